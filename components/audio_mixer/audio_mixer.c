@@ -0,0 +1,411 @@
+/**
+ * @file audio_mixer.c
+ * @brief Fixed-point multi-stream mixer with per-stream resampling, gain ramps and ducking
+ *
+ * Every pass mixes at most AUDIO_MIXER_CHUNK_FRAMES output frames. Each stream's input
+ * is staged as stereo int16, run through its polyphase resampler (audio_resampler.c),
+ * multiplied by a Q15 gain (its own gain times any crossfade level) and added into int32
+ * accumulators; the sum is saturated to
+ * int16 once per sample, or handed out as float for a limiter downstream. Keeping the
+ * lanes at 32 bits leaves headroom for every stream, so nothing clips until the final
+ * pack.
+ */
+
+#include "audio_mixer.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define GAIN_UNITY_Q15   32768
+#define GAIN_MAX_Q15     65535     // +6 dB; sample * gain still fits in int32
+#define GAIN_Q27_SHIFT   12        // Q27 ramp state -> Q15 multiplier
+#define FADE_UNITY_Q27   (GAIN_UNITY_Q15 << GAIN_Q27_SHIFT)
+#define GAIN_RAMP_MS     20        // Ramp for audio_mixer_set_gain_db() changes
+#define DUCK_HOLD_MS     300       // Gaps shorter than this between chunks keep others ducked
+#define STAGE_FRAMES     (sizeof(((audio_mixer_t *)0)->stage) / (2 * sizeof(int16_t)))
+
+typedef uint32_t __attribute__((may_alias)) u32_alias_t;  // Two int16 samples (little-endian)
+
+static int32_t db_to_q15(float db)
+{
+    float lin = powf(10.0f, db / 20.0f) * GAIN_UNITY_Q15;
+    if (lin > GAIN_MAX_Q15) {
+        return GAIN_MAX_Q15;
+    }
+    return (int32_t)(lin + 0.5f);
+}
+
+static uint32_t ms_to_frames(const audio_mixer_t *mixer, uint32_t ms)
+{
+    return (uint32_t)((uint64_t)ms * mixer->output_rate / 1000);
+}
+
+static inline int16_t sat16(int32_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+// Expand mono to stereo in place, from the end so no sample is overwritten before it
+// is read. Two samples come in per 32-bit load and each frame goes out as one store;
+// buf must be 4-byte aligned (stage frames always are).
+static void mono_to_stereo(int16_t *buf, size_t n)
+{
+    u32_alias_t *frames = (u32_alias_t *)buf;
+    size_t i = n;
+    if (i & 1) {
+        i--;
+        frames[i] = (uint16_t)buf[i] * 0x10001u;
+    }
+    while (i > 0) {
+        i -= 2;
+        uint32_t pair = frames[i / 2];  // buf[i] low, buf[i + 1] high
+        frames[i + 1] = (pair >> 16) * 0x10001u;
+        frames[i] = (pair & 0xFFFFu) * 0x10001u;
+    }
+}
+
+// Saturate accumulators to int16, two samples per 32-bit store when out is aligned
+static void pack_s16(const int32_t *acc, int16_t *out, size_t samples)
+{
+    size_t i = 0;
+    if (((uintptr_t)out & 3) == 0) {
+        u32_alias_t *pairs = (u32_alias_t *)out;
+        for (; i + 1 < samples; i += 2) {
+            pairs[i / 2] = (uint16_t)sat16(acc[i]) | (uint32_t)(uint16_t)sat16(acc[i + 1]) << 16;
+        }
+    }
+    for (; i < samples; i++) {
+        out[i] = sat16(acc[i]);
+    }
+}
+
+static bool valid_id(const audio_mixer_t *mixer, int id)
+{
+    return mixer && id >= 0 && id < AUDIO_MIXER_MAX_STREAMS;
+}
+
+esp_err_t audio_mixer_init(audio_mixer_t *mixer, uint32_t output_rate)
+{
+    if (!mixer || output_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(mixer, 0, sizeof(*mixer));
+    mixer->output_rate = output_rate;
+    for (int i = 0; i < AUDIO_MIXER_MAX_STREAMS; i++) {
+        audio_mixer_stream_t *st = &mixer->streams[i];
+        st->user_gain = GAIN_UNITY_Q15;
+        st->gain = st->gain_target = GAIN_UNITY_Q15 << GAIN_Q27_SHIFT;
+        st->fade = FADE_UNITY_Q27;
+    }
+    audio_mixer_set_ducking(mixer, 12.0f, 50, 400);
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_attach(audio_mixer_t *mixer, int id, const audio_mixer_source_t *src, uint8_t priority)
+{
+    if (!valid_id(mixer, id) || !src || !src->peek_format || !src->read) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    audio_mixer_stream_t *st = &mixer->streams[id];
+    st->src = *src;
+    st->priority = priority;
+    st->attached = true;
+    audio_mixer_reset_stream(mixer, id);
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_set_gain_db(audio_mixer_t *mixer, int id, float gain_db)
+{
+    if (!valid_id(mixer, id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (gain_db < -90.0f) {
+        gain_db = -90.0f;
+    }
+    mixer->streams[id].user_gain = db_to_q15(gain_db);
+    return ESP_OK;
+}
+
+void audio_mixer_set_ducking(audio_mixer_t *mixer, float duck_db, uint32_t attack_ms, uint32_t release_ms)
+{
+    if (!mixer) {
+        return;
+    }
+    mixer->duck_gain = db_to_q15(-fabsf(duck_db));
+    mixer->attack_ms = attack_ms;
+    mixer->release_ms = release_ms;
+}
+
+esp_err_t audio_mixer_set_output_rate(audio_mixer_t *mixer, uint32_t output_rate)
+{
+    if (!mixer || output_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (output_rate != mixer->output_rate) {
+        mixer->output_rate = output_rate;
+        for (int i = 0; i < AUDIO_MIXER_MAX_STREAMS; i++) {
+            mixer->streams[i].rate = 0;  // Pick a new filter bank on the next pass
+        }
+    }
+    return ESP_OK;
+}
+
+void audio_mixer_reset_stream(audio_mixer_t *mixer, int id)
+{
+    if (!valid_id(mixer, id)) {
+        return;
+    }
+    audio_mixer_stream_t *st = &mixer->streams[id];
+    st->rate = 0;
+    st->last_active = 0;
+    st->fade = FADE_UNITY_Q27;
+    st->fade_dir = 0;
+    st->fade_pos = 0;
+    st->fade_len = 0;
+}
+
+bool audio_mixer_is_ducked(const audio_mixer_t *mixer, int id)
+{
+    return valid_id(mixer, id) && mixer->streams[id].ducked;
+}
+
+// Crossfade level fade_pos frames into a fade of fade_len: a quarter sine, so the
+// squares of a stream fading in and one fading out over the same frames add to one
+static int32_t fade_level(const audio_mixer_stream_t *st)
+{
+    if (st->fade_pos >= st->fade_len) {
+        return FADE_UNITY_Q27;
+    }
+    return (int32_t)(sinf((float)M_PI_2 * st->fade_pos / st->fade_len) * FADE_UNITY_Q27);
+}
+
+esp_err_t audio_mixer_fade(audio_mixer_t *mixer, int id, bool fade_in, uint32_t ms)
+{
+    if (!valid_id(mixer, id)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    audio_mixer_stream_t *st = &mixer->streams[id];
+    uint32_t len = ms_to_frames(mixer, ms);
+    if (len == 0) {
+        st->fade = fade_in ? FADE_UNITY_Q27 : 0;
+        st->fade_dir = 0;
+        return ESP_OK;
+    }
+    // Start from the point on the curve of the current level, so a reversal does not jump
+    float level = (float)st->fade / FADE_UNITY_Q27;
+    float x = asinf(level < 1.0f ? level : 1.0f) / (float)M_PI_2;
+    st->fade_len = len;
+    st->fade_pos = (uint32_t)(x * len + 0.5f);
+    st->fade_dir = fade_in ? 1 : -1;
+    return ESP_OK;
+}
+
+bool audio_mixer_is_fading(const audio_mixer_t *mixer, int id)
+{
+    return valid_id(mixer, id) && mixer->streams[id].fade_dir != 0;
+}
+
+static bool stream_active(const audio_mixer_t *mixer, const audio_mixer_stream_t *st)
+{
+    return st->last_active != 0 && mixer->clock < st->last_active + ms_to_frames(mixer, DUCK_HOLD_MS);
+}
+
+// Pick each stream's gain target from its own gain and whether a higher priority is active
+static void update_gains(audio_mixer_t *mixer)
+{
+    for (int i = 0; i < AUDIO_MIXER_MAX_STREAMS; i++) {
+        audio_mixer_stream_t *st = &mixer->streams[i];
+        if (!st->attached) {
+            continue;
+        }
+        bool ducked = false;
+        for (int j = 0; j < AUDIO_MIXER_MAX_STREAMS && !ducked; j++) {
+            const audio_mixer_stream_t *other = &mixer->streams[j];
+            ducked = j != i && other->attached && other->priority > st->priority && stream_active(mixer, other);
+        }
+
+        int32_t level = ducked ? mixer->duck_gain : GAIN_UNITY_Q15;
+        int32_t target = (int32_t)(((int64_t)st->user_gain * level) >> 15) << GAIN_Q27_SHIFT;
+        uint32_t ramp_ms = ducked != st->ducked ? (ducked ? mixer->attack_ms : mixer->release_ms) : GAIN_RAMP_MS;
+        st->ducked = ducked;
+        if (target == st->gain_target) {
+            continue;
+        }
+        st->gain_target = target;
+        uint32_t frames = ms_to_frames(mixer, ramp_ms);
+        if (frames == 0 || !stream_active(mixer, st)) {
+            // A silent stream starts at its new level instead of ramping into it
+            st->gain = target;
+            st->ramp_left = 0;
+        } else {
+            st->ramp_step = (target - st->gain) / (int32_t)frames;
+            st->ramp_left = frames;
+        }
+    }
+}
+
+// Point the resampler at a new input rate; history of the old rate is dropped
+static void set_input_rate(audio_mixer_t *mixer, audio_mixer_stream_t *st, uint32_t rate)
+{
+    st->rate = rate;
+    audio_resampler_init(&st->rs, audio_resampler_get_bank(rate, mixer->output_rate));
+}
+
+// Stage up to 'want' new input frames as stereo; returns frames staged
+static size_t stage_input(audio_mixer_t *mixer, audio_mixer_stream_t *st, size_t want)
+{
+    size_t got = 0;
+    audio_mixer_format_t fmt;
+    while (got < want && st->src.peek_format(st->src.ctx, &fmt)) {
+        if (fmt.sample_rate != st->rate || (fmt.channels != 1 && fmt.channels != 2)) {
+            break;  // The new format starts next pass
+        }
+        int16_t *dst = &mixer->stage[got * 2];
+        size_t n = st->src.read(st->src.ctx, dst, want - got);
+        if (n == 0) {
+            break;
+        }
+        if (fmt.channels == 1) {
+            mono_to_stereo(dst, n);
+        }
+        got += n;
+    }
+    return got;
+}
+
+// Resample, scale and accumulate one stream; returns output frames produced
+static size_t mix_stream(audio_mixer_t *mixer, audio_mixer_stream_t *st, size_t frames)
+{
+    audio_mixer_format_t fmt;
+    size_t want = 0;
+    if (st->src.peek_format(st->src.ctx, &fmt)) {
+        if (fmt.sample_rate != st->rate) {
+            set_input_rate(mixer, st, fmt.sample_rate);
+        }
+        if (st->rs.bank) {
+            want = audio_resampler_input_needed(&st->rs, frames);
+        } else {
+            // Same rate; an unsupported rate is drained at its own pace so the queue moves on
+            want = (size_t)((uint64_t)frames * st->rate / mixer->output_rate);
+        }
+        if (want > STAGE_FRAMES) {
+            want = STAGE_FRAMES;
+        }
+    }
+    size_t avail = stage_input(mixer, st, want);
+
+    const int16_t *in = mixer->stage;
+    size_t n = avail;
+    if (st->rs.bank) {
+        n = audio_resampler_process(&st->rs, mixer->stage, avail, NULL, mixer->resampled, frames);
+        in = mixer->resampled;
+    } else if (st->rate != mixer->output_rate) {
+        return 0;
+    }
+
+    // A fade moves along its curve by the frames produced; within a chunk the level is
+    // interpolated linearly to the curve at the chunk's end, one sinf() per chunk
+    size_t fade_frames = 0;
+    int32_t fade_step = 0;
+    int32_t fade_end = st->fade;
+    if (st->fade_dir != 0) {
+        uint32_t room = st->fade_dir > 0 ? st->fade_len - st->fade_pos : st->fade_pos;
+        fade_frames = n < room ? n : room;
+        st->fade_pos = st->fade_dir > 0 ? st->fade_pos + fade_frames : st->fade_pos - fade_frames;
+        fade_end = fade_level(st);
+        if (fade_frames > 0) {
+            fade_step = (fade_end - st->fade) / (int32_t)fade_frames;
+        } else {
+            st->fade = fade_end;
+        }
+        if (fade_frames == room) {
+            st->fade_dir = 0;
+        }
+    }
+
+    int32_t *acc = mixer->acc;
+    if (st->ramp_left == 0 && fade_frames == 0) {
+        // Steady gain: straight multiply-accumulate
+        const int32_t g = ((st->gain >> GAIN_Q27_SHIFT) * (st->fade >> GAIN_Q27_SHIFT)) >> 15;
+        for (size_t i = 0; i < n * 2; i++) {
+            acc[i] += (in[i] * g) >> 15;
+        }
+        return n;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (st->ramp_left) {
+            st->gain = --st->ramp_left ? st->gain + st->ramp_step : st->gain_target;
+        }
+        if (i < fade_frames) {
+            st->fade = i + 1 < fade_frames ? st->fade + fade_step : fade_end;
+        }
+        int32_t g = ((st->gain >> GAIN_Q27_SHIFT) * (st->fade >> GAIN_Q27_SHIFT)) >> 15;
+        acc[2 * i] += (in[2 * i] * g) >> 15;
+        acc[2 * i + 1] += (in[2 * i + 1] * g) >> 15;
+    }
+    return n;
+}
+
+// Mix at most one chunk into mixer->acc; returns the number of streams that contributed
+static int mix_chunk(audio_mixer_t *mixer, size_t n)
+{
+    update_gains(mixer);
+    memset(mixer->acc, 0, n * 2 * sizeof(int32_t));
+
+    int streams = 0;
+    for (int i = 0; i < AUDIO_MIXER_MAX_STREAMS; i++) {
+        audio_mixer_stream_t *st = &mixer->streams[i];
+        if (st->attached && mix_stream(mixer, st, n) > 0) {
+            st->last_active = mixer->clock + n;
+            streams++;
+        }
+    }
+    mixer->clock += n;
+    return streams;
+}
+
+int audio_mixer_process(audio_mixer_t *mixer, int16_t *out, size_t frames)
+{
+    if (!mixer || !out) {
+        return 0;
+    }
+    int contributed = 0;
+    while (frames > 0) {
+        size_t n = frames < AUDIO_MIXER_CHUNK_FRAMES ? frames : AUDIO_MIXER_CHUNK_FRAMES;
+        int streams = mix_chunk(mixer, n);
+        pack_s16(mixer->acc, out, n * 2);
+        if (streams > contributed) {
+            contributed = streams;
+        }
+        out += n * 2;
+        frames -= n;
+    }
+    return contributed;
+}
+
+int audio_mixer_process_f32(audio_mixer_t *mixer, float *out, size_t frames)
+{
+    if (!mixer || !out) {
+        return 0;
+    }
+    int contributed = 0;
+    while (frames > 0) {
+        size_t n = frames < AUDIO_MIXER_CHUNK_FRAMES ? frames : AUDIO_MIXER_CHUNK_FRAMES;
+        int streams = mix_chunk(mixer, n);
+        for (size_t i = 0; i < n * 2; i++) {
+            out[i] = (float)mixer->acc[i];
+        }
+        if (streams > contributed) {
+            contributed = streams;
+        }
+        out += n * 2;
+        frames -= n;
+    }
+    return contributed;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file audio_resampler.c
+ * @brief Streaming rational polyphase resampler for the mixer
+ *
+ * An up/down ratio is realised as one windowed-sinc prototype at up * in_rate, split
+ * into 'up' phases; every output frame is one phase dotted with the newest input
+ * window. Banks are designed once per ratio in double precision and quantized to Q15.
+ * History is kept planar so the inner loop is two contiguous int16 dot products
+ * sharing one coefficient load, with int32 accumulation, which compilers unroll
+ * and vectorize.
+ */
+
+#include "audio_resampler.h"
+#include <math.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+
+#define CUTOFF          0.90    // Prototype cutoff relative to the lower Nyquist
+#define KAISER_BETA     8.5     // ~85 dB stopband
+#define MAX_BANKS       8
+
+static audio_resampler_bank_t *s_banks[MAX_BANKS];
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 40; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static void *alloc_coeffs(size_t bytes)
+{
+    // Read for every output sample: prefer internal RAM
+    void *p = heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!p) {
+        p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    return p;
+}
+
+static audio_resampler_bank_t *design(uint32_t in_rate, uint32_t out_rate)
+{
+    uint32_t g = gcd_u32(in_rate, out_rate);
+    uint32_t up = out_rate / g;
+    uint32_t down = in_rate / g;
+    if (up > AUDIO_RESAMPLER_MAX_PHASES) {
+        up = AUDIO_RESAMPLER_MAX_PHASES;
+        down = (uint32_t)(((uint64_t)in_rate * up + out_rate / 2) / out_rate);
+        g = gcd_u32(up, down);
+        up /= g;
+        down /= g;
+    }
+    // Downsampling narrows the cutoff relative to the input, so the filter needs more taps
+    uint32_t taps = AUDIO_RESAMPLER_TAPS;
+    if (down > up) {
+        taps = (uint32_t)(((uint64_t)AUDIO_RESAMPLER_TAPS * down + up - 1) / up);
+        taps = (taps + 3) & ~3u;
+        if (taps > AUDIO_RESAMPLER_MAX_TAPS) {
+            taps = AUDIO_RESAMPLER_MAX_TAPS;
+        }
+    }
+
+    audio_resampler_bank_t *bank = heap_caps_malloc(sizeof(*bank), MALLOC_CAP_8BIT);
+    int16_t *coeffs = alloc_coeffs((size_t)up * taps * sizeof(int16_t));
+    if (!bank || !coeffs) {
+        heap_caps_free(bank);
+        heap_caps_free(coeffs);
+        return NULL;
+    }
+
+    // Prototype at the intermediate rate up * in_rate; cutoff as a fraction of that rate.
+    // Centred on a whole input frame so a phase-0 output lands exactly on an input frame.
+    const double fc = CUTOFF * 0.5 * (up < down ? (double)up / down : 1.0) / up;
+    const double centre = (double)up * taps / 2.0;
+    const double i0_beta = bessel_i0(KAISER_BETA);
+    for (uint32_t p = 0; p < up; p++) {
+        double h[AUDIO_RESAMPLER_MAX_TAPS];
+        double sum = 0.0;
+        for (uint32_t j = 0; j < taps; j++) {
+            double n = p + (double)j * up;
+            double t = n - centre;
+            double x = 2.0 * fc * t;
+            double sinc = fabs(x) < 1e-12 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double r = t / centre;
+            double w = bessel_i0(KAISER_BETA * sqrt(fmax(0.0, 1.0 - r * r))) / i0_beta;
+            h[j] = sinc * w;
+            sum += h[j];
+        }
+        // Each phase sums to exactly 32768 so DC passes unchanged; rounding goes to the largest tap
+        int16_t *c = coeffs + (size_t)p * taps;
+        int32_t total = 0;
+        uint32_t peak = 0;
+        for (uint32_t j = 0; j < taps; j++) {
+            int32_t q = (int32_t)lround(h[j] / sum * 32768.0);
+            c[taps - 1 - j] = (int16_t)(q > INT16_MAX ? INT16_MAX : q);
+            total += c[taps - 1 - j];
+            if (fabs(h[j]) > fabs(h[peak])) {
+                peak = j;
+            }
+        }
+        c[taps - 1 - peak] = (int16_t)(c[taps - 1 - peak] + (32768 - total));
+    }
+
+    bank->in_rate = in_rate;
+    bank->out_rate = out_rate;
+    bank->up = (uint16_t)up;
+    bank->down = (uint16_t)down;
+    bank->taps = (uint16_t)taps;
+    bank->coeffs = coeffs;
+    return bank;
+}
+
+const audio_resampler_bank_t *audio_resampler_get_bank(uint32_t in_rate, uint32_t out_rate)
+{
+    if (in_rate == 0 || out_rate == 0 || in_rate == out_rate) {
+        return NULL;
+    }
+    if (in_rate > out_rate * (AUDIO_RESAMPLER_MAX_TAPS / AUDIO_RESAMPLER_TAPS)) {
+        return NULL;
+    }
+    for (int i = 0; i < MAX_BANKS; i++) {
+        if (!s_banks[i]) {
+            // Banks are never freed: streams keep pointers to them
+            s_banks[i] = design(in_rate, out_rate);
+            return s_banks[i];
+        }
+        if (s_banks[i]->in_rate == in_rate && s_banks[i]->out_rate == out_rate) {
+            return s_banks[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t audio_resampler_prepare(uint32_t out_rate, const uint32_t *in_rates, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (in_rates[i] != out_rate && !audio_resampler_get_bank(in_rates[i], out_rate)) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+void audio_resampler_init(audio_resampler_t *rs, const audio_resampler_bank_t *bank)
+{
+    rs->bank = bank;
+    rs->phase = 0;
+    rs->base = 0;
+    // Silence before the first input frame, which the first output is centred on
+    rs->fill = bank ? bank->taps / 2 - 1 : 0;
+    memset(rs->hist[0], 0, rs->fill * sizeof(int16_t));
+    memset(rs->hist[1], 0, rs->fill * sizeof(int16_t));
+}
+
+size_t audio_resampler_input_needed(const audio_resampler_t *rs, size_t out_frames)
+{
+    if (!rs->bank || out_frames == 0) {
+        return 0;
+    }
+    const audio_resampler_bank_t *b = rs->bank;
+    uint64_t q = rs->phase + (uint64_t)(out_frames - 1) * b->down;
+    uint64_t end = rs->base + q / b->up + b->taps;
+    return end > rs->fill ? (size_t)(end - rs->fill) : 0;
+}
+
+// Both channels against one coefficient load; taps is a multiple of 4
+static inline void dot_q15_stereo(const int16_t *l, const int16_t *r, const int16_t *c, uint32_t taps,
+                                  int32_t *out_l, int32_t *out_r)
+{
+    int32_t acc_l = 1 << 14, acc_r = 1 << 14;  // Round to nearest on the final shift
+    for (uint32_t k = 0; k < taps; k++) {
+        acc_l += l[k] * c[k];
+        acc_r += r[k] * c[k];
+    }
+    *out_l = acc_l >> 15;
+    *out_r = acc_r >> 15;
+}
+
+static inline int16_t sat16(int32_t v)
+{
+    return (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+}
+
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_frames, size_t *in_used,
+                               int16_t *out, size_t max_out)
+{
+    size_t produced = 0, used = 0;
+    const audio_resampler_bank_t *b = rs->bank;
+    if (!b) {
+        if (in_used) {
+            *in_used = 0;
+        }
+        return 0;
+    }
+    const uint32_t up = b->up, taps = b->taps;
+    const uint32_t step_int = b->down / up, step_frac = b->down % up;
+
+    for (;;) {
+        while (produced < max_out && rs->base + taps <= rs->fill) {
+            const int16_t *c = b->coeffs + (size_t)rs->phase * taps;
+            int32_t l, r;
+            dot_q15_stereo(&rs->hist[0][rs->base], &rs->hist[1][rs->base], c, taps, &l, &r);
+            out[2 * produced] = sat16(l);
+            out[2 * produced + 1] = sat16(r);
+            produced++;
+            rs->base += step_int;
+            rs->phase += step_frac;
+            if (rs->phase >= up) {
+                rs->phase -= up;
+                rs->base++;
+            }
+        }
+        if (used == in_frames) {
+            break;
+        }
+
+        // Drop history before the window; when downsampling the window can start past it
+        if (rs->base >= rs->fill) {
+            rs->base -= rs->fill;
+            rs->fill = 0;
+            size_t skip = in_frames - used < rs->base ? in_frames - used : rs->base;
+            used += skip;
+            rs->base -= (uint32_t)skip;
+            if (used == in_frames) {
+                break;
+            }
+        } else if (rs->base > 0) {
+            size_t keep = rs->fill - rs->base;
+            memmove(rs->hist[0], &rs->hist[0][rs->base], keep * sizeof(int16_t));
+            memmove(rs->hist[1], &rs->hist[1][rs->base], keep * sizeof(int16_t));
+            rs->fill = (uint32_t)keep;
+            rs->base = 0;
+        }
+
+        size_t n = AUDIO_RESAMPLER_HIST_FRAMES - rs->fill;
+        if (n > in_frames - used) {
+            n = in_frames - used;
+        }
+        if (n == 0) {
+            break;  // Output full and history full: the caller supplied more than it needed
+        }
+        const int16_t *src = in + used * 2;
+        int16_t *l = &rs->hist[0][rs->fill], *r = &rs->hist[1][rs->fill];
+        for (size_t i = 0; i < n; i++) {
+            l[i] = src[2 * i];
+            r[i] = src[2 * i + 1];
+        }
+        rs->fill += (uint32_t)n;
+        used += n;
+    }
+    if (in_used) {
+        *in_used = used;
+    }
+    return produced;
+}
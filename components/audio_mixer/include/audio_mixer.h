@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_MIXER_MAX_STREAMS  4
+#define AUDIO_MIXER_CHUNK_FRAMES 256  // Output frames mixed per pass
+#define AUDIO_MIXER_MAX_RATIO    (AUDIO_RESAMPLER_MAX_TAPS / AUDIO_RESAMPLER_TAPS)  // Highest input / output rate
+
+/**
+ * Format of the frames a source is about to deliver
+ */
+typedef struct {
+    uint32_t sample_rate;
+    uint8_t channels;  // 1 or 2
+} audio_mixer_format_t;
+
+/**
+ * Where a stream pulls its PCM from. Both callbacks run on the mixing task.
+ */
+typedef struct {
+    /** Format of the next frames read() returns; false if nothing is queued */
+    bool (*peek_format)(void *ctx, audio_mixer_format_t *fmt);
+    /** Copy up to max_frames interleaved frames in that format; never crosses a format change */
+    size_t (*read)(void *ctx, int16_t *dst, size_t max_frames);
+    void *ctx;
+} audio_mixer_source_t;
+
+typedef struct {
+    audio_mixer_source_t src;
+    bool attached;
+    uint8_t priority;          // Active higher-priority streams duck this one
+    uint32_t rate;             // Input rate the resampler is set up for (0: not yet)
+    audio_resampler_t rs;      // No bank: the stream is at the output rate (or unsupported)
+    int32_t user_gain;         // Q15, from audio_mixer_set_gain_db()
+    int32_t gain;              // Current gain, Q27 so per-frame ramp steps stay exact
+    int32_t gain_target;       // Q27
+    int32_t ramp_step;         // Q27 per frame
+    uint32_t ramp_left;        // Frames until gain reaches gain_target
+    uint64_t last_active;      // Mixer clock after the stream last produced audio (0: never)
+    bool ducked;
+    int32_t fade;              // Crossfade level, Q27, on top of gain
+    uint32_t fade_pos;         // Frames into the fade: level is sin(pi/2 * fade_pos / fade_len)
+    uint32_t fade_len;         // Frames from silence to full level
+    int8_t fade_dir;           // +1 fading in, -1 fading out, 0 holding at fade
+} audio_mixer_stream_t;
+
+/**
+ * Fixed-point N-stream mixer
+ *
+ * Each stream is resampled to the output rate (polyphase windowed sinc), scaled by its
+ * gain, and accumulated into 32-bit lanes that are saturated to 16-bit once at the
+ * end. While a stream is producing audio, every stream with a lower priority is
+ * ducked by duck_db with linear gain ramps. A stream can also be faded in or out on an
+ * equal-power (sine/cosine) curve, so two uncorrelated streams crossfaded over the same
+ * time keep a constant summed power.
+ */
+typedef struct {
+    audio_mixer_stream_t streams[AUDIO_MIXER_MAX_STREAMS];
+    uint32_t output_rate;
+    uint64_t clock;            // Output frames mixed since init
+    int32_t duck_gain;         // Q15
+    uint32_t attack_ms;        // Ramp into ducking
+    uint32_t release_ms;       // Ramp back out
+    int32_t acc[AUDIO_MIXER_CHUNK_FRAMES * 2];
+    int16_t stage[(AUDIO_MIXER_CHUNK_FRAMES * AUDIO_MIXER_MAX_RATIO + AUDIO_RESAMPLER_MAX_TAPS) * 2]
+        __attribute__((aligned(4)));  // Input, widened to stereo in 32-bit words
+    int16_t resampled[AUDIO_MIXER_CHUNK_FRAMES * 2];  // One stream at the output rate
+} audio_mixer_t;
+
+/**
+ * @brief Reset the mixer: no streams, 0 dB gains, 12 dB ducking with 50/400 ms ramps
+ * @param mixer: Mixer to initialize
+ * @param output_rate: Output sample rate in Hz
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a NULL mixer or zero rate
+ */
+esp_err_t audio_mixer_init(audio_mixer_t *mixer, uint32_t output_rate);
+
+/**
+ * @brief Attach a source to a stream slot
+ * @param mixer: Mixer
+ * @param id: Stream index, below AUDIO_MIXER_MAX_STREAMS
+ * @param src: Callbacks, copied
+ * @param priority: Higher values duck lower ones
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad id or missing callbacks
+ */
+esp_err_t audio_mixer_attach(audio_mixer_t *mixer, int id, const audio_mixer_source_t *src, uint8_t priority);
+
+/**
+ * @brief Set a stream's gain; applied with a short ramp
+ * @param mixer: Mixer
+ * @param id: Stream index
+ * @param gain_db: Gain in dB, clamped to [-90, +6]
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad id
+ */
+esp_err_t audio_mixer_set_gain_db(audio_mixer_t *mixer, int id, float gain_db);
+
+/**
+ * @brief Configure ducking of lower-priority streams
+ * @param mixer: Mixer
+ * @param duck_db: Attenuation applied while ducked (positive, e.g. 12 for -12 dB)
+ * @param attack_ms: Ramp time into ducking
+ * @param release_ms: Ramp time back to full level
+ */
+void audio_mixer_set_ducking(audio_mixer_t *mixer, float duck_db, uint32_t attack_ms, uint32_t release_ms);
+
+/**
+ * @brief Change the output rate; streams are resampled to it from the next pass
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a zero rate
+ */
+esp_err_t audio_mixer_set_output_rate(audio_mixer_t *mixer, uint32_t output_rate);
+
+/**
+ * @brief Fade a stream in or out on a quarter sine, from wherever its level is now
+ * The fade advances with the stream's own output, so it waits for a stream that has
+ * no audio yet. Fading one stream out and another in over the same time is an
+ * equal-power crossfade. A faded-out stream stays silent until it is faded in or reset.
+ * @param mixer: Mixer
+ * @param id: Stream index
+ * @param fade_in: true to fade up to full level, false down to silence
+ * @param ms: Time for a fade over the full range; 0 jumps there
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad id
+ */
+esp_err_t audio_mixer_fade(audio_mixer_t *mixer, int id, bool fade_in, uint32_t ms);
+
+/**
+ * @brief Whether a stream is part way through a fade
+ */
+bool audio_mixer_is_fading(const audio_mixer_t *mixer, int id);
+
+/**
+ * @brief Forget a stream's resampler history, e.g. after its queue was flushed
+ * Until then the last half filter window of input is held back, waiting for more.
+ * A fade is cancelled and the stream set back to full level.
+ */
+void audio_mixer_reset_stream(audio_mixer_t *mixer, int id);
+
+/**
+ * @brief Pull from every stream and mix into interleaved stereo
+ * Frames a stream cannot supply are silence for that stream. A stream whose rate
+ * is more than AUDIO_MIXER_MAX_RATIO times the output rate is read and discarded.
+ * @param mixer: Mixer
+ * @param out: Destination, frames * 2 samples
+ * @param frames: Output frames to produce
+ * @return Number of streams that contributed audio (0: out is silence)
+ */
+int audio_mixer_process(audio_mixer_t *mixer, int16_t *out, size_t frames);
+
+/**
+ * @brief Same as audio_mixer_process(), without the final saturation
+ * For a stage that controls the level itself (e.g. a limiter): samples are at int16
+ * scale but may exceed it where streams add up.
+ * @param mixer: Mixer
+ * @param out: Destination, frames * 2 samples
+ * @param frames: Output frames to produce
+ * @return Number of streams that contributed audio (0: out is silence)
+ */
+int audio_mixer_process_f32(audio_mixer_t *mixer, float *out, size_t frames);
+
+/**
+ * @brief Whether a stream is currently ducked
+ */
+bool audio_mixer_is_ducked(const audio_mixer_t *mixer, int id);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_RESAMPLER_TAPS       32   // Taps per phase when upsampling; scaled up when downsampling
+#define AUDIO_RESAMPLER_MAX_TAPS   128  // Up to 4:1 downsampling at full quality
+#define AUDIO_RESAMPLER_MAX_PHASES 512  // Ratios needing more are approximated (< 0.1% pitch error)
+#define AUDIO_RESAMPLER_HIST_FRAMES (AUDIO_RESAMPLER_MAX_TAPS + 256)
+
+/**
+ * Polyphase filter bank for one rational ratio up/down, shared by every stream at that ratio
+ *
+ * Windowed-sinc prototype (Kaiser), split into 'up' phases of 'taps' Q15 coefficients,
+ * stored time-reversed so each output is a forward dot product over the input window.
+ * Every phase sums to exactly unity, so DC passes bit-exact.
+ */
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint16_t up;            // L: phases
+    uint16_t down;          // M: input frames advanced per L outputs
+    uint16_t taps;          // Coefficients per phase
+    int16_t *coeffs;        // up * taps
+} audio_resampler_bank_t;
+
+/**
+ * Streaming state for one stereo stream
+ */
+typedef struct {
+    const audio_resampler_bank_t *bank;
+    uint32_t phase;         // 0..up-1
+    uint32_t base;          // First history frame of the next output's window
+    uint32_t fill;          // History frames held
+    int16_t hist[2][AUDIO_RESAMPLER_HIST_FRAMES];  // Planar L / R
+} audio_resampler_t;
+
+/**
+ * @brief Filter bank for a conversion, designed on first use and kept for reuse
+ * Not thread-safe: call from one task, or call audio_resampler_prepare() up front.
+ * @param in_rate: Input rate in Hz
+ * @param out_rate: Output rate in Hz
+ * @return Bank, or NULL when the rates are equal, out of range, or memory is short
+ */
+const audio_resampler_bank_t *audio_resampler_get_bank(uint32_t in_rate, uint32_t out_rate);
+
+/**
+ * @brief Design the banks for a list of input rates ahead of playback
+ * @param out_rate: Output rate in Hz
+ * @param in_rates: Input rates; entries equal to out_rate are skipped
+ * @param count: Number of entries
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if a bank could not be allocated
+ */
+esp_err_t audio_resampler_prepare(uint32_t out_rate, const uint32_t *in_rates, size_t count);
+
+/**
+ * @brief Start a stream on a bank with empty (silent) history
+ * @param rs: Resampler state
+ * @param bank: From audio_resampler_get_bank()
+ */
+void audio_resampler_init(audio_resampler_t *rs, const audio_resampler_bank_t *bank);
+
+/**
+ * @brief Input frames to supply so that the next call can produce out_frames
+ */
+size_t audio_resampler_input_needed(const audio_resampler_t *rs, size_t out_frames);
+
+/**
+ * @brief Consume interleaved stereo input and produce resampled interleaved stereo
+ * All input is taken into history as long as it does not exceed
+ * audio_resampler_input_needed() for max_out frames.
+ * @param rs: Resampler state
+ * @param in: Interleaved stereo input
+ * @param in_frames: Input frames
+ * @param in_used: Input frames consumed (may be NULL)
+ * @param out: Interleaved stereo output
+ * @param max_out: Output capacity in frames
+ * @return Output frames produced
+ */
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_frames, size_t *in_used,
+                               int16_t *out, size_t max_out);
+
+#ifdef __cplusplus
+}
+#endif
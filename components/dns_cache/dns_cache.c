@@ -0,0 +1,520 @@
+/**
+ * @file dns_cache.c
+ * @brief Shared DNS cache with TTL, background refresh and stale-while-revalidate
+ *
+ * lwIP's own resolver table does not expose TTLs and always blocks the caller
+ * once an entry expires. This cache sits in front of it through the netconn
+ * external-resolve hook: it sends its own A queries (so it sees the TTL),
+ * refreshes pinned and recently used hosts shortly before they expire, and keeps
+ * serving the last good address while a refresh fails.
+ */
+
+#include "dns_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
+#include "lwip/ip_addr.h"
+#include "sdkconfig.h"
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "dns_cache";
+
+#ifndef CONFIG_DNS_CACHE_ENTRIES
+#define CONFIG_DNS_CACHE_ENTRIES 8
+#endif
+#ifndef CONFIG_DNS_CACHE_MIN_TTL_S
+#define CONFIG_DNS_CACHE_MIN_TTL_S 30
+#endif
+#ifndef CONFIG_DNS_CACHE_MAX_TTL_S
+#define CONFIG_DNS_CACHE_MAX_TTL_S 3600
+#endif
+#ifndef CONFIG_DNS_CACHE_STALE_MAX_S
+#define CONFIG_DNS_CACHE_STALE_MAX_S 86400
+#endif
+#ifndef CONFIG_DNS_CACHE_QUERY_TIMEOUT_MS
+#define CONFIG_DNS_CACHE_QUERY_TIMEOUT_MS 1500
+#endif
+
+#define DNS_CACHE_HOST_MAX        64
+#define DNS_CACHE_US_PER_S        1000000LL
+#define DNS_CACHE_REFRESH_MIN_S   5       // Refresh at least this long before expiry
+#define DNS_CACHE_RETRY_S         10      // Back-off after a failed refresh
+#define DNS_CACHE_ACTIVE_S        600     // Unpinned hosts used this recently are kept warm
+#define DNS_CACHE_IDLE_WAKE_MS    60000
+#define DNS_CACHE_TASK_STACK      4096
+#define DNS_CACHE_TASK_PRIO       3
+#define DNS_PACKET_MAX            512
+#define DNS_PORT                  53
+#define DNS_TYPE_A                1
+#define DNS_CLASS_IN              1
+
+typedef struct {
+    char host[DNS_CACHE_HOST_MAX];
+    ip4_addr_t addr;
+    uint32_t ttl_s;
+    int64_t expires_us;     // When the record's TTL runs out
+    int64_t last_used_us;
+    int64_t retry_at_us;    // Earliest next refresh attempt after a failure
+    bool in_use;
+    bool valid;             // `addr` holds a resolved address (possibly expired)
+    bool pinned;
+    bool refresh_requested;
+} dns_cache_entry_t;
+
+static dns_cache_entry_t s_entries[CONFIG_DNS_CACHE_ENTRIES];
+static SemaphoreHandle_t s_lock = NULL;
+static TaskHandle_t s_refresh_task = NULL;
+static dns_cache_stats_t s_stats;
+
+static int build_query(uint8_t *buf, size_t cap, uint16_t id, const char *host)
+{
+    size_t pos = 0;
+    if (cap < 12) {
+        return -1;
+    }
+    memset(buf, 0, 12);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xff;
+    buf[2] = 0x01;  // RD: recursion desired
+    buf[5] = 1;     // QDCOUNT = 1
+    pos = 12;
+
+    const char *label = host;
+    while (*label) {
+        const char *dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+        if (len == 0 || len > 63 || pos + 1 + len + 5 > cap) {
+            return -1;
+        }
+        buf[pos++] = (uint8_t)len;
+        memcpy(buf + pos, label, len);
+        pos += len;
+        label += len;
+        if (*label == '.') {
+            label++;
+        }
+    }
+    buf[pos++] = 0;
+    buf[pos++] = 0;
+    buf[pos++] = DNS_TYPE_A;
+    buf[pos++] = 0;
+    buf[pos++] = DNS_CLASS_IN;
+    return (int)pos;
+}
+
+// Advance past a (possibly compressed) domain name; returns new offset or -1
+static int skip_name(const uint8_t *buf, size_t len, size_t pos)
+{
+    while (pos < len) {
+        uint8_t c = buf[pos];
+        if (c == 0) {
+            return (int)pos + 1;
+        }
+        if ((c & 0xC0) == 0xC0) {
+            return (pos + 2 <= len) ? (int)pos + 2 : -1;
+        }
+        pos += 1 + c;
+    }
+    return -1;
+}
+
+// Extract the first A record and the smallest TTL along the answer chain
+static esp_err_t parse_response(const uint8_t *buf, size_t len, uint16_t id,
+                                ip4_addr_t *addr, uint32_t *ttl_s)
+{
+    if (len < 12 || ((buf[0] << 8) | buf[1]) != id || !(buf[2] & 0x80)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if ((buf[3] & 0x0F) != 0) {
+        return ESP_ERR_NOT_FOUND;  // NXDOMAIN / SERVFAIL / ...
+    }
+
+    uint16_t qdcount = (buf[4] << 8) | buf[5];
+    uint16_t ancount = (buf[6] << 8) | buf[7];
+    int pos = 12;
+    for (uint16_t i = 0; i < qdcount; i++) {
+        pos = skip_name(buf, len, pos);
+        if (pos < 0 || (size_t)pos + 4 > len) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        pos += 4;
+    }
+
+    uint32_t min_ttl = UINT32_MAX;
+    for (uint16_t i = 0; i < ancount; i++) {
+        pos = skip_name(buf, len, pos);
+        if (pos < 0 || (size_t)pos + 10 > len) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        uint16_t type = (buf[pos] << 8) | buf[pos + 1];
+        uint16_t cls = (buf[pos + 2] << 8) | buf[pos + 3];
+        uint32_t ttl = ((uint32_t)buf[pos + 4] << 24) | ((uint32_t)buf[pos + 5] << 16) |
+                       ((uint32_t)buf[pos + 6] << 8) | buf[pos + 7];
+        uint16_t rdlen = (buf[pos + 8] << 8) | buf[pos + 9];
+        pos += 10;
+        if ((size_t)pos + rdlen > len) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (ttl < min_ttl) {
+            min_ttl = ttl;  // CNAME links expire too
+        }
+        if (type == DNS_TYPE_A && cls == DNS_CLASS_IN && rdlen == 4) {
+            IP4_ADDR(addr, buf[pos], buf[pos + 1], buf[pos + 2], buf[pos + 3]);
+            *ttl_s = min_ttl;
+            return ESP_OK;
+        }
+        pos += rdlen;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Query each configured DNS server in turn (runs in the caller's task, no lock held)
+static esp_err_t query_host(const char *host, ip4_addr_t *addr, uint32_t *ttl_s)
+{
+    uint8_t packet[DNS_PACKET_MAX];
+    uint16_t id = (uint16_t)esp_random();
+    int query_len = build_query(packet, sizeof(packet), id, host);
+    if (query_len < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        return ESP_FAIL;
+    }
+    struct timeval tv = {
+        .tv_sec = CONFIG_DNS_CACHE_QUERY_TIMEOUT_MS / 1000,
+        .tv_usec = (CONFIG_DNS_CACHE_QUERY_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    for (u8_t server = 0; server < DNS_MAX_SERVERS && ret != ESP_OK; server++) {
+        const ip_addr_t *dns_ip = dns_getserver(server);
+        if (!dns_ip || !IP_IS_V4(dns_ip) || ip_addr_isany(dns_ip)) {
+            continue;
+        }
+
+        struct sockaddr_in to = {
+            .sin_family = AF_INET,
+            .sin_port = htons(DNS_PORT),
+            .sin_addr.s_addr = ip_2_ip4(dns_ip)->addr,
+        };
+        if (sendto(sock, packet, query_len, 0, (struct sockaddr *)&to, sizeof(to)) != query_len) {
+            continue;
+        }
+
+        uint8_t answer[DNS_PACKET_MAX];
+        int n = recv(sock, answer, sizeof(answer), 0);
+        if (n > 0) {
+            ret = parse_response(answer, (size_t)n, id, addr, ttl_s);
+        }
+    }
+
+    close(sock);
+    return ret;
+}
+
+static uint32_t clamp_ttl(uint32_t ttl_s)
+{
+    if (ttl_s < CONFIG_DNS_CACHE_MIN_TTL_S) {
+        return CONFIG_DNS_CACHE_MIN_TTL_S;
+    }
+    if (ttl_s > CONFIG_DNS_CACHE_MAX_TTL_S) {
+        return CONFIG_DNS_CACHE_MAX_TTL_S;
+    }
+    return ttl_s;
+}
+
+// Called with s_lock held
+static dns_cache_entry_t *find_entry_locked(const char *host)
+{
+    for (int i = 0; i < CONFIG_DNS_CACHE_ENTRIES; i++) {
+        if (s_entries[i].in_use && strcasecmp(s_entries[i].host, host) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Find or create the entry for `host`, evicting the least recently used unpinned entry
+static dns_cache_entry_t *get_entry_locked(const char *host)
+{
+    dns_cache_entry_t *entry = find_entry_locked(host);
+    if (entry) {
+        return entry;
+    }
+
+    for (int i = 0; i < CONFIG_DNS_CACHE_ENTRIES; i++) {
+        if (!s_entries[i].in_use) {
+            entry = &s_entries[i];
+            break;
+        }
+        if (!s_entries[i].pinned && (!entry || s_entries[i].last_used_us < entry->last_used_us)) {
+            entry = &s_entries[i];
+        }
+    }
+    if (!entry) {
+        return NULL;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->host, host, sizeof(entry->host) - 1);
+    entry->in_use = true;
+    return entry;
+}
+
+static void store_result_locked(dns_cache_entry_t *entry, const ip4_addr_t *addr, uint32_t ttl_s, int64_t now)
+{
+    entry->addr = *addr;
+    entry->ttl_s = clamp_ttl(ttl_s);
+    entry->expires_us = now + (int64_t)entry->ttl_s * DNS_CACHE_US_PER_S;
+    entry->retry_at_us = 0;
+    entry->valid = true;
+}
+
+static int64_t refresh_due_us(const dns_cache_entry_t *entry)
+{
+    if (!entry->valid) {
+        return entry->retry_at_us;
+    }
+    int64_t margin_s = entry->ttl_s / 10;
+    if (margin_s < DNS_CACHE_REFRESH_MIN_S) {
+        margin_s = DNS_CACHE_REFRESH_MIN_S;
+    }
+    int64_t due = entry->expires_us - margin_s * DNS_CACHE_US_PER_S;
+    return (entry->retry_at_us > due) ? entry->retry_at_us : due;
+}
+
+static void refresh_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "DNS refresh task started");
+
+    while (true) {
+        char host[DNS_CACHE_HOST_MAX] = {0};
+        int64_t now = esp_timer_get_time();
+        int64_t next_due = now + (int64_t)DNS_CACHE_IDLE_WAKE_MS * 1000;
+
+        // Pick the most overdue host that is pinned or still in active use
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int64_t best_due = INT64_MAX;
+        for (int i = 0; i < CONFIG_DNS_CACHE_ENTRIES; i++) {
+            dns_cache_entry_t *e = &s_entries[i];
+            if (!e->in_use) {
+                continue;
+            }
+            bool active = e->pinned || e->refresh_requested ||
+                          (now - e->last_used_us) < (int64_t)DNS_CACHE_ACTIVE_S * DNS_CACHE_US_PER_S;
+            if (!active) {
+                continue;
+            }
+            int64_t due = e->refresh_requested ? e->retry_at_us : refresh_due_us(e);
+            if (due <= now && due < best_due) {
+                best_due = due;
+                strncpy(host, e->host, sizeof(host) - 1);
+            } else if (due > now && due < next_due) {
+                next_due = due;
+            }
+        }
+        xSemaphoreGive(s_lock);
+
+        if (host[0] == '\0') {
+            TickType_t wait = pdMS_TO_TICKS((next_due - now) / 1000);
+            ulTaskNotifyTake(pdTRUE, wait > 0 ? wait : 1);
+            continue;
+        }
+
+        ip4_addr_t addr;
+        uint32_t ttl_s = 0;
+        esp_err_t ret = query_host(host, &addr, &ttl_s);
+        now = esp_timer_get_time();
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        dns_cache_entry_t *entry = find_entry_locked(host);
+        if (entry) {
+            entry->refresh_requested = false;
+            if (ret == ESP_OK) {
+                store_result_locked(entry, &addr, ttl_s, now);
+                s_stats.refreshes++;
+            } else {
+                entry->retry_at_us = now + (int64_t)DNS_CACHE_RETRY_S * DNS_CACHE_US_PER_S;
+                s_stats.failures++;
+            }
+        }
+        xSemaphoreGive(s_lock);
+
+        if (ret == ESP_OK) {
+            ESP_LOGD(TAG, "Refreshed %s -> " IPSTR " (ttl %lus)", host, IP2STR(&addr), (unsigned long)ttl_s);
+        } else {
+            ESP_LOGW(TAG, "Refresh of %s failed (%s), serving cached address", host, esp_err_to_name(ret));
+        }
+    }
+}
+
+esp_err_t dns_cache_init(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(s_entries, 0, sizeof(s_entries));
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    if (xTaskCreate(refresh_task, "dns_refresh", DNS_CACHE_TASK_STACK, NULL,
+                    DNS_CACHE_TASK_PRIO, &s_refresh_task) != pdPASS) {
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        ESP_LOGE(TAG, "Failed to create DNS refresh task");
+        return ESP_ERR_NO_MEM;
+    }
+
+#ifndef CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM
+    ESP_LOGW(TAG, "LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM disabled - HTTP clients will bypass the cache");
+#endif
+    ESP_LOGI(TAG, "DNS cache initialized (%d entries)", CONFIG_DNS_CACHE_ENTRIES);
+    return ESP_OK;
+}
+
+esp_err_t dns_cache_pin(const char *host)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!host || strlen(host) >= DNS_CACHE_HOST_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    dns_cache_entry_t *entry = get_entry_locked(host);
+    if (entry) {
+        entry->pinned = true;
+        if (!entry->valid) {
+            entry->refresh_requested = true;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (!entry) {
+        ESP_LOGW(TAG, "Cannot pin %s: all entries pinned", host);
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(s_refresh_task);
+    return ESP_OK;
+}
+
+esp_err_t dns_cache_resolve(const char *host, ip4_addr_t *addr)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!host || !addr || strlen(host) >= DNS_CACHE_HOST_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool stale = false;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    dns_cache_entry_t *entry = find_entry_locked(host);
+    if (entry && entry->valid) {
+        int64_t stale_limit = entry->expires_us + (int64_t)CONFIG_DNS_CACHE_STALE_MAX_S * DNS_CACHE_US_PER_S;
+        if (now < entry->expires_us) {
+            *addr = entry->addr;
+            entry->last_used_us = now;
+            s_stats.hits++;
+            xSemaphoreGive(s_lock);
+            return ESP_OK;
+        }
+        if (now < stale_limit) {
+            // Serve the expired address now and let the refresh task revalidate it
+            *addr = entry->addr;
+            entry->last_used_us = now;
+            entry->refresh_requested = true;
+            s_stats.stale_hits++;
+            stale = true;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    if (stale) {
+        xTaskNotifyGive(s_refresh_task);
+        return ESP_OK;
+    }
+
+    // Not cached (or too stale): resolve on the caller's path
+    uint32_t ttl_s = 0;
+    esp_err_t ret = query_host(host, addr, &ttl_s);
+    now = esp_timer_get_time();
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.misses++;
+    if (ret == ESP_OK) {
+        entry = get_entry_locked(host);
+        if (entry) {
+            store_result_locked(entry, addr, ttl_s, now);
+            entry->last_used_us = now;
+        }
+    } else {
+        s_stats.failures++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Lookup of %s failed: %s", host, esp_err_to_name(ret));
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGI(TAG, "Resolved %s -> " IPSTR " (ttl %lus)", host, IP2STR(addr), (unsigned long)ttl_s);
+    return ESP_OK;
+}
+
+void dns_cache_get_stats(dns_cache_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    if (!s_lock) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_lock);
+}
+
+#ifdef CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM
+/**
+ * lwIP netconn resolve hook: answers IPv4 lookups from the cache.
+ * Returning 0 falls back to lwIP's own resolver (IPv6, literals, cache not ready).
+ */
+int lwip_hook_netconn_external_resolve(const char *name, ip_addr_t *addr, u8_t addrtype, err_t *err)
+{
+    if (!s_lock || !name || !addr || !err) {
+        return 0;
+    }
+    if (addrtype != LWIP_DNS_ADDRTYPE_IPV4 && addrtype != LWIP_DNS_ADDRTYPE_IPV4_IPV6) {
+        return 0;
+    }
+
+    ip4_addr_t v4;
+    if (ip4addr_aton(name, &v4)) {
+        return 0;  // Address literal, nothing to resolve
+    }
+    if (dns_cache_resolve(name, &v4) != ESP_OK) {
+        return 0;
+    }
+
+    ip_addr_copy_from_ip4(*addr, v4);
+    *err = ERR_OK;
+    return 1;
+}
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lwip/ip4_addr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * DNS cache statistics
+ */
+typedef struct {
+    uint32_t hits;          // Served from a fresh entry
+    uint32_t stale_hits;    // Served from an expired entry while refreshing
+    uint32_t misses;        // Resolved synchronously on the caller's path
+    uint32_t refreshes;     // Background refreshes that succeeded
+    uint32_t failures;      // Queries that got no usable answer
+} dns_cache_stats_t;
+
+/**
+ * @brief Initialize the shared DNS cache and start its refresh task
+ * Once initialized, every lwIP hostname lookup (esp_http_client, esp-tls,
+ * getaddrinfo) for an IPv4 host is answered from the cache. Requires
+ * CONFIG_LWIP_HOOK_NETCONN_EXT_RESOLVE_CUSTOM.
+ * @return ESP_OK on success
+ */
+esp_err_t dns_cache_init(void);
+
+/**
+ * @brief Pin a host in the cache and resolve it in the background
+ * Pinned hosts are never evicted and are refreshed shortly before their TTL
+ * expires, so requests to them never wait for DNS.
+ * @param host: Hostname (copied)
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if every entry is pinned
+ */
+esp_err_t dns_cache_pin(const char *host);
+
+/**
+ * @brief Resolve a hostname through the cache
+ * Fresh entries are returned directly; expired entries are returned while a
+ * background refresh runs; unknown hosts are queried synchronously.
+ * @param host: Hostname
+ * @param addr: Resolved IPv4 address
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the host could not be resolved
+ */
+esp_err_t dns_cache_resolve(const char *host, ip4_addr_t *addr);
+
+/**
+ * @brief Get cache statistics
+ * @param stats: Output statistics
+ */
+void dns_cache_get_stats(dns_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
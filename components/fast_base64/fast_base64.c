@@ -0,0 +1,427 @@
+/**
+ * @file fast_base64.c
+ * @brief Table-driven base64 codec with SSSE3 / AVX2 kernels on x86 hosts
+ *
+ * mbedtls_base64_* maps every character through a constant-time range
+ * comparison, which is needed for key material but costs tens of cycles per
+ * byte on audio payloads. Here the portable kernel is one table lookup per
+ * character, 3 bytes / 4 characters per step. On x86 builds (host benchmarks)
+ * the vector kernels follow Muła & Lemire's pshufb / multiply-add approach.
+ *
+ * The ESP32-S3 PIE vector unit has no per-byte table lookup (pshufb
+ * equivalent), which every base64 vector kernel is built around, so the target
+ * uses the scalar kernel with its tables in internal RAM.
+ */
+
+#include "fast_base64.h"
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define DRAM_ATTR
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FAST_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+// Encodes / decodes whole 3-byte / 4-character groups; decode returns false on an invalid character
+typedef void (*encode_groups_fn)(char *dst, const uint8_t *src, size_t groups);
+typedef bool (*decode_groups_fn)(uint8_t *dst, const char *src, size_t groups);
+
+typedef struct {
+    fast_base64_kernel_t id;
+    encode_groups_fn encode;
+    decode_groups_fn decode;
+} codec_t;
+
+static DRAM_ATTR const char ENC[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 6-bit value per character; 0x80 marks everything outside the alphabet ('=' included)
+static DRAM_ATTR const uint8_t DEC[256] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3e, 0x80, 0x80, 0x80, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+// --- scalar ---------------------------------------------------------------------
+
+static void encode_groups_scalar(char *dst, const uint8_t *src, size_t groups)
+{
+    for (size_t i = 0; i < groups; i++) {
+        uint32_t v = ((uint32_t)src[0] << 16) | ((uint32_t)src[1] << 8) | src[2];
+        dst[0] = ENC[v >> 18];
+        dst[1] = ENC[(v >> 12) & 0x3f];
+        dst[2] = ENC[(v >> 6) & 0x3f];
+        dst[3] = ENC[v & 0x3f];
+        src += 3;
+        dst += 4;
+    }
+}
+
+static bool decode_groups_scalar(uint8_t *dst, const char *src, size_t groups)
+{
+    const uint8_t *in = (const uint8_t *)src;
+    for (size_t i = 0; i < groups; i++) {
+        uint32_t a = DEC[in[0]];
+        uint32_t b = DEC[in[1]];
+        uint32_t c = DEC[in[2]];
+        uint32_t d = DEC[in[3]];
+        if ((a | b | c | d) & 0x80) {
+            return false;
+        }
+        uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+        dst[0] = (uint8_t)(v >> 16);
+        dst[1] = (uint8_t)(v >> 8);
+        dst[2] = (uint8_t)v;
+        in += 4;
+        dst += 3;
+    }
+    return true;
+}
+
+static const codec_t CODEC_SCALAR = {
+    .id = FAST_BASE64_KERNEL_SCALAR,
+    .encode = encode_groups_scalar,
+    .decode = decode_groups_scalar,
+};
+
+#ifdef FAST_BASE64_X86
+
+// --- SSSE3: 12 bytes <-> 16 characters per step ---------------------------------
+
+// Split 4 x 24 bits (already arranged as b1 b0 b2 b1 per lane) into 16 6-bit indices
+__attribute__((target("ssse3")))
+static inline __m128i enc_unpack_ssse3(__m128i in)
+{
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+// Map 6-bit indices to ASCII with one pshufb of per-range offsets
+__attribute__((target("ssse3")))
+static inline __m128i enc_translate_ssse3(__m128i indices)
+{
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                          '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+}
+
+__attribute__((target("ssse3")))
+static size_t encode_blocks_ssse3(char *dst, const uint8_t *src, size_t groups)
+{
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    size_t done = 0;
+    // Each step reads 16 bytes but consumes 12, so keep 2 spare groups
+    while (groups - done >= 6) {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), spread);
+        _mm_storeu_si128((__m128i *)dst, enc_translate_ssse3(enc_unpack_ssse3(in)));
+        src += 12;
+        dst += 16;
+        done += 4;
+    }
+    return done;
+}
+
+__attribute__((target("ssse3")))
+static void encode_groups_ssse3(char *dst, const uint8_t *src, size_t groups)
+{
+    size_t done = encode_blocks_ssse3(dst, src, groups);
+    encode_groups_scalar(dst + done * 4, src + done * 3, groups - done);
+}
+
+// ASCII to 6-bit values; sets *bad to a non-zero mask if any lane is outside the alphabet
+__attribute__((target("ssse3")))
+static inline __m128i dec_translate_ssse3(__m128i in, int *bad)
+{
+    // Bytes >= 0x80 compare as negative and fall outside every range
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+    __m128i plus = _mm_cmpeq_epi8(in, _mm_set1_epi8('+'));
+    __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+
+    __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+    *bad = _mm_movemask_epi8(valid) ^ 0xffff;
+
+    __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+    shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+    return _mm_add_epi8(in, shift);
+}
+
+// Pack 16 6-bit values into 12 bytes at the bottom of the register
+__attribute__((target("ssse3")))
+static inline __m128i dec_pack_ssse3(__m128i values)
+{
+    __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(words, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3")))
+static bool decode_blocks_ssse3(uint8_t *dst, const char *src, size_t groups, size_t *done_out)
+{
+    size_t done = 0;
+    // Each step stores 16 bytes but produces 12, so keep 2 spare groups of output
+    while (groups - done >= 6) {
+        int bad;
+        __m128i values = dec_translate_ssse3(_mm_loadu_si128((const __m128i *)src), &bad);
+        if (bad) {
+            return false;
+        }
+        _mm_storeu_si128((__m128i *)dst, dec_pack_ssse3(values));
+        src += 16;
+        dst += 12;
+        done += 4;
+    }
+    *done_out = done;
+    return true;
+}
+
+__attribute__((target("ssse3")))
+static bool decode_groups_ssse3(uint8_t *dst, const char *src, size_t groups)
+{
+    size_t done;
+    if (!decode_blocks_ssse3(dst, src, groups, &done)) {
+        return false;
+    }
+    return decode_groups_scalar(dst + done * 3, src + done * 4, groups - done);
+}
+
+static const codec_t CODEC_SSSE3 = {
+    .id = FAST_BASE64_KERNEL_SSSE3,
+    .encode = encode_groups_ssse3,
+    .decode = decode_groups_ssse3,
+};
+
+// --- AVX2: 24 bytes <-> 32 characters per step (two SSSE3 lanes) ----------------
+
+__attribute__((target("avx2")))
+static void encode_groups_avx2(char *dst, const uint8_t *src, size_t groups)
+{
+    const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                             '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                             '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                             '/' - 63, 'A', 0, 0);
+    size_t done = 0;
+    // Lanes load src[0..15] and src[12..27]: keep enough groups for the 28-byte read
+    while (groups - done >= 10) {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+            _mm_loadu_si128((const __m128i *)(src + 12)), 1);
+        in = _mm256_shuffle_epi8(in, spread);
+
+        __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i out = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices);
+
+        _mm256_storeu_si256((__m256i *)dst, out);
+        src += 24;
+        dst += 32;
+        done += 8;
+    }
+    encode_groups_ssse3(dst, src, groups - done);
+}
+
+__attribute__((target("avx2")))
+static bool decode_groups_avx2(uint8_t *dst, const char *src, size_t groups)
+{
+    size_t done = 0;
+    // Each step stores 32 bytes but produces 24: keep 3 spare groups of output
+    while (groups - done >= 11) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)src);
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('A' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), in));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), in));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), in));
+        __m256i plus = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('+'));
+        __m256i slash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                                        _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+        if ((uint32_t)_mm256_movemask_epi8(valid) != 0xffffffffu) {
+            return false;
+        }
+
+        __m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')));
+        __m256i values = _mm256_add_epi8(in, shift);
+
+        __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        __m256i packed = _mm256_shuffle_epi8(words, _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        // Close the 4-byte gap between the two 12-byte lane results
+        packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *)dst, packed);
+        src += 32;
+        dst += 24;
+        done += 8;
+    }
+    return decode_groups_ssse3(dst, src, groups - done);
+}
+
+static const codec_t CODEC_AVX2 = {
+    .id = FAST_BASE64_KERNEL_AVX2,
+    .encode = encode_groups_avx2,
+    .decode = decode_groups_avx2,
+};
+
+#endif // FAST_BASE64_X86
+
+static const codec_t *s_codec = NULL;
+
+static const codec_t *codec_for(fast_base64_kernel_t kernel)
+{
+#ifdef FAST_BASE64_X86
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool ssse3 = __builtin_cpu_supports("ssse3");
+    if ((kernel == FAST_BASE64_KERNEL_AUTO || kernel == FAST_BASE64_KERNEL_AVX2) && avx2) {
+        return &CODEC_AVX2;
+    }
+    if (kernel != FAST_BASE64_KERNEL_SCALAR && ssse3) {
+        return &CODEC_SSSE3;
+    }
+#else
+    (void)kernel;
+#endif
+    return &CODEC_SCALAR;
+}
+
+static inline const codec_t *codec(void)
+{
+    const codec_t *c = s_codec;
+    if (!c) {
+        c = codec_for(FAST_BASE64_KERNEL_AUTO);
+        s_codec = c;  // Every caller computes the same pointer, so a race is harmless
+    }
+    return c;
+}
+
+fast_base64_kernel_t fast_base64_select_kernel(fast_base64_kernel_t kernel)
+{
+    s_codec = codec_for(kernel);
+    return s_codec->id;
+}
+
+const char *fast_base64_kernel_name(fast_base64_kernel_t kernel)
+{
+    switch (kernel) {
+        case FAST_BASE64_KERNEL_SCALAR: return "scalar";
+        case FAST_BASE64_KERNEL_SSSE3:  return "ssse3";
+        case FAST_BASE64_KERNEL_AVX2:   return "avx2";
+        default:                        return "auto";
+    }
+}
+
+size_t fast_base64_encode(char *dst, const uint8_t *src, size_t len)
+{
+    size_t groups = len / 3;
+    codec()->encode(dst, src, groups);
+    src += groups * 3;
+    dst += groups * 4;
+
+    size_t rest = len - groups * 3;
+    if (rest > 0) {
+        uint32_t v = (uint32_t)src[0] << 16;
+        if (rest == 2) {
+            v |= (uint32_t)src[1] << 8;
+        }
+        dst[0] = ENC[v >> 18];
+        dst[1] = ENC[(v >> 12) & 0x3f];
+        dst[2] = rest == 2 ? ENC[(v >> 6) & 0x3f] : '=';
+        dst[3] = '=';
+    }
+    return fast_base64_encoded_len(len);
+}
+
+esp_err_t fast_base64_decode(uint8_t *dst, size_t dst_cap, size_t *out_len, const char *src, size_t len)
+{
+    if (!out_len || (len > 0 && (!src || !dst))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_len = 0;
+    if (len == 0) {
+        return ESP_OK;
+    }
+    if (len % 4 != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t groups = len / 4;
+    size_t pad = src[len - 1] == '=' ? (src[len - 2] == '=' ? 2 : 1) : 0;
+    size_t total = groups * 3 - pad;
+    if (total > dst_cap) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Whole groups go through the kernel; a padded final group is finished here
+    size_t full = pad ? groups - 1 : groups;
+    if (!codec()->decode(dst, src, full)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pad) {
+        const uint8_t *in = (const uint8_t *)src + full * 4;
+        uint32_t a = DEC[in[0]];
+        uint32_t b = DEC[in[1]];
+        uint32_t c = pad == 1 ? DEC[in[2]] : 0;
+        if ((a | b | c) & 0x80) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint32_t v = (a << 18) | (b << 12) | (c << 6);
+        uint8_t *out = dst + full * 3;
+        out[0] = (uint8_t)(v >> 16);
+        if (pad == 1) {
+            out[1] = (uint8_t)(v >> 8);
+        }
+    }
+    *out_len = total;
+    return ESP_OK;
+}
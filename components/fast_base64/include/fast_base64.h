@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Codec kernels. On the ESP32-S3 only the scalar (table-driven, word-at-a-time)
+ * kernel exists; x86 host builds add SSSE3 and AVX2 kernels picked at runtime.
+ */
+typedef enum {
+    FAST_BASE64_KERNEL_AUTO = 0,  // Fastest supported kernel
+    FAST_BASE64_KERNEL_SCALAR,
+    FAST_BASE64_KERNEL_SSSE3,
+    FAST_BASE64_KERNEL_AVX2,
+} fast_base64_kernel_t;
+
+/**
+ * Number of characters fast_base64_encode() writes for len input bytes (padding included, no NUL)
+ */
+static inline size_t fast_base64_encoded_len(size_t len)
+{
+    return ((len + 2) / 3) * 4;
+}
+
+/**
+ * Upper bound on the bytes fast_base64_decode() writes for len input characters
+ */
+static inline size_t fast_base64_decoded_max(size_t len)
+{
+    return (len / 4) * 3 + 3;
+}
+
+/**
+ * @brief Encode bytes as standard base64 with '=' padding
+ * @param dst: Output, at least fast_base64_encoded_len(len) bytes; not NUL-terminated
+ * @param src: Input bytes
+ * @param len: Input length
+ * @return Number of characters written
+ */
+size_t fast_base64_encode(char *dst, const uint8_t *src, size_t len);
+
+/**
+ * @brief Decode standard base64
+ * The input must be whole 4-character groups with '=' padding only in the last
+ * group; whitespace and any other character are rejected. Output is identical to
+ * mbedtls_base64_decode() for valid input.
+ * @param dst: Output buffer
+ * @param dst_cap: Output capacity in bytes
+ * @param out_len: Set to the number of decoded bytes
+ * @param src: Base64 characters
+ * @param len: Number of characters
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on malformed input,
+ *         ESP_ERR_INVALID_SIZE if dst_cap is too small
+ */
+esp_err_t fast_base64_decode(uint8_t *dst, size_t dst_cap, size_t *out_len, const char *src, size_t len);
+
+/**
+ * @brief Force a kernel (benchmarks and tests)
+ * @param kernel: Requested kernel; unsupported kernels fall back to the next best one
+ * @return Kernel now in use
+ */
+fast_base64_kernel_t fast_base64_select_kernel(fast_base64_kernel_t kernel);
+
+/**
+ * @brief Name of a kernel for logs
+ */
+const char *fast_base64_kernel_name(fast_base64_kernel_t kernel);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,163 @@
+/**
+ * @file test_fast_base64.c
+ * @brief Byte-exact tests of fast_base64 against mbedtls_base64
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/base64.h"
+#include "fast_base64.h"
+
+static const char *TAG = "test_fast_base64";
+
+#define MAX_LEN 1024
+
+static uint8_t *s_src;
+static uint8_t *s_decoded;
+static char *s_encoded;
+static unsigned char *s_reference;
+
+static const fast_base64_kernel_t KERNELS[] = {
+    FAST_BASE64_KERNEL_SCALAR,
+    FAST_BASE64_KERNEL_SSSE3,
+    FAST_BASE64_KERNEL_AVX2,
+};
+
+void setUp(void)
+{
+    s_src = malloc(MAX_LEN);
+    s_decoded = malloc(MAX_LEN + 3);
+    s_encoded = malloc(fast_base64_encoded_len(MAX_LEN) + 1);
+    s_reference = malloc(fast_base64_encoded_len(MAX_LEN) + 1);
+    TEST_ASSERT_NOT_NULL(s_src);
+    TEST_ASSERT_NOT_NULL(s_decoded);
+    TEST_ASSERT_NOT_NULL(s_encoded);
+    TEST_ASSERT_NOT_NULL(s_reference);
+    srand(1234);
+    for (size_t i = 0; i < MAX_LEN; i++) {
+        s_src[i] = (uint8_t)rand();
+    }
+}
+
+void tearDown(void)
+{
+    fast_base64_select_kernel(FAST_BASE64_KERNEL_AUTO);
+    free(s_src);
+    free(s_decoded);
+    free(s_encoded);
+    free(s_reference);
+}
+
+/**
+ * @brief Encoding matches mbedtls for every length and every kernel
+ */
+void test_encode_matches_mbedtls(void)
+{
+    for (size_t k = 0; k < sizeof(KERNELS) / sizeof(KERNELS[0]); k++) {
+        fast_base64_kernel_t kernel = fast_base64_select_kernel(KERNELS[k]);
+        ESP_LOGI(TAG, "Encode, kernel %s", fast_base64_kernel_name(kernel));
+        for (size_t len = 0; len <= MAX_LEN; len++) {
+            size_t ref_len = 0;
+            TEST_ASSERT_EQUAL(0, mbedtls_base64_encode(s_reference, fast_base64_encoded_len(MAX_LEN) + 1,
+                                                       &ref_len, s_src, len));
+            size_t n = fast_base64_encode(s_encoded, s_src, len);
+            TEST_ASSERT_EQUAL(ref_len, n);
+            TEST_ASSERT_EQUAL_MEMORY(s_reference, s_encoded, n);
+        }
+    }
+}
+
+/**
+ * @brief Decoding round-trips and matches mbedtls for every length and every kernel
+ */
+void test_decode_matches_mbedtls(void)
+{
+    for (size_t k = 0; k < sizeof(KERNELS) / sizeof(KERNELS[0]); k++) {
+        fast_base64_kernel_t kernel = fast_base64_select_kernel(KERNELS[k]);
+        ESP_LOGI(TAG, "Decode, kernel %s", fast_base64_kernel_name(kernel));
+        for (size_t len = 0; len <= MAX_LEN; len++) {
+            size_t chars = fast_base64_encode(s_encoded, s_src, len);
+
+            size_t ref_len = 0;
+            TEST_ASSERT_EQUAL(0, mbedtls_base64_decode(s_reference, MAX_LEN, &ref_len,
+                                                       (const unsigned char *)s_encoded, chars));
+            size_t out_len = 0;
+            // Exact capacity: the vector kernels must not write past the decoded length
+            memset(s_decoded, 0xa5, MAX_LEN + 3);
+            TEST_ASSERT_EQUAL(ESP_OK, fast_base64_decode(s_decoded, len, &out_len, s_encoded, chars));
+            TEST_ASSERT_EQUAL(ref_len, out_len);
+            TEST_ASSERT_EQUAL_MEMORY(s_reference, s_decoded, out_len);
+            TEST_ASSERT_EQUAL_MEMORY(s_src, s_decoded, len);
+            TEST_ASSERT_EACH_EQUAL_HEX8(0xa5, s_decoded + len, 3);
+        }
+    }
+}
+
+/**
+ * @brief Malformed input is rejected where mbedtls rejects it
+ */
+void test_decode_rejects_invalid(void)
+{
+    size_t chars = fast_base64_encode(s_encoded, s_src, 300);
+    for (size_t k = 0; k < sizeof(KERNELS) / sizeof(KERNELS[0]); k++) {
+        fast_base64_select_kernel(KERNELS[k]);
+        size_t out_len;
+
+        // Invalid character at every position, so each kernel and the tail path see one
+        for (size_t pos = 0; pos < chars; pos++) {
+            char saved = s_encoded[pos];
+            s_encoded[pos] = '*';
+            TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, fast_base64_decode(s_decoded, MAX_LEN, &out_len, s_encoded, chars));
+            s_encoded[pos] = saved;
+        }
+
+        // High-bit bytes must not alias a table entry
+        char saved = s_encoded[5];
+        s_encoded[5] = (char)0xc1;
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, fast_base64_decode(s_decoded, MAX_LEN, &out_len, s_encoded, chars));
+        s_encoded[5] = saved;
+
+        // Padding before the last group
+        saved = s_encoded[7];
+        s_encoded[7] = '=';
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, fast_base64_decode(s_decoded, MAX_LEN, &out_len, s_encoded, chars));
+        s_encoded[7] = saved;
+
+        // Incomplete group
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, fast_base64_decode(s_decoded, MAX_LEN, &out_len, s_encoded, chars - 1));
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, fast_base64_decode(s_decoded, MAX_LEN, &out_len, "QQ=", 3));
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, fast_base64_decode(s_decoded, MAX_LEN, &out_len, "Q===", 4));
+
+        // Output too small
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, fast_base64_decode(s_decoded, 299, &out_len, s_encoded, chars));
+    }
+}
+
+void app_main(void)
+{
+    // Wait a bit for serial output to initialize
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    ESP_LOGI(TAG, "\n\n=== fast_base64 Unit Tests ===\n");
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_encode_matches_mbedtls);
+    RUN_TEST(test_decode_matches_mbedtls);
+    RUN_TEST(test_decode_rejects_invalid);
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "\n=== All fast_base64 Tests Complete ===\n");
+
+    // Keep running so we can see results
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
@@ -7,10 +7,16 @@
 #include "esp_crt_bundle.h"
 #endif
 #include "esp_heap_caps.h"
-#include "tls_mutex.h"
+#include "net_scheduler.h"
+#include "gemini_prewarm.h"
+#include "gzip_stream.h"
+#include "gemini_json.h"
+#include "gemini_segbuf.h"
 #include "cJSON.h"
-#include "mbedtls/base64.h"
+#include "fast_base64.h"
+#include "streaming_base64.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include <ctype.h>
@@ -20,14 +26,44 @@ static const char *TAG = "gemini_api";
 
 static gemini_config_t s_config = {0};
 static bool s_initialized = false;
+static const char *s_system_instruction = NULL;  // Caller-owned, see gemini_api_set_system_instruction()
 
 // HTTP response buffer
 typedef struct {
-    uint8_t *data;
-    size_t len;
-    size_t cap;
+    seg_buf_t body;       // Decoded body, grown block by block as it arrives
+    gzip_stream_t *gzip;  // Set while inflating a Content-Encoding: gzip body
+    int status;           // HTTP status of the last request, 0 if none completed
 } http_buffer_t;
 
+// Append (already decoded) response bytes to the segmented response body
+static esp_err_t http_buffer_append(const uint8_t *data, size_t len, void *ctx)
+{
+    http_buffer_t *buf = (http_buffer_t *)ctx;
+    return seg_buf_append(&buf->body, data, len);
+}
+
+// Parse the response body as JSON and release it
+static cJSON *http_buffer_take_json(http_buffer_t *buf)
+{
+    char *text = seg_buf_flatten(&buf->body);
+    seg_buf_free(&buf->body);
+    if (!text) {
+        return NULL;
+    }
+    cJSON *json = cJSON_Parse(text);
+    free(text);
+    return json;
+}
+
+// Log the start of a response body (error details, unexpected payloads)
+static void http_buffer_log_head(const http_buffer_t *buf, const char *what)
+{
+    char head[201];
+    if (seg_buf_copy(&buf->body, 0, head, sizeof(head)) > 0) {
+        ESP_LOGE(TAG, "%s (len=%zu, first 200 chars): %s", what, buf->body.len, head);
+    }
+}
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
     http_buffer_t *buf = (http_buffer_t *)evt->user_data;
@@ -44,23 +80,18 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
             break;
         case HTTP_EVENT_ON_HEADER:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            if (buf) {
+                return gzip_stream_handle_header(&buf->gzip, evt->header_key, evt->header_value,
+                                                 http_buffer_append, buf);
+            }
             break;
         case HTTP_EVENT_ON_DATA:
-            if (evt->data_len == 0) {
-                break;
-            }
-            // Check if buffer would overflow (leave 1 byte for null terminator)
-            if (buf->len + evt->data_len >= buf->cap) {
-                // Don't log in interrupt handler - it blocks the main task from watchdog
-                // Pre-allocated buffer should be sufficient for Gemini API responses
-                ESP_LOGW(TAG, "Response buffer overflow: len=%zu, adding=%zu, cap=%zu", 
-                         buf->len, evt->data_len, buf->cap);
-                return ESP_ERR_NO_MEM;
+            if (evt->data_len == 0 || !buf) {
+                break;  // No buffer attached (e.g. pre-connect HEAD request)
             }
-            // Copy data to buffer (safe, no realloc needed)
-            memcpy(buf->data + buf->len, evt->data, evt->data_len);
-            buf->len += evt->data_len;
-            break;
+            // Compressed bodies are inflated chunk by chunk straight into the buffer
+            return gzip_stream_handle_data(buf->gzip, (const uint8_t *)evt->data, evt->data_len,
+                                           http_buffer_append, buf);
         case HTTP_EVENT_ON_FINISH:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_FINISH");
             break;
@@ -154,12 +185,7 @@ static esp_err_t base64_encode_alloc(const uint8_t *input, size_t input_len, cha
         return ESP_ERR_NO_MEM;
     }
     
-    size_t written = 0;
-    int ret = mbedtls_base64_encode((unsigned char *)encoded, target_len, &written, input, input_len);
-    if (ret != 0) {
-        free(encoded);
-        return ESP_FAIL;
-    }
+    size_t written = fast_base64_encode(encoded, input, input_len);
     encoded[written] = '\0';
     *out_str = encoded;
     return ESP_OK;
@@ -168,58 +194,6 @@ static esp_err_t base64_encode_alloc(const uint8_t *input, size_t input_len, cha
 // HTTP POST request helper with proper response handling
 static esp_err_t http_post_json_with_auth(const char *url, const char *json_data, const char *auth_header, http_buffer_t *response)
 {
-    // Determine buffer size based on API endpoint
-    // TTS responses are base64-encoded (35-50KB raw response, ~26-37KB after base64 decode)
-    // LLM responses are JSON text (~20-40KB)
-    // Optimized: Use PSRAM for all large buffers to preserve internal RAM for TLS
-    size_t RESPONSE_BUFFER_SIZE = 96 * 1024;  // Reduced to 96KB for LLM (PSRAM)
-
-    // Check if this is a TTS request (use large buffer)
-    if (strstr(url, "texttospeech") != NULL) {
-        RESPONSE_BUFFER_SIZE = 192 * 1024;  // TTS: 192KB (reduced, use PSRAM)
-    }
-
-    if (!response->data) {
-        // Always prefer PSRAM for response buffers (>32KB) to preserve internal RAM for TLS
-        // TLS connections need internal RAM for SHA buffers and SSL contexts
-        if (RESPONSE_BUFFER_SIZE > 32 * 1024) {
-            response->data = heap_caps_malloc(RESPONSE_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (!response->data) {
-                ESP_LOGW(TAG, "PSRAM allocation failed, trying internal RAM");
-                response->data = heap_caps_malloc(RESPONSE_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-            }
-        } else {
-            // Small buffers can use regular malloc (will prefer PSRAM if SPIRAM_USE_MALLOC=y)
-            response->data = malloc(RESPONSE_BUFFER_SIZE);
-        }
-        
-        if (!response->data) {
-            // If allocation fails, try smaller buffer (32KB)
-            const size_t FALLBACK_SIZE = 32 * 1024;
-            ESP_LOGW(TAG, "Primary allocation (%zu bytes) failed, trying fallback (32KB)", RESPONSE_BUFFER_SIZE);
-            response->data = malloc(FALLBACK_SIZE);
-            if (!response->data) {
-                // Last resort: 24KB minimum buffer
-                const size_t MINIMUM_SIZE = 24 * 1024;
-                ESP_LOGW(TAG, "Fallback allocation (32KB) failed, trying minimum (24KB)");
-                response->data = malloc(MINIMUM_SIZE);
-                if (!response->data) {
-                    ESP_LOGE(TAG, "Failed to allocate even 24KB response buffer");
-                    return ESP_ERR_NO_MEM;
-                }
-                response->cap = MINIMUM_SIZE;
-            } else {
-                response->cap = FALLBACK_SIZE;
-                ESP_LOGI(TAG, "Using fallback buffer: %zu bytes", FALLBACK_SIZE);
-            }
-        } else {
-            response->cap = RESPONSE_BUFFER_SIZE;
-            ESP_LOGI(TAG, "Successfully allocated %zu byte response buffer", RESPONSE_BUFFER_SIZE);
-        }
-        response->len = 0;
-        ESP_LOGD(TAG, "Allocated response buffer: %zu bytes", response->cap);
-    }
-
     // TODO: Re-enable certificate verification once certificate bundle issue is resolved
     // Currently skipping due to PK verify errors (0x4290) - certificate signature verification failing
     // This is a temporary workaround for development
@@ -241,26 +215,37 @@ static esp_err_t http_post_json_with_auth(const char *url, const char *json_data
         .disable_auto_redirect = false,
     };
     
-    // Acquire TLS mutex to serialize TLS connections
-    // This prevents concurrent TLS connections that cause memory allocation errors
-    esp_err_t mutex_err = tls_mutex_take(pdMS_TO_TICKS(10000));  // 10 second timeout
-    if (mutex_err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to acquire TLS mutex: %s", esp_err_to_name(mutex_err));
-        return ESP_ERR_TIMEOUT;
-    }
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        tls_mutex_give();  // Release mutex on error
-        return ESP_FAIL;
+    // Reuse a connection opened speculatively on wake word if one is parked for this host
+    net_session_t session;
+    esp_http_client_handle_t client = gemini_prewarm_claim(url, &session);
+    if (client) {
+        esp_http_client_set_url(client, url);
+        esp_http_client_set_user_data(client, response);
+    } else {
+        // Wait for the network scheduler to admit a TLS session. The request class
+        // comes from the calling task (voice turn by default, weather for the
+        // environmental report), so background callers queue behind voice.
+        esp_err_t sched_err = net_scheduler_acquire(NET_PRIO_TASK_DEFAULT, pdMS_TO_TICKS(10000), &session);
+        if (sched_err != ESP_OK) {
+            ESP_LOGE(TAG, "No TLS session admitted: %s", esp_err_to_name(sched_err));
+            return ESP_ERR_TIMEOUT;
+        }
+        
+        client = esp_http_client_init(&config);
+        if (!client) {
+            ESP_LOGE(TAG, "Failed to initialize HTTP client");
+            net_scheduler_release(&session);
+            return ESP_FAIL;
+        }
     }
     
     // Set headers
     esp_http_client_set_method(client, HTTP_METHOD_POST);
     esp_http_client_set_header(client, "Content-Type", "application/json");
-    // Note: Don't set Accept-Encoding headers - let server decide
-    // ESP32's HTTP client has automatic gzip decompression support
+    // Ask for a gzip body (JSON compresses 3-6x); the event handler inflates it as it
+    // arrives. Google APIs only compress when the User-Agent also contains "gzip".
+    esp_http_client_set_header(client, "Accept-Encoding", "gzip");
+    esp_http_client_set_header(client, "User-Agent", "Naphome-Korvo1 (gzip)");
     if (auth_header) {
         esp_http_client_set_header(client, "Authorization", auth_header);
     }
@@ -274,13 +259,20 @@ static esp_err_t http_post_json_with_auth(const char *url, const char *json_data
     int64_t elapsed_us = esp_timer_get_time() - start_time;
 
     int status_code = esp_http_client_get_status_code(client);
-    ESP_LOGI(TAG, "HTTP response: %d (took %lld ms), response buffer: len=%zu, data=%p",
-             status_code, elapsed_us / 1000, response->len, response->data);
+    response->status = status_code;
+    ESP_LOGI(TAG, "HTTP response: %d (took %" PRId64 " ms), body: %zu bytes in %zu blocks",
+             status_code, elapsed_us / 1000, response->body.len, response->body.blocks);
+
+    // A truncated body or a CRC/length mismatch in the gzip trailer fails the request
+    esp_err_t gz_err = gzip_stream_close(&response->gzip);
+    if (gz_err != ESP_OK && err == ESP_OK) {
+        err = gz_err;
+    }
 
     esp_http_client_cleanup(client);
     
-    // Release TLS mutex after connection is complete
-    tls_mutex_give();
+    // Release the session after cleanup so its TLS memory is already returned
+    net_scheduler_release(&session);
 
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP POST failed: %s", esp_err_to_name(err));
@@ -295,6 +287,134 @@ static esp_err_t http_post_json_with_auth(const char *url, const char *json_data
     return ESP_OK;
 }
 
+// Append `"systemInstruction":{...},` when a system instruction is configured
+static void json_buf_system_instruction(json_buf_t *jb)
+{
+    if (s_system_instruction && s_system_instruction[0] != '\0') {
+        json_buf_raw(jb, "\"systemInstruction\":{\"parts\":[{\"text\":");
+        json_buf_string(jb, s_system_instruction);
+        json_buf_raw(jb, "}]},");
+    }
+}
+
+#ifdef CONFIG_GEMINI_CONTEXT_CACHE_ENABLED
+// Refresh this long before the server-side expiry so a request never races it
+#define CONTEXT_CACHE_MARGIN_US     (60LL * 1000000)
+// Back-off after a transient failure to create the cache
+#define CONTEXT_CACHE_RETRY_US      (10LL * 60 * 1000000)
+
+typedef struct {
+    char name[128];          // "cachedContents/<id>", empty when no cache is live
+    uint32_t key;            // Hash of the model, system instruction and tools it holds
+    int64_t expires_us;
+    int64_t retry_after_us;  // Don't try to create before this time
+} context_cache_t;
+
+static context_cache_t s_context_cache = {0};
+
+static uint32_t fnv1a(uint32_t hash, const char *s)
+{
+    for (; s && *s; s++) {
+        hash = (hash ^ (uint8_t)*s) * 16777619u;
+    }
+    return hash ^ 0xff;  // Separator so ("ab","c") and ("a","bc") differ
+}
+
+static uint32_t context_cache_key(const char *tools_json)
+{
+    uint32_t hash = 2166136261u;
+    hash = fnv1a(hash, s_config.model);
+    hash = fnv1a(hash, s_system_instruction);
+    return fnv1a(hash, tools_json);
+}
+
+// Upload the system instruction and tools as a cachedContents resource
+static esp_err_t context_cache_create(const char *tools_json, uint32_t key)
+{
+    char ttl[16];
+    snprintf(ttl, sizeof(ttl), "%ds", CONFIG_GEMINI_CONTEXT_CACHE_TTL_S);
+
+    json_buf_t jb = {0};
+    json_buf_raw(&jb, "{\"model\":\"models/");
+    json_buf_raw(&jb, s_config.model);
+    json_buf_raw(&jb, "\",\"ttl\":\"");
+    json_buf_raw(&jb, ttl);
+    json_buf_raw(&jb, "\",");
+    json_buf_system_instruction(&jb);
+    json_buf_raw(&jb, "\"tools\":[");
+    json_buf_raw(&jb, tools_json);
+    json_buf_raw(&jb, "]}");
+    char *payload = json_buf_finish(&jb);
+    if (!payload) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    char url[256];
+    snprintf(url, sizeof(url),
+             "https://generativelanguage.googleapis.com/v1beta/cachedContents?key=%s",
+             s_config.api_key);
+
+    http_buffer_t http_response = {0};
+    esp_err_t ret = http_post_json_with_auth(url, payload, NULL, &http_response);
+    free(payload);
+
+    int64_t now = esp_timer_get_time();
+    s_context_cache.key = key;  // Back-off below applies to this content
+    if (ret != ESP_OK) {
+        // 4xx means the content is rejected as such (below the model's minimum cacheable
+        // token count, or caching unsupported for this model): don't retry this session
+        bool permanent = http_response.status / 100 == 4 && http_response.status != 429;
+        s_context_cache.retry_after_us = permanent ? INT64_MAX : now + CONTEXT_CACHE_RETRY_US;
+        ESP_LOGW(TAG, "Context cache not created (HTTP %d), sending tools inline%s",
+                 http_response.status, permanent ? " for this session" : "");
+        seg_buf_free(&http_response.body);
+        return ret;
+    }
+
+    cJSON *response_json = http_buffer_take_json(&http_response);
+
+    cJSON *name = response_json ? cJSON_GetObjectItem(response_json, "name") : NULL;
+    if (!name || !cJSON_IsString(name) || strlen(name->valuestring) >= sizeof(s_context_cache.name)) {
+        ESP_LOGE(TAG, "Context cache response has no usable name");
+        cJSON_Delete(response_json);
+        s_context_cache.retry_after_us = now + CONTEXT_CACHE_RETRY_US;
+        return ESP_FAIL;
+    }
+
+    strcpy(s_context_cache.name, name->valuestring);
+    s_context_cache.expires_us = now + (int64_t)CONFIG_GEMINI_CONTEXT_CACHE_TTL_S * 1000000;
+    cJSON_Delete(response_json);
+    ESP_LOGI(TAG, "Context cache %s created (ttl %s)", s_context_cache.name, ttl);
+    return ESP_OK;
+}
+
+// Name of a live cache holding exactly these tools, creating it if needed; NULL to send inline
+static const char *context_cache_get(const char *tools_json)
+{
+    uint32_t key = context_cache_key(tools_json);
+    int64_t now = esp_timer_get_time();
+
+    if (s_context_cache.name[0] != '\0' && s_context_cache.key == key &&
+        now < s_context_cache.expires_us - CONTEXT_CACHE_MARGIN_US) {
+        return s_context_cache.name;
+    }
+
+    if (s_context_cache.key != key) {
+        s_context_cache.retry_after_us = 0;  // Different content, previous failure doesn't apply
+    }
+    s_context_cache.name[0] = '\0';
+    if (now < s_context_cache.retry_after_us) {
+        return NULL;
+    }
+    return context_cache_create(tools_json, key) == ESP_OK ? s_context_cache.name : NULL;
+}
+
+static void context_cache_invalidate(void)
+{
+    s_context_cache.name[0] = '\0';
+}
+#endif // CONFIG_GEMINI_CONTEXT_CACHE_ENABLED
+
 esp_err_t gemini_api_init(const gemini_config_t *config)
 {
     if (!config || strlen(config->api_key) == 0) {
@@ -407,30 +527,20 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(ret));
-        if (response.data) {
-            ESP_LOGE(TAG, "Response data (first 200 chars): %.200s", (const char *)response.data);
-            free(response.data);
-        }
+        http_buffer_log_head(&response, "Response data");
+        seg_buf_free(&response.body);
         return ret;
     }
     
     // Parse response
-    if (!response.data || response.len == 0) {
+    if (response.body.len == 0) {
         ESP_LOGE(TAG, "Empty response from STT API");
-        if (response.data) free(response.data);
         return ESP_FAIL;
     }
     
-    response.data = realloc(response.data, response.len + 1);
-    response.data[response.len] = '\0';
-    
-    ESP_LOGD(TAG, "STT API response (len=%zu, first 500 chars): %.500s", response.len, (const char *)response.data);
-    
-    cJSON *response_json = cJSON_Parse((char *)response.data);
+    cJSON *response_json = http_buffer_take_json(&response);
     if (!response_json) {
-        ESP_LOGE(TAG, "Failed to parse JSON response (len=%zu, first 200 chars: %.200s)", 
-                 response.len, (const char *)response.data);
-        free(response.data);
+        ESP_LOGE(TAG, "Failed to parse STT JSON response");
         return ESP_FAIL;
     }
     
@@ -443,7 +553,6 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
                  error_code ? error_code->valueint : -1,
                  error_message ? error_message->valuestring : "unknown");
         cJSON_Delete(response_json);
-        free(response.data);
         return ESP_FAIL;
     }
     
@@ -452,14 +561,12 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     if (!results) {
         ESP_LOGE(TAG, "No 'results' field in STT response");
         cJSON_Delete(response_json);
-        free(response.data);
         return ESP_FAIL;
     }
     
     if (!cJSON_IsArray(results)) {
         ESP_LOGE(TAG, "'results' is not an array");
         cJSON_Delete(response_json);
-        free(response.data);
         return ESP_FAIL;
     }
     
@@ -469,7 +576,6 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     if (results_size == 0) {
         ESP_LOGW(TAG, "⚠️  STT returned no results - audio may be silence or unrecognized");
         cJSON_Delete(response_json);
-        free(response.data);
         // Return empty string instead of failure - this is a valid case (silence)
         text_out[0] = '\0';
         return ESP_OK;
@@ -479,7 +585,6 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     if (!result) {
         ESP_LOGE(TAG, "Failed to get first result");
         cJSON_Delete(response_json);
-        free(response.data);
         return ESP_FAIL;
     }
     
@@ -487,7 +592,6 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     if (!alternatives || !cJSON_IsArray(alternatives)) {
         ESP_LOGE(TAG, "No 'alternatives' array in result");
         cJSON_Delete(response_json);
-        free(response.data);
         return ESP_FAIL;
     }
     
@@ -495,7 +599,6 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     if (alt_size == 0) {
         ESP_LOGW(TAG, "No alternatives in result");
         cJSON_Delete(response_json);
-        free(response.data);
         text_out[0] = '\0';
         return ESP_OK;
     }
@@ -504,7 +607,6 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     if (!alt) {
         ESP_LOGE(TAG, "Failed to get first alternative");
         cJSON_Delete(response_json);
-        free(response.data);
         return ESP_FAIL;
     }
     
@@ -512,14 +614,12 @@ esp_err_t gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out
     if (!transcript || !cJSON_IsString(transcript)) {
         ESP_LOGE(TAG, "No 'transcript' string in alternative");
         cJSON_Delete(response_json);
-        free(response.data);
         return ESP_FAIL;
     }
     
     strncpy(text_out, transcript->valuestring, text_len - 1);
     text_out[text_len - 1] = '\0';
     cJSON_Delete(response_json);
-    free(response.data);
     ESP_LOGI(TAG, "✅ [Gemini STT] Success: \"%s\"", text_out);
     return ESP_OK;
 }
@@ -572,22 +672,17 @@ esp_err_t gemini_llm(const char *prompt, char *response, size_t response_len)
     free(payload);
     
     if (ret != ESP_OK) {
-        if (http_response.data) free(http_response.data);
+        seg_buf_free(&http_response.body);
         return ret;
     }
     
     // Parse response
-    if (!http_response.data || http_response.len == 0) {
+    if (http_response.body.len == 0) {
         ESP_LOGE(TAG, "Empty response");
-        if (http_response.data) free(http_response.data);
         return ESP_FAIL;
     }
     
-    http_response.data = realloc(http_response.data, http_response.len + 1);
-    http_response.data[http_response.len] = '\0';
-    
-    cJSON *response_json = cJSON_Parse((char *)http_response.data);
-    free(http_response.data);
+    cJSON *response_json = http_buffer_take_json(&http_response);
     
     if (!response_json) {
         ESP_LOGE(TAG, "Failed to parse JSON response");
@@ -628,6 +723,13 @@ esp_err_t gemini_llm(const char *prompt, char *response, size_t response_len)
 esp_err_t gemini_llm_with_functions(const char *prompt, const char *tools_json,
                                      char *response, size_t response_len,
                                      gemini_function_call_t *function_call)
+{
+    return gemini_llm_converse(NULL, prompt, tools_json, response, response_len, function_call);
+}
+
+esp_err_t gemini_llm_converse(gemini_conversation_t *conversation, const char *prompt, const char *tools_json,
+                              char *response, size_t response_len,
+                              gemini_function_call_t *function_call)
 {
     if (!s_initialized) {
         return ESP_ERR_INVALID_STATE;
@@ -642,39 +744,18 @@ esp_err_t gemini_llm_with_functions(const char *prompt, const char *tools_json,
         memset(function_call, 0, sizeof(gemini_function_call_t));
     }
     
-    ESP_LOGI(TAG, "💬 [Gemini LLM] Generating response with functions: \"%.100s%s\"", 
-             prompt, strlen(prompt) > 100 ? "..." : "");
-    
-    // Build JSON request for Gemini API
-    cJSON *root = cJSON_CreateObject();
-    cJSON *contents = cJSON_CreateArray();
-    cJSON *content = cJSON_CreateObject();
-    cJSON *parts = cJSON_CreateArray();
-    cJSON *part = cJSON_CreateObject();
-    
-    cJSON_AddItemToObject(root, "contents", contents);
-    cJSON_AddItemToArray(contents, content);
-    cJSON_AddItemToObject(content, "parts", parts);
-    cJSON_AddItemToArray(parts, part);
-    cJSON_AddStringToObject(part, "text", prompt);
-    
-    // Add tools if provided
-    if (tools_json && strlen(tools_json) > 0) {
-        cJSON *tools = cJSON_Parse(tools_json);
-        if (tools) {
-            cJSON_AddItemToObject(root, "tools", tools);
-            ESP_LOGI(TAG, "Added function definitions to request");
-        } else {
-            ESP_LOGW(TAG, "Failed to parse tools_json, continuing without functions");
-        }
-    }
+    ESP_LOGI(TAG, "💬 [Gemini LLM] Generating response with functions: \"%.100s%s\" (%zu prior turns)", 
+             prompt, strlen(prompt) > 100 ? "..." : "", gemini_conversation_turn_count(conversation));
     
-    char *payload = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    if (!payload) {
-        ESP_LOGE(TAG, "Failed to create JSON payload");
-        return ESP_ERR_NO_MEM;
+    bool has_tools = tools_json && strlen(tools_json) > 0;
+    const char *cached_content = NULL;
+#ifdef CONFIG_GEMINI_CONTEXT_CACHE_ENABLED
+    // The tool schema and system instruction are identical on every turn; reference
+    // them by cache name instead of uploading them with each request
+    if (has_tools) {
+        cached_content = context_cache_get(tools_json);
     }
+#endif
     
     // Gemini API endpoint
     char url[512];
@@ -682,31 +763,67 @@ esp_err_t gemini_llm_with_functions(const char *prompt, const char *tools_json,
              "https://generativelanguage.googleapis.com/v1beta/models/%s:generateContent?key=%s",
              s_config.model, s_config.api_key);
     
-    // Perform HTTP request
     http_buffer_t http_response = {0};
-    char auth_header[256];
-    snprintf(auth_header, sizeof(auth_header), "X-Goog-Api-Key: %s", s_config.api_key);
-    
-    esp_err_t ret = http_post_json_with_auth(url, payload, NULL, &http_response);
-    free(payload);
+    esp_err_t ret;
+    while (true) {
+        // Build the request body directly; tools_json is already serialized JSON
+        json_buf_t jb = {0};
+        json_buf_raw(&jb, "{");
+        if (cached_content) {
+            json_buf_raw(&jb, "\"cachedContent\":");
+            json_buf_string(&jb, cached_content);
+            json_buf_raw(&jb, ",");
+        } else {
+            json_buf_system_instruction(&jb);
+            if (has_tools) {
+                json_buf_raw(&jb, "\"tools\":[");
+                json_buf_raw(&jb, tools_json);
+                json_buf_raw(&jb, "],");
+            }
+        }
+        // Prior turns go straight from the history arena into the body
+        json_buf_raw(&jb, "\"contents\":[");
+        gemini_conversation_write_contents(conversation, &jb);
+        json_buf_raw(&jb, "{\"role\":\"user\",\"parts\":[{\"text\":");
+        json_buf_string(&jb, prompt);
+        json_buf_raw(&jb, "}]}]}");
+        char *payload = json_buf_finish(&jb);
+        if (!payload) {
+            ESP_LOGE(TAG, "Failed to create JSON payload");
+            return ESP_ERR_NO_MEM;
+        }
+        
+        ret = http_post_json_with_auth(url, payload, NULL, &http_response);
+        free(payload);
+        
+#ifdef CONFIG_GEMINI_CONTEXT_CACHE_ENABLED
+        // A cache deleted or expired server-side is reported as 400/403/404: drop it
+        // and resend this turn with the tools inline; the next turn recreates it
+        int status = http_response.status;
+        if (ret != ESP_OK && cached_content && (status == 400 || status == 403 || status == 404)) {
+            ESP_LOGW(TAG, "Context cache %s rejected (HTTP %d), retrying inline", cached_content, status);
+            context_cache_invalidate();
+            cached_content = NULL;
+            seg_buf_free(&http_response.body);
+            memset(&http_response, 0, sizeof(http_response));
+            continue;
+        }
+#endif
+        break;
+    }
     
     if (ret != ESP_OK) {
-        if (http_response.data) free(http_response.data);
+        seg_buf_free(&http_response.body);
         return ret;
     }
     
     // Parse response
-    if (!http_response.data || http_response.len == 0) {
+    if (http_response.body.len == 0) {
         ESP_LOGE(TAG, "Empty response");
-        if (http_response.data) free(http_response.data);
         return ESP_FAIL;
     }
     
-    http_response.data = realloc(http_response.data, http_response.len + 1);
-    http_response.data[http_response.len] = '\0';
-    
-    cJSON *response_json = cJSON_Parse((char *)http_response.data);
-    free(http_response.data);
+    cJSON *response_json = http_buffer_take_json(&http_response);
     
     if (!response_json) {
         ESP_LOGE(TAG, "Failed to parse JSON response");
@@ -773,6 +890,151 @@ esp_err_t gemini_llm_with_functions(const char *prompt, const char *tools_json,
     return ESP_FAIL;
 }
 
+/**
+ * Locate the "audioContent" base64 string of a TTS response in place
+ * @param body: Response body
+ * @param start: Set to the first character of the string value
+ * @param raw_len: Set to the length of the string value as sent (escapes included)
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if the body has no audioContent string
+ */
+static esp_err_t tts_find_audio_content(const seg_buf_t *body, seg_cursor_t *start, size_t *raw_len)
+{
+    seg_cursor_t cur;
+    seg_cursor_init(&cur, body);
+    if (!seg_cursor_find(&cur, "\"audioContent\"")) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    int c;
+    while ((c = seg_cursor_next(&cur)) == ' ' || c == '\t' || c == '\r' || c == '\n') {
+    }
+    if (c != ':') {
+        return ESP_ERR_NOT_FOUND;
+    }
+    while ((c = seg_cursor_next(&cur)) == ' ' || c == '\t' || c == '\r' || c == '\n') {
+    }
+    if (c != '"') {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *start = cur;
+
+    // Base64 never contains a quote, so the first one closes the string
+    if (!seg_cursor_find(&cur, "\"")) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *raw_len = cur.pos - start->pos - 1;
+    return ESP_OK;
+}
+
+// Value of a hex digit, -1 if `c` is not one
+static int hex_digit_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+/**
+ * Decode a base64 string straight out of the response blocks
+ * Runs between JSON escapes are fed to the streaming decoder in place. "\/" and
+ * a "\uXXXX" naming a base64 character keep that character; any other escape
+ * (line breaks some encoders insert) is dropped.
+ * @param cur: Cursor at the first character (from tts_find_audio_content)
+ * @param raw_len: String length as sent
+ * @param out: Output buffer
+ * @param out_cap: Output capacity in bytes
+ * @param out_len: Set to the number of decoded bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if out is too small, ESP_FAIL on malformed base64
+ */
+static esp_err_t tts_decode_audio_content(seg_cursor_t *cur, size_t raw_len,
+                                          uint8_t *out, size_t out_cap, size_t *out_len)
+{
+    streaming_base64_decoder_t dec;
+    streaming_base64_decoder_init(&dec);
+    size_t written = 0;
+    int escape = 0;          // 1 after a backslash, 2..5 while reading the hex digits of \uXXXX
+    uint32_t code = 0;       // Code point of a \uXXXX escape
+    uint8_t unescaped;
+
+    while (raw_len > 0) {
+        const uint8_t *data;
+        size_t span = seg_cursor_span(cur, &data);
+        if (span == 0) {
+            break;
+        }
+        if (span > raw_len) {
+            span = raw_len;
+        }
+        seg_cursor_advance(cur, span);
+        raw_len -= span;
+
+        // Escapes may straddle block boundaries, so their state carries across spans
+        const uint8_t *end = data + span;
+        while (data < end) {
+            const uint8_t *run;
+            size_t run_len;
+            if (escape == 1) {
+                uint8_t c = *data++;
+                if (c == 'u') {
+                    escape = 2;
+                    code = 0;
+                    continue;
+                }
+                escape = 0;
+                if (c != '/') {
+                    continue;
+                }
+                unescaped = c;
+                run = &unescaped;
+                run_len = 1;
+            } else if (escape > 1) {
+                int digit = hex_digit_value(*data++);
+                if (digit < 0) {
+                    return ESP_FAIL;
+                }
+                code = (code << 4) | (uint32_t)digit;
+                if (++escape < 6) {
+                    continue;
+                }
+                escape = 0;
+                bool base64_char = (code >= 'A' && code <= 'Z') || (code >= 'a' && code <= 'z') ||
+                                   (code >= '0' && code <= '9') || code == '+' || code == '/' || code == '=';
+                if (!base64_char) {
+                    continue;
+                }
+                unescaped = (uint8_t)code;
+                run = &unescaped;
+                run_len = 1;
+            } else {
+                const uint8_t *bs = memchr(data, '\\', end - data);
+                run = data;
+                run_len = (bs ? bs : end) - data;
+                data = bs ? bs + 1 : end;
+                escape = (bs != NULL);
+            }
+
+            size_t n = out_cap - written;
+            esp_err_t err = streaming_base64_decode(&dec, run, run_len, out + written, &n);
+            if (err != ESP_OK) {
+                return err == ESP_ERR_NO_MEM ? ESP_ERR_INVALID_SIZE : ESP_FAIL;
+            }
+            written += n;
+        }
+    }
+    if (escape != 0) {
+        return ESP_FAIL;  // String ended inside an escape
+    }
+
+    size_t n = out_cap - written;
+    esp_err_t err = streaming_base64_decode_finish(&dec, out + written, &n);
+    if (err != ESP_OK) {
+        return err == ESP_ERR_NO_MEM ? ESP_ERR_INVALID_SIZE : ESP_FAIL;
+    }
+    *out_len = written + n;
+    return ESP_OK;
+}
+
 esp_err_t gemini_tts(const char *text, int16_t *audio_out, size_t audio_len, size_t *samples_written)
 {
     if (!s_initialized) {
@@ -822,63 +1084,32 @@ esp_err_t gemini_tts(const char *text, int16_t *audio_out, size_t audio_len, siz
     free(payload);
     
     if (ret != ESP_OK) {
-        if (http_response.data) free(http_response.data);
+        seg_buf_free(&http_response.body);
         return ret;
     }
     
-    // Parse response
-    if (!http_response.data || http_response.len == 0) {
-        ESP_LOGE(TAG, "Empty response");
-        if (http_response.data) free(http_response.data);
+    seg_cursor_t audio_start;
+    size_t raw_len = 0;
+    if (tts_find_audio_content(&http_response.body, &audio_start, &raw_len) != ESP_OK) {
+        http_buffer_log_head(&http_response, "❌ [Gemini TTS] No audioContent in response");
+        seg_buf_free(&http_response.body);
         return ESP_FAIL;
     }
     
-    http_response.data = realloc(http_response.data, http_response.len + 1);
-    http_response.data[http_response.len] = '\0';
-    
-    cJSON *response_json = cJSON_Parse((char *)http_response.data);
-    free(http_response.data);
-    
-    if (!response_json) {
-        ESP_LOGE(TAG, "Failed to parse JSON response");
+    size_t decoded_len = 0;
+    ret = tts_decode_audio_content(&audio_start, raw_len, (uint8_t *)audio_out,
+                                   audio_len * sizeof(int16_t), &decoded_len);
+    seg_buf_free(&http_response.body);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ [Gemini TTS] Base64 decode failed: %s (%zu chars, %zu byte buffer)",
+                 esp_err_to_name(ret), raw_len, audio_len * sizeof(int16_t));
         return ESP_FAIL;
     }
     
-    cJSON *audioContent = cJSON_GetObjectItem(response_json, "audioContent");
-    if (audioContent && cJSON_IsString(audioContent)) {
-        // Decode base64 audio
-        const char *base64_audio = audioContent->valuestring;
-        size_t base64_len = strlen(base64_audio);
-        size_t decoded_len = 0;
-        
-        // Calculate required buffer size
-        size_t max_decoded = (base64_len / 4) * 3;
-        if (max_decoded > audio_len * sizeof(int16_t)) {
-            max_decoded = audio_len * sizeof(int16_t);
-        }
-        
-        int mbedtls_ret = mbedtls_base64_decode((unsigned char *)audio_out, 
-                                                max_decoded,
-                                                &decoded_len,
-                                                (const unsigned char *)base64_audio,
-                                                base64_len);
-        
-        cJSON_Delete(response_json);
-        
-        if (mbedtls_ret != 0) {
-            ESP_LOGE(TAG, "❌ [Gemini TTS] Base64 decode failed: %d", mbedtls_ret);
-            return ESP_FAIL;
-        }
-        
-        *samples_written = decoded_len / sizeof(int16_t);
-        ESP_LOGI(TAG, "✅ [Gemini TTS] Success: %zu bytes audio generated (%zu samples)", 
-                 decoded_len, *samples_written);
-        return ESP_OK;
-    }
-    
-    cJSON_Delete(response_json);
-    ESP_LOGE(TAG, "❌ [Gemini TTS] Failed to extract audioContent from response");
-    return ESP_FAIL;
+    *samples_written = decoded_len / sizeof(int16_t);
+    ESP_LOGI(TAG, "✅ [Gemini TTS] Success: %zu bytes audio generated (%zu samples)", 
+             decoded_len, *samples_written);
+    return ESP_OK;
 }
 
 esp_err_t gemini_tts_streaming(const char *text, gemini_tts_playback_callback_t callback, void *user_data)
@@ -922,314 +1153,55 @@ esp_err_t gemini_tts_streaming(const char *text, gemini_tts_playback_callback_t
              "https://texttospeech.googleapis.com/v1/text:synthesize?key=%s",
              s_config.api_key);
 
-    // Allocate large PSRAM buffer for entire JSON response
-    // TTS responses are typically 50-200KB JSON with base64-encoded audio
-    // Time announcements can be longer, so increase buffer size
-    // Leave 1 byte for null terminator
-    const size_t JSON_BUFFER_SIZE = 512 * 1024;  // 512KB in PSRAM (increased for longer TTS responses like time announcements)
+    // The response (typically 50-200KB of JSON around base64 audio) lands in pooled
+    // blocks, so its footprint follows the actual length of the announcement
     http_buffer_t response = {0};
-    response.data = heap_caps_malloc(JSON_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!response.data) {
-        ESP_LOGW(TAG, "PSRAM allocation failed, trying internal RAM");
-        response.data = heap_caps_malloc(JSON_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-        if (!response.data) {
-            ESP_LOGE(TAG, "Failed to allocate %zu bytes for TTS response", JSON_BUFFER_SIZE);
-            free(payload);
-            return ESP_ERR_NO_MEM;
-        }
-    }
-    response.cap = JSON_BUFFER_SIZE - 1;  // Reserve 1 byte for null terminator
-    response.len = 0;
-    ESP_LOGI(TAG, "Allocated %zu byte PSRAM buffer for TTS response (cap=%zu)", 
-             JSON_BUFFER_SIZE, response.cap);
-
-    // Perform HTTP request - store entire response
     esp_err_t err = http_post_json_with_auth(url, payload, NULL, &response);
     free(payload);
 
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP POST failed: %s", esp_err_to_name(err));
-        free(response.data);
+        seg_buf_free(&response.body);
         return err;
     }
 
-    // Ensure response is null-terminated for JSON parsing
-    if (response.len >= response.cap) {
-        ESP_LOGE(TAG, "Response buffer full (%zu >= %zu), may be truncated", response.len, response.cap);
-        free(response.data);
-        return ESP_ERR_NO_MEM;
-    }
-    
-    // Null-terminate the response for safe JSON parsing
-    response.data[response.len] = '\0';
-    
-    // Debug: Check for potential issues in response
-    ESP_LOGD(TAG, "TTS response: len=%zu, cap=%zu, last 50 chars: %.50s", 
-             response.len, response.cap, (const char *)(response.data + (response.len > 50 ? response.len - 50 : 0)));
-    
-    // Validate response doesn't contain embedded nulls (which would break JSON parsing)
-    bool has_null = false;
-    for (size_t i = 0; i < response.len; i++) {
-        if (response.data[i] == '\0') {
-            has_null = true;
-            ESP_LOGW(TAG, "Response contains null byte at offset %zu", i);
-            break;
-        }
-    }
-    if (has_null) {
-        ESP_LOGE(TAG, "Response contains embedded null bytes - cannot parse as JSON");
-        free(response.data);
-        return ESP_FAIL;
-    }
-    
-    // Try to parse JSON - if it fails due to long base64 string, extract manually
-    cJSON *json_root = cJSON_Parse((const char *)response.data);
-    const char *base64_audio = NULL;
+    seg_cursor_t audio_start;
     size_t base64_len = 0;
-    
-    if (!json_root) {
-        // JSON parsing failed - try manual extraction as fallback
-        ESP_LOGW(TAG, "cJSON parse failed, trying manual extraction");
-        
-        // Ensure response is treated as a string for searching
-        const char *response_str = (const char *)response.data;
-        
-        // Search for "audioContent" in the response
-        const char *audio_content_start = strstr(response_str, "\"audioContent\"");
-        if (!audio_content_start) {
-            // Try case-insensitive search
-            for (size_t i = 0; i < response.len - 13; i++) {
-                if (strncasecmp(response_str + i, "\"audioContent\"", 14) == 0) {
-                    audio_content_start = response_str + i;
-                    break;
-                }
-            }
-        }
-        
-        if (audio_content_start) {
-            // Find the colon after "audioContent"
-            const char *colon = strchr(audio_content_start, ':');
-            if (colon && colon < response_str + response.len) {
-                // Skip whitespace after colon
-                const char *value_start = colon + 1;
-                while (value_start < response_str + response.len && 
-                       (*value_start == ' ' || *value_start == '\t' || *value_start == '\n' || *value_start == '\r')) {
-                    value_start++;
-                }
-                
-                // Find opening quote
-                if (value_start < response_str + response.len && *value_start == '"') {
-                    base64_audio = value_start + 1; // Start after opening quote
-                    
-                    // Find closing quote - search forward from start
-                    const char *quote_end = NULL;
-                    for (const char *p = base64_audio; p < response_str + response.len; p++) {
-                        if (*p == '"' && (p == base64_audio || *(p-1) != '\\')) {
-                            // Found unescaped quote
-                            quote_end = p;
-                            break;
-                        }
-                    }
-                    
-                    if (quote_end && quote_end > base64_audio) {
-                        base64_len = quote_end - base64_audio;
-                        
-                        // Validate we're within response bounds
-                        if (base64_audio + base64_len > response_str + response.len) {
-                            ESP_LOGE(TAG, "Extracted base64 extends beyond response buffer");
-                            free(response.data);
-                            return ESP_FAIL;
-                        }
-                        
-                        // Trim any leading/trailing whitespace or control characters
-                        while (base64_len > 0 && base64_audio < response_str + response.len && 
-                               (base64_audio[0] == ' ' || base64_audio[0] == '\t' || 
-                                base64_audio[0] == '\n' || base64_audio[0] == '\r' || 
-                                (unsigned char)base64_audio[0] < 0x20)) {
-                            base64_audio++;
-                            base64_len--;
-                        }
-                        while (base64_len > 0 && base64_audio + base64_len - 1 < response_str + response.len &&
-                               (base64_audio[base64_len - 1] == ' ' || 
-                                base64_audio[base64_len - 1] == '\t' || 
-                                base64_audio[base64_len - 1] == '\n' || 
-                                base64_audio[base64_len - 1] == '\r' ||
-                                (unsigned char)base64_audio[base64_len - 1] < 0x20)) {
-                            base64_len--;
-                        }
-                        
-                        // Verify we're still pointing to valid memory
-                        if (base64_audio < response_str || base64_audio + base64_len > response_str + response.len) {
-                            ESP_LOGE(TAG, "Base64 pointer out of bounds after trimming");
-                            free(response.data);
-                            return ESP_FAIL;
-                        }
-                        
-                        ESP_LOGI(TAG, "Manually extracted base64: %zu chars (after trimming), offset: %zu", 
-                                base64_len, base64_audio - response_str);
-                    } else {
-                        ESP_LOGE(TAG, "Could not find closing quote for audioContent");
-                    }
-                } else {
-                    ESP_LOGE(TAG, "audioContent value does not start with quote (found: 0x%02x)", 
-                            value_start < response_str + response.len ? (unsigned char)*value_start : 0);
-                }
-            } else {
-                ESP_LOGE(TAG, "Could not find colon after audioContent");
-            }
-        } else {
-            ESP_LOGE(TAG, "Could not find \"audioContent\" in response");
-        }
-        
-        if (!base64_audio || base64_len == 0) {
-            const char *error_ptr = cJSON_GetErrorPtr();
-            if (error_ptr != NULL) {
-                size_t error_offset = error_ptr - (const char *)response.data;
-                ESP_LOGE(TAG, "JSON parse error at offset %zu", error_offset);
-                size_t context_start = (error_offset > 100) ? error_offset - 100 : 0;
-                size_t context_len = (error_offset + 100 < response.len) ? 200 : (response.len - context_start);
-                ESP_LOGE(TAG, "Context around error: %.200s", (const char *)(response.data + context_start));
-            }
-            ESP_LOGE(TAG, "Failed to parse JSON and manual extraction failed (len=%zu)", response.len);
-            ESP_LOGE(TAG, "First 200 chars: %.200s", (const char *)response.data);
-            ESP_LOGE(TAG, "Last 200 chars: %.200s", (const char *)(response.data + (response.len > 200 ? response.len - 200 : 0)));
-            free(response.data);
-            return ESP_FAIL;
-        }
-    } else {
-        // JSON parsed successfully - use cJSON to extract
-        cJSON *audio_content = cJSON_GetObjectItem(json_root, "audioContent");
-        if (!audio_content || !cJSON_IsString(audio_content)) {
-            ESP_LOGE(TAG, "Missing or invalid audioContent in response");
-            cJSON_Delete(json_root);
-            free(response.data);
-            return ESP_FAIL;
-        }
-        base64_audio = audio_content->valuestring;
-        base64_len = strlen(base64_audio);
-        cJSON_Delete(json_root);
-    }
-    ESP_LOGI(TAG, "Extracted base64 audio: %zu characters", base64_len);
-    
-    // Validate base64 string
-    if (base64_len == 0) {
-        ESP_LOGE(TAG, "Base64 string is empty");
-        free(response.data);
-        return ESP_FAIL;
-    }
-    
-    // Validate pointer is within response buffer bounds and clamp length
-    const char *response_start = (const char *)response.data;
-    const char *response_end = response_start + response.len;
-    
-    // Check if pointer is within bounds
-    bool pointer_in_bounds = (base64_audio >= response_start && base64_audio < response_end);
-    
-    if (!pointer_in_bounds) {
-        ESP_LOGE(TAG, "Base64 pointer out of bounds: base64_audio=%p, response_start=%p, response_end=%p, offset=%ld",
-                 base64_audio, response_start, response_end, 
-                 base64_audio > response_start ? (long)(base64_audio - response_start) : -1);
-        free(response.data);
-        return ESP_FAIL;
-    }
-    
-    // Calculate actual available space from base64_audio to end of buffer
-    size_t available_space = response_end - base64_audio;
-    
-    // Clamp base64_len to available space if it exceeds
-    if (base64_len > available_space) {
-        ESP_LOGW(TAG, "Base64 length (%zu) exceeds available space (%zu), clamping to %zu", 
-                 base64_len, available_space, available_space);
-        base64_len = available_space;
-    }
-    
-    if (base64_len == 0) {
-        ESP_LOGE(TAG, "Base64 string is empty after bounds check");
-        free(response.data);
-        return ESP_FAIL;
-    }
-    
-    ESP_LOGI(TAG, "Base64 audio validated: %zu characters (pointer=%p, buffer=[%p-%p], offset=%zu, available=%zu)", 
-             base64_len, base64_audio, response_start, response_end,
-             base64_audio - response_start, available_space);
-    
-    // Debug: Log first few bytes as hex to see what we're getting
-    ESP_LOGD(TAG, "First 20 bytes of extracted base64 (hex):");
-    for (size_t i = 0; i < (base64_len < 20 ? base64_len : 20); i++) {
-        ESP_LOGD(TAG, "  [%zu] 0x%02x '%c'", i, (unsigned char)base64_audio[i], 
-                 (base64_audio[i] >= 32 && base64_audio[i] < 127) ? base64_audio[i] : '.');
-    }
-    
-    // Check first few characters are valid base64
-    bool valid_base64 = true;
-    size_t check_len = (base64_len < 50 ? base64_len : 50);  // Check more characters
-    for (size_t i = 0; i < check_len; i++) {
-        char c = base64_audio[i];
-        if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || 
-              (c >= '0' && c <= '9') || c == '+' || c == '/' || c == '=')) {
-            valid_base64 = false;
-            ESP_LOGE(TAG, "Invalid base64 character at offset %zu: 0x%02x ('%c')", i, (unsigned char)c, 
-                     (c >= 32 && c < 127) ? c : '.');
-            
-            // Log context around the error
-            size_t context_start = (i > 20) ? i - 20 : 0;
-            size_t context_len = (i + 20 < base64_len) ? 40 : (base64_len - context_start);
-            ESP_LOGE(TAG, "Context around invalid char (offset %zu):", i);
-            for (size_t j = context_start; j < context_start + context_len && j < base64_len; j++) {
-                char ch = base64_audio[j];
-                ESP_LOGE(TAG, "  [%zu] 0x%02x '%c'", j, (unsigned char)ch, (ch >= 32 && ch < 127) ? ch : '.');
-            }
-            break;
-        }
-    }
-    if (!valid_base64) {
-        ESP_LOGE(TAG, "Base64 string contains invalid characters");
-        ESP_LOGE(TAG, "Base64 pointer: %p, Response buffer: %p-%p", 
-                 base64_audio, response_start, response_end);
-        ESP_LOGE(TAG, "First 100 bytes (hex):");
-        for (size_t i = 0; i < (base64_len < 100 ? base64_len : 100); i++) {
-            if (i % 16 == 0) {
-                ESP_LOGE(TAG, "  %04zx:", i);
-            }
-            ESP_LOGE(TAG, " %02x", (unsigned char)base64_audio[i]);
-            if (i % 16 == 15) {
-                ESP_LOGE(TAG, "");
-            }
-        }
-        if (base64_len > 100) {
-            ESP_LOGE(TAG, "  ... (truncated, total %zu bytes)", base64_len);
-        }
-        free(response.data);
+    if (tts_find_audio_content(&response.body, &audio_start, &base64_len) != ESP_OK || base64_len == 0) {
+        http_buffer_log_head(&response, "Missing or invalid audioContent in response");
+        seg_buf_free(&response.body);
         return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "Extracted base64 audio: %zu characters (offset %zu of %zu, %zu blocks)",
+             base64_len, audio_start.pos, response.body.len, response.body.blocks);
 
-    // Decode base64 to PCM audio - allocate in PSRAM
-    // Base64 encoding increases size by ~33%, so decoded size is ~75% of base64 size
-    // For safety, allocate full base64 size (will be smaller after decode)
-    size_t audio_buffer_size = (base64_len * 3) / 4 + 1024;  // Add padding for safety
+    // Decode base64 to PCM audio - allocate in PSRAM, sized from the string length
+    size_t audio_buffer_size = (base64_len / 4) * 3 + 3;
     int16_t *audio_samples = (int16_t *)heap_caps_malloc(audio_buffer_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
     if (!audio_samples) {
         ESP_LOGW(TAG, "PSRAM allocation for audio failed, trying internal RAM");
         audio_samples = (int16_t *)heap_caps_malloc(audio_buffer_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
         if (!audio_samples) {
             ESP_LOGE(TAG, "Failed to allocate %zu bytes for decoded audio", audio_buffer_size);
-            free(response.data);
+            seg_buf_free(&response.body);
             return ESP_ERR_NO_MEM;
         }
     }
 
+    size_t audio_offset = audio_start.pos;
     size_t decoded_len = 0;
-    int mbedtls_ret = mbedtls_base64_decode((unsigned char *)audio_samples, audio_buffer_size, &decoded_len,
-                                            (const unsigned char *)base64_audio, base64_len);
-    free(response.data);
-
-    if (mbedtls_ret != 0) {
-        ESP_LOGE(TAG, "Base64 decode failed: %d (base64_len=%zu)", mbedtls_ret, base64_len);
-        ESP_LOGE(TAG, "First 100 base64 chars: %.100s", base64_audio);
-        ESP_LOGE(TAG, "Last 100 base64 chars: %.100s", base64_audio + (base64_len > 100 ? base64_len - 100 : 0));
+    err = tts_decode_audio_content(&audio_start, base64_len, (uint8_t *)audio_samples, audio_buffer_size,
+                                   &decoded_len);
+    if (err != ESP_OK) {
+        char head[101];
+        seg_buf_copy(&response.body, audio_offset, head, sizeof(head));
+        ESP_LOGE(TAG, "Base64 decode failed: %s (base64_len=%zu)", esp_err_to_name(err), base64_len);
+        ESP_LOGE(TAG, "First 100 base64 chars: %s", head);
+        seg_buf_free(&response.body);
         free(audio_samples);
         return ESP_FAIL;
     }
+    seg_buf_free(&response.body);
 
     size_t sample_count = decoded_len / sizeof(int16_t);
     ESP_LOGI(TAG, "Decoded %zu bytes (%zu samples) of PCM audio", decoded_len, sample_count);
@@ -1247,8 +1219,30 @@ esp_err_t gemini_tts_streaming(const char *text, gemini_tts_playback_callback_t
     return ESP_OK;
 }
 
+esp_err_t gemini_api_prewarm(void)
+{
+#ifdef CONFIG_GEMINI_PREWARM_ENABLED
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return gemini_prewarm_start(http_event_handler);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void gemini_api_set_system_instruction(const char *instruction)
+{
+    s_system_instruction = instruction;
+}
+
 void gemini_api_deinit(void)
 {
+#ifdef CONFIG_GEMINI_CONTEXT_CACHE_ENABLED
+    // The server-side cache simply expires; forget it so a re-init starts clean
+    memset(&s_context_cache, 0, sizeof(s_context_cache));
+#endif
+    seg_buf_pool_trim();
     memset(&s_config, 0, sizeof(s_config));
     s_initialized = false;
     ESP_LOGI(TAG, "Gemini API deinitialized");
@@ -0,0 +1,206 @@
+/**
+ * @file gemini_conversation.c
+ * @brief Token-budgeted multi-turn history for Gemini requests
+ *
+ * Turn texts are stored back to back, NUL-terminated, in one PSRAM arena so they
+ * can be escaped straight into the request body. Eviction always removes the
+ * oldest turn plus a following model reply, so the history sent to the API
+ * starts with a user turn.
+ */
+
+#include "gemini_conversation.h"
+#include "gemini_json.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "gemini_conv";
+
+#ifndef CONFIG_GEMINI_CONVERSATION_BUDGET_BYTES
+#define CONFIG_GEMINI_CONVERSATION_BUDGET_BYTES 2048
+#endif
+#ifndef CONFIG_GEMINI_CONVERSATION_MAX_TURNS
+#define CONFIG_GEMINI_CONVERSATION_MAX_TURNS 8
+#endif
+#ifndef CONFIG_GEMINI_CONVERSATION_IDLE_S
+#define CONFIG_GEMINI_CONVERSATION_IDLE_S 120
+#endif
+
+// Stored model replies are clipped to this share of the budget
+#define REPLY_SHARE_DIVISOR 4
+
+typedef struct {
+    gemini_role_t role;
+    size_t offset;  // Into arena
+    size_t len;     // Excluding NUL
+} conv_turn_t;
+
+struct gemini_conversation {
+    char *arena;
+    size_t budget;
+    size_t used;
+    conv_turn_t turns[CONFIG_GEMINI_CONVERSATION_MAX_TURNS];
+    size_t count;
+    int64_t last_turn_us;
+};
+
+gemini_conversation_t *gemini_conversation_create(size_t budget_bytes)
+{
+    if (budget_bytes == 0) {
+        budget_bytes = CONFIG_GEMINI_CONVERSATION_BUDGET_BYTES;
+    }
+
+    gemini_conversation_t *conv = calloc(1, sizeof(gemini_conversation_t));
+    if (!conv) {
+        return NULL;
+    }
+    conv->arena = heap_caps_malloc(budget_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!conv->arena) {
+        conv->arena = malloc(budget_bytes);
+        if (!conv->arena) {
+            free(conv);
+            return NULL;
+        }
+    }
+    conv->budget = budget_bytes;
+    return conv;
+}
+
+// Drop the oldest turn and compact the arena
+static void evict_oldest(gemini_conversation_t *conv)
+{
+    size_t freed = conv->turns[0].len + 1;
+    memmove(conv->arena, conv->arena + freed, conv->used - freed);
+    conv->used -= freed;
+    memmove(&conv->turns[0], &conv->turns[1], (conv->count - 1) * sizeof(conv_turn_t));
+    conv->count--;
+    for (size_t i = 0; i < conv->count; i++) {
+        conv->turns[i].offset -= freed;
+    }
+}
+
+// Evict a whole exchange: the oldest turn and any model replies that follow it
+static void evict_exchange(gemini_conversation_t *conv)
+{
+    evict_oldest(conv);
+    while (conv->count > 0 && conv->turns[0].role == GEMINI_ROLE_MODEL) {
+        evict_oldest(conv);
+    }
+}
+
+static void expire_if_idle(gemini_conversation_t *conv)
+{
+    if (conv->count > 0 &&
+        esp_timer_get_time() - conv->last_turn_us > (int64_t)CONFIG_GEMINI_CONVERSATION_IDLE_S * 1000000) {
+        ESP_LOGI(TAG, "Conversation idle, forgetting %zu turns", conv->count);
+        gemini_conversation_clear(conv);
+    }
+}
+
+// Length of `text` clipped to `limit` bytes at the last sentence end (or word) inside it
+static size_t clipped_length(const char *text, size_t len, size_t limit)
+{
+    if (len <= limit) {
+        return len;
+    }
+    size_t cut = 0;
+    for (size_t i = 0; i < limit; i++) {
+        if ((text[i] == '.' || text[i] == '!' || text[i] == '?') && (text[i + 1] == ' ' || text[i + 1] == '\0')) {
+            cut = i + 1;
+        }
+    }
+    if (cut == 0) {
+        for (cut = limit; cut > 0 && text[cut] != ' '; cut--) {
+        }
+    }
+    if (cut == 0) {
+        cut = limit;
+    }
+    // Don't split a UTF-8 sequence
+    while (cut > 0 && ((unsigned char)text[cut] & 0xC0) == 0x80) {
+        cut--;
+    }
+    return cut;
+}
+
+esp_err_t gemini_conversation_add(gemini_conversation_t *conv, gemini_role_t role, const char *text)
+{
+    if (!conv || !text || (role != GEMINI_ROLE_USER && role != GEMINI_ROLE_MODEL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    expire_if_idle(conv);
+
+    size_t len = strlen(text);
+    if (len == 0) {
+        return ESP_OK;
+    }
+    size_t limit = role == GEMINI_ROLE_MODEL ? conv->budget / REPLY_SHARE_DIVISOR : conv->budget / 2;
+    len = clipped_length(text, len, limit);
+
+    // A reply with no preceding user turn (its prompt was evicted) is useless context
+    if (role == GEMINI_ROLE_MODEL && conv->count == 0) {
+        return ESP_OK;
+    }
+
+    while (conv->count > 0 &&
+           (conv->count >= CONFIG_GEMINI_CONVERSATION_MAX_TURNS || conv->used + len + 1 > conv->budget)) {
+        evict_exchange(conv);
+    }
+    if (role == GEMINI_ROLE_MODEL && conv->count == 0) {
+        return ESP_OK;
+    }
+
+    conv_turn_t *turn = &conv->turns[conv->count++];
+    turn->role = role;
+    turn->offset = conv->used;
+    turn->len = len;
+    memcpy(conv->arena + conv->used, text, len);
+    conv->arena[conv->used + len] = '\0';
+    conv->used += len + 1;
+    conv->last_turn_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+size_t gemini_conversation_turn_count(gemini_conversation_t *conv)
+{
+    if (!conv) {
+        return 0;
+    }
+    expire_if_idle(conv);
+    return conv->count;
+}
+
+void gemini_conversation_clear(gemini_conversation_t *conv)
+{
+    if (conv) {
+        conv->count = 0;
+        conv->used = 0;
+    }
+}
+
+void gemini_conversation_destroy(gemini_conversation_t *conv)
+{
+    if (conv) {
+        heap_caps_free(conv->arena);
+        free(conv);
+    }
+}
+
+void gemini_conversation_write_contents(gemini_conversation_t *conv, json_buf_t *jb)
+{
+    if (!conv) {
+        return;
+    }
+    expire_if_idle(conv);
+    for (size_t i = 0; i < conv->count; i++) {
+        const conv_turn_t *turn = &conv->turns[i];
+        json_buf_raw(jb, turn->role == GEMINI_ROLE_MODEL ? "{\"role\":\"model\",\"parts\":[{\"text\":"
+                                                         : "{\"role\":\"user\",\"parts\":[{\"text\":");
+        json_buf_string(jb, conv->arena + turn->offset);
+        json_buf_raw(jb, "}]},");
+    }
+}
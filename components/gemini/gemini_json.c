@@ -0,0 +1,78 @@
+/**
+ * @file gemini_json.c
+ * @brief Append-only JSON writer for Gemini request bodies
+ */
+
+#include "gemini_json.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool json_buf_reserve(json_buf_t *jb, size_t extra)
+{
+    if (jb->failed) {
+        return false;
+    }
+    if (jb->len + extra + 1 <= jb->cap) {
+        return true;
+    }
+    size_t cap = jb->cap ? jb->cap : 512;
+    while (cap < jb->len + extra + 1) {
+        cap *= 2;
+    }
+    char *buf = realloc(jb->buf, cap);
+    if (!buf) {
+        jb->failed = true;
+        return false;
+    }
+    jb->buf = buf;
+    jb->cap = cap;
+    return true;
+}
+
+void json_buf_raw(json_buf_t *jb, const char *s)
+{
+    size_t n = strlen(s);
+    if (json_buf_reserve(jb, n)) {
+        memcpy(jb->buf + jb->len, s, n + 1);
+        jb->len += n;
+    }
+}
+
+void json_buf_string(json_buf_t *jb, const char *s)
+{
+    // Worst case every byte becomes a \u00XX escape
+    if (!json_buf_reserve(jb, strlen(s) * 6 + 2)) {
+        return;
+    }
+    char *out = jb->buf + jb->len;
+    *out++ = '"';
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        switch (*p) {
+            case '"':  *out++ = '\\'; *out++ = '"'; break;
+            case '\\': *out++ = '\\'; *out++ = '\\'; break;
+            case '\n': *out++ = '\\'; *out++ = 'n'; break;
+            case '\r': *out++ = '\\'; *out++ = 'r'; break;
+            case '\t': *out++ = '\\'; *out++ = 't'; break;
+            default:
+                if (*p < 0x20) {
+                    out += sprintf(out, "\\u%04x", *p);
+                } else {
+                    *out++ = (char)*p;
+                }
+                break;
+        }
+    }
+    *out++ = '"';
+    *out = '\0';
+    jb->len = out - jb->buf;
+}
+
+char *json_buf_finish(json_buf_t *jb)
+{
+    if (jb->failed) {
+        free(jb->buf);
+        return NULL;
+    }
+    return jb->buf;
+}
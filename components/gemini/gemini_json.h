@@ -0,0 +1,47 @@
+#pragma once
+
+#include "gemini_conversation.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Growable request body for payloads that are mostly pre-serialized JSON (the
+ * tool schema, conversation history) plus a few escaped strings, so no cJSON
+ * tree is built per request. Zero-initialize before use.
+ */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool failed;  // Sticky allocation failure
+} json_buf_t;
+
+/**
+ * Append raw (already valid) JSON text
+ */
+void json_buf_raw(json_buf_t *jb, const char *s);
+
+/**
+ * Append a string as a quoted, escaped JSON string
+ */
+void json_buf_string(json_buf_t *jb, const char *s);
+
+/**
+ * Take ownership of the body
+ * @return NUL-terminated body to free(), or NULL if any append ran out of memory
+ */
+char *json_buf_finish(json_buf_t *jb);
+
+/**
+ * Append the conversation's turns as Gemini "contents" entries, each followed by a comma
+ * Turns idle past CONFIG_GEMINI_CONVERSATION_IDLE_S are dropped first.
+ */
+void gemini_conversation_write_contents(gemini_conversation_t *conv, json_buf_t *jb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,237 @@
+/**
+ * @file gemini_prewarm.c
+ * @brief Speculative TLS pre-connect to the Google API hosts
+ *
+ * Started when the wake word fires: one task per host acquires a voice-class
+ * scheduler session and issues a HEAD request so DNS, TCP and the TLS handshake
+ * complete while the user is still speaking. The keep-alive client is then
+ * parked until the request path claims it, or closed after the hold time or
+ * when the scheduler evicts it to admit another request.
+ */
+
+#include "gemini_prewarm.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+static const char *TAG = "gemini_prewarm";
+
+#ifndef CONFIG_GEMINI_PREWARM_HOLD_MS
+#define CONFIG_GEMINI_PREWARM_HOLD_MS 10000
+#endif
+
+#define PREWARM_TASK_STACK      6144
+#define PREWARM_TASK_PRIO       4
+#define PREWARM_ADMIT_TIMEOUT   pdMS_TO_TICKS(2000)
+#define PREWARM_CLAIM_WAIT_MS   1500  // Max wait for an in-progress handshake
+#define PREWARM_CLAIM_POLL_MS   20
+
+typedef enum {
+    PREWARM_IDLE = 0,
+    PREWARM_CONNECTING,
+    PREWARM_READY,
+} prewarm_state_t;
+
+typedef struct {
+    const char *host;
+    prewarm_state_t state;
+    esp_http_client_handle_t client;
+    net_session_t session;
+    SemaphoreHandle_t claimed;
+} prewarm_slot_t;
+
+static prewarm_slot_t s_slots[] = {
+    { .host = "speech.googleapis.com" },
+    { .host = "generativelanguage.googleapis.com" },
+};
+#define PREWARM_SLOT_COUNT (sizeof(s_slots) / sizeof(s_slots[0]))
+
+static SemaphoreHandle_t s_lock = NULL;
+static http_event_handle_cb s_event_handler = NULL;
+
+static bool url_has_host(const char *url, const char *host)
+{
+    const char *p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    size_t host_len = strlen(host);
+    return strncmp(p, host, host_len) == 0 &&
+           (p[host_len] == '/' || p[host_len] == ':' || p[host_len] == '?' || p[host_len] == '\0');
+}
+
+// Scheduler eviction: wake the parking task, which closes the still-parked client
+static void prewarm_evict(void *arg)
+{
+    prewarm_slot_t *slot = (prewarm_slot_t *)arg;
+    xSemaphoreGive(slot->claimed);
+}
+
+static void prewarm_task(void *pvParameters)
+{
+    prewarm_slot_t *slot = (prewarm_slot_t *)pvParameters;
+    int64_t start_time = esp_timer_get_time();
+
+    net_session_t session;
+    if (net_scheduler_acquire(NET_PRIO_VOICE, PREWARM_ADMIT_TIMEOUT, &session) != ESP_OK) {
+        ESP_LOGW(TAG, "No session admitted for %s, skipping pre-connect", slot->host);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        slot->state = PREWARM_IDLE;
+        xSemaphoreGive(s_lock);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    char url[96];
+    snprintf(url, sizeof(url), "https://%s/", slot->host);
+
+    // Must match the request path's client settings, the handle is reused as-is
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_HEAD,
+        .event_handler = s_event_handler,
+        .user_data = NULL,
+        .timeout_ms = 30000,
+        .skip_cert_common_name_check = true,  // Skip certificate verification for development
+        .crt_bundle_attach = NULL,  // Don't use certificate bundle
+        .use_global_ca_store = false,  // Don't use global CA store
+        .keep_alive_enable = true,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    esp_err_t err = client ? esp_http_client_perform(client) : ESP_ERR_NO_MEM;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Pre-connect to %s failed: %s", slot->host, esp_err_to_name(err));
+        if (client) {
+            esp_http_client_cleanup(client);
+        }
+        net_scheduler_release(&session);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        slot->state = PREWARM_IDLE;
+        xSemaphoreGive(s_lock);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    ESP_LOGI(TAG, "🔥 %s ready in %" PRId64 " ms", slot->host, (esp_timer_get_time() - start_time) / 1000);
+
+    xSemaphoreTake(slot->claimed, 0);  // Drop a stale claim signal
+    // Parked before it is claimable, so a claimer's unpark always finds it parked
+    net_scheduler_park(&session, prewarm_evict, slot);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    slot->client = client;
+    slot->session = session;
+    slot->state = PREWARM_READY;
+    xSemaphoreGive(s_lock);
+
+    // Park the connection until it is claimed, evicted or the hold time expires
+    xSemaphoreTake(slot->claimed, pdMS_TO_TICKS(CONFIG_GEMINI_PREWARM_HOLD_MS));
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool discard = (slot->state == PREWARM_READY);
+    if (discard) {
+        slot->client = NULL;
+        slot->state = PREWARM_IDLE;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (discard) {
+        ESP_LOGI(TAG, "Pre-connected session to %s unused, closing", slot->host);
+        esp_http_client_cleanup(client);
+        net_scheduler_release(&session);
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t gemini_prewarm_start(http_event_handle_cb event_handler)
+{
+    if (!event_handler) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) {
+            return ESP_ERR_NO_MEM;
+        }
+        for (size_t i = 0; i < PREWARM_SLOT_COUNT; i++) {
+            s_slots[i].claimed = xSemaphoreCreateBinary();
+            if (!s_slots[i].claimed) {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    s_event_handler = event_handler;
+
+    for (size_t i = 0; i < PREWARM_SLOT_COUNT; i++) {
+        prewarm_slot_t *slot = &s_slots[i];
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        bool idle = (slot->state == PREWARM_IDLE);
+        if (idle) {
+            slot->state = PREWARM_CONNECTING;
+        }
+        xSemaphoreGive(s_lock);
+        if (!idle) {
+            continue;  // Already connecting or parked
+        }
+
+        // Pin to CPU 0 with the network stack; CPU 1 is busy with mic capture
+        if (xTaskCreatePinnedToCore(prewarm_task, "gemini_prewarm", PREWARM_TASK_STACK,
+                                    slot, PREWARM_TASK_PRIO, NULL, 0) != pdPASS) {
+            ESP_LOGW(TAG, "Failed to create pre-connect task for %s", slot->host);
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            slot->state = PREWARM_IDLE;
+            xSemaphoreGive(s_lock);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_http_client_handle_t gemini_prewarm_claim(const char *url, net_session_t *session)
+{
+    if (!s_lock || !url || !session) {
+        return NULL;
+    }
+
+    prewarm_slot_t *slot = NULL;
+    for (size_t i = 0; i < PREWARM_SLOT_COUNT; i++) {
+        if (url_has_host(url, s_slots[i].host)) {
+            slot = &s_slots[i];
+            break;
+        }
+    }
+    if (!slot) {
+        return NULL;
+    }
+
+    esp_http_client_handle_t client = NULL;
+    for (int waited = 0; ; waited += PREWARM_CLAIM_POLL_MS) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        prewarm_state_t state = slot->state;
+        if (state == PREWARM_READY) {
+            client = slot->client;
+            *session = slot->session;
+            slot->client = NULL;
+            slot->state = PREWARM_IDLE;
+            xSemaphoreGive(slot->claimed);
+        }
+        xSemaphoreGive(s_lock);
+
+        if (state != PREWARM_CONNECTING || waited >= PREWARM_CLAIM_WAIT_MS) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(PREWARM_CLAIM_POLL_MS));
+    }
+
+    if (client) {
+        net_scheduler_unpark(session);
+        ESP_LOGI(TAG, "Reusing pre-connected session to %s", slot->host);
+    }
+    return client;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "net_scheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Start speculative TLS connections to the Google API hosts (internal to the gemini component)
+ * @param event_handler: HTTP event handler the request path will use with the claimed client
+ * @return ESP_OK if pre-connects were started (or are already running)
+ */
+esp_err_t gemini_prewarm_start(http_event_handle_cb event_handler);
+
+/**
+ * Take ownership of a pre-connected client for the host of `url`
+ * Waits briefly if the handshake is still in progress.
+ * @param url: Request URL (https://host/...)
+ * @param session: Receives the scheduler session that belongs to the client
+ * @return Connected client (caller must cleanup and release the session), or NULL if none
+ */
+esp_http_client_handle_t gemini_prewarm_claim(const char *url, net_session_t *session);
+
+#ifdef __cplusplus
+}
+#endif
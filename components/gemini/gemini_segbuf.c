@@ -0,0 +1,284 @@
+/**
+ * @file gemini_segbuf.c
+ * @brief Segmented, pooled response buffers for Gemini / Google API bodies
+ *
+ * Responses range from a few hundred bytes (LLM function calls) to a few
+ * hundred KB (base64 TTS audio). Instead of one worst-case allocation per
+ * request, bodies are chained from fixed-size PSRAM blocks. Freed blocks are
+ * kept on a short free list so back-to-back requests in a voice turn don't go
+ * through the allocator again.
+ */
+
+#include "gemini_segbuf.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "gemini_segbuf";
+
+#ifndef CONFIG_GEMINI_RESPONSE_BLOCK_SIZE
+#define CONFIG_GEMINI_RESPONSE_BLOCK_SIZE 4096
+#endif
+#ifndef CONFIG_GEMINI_RESPONSE_POOL_BLOCKS
+#define CONFIG_GEMINI_RESPONSE_POOL_BLOCKS 8
+#endif
+#ifndef CONFIG_GEMINI_RESPONSE_MAX_KB
+#define CONFIG_GEMINI_RESPONSE_MAX_KB 1024
+#endif
+
+#define BLOCK_DATA_SIZE  CONFIG_GEMINI_RESPONSE_BLOCK_SIZE
+#define MAX_BODY_BYTES   ((size_t)CONFIG_GEMINI_RESPONSE_MAX_KB * 1024)
+
+static portMUX_TYPE s_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static seg_block_t *s_pool = NULL;
+static size_t s_pool_count = 0;
+
+static seg_block_t *block_take(void)
+{
+    seg_block_t *block = NULL;
+    taskENTER_CRITICAL(&s_pool_lock);
+    if (s_pool) {
+        block = s_pool;
+        s_pool = block->next;
+        s_pool_count--;
+    }
+    taskEXIT_CRITICAL(&s_pool_lock);
+
+    if (!block) {
+        size_t size = sizeof(seg_block_t) + BLOCK_DATA_SIZE;
+        block = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!block) {
+            block = malloc(size);
+            if (!block) {
+                return NULL;
+            }
+        }
+    }
+    block->next = NULL;
+    block->len = 0;
+    return block;
+}
+
+static void block_give(seg_block_t *block)
+{
+    taskENTER_CRITICAL(&s_pool_lock);
+    if (s_pool_count < CONFIG_GEMINI_RESPONSE_POOL_BLOCKS) {
+        block->next = s_pool;
+        s_pool = block;
+        s_pool_count++;
+        block = NULL;
+    }
+    taskEXIT_CRITICAL(&s_pool_lock);
+
+    if (block) {
+        heap_caps_free(block);
+    }
+}
+
+esp_err_t seg_buf_append(seg_buf_t *buf, const uint8_t *data, size_t len)
+{
+    if (buf->len + len > MAX_BODY_BYTES) {
+        ESP_LOGE(TAG, "Response exceeds %d KB limit", CONFIG_GEMINI_RESPONSE_MAX_KB);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    while (len > 0) {
+        seg_block_t *tail = buf->tail;
+        if (!tail || tail->len == BLOCK_DATA_SIZE) {
+            seg_block_t *block = block_take();
+            if (!block) {
+                ESP_LOGE(TAG, "Out of memory after %zu bytes (%zu blocks)", buf->len, buf->blocks);
+                return ESP_ERR_NO_MEM;
+            }
+            if (tail) {
+                tail->next = block;
+            } else {
+                buf->head = block;
+            }
+            buf->tail = tail = block;
+            buf->blocks++;
+        }
+        size_t n = BLOCK_DATA_SIZE - tail->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(tail->data + tail->len, data, n);
+        tail->len += n;
+        buf->len += n;
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+char *seg_buf_flatten(const seg_buf_t *buf)
+{
+    if (buf->len == 0) {
+        return NULL;
+    }
+    char *out = heap_caps_malloc(buf->len + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!out) {
+        out = malloc(buf->len + 1);
+        if (!out) {
+            return NULL;
+        }
+    }
+    size_t pos = 0;
+    for (const seg_block_t *b = buf->head; b; b = b->next) {
+        memcpy(out + pos, b->data, b->len);
+        pos += b->len;
+    }
+    out[pos] = '\0';
+    return out;
+}
+
+size_t seg_buf_copy(const seg_buf_t *buf, size_t from, char *out, size_t out_len)
+{
+    if (out_len == 0) {
+        return 0;
+    }
+    seg_cursor_t cur;
+    seg_cursor_init(&cur, buf);
+    seg_cursor_advance(&cur, from);
+
+    size_t n = 0;
+    while (n + 1 < out_len) {
+        const uint8_t *data;
+        size_t span = seg_cursor_span(&cur, &data);
+        if (span == 0) {
+            break;
+        }
+        if (span > out_len - 1 - n) {
+            span = out_len - 1 - n;
+        }
+        memcpy(out + n, data, span);
+        n += span;
+        seg_cursor_advance(&cur, span);
+    }
+    out[n] = '\0';
+    return n;
+}
+
+void seg_buf_free(seg_buf_t *buf)
+{
+    seg_block_t *block = buf->head;
+    while (block) {
+        seg_block_t *next = block->next;
+        block_give(block);
+        block = next;
+    }
+    memset(buf, 0, sizeof(*buf));
+}
+
+void seg_buf_pool_trim(void)
+{
+    taskENTER_CRITICAL(&s_pool_lock);
+    seg_block_t *pool = s_pool;
+    s_pool = NULL;
+    s_pool_count = 0;
+    taskEXIT_CRITICAL(&s_pool_lock);
+
+    while (pool) {
+        seg_block_t *next = pool->next;
+        heap_caps_free(pool);
+        pool = next;
+    }
+}
+
+void seg_cursor_init(seg_cursor_t *cur, const seg_buf_t *buf)
+{
+    cur->block = buf->head;
+    cur->offset = 0;
+    cur->pos = 0;
+}
+
+// Step onto the next non-empty block once the current one is exhausted
+static inline void cursor_settle(seg_cursor_t *cur)
+{
+    while (cur->block && cur->offset >= cur->block->len) {
+        cur->block = cur->block->next;
+        cur->offset = 0;
+    }
+}
+
+int seg_cursor_peek(seg_cursor_t *cur)
+{
+    cursor_settle(cur);
+    return cur->block ? cur->block->data[cur->offset] : -1;
+}
+
+int seg_cursor_next(seg_cursor_t *cur)
+{
+    cursor_settle(cur);
+    if (!cur->block) {
+        return -1;
+    }
+    cur->pos++;
+    return cur->block->data[cur->offset++];
+}
+
+size_t seg_cursor_span(seg_cursor_t *cur, const uint8_t **data)
+{
+    cursor_settle(cur);
+    if (!cur->block) {
+        *data = NULL;
+        return 0;
+    }
+    *data = cur->block->data + cur->offset;
+    return cur->block->len - cur->offset;
+}
+
+void seg_cursor_advance(seg_cursor_t *cur, size_t n)
+{
+    while (n > 0) {
+        cursor_settle(cur);
+        if (!cur->block) {
+            return;
+        }
+        size_t step = cur->block->len - cur->offset;
+        if (step > n) {
+            step = n;
+        }
+        cur->offset += step;
+        cur->pos += step;
+        n -= step;
+    }
+}
+
+bool seg_cursor_find(seg_cursor_t *cur, const char *needle)
+{
+    size_t needle_len = strlen(needle);
+    if (needle_len == 0) {
+        return true;
+    }
+
+    while (true) {
+        // Fast scan for the first byte within the current block
+        const uint8_t *data;
+        size_t span = seg_cursor_span(cur, &data);
+        if (span == 0) {
+            return false;
+        }
+        const uint8_t *hit = memchr(data, (uint8_t)needle[0], span);
+        if (!hit) {
+            seg_cursor_advance(cur, span);
+            continue;
+        }
+        seg_cursor_advance(cur, hit - data);
+
+        // Compare the rest on a copy of the cursor, so a mismatch costs one byte
+        seg_cursor_t probe = *cur;
+        size_t matched = 0;
+        while (matched < needle_len && seg_cursor_next(&probe) == (uint8_t)needle[matched]) {
+            matched++;
+        }
+        if (matched == needle_len) {
+            *cur = probe;
+            return true;
+        }
+        seg_cursor_advance(cur, 1);
+    }
+}
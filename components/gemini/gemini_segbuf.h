@@ -0,0 +1,121 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One fixed-size block of a segmented buffer (CONFIG_GEMINI_RESPONSE_BLOCK_SIZE bytes of data)
+ */
+typedef struct seg_block {
+    struct seg_block *next;
+    size_t len;
+    uint8_t data[];
+} seg_block_t;
+
+/**
+ * HTTP response body held as a chain of PSRAM blocks, so memory follows the
+ * actual response size and nothing has to be sized up front. Blocks come from
+ * a small shared pool and return to it on seg_buf_free(). Zero-initialize
+ * before use.
+ */
+typedef struct {
+    seg_block_t *head;
+    seg_block_t *tail;
+    size_t len;
+    size_t blocks;
+} seg_buf_t;
+
+/**
+ * Read position in a seg_buf_t; reads step across block boundaries transparently
+ */
+typedef struct {
+    const seg_block_t *block;
+    size_t offset;  // Within block
+    size_t pos;     // From the start of the buffer
+} seg_cursor_t;
+
+/**
+ * Append bytes, taking new blocks as needed
+ *
+ * @param buf: Buffer
+ * @param data: Bytes to append
+ * @param len: Number of bytes
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if no block could be allocated,
+ *         ESP_ERR_INVALID_SIZE if the body would exceed CONFIG_GEMINI_RESPONSE_MAX_KB
+ */
+esp_err_t seg_buf_append(seg_buf_t *buf, const uint8_t *data, size_t len);
+
+/**
+ * Copy the whole body into one NUL-terminated allocation (for cJSON_Parse)
+ *
+ * @param buf: Buffer
+ * @return String to free(), or NULL if the buffer is empty or out of memory
+ */
+char *seg_buf_flatten(const seg_buf_t *buf);
+
+/**
+ * Copy up to out_len - 1 bytes starting at `from` into out and NUL-terminate (for logging)
+ *
+ * @return Number of bytes copied
+ */
+size_t seg_buf_copy(const seg_buf_t *buf, size_t from, char *out, size_t out_len);
+
+/**
+ * Return all blocks to the pool and reset the buffer
+ */
+void seg_buf_free(seg_buf_t *buf);
+
+/**
+ * Release pooled blocks that are not in use
+ */
+void seg_buf_pool_trim(void);
+
+/**
+ * Position a cursor at the start of the buffer
+ */
+void seg_cursor_init(seg_cursor_t *cur, const seg_buf_t *buf);
+
+/**
+ * Next byte without consuming it
+ * @return Byte value, or -1 at the end of the buffer
+ */
+int seg_cursor_peek(seg_cursor_t *cur);
+
+/**
+ * Consume and return the next byte
+ * @return Byte value, or -1 at the end of the buffer
+ */
+int seg_cursor_next(seg_cursor_t *cur);
+
+/**
+ * Contiguous bytes readable at the cursor without crossing a block boundary
+ *
+ * @param cur: Cursor
+ * @param data: Set to the first readable byte
+ * @return Number of bytes at *data, 0 at the end of the buffer
+ */
+size_t seg_cursor_span(seg_cursor_t *cur, const uint8_t **data);
+
+/**
+ * Skip forward by up to n bytes
+ */
+void seg_cursor_advance(seg_cursor_t *cur, size_t n);
+
+/**
+ * Advance just past the next occurrence of needle, which may straddle blocks
+ *
+ * @param cur: Cursor, left at the end of the buffer if needle is not found
+ * @param needle: Non-empty byte string
+ * @return true if found
+ */
+bool seg_cursor_find(seg_cursor_t *cur, const char *needle);
+
+#ifdef __cplusplus
+}
+#endif
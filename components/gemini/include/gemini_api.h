@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include "gemini_conversation.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -64,6 +65,22 @@ esp_err_t gemini_llm_with_functions(const char *prompt, const char *tools_json,
                                      char *response, size_t response_len,
                                      gemini_function_call_t *function_call);
 
+/**
+ * LLM with function calling and conversation history
+ * The stored turns are sent ahead of the prompt; the caller records the completed
+ * exchange with gemini_conversation_add() (the spoken reply for function calls).
+ * @param conversation: Prior turns (NULL for a single-shot request)
+ * @param prompt: Input text prompt
+ * @param tools_json: JSON string defining available functions/tools (NULL if none)
+ * @param response: Buffer to store LLM text response
+ * @param response_len: Size of response buffer
+ * @param function_call: Output function call if LLM wants to call a function (can be NULL)
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if function call detected (check function_call)
+ */
+esp_err_t gemini_llm_converse(gemini_conversation_t *conversation, const char *prompt, const char *tools_json,
+                              char *response, size_t response_len,
+                              gemini_function_call_t *function_call);
+
 /**
  * Text-to-Speech: Convert text to audio using Gemini
  * @param text: Text to synthesize
@@ -94,6 +111,24 @@ typedef esp_err_t (*gemini_tts_playback_callback_t)(const int16_t *samples, size
  */
 esp_err_t gemini_tts_streaming(const char *text, gemini_tts_playback_callback_t callback, void *user_data);
 
+/**
+ * Speculatively open TLS connections to the STT and LLM hosts
+ * Call on wake word so the handshakes overlap with recording; the next
+ * gemini_stt()/gemini_llm*() requests reuse the connections, unused ones are
+ * closed after CONFIG_GEMINI_PREWARM_HOLD_MS. Returns immediately.
+ * @return ESP_OK if pre-connects were started
+ */
+esp_err_t gemini_api_prewarm(void);
+
+/**
+ * Set the system instruction sent with gemini_llm_with_functions()
+ * With CONFIG_GEMINI_CONTEXT_CACHE_ENABLED the instruction and tool schema are
+ * uploaded once as a Gemini cachedContents resource and referenced by name,
+ * recreated when it expires or the content changes.
+ * @param instruction: Static string kept by reference (NULL for none)
+ */
+void gemini_api_set_system_instruction(const char *instruction);
+
 /**
  * Deinitialize Gemini API client
  */
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Speaker of a conversation turn
+ */
+typedef enum {
+    GEMINI_ROLE_USER = 0,
+    GEMINI_ROLE_MODEL,
+} gemini_role_t;
+
+/**
+ * Bounded history of prior turns sent ahead of each prompt by gemini_llm_converse()
+ *
+ * Turns are kept in one arena of budget_bytes (roughly 4 bytes per token). When a
+ * new turn doesn't fit, or CONFIG_GEMINI_CONVERSATION_MAX_TURNS is reached, the
+ * oldest user/model exchange is evicted. Long model replies are clipped to their
+ * leading sentences when stored. The history is cleared after
+ * CONFIG_GEMINI_CONVERSATION_IDLE_S without a turn. Not thread-safe: use from one task.
+ */
+typedef struct gemini_conversation gemini_conversation_t;
+
+/**
+ * Create an empty conversation
+ * @param budget_bytes: Text budget for the stored turns, 0 for CONFIG_GEMINI_CONVERSATION_BUDGET_BYTES
+ * @return Conversation handle, or NULL if out of memory
+ */
+gemini_conversation_t *gemini_conversation_create(size_t budget_bytes);
+
+/**
+ * Append a completed turn, evicting old exchanges to stay within budget
+ * @param conv: Conversation handle
+ * @param role: Who spoke
+ * @param text: Turn text (copied)
+ * @return ESP_OK on success
+ */
+esp_err_t gemini_conversation_add(gemini_conversation_t *conv, gemini_role_t role, const char *text);
+
+/**
+ * Number of turns currently held
+ * @param conv: Conversation handle
+ * @return Turn count (0 after idle expiry)
+ */
+size_t gemini_conversation_turn_count(gemini_conversation_t *conv);
+
+/**
+ * Forget all turns
+ * @param conv: Conversation handle
+ */
+void gemini_conversation_clear(gemini_conversation_t *conv);
+
+/**
+ * Free the conversation
+ * @param conv: Conversation handle (may be NULL)
+ */
+void gemini_conversation_destroy(gemini_conversation_t *conv);
+
+#ifdef __cplusplus
+}
+#endif
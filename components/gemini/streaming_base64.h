@@ -1,7 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
-#include "mbedtls/base64.h"
+#include "fast_base64.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -21,14 +21,24 @@ static inline void streaming_base64_decoder_init(streaming_base64_decoder_t *dec
     dec->started = false;
 }
 
+static inline esp_err_t streaming_base64_map_err(esp_err_t err) {
+    if (err == ESP_ERR_INVALID_SIZE) {
+        return ESP_ERR_NO_MEM;
+    }
+    return err == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
 /**
  * Decode base64 data incrementally
+ * Complete groups are decoded straight from input; only a group split across
+ * calls goes through the pending buffer. Input of any length is accepted.
+ * After an error the decoder must be re-initialized.
  * @param dec: decoder state
  * @param input: base64 input data
  * @param input_len: length of input
  * @param output: decoded PCM data output buffer
  * @param output_len: IN: capacity, OUT: bytes written
- * @return ESP_OK on success, ESP_ERR_NO_MEM if output buffer too small
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if output buffer too small, ESP_FAIL on malformed base64
  */
 static inline esp_err_t streaming_base64_decode(
     streaming_base64_decoder_t *dec,
@@ -43,58 +53,45 @@ static inline esp_err_t streaming_base64_decode(
 
     size_t out_pos = 0;
     size_t out_cap = *output_len;
+    dec->started = true;
 
-    // Combine pending bytes with new input for processing
-    size_t to_process = input_len + dec->pending_len;
-
-    // Process complete 4-byte base64 groups (decode to 3 bytes)
-    size_t complete_groups = to_process / 4;
-    size_t remainder = to_process % 4;
-
-    // Create a temporary buffer if we have pending bytes
-    uint8_t temp_input[256];
-    size_t temp_len = 0;
-
+    // Complete a group left over from the previous call
     if (dec->pending_len > 0) {
-        // Copy pending bytes to temp buffer
-        memcpy(temp_input, dec->pending, dec->pending_len);
-        temp_len = dec->pending_len;
-
-        // Copy new input bytes
-        memcpy(temp_input + temp_len, input, input_len);
-        temp_len += input_len;
-    } else {
-        memcpy(temp_input, input, input_len);
-        temp_len = input_len;
-    }
+        size_t take = 4 - dec->pending_len;
+        if (take > input_len) {
+            take = input_len;
+        }
+        memcpy(dec->pending + dec->pending_len, input, take);
+        dec->pending_len += take;
+        input += take;
+        input_len -= take;
+        if (dec->pending_len < 4) {
+            *output_len = 0;
+            return ESP_OK;
+        }
 
-    // Decode complete 4-byte groups
-    if (complete_groups > 0) {
-        size_t decoded_len = 0;
-        int ret = mbedtls_base64_decode(
-            output,
-            out_cap,
-            &decoded_len,
-            temp_input,
-            complete_groups * 4);
-
-        if (ret != 0) {
-            return ESP_FAIL;
+        esp_err_t err = fast_base64_decode(output, out_cap, &out_pos, (const char *)dec->pending, 4);
+        if (err != ESP_OK) {
+            return streaming_base64_map_err(err);
         }
+        dec->pending_len = 0;
+    }
 
-        out_pos = decoded_len;
-        if (out_pos > out_cap) {
-            return ESP_ERR_NO_MEM;
+    // Decode complete 4-byte groups in place
+    size_t bulk = input_len & ~(size_t)3;
+    if (bulk > 0) {
+        size_t decoded_len = 0;
+        esp_err_t err = fast_base64_decode(output + out_pos, out_cap - out_pos, &decoded_len,
+                                           (const char *)input, bulk);
+        if (err != ESP_OK) {
+            return streaming_base64_map_err(err);
         }
+        out_pos += decoded_len;
     }
 
     // Save remainder for next call
-    if (remainder > 0) {
-        memcpy(dec->pending, temp_input + (complete_groups * 4), remainder);
-        dec->pending_len = remainder;
-    } else {
-        dec->pending_len = 0;
-    }
+    dec->pending_len = input_len - bulk;
+    memcpy(dec->pending, input + bulk, dec->pending_len);
 
     *output_len = out_pos;
     return ESP_OK;
@@ -128,12 +125,12 @@ static inline esp_err_t streaming_base64_decode_finish(
     memset(padded + dec->pending_len, '=', 4 - dec->pending_len);
 
     size_t decoded_len = 0;
-    int ret = mbedtls_base64_decode(output, *output_len, &decoded_len, padded, 4);
+    esp_err_t err = fast_base64_decode(output, *output_len, &decoded_len, (const char *)padded, 4);
 
     dec->pending_len = 0;
 
-    if (ret != 0) {
-        return ESP_FAIL;
+    if (err != ESP_OK) {
+        return streaming_base64_map_err(err);
     }
 
     *output_len = decoded_len;
@@ -0,0 +1,317 @@
+/**
+ * @file gzip_stream.c
+ * @brief Incremental gzip (RFC 1952) decoder on top of the ROM tinfl inflater
+ *
+ * Input can arrive in arbitrary pieces (HTTP_EVENT_ON_DATA chunks). The gzip
+ * header and trailer are parsed byte-wise; the deflate body is inflated into a
+ * single circular 32 KB window that is flushed to the sink whenever it fills or
+ * the input runs out, so no full-size output buffer is ever needed.
+ */
+
+#include "gzip_stream.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "rom/miniz.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "gzip_stream";
+
+// gzip header flags
+#define GZ_FHCRC     0x02
+#define GZ_FEXTRA    0x04
+#define GZ_FNAME     0x08
+#define GZ_FCOMMENT  0x10
+
+typedef enum {
+    GZ_STATE_HEADER = 0,   // 10 fixed bytes
+    GZ_STATE_EXTRA_LEN,
+    GZ_STATE_EXTRA,
+    GZ_STATE_NAME,
+    GZ_STATE_COMMENT,
+    GZ_STATE_HCRC,
+    GZ_STATE_DEFLATE,
+    GZ_STATE_TRAILER,      // CRC32 + ISIZE
+    GZ_STATE_DONE,
+    GZ_STATE_ERROR,
+} gz_state_t;
+
+struct gzip_stream {
+    tinfl_decompressor inflator;
+    uint8_t window[TINFL_LZ_DICT_SIZE];
+    size_t window_ofs;
+    gz_state_t state;
+    uint8_t scratch[10];   // Header / trailer bytes collected so far
+    size_t scratch_len;
+    uint8_t flags;
+    uint16_t skip;         // Remaining FEXTRA bytes
+    uint32_t crc;
+    size_t total_out;
+    gzip_stream_sink_t sink;
+    void *ctx;
+};
+
+gzip_stream_t *gzip_stream_create(gzip_stream_sink_t sink, void *ctx)
+{
+    if (!sink) {
+        return NULL;
+    }
+    gzip_stream_t *stream = heap_caps_malloc(sizeof(gzip_stream_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!stream) {
+        stream = malloc(sizeof(gzip_stream_t));
+        if (!stream) {
+            return NULL;
+        }
+    }
+    memset(stream, 0, offsetof(gzip_stream_t, window));
+    tinfl_init(&stream->inflator);
+    stream->window_ofs = 0;
+    stream->state = GZ_STATE_HEADER;
+    stream->scratch_len = 0;
+    stream->flags = 0;
+    stream->skip = 0;
+    stream->crc = 0;
+    stream->total_out = 0;
+    stream->sink = sink;
+    stream->ctx = ctx;
+    return stream;
+}
+
+// Advance to the next optional header field after `from`
+static gz_state_t next_header_state(uint8_t flags, gz_state_t from)
+{
+    switch (from) {
+        case GZ_STATE_HEADER:
+            if (flags & GZ_FEXTRA) return GZ_STATE_EXTRA_LEN;
+            // fallthrough
+        case GZ_STATE_EXTRA:
+            if (flags & GZ_FNAME) return GZ_STATE_NAME;
+            // fallthrough
+        case GZ_STATE_NAME:
+            if (flags & GZ_FCOMMENT) return GZ_STATE_COMMENT;
+            // fallthrough
+        case GZ_STATE_COMMENT:
+            if (flags & GZ_FHCRC) return GZ_STATE_HCRC;
+            // fallthrough
+        default:
+            return GZ_STATE_DEFLATE;
+    }
+}
+
+static esp_err_t inflate_some(gzip_stream_t *stream, const uint8_t *data, size_t len, size_t *consumed)
+{
+    *consumed = 0;
+    while (true) {
+        size_t in_bytes = len - *consumed;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - stream->window_ofs;
+        tinfl_status status = tinfl_decompress(&stream->inflator,
+                                               data + *consumed, &in_bytes,
+                                               stream->window, stream->window + stream->window_ofs, &out_bytes,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        *consumed += in_bytes;
+
+        if (out_bytes > 0) {
+            const uint8_t *out = stream->window + stream->window_ofs;
+            stream->crc = esp_rom_crc32_le(stream->crc, out, out_bytes);
+            stream->total_out += out_bytes;
+            esp_err_t err = stream->sink(out, out_bytes, stream->ctx);
+            if (err != ESP_OK) {
+                return err;
+            }
+            stream->window_ofs = (stream->window_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (status == TINFL_STATUS_DONE) {
+            // The ROM inflater reads ahead and may already hold the first trailer
+            // bytes in its bit buffer; hand them back to the trailer. Without a zlib
+            // wrapper it does not byte-align the buffer at the end: the low
+            // m_num_bits & 7 bits are the padding of the last deflate byte.
+            stream->state = GZ_STATE_TRAILER;
+            stream->scratch_len = 0;
+            uint32_t pad = stream->inflator.m_num_bits & 7;
+            uint64_t bit_buf = (uint64_t)stream->inflator.m_bit_buf >> pad;
+            for (uint32_t bits = stream->inflator.m_num_bits - pad; bits >= 8 && stream->scratch_len < 8; bits -= 8) {
+                stream->scratch[stream->scratch_len++] = (uint8_t)bit_buf;
+                bit_buf >>= 8;
+            }
+            if (stream->scratch_len == 8) {
+                stream->state = GZ_STATE_DONE;
+            }
+            return ESP_OK;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT && *consumed >= len) {
+            return ESP_OK;
+        }
+        if (in_bytes == 0 && out_bytes == 0) {
+            return ESP_OK;  // No progress possible with this input
+        }
+    }
+}
+
+esp_err_t gzip_stream_feed(gzip_stream_t *stream, const uint8_t *data, size_t len)
+{
+    if (!stream || (!data && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t pos = 0;
+    while (pos < len) {
+        switch (stream->state) {
+            case GZ_STATE_HEADER:
+                stream->scratch[stream->scratch_len++] = data[pos++];
+                if (stream->scratch_len == 10) {
+                    // ID1 ID2 CM=8 (deflate)
+                    if (stream->scratch[0] != 0x1f || stream->scratch[1] != 0x8b || stream->scratch[2] != 8) {
+                        stream->state = GZ_STATE_ERROR;
+                        return ESP_ERR_INVALID_RESPONSE;
+                    }
+                    stream->flags = stream->scratch[3];
+                    stream->scratch_len = 0;
+                    stream->state = next_header_state(stream->flags, GZ_STATE_HEADER);
+                }
+                break;
+            case GZ_STATE_EXTRA_LEN:
+                stream->scratch[stream->scratch_len++] = data[pos++];
+                if (stream->scratch_len == 2) {
+                    stream->skip = stream->scratch[0] | (stream->scratch[1] << 8);
+                    stream->scratch_len = 0;
+                    stream->state = stream->skip ? GZ_STATE_EXTRA : next_header_state(stream->flags, GZ_STATE_EXTRA);
+                }
+                break;
+            case GZ_STATE_EXTRA: {
+                size_t n = len - pos < stream->skip ? len - pos : stream->skip;
+                pos += n;
+                stream->skip -= n;
+                if (stream->skip == 0) {
+                    stream->state = next_header_state(stream->flags, GZ_STATE_EXTRA);
+                }
+                break;
+            }
+            case GZ_STATE_NAME:
+            case GZ_STATE_COMMENT: {
+                const uint8_t *nul = memchr(data + pos, 0, len - pos);
+                if (!nul) {
+                    pos = len;
+                } else {
+                    pos = (size_t)(nul - data) + 1;
+                    stream->state = next_header_state(stream->flags, stream->state);
+                }
+                break;
+            }
+            case GZ_STATE_HCRC:
+                pos++;
+                if (++stream->scratch_len == 2) {
+                    stream->scratch_len = 0;
+                    stream->state = GZ_STATE_DEFLATE;
+                }
+                break;
+            case GZ_STATE_DEFLATE: {
+                size_t consumed = 0;
+                esp_err_t err = inflate_some(stream, data + pos, len - pos, &consumed);
+                if (err != ESP_OK) {
+                    stream->state = GZ_STATE_ERROR;
+                    return err;
+                }
+                pos += consumed;
+                if (stream->state == GZ_STATE_DEFLATE && consumed == 0) {
+                    return ESP_OK;
+                }
+                break;
+            }
+            case GZ_STATE_TRAILER:
+                stream->scratch[stream->scratch_len++] = data[pos++];
+                if (stream->scratch_len == 8) {
+                    stream->state = GZ_STATE_DONE;
+                }
+                break;
+            case GZ_STATE_DONE:
+                return ESP_OK;  // Ignore trailing garbage / concatenated members
+            case GZ_STATE_ERROR:
+            default:
+                return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gzip_stream_finish(gzip_stream_t *stream)
+{
+    if (!stream) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stream->state == GZ_STATE_ERROR) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (stream->state != GZ_STATE_DONE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint8_t *t = stream->scratch;
+    uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    uint32_t isize = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    if (crc != stream->crc || isize != (uint32_t)stream->total_out) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gzip_stream_handle_header(gzip_stream_t **stream, const char *key, const char *value,
+                                    gzip_stream_sink_t sink, void *ctx)
+{
+    if (!stream || !key || !value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (*stream || strcasecmp(key, "Content-Encoding") != 0 || strcasecmp(value, "gzip") != 0) {
+        return ESP_OK;
+    }
+    *stream = gzip_stream_create(sink, ctx);
+    if (!*stream) {
+        ESP_LOGE(TAG, "Failed to allocate gzip decoder");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gzip_stream_handle_data(gzip_stream_t *stream, const uint8_t *data, size_t len,
+                                  gzip_stream_sink_t sink, void *ctx)
+{
+    if (stream) {
+        return gzip_stream_feed(stream, data, len);
+    }
+    return sink ? sink(data, len, ctx) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gzip_stream_close(gzip_stream_t **stream)
+{
+    if (!stream || !*stream) {
+        return ESP_OK;
+    }
+    esp_err_t err = gzip_stream_finish(*stream);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Inflated gzip body to %zu bytes", (*stream)->total_out);
+    } else {
+        ESP_LOGE(TAG, "gzip body rejected after %zu bytes: %s", (*stream)->total_out, esp_err_to_name(err));
+    }
+    gzip_stream_destroy(*stream);
+    *stream = NULL;
+    return err;
+}
+
+size_t gzip_stream_total_out(const gzip_stream_t *stream)
+{
+    return stream ? stream->total_out : 0;
+}
+
+void gzip_stream_destroy(gzip_stream_t *stream)
+{
+    if (stream) {
+        heap_caps_free(stream);
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Receives inflated bytes as they are produced
+ * @param data: Decompressed bytes (valid only during the call)
+ * @param len: Number of bytes
+ * @param ctx: User context
+ * @return ESP_OK to continue, any error aborts the stream
+ */
+typedef esp_err_t (*gzip_stream_sink_t)(const uint8_t *data, size_t len, void *ctx);
+
+typedef struct gzip_stream gzip_stream_t;
+
+/**
+ * @brief Create a streaming gzip decoder
+ * Uses the ROM inflater with one fixed 32 KB window (PSRAM preferred), so
+ * memory use does not depend on the response size.
+ * @param sink: Callback for decompressed data
+ * @param ctx: User context passed to the sink
+ * @return Decoder handle, or NULL on allocation failure
+ */
+gzip_stream_t *gzip_stream_create(gzip_stream_sink_t sink, void *ctx);
+
+/**
+ * @brief Feed compressed bytes (any split, e.g. straight from HTTP_EVENT_ON_DATA)
+ * @param stream: Decoder handle
+ * @param data: Compressed input
+ * @param len: Input length
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE on corrupt input, or the sink's error
+ */
+esp_err_t gzip_stream_feed(gzip_stream_t *stream, const uint8_t *data, size_t len);
+
+/**
+ * @brief Check that the stream ended with a valid trailer (CRC32 and length)
+ * @param stream: Decoder handle
+ * @return ESP_OK if complete and intact, ESP_ERR_INVALID_SIZE if truncated,
+ *         ESP_ERR_INVALID_CRC on checksum mismatch
+ */
+esp_err_t gzip_stream_finish(gzip_stream_t *stream);
+
+/**
+ * @brief Start decoding when a response header announces a gzip body
+ * For HTTP_EVENT_ON_HEADER: creates the decoder in `*stream` on
+ * "Content-Encoding: gzip" unless one already exists; other headers are ignored.
+ * @param stream: Decoder slot of the response
+ * @param key: Header name
+ * @param value: Header value
+ * @param sink: Callback for decompressed data
+ * @param ctx: User context passed to the sink
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the decoder cannot be allocated
+ */
+esp_err_t gzip_stream_handle_header(gzip_stream_t **stream, const char *key, const char *value,
+                                    gzip_stream_sink_t sink, void *ctx);
+
+/**
+ * @brief Route a body chunk (HTTP_EVENT_ON_DATA) through the decoder if one was started
+ * @param stream: Decoder of the response, or NULL for an uncompressed body
+ * @param data: Body bytes as received
+ * @param len: Number of bytes
+ * @param sink: Receives the bytes directly when `stream` is NULL
+ * @param ctx: User context passed to the sink
+ * @return As gzip_stream_feed(), or the sink's result for an uncompressed body
+ */
+esp_err_t gzip_stream_handle_data(gzip_stream_t *stream, const uint8_t *data, size_t len,
+                                  gzip_stream_sink_t sink, void *ctx);
+
+/**
+ * @brief Finish and free the decoder of a response, if one was started
+ * @param stream: Decoder slot of the response (NULL afterwards)
+ * @return ESP_OK if no decoder was started or the body is complete and intact,
+ *         otherwise the error of gzip_stream_finish()
+ */
+esp_err_t gzip_stream_close(gzip_stream_t **stream);
+
+/**
+ * @brief Total decompressed bytes delivered so far
+ */
+size_t gzip_stream_total_out(const gzip_stream_t *stream);
+
+/**
+ * @brief Free a decoder
+ */
+void gzip_stream_destroy(gzip_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,280 @@
+/**
+ * @file test_gzip_stream.c
+ * @brief Inflate, trailer and response-helper tests for gzip_stream
+ *
+ * The fixture is a gzip member (level 9, mtime 0) of JSON lines that the tests
+ * regenerate in memory, so the decoded output can be compared byte for byte.
+ * Feeding it in every split size makes the ROM inflater stop at the end of the
+ * deflate stream with trailer bytes still in its look-ahead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "gzip_stream.h"
+
+static const char *TAG = "test_gzip_stream";
+
+#define FIXTURE_LINES 300
+#define PLAIN_MAX     16384
+
+// gzip -9 of FIXTURE_LINES lines from build_plain()
+static const uint8_t s_fixture[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x95, 0x9a, 0xcd, 0x6a, 0x1d, 0x67,
+    0x14, 0x04, 0xf7, 0x7e, 0x0c, 0xad, 0xbd, 0x98, 0xee, 0xef, 0x3f, 0x6f, 0x13, 0x88, 0xc0, 0x5a,
+    0xd8, 0x0e, 0xb2, 0xbc, 0x08, 0x26, 0xef, 0x1e, 0x93, 0x85, 0x99, 0x3e, 0x82, 0xbe, 0xee, 0xa5,
+    0xe0, 0x20, 0xc4, 0x2d, 0xa4, 0xd2, 0xf4, 0xd4, 0x8f, 0xa7, 0x6f, 0xcf, 0x5f, 0xbe, 0x7d, 0x7d,
+    0x7d, 0xfa, 0xe3, 0xfa, 0xf8, 0xf4, 0xf6, 0xfc, 0xf9, 0xef, 0xe7, 0xd7, 0x3f, 0xdf, 0xbe, 0xbf,
+    0x3e, 0xff, 0xff, 0xf5, 0xa7, 0xef, 0x9f, 0x5f, 0xfe, 0x7a, 0x79, 0xfb, 0xe7, 0xe7, 0x17, 0xff,
+    0x7e, 0xf8, 0xf1, 0xeb, 0x12, 0xe5, 0x72, 0xdd, 0x2f, 0xd1, 0xee, 0xa7, 0x2c, 0xa7, 0xe8, 0xf7,
+    0x5b, 0xce, 0xfb, 0x6d, 0x2b, 0xb7, 0xc4, 0xfd, 0xb6, 0x9d, 0xfb, 0x6d, 0xaf, 0xb7, 0xfb, 0x7e,
+    0x3b, 0x78, 0xbf, 0x1d, 0xe5, 0xb6, 0x8d, 0xfb, 0xed, 0x1c, 0xf7, 0xdb, 0x59, 0xbf, 0xef, 0xfd,
+    0x74, 0xed, 0xfb, 0xe9, 0x2a, 0xa7, 0xe7, 0x7e, 0x7a, 0x70, 0x3f, 0xdd, 0xf5, 0x53, 0x98, 0xf7,
+    0xdb, 0x7e, 0x3f, 0x3d, 0xf5, 0x07, 0x68, 0xf2, 0xe1, 0x2e, 0xe1, 0x50, 0x91, 0x35, 0x61, 0xd6,
+    0x14, 0x5a, 0xa5, 0xd6, 0x04, 0x5b, 0x17, 0x6c, 0xa8, 0xdc, 0x04, 0xdb, 0x10, 0x6c, 0xa8, 0xdc,
+    0x20, 0xdc, 0xa6, 0x70, 0x43, 0x05, 0x07, 0x01, 0xb7, 0x05, 0x1c, 0x2a, 0x39, 0x0a, 0xb9, 0x23,
+    0xe4, 0x50, 0xd1, 0x35, 0x61, 0x27, 0xe8, 0x50, 0xd9, 0x35, 0x81, 0x47, 0x81, 0x87, 0x4a, 0x4f,
+    0xe0, 0x35, 0xa1, 0x87, 0x8a, 0x0f, 0x82, 0xaf, 0x0b, 0x3e, 0x56, 0x7c, 0x14, 0x7c, 0x53, 0xf0,
+    0xb1, 0xe2, 0xa3, 0xe0, 0x5b, 0xfa, 0x5b, 0x57, 0xf1, 0x35, 0xe1, 0xb7, 0x85, 0x1f, 0xdf, 0xf1,
+    0x93, 0x0f, 0x59, 0xf0, 0xb1, 0xe2, 0x13, 0x7a, 0x10, 0x7a, 0xac, 0xf4, 0x20, 0xf4, 0x28, 0xf4,
+    0xf8, 0xee, 0x17, 0x4f, 0xe8, 0x35, 0xc1, 0xc7, 0x8a, 0x8f, 0x82, 0x6f, 0x08, 0x3e, 0x56, 0x7c,
+    0x4d, 0xf8, 0x4d, 0xe1, 0xc7, 0xca, 0x4f, 0xf0, 0x2d, 0xc1, 0xd7, 0x2a, 0x3e, 0x08, 0xbe, 0x23,
+    0xf8, 0x5a, 0xc5, 0x07, 0xc1, 0x27, 0xf4, 0x5a, 0xa5, 0x47, 0xa1, 0x07, 0xfd, 0xa3, 0x59, 0xe9,
+    0x35, 0xc1, 0x47, 0xc1, 0xd7, 0x2a, 0xbe, 0x26, 0xfc, 0xba, 0xf0, 0x6b, 0x95, 0x9f, 0xe0, 0x1b,
+    0x82, 0xaf, 0x55, 0x7c, 0x10, 0x7c, 0x53, 0xf0, 0xb5, 0x8a, 0x0f, 0x82, 0x6f, 0x0b, 0xbe, 0x56,
+    0xf1, 0x51, 0xf0, 0x1d, 0xc1, 0xd7, 0xde, 0xe1, 0x53, 0x7e, 0x62, 0x10, 0xeb, 0x3b, 0x0a, 0xbd,
+    0x6e, 0x8d, 0xd7, 0x84, 0x5e, 0xf7, 0xca, 0xeb, 0x42, 0xaf, 0x7b, 0xe7, 0x0d, 0x75, 0x9e, 0x97,
+    0xde, 0x12, 0x7a, 0xdd, 0x5b, 0x6f, 0x0b, 0xbe, 0x6e, 0xb5, 0x77, 0x84, 0x5e, 0xb7, 0xde, 0x83,
+    0xc0, 0xeb, 0x5e, 0x7c, 0x14, 0x78, 0xdd, 0xab, 0xaf, 0x09, 0xbd, 0xe1, 0xd5, 0x37, 0x04, 0xdf,
+    0xf0, 0xea, 0x9b, 0xc2, 0x6f, 0x58, 0xf5, 0x2d, 0xc1, 0x37, 0xbc, 0xfa, 0xb6, 0xe0, 0x1b, 0x5e,
+    0x7d, 0xfa, 0x2f, 0x8b, 0x37, 0x1f, 0x84, 0xde, 0xf0, 0xe6, 0xa3, 0xe0, 0x1b, 0x5e, 0x7d, 0x5d,
+    0xf8, 0x0d, 0xab, 0xbe, 0x21, 0xf8, 0x86, 0x57, 0xdf, 0x14, 0x7c, 0xd3, 0xab, 0x6f, 0x0b, 0xbe,
+    0xe9, 0xd5, 0x77, 0x04, 0xdf, 0xf4, 0xea, 0x13, 0x7c, 0xd3, 0x9a, 0x0f, 0x42, 0x6f, 0x5a, 0xf3,
+    0x35, 0xa1, 0x37, 0xbd, 0xf9, 0xba, 0xfe, 0xc7, 0xe9, 0xcd, 0x37, 0x84, 0xde, 0xf4, 0xe6, 0x5b,
+    0x42, 0x6f, 0x7a, 0xf3, 0x6d, 0xc1, 0x37, 0xad, 0xf9, 0x8e, 0xd0, 0x5b, 0xde, 0x7c, 0x10, 0x7a,
+    0xcb, 0x9b, 0x8f, 0x42, 0x6f, 0x79, 0xf5, 0x35, 0xc1, 0xb7, 0xbc, 0xfa, 0xba, 0xf0, 0x5b, 0x5e,
+    0x7d, 0x53, 0x00, 0x2e, 0xab, 0xbe, 0x25, 0xfc, 0x96, 0x57, 0xdf, 0xd6, 0x67, 0x06, 0xaf, 0x3e,
+    0xc1, 0xb7, 0xbc, 0xf9, 0x20, 0xf8, 0x96, 0x37, 0x1f, 0x85, 0xdf, 0xb6, 0xea, 0xeb, 0x82, 0x6f,
+    0x5b, 0xf5, 0x0d, 0xa1, 0xb7, 0xbd, 0xfa, 0xa6, 0xd0, 0xdb, 0x5e, 0x7d, 0x4b, 0xe8, 0x6d, 0xaf,
+    0xbe, 0x23, 0xf4, 0xb6, 0x57, 0x9f, 0xd0, 0xdb, 0xd6, 0x7c, 0x10, 0x78, 0xdb, 0x9a, 0xaf, 0xe9,
+    0x13, 0xdf, 0x83, 0x47, 0x3e, 0x81, 0xb7, 0xbd, 0xf9, 0x86, 0xc0, 0x3b, 0xde, 0x7c, 0x4b, 0xe8,
+    0x1d, 0x6f, 0xbe, 0x2d, 0xf8, 0x8e, 0x35, 0xdf, 0x11, 0x7a, 0xc7, 0x9b, 0x4f, 0xe0, 0x9d, 0x07,
+    0xe2, 0x13, 0x78, 0xc7, 0x9b, 0xaf, 0x09, 0xbd, 0xe3, 0xcd, 0xd7, 0x05, 0xdf, 0xf1, 0xe6, 0x9b,
+    0xc2, 0xef, 0x58, 0xf3, 0x2d, 0x7d, 0x64, 0xf7, 0xe6, 0xdb, 0xe5, 0x99, 0xdd, 0xab, 0x4f, 0x9f,
+    0xd9, 0x2f, 0xaf, 0x3e, 0xdd, 0x5a, 0x70, 0x79, 0xf7, 0xe9, 0xda, 0x82, 0xcb, 0xda, 0x4f, 0xe7,
+    0x16, 0x5c, 0x56, 0x7f, 0xba, 0xb7, 0xe0, 0xf2, 0xfe, 0xd3, 0xc5, 0x05, 0x97, 0x17, 0xa0, 0x8e,
+    0x2e, 0xb8, 0xbc, 0x01, 0x75, 0x77, 0xc1, 0xe5, 0x15, 0xa8, 0xcf, 0xee, 0x97, 0x55, 0x60, 0x99,
+    0x5e, 0xe0, 0x1d, 0x58, 0xb7, 0x17, 0x2f, 0xc1, 0x32, 0xbe, 0xc0, 0x5b, 0xb0, 0xcc, 0x2f, 0xf0,
+    0x1a, 0x2c, 0xfb, 0x0b, 0xbc, 0x07, 0xcb, 0x00, 0x03, 0x2b, 0xc2, 0x32, 0xc0, 0xe0, 0x81, 0x09,
+    0xf5, 0xd8, 0x9b, 0xb0, 0x4c, 0x30, 0xf0, 0x2e, 0x2c, 0x23, 0x0c, 0xbc, 0x0c, 0x75, 0x85, 0x01,
+    0xad, 0x0d, 0x75, 0x85, 0x01, 0xad, 0x0e, 0x57, 0x19, 0xd1, 0xbc, 0x0f, 0x75, 0x86, 0x01, 0xbd,
+    0x10, 0x75, 0x88, 0x01, 0xbd, 0x11, 0x75, 0x8a, 0x01, 0xbd, 0x12, 0x75, 0x8b, 0x01, 0xad, 0x14,
+    0x75, 0x8b, 0x01, 0xad, 0x15, 0x75, 0x8b, 0x01, 0xbd, 0x16, 0x75, 0x8c, 0x01, 0xbd, 0x17, 0x75,
+    0x8e, 0x41, 0xf3, 0x62, 0xd4, 0x3d, 0x06, 0xcd, 0x9b, 0x51, 0x41, 0x36, 0x6b, 0x46, 0x94, 0x39,
+    0xd4, 0xab, 0x51, 0x17, 0x19, 0x34, 0x2f, 0x47, 0x9d, 0x64, 0xd0, 0xbc, 0x1d, 0x75, 0x94, 0x41,
+    0xf3, 0x7a, 0xd4, 0x55, 0x06, 0xcd, 0xfb, 0x51, 0x67, 0x19, 0x34, 0x2b, 0x48, 0x9d, 0x65, 0xd0,
+    0xbc, 0x21, 0x95, 0x63, 0xf7, 0x82, 0xd4, 0x65, 0x06, 0xdd, 0x1b, 0x52, 0xb7, 0x19, 0x74, 0x6f,
+    0x48, 0x1d, 0x67, 0xd0, 0xad, 0x21, 0x47, 0x19, 0xb6, 0xad, 0x21, 0x75, 0x9c, 0x41, 0xf7, 0x86,
+    0xd4, 0x75, 0x06, 0xdd, 0x1b, 0x52, 0xf7, 0x19, 0x74, 0x6f, 0x48, 0x5d, 0x68, 0xd0, 0xbd, 0x21,
+    0x75, 0xa2, 0x41, 0xb7, 0x8a, 0xd4, 0x89, 0x06, 0xc3, 0x2b, 0x52, 0x37, 0x1a, 0x0c, 0xaf, 0x48,
+    0x1d, 0x69, 0x30, 0xbc, 0x22, 0x75, 0xa6, 0xc1, 0xf0, 0x8a, 0xd4, 0x9d, 0x06, 0xc3, 0x2b, 0xb2,
+    0xbc, 0xa2, 0xb0, 0x86, 0xd4, 0xa1, 0x06, 0xc3, 0x1b, 0x52, 0x97, 0x1a, 0x0c, 0xaf, 0x48, 0x9d,
+    0x6a, 0x30, 0xbc, 0x22, 0x75, 0xac, 0xc1, 0xf0, 0x8a, 0xd4, 0xb5, 0x06, 0xd3, 0x2a, 0x52, 0xd7,
+    0x1a, 0x4c, 0xab, 0x48, 0x5d, 0x6b, 0x30, 0x1f, 0x3c, 0x32, 0xea, 0xb1, 0x37, 0xa4, 0x0e, 0x36,
+    0x98, 0xde, 0x90, 0x3a, 0xd9, 0x60, 0x7a, 0x43, 0xf6, 0xf2, 0xae, 0xc9, 0x1a, 0x52, 0x37, 0x1b,
+    0x4c, 0x6b, 0x48, 0xdd, 0x6c, 0x30, 0xbd, 0x21, 0x75, 0xb4, 0xc1, 0xf4, 0x86, 0xd4, 0xd9, 0x06,
+    0xcb, 0x1b, 0x52, 0x77, 0x1b, 0x2c, 0x6f, 0x48, 0x1d, 0x6e, 0xb0, 0xac, 0x22, 0x75, 0xb8, 0xc1,
+    0xf2, 0x8a, 0xd4, 0xe5, 0x06, 0xcb, 0x2b, 0x52, 0xa7, 0x1b, 0x2c, 0xaf, 0x48, 0x1d, 0x6f, 0xb0,
+    0x1e, 0xbc, 0x35, 0x2c, 0xaf, 0x0d, 0xbd, 0x22, 0x95, 0xe4, 0xb2, 0x86, 0xd4, 0xf9, 0x06, 0xcb,
+    0x1b, 0x52, 0xf7, 0x1b, 0x6c, 0xaf, 0x48, 0x5d, 0x70, 0xb0, 0xbd, 0x22, 0x75, 0xc3, 0xc1, 0x7e,
+    0x30, 0xa0, 0x2a, 0xc9, 0x6d, 0x15, 0xa9, 0x23, 0x0e, 0xb6, 0x55, 0xa4, 0x8e, 0x38, 0xd8, 0x5e,
+    0x91, 0x8a, 0x71, 0x7b, 0x43, 0xea, 0x8e, 0x83, 0xed, 0x0d, 0xd9, 0xca, 0xeb, 0xdf, 0x07, 0xcf,
+    0x90, 0x0a, 0x72, 0x5b, 0x43, 0xea, 0x94, 0x83, 0xe3, 0x0d, 0xa9, 0x5b, 0x0e, 0x8e, 0x37, 0xa4,
+    0x8e, 0x39, 0x38, 0xde, 0x90, 0x3a, 0xe7, 0xe0, 0x78, 0x43, 0x2a, 0xc7, 0xf3, 0x40, 0x90, 0x0a,
+    0xf2, 0x58, 0x43, 0xea, 0xa0, 0x83, 0xe3, 0x0d, 0xa9, 0x8b, 0x0e, 0x8e, 0x37, 0xa4, 0x4e, 0x3a,
+    0x38, 0xde, 0x90, 0xab, 0xbc, 0xc9, 0xf7, 0x86, 0xdc, 0xe5, 0x55, 0xfe, 0xef, 0xd7, 0x33, 0xbc,
+    0x92, 0x7e, 0xe6, 0x4a, 0x0a, 0x1a, 0x5e, 0x49, 0x43, 0xc3, 0x2b, 0xa9, 0x68, 0x78, 0x25, 0x1d,
+    0x0d, 0xaf, 0xa0, 0xa4, 0xe1, 0x15, 0xb4, 0x34, 0xbc, 0x82, 0x9a, 0x86, 0x57, 0xd2, 0xd3, 0x30,
+    0x0a, 0x6a, 0x18, 0x15, 0x35, 0x4c, 0x92, 0x1a, 0x46, 0x4d, 0x0d, 0xa3, 0xa8, 0x86, 0x51, 0x55,
+    0xc3, 0x24, 0xab, 0x61, 0xd4, 0xd5, 0x30, 0x09, 0x6b, 0x98, 0x95, 0x35, 0x59, 0x5a, 0x13, 0xb6,
+    0x35, 0x51, 0x5c, 0x13, 0xd5, 0x35, 0x51, 0x5e, 0x93, 0xf5, 0x35, 0x59, 0x60, 0x93, 0x15, 0x36,
+    0x59, 0x62, 0x93, 0x34, 0x36, 0x8c, 0x22, 0x1b, 0x26, 0x95, 0x0d, 0xa3, 0xcc, 0x86, 0x51, 0x67,
+    0xc3, 0x28, 0xb4, 0x61, 0x52, 0xda, 0x30, 0x4a, 0x6d, 0x18, 0xb5, 0x36, 0x8c, 0x62, 0x1b, 0x26,
+    0xb5, 0x0d, 0x93, 0xdc, 0x86, 0x49, 0x6f, 0xc3, 0x28, 0xb8, 0x61, 0x54, 0xdc, 0x30, 0x4a, 0x6e,
+    0x18, 0x35, 0x37, 0x4c, 0xa2, 0x1b, 0x26, 0xd5, 0x0d, 0xa3, 0xec, 0x86, 0x51, 0x77, 0xc3, 0x28,
+    0xbc, 0x61, 0x54, 0xde, 0x30, 0x49, 0x6f, 0x18, 0xb5, 0x37, 0x4c, 0xe2, 0x1b, 0x46, 0xf5, 0x0d,
+    0xa3, 0xfc, 0x86, 0x51, 0x7f, 0xc3, 0x24, 0xc0, 0x61, 0x54, 0xe0, 0x30, 0x4a, 0x70, 0x18, 0x35,
+    0x38, 0x4c, 0x22, 0x1c, 0x26, 0x15, 0x0e, 0x93, 0x0c, 0x87, 0x51, 0x87, 0xc3, 0x28, 0xc4, 0x61,
+    0x54, 0xe2, 0x30, 0x4a, 0x71, 0x98, 0xb4, 0x38, 0x8c, 0x62, 0x1c, 0x46, 0x35, 0x0e, 0xa3, 0x1c,
+    0x87, 0x51, 0x8f, 0xc3, 0x28, 0xc8, 0x61, 0x52, 0xe4, 0x30, 0x4a, 0x72, 0x98, 0x34, 0x39, 0x8c,
+    0xa2, 0x1c, 0x46, 0x55, 0x0e, 0x93, 0x2c, 0x87, 0x49, 0x97, 0xc3, 0x28, 0xcc, 0x61, 0x54, 0xe6,
+    0x30, 0x4a, 0x73, 0x98, 0xb4, 0x39, 0x4c, 0xe2, 0x1c, 0x26, 0x75, 0x0e, 0xa3, 0x3c, 0x87, 0x51,
+    0x9f, 0xc3, 0x28, 0xd0, 0x61, 0x54, 0xe8, 0x30, 0x49, 0x74, 0x98, 0x34, 0x3a, 0x8c, 0x22, 0x1d,
+    0x46, 0x95, 0x0e, 0xa3, 0x4c, 0x87, 0x51, 0xa7, 0xc3, 0x24, 0xd4, 0xe1, 0x6f, 0x94, 0x3a, 0xff,
+    0x01, 0xe6, 0x0f, 0x92, 0x7b, 0x10, 0x35, 0x00, 0x00,
+};
+
+static char *s_plain;
+static size_t s_plain_len;
+static uint8_t *s_out;
+static size_t s_out_len;
+
+static void build_plain(void)
+{
+    s_plain_len = 0;
+    for (unsigned i = 0; i < FIXTURE_LINES; i++) {
+        s_plain_len += snprintf(s_plain + s_plain_len, PLAIN_MAX - s_plain_len,
+                                "{\"sensor\":%u,\"temperature\":%u,\"humidity\":%u}\n",
+                                i, (i * 7) % 40, (i * 13) % 100);
+    }
+}
+
+static esp_err_t collect(const uint8_t *data, size_t len, void *ctx)
+{
+    (void)ctx;
+    if (s_out_len + len > PLAIN_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(s_out + s_out_len, data, len);
+    s_out_len += len;
+    return ESP_OK;
+}
+
+// Feed `len` fixture bytes in pieces of `split`, return gzip_stream_finish()
+static esp_err_t inflate_split(const uint8_t *gz, size_t len, size_t split)
+{
+    gzip_stream_t *stream = gzip_stream_create(collect, NULL);
+    TEST_ASSERT_NOT_NULL(stream);
+    s_out_len = 0;
+    for (size_t pos = 0; pos < len; pos += split) {
+        size_t n = len - pos < split ? len - pos : split;
+        TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_feed(stream, gz + pos, n));
+    }
+    esp_err_t err = gzip_stream_finish(stream);
+    gzip_stream_destroy(stream);
+    return err;
+}
+
+void setUp(void)
+{
+    s_plain = malloc(PLAIN_MAX);
+    s_out = malloc(PLAIN_MAX);
+    TEST_ASSERT_NOT_NULL(s_plain);
+    TEST_ASSERT_NOT_NULL(s_out);
+    build_plain();
+}
+
+void tearDown(void)
+{
+    free(s_plain);
+    free(s_out);
+}
+
+/**
+ * @brief Every input split inflates to the original and passes the trailer check
+ */
+void test_inflate_every_split(void)
+{
+    for (size_t split = 1; split <= sizeof(s_fixture); split = split < 64 ? split + 1 : split * 2) {
+        TEST_ASSERT_EQUAL_MESSAGE(ESP_OK, inflate_split(s_fixture, sizeof(s_fixture), split), "trailer");
+        TEST_ASSERT_EQUAL(s_plain_len, s_out_len);
+        TEST_ASSERT_EQUAL_MEMORY(s_plain, s_out, s_plain_len);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, inflate_split(s_fixture, sizeof(s_fixture), sizeof(s_fixture)));
+}
+
+/**
+ * @brief A damaged CRC or length and a truncated trailer are errors
+ */
+void test_trailer_errors(void)
+{
+    uint8_t *gz = malloc(sizeof(s_fixture));
+    TEST_ASSERT_NOT_NULL(gz);
+    const size_t len = sizeof(s_fixture);
+
+    for (size_t i = 1; i <= 8; i++) {
+        memcpy(gz, s_fixture, len);
+        gz[len - i] ^= 0x01;  // ISIZE (i <= 4) or CRC32 (i > 4)
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, inflate_split(gz, len, 7));
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, inflate_split(gz, len, len));
+    }
+    for (size_t cut = 1; cut <= 8; cut++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, inflate_split(s_fixture, len - cut, 5));
+    }
+
+    memcpy(gz, s_fixture, len);
+    gz[0] = 0x1e;
+    gzip_stream_t *stream = gzip_stream_create(collect, NULL);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, gzip_stream_feed(stream, gz, len));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, gzip_stream_finish(stream));
+    gzip_stream_destroy(stream);
+    free(gz);
+}
+
+/**
+ * @brief Header/data/close helpers used by the HTTP event handlers
+ */
+void test_response_helpers(void)
+{
+    gzip_stream_t *stream = NULL;
+
+    // Plain bodies pass straight to the sink and close cleanly
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_handle_header(&stream, "Content-Type", "application/json", collect, NULL));
+    TEST_ASSERT_NULL(stream);
+    s_out_len = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_handle_data(stream, (const uint8_t *)"{}", 2, collect, NULL));
+    TEST_ASSERT_EQUAL(2, s_out_len);
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_close(&stream));
+
+    // Content-Encoding is matched case-insensitively and starts one decoder only
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_handle_header(&stream, "content-encoding", "GZIP", collect, NULL));
+    TEST_ASSERT_NOT_NULL(stream);
+    gzip_stream_t *first = stream;
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_handle_header(&stream, "Content-Encoding", "gzip", collect, NULL));
+    TEST_ASSERT_EQUAL_PTR(first, stream);
+
+    s_out_len = 0;
+    for (size_t pos = 0; pos < sizeof(s_fixture); pos += 100) {
+        size_t n = sizeof(s_fixture) - pos < 100 ? sizeof(s_fixture) - pos : 100;
+        TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_handle_data(stream, s_fixture + pos, n, collect, NULL));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_close(&stream));
+    TEST_ASSERT_NULL(stream);
+    TEST_ASSERT_EQUAL_MEMORY(s_plain, s_out, s_plain_len);
+
+    // A truncated body is reported by close
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_handle_header(&stream, "Content-Encoding", "gzip", collect, NULL));
+    s_out_len = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, gzip_stream_handle_data(stream, s_fixture, sizeof(s_fixture) - 3, collect, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, gzip_stream_close(&stream));
+    TEST_ASSERT_NULL(stream);
+}
+
+void app_main(void)
+{
+    // Wait a bit for serial output to initialize
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    ESP_LOGI(TAG, "\n\n=== gzip_stream Unit Tests ===\n");
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_inflate_every_split);
+    RUN_TEST(test_trailer_errors);
+    RUN_TEST(test_response_helpers);
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "\n=== All gzip_stream Tests Complete ===\n");
+
+    // Keep running so we can see results
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
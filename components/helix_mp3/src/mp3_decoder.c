@@ -83,11 +83,12 @@ esp_err_t mp3_decoder_decode(mp3_decoder_t *decoder,
     }
     
     if (samples == 0) {
-        // No samples decoded (might need more data or invalid frame)
-        decoder->bytes_consumed = 0;
+        // No samples: frame_bytes is what minimp3 skipped (a tag or data with no sync),
+        // or 0 if it needs more data
+        decoder->bytes_consumed = decoder->info.frame_bytes;
         *samples_decoded = 0;
         if (bytes_consumed) {
-            *bytes_consumed = 0;
+            *bytes_consumed = decoder->bytes_consumed;
         }
         return ESP_OK;
     }
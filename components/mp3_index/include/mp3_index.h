@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MP3_INDEX_INTERVAL_FRAMES 32    // Scan: one entry per this many frames (~0.8 s at 44.1 kHz)
+#define MP3_INDEX_MAX_ENTRIES     4096  // Beyond this the interval doubles (tracks over ~55 min)
+#define MP3_INDEX_TOC_ENTRIES     100   // Xing TOC: one point per percent of the duration
+#define MP3_INDEX_GAIN_UNKNOWN    INT16_MIN  // replay_gain when the file carries none
+#define MP3_INDEX_DELAY_UNKNOWN   0xFFFF     // encoder_delay without a LAME tag
+#define MP3_INDEX_DECODER_DELAY   529        // Samples a Layer III decoder outputs before the first input sample
+
+/**
+ * Where the seek points came from
+ */
+typedef enum {
+    MP3_INDEX_SCAN = 0,  // Frame headers walked: entries are exact frame starts
+    MP3_INDEX_XING,      // Xing/Info header: exact frame count, TOC points approximate
+    MP3_INDEX_VBRI,      // VBRI header: exact frame count, table points approximate
+} mp3_index_source_t;
+
+typedef struct {
+    uint32_t frame;   // Frame number, 0 being the first audio frame
+    uint32_t offset;  // File offset of that frame
+} mp3_index_entry_t;
+
+/**
+ * Seek index of one MP3 file. Frame numbers count audio frames only, so a Xing/Info
+ * or VBRI header frame is not frame 0.
+ */
+typedef struct {
+    uint32_t file_size;          // Of the indexed file, to detect a stale cache
+    uint32_t file_mtime;
+    uint32_t sample_rate;
+    uint16_t samples_per_frame;  // Per channel: 1152, or 576 for MPEG-2/2.5 layer III
+    uint8_t channels;
+    uint8_t source;              // mp3_index_source_t
+    uint32_t audio_start;        // First audio frame, after ID3v2 and any Xing/VBRI frame
+    uint32_t audio_end;          // End of the frames, before an ID3v1 tag
+    uint32_t total_frames;
+    uint32_t interval;           // Scan: frames between entries; entries[i].frame == i * interval
+    uint32_t count;
+    int16_t replay_gain;         // Track gain from a LAME tag in 0.1 dB, or MP3_INDEX_GAIN_UNKNOWN
+    uint16_t encoder_delay;      // Samples of silence the encoder put before the audio, or MP3_INDEX_DELAY_UNKNOWN
+    uint16_t encoder_padding;    // Samples it added after the audio to fill the last frame
+    mp3_index_entry_t *entries;
+} mp3_index_t;
+
+/**
+ * Header fields of one MPEG audio frame
+ */
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t frame_bytes;   // Including the header and padding
+    uint16_t samples;       // Per channel
+    uint8_t channels;
+} mp3_frame_info_t;
+
+/**
+ * Where playback resumes after mp3_index_seek()
+ */
+typedef struct {
+    uint32_t frame;        // First frame whose audio is wanted
+    uint32_t offset;       // File position set
+    uint32_t prime_bytes;  // Leading bytes to decode only to fill the bit reservoir, then drop
+} mp3_index_pos_t;
+
+/**
+ * @brief Parse a 4-byte MPEG audio frame header (layers I-III, MPEG-1/2/2.5)
+ * @param hdr: Header bytes
+ * @param info: Filled on success
+ * @return false for anything minimp3 would not sync on (free format, reserved fields)
+ */
+bool mp3_index_parse_header(const uint8_t *hdr, mp3_frame_info_t *info);
+
+/**
+ * @brief Index an MP3 from its Xing/Info or VBRI header, or by walking its frame headers
+ * Nothing is decoded. The scan reads the whole file, so for a track without a header
+ * it costs one pass over it; with scan false such a track returns ESP_ERR_NOT_FINISHED
+ * with the format fields filled and total_frames estimated from the size of the first
+ * frame (exact for CBR), which is enough for an approximate mp3_index_seek().
+ * @param fp: File opened for binary reading; its position is left undefined
+ * @param scan: Walk the frame headers when the file has no Xing/VBRI header
+ * @param idx: Filled on success; release with mp3_index_free()
+ * @return ESP_OK, ESP_ERR_NOT_FINISHED for an estimate as above, ESP_ERR_INVALID_RESPONSE
+ *         if no MPEG audio was found, ESP_ERR_NO_MEM
+ */
+esp_err_t mp3_index_build(FILE *fp, bool scan, mp3_index_t *idx);
+
+/**
+ * @brief Serialize an index (the cache file format)
+ * @return ESP_OK, ESP_FAIL on a write error
+ */
+esp_err_t mp3_index_write(const mp3_index_t *idx, FILE *fp);
+
+/**
+ * @brief Read an index written by mp3_index_write()
+ * @param fp: Open cache file
+ * @param idx: Filled on success; release with mp3_index_free()
+ * @return ESP_OK, ESP_ERR_INVALID_VERSION for another format version, ESP_ERR_INVALID_RESPONSE
+ *         for a damaged file, ESP_ERR_NO_MEM
+ */
+esp_err_t mp3_index_read(FILE *fp, mp3_index_t *idx);
+
+/**
+ * @brief Cache path of an MP3: its extension replaced by ".idx"
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE if out is too small
+ */
+esp_err_t mp3_index_cache_path(const char *mp3_path, char *out, size_t out_len);
+
+/**
+ * @brief Load the cached index of an MP3, or build and cache it
+ * A cache whose size or mtime does not match the file is rebuilt.
+ * @param mp3_path: The MP3 file
+ * @param scan: As for mp3_index_build(); a scanned index is cached too
+ * @param idx: Zeroed first; filled on ESP_OK and ESP_ERR_NOT_FINISHED, release with mp3_index_free()
+ * @return As mp3_index_build(), ESP_ERR_NOT_FOUND if the file cannot be opened
+ */
+esp_err_t mp3_index_open(const char *mp3_path, bool scan, mp3_index_t *idx);
+
+/**
+ * @brief Release the entries of an index
+ */
+void mp3_index_free(mp3_index_t *idx);
+
+/**
+ * @brief Track length from the frame count, less encoder delay and padding when known
+ */
+uint32_t mp3_index_duration_ms(const mp3_index_t *idx);
+
+/**
+ * @brief Decoded samples to drop for gapless playback from a frame
+ * With a LAME tag, the encoder delay plus the decoder delay is cut from the start of
+ * the track and the padding from its end, so consecutive tracks join sample to sample.
+ * @param idx: Index of the file
+ * @param frame: First frame decoded, as in mp3_index_pos_t
+ * @param skip_samples: Set to the leading samples (per channel) to drop
+ * @param length_samples: Set to the samples (per channel) to keep after those
+ * @return false if the file has no LAME tag: both are 0 and everything decoded is kept
+ */
+bool mp3_index_trim(const mp3_index_t *idx, uint32_t frame, uint32_t *skip_samples, uint32_t *length_samples);
+
+/**
+ * @brief Position a file for playback from a time
+ * A scanned index lands on the exact frame: it walks at most one interval of headers
+ * from the nearest entry, and starts up to a few frames early, enough for their data
+ * to refill the bit reservoir the target frame reads back into. With
+ * a Xing or VBRI table, or none, the offset is interpolated and resynced to the next
+ * frame header.
+ * @param idx: Index of the file
+ * @param fp: The file
+ * @param ms: Time to start at; past the end means the last frame
+ * @param pos: Where playback resumes
+ * @return ESP_OK, ESP_ERR_INVALID_RESPONSE if no frame header was found there, ESP_FAIL
+ *         if the file could not be read
+ */
+esp_err_t mp3_index_seek(const mp3_index_t *idx, FILE *fp, uint32_t ms, mp3_index_pos_t *pos);
+
+#ifdef __cplusplus
+}
+#endif
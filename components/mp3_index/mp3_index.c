@@ -0,0 +1,717 @@
+/**
+ * @file mp3_index.c
+ * @brief Seek index for MP3 files from Xing/VBRI headers or a header-only frame scan
+ *
+ * Only the 4-byte frame headers are parsed: frame lengths come from the bitrate and
+ * sample rate, so a scan hops from header to header without decoding anything. Sync
+ * is accepted only where three consecutive headers of the same stream chain up, the
+ * same rule minimp3 applies, so both agree on where frames are.
+ */
+
+#include "mp3_index.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+static const char *TAG = "mp3_index";
+
+#define READ_BYTES          8192         // File window for header reads
+#define SYNC_SEARCH_BYTES   (64 * 1024)  // Junk tolerated before the first frame
+#define RESYNC_BYTES        (16 * 1024)  // Damaged data skipped mid-file
+#define CACHE_MAGIC         0x5833504Du  // "MP3X" little-endian
+#define CACHE_VERSION       3
+#define CACHE_PATH_MAX      280
+#define MAX_RESERVOIR_BYTES  511  // Layer III main_data_begin reaches back at most this far
+#define FRAME_OVERHEAD_BYTES 36   // Header and stereo side info: frame bytes not in the reservoir
+#define PRIME_MAX_FRAMES     8    // Frames decoded ahead of a seek target at most
+
+// Cache file: this header, count entries, then an FNV-1a hash of both
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t file_size;
+    uint32_t file_mtime;
+    uint32_t sample_rate;
+    uint16_t samples_per_frame;
+    uint8_t channels;
+    uint8_t source;
+    uint32_t audio_start;
+    uint32_t audio_end;
+    uint32_t total_frames;
+    uint32_t interval;
+    uint32_t count;
+    int16_t replay_gain;
+    uint16_t encoder_delay;
+    uint16_t encoder_padding;
+} cache_header_t;
+
+typedef struct {
+    FILE *fp;
+    uint32_t size;
+    uint32_t base;
+    uint32_t len;
+    uint8_t buf[READ_BYTES];
+} reader_t;
+
+static const uint16_t s_bitrate_kbps[2][3][15] = {
+    {   // MPEG-1: layer I, II, III
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+    },
+    {   // MPEG-2 and 2.5
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    },
+};
+
+static const uint16_t s_rate_hz[3] = { 44100, 48000, 32000 };
+
+static inline uint32_t be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline uint16_t be16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+// Version, layer and sample rate match (what minimp3 compares between frames)
+static inline bool same_stream(const uint8_t *a, const uint8_t *b)
+{
+    return ((a[1] ^ b[1]) & 0xFE) == 0 && ((a[2] ^ b[2]) & 0x0C) == 0;
+}
+
+bool mp3_index_parse_header(const uint8_t *hdr, mp3_frame_info_t *info)
+{
+    if (hdr[0] != 0xFF || (hdr[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    unsigned version = (hdr[1] >> 3) & 3;      // 0: 2.5, 1: reserved, 2: MPEG-2, 3: MPEG-1
+    unsigned layer = 4 - ((hdr[1] >> 1) & 3);  // 4 is the reserved value
+    unsigned bitrate_index = hdr[2] >> 4;
+    unsigned rate_index = (hdr[2] >> 2) & 3;
+    if (version == 1 || layer == 4 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return false;
+    }
+    bool mpeg1 = version == 3;
+    uint32_t rate = s_rate_hz[rate_index] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+    uint32_t bps = s_bitrate_kbps[!mpeg1][layer - 1][bitrate_index] * 1000u;
+    unsigned padding = (hdr[2] >> 1) & 1;
+    if (layer == 1) {
+        info->samples = 384;
+        info->frame_bytes = (uint16_t)((12 * bps / rate + padding) * 4);
+    } else {
+        info->samples = (layer == 3 && !mpeg1) ? 576 : 1152;
+        info->frame_bytes = (uint16_t)(info->samples / 8 * bps / rate + padding);
+    }
+    info->sample_rate = rate;
+    info->channels = (hdr[3] >> 6) == 3 ? 1 : 2;
+    return true;
+}
+
+// n bytes at off, or NULL past the end of the file or on a read error (n <= READ_BYTES)
+static const uint8_t *peek(reader_t *r, uint32_t off, uint32_t n)
+{
+    if (off < r->base || off + n > r->base + r->len) {
+        if (off + n > r->size || fseek(r->fp, (long)off, SEEK_SET) != 0) {
+            return NULL;
+        }
+        r->base = off;
+        r->len = (uint32_t)fread(r->buf, 1, sizeof(r->buf), r->fp);
+        if (n > r->len) {
+            r->len = 0;
+            return NULL;
+        }
+    }
+    return r->buf + (off - r->base);
+}
+
+// First frame in [off, off + limit) followed by two more of the same stream, or one
+// that ends exactly at end; UINT32_MAX if there is none
+static uint32_t find_frame(reader_t *r, uint32_t off, uint32_t end, uint32_t limit)
+{
+    uint32_t stop = end - off > limit ? off + limit : end;
+    for (; off + 4 <= stop; off++) {
+        const uint8_t *h = peek(r, off, 4);
+        mp3_frame_info_t info;
+        if (!h) {
+            break;
+        }
+        if (h[0] != 0xFF || !mp3_index_parse_header(h, &info)) {
+            continue;
+        }
+        uint8_t first[4];
+        memcpy(first, h, sizeof(first));
+        uint32_t next = off + info.frame_bytes;
+        int chained = 0;
+        while (chained < 2 && next != end) {
+            const uint8_t *h2 = peek(r, next, 4);
+            mp3_frame_info_t info2;
+            if (!h2 || !mp3_index_parse_header(h2, &info2) || !same_stream(first, h2)) {
+                break;
+            }
+            next += info2.frame_bytes;
+            chained++;
+        }
+        if (chained == 2 || next == end) {
+            return off;
+        }
+    }
+    return UINT32_MAX;
+}
+
+static esp_err_t grow_entries(mp3_index_t *idx, uint32_t *capacity)
+{
+    uint32_t cap = *capacity ? *capacity * 2 : 256;
+    if (cap > MP3_INDEX_MAX_ENTRIES) {
+        cap = MP3_INDEX_MAX_ENTRIES;
+    }
+    size_t bytes = cap * sizeof(mp3_index_entry_t);
+    mp3_index_entry_t *entries = heap_caps_realloc(idx->entries, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!entries) {
+        entries = heap_caps_realloc(idx->entries, bytes, MALLOC_CAP_8BIT);
+        if (!entries) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    idx->entries = entries;
+    *capacity = cap;
+    return ESP_OK;
+}
+
+static esp_err_t add_entry(mp3_index_t *idx, uint32_t *capacity, uint32_t frame, uint32_t offset)
+{
+    if (idx->count == MP3_INDEX_MAX_ENTRIES) {
+        // Keep every other entry, so entries[i].frame is still i * interval
+        for (uint32_t i = 0; i < idx->count / 2; i++) {
+            idx->entries[i] = idx->entries[2 * i];
+        }
+        idx->count /= 2;
+        idx->interval *= 2;
+        if (frame % idx->interval != 0) {
+            return ESP_OK;
+        }
+    }
+    if (idx->count == *capacity) {
+        esp_err_t err = grow_entries(idx, capacity);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    idx->entries[idx->count].frame = frame;
+    idx->entries[idx->count].offset = offset;
+    idx->count++;
+    return ESP_OK;
+}
+
+// LAME tag, after the Xing fields: the radio (track) ReplayGain is 16 bits at offset 15,
+// a 3-bit name code (1 = radio), 3-bit originator, sign bit and 9-bit value in 0.1 dB.
+// At offset 21, 12 bits each of encoder delay and padding; LAME and FFmpeg (Lavc/Lavf)
+// both write them, other encoders may leave anything there
+static void parse_lame(reader_t *r, uint32_t off, mp3_index_t *idx)
+{
+    const uint8_t *t = peek(r, off, 36);
+    if (!t) {
+        return;
+    }
+    uint16_t rg = be16(t + 15);
+    if ((rg >> 13) == 1) {
+        int16_t gain = (int16_t)(rg & 0x1FF);
+        idx->replay_gain = (rg & 0x200) ? -gain : gain;
+    }
+    if (memcmp(t, "LAME", 4) == 0 || memcmp(t, "Lavc", 4) == 0 || memcmp(t, "Lavf", 4) == 0) {
+        idx->encoder_delay = (uint16_t)((t[21] << 4) | (t[22] >> 4));
+        idx->encoder_padding = (uint16_t)(((t[22] & 0x0F) << 8) | t[23]);
+    }
+}
+
+// Xing ("Xing" for VBR, "Info" for CBR) sits after the side info of the first frame
+static esp_err_t parse_xing(reader_t *r, uint32_t first, const uint8_t *hdr, const mp3_frame_info_t *info,
+                            mp3_index_t *idx)
+{
+    bool mpeg1 = ((hdr[1] >> 3) & 3) == 3;
+    uint32_t side_info = mpeg1 ? (info->channels == 1 ? 17 : 32) : (info->channels == 1 ? 9 : 17);
+    const uint8_t *x = peek(r, first + 4 + side_info, 16 + MP3_INDEX_TOC_ENTRIES);
+    if (!x || (memcmp(x, "Xing", 4) != 0 && memcmp(x, "Info", 4) != 0)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t flags = be32(x + 4);
+    if (!(flags & 0x1)) {
+        return ESP_ERR_NOT_FOUND;  // No frame count: no better than a scan
+    }
+    const uint8_t *p = x + 8;
+    idx->total_frames = be32(p);
+    p += 4;
+    uint32_t bytes = idx->audio_end - first;
+    if (flags & 0x2) {
+        uint32_t stated = be32(p);
+        p += 4;
+        if (stated > 0 && stated < bytes) {
+            bytes = stated;
+        }
+    }
+    idx->audio_start = first + info->frame_bytes;
+    idx->source = MP3_INDEX_XING;
+    uint32_t lame = first + 4 + side_info + (uint32_t)(p - x) + ((flags & 0x4) ? MP3_INDEX_TOC_ENTRIES : 0) +
+                    ((flags & 0x8) ? 4 : 0);
+    if ((flags & 0x4) && idx->total_frames > 0) {
+        uint32_t capacity = 0;
+        esp_err_t err = grow_entries(idx, &capacity);
+        if (err != ESP_OK) {
+            return err;
+        }
+        // TOC byte i: position of i% of the duration, in 1/256ths of the stream
+        for (uint32_t i = 0; i < MP3_INDEX_TOC_ENTRIES; i++) {
+            idx->entries[i].frame = (uint32_t)((uint64_t)idx->total_frames * i / MP3_INDEX_TOC_ENTRIES);
+            idx->entries[i].offset = first + (uint32_t)((uint64_t)bytes * p[i] / 256);
+        }
+        idx->count = MP3_INDEX_TOC_ENTRIES;
+    }
+    // Without a TOC, seeks interpolate over the whole file
+    if (lame + 36 <= first + info->frame_bytes) {
+        parse_lame(r, lame, idx);
+    }
+    return ESP_OK;
+}
+
+// VBRI (Fraunhofer) is always 32 bytes after the header
+static esp_err_t parse_vbri(reader_t *r, uint32_t first, const mp3_frame_info_t *info, mp3_index_t *idx)
+{
+    const uint8_t *v = peek(r, first + 4 + 32, 26);
+    if (!v || memcmp(v, "VBRI", 4) != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t frames = be32(v + 14);
+    uint32_t n = be16(v + 18);
+    uint32_t scale = be16(v + 20);
+    uint32_t entry_bytes = be16(v + 22);
+    uint32_t frames_per_entry = be16(v + 24);
+    if (frames == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    idx->total_frames = frames;
+    idx->audio_start = first + info->frame_bytes;
+    idx->source = MP3_INDEX_VBRI;
+    if (n == 0 || entry_bytes == 0 || entry_bytes > 4 || frames_per_entry == 0) {
+        return ESP_OK;
+    }
+    uint32_t step = (n + MP3_INDEX_MAX_ENTRIES - 1) / MP3_INDEX_MAX_ENTRIES;
+    uint32_t capacity = 0;
+    uint32_t offset = idx->audio_start;
+    uint32_t table = first + 4 + 32 + 26;
+    for (uint32_t i = 0; i < n && offset < idx->audio_end; i++) {
+        if (i % step == 0) {
+            if (idx->count == capacity && grow_entries(idx, &capacity) != ESP_OK) {
+                return ESP_ERR_NO_MEM;
+            }
+            idx->entries[idx->count].frame = i * frames_per_entry;
+            idx->entries[idx->count].offset = offset;
+            idx->count++;
+        }
+        const uint8_t *e = peek(r, table + i * entry_bytes, entry_bytes);
+        if (!e) {
+            break;
+        }
+        uint32_t size = 0;
+        for (uint32_t b = 0; b < entry_bytes; b++) {
+            size = size << 8 | e[b];
+        }
+        offset += size * scale;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t scan_frames(reader_t *r, mp3_index_t *idx)
+{
+    uint8_t first[4];
+    const uint8_t *h = peek(r, idx->audio_start, 4);
+    if (!h) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    memcpy(first, h, sizeof(first));
+    idx->interval = MP3_INDEX_INTERVAL_FRAMES;
+    uint32_t capacity = 0;
+    uint32_t frame = 0;
+    uint32_t off = idx->audio_start;
+    while (off + 4 <= idx->audio_end) {
+        mp3_frame_info_t info;
+        h = peek(r, off, 4);
+        if (!h) {
+            break;
+        }
+        if (!mp3_index_parse_header(h, &info) || !same_stream(first, h) ||
+            off + info.frame_bytes > idx->audio_end) {
+            // Damaged data: carry on at the next frame that chains
+            off = find_frame(r, off + 1, idx->audio_end, RESYNC_BYTES);
+            if (off == UINT32_MAX) {
+                break;
+            }
+            continue;
+        }
+        if (frame % idx->interval == 0) {
+            esp_err_t err = add_entry(idx, &capacity, frame, off);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        off += info.frame_bytes;
+        frame++;
+    }
+    idx->total_frames = frame;
+    idx->source = MP3_INDEX_SCAN;
+    return frame > 0 ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+static reader_t *reader_open(FILE *fp, uint32_t size)
+{
+    reader_t *r = malloc(sizeof(reader_t));
+    if (r) {
+        r->fp = fp;
+        r->size = size;
+        r->base = 0;
+        r->len = 0;
+    }
+    return r;
+}
+
+esp_err_t mp3_index_build(FILE *fp, bool scan, mp3_index_t *idx)
+{
+    if (!fp || !idx) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(idx, 0, sizeof(*idx));
+    idx->replay_gain = MP3_INDEX_GAIN_UNKNOWN;
+    idx->encoder_delay = MP3_INDEX_DELAY_UNKNOWN;
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        return ESP_FAIL;
+    }
+    long size = ftell(fp);
+    if (size < 0) {
+        return ESP_FAIL;
+    }
+    reader_t *r = reader_open(fp, (uint32_t)size);
+    if (!r) {
+        return ESP_ERR_NO_MEM;
+    }
+    idx->file_size = (uint32_t)size;
+
+    uint32_t start = 0;
+    uint32_t end = idx->file_size;
+    const uint8_t *p = peek(r, 0, 10);
+    if (p && memcmp(p, "ID3", 3) == 0) {
+        // Synchsafe size, plus a footer if the flag says so
+        start = 10 + ((uint32_t)(p[6] & 0x7F) << 21 | (uint32_t)(p[7] & 0x7F) << 14 |
+                      (uint32_t)(p[8] & 0x7F) << 7 | (p[9] & 0x7F)) + ((p[5] & 0x10) ? 10 : 0);
+    }
+    if (end >= 128 && (p = peek(r, end - 128, 3)) && memcmp(p, "TAG", 3) == 0) {
+        end -= 128;
+    }
+
+    esp_err_t err = ESP_ERR_INVALID_RESPONSE;
+    uint32_t first = start < end ? find_frame(r, start, end, SYNC_SEARCH_BYTES) : UINT32_MAX;
+    if (first != UINT32_MAX) {
+        uint8_t hdr[4];
+        mp3_frame_info_t info;
+        memcpy(hdr, peek(r, first, 4), sizeof(hdr));
+        mp3_index_parse_header(hdr, &info);
+        idx->sample_rate = info.sample_rate;
+        idx->samples_per_frame = info.samples;
+        idx->channels = info.channels;
+        idx->audio_start = first;
+        idx->audio_end = end;
+        err = parse_xing(r, first, hdr, &info, idx);
+        if (err == ESP_ERR_NOT_FOUND) {
+            err = parse_vbri(r, first, &info, idx);
+        }
+        if (err == ESP_ERR_NOT_FOUND && scan) {
+            err = scan_frames(r, idx);
+        } else if (err == ESP_ERR_NOT_FOUND) {
+            idx->total_frames = (end - first) / info.frame_bytes;  // Exact for CBR
+            err = ESP_ERR_NOT_FINISHED;
+        }
+    }
+    free(r);
+    if (err != ESP_OK && err != ESP_ERR_NOT_FINISHED) {
+        mp3_index_free(idx);
+    }
+    return err;
+}
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+esp_err_t mp3_index_write(const mp3_index_t *idx, FILE *fp)
+{
+    cache_header_t h = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .header_size = sizeof(cache_header_t),
+        .file_size = idx->file_size,
+        .file_mtime = idx->file_mtime,
+        .sample_rate = idx->sample_rate,
+        .samples_per_frame = idx->samples_per_frame,
+        .channels = idx->channels,
+        .source = idx->source,
+        .audio_start = idx->audio_start,
+        .audio_end = idx->audio_end,
+        .total_frames = idx->total_frames,
+        .interval = idx->interval,
+        .count = idx->count,
+        .replay_gain = idx->replay_gain,
+        .encoder_delay = idx->encoder_delay,
+        .encoder_padding = idx->encoder_padding,
+    };
+    size_t entry_bytes = idx->count * sizeof(mp3_index_entry_t);
+    uint32_t hash = fnv1a(fnv1a(2166136261u, &h, sizeof(h)), idx->entries, entry_bytes);
+    if (fwrite(&h, sizeof(h), 1, fp) != 1 || (entry_bytes && fwrite(idx->entries, entry_bytes, 1, fp) != 1) ||
+        fwrite(&hash, sizeof(hash), 1, fp) != 1) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mp3_index_read(FILE *fp, mp3_index_t *idx)
+{
+    cache_header_t h;
+    memset(idx, 0, sizeof(*idx));
+    if (fread(&h, sizeof(h), 1, fp) != 1 || h.magic != CACHE_MAGIC) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (h.version != CACHE_VERSION || h.header_size != sizeof(h)) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (h.count > MP3_INDEX_MAX_ENTRIES || h.sample_rate == 0 || h.samples_per_frame == 0 ||
+        (h.source == MP3_INDEX_SCAN && h.interval == 0)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    size_t entry_bytes = h.count * sizeof(mp3_index_entry_t);
+    if (entry_bytes) {
+        idx->entries = heap_caps_malloc(entry_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!idx->entries) {
+            idx->entries = malloc(entry_bytes);
+            if (!idx->entries) {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    uint32_t hash;
+    if ((entry_bytes && fread(idx->entries, entry_bytes, 1, fp) != 1) || fread(&hash, sizeof(hash), 1, fp) != 1 ||
+        hash != fnv1a(fnv1a(2166136261u, &h, sizeof(h)), idx->entries, entry_bytes)) {
+        mp3_index_free(idx);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    idx->file_size = h.file_size;
+    idx->file_mtime = h.file_mtime;
+    idx->sample_rate = h.sample_rate;
+    idx->samples_per_frame = h.samples_per_frame;
+    idx->channels = h.channels;
+    idx->source = h.source;
+    idx->audio_start = h.audio_start;
+    idx->audio_end = h.audio_end;
+    idx->total_frames = h.total_frames;
+    idx->interval = h.interval;
+    idx->count = h.count;
+    idx->replay_gain = h.replay_gain;
+    idx->encoder_delay = h.encoder_delay;
+    idx->encoder_padding = h.encoder_padding;
+    return ESP_OK;
+}
+
+esp_err_t mp3_index_cache_path(const char *mp3_path, char *out, size_t out_len)
+{
+    const char *slash = strrchr(mp3_path, '/');
+    const char *dot = strrchr(mp3_path, '.');
+    size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - mp3_path) : strlen(mp3_path);
+    if (stem + sizeof(".idx") > out_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out, mp3_path, stem);
+    memcpy(out + stem, ".idx", sizeof(".idx"));
+    return ESP_OK;
+}
+
+esp_err_t mp3_index_open(const char *mp3_path, bool scan, mp3_index_t *idx)
+{
+    if (!mp3_path || !idx) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(idx, 0, sizeof(*idx));
+    struct stat st;
+    if (stat(mp3_path, &st) != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    char cache[CACHE_PATH_MAX];
+    bool cacheable = mp3_index_cache_path(mp3_path, cache, sizeof(cache)) == ESP_OK;
+    if (cacheable) {
+        FILE *cf = fopen(cache, "rb");
+        if (cf) {
+            esp_err_t err = mp3_index_read(cf, idx);
+            fclose(cf);
+            if (err == ESP_OK && idx->file_size == (uint32_t)st.st_size &&
+                idx->file_mtime == (uint32_t)st.st_mtime) {
+                return ESP_OK;
+            }
+            mp3_index_free(idx);
+            ESP_LOGI(TAG, "Rebuilding stale index %s", cache);
+        }
+    }
+
+    FILE *fp = fopen(mp3_path, "rb");
+    if (!fp) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t err = mp3_index_build(fp, scan, idx);
+    fclose(fp);
+    if (err != ESP_OK) {
+        return err;
+    }
+    idx->file_mtime = (uint32_t)st.st_mtime;
+    ESP_LOGI(TAG, "%s: %" PRIu32 " frames, %" PRIu32 " ms, %" PRIu32 " seek points (%s)", mp3_path,
+             idx->total_frames, mp3_index_duration_ms(idx), idx->count,
+             idx->source == MP3_INDEX_XING ? "Xing" : idx->source == MP3_INDEX_VBRI ? "VBRI" : "scan");
+
+    if (cacheable) {
+        FILE *cf = fopen(cache, "wb");
+        bool written = cf && mp3_index_write(idx, cf) == ESP_OK;
+        if (cf && fclose(cf) != 0) {
+            written = false;
+        }
+        if (!written) {
+            ESP_LOGW(TAG, "Could not cache index at %s", cache);
+            remove(cache);
+        }
+    }
+    return ESP_OK;
+}
+
+void mp3_index_free(mp3_index_t *idx)
+{
+    if (!idx) {
+        return;
+    }
+    heap_caps_free(idx->entries);
+    idx->entries = NULL;
+    idx->count = 0;
+}
+
+uint32_t mp3_index_duration_ms(const mp3_index_t *idx)
+{
+    if (!idx || idx->sample_rate == 0) {
+        return 0;
+    }
+    uint64_t samples = (uint64_t)idx->total_frames * idx->samples_per_frame;
+    if (idx->encoder_delay != MP3_INDEX_DELAY_UNKNOWN) {
+        uint32_t trim = (uint32_t)idx->encoder_delay + idx->encoder_padding;
+        samples = samples > trim ? samples - trim : 0;
+    }
+    return (uint32_t)(samples * 1000 / idx->sample_rate);
+}
+
+bool mp3_index_trim(const mp3_index_t *idx, uint32_t frame, uint32_t *skip_samples, uint32_t *length_samples)
+{
+    *skip_samples = 0;
+    *length_samples = 0;
+    if (!idx || idx->encoder_delay == MP3_INDEX_DELAY_UNKNOWN) {
+        return false;
+    }
+    // Decoded sample n is input sample n - delay - decoder delay. Padding shorter than
+    // the decoder delay leaves the last samples in the decoder: the end is cut there
+    uint64_t total = (uint64_t)idx->total_frames * idx->samples_per_frame;
+    uint64_t from = (uint64_t)frame * idx->samples_per_frame;
+    uint64_t start = (uint64_t)idx->encoder_delay + MP3_INDEX_DECODER_DELAY;
+    uint64_t end = total + MP3_INDEX_DECODER_DELAY;
+    end = end > idx->encoder_padding ? end - idx->encoder_padding : 0;
+    if (end > total) {
+        end = total;
+    }
+    if (from < start) {
+        *skip_samples = (uint32_t)(start - from);
+        from = start;
+    }
+    *length_samples = end > from ? (uint32_t)(end - from) : 0;
+    return true;
+}
+
+esp_err_t mp3_index_seek(const mp3_index_t *idx, FILE *fp, uint32_t ms, mp3_index_pos_t *pos)
+{
+    if (!idx || !fp || !pos || idx->total_frames == 0 || idx->sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t target = (uint32_t)((uint64_t)ms * idx->sample_rate / (1000u * idx->samples_per_frame));
+    if (target >= idx->total_frames) {
+        target = idx->total_frames - 1;
+    }
+    reader_t *r = reader_open(fp, idx->file_size);
+    if (!r) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    pos->frame = target;
+    pos->prime_bytes = 0;
+    if (idx->source == MP3_INDEX_SCAN && idx->count > 0) {
+        // Walk from the entry at or before the earliest frame that may be needed for priming
+        uint32_t earliest = target > PRIME_MAX_FRAMES ? target - PRIME_MAX_FRAMES : 0;
+        uint32_t i = earliest / idx->interval;
+        if (i >= idx->count) {
+            i = idx->count - 1;
+        }
+        uint32_t recent[PRIME_MAX_FRAMES + 1];  // Frame starts, by frame number modulo the size
+        uint32_t frame = idx->entries[i].frame;
+        uint32_t off = idx->entries[i].offset;
+        mp3_frame_info_t info;
+        for (; frame < target; frame++) {
+            const uint8_t *h = peek(r, off, 4);
+            if (!h || !mp3_index_parse_header(h, &info)) {
+                err = ESP_ERR_INVALID_RESPONSE;
+                break;
+            }
+            recent[frame % (PRIME_MAX_FRAMES + 1)] = off;
+            off += info.frame_bytes;
+        }
+        recent[target % (PRIME_MAX_FRAMES + 1)] = off;
+        // Start early enough that the frames before the target refill the bit reservoir
+        uint32_t start = target;
+        while (start > earliest && start > idx->entries[i].frame &&
+               off - recent[start % (PRIME_MAX_FRAMES + 1)] <
+                   MAX_RESERVOIR_BYTES + (target - start) * FRAME_OVERHEAD_BYTES) {
+            start--;
+        }
+        pos->offset = recent[start % (PRIME_MAX_FRAMES + 1)];
+        pos->prime_bytes = off - pos->offset;
+    } else {
+        // Interpolate between table points (or over the whole stream), then find a frame
+        mp3_index_entry_t a = { 0, idx->audio_start };
+        mp3_index_entry_t b = { idx->total_frames, idx->audio_end };
+        for (uint32_t i = 0; i < idx->count && idx->entries[i].frame <= target; i++) {
+            a = idx->entries[i];
+            b = i + 1 < idx->count ? idx->entries[i + 1] : (mp3_index_entry_t){ idx->total_frames, idx->audio_end };
+        }
+        uint32_t off = a.offset;
+        if (b.frame > a.frame && b.offset > a.offset) {
+            off += (uint32_t)((uint64_t)(b.offset - a.offset) * (target - a.frame) / (b.frame - a.frame));
+        }
+        pos->offset = find_frame(r, off, idx->audio_end, RESYNC_BYTES);
+        if (pos->offset == UINT32_MAX) {
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    free(r);
+    if (err == ESP_OK && fseek(fp, (long)pos->offset, SEEK_SET) != 0) {
+        err = ESP_FAIL;
+    }
+    return err;
+}
@@ -0,0 +1,464 @@
+/**
+ * @file test_mp3_index.c
+ * @brief Header parsing, scan, Xing/VBRI, seek and cache tests for mp3_index
+ *
+ * Streams are built in memory from bare frame headers with silent bodies; only the
+ * headers matter to the index. The MP3 and its cache file are fmemopen() streams.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mp3_index.h"
+
+static const char *TAG = "test_mp3_index";
+
+#define FRAMES     400
+#define ID3_BYTES  300
+#define JUNK_BYTES 40   // Between the tag and the first frame
+#define ENC_DELAY   576   // Gapless fields of the LAME tag in the Xing image
+#define ENC_PADDING 1000
+#define IMAGE_MAX  (ID3_BYTES + 10 + JUNK_BYTES + (FRAMES + 1) * 530 + 128)
+
+static uint8_t *s_image;
+static uint32_t s_offsets[FRAMES];  // Audio frame starts in the last image built
+static uint16_t s_sizes[FRAMES];
+
+// MPEG-1 layer III, 44.1 kHz, joint stereo; bitrates 64/128/160 kbps, padding varies
+static const uint8_t s_bitrate_bits[3] = { 0x50, 0x90, 0xA0 };
+
+static uint8_t *put_frame(uint8_t *p, uint8_t bitrate_bits, bool padding)
+{
+    mp3_frame_info_t info;
+    uint8_t hdr[4] = { 0xFF, 0xFB, (uint8_t)(bitrate_bits | (padding ? 0x02 : 0)), 0x40 };
+    mp3_index_parse_header(hdr, &info);
+    memset(p, 0, info.frame_bytes);
+    memcpy(p, hdr, sizeof(hdr));
+    return p + info.frame_bytes;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+/**
+ * Image: ID3v2 tag, junk holding a false sync, an optional Xing/VBRI frame, FRAMES audio
+ * frames of varying size, an ID3v1 tag. Returns its length; *first is the offset of
+ * the first frame (the tag frame when there is one).
+ */
+static size_t build_image(const char *tag, uint32_t *first)
+{
+    uint8_t *p = s_image;
+    memcpy(p, "ID3\x04\x00\x00", 6);
+    p[6] = 0;
+    p[7] = 0;
+    p[8] = ID3_BYTES >> 7;
+    p[9] = ID3_BYTES & 0x7F;
+    p += 10;
+    memset(p, 'x', ID3_BYTES);
+    p += ID3_BYTES;
+    memset(p, 0, JUNK_BYTES);
+    memcpy(p + 8, "\xFF\xFB\x90\x40", 4);  // Looks like a frame, does not chain
+    p += JUNK_BYTES;
+
+    *first = (uint32_t)(p - s_image);
+    uint8_t *tag_frame = p;
+    if (tag) {
+        p = put_frame(p, 0x90, false);
+    }
+    for (int i = 0; i < FRAMES; i++) {
+        s_offsets[i] = (uint32_t)(p - s_image);
+        uint8_t *next = put_frame(p, s_bitrate_bits[(i / 7) % 3], i % 3 == 0);
+        s_sizes[i] = (uint16_t)(next - p);
+        p = next;
+    }
+    uint32_t audio_bytes = (uint32_t)(p - tag_frame);
+
+    if (tag && strcmp(tag, "Xing") == 0) {
+        uint8_t *x = tag_frame + 4 + 32;
+        memcpy(x, "Xing", 4);
+        put_be32(x + 4, 0x7);
+        put_be32(x + 8, FRAMES);
+        put_be32(x + 12, audio_bytes);
+        for (int i = 0; i < MP3_INDEX_TOC_ENTRIES; i++) {
+            // Points at the true frame starts, rounded down to 1/256ths
+            uint32_t off = s_offsets[i * FRAMES / MP3_INDEX_TOC_ENTRIES] - (uint32_t)(tag_frame - s_image);
+            x[16 + i] = (uint8_t)((uint64_t)off * 256 / audio_bytes);
+        }
+        memcpy(x + 116, "LAME3.100", 9);
+        put_be16(x + 116 + 15, 0x2000 | 0x0400 | 0x0200 | 62);  // Radio, set by the user: -6.2 dB
+        x[116 + 21] = ENC_DELAY >> 4;
+        x[116 + 22] = (uint8_t)((ENC_DELAY & 0x0F) << 4 | ENC_PADDING >> 8);
+        x[116 + 23] = ENC_PADDING & 0xFF;
+    } else if (tag && strcmp(tag, "VBRI") == 0) {
+        uint8_t *v = tag_frame + 4 + 32;
+        int entries = FRAMES / 40;
+        memcpy(v, "VBRI", 4);
+        put_be16(v + 4, 1);
+        put_be32(v + 14, FRAMES);
+        put_be16(v + 18, (uint16_t)entries);
+        put_be16(v + 20, 1);
+        put_be16(v + 22, 2);
+        put_be16(v + 24, 40);
+        for (int i = 0; i < entries; i++) {
+            uint32_t end = i + 1 < entries ? s_offsets[(i + 1) * 40] : (uint32_t)(p - s_image);
+            put_be16(v + 26 + 2 * i, (uint16_t)(end - s_offsets[i * 40]));
+        }
+    }
+
+    memcpy(p, "TAG", 3);
+    memset(p + 3, 0, 125);
+    p += 128;
+    return (size_t)(p - s_image);
+}
+
+static uint32_t frames_to_ms(uint32_t frames)
+{
+    return (uint32_t)((uint64_t)frames * 1152 * 1000 / 44100);
+}
+
+void setUp(void)
+{
+    s_image = malloc(IMAGE_MAX);
+    TEST_ASSERT_NOT_NULL(s_image);
+}
+
+void tearDown(void)
+{
+    free(s_image);
+}
+
+/**
+ * @brief Frame sizes and formats across versions; reserved and free-format headers rejected
+ */
+void test_parse_header(void)
+{
+    mp3_frame_info_t info;
+
+    TEST_ASSERT_TRUE(mp3_index_parse_header((const uint8_t *)"\xFF\xFB\x90\x00", &info));
+    TEST_ASSERT_EQUAL_UINT32(44100, info.sample_rate);
+    TEST_ASSERT_EQUAL_UINT16(417, info.frame_bytes);
+    TEST_ASSERT_EQUAL_UINT16(1152, info.samples);
+    TEST_ASSERT_EQUAL_UINT8(2, info.channels);
+
+    TEST_ASSERT_TRUE(mp3_index_parse_header((const uint8_t *)"\xFF\xFB\x92\xC0", &info));
+    TEST_ASSERT_EQUAL_UINT16(418, info.frame_bytes);
+    TEST_ASSERT_EQUAL_UINT8(1, info.channels);
+
+    // MPEG-2 layer III, 22.05 kHz, 64 kbps
+    TEST_ASSERT_TRUE(mp3_index_parse_header((const uint8_t *)"\xFF\xF3\x80\xC0", &info));
+    TEST_ASSERT_EQUAL_UINT32(22050, info.sample_rate);
+    TEST_ASSERT_EQUAL_UINT16(208, info.frame_bytes);
+    TEST_ASSERT_EQUAL_UINT16(576, info.samples);
+
+    // MPEG-1 layer II, 48 kHz, 192 kbps
+    TEST_ASSERT_TRUE(mp3_index_parse_header((const uint8_t *)"\xFF\xFD\xA4\x00", &info));
+    TEST_ASSERT_EQUAL_UINT16(576, info.frame_bytes);
+    TEST_ASSERT_EQUAL_UINT16(1152, info.samples);
+
+    TEST_ASSERT_FALSE(mp3_index_parse_header((const uint8_t *)"\xFF\xFB\x00\x00", &info));  // Free format
+    TEST_ASSERT_FALSE(mp3_index_parse_header((const uint8_t *)"\xFF\xFB\xF0\x00", &info));  // Bad bitrate
+    TEST_ASSERT_FALSE(mp3_index_parse_header((const uint8_t *)"\xFF\xFB\x9C\x00", &info));  // Bad rate
+    TEST_ASSERT_FALSE(mp3_index_parse_header((const uint8_t *)"\xFF\xF9\x90\x00", &info));  // Bad layer
+    TEST_ASSERT_FALSE(mp3_index_parse_header((const uint8_t *)"\xFF\xEB\x90\x00", &info));  // Bad version
+}
+
+/**
+ * @brief A header scan counts every frame, skips both tags and a false sync, and
+ *        records exact frame starts
+ */
+void test_scan(void)
+{
+    uint32_t first;
+    size_t len = build_image(NULL, &first);
+    FILE *fp = fmemopen(s_image, len, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+
+    mp3_index_t idx;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, mp3_index_build(fp, false, &idx));
+    TEST_ASSERT_EQUAL_UINT32(first, idx.audio_start);
+    TEST_ASSERT_EQUAL_UINT32(44100, idx.sample_rate);
+    TEST_ASSERT_TRUE(idx.total_frames > 0);  // Estimated from the first frame
+
+    // Without a scan, a seek lands on some frame start near the estimate
+    mp3_index_pos_t pos;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_seek(&idx, fp, frames_to_ms(FRAMES / 2), &pos));
+    bool on_frame = false;
+    for (int i = 0; i < FRAMES; i++) {
+        on_frame |= pos.offset == s_offsets[i];
+    }
+    TEST_ASSERT_TRUE(on_frame);
+
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_build(fp, true, &idx));
+    TEST_ASSERT_EQUAL(MP3_INDEX_SCAN, idx.source);
+    TEST_ASSERT_EQUAL_UINT32(len, idx.file_size);
+    TEST_ASSERT_EQUAL_UINT32(first, idx.audio_start);
+    TEST_ASSERT_EQUAL_UINT32(len - 128, idx.audio_end);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, idx.total_frames);
+    TEST_ASSERT_EQUAL_UINT32(frames_to_ms(FRAMES), mp3_index_duration_ms(&idx));
+    TEST_ASSERT_EQUAL_UINT32((FRAMES + MP3_INDEX_INTERVAL_FRAMES - 1) / MP3_INDEX_INTERVAL_FRAMES, idx.count);
+    for (uint32_t i = 0; i < idx.count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i * idx.interval, idx.entries[i].frame);
+        TEST_ASSERT_EQUAL_UINT32(s_offsets[i * idx.interval], idx.entries[i].offset);
+    }
+    mp3_index_free(&idx);
+    fclose(fp);
+}
+
+/**
+ * @brief Seeking a scanned index finds the exact frame, starting early enough to prime
+ *        the bit reservoir
+ */
+void test_seek_exact(void)
+{
+    uint32_t first;
+    size_t len = build_image(NULL, &first);
+    FILE *fp = fmemopen(s_image, len, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    mp3_index_t idx;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_build(fp, true, &idx));
+
+    mp3_index_pos_t pos;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_seek(&idx, fp, 0, &pos));
+    TEST_ASSERT_EQUAL_UINT32(0, pos.frame);
+    TEST_ASSERT_EQUAL_UINT32(s_offsets[0], pos.offset);
+    TEST_ASSERT_EQUAL_UINT32(0, pos.prime_bytes);
+
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_seek(&idx, fp, frames_to_ms(1) + 1, &pos));
+    TEST_ASSERT_EQUAL_UINT32(1, pos.frame);
+    TEST_ASSERT_EQUAL_UINT32(s_offsets[0], pos.offset);
+    TEST_ASSERT_EQUAL_UINT32(s_sizes[0], pos.prime_bytes);
+
+    static const uint32_t targets[] = { 31, 32, 33, 64, 250, FRAMES - 1 };
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+        uint32_t t = targets[i];
+        // Just past the start of the frame, so rounding cannot land on the one before
+        TEST_ASSERT_EQUAL(ESP_OK, mp3_index_seek(&idx, fp, frames_to_ms(t) + 1, &pos));
+        TEST_ASSERT_EQUAL_UINT32(t, pos.frame);
+        TEST_ASSERT_EQUAL_UINT32(s_offsets[t], pos.offset + pos.prime_bytes);
+        TEST_ASSERT_EQUAL(pos.offset, ftell(fp));
+        // Fewest whole frames holding a full reservoir besides headers and side info
+        uint32_t k = 1;
+        while (s_offsets[t - k] != pos.offset) {
+            k++;
+            TEST_ASSERT_TRUE(k <= 8);
+        }
+        TEST_ASSERT_TRUE(pos.prime_bytes >= 511 + 36 * k);
+        TEST_ASSERT_TRUE(pos.prime_bytes - s_sizes[t - k] < 511 + 36 * (k - 1));
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_seek(&idx, fp, frames_to_ms(FRAMES) + 5000, &pos));
+    TEST_ASSERT_EQUAL_UINT32(FRAMES - 1, pos.frame);
+    mp3_index_free(&idx);
+    fclose(fp);
+}
+
+/**
+ * @brief A Xing TOC gives the frame count without a scan, and seeks land on frame starts
+ */
+void test_xing(void)
+{
+    uint32_t first;
+    size_t len = build_image("Xing", &first);
+    FILE *fp = fmemopen(s_image, len, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    mp3_index_t idx;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_build(fp, false, &idx));
+    TEST_ASSERT_EQUAL(MP3_INDEX_XING, idx.source);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, idx.total_frames);
+    TEST_ASSERT_EQUAL_UINT32(s_offsets[0], idx.audio_start);
+    TEST_ASSERT_EQUAL_UINT32(MP3_INDEX_TOC_ENTRIES, idx.count);
+    TEST_ASSERT_EQUAL_UINT32((uint64_t)(FRAMES * 1152 - ENC_DELAY - ENC_PADDING) * 1000 / 44100,
+                             mp3_index_duration_ms(&idx));
+    TEST_ASSERT_EQUAL_INT16(-62, idx.replay_gain);
+    TEST_ASSERT_EQUAL_UINT16(ENC_DELAY, idx.encoder_delay);
+    TEST_ASSERT_EQUAL_UINT16(ENC_PADDING, idx.encoder_padding);
+
+    // From the start: delays cut, and what is left is exactly the encoded audio
+    uint32_t skip, length;
+    TEST_ASSERT_TRUE(mp3_index_trim(&idx, 0, &skip, &length));
+    TEST_ASSERT_EQUAL_UINT32(ENC_DELAY + MP3_INDEX_DECODER_DELAY, skip);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES * 1152 - ENC_DELAY - ENC_PADDING, length);
+    TEST_ASSERT_TRUE(mp3_index_trim(&idx, 200, &skip, &length));
+    TEST_ASSERT_EQUAL_UINT32(0, skip);
+    TEST_ASSERT_EQUAL_UINT32((FRAMES - 200) * 1152 - ENC_PADDING + MP3_INDEX_DECODER_DELAY, length);
+
+    mp3_index_pos_t pos;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_seek(&idx, fp, frames_to_ms(200) + 1, &pos));
+    TEST_ASSERT_EQUAL_UINT32(200, pos.frame);
+    TEST_ASSERT_EQUAL_UINT32(0, pos.prime_bytes);
+    bool on_frame = false;
+    for (int i = 190; i <= 200; i++) {
+        on_frame |= pos.offset == s_offsets[i];
+    }
+    TEST_ASSERT_TRUE(on_frame);
+    mp3_index_free(&idx);
+    fclose(fp);
+}
+
+/**
+ * @brief A VBRI table gives the frame count and seek points at its entries
+ */
+void test_vbri(void)
+{
+    uint32_t first;
+    size_t len = build_image("VBRI", &first);
+    FILE *fp = fmemopen(s_image, len, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    mp3_index_t idx;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_build(fp, false, &idx));
+    TEST_ASSERT_EQUAL(MP3_INDEX_VBRI, idx.source);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, idx.total_frames);
+    TEST_ASSERT_EQUAL_INT16(MP3_INDEX_GAIN_UNKNOWN, idx.replay_gain);
+    TEST_ASSERT_EQUAL_UINT16(MP3_INDEX_DELAY_UNKNOWN, idx.encoder_delay);
+    TEST_ASSERT_EQUAL_UINT32(frames_to_ms(FRAMES), mp3_index_duration_ms(&idx));
+    uint32_t skip, length;
+    TEST_ASSERT_FALSE(mp3_index_trim(&idx, 0, &skip, &length));
+    TEST_ASSERT_EQUAL_UINT32(0, skip);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES / 40, idx.count);
+    for (uint32_t i = 0; i < idx.count; i++) {
+        TEST_ASSERT_EQUAL_UINT32(i * 40, idx.entries[i].frame);
+        TEST_ASSERT_EQUAL_UINT32(s_offsets[i * 40], idx.entries[i].offset);
+    }
+
+    mp3_index_pos_t pos;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_seek(&idx, fp, frames_to_ms(120) + 1, &pos));
+    TEST_ASSERT_EQUAL_UINT32(s_offsets[120], pos.offset);
+    mp3_index_free(&idx);
+    fclose(fp);
+}
+
+/**
+ * @brief The cache round-trips; damage and other versions are refused
+ */
+void test_cache(void)
+{
+    uint32_t first;
+    size_t len = build_image(NULL, &first);
+    FILE *fp = fmemopen(s_image, len, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    mp3_index_t idx;
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_build(fp, true, &idx));
+    fclose(fp);
+    idx.file_mtime = 1234567;
+    idx.replay_gain = 35;
+    idx.encoder_delay = 1105;
+    idx.encoder_padding = 2000;
+
+    static uint8_t cache[1024];
+    FILE *cf = fmemopen(cache, sizeof(cache), "wb");
+    TEST_ASSERT_NOT_NULL(cf);
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_write(&idx, cf));
+    long cache_len = ftell(cf);
+    fclose(cf);
+
+    mp3_index_t back;
+    cf = fmemopen(cache, (size_t)cache_len, "rb");
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_read(cf, &back));
+    fclose(cf);
+    TEST_ASSERT_EQUAL_UINT32(idx.file_size, back.file_size);
+    TEST_ASSERT_EQUAL_UINT32(1234567, back.file_mtime);
+    TEST_ASSERT_EQUAL_UINT32(idx.total_frames, back.total_frames);
+    TEST_ASSERT_EQUAL_UINT32(idx.audio_start, back.audio_start);
+    TEST_ASSERT_EQUAL_UINT32(idx.count, back.count);
+    TEST_ASSERT_EQUAL_INT16(35, back.replay_gain);
+    TEST_ASSERT_EQUAL_UINT16(1105, back.encoder_delay);
+    TEST_ASSERT_EQUAL_UINT16(2000, back.encoder_padding);
+    TEST_ASSERT_EQUAL_MEMORY(idx.entries, back.entries, idx.count * sizeof(mp3_index_entry_t));
+    mp3_index_free(&back);
+
+    cache[cache_len - 10] ^= 0x01;
+    cf = fmemopen(cache, (size_t)cache_len, "rb");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, mp3_index_read(cf, &back));
+    fclose(cf);
+    TEST_ASSERT_NULL(back.entries);
+
+    cache[4] ^= 0x02;  // Version field
+    cf = fmemopen(cache, (size_t)cache_len, "rb");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, mp3_index_read(cf, &back));
+    fclose(cf);
+
+    cf = fmemopen(cache, 7, "rb");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, mp3_index_read(cf, &back));
+    fclose(cf);
+    mp3_index_free(&idx);
+
+    char path[32];
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_cache_path("/sdcard/music/song.mp3", path, sizeof(path)));
+    TEST_ASSERT_EQUAL_STRING("/sdcard/music/song.idx", path);
+    TEST_ASSERT_EQUAL(ESP_OK, mp3_index_cache_path("/sdcard/a.b/song", path, sizeof(path)));
+    TEST_ASSERT_EQUAL_STRING("/sdcard/a.b/song.idx", path);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, mp3_index_cache_path("/sdcard/music/a-long-name.mp3", path, 16));
+}
+
+/**
+ * @brief Data without a frame chain is not taken for MP3
+ */
+void test_not_mp3(void)
+{
+    memset(s_image, 0, 4096);
+    memcpy(s_image + 100, "\xFF\xFB\x90\x40", 4);  // A lone header
+    FILE *fp = fmemopen(s_image, 4096, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    mp3_index_t idx;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, mp3_index_build(fp, true, &idx));
+    TEST_ASSERT_NULL(idx.entries);
+    fclose(fp);
+}
+
+/**
+ * @brief A file that cannot be opened leaves an empty index, safe to free
+ */
+void test_open_missing(void)
+{
+    mp3_index_t idx;
+    memset(&idx, 0xA5, sizeof(idx));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, mp3_index_open("/nonexistent/track.mp3", false, &idx));
+    TEST_ASSERT_NULL(idx.entries);
+    TEST_ASSERT_EQUAL_UINT32(0, idx.count);
+    TEST_ASSERT_EQUAL_UINT32(0, mp3_index_duration_ms(&idx));
+    mp3_index_free(&idx);
+}
+
+void app_main(void)
+{
+    // Wait a bit for serial output to initialize
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    ESP_LOGI(TAG, "\n\n=== mp3_index Unit Tests ===\n");
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_parse_header);
+    RUN_TEST(test_scan);
+    RUN_TEST(test_seek_exact);
+    RUN_TEST(test_xing);
+    RUN_TEST(test_vbri);
+    RUN_TEST(test_cache);
+    RUN_TEST(test_not_mp3);
+    RUN_TEST(test_open_missing);
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "\n=== All mp3_index Tests Complete ===\n");
+
+    // Keep running so we can see results
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Request classes, highest priority first.
+ * A waiting request is never overtaken by a lower class.
+ */
+typedef enum {
+    NET_PRIO_VOICE = 0,      // Interactive voice turn (STT, LLM)
+    NET_PRIO_TTS_PREFETCH,   // Streamed TTS of a voice turn's spoken reply
+    NET_PRIO_TELEMETRY,      // Sensor publishes
+    NET_PRIO_WEATHER,        // Environmental report (Open-Meteo, summary LLM/TTS)
+    NET_PRIO_COUNT,
+    NET_PRIO_TASK_DEFAULT = NET_PRIO_COUNT,  // Use the class registered for the calling task
+} net_priority_t;
+
+/**
+ * Admission ticket for one TLS session
+ */
+typedef struct {
+    int slot;                 // Internal slot index, -1 when not admitted
+    net_priority_t priority;  // Class the session was admitted under
+} net_session_t;
+
+/**
+ * Scheduler statistics (for diagnostics / status endpoints)
+ */
+typedef struct {
+    uint8_t active_sessions;
+    uint8_t waiting[NET_PRIO_COUNT];
+    uint32_t admitted[NET_PRIO_COUNT];
+    uint32_t timeouts[NET_PRIO_COUNT];
+    uint32_t evictions;       // Parked sessions released for a waiting request
+    bool voice_turn_active;
+} net_scheduler_stats_t;
+
+/**
+ * Called (with the scheduler lock held) to ask the owner of a parked session to
+ * close it and release its slot. Must not block or call back into the scheduler.
+ */
+typedef void (*net_evict_cb_t)(void *arg);
+
+/**
+ * @brief Initialize the network request scheduler
+ * Must be called before any HTTPS request is made.
+ * @return ESP_OK on success
+ */
+esp_err_t net_scheduler_init(void);
+
+/**
+ * @brief Wait for admission of a TLS session
+ * Blocks until a session slot is free, enough internal heap is available for a
+ * TLS context, no higher-priority request is waiting and (for background
+ * classes) no voice turn is in progress.
+ * @param priority: Request class, or NET_PRIO_TASK_DEFAULT
+ * @param timeout: Maximum time to wait in ticks (portMAX_DELAY for infinite)
+ * @param session: Filled with the admission ticket on success
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if not admitted in time
+ */
+esp_err_t net_scheduler_acquire(net_priority_t priority, TickType_t timeout, net_session_t *session);
+
+/**
+ * @brief Release a session admitted by net_scheduler_acquire()
+ * Call after esp_http_client_cleanup() so the TLS memory is already returned.
+ * @param session: Admission ticket (reset to not-admitted)
+ */
+void net_scheduler_release(net_session_t *session);
+
+/**
+ * @brief Mark an admitted session as parked (idle, kept open speculatively)
+ * A parked session keeps its slot, but when an interactive request would be
+ * deferred the scheduler calls `evict` so the owner closes it and releases
+ * the slot. Each session is evicted at most once.
+ * @param session: Admission ticket of the idle session
+ * @param evict: Callback asking the owner to release the session
+ * @param arg: Argument passed to `evict`
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the session is not admitted
+ */
+esp_err_t net_scheduler_park(const net_session_t *session, net_evict_cb_t evict, void *arg);
+
+/**
+ * @brief Take a parked session back into use
+ * After this the session is no longer evicted. No-op if it is not parked.
+ * @param session: Admission ticket passed to net_scheduler_park()
+ */
+void net_scheduler_unpark(const net_session_t *session);
+
+/**
+ * @brief Register the default request class for a task
+ * Requests made from that task with NET_PRIO_TASK_DEFAULT use this class.
+ * Unregistered tasks default to NET_PRIO_VOICE.
+ * @param task: Task handle (NULL for the calling task)
+ * @param priority: Request class
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the task table is full
+ */
+esp_err_t net_scheduler_set_task_priority(TaskHandle_t task, net_priority_t priority);
+
+/**
+ * @brief Mark the start of a voice turn
+ * Telemetry and weather requests are deferred until the turn ends.
+ */
+void net_scheduler_voice_turn_begin(void);
+
+/**
+ * @brief Mark the end of a voice turn and admit deferred background work
+ */
+void net_scheduler_voice_turn_end(void);
+
+/**
+ * @brief Check whether a voice turn is in progress
+ * @return true while a voice turn is active
+ */
+bool net_scheduler_voice_turn_active(void);
+
+/**
+ * @brief Get a snapshot of scheduler statistics
+ * @param stats: Output statistics
+ */
+void net_scheduler_get_stats(net_scheduler_stats_t *stats);
+
+/**
+ * @brief Deinitialize the scheduler
+ * @return ESP_OK on success
+ */
+esp_err_t net_scheduler_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,471 @@
+/**
+ * @file net_scheduler.c
+ * @brief Priority admission control for HTTPS/TLS sessions
+ *
+ * Each TLS session needs ~40 KB of internal RAM for mbedTLS contexts and record
+ * buffers. Instead of serializing every connection behind one mutex, requests
+ * wait here until a slot is free and the internal heap can hold another session.
+ * Waiters are served strictly by class (voice > TTS prefetch > telemetry >
+ * weather), FIFO within a class, and background classes are held back while a
+ * voice turn is in progress. Idle parked sessions (speculative pre-connects)
+ * are evicted when they would otherwise hold up an interactive request.
+ */
+
+#include "net_scheduler.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "net_sched";
+
+#ifndef CONFIG_NET_SCHEDULER_MAX_SESSIONS
+#define CONFIG_NET_SCHEDULER_MAX_SESSIONS 2
+#endif
+#ifndef CONFIG_NET_SCHEDULER_TLS_RESERVE_KB
+#define CONFIG_NET_SCHEDULER_TLS_RESERVE_KB 40
+#endif
+#ifndef CONFIG_NET_SCHEDULER_HEAP_HEADROOM_KB
+#define CONFIG_NET_SCHEDULER_HEAP_HEADROOM_KB 16
+#endif
+#ifndef CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN
+#define CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN 16384
+#endif
+#ifndef CONFIG_NET_SCHEDULER_HANDSHAKE_WINDOW_MS
+#define CONFIG_NET_SCHEDULER_HANDSHAKE_WINDOW_MS 3000
+#endif
+
+#define NET_SCHED_MAX_SESSIONS    CONFIG_NET_SCHEDULER_MAX_SESSIONS
+#define NET_SCHED_TLS_RESERVE     ((size_t)CONFIG_NET_SCHEDULER_TLS_RESERVE_KB * 1024)
+#define NET_SCHED_HEADROOM        ((size_t)CONFIG_NET_SCHEDULER_HEAP_HEADROOM_KB * 1024)
+// The largest single TLS allocation is the incoming record buffer
+#define NET_SCHED_MIN_CONTIG      (CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN + 1024)
+#define NET_SCHED_POLL_MS         250                 // Re-check heap while waiting
+#define NET_SCHED_MAX_TASKS       8
+#define NET_SCHED_HEAP_CAPS       (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+typedef struct {
+    bool in_use;
+    net_priority_t priority;
+    TickType_t admitted_at;
+    net_evict_cb_t evict;      // Set while the session is parked
+    void *evict_arg;
+} net_slot_t;
+
+typedef struct net_waiter {
+    net_priority_t priority;
+    SemaphoreHandle_t wake;
+    StaticSemaphore_t wake_buf;
+    struct net_waiter *next;
+} net_waiter_t;
+
+typedef struct {
+    TaskHandle_t task;
+    net_priority_t priority;
+} net_task_class_t;
+
+static SemaphoreHandle_t s_lock = NULL;
+static net_slot_t s_slots[NET_SCHED_MAX_SESSIONS];
+static net_waiter_t *s_waiters = NULL;  // Insertion (FIFO) order
+static net_task_class_t s_task_classes[NET_SCHED_MAX_TASKS];
+static int s_voice_turns = 0;
+static net_scheduler_stats_t s_stats;
+
+static const char *prio_name(net_priority_t prio)
+{
+    switch (prio) {
+        case NET_PRIO_VOICE: return "voice";
+        case NET_PRIO_TTS_PREFETCH: return "tts_prefetch";
+        case NET_PRIO_TELEMETRY: return "telemetry";
+        case NET_PRIO_WEATHER: return "weather";
+        default: return "?";
+    }
+}
+
+static bool is_background(net_priority_t prio)
+{
+    return prio == NET_PRIO_TELEMETRY || prio == NET_PRIO_WEATHER;
+}
+
+static net_priority_t resolve_priority(net_priority_t prio)
+{
+    if (prio < NET_PRIO_COUNT) {
+        return prio;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < NET_SCHED_MAX_TASKS; i++) {
+        if (s_task_classes[i].task == self) {
+            return s_task_classes[i].priority;
+        }
+    }
+    return NET_PRIO_VOICE;
+}
+
+// Wake every waiter so each re-evaluates its own admission (called with s_lock held)
+static void wake_waiters_locked(void)
+{
+    for (net_waiter_t *w = s_waiters; w; w = w->next) {
+        xSemaphoreGive(w->wake);
+    }
+}
+
+// True if another waiter must be served before `self` (called with s_lock held)
+static bool is_overtaken_locked(const net_waiter_t *self)
+{
+    bool queued_before_self = true;
+    for (const net_waiter_t *w = s_waiters; w; w = w->next) {
+        if (w == self) {
+            queued_before_self = false;
+            continue;
+        }
+        if (w->priority < self->priority ||
+            (queued_before_self && w->priority == self->priority)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the free slot index if `prio` may open a session now, -1 otherwise (s_lock held)
+static int try_admit_locked(net_priority_t prio)
+{
+    if (is_background(prio) && s_voice_turns > 0) {
+        return -1;
+    }
+
+    int active = 0;
+    int handshaking = 0;
+    int free_slot = -1;
+    TickType_t now = xTaskGetTickCount();
+    for (int i = 0; i < NET_SCHED_MAX_SESSIONS; i++) {
+        if (s_slots[i].in_use) {
+            active++;
+            if ((now - s_slots[i].admitted_at) < pdMS_TO_TICKS(CONFIG_NET_SCHEDULER_HANDSHAKE_WINDOW_MS)) {
+                handshaking++;
+            }
+        } else if (free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (free_slot < 0) {
+        return -1;
+    }
+
+    // Keep one slot for interactive requests
+    if (is_background(prio) && NET_SCHED_MAX_SESSIONS > 1 && active >= NET_SCHED_MAX_SESSIONS - 1) {
+        return -1;
+    }
+
+    // With nothing in flight no TLS memory will be returned by waiting, so let
+    // the request try rather than stall behind an allocation that never comes
+    if (active == 0) {
+        return free_slot;
+    }
+
+    size_t free_internal = heap_caps_get_free_size(NET_SCHED_HEAP_CAPS);
+    size_t largest = heap_caps_get_largest_free_block(NET_SCHED_HEAP_CAPS);
+    size_t pending = (size_t)handshaking * NET_SCHED_TLS_RESERVE;
+    if (free_internal < pending + NET_SCHED_TLS_RESERVE + NET_SCHED_HEADROOM ||
+        largest < NET_SCHED_MIN_CONTIG) {
+        ESP_LOGD(TAG, "Deferring %s: internal free=%zu largest=%zu pending=%zu",
+                 prio_name(prio), free_internal, largest, pending);
+        return -1;
+    }
+    return free_slot;
+}
+
+// Ask the owner of the oldest parked session to release it (s_lock held)
+static void evict_parked_locked(net_priority_t prio)
+{
+    int oldest = -1;
+    for (int i = 0; i < NET_SCHED_MAX_SESSIONS; i++) {
+        if (s_slots[i].in_use && s_slots[i].evict &&
+            (oldest < 0 || (int32_t)(s_slots[i].admitted_at - s_slots[oldest].admitted_at) < 0)) {
+            oldest = i;
+        }
+    }
+    if (oldest < 0) {
+        return;
+    }
+
+    net_evict_cb_t evict = s_slots[oldest].evict;
+    s_slots[oldest].evict = NULL;
+    s_stats.evictions++;
+    ESP_LOGI(TAG, "Evicting parked %s session (slot %d) for a %s request",
+             prio_name(s_slots[oldest].priority), oldest, prio_name(prio));
+    evict(s_slots[oldest].evict_arg);
+}
+
+static void remove_waiter_locked(net_waiter_t *waiter)
+{
+    for (net_waiter_t **pp = &s_waiters; *pp; pp = &(*pp)->next) {
+        if (*pp == waiter) {
+            *pp = waiter->next;
+            break;
+        }
+    }
+    s_stats.waiting[waiter->priority]--;
+}
+
+esp_err_t net_scheduler_init(void)
+{
+    if (s_lock != NULL) {
+        ESP_LOGW(TAG, "Network scheduler already initialized");
+        return ESP_OK;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create scheduler lock");
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(s_slots, 0, sizeof(s_slots));
+    memset(s_task_classes, 0, sizeof(s_task_classes));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_waiters = NULL;
+    s_voice_turns = 0;
+
+    ESP_LOGI(TAG, "Network scheduler initialized (%d sessions, %zu KB reserve per TLS session)",
+             NET_SCHED_MAX_SESSIONS, NET_SCHED_TLS_RESERVE / 1024);
+    return ESP_OK;
+}
+
+esp_err_t net_scheduler_acquire(net_priority_t priority, TickType_t timeout, net_session_t *session)
+{
+    if (session == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    session->slot = -1;
+    if (s_lock == NULL) {
+        ESP_LOGE(TAG, "Network scheduler not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    net_priority_t prio = resolve_priority(priority);
+    session->priority = prio;
+
+    net_waiter_t waiter = {
+        .priority = prio,
+        .next = NULL,
+    };
+    waiter.wake = xSemaphoreCreateBinaryStatic(&waiter.wake_buf);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    net_waiter_t **tail = &s_waiters;
+    while (*tail) {
+        tail = &(*tail)->next;
+    }
+    *tail = &waiter;
+    s_stats.waiting[prio]++;
+
+    TickType_t start = xTaskGetTickCount();
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    while (true) {
+        if (!is_overtaken_locked(&waiter)) {
+            int slot = try_admit_locked(prio);
+            if (slot >= 0) {
+                s_slots[slot].in_use = true;
+                s_slots[slot].priority = prio;
+                s_slots[slot].admitted_at = xTaskGetTickCount();
+                s_slots[slot].evict = NULL;
+                s_stats.active_sessions++;
+                s_stats.admitted[prio]++;
+                session->slot = slot;
+                ret = ESP_OK;
+                break;
+            }
+            // An idle parked session must not hold up interactive work; its
+            // release wakes this waiter again
+            if (!is_background(prio)) {
+                evict_parked_locked(prio);
+            }
+        }
+
+        TickType_t wait = pdMS_TO_TICKS(NET_SCHED_POLL_MS);
+        if (timeout != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= timeout) {
+                break;
+            }
+            if (timeout - elapsed < wait) {
+                wait = timeout - elapsed;
+            }
+        }
+
+        xSemaphoreGive(s_lock);
+        xSemaphoreTake(waiter.wake, wait);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+    }
+
+    remove_waiter_locked(&waiter);
+    if (ret != ESP_OK) {
+        s_stats.timeouts[prio]++;
+        // Lower classes queued behind this waiter may be admissible now
+        wake_waiters_locked();
+    }
+    xSemaphoreGive(s_lock);
+    vSemaphoreDelete(waiter.wake);
+
+    if (ret == ESP_OK) {
+        ESP_LOGD(TAG, "Admitted %s session (slot %d)", prio_name(prio), session->slot);
+    } else {
+        ESP_LOGW(TAG, "No %s session admitted within %lu ms", prio_name(prio),
+                 (unsigned long)(timeout * portTICK_PERIOD_MS));
+    }
+    return ret;
+}
+
+void net_scheduler_release(net_session_t *session)
+{
+    if (s_lock == NULL || session == NULL || session->slot < 0 || session->slot >= NET_SCHED_MAX_SESSIONS) {
+        return;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_slots[session->slot].in_use) {
+        s_slots[session->slot].in_use = false;
+        s_slots[session->slot].evict = NULL;
+        s_stats.active_sessions--;
+    }
+    wake_waiters_locked();
+    xSemaphoreGive(s_lock);
+
+    ESP_LOGD(TAG, "Released %s session (slot %d)", prio_name(session->priority), session->slot);
+    session->slot = -1;
+}
+
+esp_err_t net_scheduler_park(const net_session_t *session, net_evict_cb_t evict, void *arg)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (session == NULL || evict == NULL || session->slot < 0 || session->slot >= NET_SCHED_MAX_SESSIONS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_slots[session->slot].in_use) {
+        s_slots[session->slot].evict = evict;
+        s_slots[session->slot].evict_arg = arg;
+        // A waiter may already be deferred behind this slot
+        wake_waiters_locked();
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+void net_scheduler_unpark(const net_session_t *session)
+{
+    if (s_lock == NULL || session == NULL || session->slot < 0 || session->slot >= NET_SCHED_MAX_SESSIONS) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_slots[session->slot].evict = NULL;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t net_scheduler_set_task_priority(TaskHandle_t task, net_priority_t priority)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (priority >= NET_PRIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (task == NULL) {
+        task = xTaskGetCurrentTaskHandle();
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int free_index = -1;
+    for (int i = 0; i < NET_SCHED_MAX_TASKS; i++) {
+        if (s_task_classes[i].task == task) {
+            free_index = i;
+            break;
+        }
+        if (s_task_classes[i].task == NULL && free_index < 0) {
+            free_index = i;
+        }
+    }
+    if (free_index >= 0) {
+        s_task_classes[free_index].task = task;
+        s_task_classes[free_index].priority = priority;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Task class table full, %s requests will use voice priority", prio_name(priority));
+    }
+    return ret;
+}
+
+void net_scheduler_voice_turn_begin(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_voice_turns++;
+    xSemaphoreGive(s_lock);
+}
+
+void net_scheduler_voice_turn_end(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_voice_turns > 0) {
+        s_voice_turns--;
+    }
+    if (s_voice_turns == 0) {
+        wake_waiters_locked();
+    }
+    xSemaphoreGive(s_lock);
+}
+
+bool net_scheduler_voice_turn_active(void)
+{
+    if (s_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool active = s_voice_turns > 0;
+    xSemaphoreGive(s_lock);
+    return active;
+}
+
+void net_scheduler_get_stats(net_scheduler_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    if (s_lock == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    stats->voice_turn_active = s_voice_turns > 0;
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t net_scheduler_deinit(void)
+{
+    if (s_lock != NULL) {
+        if (s_stats.active_sessions > 0 || s_waiters != NULL) {
+            ESP_LOGW(TAG, "Deinitializing with %u active session(s)", s_stats.active_sessions);
+        }
+        vSemaphoreDelete(s_lock);
+        s_lock = NULL;
+        ESP_LOGI(TAG, "Network scheduler deinitialized");
+    }
+    return ESP_OK;
+}
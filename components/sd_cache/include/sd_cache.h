@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SD_CACHE_MAX_FILES 8    // Files with an open stream or cached blocks at once
+#define SD_CACHE_PATH_MAX  128
+
+/**
+ * @brief Called by the I/O task after each block read from the card
+ * @param us: Time in the read, seek included
+ * @param bytes: Bytes read, 0 if it failed
+ * @param arg: sd_cache_config_t.read_cb_arg
+ */
+typedef void (*sd_cache_read_cb_t)(uint32_t us, size_t bytes, void *arg);
+
+/**
+ * Cache size and read-ahead policy
+ */
+typedef struct {
+    size_t block_size;      // Bytes per block and per SD read; a multiple of 512
+    size_t cache_size;      // Bytes of blocks, allocated in PSRAM
+    uint32_t lead_ms;       // Audio kept loaded past each reader, at the rate it consumes
+    int task_priority;      // I/O task; it does every SD read of the cache
+    int task_core;
+    uint32_t max_open;      // Card file handles kept open at once, 1..SD_CACHE_MAX_FILES; keep it
+                            // below the mount's max_files so other users of the card get handles
+    sd_cache_read_cb_t read_cb;  // Optional: times the card reads, e.g. for telemetry
+    void *read_cb_arg;
+} sd_cache_config_t;
+
+#define SD_CACHE_DEFAULT_CONFIG() {      \
+    .block_size = 16 * 1024,             \
+    .cache_size = 1024 * 1024,           \
+    .lead_ms = 8000,                     \
+    .task_priority = 7,                  \
+    .task_core = 0,                      \
+    .max_open = 3,                       \
+    .read_cb = NULL,                     \
+    .read_cb_arg = NULL,                 \
+}
+
+/**
+ * Counters since sd_cache_init()
+ */
+typedef struct {
+    uint32_t hits;              // Reads served without waiting for the card
+    uint32_t misses;            // Reads that waited for a block
+    uint32_t blocks_read;       // Blocks loaded, whatever asked for them
+    uint32_t readahead_blocks;  // Loaded ahead of a reader
+    uint32_t prefetch_blocks;   // Loaded by sd_cache_prefetch()
+    uint32_t evictions;         // Loaded blocks given to other data
+    uint32_t read_errors;
+    uint32_t wait_us_max;       // Longest a reader waited for a block
+} sd_cache_stats_t;
+
+/**
+ * @brief Allocate the blocks and start the I/O task
+ * @param config: Sizes and task placement, e.g. SD_CACHE_DEFAULT_CONFIG()
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a block size that is not a multiple of 512, a
+ *         cache of fewer than four blocks or max_open out of range, ESP_ERR_NO_MEM, ESP_ERR_INVALID_STATE if running
+ */
+esp_err_t sd_cache_init(const sd_cache_config_t *config);
+
+/**
+ * @brief Stop the I/O task and free the cache
+ * Streams from sd_cache_fopen() must be closed first.
+ */
+void sd_cache_deinit(void);
+
+/**
+ * @brief Open a file for reading through the cache
+ *
+ * The stream is unbuffered: each fread() copies from cached blocks, waiting only for
+ * a block that is not loaded yet. Reads ahead of the position are scheduled at the rate
+ * the stream consumes data, so a steady reader never waits on the card. A file already
+ * prefetched opens without a FAT lookup. The cache's card handle of a file is closed
+ * when its last stream is; cached blocks stay. When the card has no handle to spare
+ * (EMFILE, ENFILE), handles of files nobody is reading are given back and the open
+ * is tried again.
+ * Without sd_cache_init() this is a plain fopen(path, "rb").
+ *
+ * @param path: File to read
+ * @return Stream to fread(), fseek() and fclose(), or NULL with errno set
+ */
+FILE *sd_cache_fopen(const char *path);
+
+/**
+ * @brief Load part of a file in the background, e.g. the start of the next track
+ * The blocks are kept for a stream to come until a newer prefetch needs the room.
+ * Prefetching waits while sd_cache_write_begin() writers are active.
+ * @param path: File to load
+ * @param offset: First byte
+ * @param bytes: Bytes from offset; cut to the file and to half the cache
+ * @return ESP_OK once queued, ESP_ERR_INVALID_STATE without sd_cache_init(),
+ *         ESP_ERR_NO_MEM if all file slots hold open streams
+ */
+esp_err_t sd_cache_prefetch(const char *path, uint32_t offset, uint32_t bytes);
+
+/**
+ * @brief Announce a write to a file on the card (an upload)
+ * Drops what is cached of path and, until sd_cache_write_end(), reads further ahead
+ * and holds back prefetches: the writer shares the SD bus and the FATFS lock, so
+ * readers get more buffered audio to ride out its writes.
+ * @param path: File about to be written, or NULL
+ */
+void sd_cache_write_begin(const char *path);
+
+/**
+ * @brief End a write started with sd_cache_write_begin()
+ * @param path: As given to sd_cache_write_begin(); cached data of it is dropped again
+ */
+void sd_cache_write_end(const char *path);
+
+/**
+ * @brief Drop what is cached of a file that changed or was removed
+ * Open streams keep working and read the file as it is now.
+ */
+void sd_cache_invalidate(const char *path);
+
+/**
+ * @brief Copy the counters
+ */
+void sd_cache_get_stats(sd_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
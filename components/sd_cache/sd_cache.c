@@ -0,0 +1,882 @@
+/**
+ * @file sd_cache.c
+ * @brief Shared PSRAM block cache for SD reads, with rate-driven read-ahead and prefetch
+ *
+ * Files are cut into fixed blocks at sector-aligned offsets. One I/O task does every SD
+ * read of the cache, a whole block at a time into an internal DMA-capable buffer, so
+ * FATFS issues one multi-sector transfer instead of a bounce per sector; the block is
+ * then copied to PSRAM. Loads run in priority order: a reader waiting, then read-ahead,
+ * then prefetch. Readers copy out of loaded blocks under a pin, without holding the lock.
+ *
+ * Read-ahead follows each file's consumption rate: the blocks covering lead_ms of data
+ * past the last read are kept loaded and are not evicted; everything else goes least
+ * recently used first.
+ *
+ * File slots outnumber the card handles the cache may hold (max_open): a slot keeps
+ * its blocks without a handle, and the I/O task opens the file again when it needs it.
+ * The FAT mount has a small fixed handle table shared with every other user of the
+ * card, so idle handles are closed least recently used first before opening another.
+ */
+
+#define _GNU_SOURCE  // fopencookie()
+#include "sd_cache.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+static const char *TAG = "sd_cache";
+
+#define SECTOR_SIZE     512
+#define MIN_BLOCKS      4
+#define IO_TASK_STACK   4096
+#define WAIT_SLICE      pdMS_TO_TICKS(100)
+#define READ_TIMEOUT_US (10 * 1000000LL)  // A reader gives up on a block after this: card gone
+#define RATE_WINDOW_US  250000            // Consumption is measured over at least this
+#define MAX_WAITERS     16
+
+// Offset type of the fopencookie() seek callback, as each C library declares it
+#if defined(__GLIBC__)
+typedef off64_t cookie_off_t;
+#elif defined(__LARGE64_FILES)
+typedef _off64_t cookie_off_t;
+#else
+typedef off_t cookie_off_t;
+#endif
+
+enum { BLOCK_FREE, BLOCK_QUEUED, BLOCK_LOADING, BLOCK_READY, BLOCK_FAILED };
+enum { PRIO_PREFETCH, PRIO_AHEAD, PRIO_DEMAND };
+
+typedef struct {
+    uint32_t file_id;   // cache_file_t.id of the data
+    uint32_t index;     // Block number in the file
+    uint32_t len;       // Valid bytes, short at the end of the file
+    uint32_t lru;       // s_tick when last used or queued
+    uint16_t pins;      // Readers copying out of it
+    uint8_t state;
+    uint8_t priority;
+} block_t;
+
+typedef struct {
+    uint32_t id;              // Unique per file and generation; 0 for a free slot
+    char path[SD_CACHE_PATH_MAX];
+    FILE *fp;                 // Plain stdio stream, read by the I/O task
+    uint32_t size;
+    uint16_t streams;         // Open sd_cache_fopen() streams
+    uint16_t io_busy;         // The I/O task is reading it with the lock released
+    bool stale;               // Invalidated during that read: close fp afterwards
+    uint32_t pos;             // Where the last stream read ended
+    uint32_t ahead;           // Bytes kept loaded past pos
+    uint32_t rate;            // Bytes per second read, smoothed
+    uint32_t rate_bytes;
+    int64_t rate_since_us;
+    uint32_t prefetch_first;  // Blocks [first, end) kept for a stream to come
+    uint32_t prefetch_end;
+    uint32_t lru;
+} cache_file_t;
+
+typedef struct {
+    cache_file_t *file;
+    uint32_t pos;
+} stream_t;
+
+static sd_cache_config_t s_config;
+static block_t *s_blocks = NULL;
+static uint32_t s_block_count = 0;
+static uint8_t *s_data = NULL;
+static uint8_t *s_staging = NULL;
+static cache_file_t s_files[SD_CACHE_MAX_FILES];
+static SemaphoreHandle_t s_lock = NULL;
+static SemaphoreHandle_t s_work = NULL;    // Given when a block is queued
+static SemaphoreHandle_t s_loaded = NULL;  // Given once per waiter when a load completes
+static SemaphoreHandle_t s_done = NULL;    // Given by the I/O task as it exits
+static uint32_t s_waiters = 0;
+static uint32_t s_tick = 0;
+static uint32_t s_next_id = 0;
+static uint32_t s_writers = 0;
+static volatile bool s_stop = false;
+static sd_cache_stats_t s_stats;
+
+static void lock(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+    xSemaphoreGive(s_lock);
+}
+
+static uint8_t *block_data(const block_t *b)
+{
+    return s_data + (size_t)(b - s_blocks) * s_config.block_size;
+}
+
+static FILE *open_file(const char *path, uint32_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    // Block reads go straight into the staging buffer
+    setvbuf(fp, NULL, _IONBF, 0);
+    long end = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        end = ftell(fp);
+    }
+    if (end < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        fclose(fp);
+        errno = EIO;
+        return NULL;
+    }
+    *size = (uint32_t)end;
+    return fp;
+}
+
+// Close the handles of files nobody is reading, least recently used first, until fewer
+// than limit are open or none is idle. Caller holds the lock.
+static void close_idle(uint32_t limit)
+{
+    for (;;) {
+        cache_file_t *victim = NULL;
+        uint32_t open = 0;
+        for (size_t i = 0; i < SD_CACHE_MAX_FILES; i++) {
+            cache_file_t *f = &s_files[i];
+            if (!f->fp) {
+                continue;
+            }
+            open++;
+            if (f->streams == 0 && f->io_busy == 0 && (!victim || f->lru < victim->lru)) {
+                victim = f;
+            }
+        }
+        if (open < limit || !victim) {
+            return;
+        }
+        fclose(victim->fp);
+        victim->fp = NULL;
+    }
+}
+
+// open_file() within max_open handles; caller does not hold the lock
+static FILE *open_file_limited(const char *path, uint32_t *size)
+{
+    lock();
+    close_idle(s_config.max_open);
+    unlock();
+    FILE *fp = open_file(path, size);
+    if (!fp && (errno == EMFILE || errno == ENFILE)) {
+        // Other users of the card hold handles too: give back every idle one and retry
+        lock();
+        close_idle(1);
+        unlock();
+        fp = open_file(path, size);
+    }
+    return fp;
+}
+
+static cache_file_t *find_file(const char *path)
+{
+    for (size_t i = 0; i < SD_CACHE_MAX_FILES; i++) {
+        if (s_files[i].id && strcmp(s_files[i].path, path) == 0) {
+            return &s_files[i];
+        }
+    }
+    return NULL;
+}
+
+static cache_file_t *file_by_id(uint32_t id)
+{
+    for (size_t i = 0; i < SD_CACHE_MAX_FILES; i++) {
+        if (s_files[i].id == id) {
+            return &s_files[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t new_id(void)
+{
+    if (++s_next_id == 0) {
+        s_next_id = 1;
+    }
+    return s_next_id;
+}
+
+// Blocks being loaded or copied from are left alone; their file id no longer matches
+static void drop_blocks(uint32_t id)
+{
+    for (uint32_t i = 0; i < s_block_count; i++) {
+        block_t *b = &s_blocks[i];
+        if (b->file_id == id && b->state != BLOCK_LOADING && b->pins == 0) {
+            b->state = BLOCK_FREE;
+            b->file_id = 0;
+        }
+    }
+}
+
+// A slot for path: a free one, or the least recently used file nobody is reading
+static cache_file_t *new_file(const char *path)
+{
+    cache_file_t *slot = NULL;
+    for (size_t i = 0; i < SD_CACHE_MAX_FILES; i++) {
+        cache_file_t *f = &s_files[i];
+        if (!f->id) {
+            slot = f;
+            break;
+        }
+        if (f->streams == 0 && f->io_busy == 0 && (!slot || f->lru < slot->lru)) {
+            slot = f;
+        }
+    }
+    if (!slot) {
+        return NULL;
+    }
+    if (slot->id) {
+        drop_blocks(slot->id);
+        if (slot->fp) {
+            fclose(slot->fp);
+        }
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->id = new_id();
+    strncpy(slot->path, path, sizeof(slot->path) - 1);
+    slot->ahead = 2 * s_config.block_size;
+    slot->lru = ++s_tick;
+    return slot;
+}
+
+static block_t *find_block(uint32_t id, uint32_t index)
+{
+    for (uint32_t i = 0; i < s_block_count; i++) {
+        block_t *b = &s_blocks[i];
+        if (b->state != BLOCK_FREE && b->file_id == id && b->index == index) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+// Within the read-ahead of a reader, or prefetched and not yet passed
+static bool is_wanted(const block_t *b)
+{
+    const cache_file_t *f = file_by_id(b->file_id);
+    if (!f) {
+        return false;
+    }
+    uint32_t first = f->pos / s_config.block_size;
+    if (f->streams > 0 && b->index >= first && b->index <= (f->pos + f->ahead) / s_config.block_size) {
+        return true;
+    }
+    return b->index >= f->prefetch_first && b->index < f->prefetch_end && (f->streams == 0 || b->index >= first);
+}
+
+/**
+ * @brief A block to load new data into
+ * @param force: A reader is waiting: take even a block that read-ahead or prefetch wants
+ * @return A free block, the least recently used one that can go, or NULL
+ */
+static block_t *take_block(bool force)
+{
+    block_t *victim = NULL;
+    for (uint32_t i = 0; i < s_block_count; i++) {
+        block_t *b = &s_blocks[i];
+        if (b->state == BLOCK_FREE) {
+            return b;
+        }
+        if (b->state == BLOCK_LOADING || b->pins > 0 || (!force && is_wanted(b))) {
+            continue;
+        }
+        if (!victim || b->lru < victim->lru) {
+            victim = b;
+        }
+    }
+    if (victim && victim->state == BLOCK_READY) {
+        s_stats.evictions++;
+    }
+    return victim;
+}
+
+/**
+ * @brief Make sure a block of a file is loaded or on its way
+ * @return false past the end of the file or when no block can be given to it
+ */
+static bool queue_block(cache_file_t *f, uint32_t index, uint8_t priority)
+{
+    if ((uint64_t)index * s_config.block_size >= f->size) {
+        return false;
+    }
+    block_t *b = find_block(f->id, index);
+    if (b) {
+        if (b->state == BLOCK_QUEUED && b->priority < priority) {
+            b->priority = priority;
+        }
+        return true;
+    }
+    b = take_block(priority == PRIO_DEMAND);
+    if (!b) {
+        return false;
+    }
+    b->file_id = f->id;
+    b->index = index;
+    b->len = 0;
+    b->lru = ++s_tick;
+    b->pins = 0;
+    b->state = BLOCK_QUEUED;
+    b->priority = priority;
+    xSemaphoreGive(s_work);
+    return true;
+}
+
+static void schedule_ahead(cache_file_t *f)
+{
+    if (f->streams == 0 || f->size == 0 || f->pos >= f->size) {
+        return;
+    }
+    uint32_t first = f->pos / s_config.block_size;
+    uint32_t last = (uint32_t)(((uint64_t)f->pos + f->ahead - 1) / s_config.block_size);
+    for (uint32_t i = first; i <= last; i++) {
+        if (!queue_block(f, i, PRIO_AHEAD)) {
+            break;
+        }
+    }
+}
+
+// Smooth the rate a file is read at and size its read-ahead from it
+static void note_read(cache_file_t *f, size_t bytes, int64_t now)
+{
+    f->rate_bytes += (uint32_t)bytes;
+    int64_t elapsed = now - f->rate_since_us;
+    if (elapsed >= RATE_WINDOW_US) {
+        uint32_t rate = (uint32_t)((uint64_t)f->rate_bytes * 1000000 / (uint64_t)elapsed);
+        f->rate = f->rate ? (3 * f->rate + rate) / 4 : rate;
+        f->rate_bytes = 0;
+        f->rate_since_us = now;
+    }
+    uint64_t ahead = (uint64_t)f->rate * s_config.lead_ms / 1000;
+    if (s_writers > 0) {
+        ahead *= 2;  // The bus is shared: keep more in hand
+    }
+    uint64_t min_ahead = 2 * (uint64_t)s_config.block_size;
+    uint64_t max_ahead = (uint64_t)(s_block_count / 2) * s_config.block_size;
+    f->ahead = (uint32_t)(ahead < min_ahead ? min_ahead : ahead > max_ahead ? max_ahead : ahead);
+    f->lru = ++s_tick;
+}
+
+static void wake_waiters(void)
+{
+    for (; s_waiters > 0; s_waiters--) {
+        xSemaphoreGive(s_loaded);
+    }
+}
+
+static block_t *next_queued(void)
+{
+    block_t *best = NULL;
+    for (uint32_t i = 0; i < s_block_count; i++) {
+        block_t *b = &s_blocks[i];
+        if (b->state != BLOCK_QUEUED || (b->priority == PRIO_PREFETCH && s_writers > 0)) {
+            continue;
+        }
+        // Highest priority first, then in the order asked for
+        if (!best || b->priority > best->priority || (b->priority == best->priority && b->lru < best->lru)) {
+            best = b;
+        }
+    }
+    return best;
+}
+
+static void io_task(void *arg)
+{
+    (void)arg;
+    lock();
+    while (!s_stop) {
+        block_t *b = next_queued();
+        cache_file_t *f = b ? file_by_id(b->file_id) : NULL;
+        if (b && !f) {
+            b->state = BLOCK_FREE;
+            continue;
+        }
+        if (!b) {
+            unlock();
+            xSemaphoreTake(s_work, portMAX_DELAY);
+            lock();
+            continue;
+        }
+
+        uint32_t id = f->id;
+        uint32_t index = b->index;
+        uint8_t priority = b->priority;
+        b->state = BLOCK_LOADING;
+        f->io_busy++;
+        FILE *fp = f->fp;
+        char path[SD_CACHE_PATH_MAX];
+        if (!fp) {
+            memcpy(path, f->path, sizeof(path));  // Closed by an invalidation: open it again
+        }
+        unlock();
+
+        uint32_t size = 0;
+        bool opened = false;
+        if (!fp) {
+            fp = open_file_limited(path, &size);
+            opened = fp != NULL;
+        }
+        size_t got = 0;
+        int64_t read_start = esp_timer_get_time();
+        if (fp && fseek(fp, (long)index * (long)s_config.block_size, SEEK_SET) == 0) {
+            got = fread(s_staging, 1, s_config.block_size, fp);
+        }
+        if (fp && s_config.read_cb) {
+            s_config.read_cb((uint32_t)(esp_timer_get_time() - read_start), got, s_config.read_cb_arg);
+        }
+        if (got > 0) {
+            memcpy(block_data(b), s_staging, got);
+        }
+
+        lock();
+        f->io_busy--;
+        if (f->stale && f->io_busy == 0) {
+            if (f->fp) {
+                fclose(f->fp);
+                f->fp = NULL;
+            }
+            f->stale = false;
+        }
+        if (opened) {
+            if (!f->fp && f->id == id) {
+                f->fp = fp;
+                f->size = size;
+            } else {
+                fclose(fp);
+            }
+        }
+        if (b->file_id != id || f->id != id) {
+            b->state = BLOCK_FREE;  // Invalidated while it loaded
+        } else if (got == 0) {
+            b->state = BLOCK_FAILED;
+            s_stats.read_errors++;
+            ESP_LOGW(TAG, "Read of %s block %" PRIu32 " failed", f->path, index);
+        } else {
+            b->state = BLOCK_READY;
+            b->len = (uint32_t)got;
+            s_stats.blocks_read++;
+            if (priority == PRIO_AHEAD) {
+                s_stats.readahead_blocks++;
+            } else if (priority == PRIO_PREFETCH) {
+                s_stats.prefetch_blocks++;
+            }
+        }
+        wake_waiters();
+    }
+    unlock();
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static ssize_t stream_read(void *cookie, char *buf, size_t len)
+{
+    stream_t *s = cookie;
+    cache_file_t *f = s->file;
+    size_t done = 0;
+    int64_t wait_start = 0;
+    bool failed = false;
+
+    lock();
+    while (done < len && s->pos < f->size) {
+        uint32_t index = s->pos / s_config.block_size;
+        block_t *b = find_block(f->id, index);
+        if (b && b->state == BLOCK_READY) {
+            uint32_t offset = s->pos - index * s_config.block_size;
+            if (offset >= b->len) {
+                break;  // The file is shorter than when it was opened
+            }
+            size_t take = b->len - offset;
+            if (take > len - done) {
+                take = len - done;
+            }
+            b->pins++;
+            b->lru = ++s_tick;
+            unlock();
+            memcpy(buf + done, block_data(b) + offset, take);
+            lock();
+            b->pins--;
+            done += take;
+            s->pos += (uint32_t)take;
+            continue;
+        }
+        if (b && b->state == BLOCK_FAILED) {
+            b->state = BLOCK_FREE;  // The next read tries again
+            failed = true;
+            break;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (!wait_start) {
+            wait_start = now;
+            s_stats.misses++;
+        } else if (now - wait_start > READ_TIMEOUT_US) {
+            ESP_LOGW(TAG, "Timed out reading %s at %" PRIu32, f->path, s->pos);
+            failed = true;
+            break;
+        }
+        if (b) {
+            b->priority = PRIO_DEMAND;
+        } else {
+            queue_block(f, index, PRIO_DEMAND);
+        }
+        s_waiters++;
+        unlock();
+        xSemaphoreTake(s_loaded, WAIT_SLICE);
+        lock();
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (wait_start) {
+        uint32_t waited = (uint32_t)(now - wait_start);
+        if (waited > s_stats.wait_us_max) {
+            s_stats.wait_us_max = waited;
+        }
+    } else if (done > 0) {
+        s_stats.hits++;
+    }
+    f->pos = s->pos;
+    note_read(f, done, now);
+    schedule_ahead(f);
+    unlock();
+
+    if (failed && done == 0) {
+        errno = EIO;
+        return -1;
+    }
+    return (ssize_t)done;
+}
+
+static int stream_seek(void *cookie, cookie_off_t *offset, int whence)
+{
+    stream_t *s = cookie;
+    int64_t base = 0;
+    if (whence == SEEK_CUR) {
+        base = s->pos;
+    } else if (whence == SEEK_END) {
+        lock();
+        base = s->file->size;
+        unlock();
+    } else if (whence != SEEK_SET) {
+        errno = EINVAL;
+        return -1;
+    }
+    int64_t pos = base + (int64_t)*offset;
+    if (pos < 0 || pos > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    s->pos = (uint32_t)pos;
+    *offset = (cookie_off_t)pos;
+    return 0;
+}
+
+static int stream_close(void *cookie)
+{
+    stream_t *s = cookie;
+    lock();
+    cache_file_t *f = s->file;
+    f->streams--;
+    // The card handle goes back; the blocks stay cached
+    if (f->streams == 0 && f->io_busy == 0 && f->fp) {
+        fclose(f->fp);
+        f->fp = NULL;
+    }
+    unlock();
+    free(s);
+    return 0;
+}
+
+// Caller holds the lock; an open fp is handed over or closed
+static cache_file_t *install_file(const char *path, FILE *fp, uint32_t size)
+{
+    cache_file_t *f = find_file(path);
+    if (!f) {
+        f = new_file(path);
+    }
+    if (f && !f->fp) {
+        f->fp = fp;
+        f->size = size;
+    } else if (fp) {
+        fclose(fp);
+    }
+    return f;
+}
+
+// Open path unless the cache has it open already; caller does not hold the lock
+static esp_err_t ensure_open(const char *path)
+{
+    lock();
+    cache_file_t *f = find_file(path);
+    bool open = f && f->fp;
+    unlock();
+    if (open) {
+        return ESP_OK;
+    }
+    uint32_t size;
+    FILE *fp = open_file_limited(path, &size);
+    if (!fp) {
+        return errno == EMFILE || errno == ENFILE ? ESP_ERR_NO_MEM : ESP_ERR_NOT_FOUND;
+    }
+    lock();
+    f = install_file(path, fp, size);
+    unlock();
+    return f ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+FILE *sd_cache_fopen(const char *path)
+{
+    if (!s_blocks || strlen(path) >= SD_CACHE_PATH_MAX) {
+        return fopen(path, "rb");
+    }
+    stream_t *s = calloc(1, sizeof(stream_t));
+    if (!s) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    esp_err_t err = ensure_open(path);
+    if (err != ESP_OK) {
+        free(s);
+        errno = err == ESP_ERR_NO_MEM ? EMFILE : ENOENT;
+        return NULL;
+    }
+
+    lock();
+    cache_file_t *f = find_file(path);
+    if (!f) {
+        // Evicted between the two locks by other opens
+        unlock();
+        free(s);
+        errno = EMFILE;
+        return NULL;
+    }
+    f->streams++;
+    f->pos = 0;
+    f->rate = 0;
+    f->rate_bytes = 0;
+    f->rate_since_us = esp_timer_get_time();
+    f->ahead = 2 * s_config.block_size;
+    f->lru = ++s_tick;
+    schedule_ahead(f);
+    unlock();
+
+    s->file = f;
+    cookie_io_functions_t io = {
+        .read = stream_read,
+        .write = NULL,
+        .seek = stream_seek,
+        .close = stream_close,
+    };
+    FILE *fp = fopencookie(s, "r", io);
+    if (!fp) {
+        stream_close(s);
+        errno = ENOMEM;
+        return NULL;
+    }
+    setvbuf(fp, NULL, _IONBF, 0);  // Reads copy from the blocks: another buffer would only add a copy
+    return fp;
+}
+
+esp_err_t sd_cache_prefetch(const char *path, uint32_t offset, uint32_t bytes)
+{
+    if (!s_blocks) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!path || strlen(path) >= SD_CACHE_PATH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The FAT lookup happens here, not when playback opens the file
+    esp_err_t err = ensure_open(path);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    lock();
+    cache_file_t *f = find_file(path);
+    if (f && offset < f->size) {
+        uint32_t max_bytes = (s_block_count / 2) * (uint32_t)s_config.block_size;
+        if (bytes > max_bytes) {
+            bytes = max_bytes;
+        }
+        uint64_t end = (uint64_t)offset + bytes;
+        if (end > f->size) {
+            end = f->size;
+        }
+        // The newest prefetch has the claim on the cache
+        for (size_t i = 0; i < SD_CACHE_MAX_FILES; i++) {
+            s_files[i].prefetch_first = 0;
+            s_files[i].prefetch_end = 0;
+        }
+        f->prefetch_first = offset / s_config.block_size;
+        f->prefetch_end = (uint32_t)((end + s_config.block_size - 1) / s_config.block_size);
+        f->lru = ++s_tick;
+        for (uint32_t i = f->prefetch_first; i < f->prefetch_end; i++) {
+            if (!queue_block(f, i, PRIO_PREFETCH)) {
+                break;
+            }
+        }
+    }
+    unlock();
+    return f ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void sd_cache_invalidate(const char *path)
+{
+    if (!s_blocks || !path) {
+        return;
+    }
+    lock();
+    cache_file_t *f = find_file(path);
+    if (f) {
+        drop_blocks(f->id);
+        if (f->streams == 0 && f->io_busy == 0) {
+            if (f->fp) {
+                fclose(f->fp);
+            }
+            memset(f, 0, sizeof(*f));
+        } else {
+            // Open streams carry on with the file as it is now
+            f->id = new_id();
+            f->prefetch_first = 0;
+            f->prefetch_end = 0;
+            if (f->io_busy) {
+                f->stale = true;
+            } else if (f->fp) {
+                fclose(f->fp);
+                f->fp = NULL;
+            }
+        }
+    }
+    unlock();
+}
+
+void sd_cache_write_begin(const char *path)
+{
+    if (!s_blocks) {
+        return;
+    }
+    lock();
+    s_writers++;
+    unlock();
+    sd_cache_invalidate(path);
+}
+
+void sd_cache_write_end(const char *path)
+{
+    if (!s_blocks) {
+        return;
+    }
+    sd_cache_invalidate(path);
+    lock();
+    if (s_writers > 0) {
+        s_writers--;
+    }
+    unlock();
+    xSemaphoreGive(s_work);  // Prefetches held back may go now
+}
+
+void sd_cache_get_stats(sd_cache_stats_t *stats)
+{
+    if (!s_blocks) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    lock();
+    *stats = s_stats;
+    unlock();
+}
+
+static void free_cache(void)
+{
+    for (size_t i = 0; i < SD_CACHE_MAX_FILES; i++) {
+        if (s_files[i].fp) {
+            fclose(s_files[i].fp);
+        }
+    }
+    memset(s_files, 0, sizeof(s_files));
+    heap_caps_free(s_data);
+    heap_caps_free(s_staging);
+    free(s_blocks);
+    s_data = NULL;
+    s_staging = NULL;
+    s_blocks = NULL;
+    s_block_count = 0;
+    if (s_lock) {
+        vSemaphoreDelete(s_lock);
+    }
+    if (s_work) {
+        vSemaphoreDelete(s_work);
+    }
+    if (s_loaded) {
+        vSemaphoreDelete(s_loaded);
+    }
+    if (s_done) {
+        vSemaphoreDelete(s_done);
+    }
+    s_lock = s_work = s_loaded = s_done = NULL;
+}
+
+esp_err_t sd_cache_init(const sd_cache_config_t *config)
+{
+    if (s_blocks) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!config || config->block_size == 0 || config->block_size % SECTOR_SIZE != 0 ||
+        config->cache_size / config->block_size < MIN_BLOCKS || config->max_open == 0 ||
+        config->max_open > SD_CACHE_MAX_FILES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *config;
+    uint32_t count = (uint32_t)(config->cache_size / config->block_size);
+
+    s_blocks = calloc(count, sizeof(block_t));
+    s_data = heap_caps_malloc((size_t)count * config->block_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    // Internal and DMA-capable, so the SD driver transfers a block in one go
+    s_staging = heap_caps_malloc(config->block_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    s_lock = xSemaphoreCreateMutex();
+    s_work = xSemaphoreCreateBinary();
+    s_loaded = xSemaphoreCreateCounting(MAX_WAITERS, 0);
+    s_done = xSemaphoreCreateBinary();
+    if (!s_blocks || !s_data || !s_staging || !s_lock || !s_work || !s_loaded || !s_done) {
+        ESP_LOGE(TAG, "No memory for a %u KB cache", (unsigned)(config->cache_size / 1024));
+        free_cache();
+        return ESP_ERR_NO_MEM;
+    }
+    s_block_count = count;
+    s_waiters = 0;
+    s_writers = 0;
+    s_stop = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+
+    if (xTaskCreatePinnedToCore(io_task, "sd_cache", IO_TASK_STACK, NULL, config->task_priority, NULL,
+                                config->task_core) != pdPASS) {
+        free_cache();
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "%" PRIu32 " blocks of %u KB, %" PRIu32 " ms read-ahead", count,
+             (unsigned)(config->block_size / 1024), config->lead_ms);
+    return ESP_OK;
+}
+
+void sd_cache_deinit(void)
+{
+    if (!s_blocks) {
+        return;
+    }
+    s_stop = true;
+    xSemaphoreGive(s_work);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    free_cache();
+}
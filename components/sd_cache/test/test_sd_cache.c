@@ -0,0 +1,319 @@
+/**
+ * @file test_sd_cache.c
+ * @brief Read, seek, prefetch, invalidation and card-handle tests for sd_cache
+ *
+ * Needs a card mounted at SD_CACHE_TEST_DIR; the test file is removed afterwards.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sd_cache.h"
+
+static const char *TAG = "test_sd_cache";
+
+#ifndef SD_CACHE_TEST_DIR
+#define SD_CACHE_TEST_DIR "/sdcard"
+#endif
+#ifndef SD_CACHE_TEST_MAX_FILES
+#define SD_CACHE_TEST_MAX_FILES 5  // max_files of the card's FAT mount
+#endif
+
+#define TEST_FILE   SD_CACHE_TEST_DIR "/sdc_test.bin"
+#define BLOCK_SIZE  4096
+#define CACHE_SIZE  (16 * BLOCK_SIZE)
+#define FILE_SIZE   (50 * BLOCK_SIZE + 123)  // Larger than the cache, with a short last block
+#define MAX_OPEN    2
+#define MANY_FILES  (SD_CACHE_MAX_FILES + SD_CACHE_TEST_MAX_FILES + 1)
+
+static uint8_t s_buf[3 * BLOCK_SIZE];
+static volatile uint32_t s_timed_reads;
+static volatile uint32_t s_timed_bytes;
+
+// Runs on the I/O task
+static void on_read(uint32_t us, size_t bytes, void *arg)
+{
+    (void)us;
+    if (arg == (void *)&s_timed_reads) {
+        s_timed_reads++;
+        s_timed_bytes += (uint32_t)bytes;
+    }
+}
+
+static uint8_t pattern(uint32_t offset, uint8_t seed)
+{
+    return (uint8_t)((offset * 2654435761u) >> 24) ^ seed;
+}
+
+static void write_path(const char *path, uint32_t size, uint8_t seed)
+{
+    FILE *fp = fopen(path, "wb");
+    TEST_ASSERT_NOT_NULL(fp);
+    for (uint32_t i = 0; i < size; i++) {
+        fputc(pattern(i, seed), fp);
+    }
+    fclose(fp);
+}
+
+static void write_file(uint8_t seed)
+{
+    write_path(TEST_FILE, FILE_SIZE, seed);
+}
+
+static void many_path(char *path, size_t len, int i)
+{
+    snprintf(path, len, SD_CACHE_TEST_DIR "/sdc_%d.bin", i);
+}
+
+static void check(const uint8_t *data, uint32_t offset, size_t len, uint8_t seed)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != pattern(offset + (uint32_t)i, seed)) {
+            TEST_FAIL_MESSAGE("Data differs from the file");
+        }
+    }
+}
+
+void setUp(void)
+{
+    sd_cache_config_t config = SD_CACHE_DEFAULT_CONFIG();
+    config.block_size = BLOCK_SIZE;
+    config.cache_size = CACHE_SIZE;
+    config.lead_ms = 1000;
+    config.max_open = MAX_OPEN;
+    config.read_cb = on_read;
+    config.read_cb_arg = (void *)&s_timed_reads;
+    s_timed_reads = 0;
+    s_timed_bytes = 0;
+    write_file(0);
+    TEST_ASSERT_EQUAL(ESP_OK, sd_cache_init(&config));
+}
+
+void tearDown(void)
+{
+    sd_cache_deinit();
+    remove(TEST_FILE);
+}
+
+/**
+ * @brief Reads of every size across block edges return the file, through more data than fits
+ */
+void test_read(void)
+{
+    FILE *fp = sd_cache_fopen(TEST_FILE);
+    TEST_ASSERT_NOT_NULL(fp);
+    uint32_t offset = 0;
+    size_t len = 1;
+    while (offset < FILE_SIZE) {
+        size_t got = fread(s_buf, 1, len, fp);
+        TEST_ASSERT_TRUE(got > 0);
+        check(s_buf, offset, got, 0);
+        offset += (uint32_t)got;
+        len = len * 7 % sizeof(s_buf) + 1;
+    }
+    TEST_ASSERT_EQUAL_UINT32(FILE_SIZE, offset);
+    TEST_ASSERT_EQUAL(0, fread(s_buf, 1, sizeof(s_buf), fp));
+    TEST_ASSERT_TRUE(feof(fp));
+    fclose(fp);
+
+    sd_cache_stats_t stats;
+    sd_cache_get_stats(&stats);
+    ESP_LOGI(TAG, "hits %u misses %u read %u ahead %u evicted %u", (unsigned)stats.hits, (unsigned)stats.misses,
+             (unsigned)stats.blocks_read, (unsigned)stats.readahead_blocks, (unsigned)stats.evictions);
+    TEST_ASSERT_TRUE(stats.blocks_read >= FILE_SIZE / BLOCK_SIZE);
+    TEST_ASSERT_TRUE(stats.evictions > 0);
+    TEST_ASSERT_EQUAL(0, stats.read_errors);
+    // Every card read is timed, and only those: stream reads copy from the blocks.
+    // The last read-ahead may still be loading, timed but not yet counted.
+    TEST_ASSERT_TRUE(s_timed_reads >= stats.blocks_read && s_timed_reads <= stats.blocks_read + 1);
+    TEST_ASSERT_TRUE(s_timed_bytes >= FILE_SIZE);
+
+    TEST_ASSERT_NULL(sd_cache_fopen(SD_CACHE_TEST_DIR "/missing.bin"));
+}
+
+/**
+ * @brief fseek() and ftell() behave as on a plain file
+ */
+void test_seek(void)
+{
+    FILE *fp = sd_cache_fopen(TEST_FILE);
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(0, fseek(fp, 0, SEEK_END));
+    TEST_ASSERT_EQUAL(FILE_SIZE, ftell(fp));
+
+    const uint32_t offsets[] = {FILE_SIZE - 100, 5, 3 * BLOCK_SIZE - 1, 40 * BLOCK_SIZE, 0};
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        TEST_ASSERT_EQUAL(0, fseek(fp, offsets[i], SEEK_SET));
+        size_t got = fread(s_buf, 1, 100, fp);
+        TEST_ASSERT_EQUAL(100, got);
+        check(s_buf, offsets[i], got, 0);
+        TEST_ASSERT_EQUAL(offsets[i] + 100, ftell(fp));
+    }
+    TEST_ASSERT_EQUAL(0, fseek(fp, -10, SEEK_END));
+    TEST_ASSERT_EQUAL(10, fread(s_buf, 1, sizeof(s_buf), fp));
+    check(s_buf, FILE_SIZE - 10, 10, 0);
+    TEST_ASSERT_EQUAL(0, fseek(fp, -(long)BLOCK_SIZE, SEEK_CUR));
+    TEST_ASSERT_EQUAL(FILE_SIZE - BLOCK_SIZE, ftell(fp));
+    fclose(fp);
+}
+
+/**
+ * @brief A prefetched start is read without waiting; prefetching a missing file fails
+ */
+void test_prefetch(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, sd_cache_prefetch(TEST_FILE, 0, 4 * BLOCK_SIZE));
+    sd_cache_stats_t stats;
+    for (int i = 0; i < 100; i++) {
+        sd_cache_get_stats(&stats);
+        if (stats.prefetch_blocks == 4) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(4, stats.prefetch_blocks);
+
+    FILE *fp = sd_cache_fopen(TEST_FILE);
+    TEST_ASSERT_NOT_NULL(fp);
+    for (uint32_t offset = 0; offset < 4 * BLOCK_SIZE; offset += 1000) {
+        size_t got = fread(s_buf, 1, 1000, fp);
+        TEST_ASSERT_EQUAL(1000, got);
+        check(s_buf, offset, got, 0);
+    }
+    fclose(fp);
+    sd_cache_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.misses);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, sd_cache_prefetch(SD_CACHE_TEST_DIR "/missing.bin", 0, BLOCK_SIZE));
+}
+
+/**
+ * @brief After a write announced with sd_cache_write_begin() readers see the new data
+ */
+void test_write(void)
+{
+    FILE *fp = sd_cache_fopen(TEST_FILE);
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, fread(s_buf, 1, BLOCK_SIZE, fp));
+    fclose(fp);
+
+    sd_cache_write_begin(TEST_FILE);
+    write_file(0x5a);
+    sd_cache_write_end(TEST_FILE);
+
+    fp = sd_cache_fopen(TEST_FILE);
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, fread(s_buf, 1, BLOCK_SIZE, fp));
+    check(s_buf, 0, BLOCK_SIZE, 0x5a);
+    fclose(fp);
+}
+
+/**
+ * @brief Two streams of one file read independently
+ */
+void test_two_streams(void)
+{
+    FILE *a = sd_cache_fopen(TEST_FILE);
+    FILE *b = sd_cache_fopen(TEST_FILE);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_EQUAL(0, fseek(b, 20 * BLOCK_SIZE, SEEK_SET));
+    for (uint32_t i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(BLOCK_SIZE, fread(s_buf, 1, BLOCK_SIZE, a));
+        check(s_buf, i * BLOCK_SIZE, BLOCK_SIZE, 0);
+        TEST_ASSERT_EQUAL(BLOCK_SIZE, fread(s_buf, 1, BLOCK_SIZE, b));
+        check(s_buf, (20 + i) * BLOCK_SIZE, BLOCK_SIZE, 0);
+    }
+    fclose(a);
+    fclose(b);
+}
+
+/**
+ * @brief More files than the mount has handles for: the cache keeps at most max_open, so
+ * plain opens still succeed, and it gives idle ones back when the card runs out
+ */
+void test_many_files(void)
+{
+    char path[64];
+    for (int i = 0; i < MANY_FILES; i++) {
+        many_path(path, sizeof(path), i);
+        write_path(path, 2 * BLOCK_SIZE, (uint8_t)i);
+    }
+    for (int i = 0; i < MANY_FILES - 1; i++) {  // The last one is left for a cold prefetch
+        many_path(path, sizeof(path), i);
+        if (i % 2) {
+            TEST_ASSERT_EQUAL(ESP_OK, sd_cache_prefetch(path, 0, BLOCK_SIZE));
+        }
+        FILE *fp = sd_cache_fopen(path);
+        TEST_ASSERT_NOT_NULL(fp);
+        TEST_ASSERT_EQUAL(BLOCK_SIZE, fread(s_buf, 1, BLOCK_SIZE, fp));
+        check(s_buf, 0, BLOCK_SIZE, (uint8_t)i);
+        fclose(fp);
+    }
+
+    // Everything but the cache's share is free for other users
+    FILE *plain[SD_CACHE_TEST_MAX_FILES];
+    int held = 0;
+    for (; held < SD_CACHE_TEST_MAX_FILES - MAX_OPEN; held++) {
+        plain[held] = fopen(TEST_FILE, "rb");
+        TEST_ASSERT_NOT_NULL_MESSAGE(plain[held], "The cache holds on to card handles");
+    }
+    // Others hold all but one handle: an idle prefetch gives its handle back for a reader
+    sd_cache_stats_t stats;
+    sd_cache_get_stats(&stats);
+    uint32_t prefetched = stats.prefetch_blocks;
+    many_path(path, sizeof(path), MANY_FILES - 1);
+    TEST_ASSERT_EQUAL(ESP_OK, sd_cache_prefetch(path, 0, BLOCK_SIZE));
+    for (int i = 0; i < 100 && stats.prefetch_blocks == prefetched; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        sd_cache_get_stats(&stats);
+    }
+    TEST_ASSERT_EQUAL(prefetched + 1, stats.prefetch_blocks);
+    for (; held < SD_CACHE_TEST_MAX_FILES - 1; held++) {
+        plain[held] = fopen(TEST_FILE, "rb");
+        TEST_ASSERT_NOT_NULL(plain[held]);
+    }
+    many_path(path, sizeof(path), 0);
+    FILE *fp = sd_cache_fopen(path);
+    TEST_ASSERT_NOT_NULL_MESSAGE(fp, "Idle cache handles were not given back");
+    TEST_ASSERT_EQUAL(BLOCK_SIZE, fread(s_buf, 1, BLOCK_SIZE, fp));
+    check(s_buf, 0, BLOCK_SIZE, 0);
+    fclose(fp);
+
+    while (held > 0) {
+        fclose(plain[--held]);
+    }
+    for (int i = 0; i < MANY_FILES; i++) {
+        many_path(path, sizeof(path), i);
+        remove(path);
+    }
+}
+
+void app_main(void)
+{
+    // Wait a bit for serial output to initialize
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    ESP_LOGI(TAG, "\n\n=== sd_cache Unit Tests ===\n");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_read);
+    RUN_TEST(test_seek);
+    RUN_TEST(test_prefetch);
+    RUN_TEST(test_write);
+    RUN_TEST(test_two_streams);
+    RUN_TEST(test_many_files);
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "\n=== All sd_cache Tests Complete ===\n");
+
+    // Keep running so we can see results
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
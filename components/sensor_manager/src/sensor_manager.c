@@ -18,7 +18,7 @@
 #endif
 #include "esp_timer.h"
 #include "somnus_profile.h"
-#include "tls_mutex.h"
+#include "net_scheduler.h"
 #include "cJSON.h"
 #include <time.h>
 #include <string.h>
@@ -341,13 +341,18 @@ static void sensor_manager_collect_and_publish(void)
     // This is a temporary workaround for development
     ESP_LOGW(SENSOR_MANAGER_TAG, "⚠️  Development mode: Certificate verification disabled");
     
-    // Acquire TLS mutex to serialize TLS connections
-    // This prevents concurrent TLS connections that cause memory allocation errors
-    esp_err_t mutex_err = tls_mutex_take(pdMS_TO_TICKS(5000));  // 5 second timeout
-    if (mutex_err != ESP_OK) {
-        ESP_LOGW(SENSOR_MANAGER_TAG, "Failed to acquire TLS mutex, skipping publish: %s", esp_err_to_name(mutex_err));
+    // Queue for a telemetry-class TLS session. Voice turns and memory pressure
+    // defer the publish; it is only dropped once the next sample is due, since
+    // that sample supersedes this one.
+    net_session_t session;
+    esp_err_t sched_err = net_scheduler_acquire(NET_PRIO_TELEMETRY,
+                                                pdMS_TO_TICKS(CONFIG_SENSOR_MANAGER_PUBLISH_INTERVAL_MS),
+                                                &session);
+    if (sched_err != ESP_OK) {
+        ESP_LOGW(SENSOR_MANAGER_TAG, "Telemetry publish deferred past next interval, dropping: %s",
+                 esp_err_to_name(sched_err));
         free(payload);
-        return;  // Non-blocking - skip this publish if mutex unavailable
+        return;
     }
     
     // Configure HTTP client to skip certificate verification
@@ -380,8 +385,8 @@ static void sensor_manager_collect_and_publish(void)
         ESP_LOGE(SENSOR_MANAGER_TAG, "Failed to initialize HTTP client");
     }
     
-    // Release TLS mutex after connection is complete
-    tls_mutex_give();
+    // Release the session after cleanup so its TLS memory is already returned
+    net_scheduler_release(&session);
 
     free(payload);
 }
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACK_CATALOG_NONE         UINT32_MAX  // track_catalog_find(): no such track
+#define TRACK_CATALOG_GAIN_UNKNOWN INT16_MIN   // replay_gain when the file carries none
+#define TRACK_CATALOG_MAX_TRACKS   65536
+
+/**
+ * Entry flags
+ */
+#define TRACK_CATALOG_WAV     0x01  // Streamed as is; otherwise MP3
+#define TRACK_CATALOG_INDEXED 0x02  // The metadata below file_size/mtime has been read from the file
+
+/**
+ * One track. Strings are offsets into the catalog's string table: read them with
+ * track_catalog_str(). The layout is the on-disk one.
+ */
+typedef struct {
+    uint32_t name;          // File name without its extension: the lookup key
+    uint32_t display_name;
+    uint32_t dir;           // Directory, without a trailing '/'
+    uint32_t file;          // File name with its extension
+    uint32_t file_size;     // As last seen, to notice a replaced file
+    uint32_t mtime;
+    uint32_t duration_ms;   // 0 until indexed
+    uint32_t sample_rate;
+    uint16_t bitrate_kbps;  // Average over the file
+    int16_t replay_gain;    // Track gain in 0.1 dB, or TRACK_CATALOG_GAIN_UNKNOWN
+    uint8_t channels;
+    uint8_t flags;
+    uint16_t reserved;
+} track_catalog_entry_t;
+
+/**
+ * Track library: entries, a hash index on the case-folded name and a string table in
+ * which each distinct string is stored once. The file is these three arrays behind a
+ * header, so loading it is one read per array with no per-track work beyond checks.
+ */
+typedef struct {
+    track_catalog_entry_t *entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *slots;          // Open addressing, linear probing: entry index + 1, 0 for empty
+    uint32_t slot_count;      // Power of two, at least twice count
+    char *strings;
+    uint32_t string_bytes;
+    uint32_t string_capacity;
+    uint32_t *interned;       // String offset + 1 by hash; built on the first add, not stored
+    uint32_t interned_count;
+    uint32_t interned_slots;
+    void **retired;           // String blocks outgrown or compacted away, freed with the catalog
+    uint32_t retired_count;
+    bool dirty;               // Changed since it was loaded or saved
+} track_catalog_t;
+
+/**
+ * @brief Start an empty catalog
+ */
+void track_catalog_init(track_catalog_t *cat);
+
+/**
+ * @brief Release a catalog; strings it returned become invalid
+ */
+void track_catalog_free(track_catalog_t *cat);
+
+/**
+ * @brief Read a catalog written by track_catalog_write()
+ * @param cat: Replaced on success, left empty on failure
+ * @param fp: Open catalog file
+ * @return ESP_OK, ESP_ERR_INVALID_VERSION for another format version, ESP_ERR_INVALID_RESPONSE
+ *         for a damaged file, ESP_ERR_NO_MEM
+ */
+esp_err_t track_catalog_read(track_catalog_t *cat, FILE *fp);
+
+/**
+ * @brief Serialize a catalog
+ * @return ESP_OK, ESP_FAIL on a write error
+ */
+esp_err_t track_catalog_write(const track_catalog_t *cat, FILE *fp);
+
+/**
+ * @brief Load a catalog file
+ * @return As track_catalog_read(), ESP_ERR_NOT_FOUND if there is no file
+ */
+esp_err_t track_catalog_load(track_catalog_t *cat, const char *path);
+
+/**
+ * @brief Save a catalog file; a temporary file is renamed over it, so a power cut
+ * leaves either the old catalog or the new one
+ * @return ESP_OK, ESP_FAIL if it could not be written
+ */
+esp_err_t track_catalog_save(track_catalog_t *cat, const char *path);
+
+/**
+ * @brief Look up a track by name, ignoring case
+ * @param name: File name without its extension
+ * @return Entry index, or TRACK_CATALOG_NONE
+ */
+uint32_t track_catalog_find(const track_catalog_t *cat, const char *name);
+
+/**
+ * @brief Add a track, or move an existing one of the same name to a new file
+ * A track whose file changed has its metadata cleared, to be indexed again.
+ * @param dir: Directory of the file, without a trailing '/'
+ * @param file: File name with its extension; the name is this without the extension
+ * @param display_name: Name for the UI
+ * @param index: Set to the entry index, may be NULL
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a file name with no stem, ESP_ERR_INVALID_SIZE
+ *         when the catalog is full, ESP_ERR_NO_MEM
+ */
+esp_err_t track_catalog_add(track_catalog_t *cat, const char *dir, const char *file, const char *display_name,
+                            uint32_t *index);
+
+/**
+ * @brief Remove a track; the last entry takes its index
+ * Its strings stay in the table until track_catalog_compact().
+ */
+void track_catalog_remove(track_catalog_t *cat, uint32_t index);
+
+/**
+ * @brief Rebuild the string table without the strings of removed tracks
+ * @return ESP_OK, ESP_ERR_NO_MEM (the catalog is unchanged)
+ */
+esp_err_t track_catalog_compact(track_catalog_t *cat);
+
+/**
+ * @brief String at an offset in the table
+ * Strings stay valid until track_catalog_free(), across adds and compaction.
+ */
+const char *track_catalog_str(const track_catalog_t *cat, uint32_t offset);
+
+/**
+ * @brief Full path of a track's file
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE if out is too small
+ */
+esp_err_t track_catalog_path(const track_catalog_t *cat, uint32_t index, char *out, size_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
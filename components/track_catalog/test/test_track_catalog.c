@@ -0,0 +1,246 @@
+/**
+ * @file test_track_catalog.c
+ * @brief Lookup, update, removal, compaction and file format tests for track_catalog
+ *
+ * A thousand generated names exercise growth, hashing and compaction; the saved
+ * format is written to and read back from an fmemopen() buffer, damaged copies included.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "track_catalog.h"
+
+static const char *TAG = "test_track_catalog";
+
+#define TRACKS 1000
+
+static track_catalog_t s_cat;
+
+static void add_numbered(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++) {
+        char file[32];
+        char display[32];
+        snprintf(file, sizeof(file), "track_%04u.mp3", (unsigned)i);
+        snprintf(display, sizeof(display), "Track %u", (unsigned)i);
+        uint32_t index;
+        TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard/sounds", file, display, &index));
+        TEST_ASSERT_EQUAL_UINT32(i, index);
+        s_cat.entries[index].duration_ms = 1000 + i;
+    }
+}
+
+void setUp(void)
+{
+    track_catalog_init(&s_cat);
+}
+
+void tearDown(void)
+{
+    track_catalog_free(&s_cat);
+}
+
+/**
+ * @brief Names are found ignoring case; paths, flags and interned strings are as added
+ */
+void test_add_find(void)
+{
+    uint32_t rain;
+    uint32_t ocean;
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard/sounds", "paris_rain_sleep.mp3",
+                                                "Paris Rain Sleep", &rain));
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard/sounds", "OCEAN~1.WAV", "OCEAN~1", &ocean));
+    TEST_ASSERT_EQUAL_UINT32(2, s_cat.count);
+    TEST_ASSERT_TRUE(s_cat.dirty);
+
+    TEST_ASSERT_EQUAL_UINT32(rain, track_catalog_find(&s_cat, "paris_rain_sleep"));
+    TEST_ASSERT_EQUAL_UINT32(rain, track_catalog_find(&s_cat, "PARIS_RAIN_SLEEP"));
+    TEST_ASSERT_EQUAL_UINT32(ocean, track_catalog_find(&s_cat, "ocean~1"));
+    TEST_ASSERT_EQUAL_UINT32(TRACK_CATALOG_NONE, track_catalog_find(&s_cat, "paris_rain"));
+    TEST_ASSERT_EQUAL_UINT32(TRACK_CATALOG_NONE, track_catalog_find(&s_cat, ""));
+
+    const track_catalog_entry_t *e = &s_cat.entries[ocean];
+    TEST_ASSERT_EQUAL_STRING("OCEAN~1", track_catalog_str(&s_cat, e->name));
+    TEST_ASSERT_EQUAL_UINT32(e->name, e->display_name);  // Interned once
+    TEST_ASSERT_EQUAL_UINT32(s_cat.entries[rain].dir, e->dir);
+    TEST_ASSERT_EQUAL(TRACK_CATALOG_WAV, e->flags);
+    TEST_ASSERT_EQUAL_INT16(TRACK_CATALOG_GAIN_UNKNOWN, e->replay_gain);
+    TEST_ASSERT_EQUAL(0, s_cat.entries[rain].flags);
+
+    char path[64];
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_path(&s_cat, rain, path, sizeof(path)));
+    TEST_ASSERT_EQUAL_STRING("/sdcard/sounds/paris_rain_sleep.mp3", path);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, track_catalog_path(&s_cat, rain, path, 16));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, track_catalog_add(&s_cat, "/sdcard", ".mp3", "x", NULL));
+}
+
+/**
+ * @brief Adding a known file keeps its metadata; a new file for the name clears it
+ */
+void test_update(void)
+{
+    uint32_t index;
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard/sounds", "white_noise.mp3", "White Noise", &index));
+    s_cat.entries[index].duration_ms = 60000;
+    s_cat.entries[index].flags |= TRACK_CATALOG_INDEXED;
+    s_cat.dirty = false;
+
+    uint32_t again;
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard/sounds", "white_noise.mp3", "White Noise", &again));
+    TEST_ASSERT_EQUAL_UINT32(index, again);
+    TEST_ASSERT_FALSE(s_cat.dirty);
+    TEST_ASSERT_EQUAL_UINT32(60000, s_cat.entries[index].duration_ms);
+
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard/sounds", "white_noise.wav", "White Noise", &again));
+    TEST_ASSERT_EQUAL_UINT32(index, again);
+    TEST_ASSERT_EQUAL_UINT32(1, s_cat.count);
+    TEST_ASSERT_TRUE(s_cat.dirty);
+    TEST_ASSERT_EQUAL_UINT32(0, s_cat.entries[index].duration_ms);
+    TEST_ASSERT_EQUAL(TRACK_CATALOG_WAV, s_cat.entries[index].flags);
+}
+
+/**
+ * @brief Many tracks: every one is found, and strings handed out survive the table growing
+ */
+void test_many(void)
+{
+    uint32_t first;
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard", "first.mp3", "First", &first));
+    const char *name = track_catalog_str(&s_cat, s_cat.entries[first].name);
+    track_catalog_remove(&s_cat, first);
+    add_numbered(TRACKS);
+    TEST_ASSERT_EQUAL_STRING("first", name);
+    TEST_ASSERT_TRUE(s_cat.slot_count >= 2 * s_cat.count);
+    for (uint32_t i = 0; i < TRACKS; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "TRACK_%04u", (unsigned)i);
+        uint32_t index = track_catalog_find(&s_cat, key);
+        TEST_ASSERT_EQUAL_UINT32(i, index);
+        TEST_ASSERT_EQUAL_UINT32(1000 + i, s_cat.entries[index].duration_ms);
+    }
+}
+
+/**
+ * @brief Removal keeps the rest reachable; compaction drops the removed strings only
+ */
+void test_remove_compact(void)
+{
+    add_numbered(TRACKS);
+    for (uint32_t i = 0; i < TRACKS; i += 3) {
+        char key[32];
+        snprintf(key, sizeof(key), "track_%04u", (unsigned)i);
+        track_catalog_remove(&s_cat, track_catalog_find(&s_cat, key));
+    }
+    TEST_ASSERT_EQUAL_UINT32(TRACKS - (TRACKS + 2) / 3, s_cat.count);
+    uint32_t before = s_cat.string_bytes;
+    const char *kept = track_catalog_str(&s_cat, s_cat.entries[0].name);
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_compact(&s_cat));
+    TEST_ASSERT_TRUE(s_cat.string_bytes < before);
+    TEST_ASSERT_NOT_NULL(strstr(kept, "track_"));
+
+    for (uint32_t i = 0; i < TRACKS; i++) {
+        char key[32];
+        char display[32];
+        snprintf(key, sizeof(key), "track_%04u", (unsigned)i);
+        snprintf(display, sizeof(display), "Track %u", (unsigned)i);
+        uint32_t index = track_catalog_find(&s_cat, key);
+        if (i % 3 == 0) {
+            TEST_ASSERT_EQUAL_UINT32(TRACK_CATALOG_NONE, index);
+            continue;
+        }
+        TEST_ASSERT_TRUE(index != TRACK_CATALOG_NONE);
+        TEST_ASSERT_EQUAL_UINT32(1000 + i, s_cat.entries[index].duration_ms);
+        TEST_ASSERT_EQUAL_STRING(display, track_catalog_str(&s_cat, s_cat.entries[index].display_name));
+        TEST_ASSERT_EQUAL_STRING("/sdcard/sounds", track_catalog_str(&s_cat, s_cat.entries[index].dir));
+    }
+}
+
+/**
+ * @brief The file round-trips with its hash index; damage and other versions are refused
+ */
+void test_file(void)
+{
+    add_numbered(TRACKS);
+    size_t size = 128 * 1024;
+    uint8_t *image = malloc(size);
+    TEST_ASSERT_NOT_NULL(image);
+    FILE *fp = fmemopen(image, size, "wb");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_write(&s_cat, fp));
+    long len = ftell(fp);
+    fclose(fp);
+
+    track_catalog_t back;
+    track_catalog_init(&back);
+    fp = fmemopen(image, (size_t)len, "rb");
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_read(&back, fp));
+    fclose(fp);
+    TEST_ASSERT_EQUAL_UINT32(TRACKS, back.count);
+    TEST_ASSERT_FALSE(back.dirty);
+    TEST_ASSERT_EQUAL_UINT32(777, track_catalog_find(&back, "Track_0777"));
+    TEST_ASSERT_EQUAL_UINT32(1777, back.entries[777].duration_ms);
+    uint32_t index;
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&back, "/sdcard/sounds", "uploaded.mp3", "Uploaded", &index));
+    TEST_ASSERT_EQUAL_UINT32(TRACKS, index);
+    TEST_ASSERT_EQUAL_UINT32(s_cat.entries[0].dir, back.entries[index].dir);  // Interned against the loaded table
+    track_catalog_free(&back);
+
+    image[len - 10] ^= 0x01;
+    fp = fmemopen(image, (size_t)len, "rb");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, track_catalog_read(&back, fp));
+    fclose(fp);
+    TEST_ASSERT_NULL(back.entries);
+
+    image[4] ^= 0x02;  // Version field
+    fp = fmemopen(image, (size_t)len, "rb");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, track_catalog_read(&back, fp));
+    fclose(fp);
+
+    fp = fmemopen(image, 7, "rb");
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, track_catalog_read(&back, fp));
+    fclose(fp);
+
+    // An empty catalog is a valid file too
+    track_catalog_free(&s_cat);
+    fp = fmemopen(image, size, "wb");
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_write(&s_cat, fp));
+    len = ftell(fp);
+    fclose(fp);
+    fp = fmemopen(image, (size_t)len, "rb");
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_read(&back, fp));
+    fclose(fp);
+    TEST_ASSERT_EQUAL_UINT32(0, back.count);
+    TEST_ASSERT_EQUAL_UINT32(TRACK_CATALOG_NONE, track_catalog_find(&back, "track_0001"));
+    track_catalog_free(&back);
+    free(image);
+}
+
+void app_main(void)
+{
+    // Wait a bit for serial output to initialize
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    ESP_LOGI(TAG, "\n\n=== track_catalog Unit Tests ===\n");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_add_find);
+    RUN_TEST(test_update);
+    RUN_TEST(test_many);
+    RUN_TEST(test_remove_compact);
+    RUN_TEST(test_file);
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "\n=== All track_catalog Tests Complete ===\n");
+
+    // Keep running so we can see results
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
@@ -0,0 +1,614 @@
+/**
+ * @file track_catalog.c
+ * @brief Track library kept on the SD card: entries, a name hash index and interned strings
+ *
+ * The file holds the in-memory arrays as they are, so a load is four reads into PSRAM
+ * and a checksum, and lookups use the stored hash index without rebuilding anything.
+ * Removal leaves its strings behind until compaction; string blocks that are replaced
+ * are kept until the catalog is freed, so a string pointer handed out never dangles.
+ */
+
+#include "track_catalog.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "track_catalog";
+
+#define CATALOG_MAGIC       0x54414354u  // "TCAT" little-endian
+#define CATALOG_VERSION     1
+#define CATALOG_PATH_MAX    280
+#define MIN_SLOTS           64
+#define MIN_STRING_BYTES    4096
+#define MAX_STRING_BYTES    (8 * 1024 * 1024)
+#define MAX_NAME_LEN        255
+
+_Static_assert(sizeof(track_catalog_entry_t) == 40, "track_catalog_entry_t is the on-disk layout");
+
+// File: this header, count entries, slot_count slots, string_bytes of strings, then an
+// FNV-1a hash of all of them
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t entry_size;
+    uint16_t reserved;
+    uint32_t count;
+    uint32_t slot_count;
+    uint32_t string_bytes;
+} file_header_t;
+
+static void *catalog_alloc(size_t bytes)
+{
+    void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : malloc(bytes);
+}
+
+static void *catalog_realloc(void *p, size_t bytes)
+{
+    void *q = heap_caps_realloc(p, bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return q ? q : heap_caps_realloc(p, bytes, MALLOC_CAP_8BIT);
+}
+
+static uint32_t *alloc_slots(uint32_t n)
+{
+    uint32_t *slots = catalog_alloc(n * sizeof(uint32_t));
+    if (slots) {
+        memset(slots, 0, n * sizeof(uint32_t));
+    }
+    return slots;
+}
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Lookup key: FAT names carry no reliable case
+static uint32_t hash_name(const char *s)
+{
+    uint32_t hash = 2166136261u;
+    for (; *s; s++) {
+        hash = (hash ^ (uint8_t)tolower((unsigned char)*s)) * 16777619u;
+    }
+    return hash;
+}
+
+static inline const char *entry_name(const track_catalog_t *cat, uint32_t index)
+{
+    return cat->strings + cat->entries[index].name;
+}
+
+static void slot_insert(uint32_t *slots, uint32_t slot_count, uint32_t hash, uint32_t value)
+{
+    uint32_t mask = slot_count - 1;
+    uint32_t i = hash & mask;
+    while (slots[i]) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = value;
+}
+
+// Slot holding an entry
+static uint32_t slot_of(const track_catalog_t *cat, uint32_t index)
+{
+    uint32_t mask = cat->slot_count - 1;
+    uint32_t i = hash_name(entry_name(cat, index)) & mask;
+    while (cat->slots[i] != index + 1) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Empty a slot, shifting later members of the probe run back so none becomes unreachable
+static void slot_delete(track_catalog_t *cat, uint32_t i)
+{
+    uint32_t mask = cat->slot_count - 1;
+    for (uint32_t j = (i + 1) & mask; cat->slots[j]; j = (j + 1) & mask) {
+        uint32_t home = hash_name(entry_name(cat, cat->slots[j] - 1)) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            cat->slots[i] = cat->slots[j];
+            i = j;
+        }
+    }
+    cat->slots[i] = 0;
+}
+
+static esp_err_t rehash_slots(track_catalog_t *cat, uint32_t slot_count)
+{
+    uint32_t *slots = alloc_slots(slot_count);
+    if (!slots) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < cat->count; i++) {
+        slot_insert(slots, slot_count, hash_name(entry_name(cat, i)), i + 1);
+    }
+    free(cat->slots);
+    cat->slots = slots;
+    cat->slot_count = slot_count;
+    return ESP_OK;
+}
+
+static esp_err_t retire_reserve(track_catalog_t *cat)
+{
+    void **retired = catalog_realloc(cat->retired, (cat->retired_count + 1) * sizeof(void *));
+    if (!retired) {
+        return ESP_ERR_NO_MEM;
+    }
+    cat->retired = retired;
+    return ESP_OK;
+}
+
+static esp_err_t reserve_strings(track_catalog_t *cat, uint32_t extra)
+{
+    if (cat->string_bytes + extra <= cat->string_capacity) {
+        return ESP_OK;
+    }
+    uint32_t capacity = cat->string_capacity ? cat->string_capacity * 2 : MIN_STRING_BYTES;
+    while (capacity < cat->string_bytes + extra) {
+        capacity *= 2;
+    }
+    if (capacity > MAX_STRING_BYTES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    char *strings = catalog_alloc(capacity);
+    if (!strings || (cat->strings && retire_reserve(cat) != ESP_OK)) {
+        free(strings);
+        return ESP_ERR_NO_MEM;
+    }
+    if (cat->strings) {
+        memcpy(strings, cat->strings, cat->string_bytes);
+        cat->retired[cat->retired_count++] = cat->strings;
+    }
+    cat->strings = strings;
+    cat->string_capacity = capacity;
+    return ESP_OK;
+}
+
+// Slot of a string in the intern table, or of the empty slot where it would go
+static uint32_t intern_probe(const track_catalog_t *cat, const char *s, uint32_t hash)
+{
+    uint32_t mask = cat->interned_slots - 1;
+    uint32_t i = hash & mask;
+    while (cat->interned[i] && strcmp(cat->strings + cat->interned[i] - 1, s) != 0) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static esp_err_t intern_rehash(track_catalog_t *cat, uint32_t min_strings)
+{
+    uint32_t n = 256;
+    while (n < min_strings * 2) {
+        n *= 2;
+    }
+    uint32_t *table = alloc_slots(n);
+    if (!table) {
+        return ESP_ERR_NO_MEM;
+    }
+    free(cat->interned);
+    cat->interned = table;
+    cat->interned_slots = n;
+    cat->interned_count = 0;
+    for (uint32_t off = 0; off < cat->string_bytes; off += strlen(cat->strings + off) + 1) {
+        const char *s = cat->strings + off;
+        uint32_t i = intern_probe(cat, s, fnv1a(2166136261u, s, strlen(s)));
+        if (!cat->interned[i]) {
+            cat->interned[i] = off + 1;
+            cat->interned_count++;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t intern(track_catalog_t *cat, const char *s, uint32_t *offset)
+{
+    if (!cat->interned || (cat->interned_count + 1) * 2 > cat->interned_slots) {
+        esp_err_t err = intern_rehash(cat, cat->interned ? cat->interned_slots : cat->count * 3 + 1);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    size_t len = strlen(s);
+    uint32_t hash = fnv1a(2166136261u, s, len);
+    uint32_t i = intern_probe(cat, s, hash);
+    if (cat->interned[i]) {
+        *offset = cat->interned[i] - 1;
+        return ESP_OK;
+    }
+    // s may be in the current block: an outgrown block is retired, not freed
+    esp_err_t err = reserve_strings(cat, (uint32_t)len + 1);
+    if (err != ESP_OK) {
+        return err;
+    }
+    *offset = cat->string_bytes;
+    memcpy(cat->strings + cat->string_bytes, s, len + 1);
+    cat->string_bytes += (uint32_t)len + 1;
+    cat->interned[i] = *offset + 1;
+    cat->interned_count++;
+    return ESP_OK;
+}
+
+void track_catalog_init(track_catalog_t *cat)
+{
+    memset(cat, 0, sizeof(*cat));
+}
+
+void track_catalog_free(track_catalog_t *cat)
+{
+    if (!cat) {
+        return;
+    }
+    free(cat->entries);
+    free(cat->slots);
+    free(cat->strings);
+    free(cat->interned);
+    for (uint32_t i = 0; i < cat->retired_count; i++) {
+        free(cat->retired[i]);
+    }
+    free(cat->retired);
+    track_catalog_init(cat);
+}
+
+uint32_t track_catalog_find(const track_catalog_t *cat, const char *name)
+{
+    if (!cat || !name || cat->count == 0) {
+        return TRACK_CATALOG_NONE;
+    }
+    uint32_t mask = cat->slot_count - 1;
+    for (uint32_t i = hash_name(name) & mask; cat->slots[i]; i = (i + 1) & mask) {
+        if (strcasecmp(entry_name(cat, cat->slots[i] - 1), name) == 0) {
+            return cat->slots[i] - 1;
+        }
+    }
+    return TRACK_CATALOG_NONE;
+}
+
+esp_err_t track_catalog_add(track_catalog_t *cat, const char *dir, const char *file, const char *display_name,
+                            uint32_t *index)
+{
+    if (!cat || !dir || !file || !display_name) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *dot = strrchr(file, '.');
+    size_t stem = dot ? (size_t)(dot - file) : strlen(file);
+    if (stem == 0 || stem > MAX_NAME_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    char name[MAX_NAME_LEN + 1];
+    memcpy(name, file, stem);
+    name[stem] = '\0';
+
+    uint32_t i = track_catalog_find(cat, name);
+    if (i == TRACK_CATALOG_NONE) {
+        if (cat->count == TRACK_CATALOG_MAX_TRACKS) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (cat->count == cat->capacity) {
+            uint32_t capacity = cat->capacity ? cat->capacity * 2 : 64;
+            track_catalog_entry_t *entries = catalog_realloc(cat->entries, capacity * sizeof(*entries));
+            if (!entries) {
+                return ESP_ERR_NO_MEM;
+            }
+            cat->entries = entries;
+            cat->capacity = capacity;
+        }
+        if ((cat->count + 1) * 2 > cat->slot_count) {
+            esp_err_t err = rehash_slots(cat, cat->slot_count ? cat->slot_count * 2 : MIN_SLOTS);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+
+    track_catalog_entry_t e = {0};
+    esp_err_t err = intern(cat, name, &e.name);
+    if (err == ESP_OK) {
+        err = intern(cat, display_name, &e.display_name);
+    }
+    if (err == ESP_OK) {
+        err = intern(cat, dir, &e.dir);
+    }
+    if (err == ESP_OK) {
+        err = intern(cat, file, &e.file);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (i != TRACK_CATALOG_NONE) {
+        track_catalog_entry_t *old = &cat->entries[i];
+        if (old->dir == e.dir && old->file == e.file) {
+            // Same file: keep what is known about it
+            cat->dirty |= old->name != e.name || old->display_name != e.display_name;
+            old->name = e.name;
+            old->display_name = e.display_name;
+            if (index) {
+                *index = i;
+            }
+            return ESP_OK;
+        }
+    }
+    e.replay_gain = TRACK_CATALOG_GAIN_UNKNOWN;
+    e.flags = (dot && strcasecmp(dot, ".wav") == 0) ? TRACK_CATALOG_WAV : 0;
+    if (i == TRACK_CATALOG_NONE) {
+        i = cat->count++;
+        slot_insert(cat->slots, cat->slot_count, hash_name(name), i + 1);
+    }
+    cat->entries[i] = e;
+    cat->dirty = true;
+    if (index) {
+        *index = i;
+    }
+    return ESP_OK;
+}
+
+void track_catalog_remove(track_catalog_t *cat, uint32_t index)
+{
+    if (!cat || index >= cat->count) {
+        return;
+    }
+    slot_delete(cat, slot_of(cat, index));
+    uint32_t last = cat->count - 1;
+    if (index != last) {
+        uint32_t slot = slot_of(cat, last);
+        cat->entries[index] = cat->entries[last];
+        cat->slots[slot] = index + 1;
+    }
+    cat->count--;
+    cat->dirty = true;
+}
+
+esp_err_t track_catalog_compact(track_catalog_t *cat)
+{
+    if (!cat || cat->string_bytes == 0) {
+        return ESP_OK;
+    }
+    // Allocate everything first, so a failure leaves the catalog as it was
+    uint32_t capacity = cat->string_bytes;
+    char *strings = catalog_alloc(capacity);
+    uint32_t interned_slots = 256;
+    while (interned_slots < (cat->count * 4 + 1) * 2) {
+        interned_slots *= 2;
+    }
+    uint32_t *interned = alloc_slots(interned_slots);
+    if (!strings || !interned || retire_reserve(cat) != ESP_OK) {
+        free(strings);
+        free(interned);
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t before = cat->string_bytes;
+    const char *old = cat->strings;
+    cat->retired[cat->retired_count++] = cat->strings;
+    free(cat->interned);
+    cat->interned = interned;
+    cat->interned_slots = interned_slots;
+    cat->interned_count = 0;
+    cat->strings = strings;
+    cat->string_bytes = 0;
+    cat->string_capacity = capacity;
+    // Neither the table nor the block can need to grow: both fit every live string
+    for (uint32_t i = 0; i < cat->count; i++) {
+        track_catalog_entry_t *e = &cat->entries[i];
+        intern(cat, old + e->name, &e->name);
+        intern(cat, old + e->display_name, &e->display_name);
+        intern(cat, old + e->dir, &e->dir);
+        intern(cat, old + e->file, &e->file);
+    }
+    if (cat->string_bytes != before) {
+        cat->dirty = true;
+        ESP_LOGI(TAG, "Compacted strings from %" PRIu32 " to %" PRIu32 " bytes", before, cat->string_bytes);
+    }
+    return ESP_OK;
+}
+
+const char *track_catalog_str(const track_catalog_t *cat, uint32_t offset)
+{
+    return (cat && offset < cat->string_bytes) ? cat->strings + offset : "";
+}
+
+esp_err_t track_catalog_path(const track_catalog_t *cat, uint32_t index, char *out, size_t out_len)
+{
+    if (!cat || index >= cat->count || !out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const track_catalog_entry_t *e = &cat->entries[index];
+    int len = snprintf(out, out_len, "%s/%s", cat->strings + e->dir, cat->strings + e->file);
+    return (len < 0 || (size_t)len >= out_len) ? ESP_ERR_INVALID_SIZE : ESP_OK;
+}
+
+esp_err_t track_catalog_write(const track_catalog_t *cat, FILE *fp)
+{
+    file_header_t h = {
+        .magic = CATALOG_MAGIC,
+        .version = CATALOG_VERSION,
+        .header_size = sizeof(file_header_t),
+        .entry_size = sizeof(track_catalog_entry_t),
+        .count = cat->count,
+        .slot_count = cat->count ? cat->slot_count : 0,
+        .string_bytes = cat->count ? cat->string_bytes : 0,
+    };
+    size_t entry_bytes = h.count * sizeof(track_catalog_entry_t);
+    size_t slot_bytes = h.slot_count * sizeof(uint32_t);
+    uint32_t hash = fnv1a(2166136261u, &h, sizeof(h));
+    hash = fnv1a(hash, cat->entries, entry_bytes);
+    hash = fnv1a(hash, cat->slots, slot_bytes);
+    hash = fnv1a(hash, cat->strings, h.string_bytes);
+    if (fwrite(&h, sizeof(h), 1, fp) != 1 || (entry_bytes && fwrite(cat->entries, entry_bytes, 1, fp) != 1) ||
+        (slot_bytes && fwrite(cat->slots, slot_bytes, 1, fp) != 1) ||
+        (h.string_bytes && fwrite(cat->strings, h.string_bytes, 1, fp) != 1) ||
+        fwrite(&hash, sizeof(hash), 1, fp) != 1) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static bool entries_valid(const track_catalog_t *cat)
+{
+    if (cat->count == 0) {
+        return true;
+    }
+    if (cat->string_bytes == 0 || cat->strings[cat->string_bytes - 1] != '\0') {
+        return false;
+    }
+    for (uint32_t i = 0; i < cat->count; i++) {
+        const track_catalog_entry_t *e = &cat->entries[i];
+        if (e->name >= cat->string_bytes || e->display_name >= cat->string_bytes ||
+            e->dir >= cat->string_bytes || e->file >= cat->string_bytes) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < cat->slot_count; i++) {
+        if (cat->slots[i] > cat->count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t track_catalog_read(track_catalog_t *cat, FILE *fp)
+{
+    if (!cat || !fp) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    track_catalog_free(cat);
+    file_header_t h;
+    if (fread(&h, sizeof(h), 1, fp) != 1 || h.magic != CATALOG_MAGIC) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (h.version != CATALOG_VERSION || h.header_size != sizeof(h) ||
+        h.entry_size != sizeof(track_catalog_entry_t)) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (h.count > TRACK_CATALOG_MAX_TRACKS || h.string_bytes > MAX_STRING_BYTES ||
+        (h.slot_count & (h.slot_count - 1)) != 0 || h.slot_count > 4 * TRACK_CATALOG_MAX_TRACKS ||
+        (h.count > 0 && h.slot_count < h.count * 2)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (h.count == 0) {
+        uint32_t hash;
+        if (fread(&hash, sizeof(hash), 1, fp) != 1 || hash != fnv1a(2166136261u, &h, sizeof(h))) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        return ESP_OK;
+    }
+
+    // Headroom for a few uploads before anything has to move
+    cat->capacity = h.count + 16;
+    cat->string_capacity = h.string_bytes + h.string_bytes / 8 + 1024;
+    cat->entries = catalog_alloc(cat->capacity * sizeof(track_catalog_entry_t));
+    cat->slots = catalog_alloc(h.slot_count * sizeof(uint32_t));
+    cat->strings = catalog_alloc(cat->string_capacity);
+    if (!cat->entries || !cat->slots || !cat->strings) {
+        track_catalog_free(cat);
+        return ESP_ERR_NO_MEM;
+    }
+    cat->count = h.count;
+    cat->slot_count = h.slot_count;
+    cat->string_bytes = h.string_bytes;
+
+    size_t entry_bytes = h.count * sizeof(track_catalog_entry_t);
+    size_t slot_bytes = h.slot_count * sizeof(uint32_t);
+    uint32_t hash;
+    bool ok = fread(cat->entries, entry_bytes, 1, fp) == 1 && fread(cat->slots, slot_bytes, 1, fp) == 1 &&
+              (h.string_bytes == 0 || fread(cat->strings, h.string_bytes, 1, fp) == 1) &&
+              fread(&hash, sizeof(hash), 1, fp) == 1;
+    if (ok) {
+        uint32_t expect = fnv1a(2166136261u, &h, sizeof(h));
+        expect = fnv1a(expect, cat->entries, entry_bytes);
+        expect = fnv1a(expect, cat->slots, slot_bytes);
+        expect = fnv1a(expect, cat->strings, h.string_bytes);
+        ok = hash == expect && entries_valid(cat);
+    }
+    if (!ok) {
+        track_catalog_free(cat);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+// Temporary file beside the catalog: its extension replaced, as 8.3 names allow one
+static esp_err_t temp_path(const char *path, char *out, size_t out_len)
+{
+    const char *slash = strrchr(path, '/');
+    const char *dot = strrchr(path, '.');
+    size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - path) : strlen(path);
+    if (stem + sizeof(".tmp") > out_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out, path, stem);
+    memcpy(out + stem, ".tmp", sizeof(".tmp"));
+    return ESP_OK;
+}
+
+static esp_err_t read_file(track_catalog_t *cat, const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t err = track_catalog_read(cat, fp);
+    fclose(fp);
+    return err;
+}
+
+esp_err_t track_catalog_load(track_catalog_t *cat, const char *path)
+{
+    if (!cat || !path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = read_file(cat, path);
+    char tmp[CATALOG_PATH_MAX];
+    if (err == ESP_ERR_NOT_FOUND && temp_path(path, tmp, sizeof(tmp)) == ESP_OK) {
+        // Power lost between removing the old file and renaming the new one
+        err = read_file(cat, tmp);
+        if (err == ESP_OK) {
+            rename(tmp, path);
+        }
+    }
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded %s: %" PRIu32 " tracks, %" PRIu32 " string bytes", path, cat->count,
+                 cat->string_bytes);
+    } else if (err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Ignoring %s: %s", path, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t track_catalog_save(track_catalog_t *cat, const char *path)
+{
+    if (!cat || !path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    char tmp[CATALOG_PATH_MAX];
+    if (temp_path(path, tmp, sizeof(tmp)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    FILE *fp = fopen(tmp, "wb");
+    bool written = fp && track_catalog_write(cat, fp) == ESP_OK;
+    if (fp && fclose(fp) != 0) {
+        written = false;
+    }
+    if (!written) {
+        ESP_LOGW(TAG, "Could not write %s", tmp);
+        remove(tmp);
+        return ESP_FAIL;
+    }
+    // FATFS will not rename over an existing file. Once the old one is gone the
+    // temporary file is the catalog: track_catalog_load() falls back to it.
+    if ((remove(path) != 0 && errno != ENOENT) || rename(tmp, path) != 0) {
+        ESP_LOGW(TAG, "Could not replace %s", path);
+        return ESP_FAIL;
+    }
+    cat->dirty = false;
+    return ESP_OK;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "track_catalog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACK_SEARCH_MAX_SCORE  1000
+#define TRACK_SEARCH_MAX_TRACKS 65535  // Postings hold 16-bit entry indices
+
+/**
+ * One result: a catalog entry index and how well it matches, 0..TRACK_SEARCH_MAX_SCORE
+ */
+typedef struct {
+    uint32_t index;
+    uint16_t score;
+} track_search_hit_t;
+
+/**
+ * Trigram inverted index over the names and display names of a catalog.
+ *
+ * Names are folded to lowercase words, "~N" suffixes of 8.3 names are dropped, and each
+ * word contributes its trigrams padded with a space on either side, so "rain" gives
+ * " ra", "rai", "ain" and "in ". Each trigram has a sorted posting list of the entries
+ * that contain it, stored back to back. A query is scored as a weighted Dice coefficient
+ * of the trigram sets, with rarer trigrams weighing more.
+ *
+ * Entry indices are those of the catalog when the index was built: build it again after
+ * entries are added or removed.
+ */
+typedef struct {
+    uint32_t track_count;
+    uint32_t key_count;
+    uint16_t *keys;        // Distinct trigram codes, ascending
+    uint32_t *starts;      // key_count + 1 offsets into postings
+    uint16_t *postings;    // Entry indices of each trigram in turn
+    float *key_weights;    // Inverse document frequency of each trigram
+    float *track_weights;  // Summed weights of each entry's trigrams
+    float *scratch;        // Per-entry accumulator of a query
+    uint16_t *touched;     // Entries the current query has reached
+} track_search_t;
+
+/**
+ * @brief Start an empty index; queries on it return nothing
+ */
+void track_search_init(track_search_t *ts);
+
+/**
+ * @brief Release an index
+ */
+void track_search_free(track_search_t *ts);
+
+/**
+ * @brief Index the names and display names of a catalog, replacing what ts held
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE above TRACK_SEARCH_MAX_TRACKS entries, ESP_ERR_NO_MEM
+ *         (ts is then left empty)
+ */
+esp_err_t track_search_build(track_search_t *ts, const track_catalog_t *cat);
+
+/**
+ * @brief Rank the entries against a spoken or typed query such as "the rain one"
+ *
+ * Filler words ("play", "the", "song", ...) are ignored unless nothing else is left.
+ * Not reentrant on one index: callers share it under their own lock.
+ *
+ * @param query: Free text
+ * @param hits: Filled best first; ties keep catalog order
+ * @param max_hits: Size of hits
+ * @return Number of hits written, 0 if nothing shares a trigram with the query
+ */
+size_t track_search_query(track_search_t *ts, const char *query, track_search_hit_t *hits, size_t max_hits);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file test_track_search.c
+ * @brief Ranking, 8.3 name and large library tests for track_search
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "track_search.h"
+
+static const char *TAG = "test_track_search";
+
+#define MANY_TRACKS 2000
+#define HITS        5
+
+static track_catalog_t s_cat;
+static track_search_t s_search;
+
+static const char *s_names[] = {
+    "chants_crownchakra", "chants_thirdeyechakra", "deep-in-the-ocean-116172", "forest_waterfall_sleep",
+    "light-rain-ambient-114354", "noise_white", "ocean_embrace_presleep", "ocean_embrace_sleep",
+    "paris_rain_presleep", "paris_rain_sleep", "paris_rain_wakeup", "pink_noise_presleep",
+    "presleep_rain_against_window", "sleep_crickets_waves", "stories_ocean",
+};
+
+static void add_track(const char *name, const char *display)
+{
+    char file[64];
+    snprintf(file, sizeof(file), "%s.mp3", name);
+    TEST_ASSERT_EQUAL(ESP_OK, track_catalog_add(&s_cat, "/sdcard/sounds", file, display ? display : name, NULL));
+}
+
+static const char *hit_name(const track_search_hit_t *hit)
+{
+    return track_catalog_str(&s_cat, s_cat.entries[hit->index].name);
+}
+
+void setUp(void)
+{
+    track_catalog_init(&s_cat);
+    track_search_init(&s_search);
+}
+
+void tearDown(void)
+{
+    track_search_free(&s_search);
+    track_catalog_free(&s_cat);
+}
+
+/**
+ * @brief Spoken fragments rank the track they describe first; scores descend
+ */
+void test_ranking(void)
+{
+    for (size_t i = 0; i < sizeof(s_names) / sizeof(s_names[0]); i++) {
+        add_track(s_names[i], NULL);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, track_search_build(&s_search, &s_cat));
+
+    track_search_hit_t hits[HITS];
+    TEST_ASSERT_EQUAL(HITS, track_search_query(&s_search, "ocean sleep", hits, HITS));
+    TEST_ASSERT_EQUAL_STRING("ocean_embrace_sleep", hit_name(&hits[0]));
+    for (size_t i = 1; i < HITS; i++) {
+        TEST_ASSERT_TRUE(hits[i - 1].score >= hits[i].score);
+    }
+
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "Paris Rain Wakeup", hits, HITS) > 0);
+    TEST_ASSERT_EQUAL_STRING("paris_rain_wakeup", hit_name(&hits[0]));
+    TEST_ASSERT_EQUAL_UINT16(TRACK_SEARCH_MAX_SCORE, hits[0].score);
+
+    // Filler words do not pull in "deep in the ocean" or "noise_white"
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "play the rain one", hits, HITS) > 0);
+    TEST_ASSERT_NOT_NULL(strstr(hit_name(&hits[0]), "rain"));
+
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "chants third eye", hits, 1) == 1);
+    TEST_ASSERT_EQUAL_STRING("chants_thirdeyechakra", hit_name(&hits[0]));
+
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "white noise", hits, 1) == 1);
+    TEST_ASSERT_EQUAL_STRING("noise_white", hit_name(&hits[0]));
+
+    TEST_ASSERT_EQUAL(0, track_search_query(&s_search, "zzqx", hits, HITS));
+    TEST_ASSERT_EQUAL(0, track_search_query(&s_search, "", hits, HITS));
+    TEST_ASSERT_EQUAL(0, track_search_query(&s_search, "?!", hits, HITS));
+}
+
+/**
+ * @brief 8.3 aliases match the words they were cut from; ties keep catalog order
+ */
+void test_short_names(void)
+{
+    add_track("PARIS_~1", NULL);
+    add_track("OCEAN_~1", NULL);
+    add_track("OCEAN_~2", NULL);
+    add_track("CHANTS~1", NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, track_search_build(&s_search, &s_cat));
+
+    track_search_hit_t hits[HITS];
+    TEST_ASSERT_EQUAL(2, track_search_query(&s_search, "ocean", hits, HITS));
+    TEST_ASSERT_EQUAL_STRING("OCEAN_~1", hit_name(&hits[0]));
+    TEST_ASSERT_EQUAL_STRING("OCEAN_~2", hit_name(&hits[1]));
+    TEST_ASSERT_EQUAL_UINT16(TRACK_SEARCH_MAX_SCORE, hits[0].score);
+
+    // The long name an assistant remembers still finds the alias
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "chants_thirdeyechakra", hits, HITS) > 0);
+    TEST_ASSERT_EQUAL_STRING("CHANTS~1", hit_name(&hits[0]));
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "paris rain sleep", hits, HITS) > 0);
+    TEST_ASSERT_EQUAL_STRING("PARIS_~1", hit_name(&hits[0]));
+}
+
+/**
+ * @brief Display names are searched too, and a query of filler words alone still runs
+ */
+void test_display_names(void)
+{
+    add_track("TRACK01", "Ocean Lullaby");
+    add_track("TRACK02", "Music Box");
+    TEST_ASSERT_EQUAL(ESP_OK, track_search_build(&s_search, &s_cat));
+
+    track_search_hit_t hits[HITS];
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "lullaby", hits, HITS) > 0);
+    TEST_ASSERT_EQUAL_STRING("TRACK01", hit_name(&hits[0]));
+    TEST_ASSERT_TRUE(track_search_query(&s_search, "music", hits, HITS) > 0);
+    TEST_ASSERT_EQUAL_STRING("TRACK02", hit_name(&hits[0]));
+
+    // An empty catalog gives an empty index
+    track_catalog_free(&s_cat);
+    TEST_ASSERT_EQUAL(ESP_OK, track_search_build(&s_search, &s_cat));
+    TEST_ASSERT_EQUAL(0, track_search_query(&s_search, "ocean", hits, HITS));
+}
+
+/**
+ * @brief Thousands of tracks: the numbered one wins and a query stays well under a millisecond
+ */
+void test_many(void)
+{
+    for (uint32_t i = 0; i < MANY_TRACKS; i++) {
+        char name[48];
+        snprintf(name, sizeof(name), "%s_%04u", s_names[i % (sizeof(s_names) / sizeof(s_names[0]))], (unsigned)i);
+        add_track(name, NULL);
+    }
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(ESP_OK, track_search_build(&s_search, &s_cat));
+    ESP_LOGI(TAG, "Built %u tracks in %lld us", MANY_TRACKS, (long long)(esp_timer_get_time() - start));
+
+    track_search_hit_t hits[HITS];
+    start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(HITS, track_search_query(&s_search, "paris rain sleep 1314", hits, HITS));
+    int64_t took = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Query took %lld us", (long long)took);
+    TEST_ASSERT_EQUAL_STRING("paris_rain_sleep_1314", hit_name(&hits[0]));
+    TEST_ASSERT_TRUE(took < 1000);
+}
+
+void app_main(void)
+{
+    // Wait a bit for serial output to initialize
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    ESP_LOGI(TAG, "\n\n=== track_search Unit Tests ===\n");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_ranking);
+    RUN_TEST(test_short_names);
+    RUN_TEST(test_display_names);
+    RUN_TEST(test_many);
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "\n=== All track_search Tests Complete ===\n");
+
+    // Keep running so we can see results
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
@@ -0,0 +1,337 @@
+/**
+ * @file track_search.c
+ * @brief Trigram index for fuzzy lookup of tracks by spoken or typed names
+ *
+ * Built with a counting sort over the 37^3 possible trigrams, so a build is two passes
+ * over the names with no per-posting allocation. A query reads the posting lists of its
+ * own trigrams only and scores the entries they reach, so its cost follows how common
+ * the query's trigrams are rather than the size of the library.
+ */
+
+#include "track_search.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "track_search";
+
+#define ALPHABET    37  // Space, a-z, 0-9
+#define KEY_SPACE   (ALPHABET * ALPHABET * ALPHABET)
+#define MAX_GRAMS   512  // A name and a display name of up to 255 characters each
+#define MAX_WORD    32
+#define SCRATCH_INTERNAL_MAX (16 * 1024)
+
+// Words that say how to play rather than what: "play the rain one"
+static const char *const s_filler[] = {
+    "a", "an", "and", "me", "my", "of", "on", "one", "play", "please", "put", "some", "song",
+    "sound", "sounds", "start", "the", "to", "track", "music", "with",
+};
+
+static void *search_alloc(size_t bytes)
+{
+    void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : malloc(bytes);
+}
+
+static void *search_calloc(size_t n, size_t size)
+{
+    void *p = heap_caps_calloc(n, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : calloc(n, size);
+}
+
+// Query scratch is written at random per posting: internal RAM for libraries of usual size
+static void *scratch_calloc(size_t n, size_t size)
+{
+    void *p = NULL;
+    if (n * size <= SCRATCH_INTERNAL_MAX) {
+        p = heap_caps_calloc(n, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return p ? p : search_calloc(n, size);
+}
+
+// Letter or digit as a trigram symbol, 0 for anything that separates words
+static inline uint32_t symbol(char c)
+{
+    if (c >= 'a' && c <= 'z') {
+        return (uint32_t)(c - 'a') + 1;
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return (uint32_t)(c - 'A') + 1;
+    }
+    if (c >= '0' && c <= '9') {
+        return (uint32_t)(c - '0') + 27;
+    }
+    return 0;
+}
+
+static bool is_filler(const char *word, size_t len)
+{
+    for (size_t i = 0; i < sizeof(s_filler) / sizeof(s_filler[0]); i++) {
+        if (strlen(s_filler[i]) == len && strncasecmp(s_filler[i], word, len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Append the padded trigrams of each word of text to grams
+ * @param skip_filler: Leave out the words of s_filler
+ * @return New number of grams, at most max
+ */
+static size_t add_grams(const char *text, bool skip_filler, uint16_t *grams, size_t n, size_t max)
+{
+    const char *p = text;
+    while (*p && n < max) {
+        if (*p == '~') {
+            // 8.3 alias suffix: "OCEAN~1" is the word "ocean"
+            p++;
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+            continue;
+        }
+        if (symbol(*p) == 0) {
+            p++;
+            continue;
+        }
+        const char *word = p;
+        while (symbol(*p) != 0) {
+            p++;
+        }
+        size_t len = (size_t)(p - word);
+        if (skip_filler && len < MAX_WORD && is_filler(word, len)) {
+            continue;
+        }
+        uint32_t a = 0;
+        uint32_t b = symbol(word[0]);
+        for (size_t i = 1; i <= len && n < max; i++) {
+            uint32_t c = i < len ? symbol(word[i]) : 0;
+            grams[n++] = (uint16_t)((a * ALPHABET + b) * ALPHABET + c);
+            a = b;
+            b = c;
+        }
+    }
+    return n;
+}
+
+static int compare_gram(const void *a, const void *b)
+{
+    return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+// Sort and drop repeats: each entry counts a trigram once
+static size_t unique_grams(uint16_t *grams, size_t n)
+{
+    if (n < 2) {
+        return n;
+    }
+    qsort(grams, n, sizeof(uint16_t), compare_gram);
+    size_t out = 1;
+    for (size_t i = 1; i < n; i++) {
+        if (grams[i] != grams[out - 1]) {
+            grams[out++] = grams[i];
+        }
+    }
+    return out;
+}
+
+static size_t track_grams(const track_catalog_t *cat, uint32_t index, uint16_t *grams)
+{
+    const track_catalog_entry_t *e = &cat->entries[index];
+    size_t n = add_grams(track_catalog_str(cat, e->name), false, grams, 0, MAX_GRAMS);
+    if (e->display_name != e->name) {
+        n = add_grams(track_catalog_str(cat, e->display_name), false, grams, n, MAX_GRAMS);
+    }
+    return unique_grams(grams, n);
+}
+
+// Position of key in ts->keys, or -1
+static int32_t find_key(const track_search_t *ts, uint16_t key)
+{
+    uint32_t lo = 0;
+    uint32_t hi = ts->key_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (ts->keys[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < ts->key_count && ts->keys[lo] == key ? (int32_t)lo : -1;
+}
+
+void track_search_init(track_search_t *ts)
+{
+    memset(ts, 0, sizeof(*ts));
+}
+
+void track_search_free(track_search_t *ts)
+{
+    free(ts->keys);
+    free(ts->starts);
+    free(ts->postings);
+    free(ts->key_weights);
+    free(ts->track_weights);
+    free(ts->scratch);
+    free(ts->touched);
+    track_search_init(ts);
+}
+
+esp_err_t track_search_build(track_search_t *ts, const track_catalog_t *cat)
+{
+    track_search_free(ts);
+    if (cat->count > TRACK_SEARCH_MAX_TRACKS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (cat->count == 0) {
+        return ESP_OK;
+    }
+
+    uint16_t *grams = malloc(MAX_GRAMS * sizeof(uint16_t));
+    uint32_t *offsets = search_calloc(KEY_SPACE + 1, sizeof(uint32_t));
+    if (!grams || !offsets) {
+        free(grams);
+        free(offsets);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Pass 1: postings per trigram
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < cat->count; i++) {
+        size_t n = track_grams(cat, i, grams);
+        for (size_t g = 0; g < n; g++) {
+            offsets[grams[g] + 1]++;
+        }
+        total += n;
+    }
+    uint32_t key_count = 0;
+    for (uint32_t k = 1; k <= KEY_SPACE; k++) {
+        key_count += offsets[k] != 0;
+        offsets[k] += offsets[k - 1];
+    }
+
+    ts->track_count = cat->count;
+    ts->key_count = key_count;
+    uint32_t key_slots = key_count ? key_count : 1;  // Names with no letters or digits
+    ts->keys = search_alloc(key_slots * sizeof(uint16_t));
+    ts->starts = search_alloc((key_count + 1) * sizeof(uint32_t));
+    ts->postings = search_alloc((total ? total : 1) * sizeof(uint16_t));
+    ts->key_weights = search_alloc(key_slots * sizeof(float));
+    ts->track_weights = search_calloc(cat->count, sizeof(float));
+    ts->scratch = scratch_calloc(cat->count, sizeof(float));
+    ts->touched = scratch_calloc(cat->count, sizeof(uint16_t));
+    if (!ts->keys || !ts->starts || !ts->postings || !ts->key_weights || !ts->track_weights || !ts->scratch ||
+        !ts->touched) {
+        free(grams);
+        free(offsets);
+        track_search_free(ts);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Keep the distinct trigrams before offsets turns into write cursors
+    uint32_t next = 0;
+    for (uint32_t k = 0; k < KEY_SPACE; k++) {
+        if (offsets[k + 1] != offsets[k]) {
+            ts->keys[next] = (uint16_t)k;
+            ts->starts[next] = offsets[k];
+            float df = (float)(offsets[k + 1] - offsets[k]);
+            ts->key_weights[next] = logf(1.0f + (float)cat->count / df);
+            next++;
+        }
+    }
+    ts->starts[key_count] = total;
+
+    // Pass 2: entries in order, so each list comes out sorted
+    for (uint32_t i = 0; i < cat->count; i++) {
+        size_t n = track_grams(cat, i, grams);
+        for (size_t g = 0; g < n; g++) {
+            ts->postings[offsets[grams[g]]++] = (uint16_t)i;
+        }
+    }
+    free(offsets);
+    free(grams);
+
+    for (uint32_t k = 0; k < key_count; k++) {
+        for (uint32_t p = ts->starts[k]; p < ts->starts[k + 1]; p++) {
+            ts->track_weights[ts->postings[p]] += ts->key_weights[k];
+        }
+    }
+    ESP_LOGD(TAG, "Indexed %" PRIu32 " tracks: %" PRIu32 " trigrams, %" PRIu32 " postings", cat->count,
+             key_count, total);
+    return ESP_OK;
+}
+
+size_t track_search_query(track_search_t *ts, const char *query, track_search_hit_t *hits, size_t max_hits)
+{
+    if (!query || !hits || max_hits == 0 || ts->track_count == 0) {
+        return 0;
+    }
+    uint16_t grams[MAX_GRAMS / 2];
+    size_t n = add_grams(query, true, grams, 0, sizeof(grams) / sizeof(grams[0]));
+    if (n == 0) {
+        n = add_grams(query, false, grams, 0, sizeof(grams) / sizeof(grams[0]));
+    }
+    n = unique_grams(grams, n);
+    if (n == 0) {
+        return 0;
+    }
+
+    // A trigram no track has weighs as much as the rarest one: it still counts against every match
+    float unseen = logf(1.0f + (float)ts->track_count);
+    float query_weight = 0.0f;
+    uint32_t touched = 0;
+    for (size_t g = 0; g < n; g++) {
+        int32_t k = find_key(ts, grams[g]);
+        if (k < 0) {
+            query_weight += unseen;
+            continue;
+        }
+        float w = ts->key_weights[k];
+        query_weight += w;
+        for (uint32_t p = ts->starts[k]; p < ts->starts[k + 1]; p++) {
+            uint16_t track = ts->postings[p];
+            if (ts->scratch[track] == 0.0f) {
+                ts->touched[touched++] = track;
+            }
+            ts->scratch[track] += w;
+        }
+    }
+
+    // Keep the best max_hits by insertion; the scratch is cleared on the way
+    size_t found = 0;
+    for (uint32_t t = 0; t < touched; t++) {
+        uint16_t track = ts->touched[t];
+        float shared = ts->scratch[track];
+        ts->scratch[track] = 0.0f;
+        float total = query_weight + ts->track_weights[track];
+        if (found == max_hits && 2.0f * TRACK_SEARCH_MAX_SCORE * shared < (hits[found - 1].score - 0.5f) * total) {
+            continue;  // Below the worst kept hit, without dividing
+        }
+        float dice = 2.0f * shared / total;
+        uint16_t score = (uint16_t)fminf(dice * TRACK_SEARCH_MAX_SCORE + 0.5f, TRACK_SEARCH_MAX_SCORE);
+
+        size_t pos = found;
+        while (pos > 0 && (hits[pos - 1].score < score ||
+                           (hits[pos - 1].score == score && hits[pos - 1].index > track))) {
+            pos--;
+        }
+        if (pos >= max_hits) {
+            continue;
+        }
+        size_t last = found < max_hits ? found : max_hits - 1;
+        memmove(&hits[pos + 1], &hits[pos], (last - pos) * sizeof(hits[0]));
+        hits[pos].index = track;
+        hits[pos].score = score;
+        if (found < max_hits) {
+            found++;
+        }
+    }
+    return found;
+}
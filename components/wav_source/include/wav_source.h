@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WAV_SOURCE_BLOCK_FRAMES   256  // Frames per read from a file
+#define WAV_SOURCE_MAX_CHANNELS   2
+#define WAV_SOURCE_MAX_SAMPLE_BYTES 4
+
+/**
+ * A WAV image being read in blocks and converted to interleaved int16. The header is
+ * parsed with byte loads, so images at any address (flash blobs, mmapped partitions,
+ * odd chunk offsets) are fine. Memory use is constant whatever the file length.
+ *
+ * Supported: PCM in 16, 24 or 32-bit containers and 32-bit IEEE float, plain or
+ * WAVE_FORMAT_EXTENSIBLE, mono or stereo.
+ */
+typedef struct wav_source {
+    // Backend: a file, or an image in memory
+    FILE *fp;
+    const uint8_t *data;
+    size_t data_len;
+    size_t pos;                  // Read offset into data
+    uint32_t mmap_handle;        // Partition mapping owned by this source
+    bool mapped;
+    // Format of the data chunk
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits_per_sample;    // Significant bits
+    uint16_t sample_bytes;       // Container size of one sample
+    bool is_float;
+    uint32_t frames_total;
+    uint32_t frames_left;
+    uint8_t raw[WAV_SOURCE_BLOCK_FRAMES * WAV_SOURCE_MAX_CHANNELS * WAV_SOURCE_MAX_SAMPLE_BYTES];  // File reads
+} wav_source_t;
+
+/**
+ * @brief Parse a WAV image in memory (e.g. an EMBED_FILES blob)
+ * The image must stay valid until wav_source_close().
+ * @param src: Source to initialize
+ * @param data: Start of the RIFF image
+ * @param len: Bytes available; a data chunk claiming more is cut to fit
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the image is not a valid WAV,
+ *         ESP_ERR_NOT_SUPPORTED for a sample format or channel count not listed above
+ */
+esp_err_t wav_source_open_memory(wav_source_t *src, const void *data, size_t len);
+
+/**
+ * @brief Parse a WAV header from an open file and stream the samples from it
+ * Reads start at the current position. The caller keeps ownership of fp and closes it
+ * after wav_source_close().
+ * @param src: Source to initialize
+ * @param fp: File opened for binary reading, positioned at the RIFF header
+ * @return As wav_source_open_memory()
+ */
+esp_err_t wav_source_open_file(wav_source_t *src, FILE *fp);
+
+/**
+ * @brief Map a data partition holding a WAV image (written with parttool.py) and parse it
+ * @param src: Source to initialize
+ * @param label: Partition label
+ * @return As wav_source_open_memory(), or ESP_ERR_NOT_FOUND if there is no such partition
+ */
+esp_err_t wav_source_open_partition(wav_source_t *src, const char *label);
+
+/**
+ * @brief Convert the next frames to interleaved int16 at the source's rate and channel count
+ * @param src: Open source
+ * @param out: At least max_frames * src->channels samples
+ * @param max_frames: Frames wanted
+ * @return Frames written; 0 at the end of the data (or of a truncated file)
+ */
+size_t wav_source_read(wav_source_t *src, int16_t *out, size_t max_frames);
+
+/**
+ * @brief Skip frames without converting them; a file source seeks past them
+ * @param src: Open source
+ * @param frames: Frames to skip
+ * @return Frames skipped, fewer if the data ends first
+ */
+size_t wav_source_skip(wav_source_t *src, size_t frames);
+
+/**
+ * @brief Release the source (unmaps a partition; does not close a file)
+ */
+void wav_source_close(wav_source_t *src);
+
+#ifdef __cplusplus
+}
+#endif
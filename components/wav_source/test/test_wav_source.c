@@ -0,0 +1,319 @@
+/**
+ * @file test_wav_source.c
+ * @brief Header parsing, sample conversion and streaming tests for wav_source
+ *
+ * WAV images are built in memory, with odd chunk sizes and unknown data lengths where
+ * a test needs them; file sources read them through fmemopen().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_log.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "wav_source.h"
+
+static const char *TAG = "test_wav_source";
+
+#define IMAGE_MAX 16384
+
+static uint8_t *s_image;
+static wav_source_t *s_src;
+
+typedef struct {
+    uint16_t tag;             // 1 PCM, 3 float, 0xFFFE extensible
+    uint16_t sub_tag;         // Subformat for extensible
+    uint16_t channels;
+    uint16_t container_bits;
+    uint16_t valid_bits;      // Extensible only
+    bool list_chunk;          // Odd-sized chunk before fmt
+} image_fmt_t;
+
+static uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    p = put16(p, (uint16_t)v);
+    return put16(p, (uint16_t)(v >> 16));
+}
+
+// Write a WAV image at dst; returns its length
+static size_t build_image(uint8_t *dst, const image_fmt_t *f, const void *samples, size_t sample_bytes)
+{
+    uint8_t *p = dst;
+    memcpy(p, "RIFF", 4);
+    p = put32(p + 4, 0);  // Patched below
+    memcpy(p, "WAVE", 4);
+    p += 4;
+    if (f->list_chunk) {
+        memcpy(p, "LIST", 4);
+        p = put32(p + 4, 5);
+        memcpy(p, "INFOx\0", 6);  // 5 bytes and a pad byte
+        p += 6;
+    }
+    bool ext = f->tag == 0xFFFE;
+    uint16_t block_align = f->channels * f->container_bits / 8;
+    memcpy(p, "fmt ", 4);
+    p = put32(p + 4, ext ? 40 : 16);
+    p = put16(p, f->tag);
+    p = put16(p, f->channels);
+    p = put32(p, 48000);
+    p = put32(p, 48000u * block_align);
+    p = put16(p, block_align);
+    p = put16(p, f->container_bits);
+    if (ext) {
+        p = put16(p, 22);
+        p = put16(p, f->valid_bits);
+        p = put32(p, f->channels == 2 ? 3 : 4);
+        p = put16(p, f->sub_tag);
+        static const uint8_t guid_tail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+                                               0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+        memcpy(p, guid_tail, sizeof(guid_tail));
+        p += sizeof(guid_tail);
+    }
+    memcpy(p, "data", 4);
+    p = put32(p + 4, (uint32_t)sample_bytes);
+    memcpy(p, samples, sample_bytes);
+    p += sample_bytes;
+    put32(dst + 4, (uint32_t)(p - dst - 8));
+    return (size_t)(p - dst);
+}
+
+void setUp(void)
+{
+    s_image = malloc(IMAGE_MAX);
+    s_src = malloc(sizeof(wav_source_t));
+    TEST_ASSERT_NOT_NULL(s_image);
+    TEST_ASSERT_NOT_NULL(s_src);
+}
+
+void tearDown(void)
+{
+    free(s_image);
+    free(s_src);
+}
+
+/**
+ * @brief 16-bit stereo at an odd address behind an odd-sized chunk comes out unchanged
+ */
+void test_pcm16_unaligned(void)
+{
+    int16_t samples[64];
+    for (int i = 0; i < 64; i++) {
+        samples[i] = (int16_t)(i * 1021 - 32000);
+    }
+    const image_fmt_t f = { .tag = 1, .channels = 2, .container_bits = 16, .list_chunk = true };
+    size_t len = build_image(s_image + 1, &f, samples, sizeof(samples));
+
+    TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_memory(s_src, s_image + 1, len));
+    TEST_ASSERT_EQUAL(48000, s_src->sample_rate);
+    TEST_ASSERT_EQUAL(2, s_src->channels);
+    TEST_ASSERT_EQUAL(32, s_src->frames_total);
+
+    int16_t out[64];
+    TEST_ASSERT_EQUAL(20, wav_source_read(s_src, out, 20));
+    TEST_ASSERT_EQUAL(12, wav_source_read(s_src, out + 40, 20));
+    TEST_ASSERT_EQUAL(0, wav_source_read(s_src, out, 20));
+    for (int i = 0; i < 64; i++) {
+        TEST_ASSERT_EQUAL_INT16(samples[i], out[i]);
+    }
+    wav_source_close(s_src);
+}
+
+/**
+ * @brief 24 and 32-bit integer and float samples round to int16 and saturate at the rails
+ */
+void test_sample_formats(void)
+{
+    int16_t out[8];
+
+    // 24-bit mono: 0x123480 rounds up, the top of the range saturates
+    const uint8_t s24[] = { 0x80, 0x34, 0x12, 0x7F, 0x34, 0x12, 0xFF, 0xFF, 0x7F, 0x00, 0x00, 0x80 };
+    const image_fmt_t f24 = { .tag = 1, .channels = 1, .container_bits = 24 };
+    size_t len = build_image(s_image, &f24, s24, sizeof(s24));
+    TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_memory(s_src, s_image, len));
+    TEST_ASSERT_EQUAL(4, wav_source_read(s_src, out, 8));
+    TEST_ASSERT_EQUAL_INT16(0x1235, out[0]);
+    TEST_ASSERT_EQUAL_INT16(0x1234, out[1]);
+    TEST_ASSERT_EQUAL_INT16(INT16_MAX, out[2]);
+    TEST_ASSERT_EQUAL_INT16(INT16_MIN, out[3]);
+
+    // 32-bit integer, and 24 valid bits in 32-bit containers (WAVE_FORMAT_EXTENSIBLE)
+    const int32_t s32[] = { 0x12348000, -0x12348000, INT32_MAX, INT32_MIN };
+    const image_fmt_t f32 = { .tag = 1, .channels = 2, .container_bits = 32 };
+    const image_fmt_t fext = { .tag = 0xFFFE, .sub_tag = 1, .channels = 2, .container_bits = 32, .valid_bits = 24 };
+    const image_fmt_t *ints[] = { &f32, &fext };
+    for (int k = 0; k < 2; k++) {
+        len = build_image(s_image, ints[k], s32, sizeof(s32));
+        TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_memory(s_src, s_image, len));
+        TEST_ASSERT_EQUAL(2, wav_source_read(s_src, out, 8));
+        TEST_ASSERT_EQUAL_INT16(0x1235, out[0]);
+        TEST_ASSERT_EQUAL_INT16(-0x1234, out[1]);
+        TEST_ASSERT_EQUAL_INT16(INT16_MAX, out[2]);
+        TEST_ASSERT_EQUAL_INT16(INT16_MIN, out[3]);
+    }
+    TEST_ASSERT_EQUAL(24, s_src->bits_per_sample);
+
+    // Float, plain and extensible: scaled by 32767, rounded, clamped; NaN is silence
+    const float sf[] = { 0.5f, -0.25f, 1.5f, -2.0f, 0.0f, -1.0f, 3e-5f, __builtin_nanf("") };
+    const image_fmt_t ff = { .tag = 3, .channels = 2, .container_bits = 32 };
+    const image_fmt_t ffext = { .tag = 0xFFFE, .sub_tag = 3, .channels = 2, .container_bits = 32, .valid_bits = 32 };
+    const image_fmt_t *floats[] = { &ff, &ffext };
+    for (int k = 0; k < 2; k++) {
+        len = build_image(s_image, floats[k], sf, sizeof(sf));
+        TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_memory(s_src, s_image, len));
+        TEST_ASSERT_EQUAL(4, wav_source_read(s_src, out, 8));
+        TEST_ASSERT_EQUAL_INT16(16384, out[0]);
+        TEST_ASSERT_EQUAL_INT16(-8192, out[1]);
+        TEST_ASSERT_EQUAL_INT16(INT16_MAX, out[2]);
+        TEST_ASSERT_EQUAL_INT16(INT16_MIN, out[3]);
+        TEST_ASSERT_EQUAL_INT16(0, out[4]);
+        TEST_ASSERT_EQUAL_INT16(-32767, out[5]);
+        TEST_ASSERT_EQUAL_INT16(1, out[6]);
+        TEST_ASSERT_EQUAL_INT16(0, out[7]);
+    }
+}
+
+/**
+ * @brief A file source streams across its block size, skips, and stops at a truncated end
+ */
+void test_file_streaming(void)
+{
+    const size_t frames = 1000;
+    int16_t *samples = malloc(frames * sizeof(int16_t));
+    int16_t *out = malloc(frames * sizeof(int16_t));
+    TEST_ASSERT_NOT_NULL(samples);
+    TEST_ASSERT_NOT_NULL(out);
+    for (size_t i = 0; i < frames; i++) {
+        samples[i] = (int16_t)(i * 37);
+    }
+    const image_fmt_t f = { .tag = 1, .channels = 1, .container_bits = 16, .list_chunk = true };
+    size_t len = build_image(s_image, &f, samples, frames * sizeof(int16_t));
+
+    FILE *fp = fmemopen(s_image, len, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_file(s_src, fp));
+    TEST_ASSERT_EQUAL(frames, s_src->frames_total);
+    size_t done = 0, n;
+    while ((n = wav_source_read(s_src, out + done, 300)) > 0) {
+        done += n;
+    }
+    TEST_ASSERT_EQUAL(frames, done);
+    for (size_t i = 0; i < frames; i++) {
+        TEST_ASSERT_EQUAL_INT16(samples[i], out[i]);
+    }
+    wav_source_close(s_src);
+    fclose(fp);
+
+    // Skipping seeks past frames, in a file and in memory, and stops at the end
+    fp = fmemopen(s_image, len, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_file(s_src, fp));
+    TEST_ASSERT_EQUAL(10, wav_source_read(s_src, out, 10));
+    TEST_ASSERT_EQUAL(613, wav_source_skip(s_src, 613));
+    TEST_ASSERT_EQUAL(5, wav_source_read(s_src, out, 5));
+    TEST_ASSERT_EQUAL_INT16(samples[623], out[0]);
+    TEST_ASSERT_EQUAL(frames - 628, wav_source_skip(s_src, frames));
+    TEST_ASSERT_EQUAL(0, wav_source_read(s_src, out, 5));
+    wav_source_close(s_src);
+    fclose(fp);
+    TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_memory(s_src, s_image, len));
+    TEST_ASSERT_EQUAL(900, wav_source_skip(s_src, 900));
+    TEST_ASSERT_EQUAL(100, wav_source_read(s_src, out, 300));
+    TEST_ASSERT_EQUAL_INT16(samples[900], out[0]);
+
+    // Header promises more than the file holds: read what is there, then end
+    fp = fmemopen(s_image, len - 200, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_file(s_src, fp));
+    done = 0;
+    while ((n = wav_source_read(s_src, out + done, 300)) > 0) {
+        done += n;
+    }
+    TEST_ASSERT_EQUAL(frames - 100, done);
+    TEST_ASSERT_EQUAL(0, wav_source_read(s_src, out, 300));
+    wav_source_close(s_src);
+    fclose(fp);
+    free(samples);
+    free(out);
+}
+
+/**
+ * @brief A data size left at 0 or ~0 by a streaming writer means "to the end of the image"
+ */
+void test_unknown_data_size(void)
+{
+    int16_t samples[20] = { 0 };
+    int16_t out[20];
+    const uint32_t sizes[] = { 0, UINT32_MAX };
+    for (int k = 0; k < 2; k++) {
+        const image_fmt_t f = { .tag = 1, .channels = 2, .container_bits = 16 };
+        size_t len = build_image(s_image, &f, samples, sizeof(samples));
+        put32(s_image + len - sizeof(samples) - 4, sizes[k]);
+        TEST_ASSERT_EQUAL(ESP_OK, wav_source_open_memory(s_src, s_image, len));
+        TEST_ASSERT_EQUAL(10, s_src->frames_total);
+        TEST_ASSERT_EQUAL(10, wav_source_read(s_src, out, 20));
+    }
+}
+
+/**
+ * @brief Malformed images are rejected as invalid, unsupported formats as not supported
+ */
+void test_rejects(void)
+{
+    int16_t samples[16] = { 0 };
+    const image_fmt_t ok = { .tag = 1, .channels = 2, .container_bits = 16 };
+    size_t len = build_image(s_image, &ok, samples, sizeof(samples));
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, wav_source_open_memory(s_src, s_image, 30));  // Cut in the fmt chunk
+    memcpy(s_image + 8, "AVI ", 4);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, wav_source_open_memory(s_src, s_image, len));
+    memcpy(s_image + 8, "WAVE", 4);
+    memcpy(s_image + 12, "junk", 4);  // fmt hidden: data comes first
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, wav_source_open_memory(s_src, s_image, len));
+
+    const image_fmt_t unsupported[] = {
+        { .tag = 1, .channels = 2, .container_bits = 8 },
+        { .tag = 1, .channels = 4, .container_bits = 16 },
+        { .tag = 2, .channels = 1, .container_bits = 16 },   // ADPCM
+        { .tag = 3, .channels = 1, .container_bits = 64 },   // Double
+        { .tag = 0xFFFE, .sub_tag = 2, .channels = 1, .container_bits = 16, .valid_bits = 16 },
+    };
+    for (size_t k = 0; k < sizeof(unsupported) / sizeof(unsupported[0]); k++) {
+        len = build_image(s_image, &unsupported[k], samples, sizeof(samples));
+        TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, wav_source_open_memory(s_src, s_image, len));
+    }
+}
+
+void app_main(void)
+{
+    // Wait a bit for serial output to initialize
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    ESP_LOGI(TAG, "\n\n=== wav_source Unit Tests ===\n");
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pcm16_unaligned);
+    RUN_TEST(test_sample_formats);
+    RUN_TEST(test_file_streaming);
+    RUN_TEST(test_unknown_data_size);
+    RUN_TEST(test_rejects);
+
+    UNITY_END();
+
+    ESP_LOGI(TAG, "\n=== All wav_source Tests Complete ===\n");
+
+    // Keep running so we can see results
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
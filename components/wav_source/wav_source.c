@@ -0,0 +1,336 @@
+/**
+ * @file wav_source.c
+ * @brief Block-wise WAV reader for files, flash blobs and mmapped partitions
+ *
+ * The RIFF chunks are walked through two backend primitives (read, skip) and every
+ * multi-byte field is assembled from bytes, so nothing depends on the alignment of
+ * the image. Samples are converted to int16 one block at a time: straight from the
+ * image for memory sources, through a fixed buffer for files.
+ */
+
+#include "wav_source.h"
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+
+#define WAVE_FORMAT_PCM         0x0001
+#define WAVE_FORMAT_IEEE_FLOAT  0x0003
+#define WAVE_FORMAT_EXTENSIBLE  0xFFFE
+#define FMT_EXTENSIBLE_BYTES    40  // fmt chunk up to the end of the subformat GUID
+#define FMT_SUBFORMAT_OFFSET    24
+
+static inline uint16_t rd16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline int16_t sat16(int32_t v)
+{
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+// Exact read of n header bytes
+static bool src_read(wav_source_t *src, void *dst, size_t n)
+{
+    if (src->fp) {
+        return fread(dst, 1, n, src->fp) == n;
+    }
+    if (n > src->data_len - src->pos) {
+        return false;
+    }
+    memcpy(dst, src->data + src->pos, n);
+    src->pos += n;
+    return true;
+}
+
+static bool src_skip(wav_source_t *src, uint32_t n)
+{
+    if (src->fp) {
+        return fseek(src->fp, (long)n, SEEK_CUR) == 0;
+    }
+    if (n > src->data_len - src->pos) {
+        return false;
+    }
+    src->pos += n;
+    return true;
+}
+
+// Bytes left after the current position, SIZE_MAX if the file size is unknown
+static size_t src_remaining(wav_source_t *src)
+{
+    if (!src->fp) {
+        return src->data_len - src->pos;
+    }
+    struct stat st;
+    long at = ftell(src->fp);
+    if (at < 0 || fstat(fileno(src->fp), &st) != 0 || st.st_size < at) {
+        return SIZE_MAX;
+    }
+    return (size_t)(st.st_size - at);
+}
+
+static esp_err_t parse_fmt(wav_source_t *src, const uint8_t *fmt, uint32_t size)
+{
+    uint16_t tag = rd16(fmt);
+    uint16_t channels = rd16(fmt + 2);
+    uint32_t rate = rd32(fmt + 4);
+    uint16_t block_align = rd16(fmt + 12);
+    uint16_t bits = rd16(fmt + 14);
+    if (tag == WAVE_FORMAT_EXTENSIBLE) {
+        if (size < FMT_EXTENSIBLE_BYTES) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        tag = rd16(fmt + FMT_SUBFORMAT_OFFSET);  // First field of the subformat GUID
+        uint16_t valid_bits = rd16(fmt + 18);
+        if (valid_bits != 0 && valid_bits < bits) {
+            bits = valid_bits;
+        }
+    }
+    if (channels == 0 || rate == 0 || block_align == 0 || block_align % channels != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint16_t sample_bytes = block_align / channels;
+    if (channels > WAV_SOURCE_MAX_CHANNELS || bits > sample_bytes * 8) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (tag == WAVE_FORMAT_PCM) {
+        if (sample_bytes < 2 || sample_bytes > 4 || bits <= 8) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    } else if (tag == WAVE_FORMAT_IEEE_FLOAT) {
+        if (sample_bytes != 4) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    } else {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    src->sample_rate = rate;
+    src->channels = channels;
+    src->bits_per_sample = bits;
+    src->sample_bytes = sample_bytes;
+    src->is_float = tag == WAVE_FORMAT_IEEE_FLOAT;
+    return ESP_OK;
+}
+
+// Walk the chunks up to the start of the samples
+static esp_err_t parse_header(wav_source_t *src)
+{
+    uint8_t hdr[12];
+    if (!src_read(src, hdr, sizeof(hdr)) || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool fmt_found = false;
+    for (;;) {
+        uint8_t chunk[8];
+        if (!src_read(src, chunk, sizeof(chunk))) {
+            return ESP_ERR_INVALID_ARG;  // No data chunk
+        }
+        uint32_t size = rd32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && !fmt_found) {
+            uint8_t fmt[FMT_EXTENSIBLE_BYTES] = {0};
+            uint32_t take = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (size < 16 || !src_read(src, fmt, take)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            esp_err_t err = parse_fmt(src, fmt, size);
+            if (err != ESP_OK) {
+                return err;
+            }
+            fmt_found = true;
+            if (!src_skip(src, size - take + (size & 1))) {
+                return ESP_ERR_INVALID_ARG;
+            }
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!fmt_found) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            // Writers that stream often leave the size at 0 or ~0; take what is there
+            size_t avail = src_remaining(src);
+            size_t bytes = (size == 0 || size == UINT32_MAX || size > avail) ? avail : size;
+            size_t frames = bytes / ((size_t)src->sample_bytes * src->channels);
+            src->frames_total = frames > UINT32_MAX ? UINT32_MAX : (uint32_t)frames;
+            src->frames_left = src->frames_total;
+            return src->frames_total > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+        } else if (!src_skip(src, size + (size & 1))) {
+            return ESP_ERR_INVALID_ARG;  // Chunks are word-aligned
+        }
+    }
+}
+
+esp_err_t wav_source_open_memory(wav_source_t *src, const void *data, size_t len)
+{
+    if (!src || !data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(src, 0, offsetof(wav_source_t, raw));
+    src->data = data;
+    src->data_len = len;
+    return parse_header(src);
+}
+
+esp_err_t wav_source_open_file(wav_source_t *src, FILE *fp)
+{
+    if (!src || !fp) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(src, 0, offsetof(wav_source_t, raw));
+    src->fp = fp;
+    return parse_header(src);
+}
+
+#ifdef ESP_PLATFORM
+esp_err_t wav_source_open_partition(wav_source_t *src, const char *label)
+{
+    if (!src || !label) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const void *ptr;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = wav_source_open_memory(src, ptr, part->size);
+    if (err != ESP_OK) {
+        esp_partition_munmap(handle);
+        return err;
+    }
+    src->mmap_handle = handle;
+    src->mapped = true;
+    return ESP_OK;
+}
+#else
+esp_err_t wav_source_open_partition(wav_source_t *src, const char *label)
+{
+    (void)src;
+    (void)label;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
+
+// Convert n frames of the source's format to int16, rounding and saturating
+static void convert(const wav_source_t *src, const uint8_t *in, int16_t *out, size_t n)
+{
+    size_t samples = n * src->channels;
+    if (src->is_float) {
+        for (size_t i = 0; i < samples; i++, in += 4) {
+            uint32_t bits = rd32(in);
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            f *= 32767.0f;
+            if (!(f < 32767.0f)) {
+                f = f > 0.0f ? 32767.0f : 0.0f;  // +overflow or NaN
+            } else if (f < -32768.0f) {
+                f = -32768.0f;
+            }
+            out[i] = (int16_t)(f >= 0.0f ? f + 0.5f : f - 0.5f);
+        }
+        return;
+    }
+    switch (src->sample_bytes) {
+    case 2:
+        for (size_t i = 0; i < samples; i++, in += 2) {
+            out[i] = (int16_t)rd16(in);
+        }
+        break;
+    case 3:
+        for (size_t i = 0; i < samples; i++, in += 3) {
+            int32_t v = (int32_t)((uint32_t)in[0] << 8 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 24) >> 8;
+            out[i] = sat16((v + 0x80) >> 8);
+        }
+        break;
+    default:
+        for (size_t i = 0; i < samples; i++, in += 4) {
+            int64_t v = (int32_t)rd32(in);
+            out[i] = sat16((int32_t)((v + 0x8000) >> 16));
+        }
+        break;
+    }
+}
+
+size_t wav_source_read(wav_source_t *src, int16_t *out, size_t max_frames)
+{
+    if (!src || !out) {
+        return 0;
+    }
+    size_t frame_bytes = (size_t)src->sample_bytes * src->channels;
+    size_t done = 0;
+    while (done < max_frames && src->frames_left > 0) {
+        size_t n = max_frames - done;
+        if (n > src->frames_left) {
+            n = src->frames_left;
+        }
+        const uint8_t *in;
+        if (src->fp) {
+            if (n > WAV_SOURCE_BLOCK_FRAMES) {
+                n = WAV_SOURCE_BLOCK_FRAMES;
+            }
+            size_t got = fread(src->raw, frame_bytes, n, src->fp);
+            if (got < n) {
+                src->frames_left = (uint32_t)got;  // Truncated file: end after these
+            }
+            n = got;
+            in = src->raw;
+        } else {
+            in = src->data + src->pos;
+            src->pos += n * frame_bytes;
+        }
+        if (n == 0) {
+            break;
+        }
+        convert(src, in, out + done * src->channels, n);
+        src->frames_left -= (uint32_t)n;
+        done += n;
+    }
+    return done;
+}
+
+size_t wav_source_skip(wav_source_t *src, size_t frames)
+{
+    if (!src) {
+        return 0;
+    }
+    if (frames > src->frames_left) {
+        frames = src->frames_left;
+    }
+    size_t bytes = frames * src->sample_bytes * src->channels;
+    if (bytes > UINT32_MAX || !src_skip(src, (uint32_t)bytes)) {
+        return 0;
+    }
+    src->frames_left -= (uint32_t)frames;
+    return frames;
+}
+
+void wav_source_close(wav_source_t *src)
+{
+    if (!src) {
+        return;
+    }
+#ifdef ESP_PLATFORM
+    if (src->mapped) {
+        esp_partition_munmap(src->mmap_handle);
+    }
+#endif
+    src->mapped = false;
+    src->fp = NULL;
+    src->data = NULL;
+    src->frames_left = 0;
+}
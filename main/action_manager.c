@@ -1,5 +1,6 @@
 #include "action_manager.h"
 #include "audio_player.h"
+#include "audio_file_manager.h"
 #include "led_strip.h"
 #include "led_indicators.h"
 #include "gemini_api.h"
@@ -160,11 +161,14 @@ static esp_err_t set_audio_volume(float volume)
     if (volume > 1.0f) volume = 1.0f;
     
     s_device_state.current_volume = volume;
-    
-    // Note: ES8311 volume control would go here
-    // For now, we just store the volume level
-    // Actual implementation would write to ES8311 registers
-    
+
+    // Ramped in software, coarse steps in the ES8311 DAC volume register
+    esp_err_t err = audio_player_set_volume(volume);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Volume not applied: %s", esp_err_to_name(err));
+        return err;
+    }
+
     ESP_LOGI(TAG, "Volume set to %.2f", volume);
     return ESP_OK;
 }
@@ -177,14 +181,26 @@ esp_err_t action_manager_execute(const action_t *action)
     
     switch (action->type) {
         case ACTION_SONG_CHANGE: {
-            // Note: Audio file playback not implemented yet
-            // For now, we can use TTS to speak the song name
-            ESP_LOGW(TAG, "SongChange not fully implemented - would play: %s", 
-                     action->data.song_change.song_name);
-            char msg[256];
-            snprintf(msg, sizeof(msg), "Playing %s", action->data.song_change.song_name);
-            // Could trigger TTS here
-            return ESP_OK;
+            // The assistant names tracks loosely ("the rain one", "ocean sleep"): resolve the
+            // name before stopping what plays, so a miss leaves it playing
+            audio_file_info_t info;
+            if (audio_file_manager_get_by_name(action->data.song_change.song_name, &info) != ESP_OK) {
+                ESP_LOGW(TAG, "SongChange: no track matches '%s'", action->data.song_change.song_name);
+                return ESP_ERR_NOT_FOUND;
+            }
+            ESP_LOGI(TAG, "SongChange: '%s' -> %s", action->data.song_change.song_name, info.name);
+            esp_err_t err = audio_file_manager_play(info.name, action->data.song_change.volume,
+                                                    action->data.song_change.duration);
+            if (err == ESP_OK) {
+                s_device_state.audio_playing = true;
+                // A routine names its next track (presleep -> sleep -> wakeup): load its
+                // start now so the change does not wait on the SD card
+                const char *next = action->data.song_change.next_song_name;
+                if (next[0] && audio_file_manager_prefetch(next) != ESP_OK) {
+                    ESP_LOGW(TAG, "SongChange: cannot prefetch next track '%s'", next);
+                }
+            }
+            return err;
         }
         
         case ACTION_SPEECH: {
@@ -290,15 +306,25 @@ esp_err_t action_manager_execute_json(const char *action_json)
             if (data) {
                 cJSON *song_name = cJSON_GetObjectItem(data, "SongName");
                 cJSON *volume = cJSON_GetObjectItem(data, "Volume");
+                cJSON *duration = cJSON_GetObjectItem(data, "Duration");
+                cJSON *next_song_name = cJSON_GetObjectItem(data, "NextSongName");
                 if (song_name && cJSON_IsString(song_name)) {
                     strncpy(action.data.song_change.song_name, song_name->valuestring,
                            sizeof(action.data.song_change.song_name) - 1);
                 }
+                if (next_song_name && cJSON_IsString(next_song_name)) {
+                    strncpy(action.data.song_change.next_song_name, next_song_name->valuestring,
+                           sizeof(action.data.song_change.next_song_name) - 1);
+                }
                 if (volume && cJSON_IsNumber(volume)) {
                     action.data.song_change.volume = (float)volume->valuedouble;
                 } else {
                     action.data.song_change.volume = 0.6f;
                 }
+                action.data.song_change.duration = -1;
+                if (duration && cJSON_IsNumber(duration) && duration->valueint > 0) {
+                    action.data.song_change.duration = duration->valueint;
+                }
             }
             break;
         }
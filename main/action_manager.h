@@ -34,6 +34,7 @@ typedef struct {
             char song_name[128];
             float volume;
             int duration;  // seconds, -1 for indefinite
+            char next_song_name[128];  // Track a routine plays next, prefetched; empty for none
         } song_change;
         struct {
             char text[512];
@@ -1,6 +1,7 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 
@@ -25,14 +26,16 @@
 #include "audio_file_manager.h"
 #include "environmental_report.h"
 #include "esp_task_wdt.h"
-#include "tls_mutex.h"
+#include "net_scheduler.h"
+#include "dns_cache.h"
 #include "gemini_api.h"
 #include "audio_player.h"
 #include "wake_word_manager.h"
-// WAV file is embedded via EMBED_FILES
-// Access it via the generated symbol (ESP-IDF generates these symbols automatically)
-extern const uint8_t _binary_256kMeasSweep_0_to_20000__12_dBFS_48k_Float_LR_refL_wav_start[] asm("_binary_256kMeasSweep_0_to_20000__12_dBFS_48k_Float_LR_refL_wav_start");
-extern const uint8_t _binary_256kMeasSweep_0_to_20000__12_dBFS_48k_Float_LR_refL_wav_end[] asm("_binary_256kMeasSweep_0_to_20000__12_dBFS_48k_Float_LR_refL_wav_end");
+#include "wav_source.h"
+
+// The log sweep is streamed from the SD card, or from its own flash partition
+#define SWEEP_WAV_PATH        "/sdcard/256kMeasSweep_0_to_20000_-12_dBFS_48k_Float_LR_refL.wav"
+#define SWEEP_PARTITION_LABEL "sweep"
 
 // Offline welcome message (for use when internet is unavailable)
 extern const uint8_t _binary_offline_welcome_wav_start[] asm("_binary_offline_welcome_wav_start");
@@ -60,7 +63,8 @@ static esp_err_t time_tts_callback(const int16_t *samples, size_t sample_count,
     if (!samples || sample_count == 0) {
         return ESP_OK;
     }
-    return audio_player_submit_pcm(samples, sample_count, 24000, 1);  // 24kHz, mono
+    return audio_player_stream_submit(AUDIO_STREAM_VOICE, samples, sample_count, 24000, 1,  // 24kHz, mono
+                                      portMAX_DELAY, NULL);
 }
 
 // BLE WiFi connect callback
@@ -252,39 +256,29 @@ static void update_leds_for_audio(float progress, bool playing)
     led_strip_refresh(s_strip);
 }
 
-// Play log sweep from embedded WAV file
+// Play the log sweep from the SD card, falling back to the "sweep" flash partition
 static void play_log_sweep_pcm(void)
 {
-    size_t wav_size = _binary_256kMeasSweep_0_to_20000__12_dBFS_48k_Float_LR_refL_wav_end - _binary_256kMeasSweep_0_to_20000__12_dBFS_48k_Float_LR_refL_wav_start;
-    const uint8_t *wav_data = _binary_256kMeasSweep_0_to_20000__12_dBFS_48k_Float_LR_refL_wav_start;
-    
-    ESP_LOGI(TAG, "Playing embedded log sweep WAV file (%zu bytes)", wav_size);
-    ESP_LOGI(TAG, "WAV file first 16 bytes: %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x",
-             wav_data[0], wav_data[1], wav_data[2], wav_data[3],
-             wav_data[4], wav_data[5], wav_data[6], wav_data[7],
-             wav_data[8], wav_data[9], wav_data[10], wav_data[11],
-             wav_data[12], wav_data[13], wav_data[14], wav_data[15]);
-    
-    // Verify it's a valid WAV file (RIFF header)
-    if (wav_size < 12 || wav_data[0] != 'R' || wav_data[1] != 'I' || 
-        wav_data[2] != 'F' || wav_data[3] != 'F') {
-        ESP_LOGE(TAG, "Invalid WAV file - missing RIFF header!");
-        update_leds_for_audio(0.0f, false);
-        return;
+    ESP_LOGI(TAG, "Playing log sweep from %s", SWEEP_WAV_PATH);
+    esp_err_t err = audio_player_play_wav_file(SWEEP_WAV_PATH, update_leds_for_audio);
+    if (err == ESP_ERR_NOT_FOUND) {
+        // Written with: parttool.py write_partition --partition-name sweep --input <file>.wav
+        wav_source_t *src = malloc(sizeof(wav_source_t));
+        err = src ? wav_source_open_partition(src, SWEEP_PARTITION_LABEL) : ESP_ERR_NO_MEM;
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Playing log sweep from partition '%s'", SWEEP_PARTITION_LABEL);
+            err = audio_player_play_wav_source(src, update_leds_for_audio);
+            wav_source_close(src);
+        }
+        free(src);
     }
-    
-    // Play the embedded WAV file with LED progress callback
-    // The callback will update LEDs in sync with audio playback
-    esp_err_t err = audio_player_play_wav(wav_data, 
-                                          wav_size,
-                                          update_leds_for_audio);  // Pass LED update function as callback
-    
+
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to play WAV file: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to play log sweep: %s", esp_err_to_name(err));
         update_leds_for_audio(0.0f, false);  // Turn off LEDs on error
         return;
     }
-    
+
     ESP_LOGI(TAG, "Log sweep WAV playback complete");
 }
 
@@ -353,9 +347,9 @@ static void play_mp3_file(const uint8_t *mp3_data, size_t mp3_len)
                 ESP_LOGI(TAG, "MP3: %d Hz, %d channel(s)", sample_rate, channels);
             }
             
-            // Play decoded PCM
-            err = audio_player_submit_pcm(pcm_buffer, samples_decoded / channels,
-                                          sample_rate, channels);
+            // Queue decoded PCM (waits while the playback ring is full)
+            err = audio_player_submit_pcm_wait(pcm_buffer, samples_decoded / channels,
+                                               sample_rate, channels, portMAX_DELAY, NULL);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "Failed to submit PCM: %s", esp_err_to_name(err));
             }
@@ -382,6 +376,8 @@ static void play_mp3_file(const uint8_t *mp3_data, size_t mp3_len)
         vTaskDelay(pdMS_TO_TICKS(10));
     }
     
+    audio_player_stream_wait_idle(AUDIO_STREAM_MEDIA, portMAX_DELAY);
+    
     // Final LED update
     update_leds_for_audio(1.0f, true);
     vTaskDelay(pdMS_TO_TICKS(100));
@@ -464,13 +460,13 @@ void app_main(void)
     // The timeout should be set via sdkconfig.defaults (30 seconds)
     esp_task_wdt_add(NULL);
     
-    // Initialize TLS mutex for serializing TLS connections
-    // This prevents concurrent TLS connections that cause memory allocation errors
-    esp_err_t tls_mutex_err = tls_mutex_init();
-    if (tls_mutex_err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize TLS mutex: %s", esp_err_to_name(tls_mutex_err));
+    // Initialize the network request scheduler before any HTTPS client runs
+    // It admits TLS sessions by priority and available internal RAM
+    esp_err_t net_sched_err = net_scheduler_init();
+    if (net_sched_err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize network scheduler: %s", esp_err_to_name(net_sched_err));
     } else {
-        ESP_LOGI(TAG, "✅ TLS mutex initialized - serializing TLS connections");
+        ESP_LOGI(TAG, "✅ Network scheduler initialized - TLS sessions admitted by priority");
     }
     
     // Create dedicated watchdog feed task BEFORE any long operations
@@ -523,7 +519,7 @@ void app_main(void)
     // Try SDMMC mode first (1-bit mode, most compatible)
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,
-        .max_files = 5,
+        .max_files = 5,  // Shared with the SD cache, which keeps at most its max_open of them
         .allocation_unit_size = 16 * 1024
     };
     
@@ -779,6 +775,21 @@ void app_main(void)
             if (wifi_manager_get_ip(ip_str, sizeof(ip_str)) == ESP_OK) {
                 ESP_LOGI(TAG, "WiFi connected, IP: %s", ip_str);
                 
+                // Shared DNS cache for every HTTP client; pre-resolve the fixed
+                // endpoints so no request on the voice path waits for a lookup
+                if (dns_cache_init() == ESP_OK) {
+                    static const char *const s_pinned_hosts[] = {
+                        "speech.googleapis.com",
+                        "generativelanguage.googleapis.com",
+                        "texttospeech.googleapis.com",
+                        "api-uat.naptick.com",
+                        "api.open-meteo.com",
+                    };
+                    for (size_t i = 0; i < sizeof(s_pinned_hosts) / sizeof(s_pinned_hosts[0]); i++) {
+                        dns_cache_pin(s_pinned_hosts[i]);
+                    }
+                }
+                
                 // Synchronize time with NTP (required for TLS certificate validation)
                 ESP_LOGI(TAG, "Synchronizing time with NTP servers...");
                 esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG("pool.ntp.org");
@@ -852,8 +863,8 @@ void app_main(void)
                                 ESP_LOGW(TAG, "TTS announcement failed: %s (continuing anyway)", esp_err_to_name(tts_ret));
                             } else {
                                 ESP_LOGI(TAG, "✅ Time announced via TTS");
-                                // Wait a bit for TTS to complete (rough estimate: ~3-5 seconds for announcement)
-                                vTaskDelay(pdMS_TO_TICKS(6000));
+                                // Wait for the queued announcement to finish playing
+                                audio_player_stream_wait_idle(AUDIO_STREAM_VOICE, pdMS_TO_TICKS(15000));
                             }
                             
                             // Resume wake word detection
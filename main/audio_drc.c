@@ -0,0 +1,324 @@
+/**
+ * @file audio_drc.c
+ * @brief RMS compressor and true-peak look-ahead limiter for the playback path
+ *
+ * Work is split into passes over the block so that all but one are straight loops
+ * over independent frames: compressor gain and apply, the 4x true-peak estimate,
+ * and the final gain multiply with int16 pack. Only the limiter's gain computer
+ * (sliding minimum, release, moving average) is a per-frame recurrence, and it
+ * runs on one stereo-linked value per frame. Transcendentals are evaluated once
+ * per compressor sub-block, never per sample.
+ */
+
+#include "audio_drc.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SUB_FRAMES      16        // Compressor detector / gain interpolation step
+#define KNEE_DB         6.0f      // Soft knee width around the threshold
+#define FULL_SCALE      32768.0f
+#define TP_CENTRE       (AUDIO_DRC_TP_TAPS / 2 - 1)  // Window tap just before the interpolated points
+#define TP_KAISER_BETA  3.0
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 30; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// Windowed-sinc taps for the points 1/4, 2/4 and 3/4 of the way from x[TP_CENTRE] to the next sample
+static void design_true_peak(audio_drc_t *drc)
+{
+    const double half = AUDIO_DRC_TP_TAPS / 2.0;
+    for (int p = 0; p < AUDIO_DRC_TP_PHASES; p++) {
+        double frac = (p + 1) / (double)(AUDIO_DRC_TP_PHASES + 1);
+        double h[AUDIO_DRC_TP_TAPS], sum = 0.0;
+        for (int t = 0; t < AUDIO_DRC_TP_TAPS; t++) {
+            double d = t - TP_CENTRE - frac;
+            double r = d / half;
+            double sinc = sin(M_PI * d) / (M_PI * d);
+            h[t] = sinc * bessel_i0(TP_KAISER_BETA * sqrt(fmax(0.0, 1.0 - r * r))) / bessel_i0(TP_KAISER_BETA);
+            sum += h[t];
+        }
+        for (int t = 0; t < AUDIO_DRC_TP_TAPS; t++) {
+            drc->tp_coeffs[p][t] = (float)(h[t] / sum);
+        }
+    }
+}
+
+static bool config_valid(const audio_drc_config_t *cfg)
+{
+    return cfg->ratio >= 1.0f && cfg->attack_ms > 0.0f && cfg->release_ms > 0.0f && cfg->limit_release_ms > 0.0f &&
+           cfg->lookahead_ms >= 0.0f && cfg->limit_db <= 0.0f;
+}
+
+static void derive(audio_drc_t *drc)
+{
+    const float rate = (float)drc->sample_rate;
+    drc->env_attack = 1.0f - expf(-SUB_FRAMES * 1000.0f / (drc->cfg.attack_ms * rate));
+    drc->env_release = 1.0f - expf(-SUB_FRAMES * 1000.0f / (drc->cfg.release_ms * rate));
+    drc->lim_release = 1.0f - expf(-1000.0f / (drc->cfg.limit_release_ms * rate));
+    drc->ceiling = FULL_SCALE * powf(10.0f, drc->cfg.limit_db / 20.0f);
+    uint32_t la = (uint32_t)(drc->cfg.lookahead_ms * rate / 1000.0f + 0.5f);
+    drc->lookahead = la < 1 ? 1 : la > AUDIO_DRC_MAX_LOOKAHEAD ? AUDIO_DRC_MAX_LOOKAHEAD : la;
+}
+
+esp_err_t audio_drc_init(audio_drc_t *drc, uint32_t sample_rate, const audio_drc_config_t *cfg)
+{
+    if (!drc || sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const audio_drc_config_t def = AUDIO_DRC_DEFAULT_CONFIG();
+    if (!cfg) {
+        cfg = &def;
+    }
+    if (!config_valid(cfg)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(drc, 0, sizeof(*drc));
+    drc->cfg = *cfg;
+    drc->sample_rate = sample_rate;
+    drc->enabled = true;
+    design_true_peak(drc);
+    derive(drc);
+    audio_drc_reset(drc);
+    return ESP_OK;
+}
+
+esp_err_t audio_drc_set_config(audio_drc_t *drc, const audio_drc_config_t *cfg)
+{
+    if (!drc || !cfg || !config_valid(cfg)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    drc->cfg = *cfg;
+    derive(drc);
+    audio_drc_reset(drc);
+    return ESP_OK;
+}
+
+void audio_drc_reset(audio_drc_t *drc)
+{
+    if (!drc) {
+        return;
+    }
+    drc->env = 0.0f;
+    drc->comp_gain = powf(10.0f, drc->cfg.makeup_db / 20.0f);
+    memset(drc->hist, 0, sizeof(drc->hist));
+    drc->hold_head = 0;
+    drc->hold_len = 0;
+    drc->frame = 0;
+    drc->prev_peak = 0.0f;
+    drc->lim_gain = 1.0f;
+    drc->last_gain = 1.0f;
+    for (uint32_t i = 0; i < drc->lookahead; i++) {
+        drc->box[i] = 1.0f;
+    }
+    drc->box_pos = 0;
+}
+
+size_t audio_drc_latency_frames(const audio_drc_t *drc)
+{
+    // The limiter output trails detection by lookahead - 1; detection trails input by TAPS / 2
+    return drc && drc->enabled ? drc->lookahead - 1 + AUDIO_DRC_TP_TAPS / 2 : 0;
+}
+
+static inline int16_t pack(float v)
+{
+    // lrintf() is a libcall on this target
+    v += v < 0.0f ? -0.5f : 0.5f;
+    v = v > 32767.0f ? 32767.0f : v;
+    v = v < -32768.0f ? -32768.0f : v;
+    return (int16_t)v;
+}
+
+// Gain for a power level: soft-knee downward compression plus makeup
+static float compressor_gain(const audio_drc_t *drc, float power)
+{
+    float level_db = 10.0f * log10f(power / (FULL_SCALE * FULL_SCALE) + 1e-12f);
+    float over = level_db - drc->cfg.threshold_db;
+    float slope = 1.0f - 1.0f / drc->cfg.ratio;
+    float reduce = 0.0f;
+    if (2.0f * over >= KNEE_DB) {
+        reduce = slope * over;
+    } else if (2.0f * over > -KNEE_DB) {
+        float x = over + KNEE_DB / 2.0f;
+        reduce = slope * x * x / (2.0f * KNEE_DB);
+    }
+    return powf(10.0f, (drc->cfg.makeup_db - reduce) / 20.0f);
+}
+
+// Pass 1: compress 'n' interleaved frames into planar history at 'dst'
+static void compress(audio_drc_t *drc, const float *in, size_t dst, size_t n)
+{
+    float *l = &drc->hist[0][dst], *r = &drc->hist[1][dst];
+    for (size_t s = 0; s < n; s += SUB_FRAMES) {
+        size_t m = n - s < SUB_FRAMES ? n - s : SUB_FRAMES;
+        const float *x = in + s * 2;
+        float power = 0.0f;
+        for (size_t i = 0; i < m * 2; i++) {
+            power += x[i] * x[i];
+        }
+        power /= (float)(m * 2);
+        drc->env += (power > drc->env ? drc->env_attack : drc->env_release) * (power - drc->env);
+
+        float g = drc->comp_gain;
+        float step = (compressor_gain(drc, drc->env) - g) / (float)m;
+        for (size_t i = 0; i < m; i++) {
+            g += step;
+            l[s + i] = x[2 * i] * g;
+            r[s + i] = x[2 * i + 1] * g;
+        }
+        drc->comp_gain = g;
+    }
+}
+
+// Pass 2: true peak around detection frames k0 .. k0 + n - 1, from the samples and three
+// interpolated points on each side
+static void true_peak(audio_drc_t *drc, size_t k0, size_t n)
+{
+    float *peak = drc->peak;
+    const float *l = &drc->hist[0][k0], *r = &drc->hist[1][k0];
+    for (size_t i = 0; i < n; i++) {
+        float a = fabsf(l[i]), b = fabsf(r[i]);
+        peak[i] = a > b ? a : b;
+    }
+    // Points between k and k + 1 are estimated below and also bind frame k + 1
+    for (int p = 0; p < AUDIO_DRC_TP_PHASES; p++) {
+        const float *c = drc->tp_coeffs[p];
+        for (int ch = 0; ch < 2; ch++) {
+            const float *x = &drc->hist[ch][k0 - TP_CENTRE];
+            for (size_t i = 0; i < n; i++) {
+                float v = 0.0f;
+                for (int t = 0; t < AUDIO_DRC_TP_TAPS; t++) {
+                    v += c[t] * x[i + t];
+                }
+                v = fabsf(v);
+                peak[i] = v > peak[i] ? v : peak[i];
+            }
+        }
+    }
+    float prev = drc->prev_peak;
+    for (size_t i = 0; i < n; i++) {
+        float cur = peak[i];
+        peak[i] = cur > prev ? cur : prev;
+        prev = cur;
+    }
+    drc->prev_peak = prev;
+}
+
+// Pass 3: required gain -> sliding minimum over the look-ahead -> release -> moving average
+static void limiter_gain(audio_drc_t *drc, size_t n)
+{
+    const uint32_t la = drc->lookahead;
+    const float inv_la = 1.0f / (float)la;
+    const float ceiling = drc->ceiling;
+    const float rel = drc->lim_release;
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < la; i++) {
+        sum += drc->box[i];  // Re-summed per block so rounding cannot drift
+    }
+    float g = drc->lim_gain;
+    uint32_t head = drc->hold_head, len = drc->hold_len, pos = drc->box_pos, frame = drc->frame;
+
+    for (size_t i = 0; i < n; i++, frame++) {
+        float need = drc->peak[i] > ceiling ? ceiling / drc->peak[i] : 1.0f;
+        // Monotonic queue: drop the entry that aged out, then those the new one undercuts
+        if (len > 0 && frame - drc->hold_pos[head] >= la) {
+            head = head + 1 == la ? 0 : head + 1;
+            len--;
+        }
+        while (len > 0 && drc->hold_val[(head + len - 1) % la] >= need) {
+            len--;
+        }
+        drc->hold_val[(head + len) % la] = need;
+        drc->hold_pos[(head + len) % la] = frame;
+        len++;
+        float hold = drc->hold_val[head];
+
+        g += (1.0f - g) * rel;
+        g = g < hold ? g : hold;
+        sum += g - drc->box[pos];
+        drc->box[pos] = g;
+        pos = pos + 1 == la ? 0 : pos + 1;
+        drc->gain_out[i] = sum * inv_la;
+    }
+    drc->lim_gain = g;
+    drc->hold_head = head;
+    drc->hold_len = len;
+    drc->box_pos = pos;
+    drc->frame = frame;
+    drc->last_gain = drc->gain_out[n - 1];
+}
+
+static void process_block(audio_drc_t *drc, const float *in, int16_t *out, size_t n)
+{
+    const size_t hist = drc->lookahead + AUDIO_DRC_TP_TAPS;
+    const size_t k0 = hist - AUDIO_DRC_TP_TAPS / 2;  // First frame whose window is now complete
+    compress(drc, in, hist, n);
+    true_peak(drc, k0, n);
+    limiter_gain(drc, n);
+
+    // Pass 4: the frame leaving the delay line gets the gain computed for lookahead - 1 frames later
+    const float *l = &drc->hist[0][k0 + 1 - drc->lookahead];
+    const float *r = &drc->hist[1][k0 + 1 - drc->lookahead];
+    for (size_t i = 0; i < n; i++) {
+        float g = drc->gain_out[i];
+        out[2 * i] = pack(l[i] * g);
+        out[2 * i + 1] = pack(r[i] * g);
+    }
+    memmove(drc->hist[0], &drc->hist[0][n], hist * sizeof(float));
+    memmove(drc->hist[1], &drc->hist[1][n], hist * sizeof(float));
+}
+
+void audio_drc_process(audio_drc_t *drc, const float *in, int16_t *out, size_t frames)
+{
+    if (!drc || !in || !out) {
+        return;
+    }
+    if (!drc->enabled) {
+        for (size_t i = 0; i < frames * 2; i++) {
+            out[i] = pack(in[i]);
+        }
+        return;
+    }
+    while (frames > 0) {
+        size_t n = frames < AUDIO_DRC_BLOCK_FRAMES ? frames : AUDIO_DRC_BLOCK_FRAMES;
+        process_block(drc, in, out, n);
+        in += n * 2;
+        out += n * 2;
+        frames -= n;
+    }
+}
+
+void audio_drc_process_s16(audio_drc_t *drc, int16_t *samples, size_t frames)
+{
+    if (!drc || !samples || !drc->enabled) {
+        return;
+    }
+    float block[AUDIO_DRC_BLOCK_FRAMES * 2];
+    while (frames > 0) {
+        size_t n = frames < AUDIO_DRC_BLOCK_FRAMES ? frames : AUDIO_DRC_BLOCK_FRAMES;
+        for (size_t i = 0; i < n * 2; i++) {
+            block[i] = samples[i];
+        }
+        process_block(drc, block, samples, n);
+        samples += n * 2;
+        frames -= n;
+    }
+}
+
+float audio_drc_gain_db(const audio_drc_t *drc)
+{
+    if (!drc || !drc->enabled) {
+        return 0.0f;
+    }
+    return 20.0f * log10f(drc->comp_gain * drc->last_gain);
+}
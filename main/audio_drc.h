@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_DRC_BLOCK_FRAMES    256  // Frames processed per pass
+#define AUDIO_DRC_MAX_LOOKAHEAD   192  // Limiter look-ahead, frames (4 ms at 48 kHz)
+#define AUDIO_DRC_TP_TAPS         12   // True-peak interpolator taps per phase
+#define AUDIO_DRC_TP_PHASES       3    // Points estimated between samples (4x oversampling)
+#define AUDIO_DRC_HIST_FRAMES     (AUDIO_DRC_MAX_LOOKAHEAD + AUDIO_DRC_TP_TAPS)
+
+/**
+ * Dynamics settings
+ */
+typedef struct {
+    float threshold_db;       // Compressor threshold, dBFS RMS
+    float ratio;              // Compression above the threshold, >= 1
+    float attack_ms;          // RMS detector attack
+    float release_ms;         // RMS detector release
+    float makeup_db;          // Gain after compression
+    float limit_db;           // Limiter ceiling, dBFS true peak
+    float limit_release_ms;   // Limiter recovery
+    float lookahead_ms;       // Limiter look-ahead, also the attack time
+} audio_drc_config_t;
+
+#define AUDIO_DRC_DEFAULT_CONFIG() {    \
+    .threshold_db = -18.0f,             \
+    .ratio = 2.0f,                      \
+    .attack_ms = 10.0f,                 \
+    .release_ms = 200.0f,               \
+    .makeup_db = 3.0f,                  \
+    .limit_db = -1.0f,                  \
+    .limit_release_ms = 50.0f,          \
+    .lookahead_ms = 2.0f,               \
+}
+
+/**
+ * RMS compressor followed by a true-peak look-ahead limiter, stereo-linked
+ *
+ * The compressor follows the block's mean power in sub-blocks and interpolates its
+ * gain across each one. The limiter estimates inter-sample peaks with a 4x polyphase
+ * interpolator, holds the lowest required gain over the look-ahead window, releases
+ * exponentially, and smooths with a moving average as long as the window, so the
+ * gain is already down when a peak leaves the delay line.
+ */
+typedef struct {
+    audio_drc_config_t cfg;
+    uint32_t sample_rate;
+    bool enabled;
+
+    // Derived from cfg and sample_rate
+    float env_attack;         // Per-sub-block smoothing of the power envelope
+    float env_release;
+    float lim_release;        // Per-frame recovery of the limiter gain
+    float ceiling;            // Linear, int16 scale
+    uint32_t lookahead;       // Frames, 1..AUDIO_DRC_MAX_LOOKAHEAD
+    float tp_coeffs[AUDIO_DRC_TP_PHASES][AUDIO_DRC_TP_TAPS];
+
+    // Compressor
+    float env;                // Smoothed mean power, int16 scale squared
+    float comp_gain;          // Gain at the end of the last sub-block
+
+    // Limiter
+    float hist[2][AUDIO_DRC_HIST_FRAMES + AUDIO_DRC_BLOCK_FRAMES];  // Compressed input, planar
+    float hold_val[AUDIO_DRC_MAX_LOOKAHEAD];  // Sliding minimum: increasing gains, ring
+    uint32_t hold_pos[AUDIO_DRC_MAX_LOOKAHEAD];
+    uint32_t hold_head, hold_len;
+    uint32_t frame;           // Detection frames since reset (wraps)
+    float prev_peak;          // Peak estimate of the frame before the block
+    float lim_gain;           // Released gain
+    float box[AUDIO_DRC_MAX_LOOKAHEAD];       // Last 'lookahead' released gains, ring
+    uint32_t box_pos;
+    float last_gain;          // Limiter gain on the last frame out
+    float gain_out[AUDIO_DRC_BLOCK_FRAMES];   // Scratch: per-frame limiter gain
+    float peak[AUDIO_DRC_BLOCK_FRAMES];       // Scratch: per-frame true peak
+} audio_drc_t;
+
+/**
+ * @brief Set up a DRC stage
+ * @param drc: Stage to initialize
+ * @param sample_rate: Sample rate in Hz
+ * @param cfg: Settings; NULL for AUDIO_DRC_DEFAULT_CONFIG()
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad parameters
+ */
+esp_err_t audio_drc_init(audio_drc_t *drc, uint32_t sample_rate, const audio_drc_config_t *cfg);
+
+/**
+ * @brief Change settings; the state is reset
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad parameters
+ */
+esp_err_t audio_drc_set_config(audio_drc_t *drc, const audio_drc_config_t *cfg);
+
+/**
+ * @brief Clear the envelopes and the delay line, e.g. before unrelated audio starts
+ */
+void audio_drc_reset(audio_drc_t *drc);
+
+/**
+ * @brief Delay through the stage in frames (0 when disabled)
+ */
+size_t audio_drc_latency_frames(const audio_drc_t *drc);
+
+/**
+ * @brief Process interleaved stereo at int16 scale into int16
+ * When disabled this only rounds and saturates.
+ * @param drc: DRC stage
+ * @param in: Interleaved L/R, full scale +-32768 (may exceed it)
+ * @param out: Interleaved L/R output
+ * @param frames: Number of frames
+ */
+void audio_drc_process(audio_drc_t *drc, const float *in, int16_t *out, size_t frames);
+
+/**
+ * @brief Process interleaved int16 stereo in place
+ */
+void audio_drc_process_s16(audio_drc_t *drc, int16_t *samples, size_t frames);
+
+/**
+ * @brief Total gain change at the end of the last block (compressor, makeup and limiter)
+ * @return Gain in dB; negative while reducing
+ */
+float audio_drc_gain_db(const audio_drc_t *drc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,258 @@
+/**
+ * @file audio_eq.c
+ * @brief Biquad EQ cascade (transposed direct form II) for the playback path
+ *
+ * Coefficients follow the RBJ Audio EQ Cookbook, so REW filter exports can be
+ * entered as bands directly. The ESP32-S3 FPU is scalar, so the cascade is laid
+ * out for it rather than for SIMD: sections run over the whole block two at a
+ * time with coefficients and state held in registers, which keeps four
+ * independent recurrences (two sections x two channels) in flight, and each
+ * update is associated so only one multiply-add waits on the previous output.
+ */
+
+#include "audio_eq.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const audio_eq_band_t s_default_bands[] = {
+    { AUDIO_EQ_HIGHPASS, 90.0f, 0.707f, 0.0f },   // Keep LF out of the small driver
+    { AUDIO_EQ_PEAKING, 320.0f, 1.0f, -4.0f },    // Mid-bass boom
+    { AUDIO_EQ_PEAKING, 500.0f, 1.0f, -2.0f },    // Boxiness
+};
+#define DEFAULT_GAIN_DB 0.0f                      // Peaks are left to the limiter (audio_drc.c)
+
+static void design(const audio_eq_band_t *band, uint32_t sample_rate, audio_eq_coeffs_t *c)
+{
+    if (band->freq_hz <= 0.0f || band->freq_hz >= sample_rate / 2.0f || band->q <= 0.0f) {
+        *c = (audio_eq_coeffs_t){ .b0 = 1.0f };
+        return;
+    }
+    double w0 = 2.0 * M_PI * band->freq_hz / sample_rate;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2.0 * band->q);
+    double a = pow(10.0, band->gain_db / 40.0);
+    double sa = 2.0 * sqrt(a) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band->type) {
+        case AUDIO_EQ_HIGHPASS:
+            b0 = (1.0 + cw) / 2.0;
+            b1 = -(1.0 + cw);
+            b2 = b0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cw;
+            a2 = 1.0 - alpha;
+            break;
+        case AUDIO_EQ_LOWPASS:
+            b0 = (1.0 - cw) / 2.0;
+            b1 = 1.0 - cw;
+            b2 = b0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cw;
+            a2 = 1.0 - alpha;
+            break;
+        case AUDIO_EQ_LOWSHELF:
+            b0 = a * ((a + 1.0) - (a - 1.0) * cw + sa);
+            b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cw);
+            b2 = a * ((a + 1.0) - (a - 1.0) * cw - sa);
+            a0 = (a + 1.0) + (a - 1.0) * cw + sa;
+            a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cw);
+            a2 = (a + 1.0) + (a - 1.0) * cw - sa;
+            break;
+        case AUDIO_EQ_HIGHSHELF:
+            b0 = a * ((a + 1.0) + (a - 1.0) * cw + sa);
+            b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cw);
+            b2 = a * ((a + 1.0) + (a - 1.0) * cw - sa);
+            a0 = (a + 1.0) - (a - 1.0) * cw + sa;
+            a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cw);
+            a2 = (a + 1.0) - (a - 1.0) * cw - sa;
+            break;
+        case AUDIO_EQ_PEAKING:
+        default:
+            b0 = 1.0 + alpha * a;
+            b1 = -2.0 * cw;
+            b2 = 1.0 - alpha * a;
+            a0 = 1.0 + alpha / a;
+            a1 = -2.0 * cw;
+            a2 = 1.0 - alpha / a;
+            break;
+    }
+    c->b0 = (float)(b0 / a0);
+    c->b1 = (float)(b1 / a0);
+    c->b2 = (float)(b2 / a0);
+    c->a1 = (float)(a1 / a0);
+    c->a2 = (float)(a2 / a0);
+}
+
+esp_err_t audio_eq_init(audio_eq_t *eq, uint32_t sample_rate, const audio_eq_band_t *bands, size_t num_bands,
+                        float gain_db)
+{
+    if (!eq || sample_rate == 0 || num_bands > AUDIO_EQ_MAX_SECTIONS || (num_bands > 0 && !bands)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(eq, 0, sizeof(*eq));
+    if (num_bands > 0) {
+        memcpy(eq->bands, bands, num_bands * sizeof(bands[0]));
+    }
+    eq->num_sections = num_bands;
+    eq->gain = powf(10.0f, gain_db / 20.0f);
+    eq->enabled = true;
+    return audio_eq_set_sample_rate(eq, sample_rate);
+}
+
+esp_err_t audio_eq_init_default(audio_eq_t *eq, uint32_t sample_rate)
+{
+    return audio_eq_init(eq, sample_rate, s_default_bands, sizeof(s_default_bands) / sizeof(s_default_bands[0]),
+                         DEFAULT_GAIN_DB);
+}
+
+esp_err_t audio_eq_set_sample_rate(audio_eq_t *eq, uint32_t sample_rate)
+{
+    if (!eq || sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    eq->sample_rate = sample_rate;
+    for (size_t i = 0; i < eq->num_sections; i++) {
+        design(&eq->bands[i], sample_rate, &eq->coeffs[i]);
+    }
+    audio_eq_reset(eq);
+    return ESP_OK;
+}
+
+void audio_eq_reset(audio_eq_t *eq)
+{
+    if (eq) {
+        memset(eq->state, 0, sizeof(eq->state));
+    }
+}
+
+// One section over a stereo block, in place
+static void run_section(const audio_eq_coeffs_t *c, float *z, float *x, size_t frames)
+{
+    const float b0 = c->b0, b1 = c->b1, b2 = c->b2, a1 = c->a1, a2 = c->a2;
+    float z1l = z[0], z2l = z[1], z1r = z[2], z2r = z[3];
+    for (size_t i = 0; i < frames; i++) {
+        float xl = x[2 * i];
+        float xr = x[2 * i + 1];
+        float yl = b0 * xl + z1l;
+        float yr = b0 * xr + z1r;
+        z1l = (b1 * xl + z2l) - a1 * yl;
+        z1r = (b1 * xr + z2r) - a1 * yr;
+        z2l = b2 * xl - a2 * yl;
+        z2r = b2 * xr - a2 * yr;
+        x[2 * i] = yl;
+        x[2 * i + 1] = yr;
+    }
+    z[0] = z1l;
+    z[1] = z2l;
+    z[2] = z1r;
+    z[3] = z2r;
+}
+
+// Two consecutive sections in one pass: four recurrences in flight instead of two,
+// and half the block loads/stores
+static void run_section_pair(const audio_eq_coeffs_t *c, float (*z)[4], float *x, size_t frames)
+{
+    const float pb0 = c[0].b0, pb1 = c[0].b1, pb2 = c[0].b2, pa1 = c[0].a1, pa2 = c[0].a2;
+    const float qb0 = c[1].b0, qb1 = c[1].b1, qb2 = c[1].b2, qa1 = c[1].a1, qa2 = c[1].a2;
+    float pz1l = z[0][0], pz2l = z[0][1], pz1r = z[0][2], pz2r = z[0][3];
+    float qz1l = z[1][0], qz2l = z[1][1], qz1r = z[1][2], qz2r = z[1][3];
+    for (size_t i = 0; i < frames; i++) {
+        float xl = x[2 * i];
+        float xr = x[2 * i + 1];
+        float ml = pb0 * xl + pz1l;
+        float mr = pb0 * xr + pz1r;
+        pz1l = (pb1 * xl + pz2l) - pa1 * ml;
+        pz1r = (pb1 * xr + pz2r) - pa1 * mr;
+        pz2l = pb2 * xl - pa2 * ml;
+        pz2r = pb2 * xr - pa2 * mr;
+        float yl = qb0 * ml + qz1l;
+        float yr = qb0 * mr + qz1r;
+        qz1l = (qb1 * ml + qz2l) - qa1 * yl;
+        qz1r = (qb1 * mr + qz2r) - qa1 * yr;
+        qz2l = qb2 * ml - qa2 * yl;
+        qz2r = qb2 * mr - qa2 * yr;
+        x[2 * i] = yl;
+        x[2 * i + 1] = yr;
+    }
+    z[0][0] = pz1l;
+    z[0][1] = pz2l;
+    z[0][2] = pz1r;
+    z[0][3] = pz2r;
+    z[1][0] = qz1l;
+    z[1][1] = qz2l;
+    z[1][2] = qz1r;
+    z[1][3] = qz2r;
+}
+
+static void run_cascade(audio_eq_t *eq, float *x, size_t frames)
+{
+    size_t s = 0;
+    for (; s + 1 < eq->num_sections; s += 2) {
+        run_section_pair(&eq->coeffs[s], &eq->state[s], x, frames);
+    }
+    if (s < eq->num_sections) {
+        run_section(&eq->coeffs[s], eq->state[s], x, frames);
+    }
+}
+
+void audio_eq_process_f32(audio_eq_t *eq, float *samples, size_t frames)
+{
+    if (!eq || !eq->enabled || !samples) {
+        return;
+    }
+    run_cascade(eq, samples, frames);
+    const float g = eq->gain;
+    for (size_t i = 0; i < frames * 2; i++) {
+        samples[i] *= g;
+    }
+}
+
+void audio_eq_process_s16(audio_eq_t *eq, int16_t *samples, size_t frames)
+{
+    if (!eq || !eq->enabled || !samples) {
+        return;
+    }
+    float block[AUDIO_EQ_BLOCK_FRAMES * 2];
+    const float g = eq->gain;
+    while (frames > 0) {
+        size_t n = frames < AUDIO_EQ_BLOCK_FRAMES ? frames : AUDIO_EQ_BLOCK_FRAMES;
+        for (size_t i = 0; i < n * 2; i++) {
+            block[i] = samples[i];
+        }
+        run_cascade(eq, block, n);
+        // Gain, clamp and round in one pass; lrintf() is a libcall on this target
+        for (size_t i = 0; i < n * 2; i++) {
+            float v = block[i] * g;
+            v += v < 0.0f ? -0.5f : 0.5f;
+            v = v > 32767.0f ? 32767.0f : v;
+            v = v < -32768.0f ? -32768.0f : v;
+            samples[i] = (int16_t)v;
+        }
+        samples += n * 2;
+        frames -= n;
+    }
+}
+
+float audio_eq_response_db(const audio_eq_t *eq, float freq_hz)
+{
+    if (!eq || eq->sample_rate == 0) {
+        return 0.0f;
+    }
+    double w = 2.0 * M_PI * freq_hz / eq->sample_rate;
+    double db = 20.0 * log10(eq->gain);
+    for (size_t s = 0; s < eq->num_sections; s++) {
+        const audio_eq_coeffs_t *c = &eq->coeffs[s];
+        // |B(e^jw)| / |A(e^jw)| with A = 1 + a1 z^-1 + a2 z^-2
+        double br = c->b0 + c->b1 * cos(w) + c->b2 * cos(2 * w);
+        double bi = -(c->b1 * sin(w) + c->b2 * sin(2 * w));
+        double ar = 1.0 + c->a1 * cos(w) + c->a2 * cos(2 * w);
+        double ai = -(c->a1 * sin(w) + c->a2 * sin(2 * w));
+        db += 10.0 * log10((br * br + bi * bi) / (ar * ar + ai * ai));
+    }
+    return (float)db;
+}
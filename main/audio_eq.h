@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_EQ_MAX_SECTIONS 8
+#define AUDIO_EQ_BLOCK_FRAMES 256  // Frames converted to float per pass
+
+typedef enum {
+    AUDIO_EQ_HIGHPASS = 0,
+    AUDIO_EQ_LOWPASS,
+    AUDIO_EQ_PEAKING,
+    AUDIO_EQ_LOWSHELF,
+    AUDIO_EQ_HIGHSHELF,
+} audio_eq_filter_type_t;
+
+/**
+ * One biquad section as designed (RBJ cookbook)
+ */
+typedef struct {
+    audio_eq_filter_type_t type;
+    float freq_hz;
+    float q;
+    float gain_db;  // Peaking and shelf only
+} audio_eq_band_t;
+
+typedef struct {
+    float b0, b1, b2, a1, a2;  // Normalized so a0 == 1
+} audio_eq_coeffs_t;
+
+/**
+ * Stereo biquad cascade, transposed direct form II
+ *
+ * Coefficients are shared by both channels; each section keeps two state words
+ * per channel.
+ */
+typedef struct {
+    audio_eq_band_t bands[AUDIO_EQ_MAX_SECTIONS];
+    audio_eq_coeffs_t coeffs[AUDIO_EQ_MAX_SECTIONS];
+    float state[AUDIO_EQ_MAX_SECTIONS][4];  // z1 L, z2 L, z1 R, z2 R
+    size_t num_sections;
+    float gain;                             // Linear output gain
+    uint32_t sample_rate;
+    bool enabled;
+} audio_eq_t;
+
+/**
+ * @brief Set up a cascade and compute its coefficients
+ * @param eq: EQ to initialize
+ * @param sample_rate: Sample rate in Hz
+ * @param bands: Sections in processing order
+ * @param num_bands: Number of sections, at most AUDIO_EQ_MAX_SECTIONS
+ * @param gain_db: Gain applied after the last section
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad parameters
+ */
+esp_err_t audio_eq_init(audio_eq_t *eq, uint32_t sample_rate, const audio_eq_band_t *bands, size_t num_bands,
+                        float gain_db);
+
+/**
+ * @brief Naphome v0.1 speaker tuning: HPF 90 Hz, -4 dB @ 320 Hz, -2 dB @ 500 Hz, 0 dB gain
+ */
+esp_err_t audio_eq_init_default(audio_eq_t *eq, uint32_t sample_rate);
+
+/**
+ * @brief Recompute coefficients for a new sample rate and clear the state
+ * Sections whose frequency is at or above Nyquist are passed through.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a zero rate
+ */
+esp_err_t audio_eq_set_sample_rate(audio_eq_t *eq, uint32_t sample_rate);
+
+/**
+ * @brief Clear the filter state, e.g. before unrelated audio starts
+ */
+void audio_eq_reset(audio_eq_t *eq);
+
+/**
+ * @brief Filter interleaved stereo in place, saturating to int16
+ * Does nothing when the EQ is disabled.
+ * @param eq: EQ
+ * @param samples: Interleaved L/R samples
+ * @param frames: Number of frames
+ */
+void audio_eq_process_s16(audio_eq_t *eq, int16_t *samples, size_t frames);
+
+/**
+ * @brief Filter interleaved stereo float in place (no output gain clamp)
+ */
+void audio_eq_process_f32(audio_eq_t *eq, float *samples, size_t frames);
+
+/**
+ * @brief Magnitude response of the whole cascade including output gain
+ * @param eq: EQ
+ * @param freq_hz: Frequency to evaluate
+ * @return Gain in dB
+ */
+float audio_eq_response_db(const audio_eq_t *eq, float freq_hz);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,11 +1,17 @@
 /**
  * @file audio_file_manager.c
- * @brief Audio file manager for MP3 playback
+ * @brief Audio file manager for MP3 and WAV playback
  */
 
 #include "audio_file_manager.h"
 #include "audio_player.h"
-#include "mp3_decoder.h"
+#include "audio_telemetry.h"
+#include "mp3_index.h"
+#include "mp3_pipeline.h"
+#include "sd_cache.h"
+#include "track_catalog.h"
+#include "track_search.h"
+#include "wav_source.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_check.h"
@@ -17,48 +23,160 @@
 #include "sdmmc_cmd.h"
 #include "esp_task_wdt.h"
 #include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
 #include <string.h>
 #include <stdlib.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <limits.h>
-#include <ctype.h>
 #include <errno.h>
+#include <inttypes.h>
 
 static const char *TAG = "audio_file_mgr";
 
-// Maximum number of audio files
-#define MAX_AUDIO_FILES 200
+#ifndef CONFIG_AUDIO_MP3_DECODER_PRIORITY
+#define CONFIG_AUDIO_MP3_DECODER_PRIORITY 6
+#endif
 
-// Audio file registry
-typedef struct {
-    char name[128];           // File name without extension
-    char display_name[128];   // Display name for UI
-    char file_path[256];      // Full file path
-    size_t file_size;         // File size in bytes
-    bool available;           // Whether file is available
-} audio_file_entry_t;
-
-static audio_file_entry_t s_audio_files[MAX_AUDIO_FILES];
-static size_t s_file_count = 0;
+#ifndef CONFIG_AUDIO_MP3_READER_PRIORITY
+#define CONFIG_AUDIO_MP3_READER_PRIORITY 7
+#endif
+
+#ifndef CONFIG_AUDIO_SD_CACHE_KB
+#define CONFIG_AUDIO_SD_CACHE_KB 1024
+#endif
+
+#ifndef CONFIG_AUDIO_SD_CACHE_BLOCK_KB
+#define CONFIG_AUDIO_SD_CACHE_BLOCK_KB 16
+#endif
+
+#ifndef CONFIG_AUDIO_SD_CACHE_LEAD_MS
+#define CONFIG_AUDIO_SD_CACHE_LEAD_MS 8000
+#endif
+
+#ifndef CONFIG_AUDIO_SD_PREFETCH_SEC
+#define CONFIG_AUDIO_SD_PREFETCH_SEC 10
+#endif
+
+// Bitrate assumed for a track not indexed yet when sizing its prefetch
+#define PREFETCH_DEFAULT_KBPS 192
+
+// Track library catalog, kept in the sounds directory (an 8.3 name)
+#define CATALOG_FILE "catalog.bin"
+
+// Resume point: track and position, kept across reboots
+#define RESUME_NVS_NAMESPACE    "audio_resume"
+#define RESUME_SAVE_INTERVAL_US (60 * 1000000LL)  // Also saved on stop; a power cut loses at most this
+
+// Keeps the catalog in step with the files in the background, while nothing plays
+#define INDEXER_PRIORITY 1
+#define INDEXER_STACK    4096
+
+// Track library: loaded from the catalog file at boot, then kept current by uploads and
+// the indexer. The lock guards it; the strings it hands out stay valid until reboot.
+static track_catalog_t s_catalog;
+static SemaphoreHandle_t s_catalog_lock = NULL;
+static char s_sounds_dir[32] = {0};
+static char s_catalog_path[48] = {0};  // Empty without a sounds directory: nothing is saved
+static bool s_rescan = false;          // Catalog came from the file: look for new files in the background
+static bool s_index_again = false;     // Tracks were added while the indexer was running
+static track_search_t s_search;        // Fuzzy name index over the catalog, under s_catalog_lock
+static bool s_search_stale = true;     // Tracks were added or removed since it was built
 static bool s_initialized = false;
-static bool s_playing = false;
-static char s_current_playing[128] = {0};
 
-// MP3 playback task
-static TaskHandle_t s_playback_task = NULL;
+// A track played over another, or queued after it, crossfades in over this time; 0
+// plays queued tracks back to back with no gap
+#ifndef CONFIG_AUDIO_CROSSFADE_MS
+#define CONFIG_AUDIO_CROSSFADE_MS 3000
+#endif
+
+#define PLAY_QUEUE_LEN       8
+#define NEXT_PRELOAD_MS      3000   // The next track starts decoding this long before its crossfade
+#define FADE_IN_BUFFER_MS    300    // A track played over another fades in once this much is queued
+#define FADE_STOP_MARGIN_US  (200 * 1000LL)  // A faded-out deck is stopped this long after its fade
+#define CUE_WAIT_TICKS       pdMS_TO_TICKS(100)
+#define DECK_STOP_TIMEOUT    pdMS_TO_TICKS(10000)
+#define DECK_STACK           8192
 
-// Playback parameters
+// Why playback ended
+typedef enum {
+    PLAYBACK_END_OF_FILE,
+    PLAYBACK_DURATION,    // The duration limit was reached first
+    PLAYBACK_STOPPED,
+    PLAYBACK_FAILED,      // Could not be opened; nothing was played
+} playback_end_t;
+
+// A track waiting in the play queue
 typedef struct {
-    char *file_path;
+    char name[128];
     int duration_seconds;  // -1 for full file
-} playback_params_t;
+} play_item_t;
+
+// Tracks play on two media decks, each a task decoding onto its own mixer stream. The
+// next track is decoded into the idle deck, held silent, and crossfaded in; with no
+// crossfade it is queued on the same deck right behind the last sample of the current one.
+typedef struct {
+    audio_stream_t stream;
+    SemaphoreHandle_t done;          // Given while the deck has no task
+    volatile bool running;           // Cleared to stop it; the pipeline's keep_running
+    char name[128];                  // Track it plays
+    char path[256];
+    int duration_seconds;            // -1 for full file
+    uint32_t start_ms;
+    // Position of its track: start point plus audio queued, less what is still buffered
+    volatile uint32_t pos_start_ms;
+    volatile uint32_t queued_ms;
+    volatile uint32_t duration_ms;
+    uint32_t end_ms;                 // queued_ms at which the track ends, 0 if not known
+    int64_t last_save_us;
+    bool heard;                      // Released to the mixer; a stop leaves a resume point
+    uint32_t fade_in_ms;             // Held over the other deck until buffered, then crossfaded in
+    int64_t stop_at_us;              // Fading out: stopped at this time
+    bool next_started;               // The other deck holds the next queued track
+    bool cue_queued;                 // The crossfade to it is queued behind this track
+} deck_t;
+
+static deck_t s_decks[2] = {
+    { .stream = AUDIO_STREAM_MEDIA },
+    { .stream = AUDIO_STREAM_MEDIA_ALT },
+};
+static deck_t *volatile s_current = NULL;  // Deck heard, or about to be
+static SemaphoreHandle_t s_player_lock = NULL;  // Serializes deck changes; deck tasks only try it
+static play_item_t s_queue[PLAY_QUEUE_LEN];
+static size_t s_queue_head = 0;
+static size_t s_queue_count = 0;
+static SemaphoreHandle_t s_queue_lock = NULL;
+
+static TaskHandle_t s_indexer_task = NULL;
 
 // Forward declarations
-static void mp3_playback_task(void *arg);
-static esp_err_t load_mp3_file_list(void);
-static const char *get_display_name(const char *filename);
+static void deck_task(void *arg);
+static esp_err_t load_catalog(void);
+static void make_display_name(const char *filename, char *display, size_t len);
+static void start_indexer(void);
+static track_search_t *search_index(void);
+
+static void catalog_lock(void)
+{
+    xSemaphoreTake(s_catalog_lock, portMAX_DELAY);
+}
+
+static void catalog_unlock(void)
+{
+    xSemaphoreGive(s_catalog_lock);
+}
+
+#if CONFIG_AUDIO_SD_CACHE_KB > 0
+// The cache's I/O task is the only one on the card; playback readers only copy
+static void on_sd_block_read(uint32_t us, size_t bytes, void *arg)
+{
+    (void)bytes;
+    (void)arg;
+    audio_telemetry_record(AUDIO_TELEMETRY_SD_READ, us);
+}
+#endif
 
 esp_err_t audio_file_manager_init(void)
 {
@@ -68,20 +186,56 @@ esp_err_t audio_file_manager_init(void)
 
     ESP_LOGI(TAG, "Initializing audio file manager...");
     
-    memset(s_audio_files, 0, sizeof(s_audio_files));
-    s_file_count = 0;
-    s_playing = false;
-    memset(s_current_playing, 0, sizeof(s_current_playing));
+    s_catalog_lock = xSemaphoreCreateMutex();
+    if (!s_catalog_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    track_catalog_init(&s_catalog);
+    track_search_init(&s_search);
+    s_player_lock = xSemaphoreCreateMutex();
+    s_queue_lock = xSemaphoreCreateMutex();
+    if (!s_player_lock || !s_queue_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < 2; i++) {
+        s_decks[i].done = xSemaphoreCreateBinary();
+        if (!s_decks[i].done) {
+            return ESP_ERR_NO_MEM;
+        }
+        xSemaphoreGive(s_decks[i].done);
+    }
 
-    // Load MP3 file list
-    esp_err_t ret = load_mp3_file_list();
+    // Load the track catalog
+    esp_err_t ret = load_catalog();
     if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to load MP3 file list: %s", esp_err_to_name(ret));
+        ESP_LOGW(TAG, "Failed to load the track catalog: %s", esp_err_to_name(ret));
         // Continue anyway - files might be added later
     }
+    catalog_lock();
+    search_index();
+    catalog_unlock();
+
+#if CONFIG_AUDIO_SD_CACHE_KB > 0
+    // Track reads go through the block cache; the reader task of the MP3 pipeline
+    // then only copies, and the cache's own I/O task takes its place on the card
+    sd_cache_config_t cache_config = SD_CACHE_DEFAULT_CONFIG();
+    cache_config.block_size = CONFIG_AUDIO_SD_CACHE_BLOCK_KB * 1024;
+    cache_config.cache_size = CONFIG_AUDIO_SD_CACHE_KB * 1024;
+    cache_config.lead_ms = CONFIG_AUDIO_SD_CACHE_LEAD_MS;
+    cache_config.task_priority = CONFIG_AUDIO_MP3_READER_PRIORITY;
+    // Of the SD mount's 5 handles: two decks crossfading and the next track's prefetch,
+    // leaving two for indexing, catalog saves and uploads
+    cache_config.max_open = 3;
+    cache_config.read_cb = on_sd_block_read;
+    ret = sd_cache_init(&cache_config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "SD cache unavailable (%s), reading files directly", esp_err_to_name(ret));
+    }
+#endif
 
     s_initialized = true;
-    ESP_LOGI(TAG, "Audio file manager initialized with %zu files", s_file_count);
+    ESP_LOGI(TAG, "Audio file manager initialized with %" PRIu32 " files", s_catalog.count);
+    start_indexer();
     return ESP_OK;
 }
 
@@ -136,150 +290,115 @@ static const char* s_mp3_file_names[] = {
 };
 #define MP3_FILE_COUNT (sizeof(s_mp3_file_names) / sizeof(s_mp3_file_names[0]))
 
-static esp_err_t load_mp3_file_list(void)
+static bool is_audio_file(const char *name)
+{
+    // MP3 is decoded; WAV is streamed as is
+    size_t len = strlen(name);
+    return len > 4 && (strcasecmp(name + len - 4, ".mp3") == 0 || strcasecmp(name + len - 4, ".wav") == 0);
+}
+
+static void load_static_list(void)
+{
+    // Set default path (most likely location) - DON'T check existence during init
+    // File availability will be checked lazily when the file is actually requested
+    for (size_t i = 0; i < MP3_FILE_COUNT; i++) {
+        char file[136];
+        char display[128];
+        snprintf(file, sizeof(file), "%s.mp3", s_mp3_file_names[i]);
+        make_display_name(s_mp3_file_names[i], display, sizeof(display));
+        track_catalog_add(&s_catalog, "/sdcard/sounds", file, display, NULL);
+    }
+    ESP_LOGI(TAG, "Loaded %" PRIu32 " files from static list", s_catalog.count);
+}
+
+// Add the MP3 and WAV files of a directory that the catalog does not know yet
+static esp_err_t scan_sounds_dir(const char *sounds_dir, bool feed_wdt)
 {
-    // Try SD card first (primary storage for MP3 files)
-    const char *sounds_dir = "/sdcard/sounds";
     DIR *dir = opendir(sounds_dir);
-    
-    // Fallback to SD card root
     if (!dir) {
-        sounds_dir = "/sdcard";
-        dir = opendir(sounds_dir);
+        return ESP_ERR_NOT_FOUND;
     }
-    
-    // Fallback to SPIFFS
-    if (!dir) {
-        sounds_dir = "/spiffs/sounds";
-        dir = opendir(sounds_dir);
+    uint32_t added = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_type != DT_REG || !is_audio_file(entry->d_name)) {
+            continue;
+        }
+        char name[128];
+        char display[128];
+        size_t name_len = strlen(entry->d_name) - 4;
+        if (name_len >= sizeof(name)) {
+            continue;
+        }
+        memcpy(name, entry->d_name, name_len);
+        name[name_len] = '\0';
+        make_display_name(name, display, sizeof(display));
+
+        catalog_lock();
+        if (track_catalog_find(&s_catalog, name) == TRACK_CATALOG_NONE &&
+            track_catalog_add(&s_catalog, sounds_dir, entry->d_name, display, NULL) == ESP_OK) {
+            added++;
+            s_search_stale = true;
+        }
+        catalog_unlock();
+
+        // Feed watchdog every 20 files to prevent timeout during scanning
+        if (feed_wdt && added % 20 == 0) {
+            esp_task_wdt_reset();
+        }
     }
-    
-    // Fallback to generic sounds directory
-    if (!dir) {
-        sounds_dir = "/sounds";
-        dir = opendir(sounds_dir);
+    closedir(dir);
+    if (added > 0) {
+        ESP_LOGI(TAG, "Added %" PRIu32 " tracks from %s", added, sounds_dir);
     }
-    
-    bool use_static_list = false;
-    if (!dir) {
+    return ESP_OK;
+}
+
+static esp_err_t load_catalog(void)
+{
+    // SD card sounds directory (preferred), SD card root, SPIFFS, generic sounds directory
+    static const char *dirs[] = { "/sdcard/sounds", "/sdcard", "/spiffs/sounds", "/sounds" };
+    const char *sounds_dir = NULL;
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]) && !sounds_dir; i++) {
+        DIR *dir = opendir(dirs[i]);
+        if (dir) {
+            closedir(dir);
+            sounds_dir = dirs[i];
+        }
+    }
+    if (!sounds_dir) {
         ESP_LOGW(TAG, "Sounds directory not found, using static file list (%d files)", MP3_FILE_COUNT);
-        use_static_list = true;
+        load_static_list();
+        return ESP_OK;
     }
+    snprintf(s_sounds_dir, sizeof(s_sounds_dir), "%s", sounds_dir);
+    snprintf(s_catalog_path, sizeof(s_catalog_path), "%s/%s", sounds_dir, CATALOG_FILE);
 
-    if (use_static_list) {
-        // Use static list of known files - they may be in SPIFFS or SD card
-        // Feed watchdog periodically during file scanning
-        for (size_t i = 0; i < MP3_FILE_COUNT && s_file_count < MAX_AUDIO_FILES; i++) {
-            // Feed watchdog every 10 files to prevent timeout during scanning
-            if (i % 10 == 0) {
-                esp_task_wdt_reset();
-            }
-            
-            audio_file_entry_t *file = &s_audio_files[s_file_count];
-            const char *name = s_mp3_file_names[i];
-            
-            strncpy(file->name, name, sizeof(file->name) - 1);
-            file->name[sizeof(file->name) - 1] = '\0';
-            
-            // Get display name
-            const char *display = get_display_name(file->name);
-            strncpy(file->display_name, display, sizeof(file->display_name) - 1);
-            file->display_name[sizeof(file->display_name) - 1] = '\0';
-            
-            // Try to find file in multiple locations (SD card first, then SPIFFS)
-            const char *search_paths[] = {
-                "/sdcard/sounds/%s.mp3",      // SD card sounds directory (preferred)
-                "/sdcard/%s.mp3",             // SD card root
-                "/spiffs/sounds/%s.mp3",      // SPIFFS sounds directory
-                "/spiffs/%s.mp3",             // SPIFFS root
-                "/sounds/%s.mp3",            // Generic sounds directory
-                NULL
-            };
-            
-            file->available = false;
-            file->file_size = 0;
-            
-            // Use temporary buffer to avoid restrict warning (file->name is in same struct)
-            char temp_name[128];
-            strncpy(temp_name, file->name, sizeof(temp_name) - 1);
-            temp_name[sizeof(temp_name) - 1] = '\0';
-            
-            // Set default path (most likely location) - DON'T check existence during init
-            // File availability will be checked lazily when the file is actually requested
-            // This speeds up initialization significantly (no stat() calls on slow SD card)
-            snprintf(file->file_path, sizeof(file->file_path), "/sdcard/sounds/%s.mp3", temp_name);
-            file->available = false;  // Will be checked when file is requested
-            file->file_size = 0;
-            
-            s_file_count++;
-        }
-        size_t available_count = 0;
-        for (size_t i = 0; i < s_file_count; i++) {
-            if (s_audio_files[i].available) available_count++;
-        }
-        ESP_LOGI(TAG, "Loaded %zu files from static list (%zu available)", s_file_count, available_count);
+    // One file read, however many tracks: the directory is listed later, in the background
+    int64_t start = esp_timer_get_time();
+    if (track_catalog_load(&s_catalog, s_catalog_path) == ESP_OK) {
+        s_rescan = true;
+        ESP_LOGI(TAG, "Catalog loaded in %" PRId64 " ms", (esp_timer_get_time() - start) / 1000);
         return ESP_OK;
     }
 
-    // Scan directory for MP3 files
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL && s_file_count < MAX_AUDIO_FILES) {
-        if (entry->d_type == DT_REG) {
-            const char *name = entry->d_name;
-            size_t name_len = strlen(name);
-            
-            // Check if it's an MP3 file
-            if (name_len > 4 && strcasecmp(name + name_len - 4, ".mp3") == 0) {
-                audio_file_entry_t *file = &s_audio_files[s_file_count];
-                
-                // Store name without extension
-                strncpy(file->name, name, name_len - 4);
-                file->name[name_len - 4] = '\0';
-                
-                // Get display name
-                const char *display = get_display_name(file->name);
-                strncpy(file->display_name, display, sizeof(file->display_name) - 1);
-                file->display_name[sizeof(file->display_name) - 1] = '\0';
-                
-                // Build file path (use temporary buffer to avoid restrict warning)
-                char temp_name[128];
-                strncpy(temp_name, file->name, sizeof(temp_name) - 1);
-                temp_name[sizeof(temp_name) - 1] = '\0';
-                char temp_path[256];
-                snprintf(temp_path, sizeof(temp_path), "%s/%s.mp3", sounds_dir, temp_name);
-                strncpy(file->file_path, temp_path, sizeof(file->file_path) - 1);
-                file->file_path[sizeof(file->file_path) - 1] = '\0';
-                
-                // Mark as available (we found it in the directory, so it exists)
-                // Skip stat() call during init to speed up initialization - we'll get file size when needed
-                file->available = true;
-                file->file_size = 0;  // Will be populated lazily when needed
-                
-                s_file_count++;
-                
-                // Feed watchdog every 20 files to prevent timeout during scanning
-                if (s_file_count % 20 == 0) {
-                    esp_task_wdt_reset();
-                }
-            }
-        }
+    // First boot, or the catalog was lost: list the directory now and keep the result
+    esp_err_t err = scan_sounds_dir(sounds_dir, true);
+    if (err == ESP_OK) {
+        track_catalog_save(&s_catalog, s_catalog_path);
     }
-    
-    closedir(dir);
-    return ESP_OK;
+    return err;
 }
 
 // Convert filename to display name (remove underscores, capitalize, etc.)
-static const char *get_display_name(const char *filename)
+static void make_display_name(const char *filename, char *display, size_t len)
 {
-    static char display[128];
-    size_t len = strlen(filename);
     size_t j = 0;
     bool capitalize_next = true;
-    
-    for (size_t i = 0; i < len && j < sizeof(display) - 1; i++) {
+
+    for (size_t i = 0; filename[i] && j < len - 1; i++) {
         char c = filename[i];
-        
+
         if (c == '_') {
             display[j++] = ' ';
             capitalize_next = true;
@@ -291,445 +410,350 @@ static const char *get_display_name(const char *filename)
             capitalize_next = false;
         }
     }
-    
+
     display[j] = '\0';
-    return display;
 }
 
 size_t audio_file_manager_get_count(void)
 {
-    return s_file_count;
+    return s_catalog.count;
 }
 
-esp_err_t audio_file_manager_get_by_index(size_t index, audio_file_info_t *info)
+static const char *track_name(uint32_t index)
 {
-    if (!info || index >= s_file_count) {
-        return ESP_ERR_INVALID_ARG;
-    }
+    return track_catalog_str(&s_catalog, s_catalog.entries[index].name);
+}
 
-    audio_file_entry_t *file = &s_audio_files[index];
-    info->name = file->name;
-    info->display_name = file->display_name;
+// Caller holds the catalog lock
+static void fill_info(uint32_t index, audio_file_info_t *info)
+{
+    const track_catalog_entry_t *file = &s_catalog.entries[index];
+    info->name = track_catalog_str(&s_catalog, file->name);
+    info->display_name = track_catalog_str(&s_catalog, file->display_name);
     info->data = NULL;  // Files are loaded on demand
     info->data_len = file->file_size;
-    
-    return ESP_OK;
+    info->duration_ms = file->duration_ms;
+    info->sample_rate = file->sample_rate;
+    info->bitrate_kbps = file->bitrate_kbps;
+    info->replay_gain = file->replay_gain;
 }
 
-esp_err_t audio_file_manager_get_by_name(const char *name, audio_file_info_t *info)
+esp_err_t audio_file_manager_get_by_index(size_t index, audio_file_info_t *info)
 {
-    if (!name || !info) {
+    if (!info || !s_catalog_lock) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Remove .mp3 extension if present
+    catalog_lock();
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (index < s_catalog.count) {
+        fill_info((uint32_t)index, info);
+        err = ESP_OK;
+    }
+    catalog_unlock();
+    return err;
+}
+
+// Catalog index of a track, or TRACK_CATALOG_NONE; caller holds the catalog lock
+static uint32_t find_track(const char *name)
+{
+    // Remove .mp3 or .wav extension if present
     char clean_name[128];
     strncpy(clean_name, name, sizeof(clean_name) - 1);
+    clean_name[sizeof(clean_name) - 1] = '\0';
     size_t len = strlen(clean_name);
-    if (len > 4 && strcasecmp(clean_name + len - 4, ".mp3") == 0) {
+    if (len > 4 && (strcasecmp(clean_name + len - 4, ".mp3") == 0 ||
+                    strcasecmp(clean_name + len - 4, ".wav") == 0)) {
         clean_name[len - 4] = '\0';
     }
 
-    // First try exact match (case-insensitive)
-    for (size_t i = 0; i < s_file_count; i++) {
-        if (strcasecmp(s_audio_files[i].name, clean_name) == 0) {
-            audio_file_entry_t *file = &s_audio_files[i];
-            info->name = file->name;
-            info->display_name = file->display_name;
-            info->data = NULL;
-            info->data_len = file->file_size;
-            return ESP_OK;
-        }
+    // First try exact match (case-insensitive): one hash lookup
+    uint32_t index = track_catalog_find(&s_catalog, clean_name);
+    if (index != TRACK_CATALOG_NONE) {
+        return index;
     }
-    
-    // If exact match fails, try fuzzy matching for 8.3 filenames
-    // Check if the stored name starts with the search name (handles "CHANTS~1" matching "chants_thirdeyechakra")
-    // Also check if search name contains key parts that might match
-    char search_upper[128];
-    strncpy(search_upper, clean_name, sizeof(search_upper) - 1);
-    search_upper[sizeof(search_upper) - 1] = '\0';
-    for (size_t i = 0; search_upper[i]; i++) {
-        search_upper[i] = toupper(search_upper[i]);
+
+    // Otherwise the best fuzzy match, if it is a good one: "CHANTS~1" for
+    // "chants_thirdeyechakra", "paris_rain_sleep" for "paris rain"
+    track_search_t *search = search_index();
+    track_search_hit_t hit;
+    if (search && track_search_query(search, clean_name, &hit, 1) == 1 && hit.score >= AUDIO_FILE_MATCH_MIN_SCORE) {
+        ESP_LOGW(TAG, "Fuzzy match: '%s' matched '%s' (%u)", clean_name, track_name(hit.index), hit.score);
+        return hit.index;
     }
-    
-    // Extract key parts from search name (e.g., "chants_thirdeyechakra" -> "chants" and "thirdeye")
-    char key_part1[32] = {0};
-    char key_part2[32] = {0};
-    const char *underscore = strchr(clean_name, '_');
-    if (underscore) {
-        size_t part1_len = underscore - clean_name;
-        if (part1_len < sizeof(key_part1)) {
-            strncpy(key_part1, clean_name, part1_len);
-            key_part1[part1_len] = '\0';
-            for (size_t i = 0; key_part1[i]; i++) {
-                key_part1[i] = toupper(key_part1[i]);
-            }
-        }
-        strncpy(key_part2, underscore + 1, sizeof(key_part2) - 1);
-        key_part2[sizeof(key_part2) - 1] = '\0';
-        for (size_t i = 0; key_part2[i]; i++) {
-            key_part2[i] = toupper(key_part2[i]);
-        }
+    return TRACK_CATALOG_NONE;
+}
+
+esp_err_t audio_file_manager_get_by_name(const char *name, audio_file_info_t *info)
+{
+    if (!name || !info || !s_catalog_lock) {
+        return ESP_ERR_INVALID_ARG;
     }
-    
-    for (size_t i = 0; i < s_file_count; i++) {
-        char stored_upper[128];
-        strncpy(stored_upper, s_audio_files[i].name, sizeof(stored_upper) - 1);
-        stored_upper[sizeof(stored_upper) - 1] = '\0';
-        for (size_t j = 0; stored_upper[j]; j++) {
-            stored_upper[j] = toupper(stored_upper[j]);
-        }
-        
-        // Check if stored name starts with search name (handles "CHANTS~1" for "chants_thirdeyechakra")
-        if (strncmp(stored_upper, search_upper, strlen(search_upper)) == 0) {
-            audio_file_entry_t *file = &s_audio_files[i];
-            info->name = file->name;
-            info->display_name = file->display_name;
-            info->data = NULL;
-            info->data_len = file->file_size;
-            ESP_LOGW(TAG, "Fuzzy match: '%s' matched '%s'", clean_name, file->name);
-            return ESP_OK;
-        }
-        
-        // Check if stored name contains key parts (e.g., "CHANTS~1" contains "CHANTS")
-        if (key_part1[0] && strstr(stored_upper, key_part1) != NULL) {
-            // Also check if it might be the right file by checking for other key parts
-            // For "chants_thirdeyechakra", look for files starting with "CHANTS" that might be it
-            if (strncmp(stored_upper, key_part1, strlen(key_part1)) == 0) {
-                audio_file_entry_t *file = &s_audio_files[i];
-                info->name = file->name;
-                info->display_name = file->display_name;
-                info->data = NULL;
-                info->data_len = file->file_size;
-                ESP_LOGW(TAG, "Fuzzy match (key part): '%s' matched '%s'", clean_name, file->name);
-                return ESP_OK;
-            }
-        }
+
+    catalog_lock();
+    uint32_t index = find_track(name);
+    if (index != TRACK_CATALOG_NONE) {
+        fill_info(index, info);
     }
-    
-    return ESP_ERR_NOT_FOUND;
+    catalog_unlock();
+    return index != TRACK_CATALOG_NONE ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
 
-// MP3 playback task
-static void mp3_playback_task(void *arg)
+// The name index, rebuilt first if tracks came or went; NULL if it cannot be built.
+// Caller holds the catalog lock.
+static track_search_t *search_index(void)
 {
-    playback_params_t *params = (playback_params_t *)arg;
-    if (!params || !params->file_path) {
-        if (params) {
-            free(params->file_path);
-            free(params);
+    if (s_search_stale) {
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = track_search_build(&s_search, &s_catalog);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to index track names: %s", esp_err_to_name(err));
+            return NULL;
         }
-        vTaskDelete(NULL);
-        return;
+        s_search_stale = false;
+        ESP_LOGI(TAG, "Indexed %" PRIu32 " track names in %" PRId64 " us", s_catalog.count,
+                 esp_timer_get_time() - start);
     }
+    return &s_search;
+}
 
-    char *file_path = params->file_path;
-    int duration_seconds = params->duration_seconds;
-    
-    ESP_LOGI(TAG, "Starting MP3 playback: %s (duration: %d seconds)", file_path, duration_seconds);
-
-    // Track playback time for duration limiting
-    int64_t start_time_us = esp_timer_get_time();
-    int64_t duration_us = (duration_seconds > 0) ? (duration_seconds * 1000000LL) : INT64_MAX;
+size_t audio_file_manager_search(const char *query, audio_file_match_t *matches, size_t max_matches)
+{
+    if (!query || !matches || max_matches == 0 || !s_catalog_lock) {
+        return 0;
+    }
+    track_search_hit_t hits[AUDIO_FILE_SEARCH_MAX];
+    if (max_matches > AUDIO_FILE_SEARCH_MAX) {
+        max_matches = AUDIO_FILE_SEARCH_MAX;
+    }
 
-    // Open file
-    ESP_LOGI(TAG, "Opening file: %s", file_path);
-    FILE *fp = fopen(file_path, "rb");
-    if (!fp) {
-        ESP_LOGE(TAG, "Failed to open file: %s (errno: %d)", file_path, errno);
-        free(file_path);
-        s_playing = false;
-        s_playback_task = NULL;
-        vTaskDelete(NULL);
-        return;
+    catalog_lock();
+    size_t found = 0;
+    track_search_t *search = search_index();
+    if (search) {
+        found = track_search_query(search, query, hits, max_matches);
+        for (size_t i = 0; i < found; i++) {
+            fill_info(hits[i].index, &matches[i].info);
+            matches[i].score = hits[i].score;
+        }
     }
-    ESP_LOGI(TAG, "File opened successfully: %s", file_path);
-    
-    // Increase file buffer size for SD card reads (reduces system calls)
-    // Use larger buffer to reduce SD card access frequency
-    // Note: setvbuf buffer is automatically freed when file is closed
-    const size_t file_buffer_size = 16384;  // 16KB file buffer
-    uint8_t *file_buffer_ptr = malloc(file_buffer_size);
-    if (file_buffer_ptr) {
-        setvbuf(fp, (char *)file_buffer_ptr, _IOFBF, file_buffer_size);
-        ESP_LOGI(TAG, "File buffer set to %zu bytes for SD card optimization", file_buffer_size);
-    } else {
-        ESP_LOGW(TAG, "Failed to allocate file buffer, using default (may cause SD card read issues)");
+    catalog_unlock();
+    return found;
+}
+
+static bool is_wav_path(const char *path)
+{
+    size_t len = strlen(path);
+    return len > 4 && strcasecmp(path + len - 4, ".wav") == 0;
+}
+
+// What a seek learned about a track: its exact length, or (0) that it needs indexing
+static void note_track_index(const char *name, uint32_t duration_ms)
+{
+    catalog_lock();
+    uint32_t index = track_catalog_find(&s_catalog, name);
+    if (index != TRACK_CATALOG_NONE) {
+        track_catalog_entry_t *file = &s_catalog.entries[index];
+        if (duration_ms == 0) {
+            file->flags &= ~TRACK_CATALOG_INDEXED;
+        } else if (file->duration_ms != duration_ms) {
+            file->duration_ms = duration_ms;
+            s_catalog.dirty = true;
+        }
     }
+    catalog_unlock();
+}
 
-    // Create MP3 decoder
-    ESP_LOGI(TAG, "Creating MP3 decoder...");
-    mp3_decoder_t *decoder = mp3_decoder_create();
-    if (!decoder) {
-        ESP_LOGE(TAG, "Failed to create MP3 decoder");
-        fclose(fp);
-        free(file_path);
-        s_playing = false;
-        s_playback_task = NULL;
-        vTaskDelete(NULL);
-        return;
+static void save_resume_point(const char *track, uint32_t position_ms)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs, "track", track);
+        if (err == ESP_OK) {
+            err = nvs_set_u32(nvs, "position_ms", position_ms);
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save resume point: %s", esp_err_to_name(err));
     }
-    ESP_LOGI(TAG, "MP3 decoder created successfully");
+}
 
-    // Allocate buffers
-    // Increase MP3 buffer size significantly for SD card playback
-    // Larger buffer = fewer SD card reads = less chance of underruns
-    const size_t mp3_buffer_size = 32768;  // 32KB buffer for SD card (was 8KB)
-    const size_t pcm_buffer_size = 1152 * 2 * sizeof(int16_t);
-    
-    // MP3 buffer can be in PSRAM (only accessed from task, not from interrupt)
-    uint8_t *mp3_buffer = heap_caps_malloc(mp3_buffer_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!mp3_buffer) {
-        mp3_buffer = malloc(mp3_buffer_size);
+static esp_err_t load_resume_point(char *track, size_t track_len, uint32_t *position_ms)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(RESUME_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;  // Namespace not created yet
     }
-    
-    // PCM buffer MUST be in internal RAM (DMA-capable) for I2S
-    // I2S DMA interrupt only accesses I2S driver's internal buffers, not this buffer
-    // This buffer is only accessed in task context
-    int16_t *pcm_buffer = heap_caps_malloc(pcm_buffer_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
-    if (!pcm_buffer) {
-        // Fallback to regular malloc if DMA-capable allocation fails
-        pcm_buffer = malloc(pcm_buffer_size);
-        ESP_LOGW(TAG, "PCM buffer not in DMA-capable memory - may cause issues");
+    err = nvs_get_str(nvs, "track", track, &track_len);
+    if (err == ESP_OK) {
+        err = nvs_get_u32(nvs, "position_ms", position_ms);
     }
-    
-    if (!mp3_buffer || !pcm_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate buffers (mp3=%p, pcm=%p)", mp3_buffer, pcm_buffer);
-        mp3_decoder_destroy(decoder);
-        fclose(fp);
-        free(file_path);
-        if (mp3_buffer) free(mp3_buffer);
-        if (pcm_buffer) free(pcm_buffer);
-        s_playing = false;
-        s_playback_task = NULL;
-        vTaskDelete(NULL);
+    nvs_close(nvs);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+}
+
+// A track played to its end no longer needs resuming; another track's point is kept
+static void clear_resume_point(const char *track)
+{
+    char saved[128];
+    uint32_t position_ms;
+    if (load_resume_point(saved, sizeof(saved), &position_ms) != ESP_OK || strcmp(saved, track) != 0) {
         return;
     }
-    ESP_LOGI(TAG, "Buffers allocated: mp3=%p (%zu bytes), pcm=%p (%zu bytes)", 
-             mp3_buffer, mp3_buffer_size, pcm_buffer, pcm_buffer_size);
-
-    int sample_rate = 0;
-    int channels = 0;
-    size_t bytes_read = 0;
-    bool eof = false;
-    int frame_count = 0;
-
-    // Pre-fill MP3 buffer before starting playback (critical for SD card)
-    // This prevents buffer underruns during playback
-    ESP_LOGI(TAG, "Pre-filling MP3 buffer from SD card...");
-    size_t prefill_read = fread(mp3_buffer, 1, mp3_buffer_size, fp);
-    if (prefill_read > 0) {
-        bytes_read = prefill_read;
-        ESP_LOGI(TAG, "Pre-filled %zu bytes into MP3 buffer", prefill_read);
-    } else {
-        ESP_LOGE(TAG, "Failed to pre-fill buffer - file may be empty or unreadable");
-        eof = true;
+    nvs_handle_t nvs;
+    if (nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_all(nvs);
+        nvs_commit(nvs);
+        nvs_close(nvs);
     }
+}
 
-    ESP_LOGI(TAG, "Starting MP3 decode loop...");
-    while (s_playing && !eof) {
-        // Check duration limit
-        if (duration_seconds > 0) {
-            int64_t elapsed_us = esp_timer_get_time() - start_time_us;
-            if (elapsed_us >= duration_us) {
-                ESP_LOGI(TAG, "Duration limit reached (%d seconds), stopping playback", duration_seconds);
-                break;
-            }
-        }
-        // Read MP3 data from SD card
-        // Pre-fill buffer aggressively to prevent underruns
-        // Only read when buffer is less than 50% full to maintain headroom
-        const size_t refill_threshold = mp3_buffer_size / 2;  // Refill when < 50% full
-        if (bytes_read < refill_threshold) {
-            size_t to_read = mp3_buffer_size - bytes_read;
-            // Read larger chunks for SD card (file buffer handles smaller reads)
-            // Read up to 8KB at a time for better SD card efficiency
-            const size_t chunk_size = 8192;  // Read 8KB at a time (file buffer will handle smaller ops)
-            size_t total_read = 0;
-            int64_t read_start = esp_timer_get_time();
-            
-            while (total_read < to_read && !eof) {
-                size_t this_read = (to_read - total_read > chunk_size) ? chunk_size : (to_read - total_read);
-                size_t read = fread(mp3_buffer + bytes_read + total_read, 1, this_read, fp);
-                if (read < this_read) {
-                    eof = true;
-                }
-                total_read += read;
-                
-                // Yield periodically but less frequently (file buffer reduces system call overhead)
-                if (total_read < to_read && !eof && (total_read % 4096 == 0)) {
-                    vTaskDelay(pdMS_TO_TICKS(1));  // Yield every 4KB
-                }
-            }
-            
-            bytes_read += total_read;
-            int64_t read_time = esp_timer_get_time() - read_start;
-            if (read_time > 10000) {  // Log if read took > 10ms
-                ESP_LOGW(TAG, "SD card read took %lld us for %zu bytes", read_time, total_read);
-            }
-        }
-
-        if (bytes_read == 0) {
-            break;
-        }
+// Position heard so far: what the deck has queued less what its stream still holds
+static uint32_t deck_position_ms(const deck_t *d)
+{
+    audio_player_stats_t stats;
+    audio_player_get_stream_stats(d->stream, &stats);
+    uint32_t queued_ms = d->queued_ms;
+    return d->pos_start_ms + (queued_ms > stats.buffered_ms ? queued_ms - stats.buffered_ms : 0);
+}
 
-        // Decode MP3 frame
-        size_t samples_decoded = 0;
-        int frame_sample_rate = 0;
-        int frame_channels = 0;
-        size_t bytes_consumed = 0;
-
-        esp_err_t err = mp3_decoder_decode(decoder,
-                                          mp3_buffer,
-                                          bytes_read,
-                                          pcm_buffer,
-                                          pcm_buffer_size / sizeof(int16_t),
-                                          &samples_decoded,
-                                          &frame_sample_rate,
-                                          &frame_channels,
-                                          &bytes_consumed);
-
-        if (err == ESP_OK && samples_decoded > 0 && bytes_consumed > 0) {
-            frame_count++;
-            if (sample_rate == 0) {
-                sample_rate = frame_sample_rate;
-                channels = frame_channels;
-                ESP_LOGI(TAG, "MP3 decoded: %d Hz, %d channel(s), frame %d", sample_rate, channels, frame_count);
-            }
-            if (frame_count % 100 == 0) {
-                ESP_LOGI(TAG, "MP3 playback progress: %d frames decoded", frame_count);
-            }
+static deck_t *deck_other(const deck_t *d)
+{
+    return d == &s_decks[0] ? &s_decks[1] : &s_decks[0];
+}
 
-            // Submit PCM to audio player (all processing happens in task context, not interrupt)
-            // The audio player will copy data to I2S DMA buffers in task context
-            err = audio_player_submit_pcm(pcm_buffer, samples_decoded / channels,
-                                         sample_rate, channels);
-            if (err != ESP_OK) {
-                ESP_LOGW(TAG, "Failed to submit PCM: %s", esp_err_to_name(err));
-            }
+static bool deck_idle(const deck_t *d)
+{
+    return uxSemaphoreGetCount(d->done) > 0;
+}
 
-            // Move remaining data to start of buffer
-            if (bytes_consumed < bytes_read) {
-                memmove(mp3_buffer, mp3_buffer + bytes_consumed, bytes_read - bytes_consumed);
-                bytes_read -= bytes_consumed;
-            } else {
-                bytes_read = 0;
-            }
-        } else if (bytes_consumed > 0) {
-            // Skip invalid data
-            memmove(mp3_buffer, mp3_buffer + bytes_consumed, bytes_read - bytes_consumed);
-            bytes_read -= bytes_consumed;
-        } else {
-            // No progress, read more
-            if (bytes_read >= mp3_buffer_size) {
-                ESP_LOGW(TAG, "Decoder stuck, skipping data");
-                bytes_read = 0;
-            }
-        }
+static void queue_clear(void)
+{
+    xSemaphoreTake(s_queue_lock, portMAX_DELAY);
+    s_queue_head = 0;
+    s_queue_count = 0;
+    xSemaphoreGive(s_queue_lock);
+}
 
-        // Yield to allow I2S DMA and other tasks to run
-        // This prevents SD card reads from blocking I2S DMA operations
-        vTaskDelay(pdMS_TO_TICKS(5));  // Reduced from 10ms to be more responsive
+static bool queue_push(const char *name, int duration_seconds)
+{
+    xSemaphoreTake(s_queue_lock, portMAX_DELAY);
+    bool ok = s_queue_count < PLAY_QUEUE_LEN;
+    if (ok) {
+        play_item_t *item = &s_queue[(s_queue_head + s_queue_count) % PLAY_QUEUE_LEN];
+        snprintf(item->name, sizeof(item->name), "%s", name);
+        item->duration_seconds = duration_seconds;
+        s_queue_count++;
     }
+    xSemaphoreGive(s_queue_lock);
+    return ok;
+}
 
-    // Cleanup
-    free(mp3_buffer);
-    free(pcm_buffer);
-    mp3_decoder_destroy(decoder);
-    
-    // Close file (setvbuf buffer is automatically freed when file is closed)
-    fclose(fp);
-    
-    free(params->file_path);
-    free(params);
-
-    ESP_LOGI(TAG, "MP3 playback complete");
-    s_playing = false;
-    s_playback_task = NULL;
-    vTaskDelete(NULL);
+static bool queue_pop(play_item_t *item)
+{
+    xSemaphoreTake(s_queue_lock, portMAX_DELAY);
+    bool ok = s_queue_count > 0;
+    if (ok) {
+        *item = s_queue[s_queue_head];
+        s_queue_head = (s_queue_head + 1) % PLAY_QUEUE_LEN;
+        s_queue_count--;
+    }
+    xSemaphoreGive(s_queue_lock);
+    return ok;
 }
 
-esp_err_t audio_file_manager_play(const char *name, float volume, int duration)
+// Start a deck on a track. Held, it decodes ahead silently until crossfaded in.
+static esp_err_t deck_start(deck_t *d, const char *name, const char *path, int duration_seconds,
+                            uint32_t start_ms, bool held)
 {
-    (void)volume;  // Volume handled by audio_player
+    if (xSemaphoreTake(d->done, 0) != pdTRUE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    snprintf(d->path, sizeof(d->path), "%s", path);
+    d->duration_seconds = duration_seconds;
+    d->start_ms = start_ms;
+    d->heard = !held;
+    d->fade_in_ms = 0;
+    d->stop_at_us = 0;
+    d->next_started = false;
+    d->cue_queued = false;
+    d->running = true;
+    // Also undoes the fade-out the stream was left at by its last crossfade
+    audio_player_stream_hold(d->stream, held);
 
-    if (!s_initialized) {
-        ESP_RETURN_ON_ERROR(audio_file_manager_init(), TAG, "init failed");
+    // Decode on CPU 1 with the I2S feeder, away from WiFi/network tasks on CPU 0;
+    // the SD reader stage of the MP3 pipeline runs on CPU 0
+    BaseType_t ret = xTaskCreatePinnedToCore(deck_task,
+                                             d->stream == AUDIO_STREAM_MEDIA ? "mp3_playback" : "mp3_playback2",
+                                             DECK_STACK,
+                                             d,
+                                             CONFIG_AUDIO_MP3_DECODER_PRIORITY,
+                                             NULL,
+                                             1);  // CPU 1 for audio processing
+    if (ret != pdPASS) {
+        d->running = false;
+        xSemaphoreGive(d->done);
+        return ESP_ERR_NO_MEM;
     }
+    return ESP_OK;
+}
 
-    // Stop current playback
-    audio_file_manager_stop();
+// Stop a deck, dropping what it has queued, and wait for its task to end
+static void deck_stop(deck_t *d)
+{
+    if (deck_idle(d)) {
+        return;
+    }
+    d->running = false;
+    audio_player_stream_flush(d->stream);
+    if (xSemaphoreTake(d->done, DECK_STOP_TIMEOUT) != pdTRUE) {
+        ESP_LOGW(TAG, "Playback of %s did not stop", d->name);
+        return;
+    }
+    xSemaphoreGive(d->done);
+}
 
+// Find the file of a track, by catalog path or the usual places
+static esp_err_t find_track_file(const char *name, audio_file_info_t *info, char *file_path, size_t len)
+{
     ESP_LOGI(TAG, "Looking for audio file: %s", name);
     
     // Find file
-    audio_file_info_t info;
-    esp_err_t ret = audio_file_manager_get_by_name(name, &info);
+    esp_err_t ret = audio_file_manager_get_by_name(name, info);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Audio file not found: %s", name);
-        ESP_LOGE(TAG, "Available files: %zu total", s_file_count);
-        // Log files that might match (starting with same prefix)
-        char search_prefix[32] = {0};
-        const char *underscore = strchr(name, '_');
-        if (underscore) {
-            size_t prefix_len = underscore - name;
-            if (prefix_len < sizeof(search_prefix)) {
-                strncpy(search_prefix, name, prefix_len);
-                search_prefix[prefix_len] = '\0';
-            }
-        } else {
-            strncpy(search_prefix, name, sizeof(search_prefix) - 1);
-        }
-        ESP_LOGE(TAG, "Searching for files starting with '%s'...", search_prefix);
-        size_t matches_found = 0;
-        for (size_t i = 0; i < s_file_count && matches_found < 10; i++) {
-            char stored_upper[128];
-            strncpy(stored_upper, s_audio_files[i].name, sizeof(stored_upper) - 1);
-            stored_upper[sizeof(stored_upper) - 1] = '\0';
-            for (size_t j = 0; stored_upper[j]; j++) {
-                stored_upper[j] = toupper(stored_upper[j]);
-            }
-            char prefix_upper[32];
-            strncpy(prefix_upper, search_prefix, sizeof(prefix_upper) - 1);
-            prefix_upper[sizeof(prefix_upper) - 1] = '\0';
-            for (size_t j = 0; prefix_upper[j]; j++) {
-                prefix_upper[j] = toupper(prefix_upper[j]);
-            }
-            if (strncmp(stored_upper, prefix_upper, strlen(prefix_upper)) == 0) {
-                ESP_LOGE(TAG, "  [%zu] %s -> %s (available: %s, path: %s)", i, s_audio_files[i].name, 
-                        s_audio_files[i].display_name,
-                        s_audio_files[i].available ? "yes" : "no",
-                        s_audio_files[i].file_path);
-                matches_found++;
-            }
-        }
-        if (matches_found == 0) {
-            // Log first few files if no matches
-            for (size_t i = 0; i < (s_file_count < 5 ? s_file_count : 5); i++) {
-                ESP_LOGE(TAG, "  [%zu] %s -> %s (available: %s)", i, s_audio_files[i].name, 
-                        s_audio_files[i].display_name,
-                        s_audio_files[i].available ? "yes" : "no");
-            }
+        ESP_LOGE(TAG, "Available files: %" PRIu32 " total", s_catalog.count);
+        // Log the closest names, all below the score needed to play them
+        audio_file_match_t close[5];
+        size_t close_count = audio_file_manager_search(name, close, sizeof(close) / sizeof(close[0]));
+        for (size_t i = 0; i < close_count; i++) {
+            ESP_LOGE(TAG, "  %s -> %s (score %u)", close[i].info.name, close[i].info.display_name, close[i].score);
         }
         return ESP_ERR_NOT_FOUND;
     }
     
-    ESP_LOGI(TAG, "Found file: %s -> %s", name, info.display_name);
+    ESP_LOGI(TAG, "Found file: %s -> %s", name, info->display_name);
 
     // Find file path - check multiple locations if needed
-    char file_path[256] = {0};
     bool file_available = false;
     
-    // First, try to find the file in our list
-    for (size_t i = 0; i < s_file_count; i++) {
-        if (strcasecmp(s_audio_files[i].name, info.name) == 0) {
-            strncpy(file_path, s_audio_files[i].file_path, sizeof(file_path) - 1);
-            file_path[sizeof(file_path) - 1] = '\0';
-            ESP_LOGI(TAG, "File entry found: path=%s, available=%s, size=%zu", 
-                    file_path, s_audio_files[i].available ? "yes" : "no", s_audio_files[i].file_size);
-            break;
-        }
+    // First, take the path from the catalog
+    catalog_lock();
+    uint32_t index = track_catalog_find(&s_catalog, info->name);
+    if (index != TRACK_CATALOG_NONE &&
+        track_catalog_path(&s_catalog, index, file_path, len) == ESP_OK) {
+        ESP_LOGI(TAG, "File entry found: path=%s, size=%" PRIu32, file_path, s_catalog.entries[index].file_size);
+    } else {
+        file_path[0] = '\0';
     }
+    catalog_unlock();
 
     if (file_path[0] == '\0') {
         ESP_LOGE(TAG, "File path not found for: %s", name);
@@ -748,19 +772,21 @@ esp_err_t audio_file_manager_play(const char *name, float volume, int duration)
             "/sdcard/%s.mp3",
             "/spiffs/sounds/%s.mp3",
             "/spiffs/%s.mp3",
+            "/sdcard/sounds/%s.wav",
+            "/sdcard/%s.wav",
             NULL
         };
         
         char temp_name[128];
-        strncpy(temp_name, info.name, sizeof(temp_name) - 1);
+        strncpy(temp_name, info->name, sizeof(temp_name) - 1);
         temp_name[sizeof(temp_name) - 1] = '\0';
         
         for (int i = 0; search_paths[i] != NULL; i++) {
             char alt_path[256];
             snprintf(alt_path, sizeof(alt_path), search_paths[i], temp_name);
             if (stat(alt_path, &st) == 0) {
-                strncpy(file_path, alt_path, sizeof(file_path) - 1);
-                file_path[sizeof(file_path) - 1] = '\0';
+                strncpy(file_path, alt_path, len - 1);
+                file_path[len - 1] = '\0';
                 file_available = true;
                 ESP_LOGI(TAG, "File found at alternative path: %s (size: %zu bytes)", file_path, (size_t)st.st_size);
                 break;
@@ -774,60 +800,660 @@ esp_err_t audio_file_manager_play(const char *name, float volume, int duration)
         ESP_LOGE(TAG, "Tried: %s", file_path);
         return ESP_ERR_NOT_FOUND;
     }
+    return ESP_OK;
+}
 
-    // Allocate playback parameters
-    playback_params_t *params = malloc(sizeof(playback_params_t));
-    if (!params) {
-        return ESP_ERR_NO_MEM;
+// Crossfade from the other deck to one held until it had audio queued
+static void fade_in_deck(deck_t *d)
+{
+    deck_t *other = deck_other(d);
+    ESP_LOGI(TAG, "Crossfading to %s over %" PRIu32 " ms", d->name, d->fade_in_ms);
+    audio_player_crossfade(other->stream, d->stream, d->fade_in_ms);
+    if (!deck_idle(other)) {
+        other->stop_at_us = esp_timer_get_time() + (int64_t)d->fade_in_ms * 1000 + FADE_STOP_MARGIN_US;
     }
-    
-    params->file_path = strdup(file_path);
-    if (!params->file_path) {
-        free(params);
-        return ESP_ERR_NO_MEM;
+    d->fade_in_ms = 0;
+    d->heard = true;
+}
+
+// Crossfades into the next queued track, driven by the progress of the deck heard:
+// the other deck starts decoding it NEXT_PRELOAD_MS ahead, and the crossfade is cued
+// in the stream so it starts at the same sample however decode and SD timing go.
+// Caller holds s_player_lock.
+static void plan_crossfade(deck_t *d, uint32_t queued_ms)
+{
+    deck_t *other = deck_other(d);
+    if (d->fade_in_ms) {
+        if (queued_ms >= FADE_IN_BUFFER_MS) {
+            fade_in_deck(d);
+        }
+        return;
     }
-    
-    params->duration_seconds = duration;
-
-    strncpy(s_current_playing, info.name, sizeof(s_current_playing) - 1);
-    s_playing = true;
-
-    // Pin MP3 playback task to CPU 1 to isolate from WiFi/network tasks on CPU 0
-    BaseType_t task_ret = xTaskCreatePinnedToCore(mp3_playback_task,
-                                                 "mp3_playback",
-                                                 8192,
-                                                 params,
-                                                 5,
-                                                 &s_playback_task,
-                                                 1);  // CPU 1 for audio processing
-    if (task_ret != pdPASS) {
-        free(params->file_path);
-        free(params);
-        s_playing = false;
-        return ESP_ERR_NO_MEM;
+    if (d != s_current || d->end_ms == 0 || CONFIG_AUDIO_CROSSFADE_MS == 0) {
+        return;
+    }
+    uint32_t fade = CONFIG_AUDIO_CROSSFADE_MS;
+    if (fade > d->end_ms / 2) {
+        fade = d->end_ms / 2;
+    }
+    if (!d->next_started && queued_ms + fade + NEXT_PRELOAD_MS >= d->end_ms && deck_idle(other)) {
+        play_item_t item;
+        audio_file_info_t info;
+        char path[256];
+        while (!d->next_started && queue_pop(&item)) {
+            if (find_track_file(item.name, &info, path, sizeof(path)) == ESP_OK &&
+                deck_start(other, info.name, path, item.duration_seconds, 0, true) == ESP_OK) {
+                d->next_started = true;
+                ESP_LOGI(TAG, "Decoding %s ahead to follow %s", info.name, d->name);
+            }
+        }
+    }
+    if (d->next_started && !d->cue_queued && queued_ms + fade >= d->end_ms) {
+        // What is queued from here on is the tail heard while it fades out
+        uint32_t tail_ms = d->end_ms > queued_ms ? d->end_ms - queued_ms : 0;
+        if (audio_player_queue_crossfade(d->stream, other->stream, tail_ms, CUE_WAIT_TICKS) == ESP_OK) {
+            d->cue_queued = true;
+            other->heard = true;
+            s_current = other;
+        }
+    }
+}
+
+static void note_progress(uint32_t queued_ms, void *arg)
+{
+    deck_t *d = arg;
+    d->queued_ms = queued_ms;
+    int64_t now = esp_timer_get_time();
+    if (d->stop_at_us && now >= d->stop_at_us) {
+        d->running = false;  // Faded out
+        return;
+    }
+    if (d == s_current && now - d->last_save_us >= RESUME_SAVE_INTERVAL_US) {
+        d->last_save_us = now;
+        save_resume_point(d->name, deck_position_ms(d));
+    }
+    if (d->fade_in_ms || (d == s_current && d->end_ms > 0)) {
+        // Only tried: play() or stop() may hold it while waiting for this deck to end
+        if (xSemaphoreTake(s_player_lock, 0) == pdTRUE) {
+            plan_crossfade(d, queued_ms);
+            xSemaphoreGive(s_player_lock);
+        }
+    }
+}
+
+// A deck's track ended before its crossfade point, or before it had been faded in
+static void finish_crossfade(deck_t *d)
+{
+    while (xSemaphoreTake(s_player_lock, pdMS_TO_TICKS(10)) != pdTRUE) {
+        if (!d->running) {
+            return;  // Being stopped
+        }
+    }
+    if (d->fade_in_ms) {
+        fade_in_deck(d);
+    }
+    if (d->next_started && !d->cue_queued &&
+        audio_player_queue_crossfade(d->stream, deck_other(d)->stream, 0, DECK_STOP_TIMEOUT) == ESP_OK) {
+        // The next track starts right after the last sample
+        d->cue_queued = true;
+        deck_other(d)->heard = true;
+        s_current = deck_other(d);
+    }
+    xSemaphoreGive(s_player_lock);
+}
+
+// Stream a WAV file a block at a time; memory use does not depend on its length
+static playback_end_t stream_wav_file(deck_t *d, FILE *fp, uint32_t duration_ms)
+{
+    const size_t block_frames = 1024;
+    wav_source_t *src = malloc(sizeof(wav_source_t));
+    int16_t *pcm = malloc(block_frames * WAV_SOURCE_MAX_CHANNELS * sizeof(int16_t));
+    if (!src || !pcm) {
+        ESP_LOGE(TAG, "Failed to allocate WAV buffers");
+        free(src);
+        free(pcm);
+        return PLAYBACK_FAILED;
+    }
+    esp_err_t err = wav_source_open_file(src, fp);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Unsupported or invalid WAV file: %s", esp_err_to_name(err));
+        free(src);
+        free(pcm);
+        return PLAYBACK_FAILED;
+    }
+    ESP_LOGI(TAG, "WAV: %" PRIu32 " Hz, %u channel(s), %u-bit %s, %" PRIu32 " frames",
+             src->sample_rate, src->channels, src->bits_per_sample, src->is_float ? "float" : "PCM",
+             src->frames_total);
+    d->duration_ms = (uint32_t)((uint64_t)src->frames_total * 1000 / src->sample_rate);
+    size_t skipped = 0;
+    if (d->start_ms > 0) {
+        skipped = wav_source_skip(src, (size_t)((uint64_t)d->start_ms * src->sample_rate / 1000));
+        d->pos_start_ms = (uint32_t)((uint64_t)skipped * 1000 / src->sample_rate);
+    }
+
+    // Counted in frames, so the stop is sample-accurate
+    uint64_t frames_limit = duration_ms > 0 ? (uint64_t)duration_ms * src->sample_rate / 1000 : UINT64_MAX;
+    uint64_t frames_left = src->frames_total > skipped ? src->frames_total - skipped : 0;
+    d->end_ms = (uint32_t)((frames_left < frames_limit ? frames_left : frames_limit) * 1000 / src->sample_rate);
+    uint64_t frames_queued = 0;
+    while (d->running && frames_queued < frames_limit) {
+        size_t want = block_frames;
+        if (want > frames_limit - frames_queued) {
+            want = (size_t)(frames_limit - frames_queued);
+        }
+        int64_t read_start = esp_timer_get_time();
+        size_t frames = wav_source_read(src, pcm, want);
+        audio_telemetry_record(AUDIO_TELEMETRY_READER_WAIT, (uint32_t)(esp_timer_get_time() - read_start));
+        if (frames == 0) {
+            break;
+        }
+        // Wait in short slices so a stop request is noticed even while the ring is full
+        size_t frames_done = 0;
+        while (frames_done < frames && d->running) {
+            size_t queued = 0;
+            err = audio_player_stream_submit(d->stream, pcm + frames_done * src->channels, frames - frames_done,
+                                             (int)src->sample_rate, src->channels,
+                                             pdMS_TO_TICKS(100), &queued);
+            frames_done += queued;
+            if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+                ESP_LOGW(TAG, "Failed to submit PCM: %s", esp_err_to_name(err));
+                break;
+            }
+        }
+        frames_queued += frames_done;
+        note_progress((uint32_t)(frames_queued * 1000 / src->sample_rate), d);
+    }
+    playback_end_t end = PLAYBACK_END_OF_FILE;
+    if (!d->running) {
+        end = PLAYBACK_STOPPED;
+    } else if (frames_queued >= frames_limit) {
+        ESP_LOGI(TAG, "Duration limit reached, stopping playback");
+        end = PLAYBACK_DURATION;
+    }
+    wav_source_close(src);
+    free(src);
+    free(pcm);
+    return end;
+}
+
+// Position an MP3 at the deck's start point and fill in what the pipeline cuts: the
+// bit reservoir priming, and the encoder delay and padding when a LAME tag gives them.
+// Returns false if there is nothing left to play.
+static bool seek_mp3(deck_t *d, FILE *fp, mp3_pipeline_config_t *config)
+{
+    // A scan would read the whole file before playing: use the cached index or a
+    // Xing/VBRI header, and otherwise estimate and let the indexer catch up
+    mp3_index_t idx;
+    esp_err_t err = mp3_index_open(d->path, false, &idx);
+    if (err == ESP_OK) {
+        d->duration_ms = mp3_index_duration_ms(&idx);
+        note_track_index(d->name, d->duration_ms);
+    } else if (err == ESP_ERR_NOT_FINISHED) {
+        d->duration_ms = mp3_index_duration_ms(&idx);  // Estimated
+        note_track_index(d->name, 0);
+        start_indexer();
+    } else {
+        ESP_LOGW(TAG, "Cannot index %s: %s", d->path, esp_err_to_name(err));
+        return true;
+    }
+
+    uint32_t frame = 0;
+    bool seeked = false;
+    if (d->start_ms > 0) {
+        mp3_index_pos_t pos;
+        if (mp3_index_seek(&idx, fp, d->start_ms, &pos) == ESP_OK) {
+            frame = pos.frame;
+            d->pos_start_ms = (uint32_t)((uint64_t)pos.frame * idx.samples_per_frame * 1000 / idx.sample_rate);
+            config->prime_bytes = pos.prime_bytes;
+            seeked = true;
+            ESP_LOGI(TAG, "Seeked to %" PRIu32 " ms (frame %" PRIu32 ", offset %" PRIu32 ")",
+                     d->pos_start_ms, pos.frame, pos.offset);
+        } else {
+            ESP_LOGW(TAG, "Seek to %" PRIu32 " ms failed, playing from the start", d->start_ms);
+        }
+    }
+    if (!seeked) {
+        // Past the tags and the Xing/Info frame, which decodes as a frame of silence
+        fseek(fp, idx.audio_start, SEEK_SET);
+    }
+
+    bool more = true;
+    uint32_t skip, length;
+    if (mp3_index_trim(&idx, frame, &skip, &length)) {
+        config->skip_samples = skip;
+        config->length_samples = length;
+        d->end_ms = (uint32_t)((uint64_t)length * 1000 / idx.sample_rate);
+        more = length > 0;
+    } else if (err == ESP_OK && d->duration_ms > d->pos_start_ms) {
+        d->end_ms = d->duration_ms - d->pos_start_ms;
+    }
+    if (config->duration_ms > 0 && (d->end_ms == 0 || d->end_ms > config->duration_ms)) {
+        d->end_ms = config->duration_ms;
+    }
+    mp3_index_free(&idx);
+    return more;
+}
+
+// Play the deck's track to its end, its duration limit or a stop
+static playback_end_t play_track(deck_t *d)
+{
+    uint32_t duration_ms = d->duration_seconds > 0 ? (uint32_t)d->duration_seconds * 1000 : 0;
+    ESP_LOGI(TAG, "Starting playback: %s (duration: %d seconds, from %" PRIu32 " ms)", d->path,
+             d->duration_seconds, d->start_ms);
+    d->pos_start_ms = 0;
+    d->queued_ms = 0;
+    d->duration_ms = 0;
+    d->end_ms = 0;
+    d->last_save_us = esp_timer_get_time();
+
+    // Open file; a prefetched start is already in the cache
+    FILE *fp = sd_cache_fopen(d->path);
+    if (!fp) {
+        ESP_LOGE(TAG, "Failed to open file: %s (errno: %d)", d->path, errno);
+        return PLAYBACK_FAILED;
+    }
+    // Both players read several KB at a time: no stdio buffer in between (a cache
+    // stream has none; without the cache, the pipeline reads whole sectors)
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    playback_end_t end = PLAYBACK_END_OF_FILE;
+    if (is_wav_path(d->path)) {
+        end = stream_wav_file(d, fp, duration_ms);
+        fclose(fp);
+        return end;
+    }
+
+    mp3_pipeline_config_t config = {
+        .fp = fp,
+        .keep_running = &d->running,
+        .duration_ms = duration_ms,
+        .stream = d->stream,
+        .on_progress = note_progress,
+        .progress_arg = d,
+    };
+    if (seek_mp3(d, fp, &config)) {
+        mp3_pipeline_result_t result = {0};
+        esp_err_t err = mp3_pipeline_play(&config, &result);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "MP3 playback failed: %s", esp_err_to_name(err));
+        }
+        if (result.cut_short) {
+            end = PLAYBACK_STOPPED;
+        } else if (duration_ms > 0 && result.queued_ms >= duration_ms) {
+            end = PLAYBACK_DURATION;
+        }
+    }
+    fclose(fp);
+    return end;
+}
+
+// Deck task, the decode stage of the MP3 pipeline. Plays its track, then, unless the
+// other deck is taking over, the queued tracks after it on the same stream with no gap.
+// A track stopped early leaves a resume point; one that played out clears it. Once a
+// crossfade has handed over to the other deck, only that deck touches the resume point.
+static void deck_task(void *arg)
+{
+    deck_t *d = arg;
+    playback_end_t end;
+    for (;;) {
+        end = play_track(d);
+        if (end == PLAYBACK_STOPPED) {
+            break;
+        }
+        // A deck faded out under the next track leaves the resume point to it
+        if (d == s_current) {
+            if (end == PLAYBACK_END_OF_FILE) {
+                clear_resume_point(d->name);
+            } else if (end == PLAYBACK_DURATION) {
+                save_resume_point(d->name, d->pos_start_ms + d->queued_ms);
+            }
+        }
+
+        // Decoded ahead and still held: what follows is up to it once it is heard
+        while (!d->heard && d->running) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        play_item_t item;
+        audio_file_info_t info;
+        char path[256];
+        bool found = false;
+        while (!found && !d->next_started && d == s_current && d->running && queue_pop(&item)) {
+            found = find_track_file(item.name, &info, path, sizeof(path)) == ESP_OK;
+        }
+        if (!found) {
+            break;
+        }
+        ESP_LOGI(TAG, "Playing %s straight after %s", info.name, d->name);
+        snprintf(d->name, sizeof(d->name), "%s", info.name);
+        snprintf(d->path, sizeof(d->path), "%s", path);
+        d->duration_seconds = item.duration_seconds;
+        d->start_ms = 0;
+    }
+
+    if (end == PLAYBACK_STOPPED) {
+        if (d->heard && d == s_current) {
+            save_resume_point(d->name, deck_position_ms(d));
+        }
+        audio_player_stream_flush(d->stream);
+    } else {
+        // Let the queued audio play out
+        finish_crossfade(d);
+        audio_player_stream_wait_idle(d->stream, portMAX_DELAY);
+    }
+
+    ESP_LOGI(TAG, "Playback complete");
+    d->running = false;
+    xSemaphoreGive(d->done);
+    vTaskDelete(NULL);
+}
+
+// Read what the catalog keeps about a file; fields stay zero if it cannot be parsed
+static void index_track(const char *path, bool wav, track_catalog_entry_t *meta)
+{
+    if (wav) {
+        FILE *fp = fopen(path, "rb");
+        wav_source_t *src = malloc(sizeof(wav_source_t));
+        if (fp && src && wav_source_open_file(src, fp) == ESP_OK) {
+            meta->duration_ms = (uint32_t)((uint64_t)src->frames_total * 1000 / src->sample_rate);
+            meta->sample_rate = src->sample_rate;
+            meta->channels = (uint8_t)src->channels;
+            meta->bitrate_kbps = (uint16_t)(src->sample_rate * src->channels * src->sample_bytes * 8 / 1000);
+            wav_source_close(src);
+        }
+        free(src);
+        if (fp) {
+            fclose(fp);
+        }
+        return;
+    }
+    // Also caches the seek index next to the file
+    mp3_index_t idx;
+    if (mp3_index_open(path, true, &idx) == ESP_OK) {
+        meta->duration_ms = mp3_index_duration_ms(&idx);
+        meta->sample_rate = idx.sample_rate;
+        meta->channels = idx.channels;
+        if (meta->duration_ms > 0) {
+            meta->bitrate_kbps = (uint16_t)((uint64_t)(idx.audio_end - idx.audio_start) * 8 / meta->duration_ms);
+        }
+        meta->replay_gain = idx.replay_gain == MP3_INDEX_GAIN_UNKNOWN ? TRACK_CATALOG_GAIN_UNKNOWN : idx.replay_gain;
+        mp3_index_free(&idx);
+    }
+}
+
+// Caller holds the catalog lock: entry index still holds the file it held when read
+static bool same_file(uint32_t index, const track_catalog_entry_t *was)
+{
+    return index < s_catalog.count && s_catalog.entries[index].dir == was->dir &&
+           s_catalog.entries[index].file == was->file;
+}
+
+// Keep the catalog in step with the files: add new ones, drop missing ones, and read
+// the metadata of new or changed ones. Waits while audio plays.
+static void indexer_task(void *arg)
+{
+    (void)arg;
+    if (s_rescan) {
+        s_rescan = false;
+        scan_sounds_dir(s_sounds_dir, false);
+    }
+    for (;;) {
+        bool removed = false;
+        catalog_lock();
+        s_index_again = false;
+        uint32_t i = s_catalog.count;
+        catalog_unlock();
+
+        // Backwards: a removal moves the last entry, which has been seen, into the gap
+        while (i-- > 0) {
+            while (audio_file_manager_is_playing()) {
+                vTaskDelay(pdMS_TO_TICKS(1000));
+            }
+            char path[256];
+            track_catalog_entry_t was = {0};
+            catalog_lock();
+            bool valid = i < s_catalog.count && track_catalog_path(&s_catalog, i, path, sizeof(path)) == ESP_OK;
+            if (valid) {
+                was = s_catalog.entries[i];
+            }
+            catalog_unlock();
+            if (!valid) {
+                continue;
+            }
+
+            struct stat st;
+            if (stat(path, &st) != 0) {
+                // Deleted or renamed. The static list is only a guess, so nothing is dropped from it.
+                if (s_catalog_path[0]) {
+                    catalog_lock();
+                    if (same_file(i, &was)) {
+                        ESP_LOGI(TAG, "Dropping missing track %s", path);
+                        track_catalog_remove(&s_catalog, i);
+                        s_search_stale = true;
+                        sd_cache_invalidate(path);
+                        removed = true;
+                    }
+                    catalog_unlock();
+                }
+                continue;
+            }
+            if ((was.flags & TRACK_CATALOG_INDEXED) && was.file_size == (uint32_t)st.st_size &&
+                was.mtime == (uint32_t)st.st_mtime) {
+                continue;
+            }
+
+            track_catalog_entry_t meta = { .replay_gain = TRACK_CATALOG_GAIN_UNKNOWN };
+            index_track(path, was.flags & TRACK_CATALOG_WAV, &meta);
+            catalog_lock();
+            if (same_file(i, &was)) {
+                track_catalog_entry_t *file = &s_catalog.entries[i];
+                file->file_size = (uint32_t)st.st_size;
+                file->mtime = (uint32_t)st.st_mtime;
+                file->duration_ms = meta.duration_ms;
+                file->sample_rate = meta.sample_rate;
+                file->channels = meta.channels;
+                file->bitrate_kbps = meta.bitrate_kbps;
+                file->replay_gain = meta.replay_gain;
+                file->flags |= TRACK_CATALOG_INDEXED;  // Unreadable files too: not retried until they change
+                s_catalog.dirty = true;
+            }
+            catalog_unlock();
+        }
+
+        catalog_lock();
+        if (removed) {
+            track_catalog_compact(&s_catalog);
+        }
+        if (s_catalog.dirty && s_catalog_path[0]) {
+            track_catalog_save(&s_catalog, s_catalog_path);
+        }
+        bool again = s_index_again;
+        if (!again) {
+            s_indexer_task = NULL;
+        }
+        catalog_unlock();
+        if (!again) {
+            break;
+        }
+    }
+    ESP_LOGI(TAG, "Track indexing complete");
+    vTaskDelete(NULL);
+}
+
+static void start_indexer(void)
+{
+    catalog_lock();
+    if (s_indexer_task) {
+        s_index_again = true;
+    } else if (s_catalog.count > 0 || s_rescan) {
+        // CPU 0 with the SD reader, below everything that matters
+        if (xTaskCreatePinnedToCore(indexer_task, "mp3_indexer", INDEXER_STACK, NULL, INDEXER_PRIORITY,
+                                    &s_indexer_task, 0) != pdPASS) {
+            ESP_LOGW(TAG, "Failed to start the track indexer");
+            s_indexer_task = NULL;
+        }
+    }
+    catalog_unlock();
+}
+
+esp_err_t audio_file_manager_play(const char *name, float volume, int duration)
+{
+    return audio_file_manager_play_at(name, volume, duration, 0);
+}
+
+esp_err_t audio_file_manager_play_at(const char *name, float volume, int duration, uint32_t start_ms)
+{
+    (void)volume;  // Volume handled by audio_player
+
+    if (!s_initialized) {
+        ESP_RETURN_ON_ERROR(audio_file_manager_init(), TAG, "init failed");
+    }
+
+    audio_file_info_t info;
+    char file_path[256] = {0};
+    esp_err_t ret = find_track_file(name, &info, file_path, sizeof(file_path));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    xSemaphoreTake(s_player_lock, portMAX_DELAY);
+    queue_clear();
+    deck_t *cur = s_current;
+    if (cur && cur->fade_in_ms) {
+        // Not faded in yet: drop it and fade from the track still heard
+        deck_stop(cur);
+        cur = deck_other(cur);
+        cur->stop_at_us = 0;
+    }
+    bool crossfade = CONFIG_AUDIO_CROSSFADE_MS > 0 && cur && !deck_idle(cur) && cur->running;
+    deck_t *d;
+    if (crossfade) {
+        // Fade from the current track once the new one has audio queued
+        d = deck_other(cur);
+        deck_stop(d);
+        cur->next_started = false;
+    } else {
+        deck_stop(&s_decks[1]);
+        deck_stop(&s_decks[0]);
+        d = &s_decks[0];
+    }
+    ret = deck_start(d, info.name, file_path, duration, start_ms, crossfade);
+    if (ret == ESP_OK) {
+        d->fade_in_ms = crossfade ? CONFIG_AUDIO_CROSSFADE_MS : 0;
+        s_current = d;
+    }
+    xSemaphoreGive(s_player_lock);
+    if (ret != ESP_OK) {
+        return ret;
     }
 
     ESP_LOGI(TAG, "Started playback: %s (duration: %d seconds)", info.display_name, duration);
     return ESP_OK;
 }
 
+esp_err_t audio_file_manager_enqueue(const char *name, int duration)
+{
+    if (!name) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        ESP_RETURN_ON_ERROR(audio_file_manager_init(), TAG, "init failed");
+    }
+    audio_file_info_t info;
+    if (audio_file_manager_get_by_name(name, &info) != ESP_OK) {
+        ESP_LOGE(TAG, "Audio file not found: %s", name);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!audio_file_manager_is_playing()) {
+        return audio_file_manager_play(info.name, 1.0f, duration);
+    }
+    if (!queue_push(info.name, duration)) {
+        ESP_LOGW(TAG, "Play queue full, %s not queued", info.name);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Queued %s", info.display_name);
+    // Its start is then read from memory, whichever way it follows the current track
+    audio_file_manager_prefetch(info.name);
+    return ESP_OK;
+}
+
+esp_err_t audio_file_manager_prefetch(const char *name)
+{
+    if (!name) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char path[SD_CACHE_PATH_MAX];
+    uint32_t kbps = 0;
+    catalog_lock();
+    uint32_t index = find_track(name);
+    if (index != TRACK_CATALOG_NONE && track_catalog_path(&s_catalog, index, path, sizeof(path)) != ESP_OK) {
+        index = TRACK_CATALOG_NONE;
+    }
+    if (index != TRACK_CATALOG_NONE) {
+        kbps = s_catalog.entries[index].bitrate_kbps;
+    }
+    catalog_unlock();
+    if (index == TRACK_CATALOG_NONE) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t bytes = (kbps ? kbps : PREFETCH_DEFAULT_KBPS) * 125 * CONFIG_AUDIO_SD_PREFETCH_SEC;
+    esp_err_t err = sd_cache_prefetch(path, 0, bytes);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Prefetching %" PRIu32 " KB of %s", bytes / 1024, path);
+    }
+    return err;
+}
+
 esp_err_t audio_file_manager_stop(void)
 {
-    if (s_playing && s_playback_task) {
-        s_playing = false;
-        // Wait for task to finish (with timeout)
-        int timeout = 100; // 10 seconds
-        while (s_playback_task != NULL && timeout-- > 0) {
-            vTaskDelay(pdMS_TO_TICKS(100));
-        }
+    if (!s_initialized) {
+        return ESP_OK;
     }
-    memset(s_current_playing, 0, sizeof(s_current_playing));
+    xSemaphoreTake(s_player_lock, portMAX_DELAY);
+    queue_clear();
+    // The deck heard last, so its resume point is the one kept
+    deck_t *cur = s_current ? s_current : &s_decks[0];
+    deck_stop(deck_other(cur));
+    deck_stop(cur);
+    xSemaphoreGive(s_player_lock);
     return ESP_OK;
 }
 
 bool audio_file_manager_is_playing(void)
 {
-    return s_playing;
+    return s_initialized && (!deck_idle(&s_decks[0]) || !deck_idle(&s_decks[1]));
+}
+
+esp_err_t audio_file_manager_resume(float volume, int duration)
+{
+    char track[128];
+    uint32_t position_ms = 0;
+    esp_err_t err = load_resume_point(track, sizeof(track), &position_ms);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ESP_LOGI(TAG, "Resuming %s at %" PRIu32 " ms", track, position_ms);
+    return audio_file_manager_play_at(track, volume, duration, position_ms);
+}
+
+esp_err_t audio_file_manager_get_position(audio_file_position_t *pos)
+{
+    if (!pos) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    deck_t *d = s_current;
+    if (!s_initialized || !d || deck_idle(d)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    strncpy(pos->name, d->name, sizeof(pos->name) - 1);
+    pos->name[sizeof(pos->name) - 1] = '\0';
+    pos->position_ms = deck_position_ms(d);
+    pos->duration_ms = d->duration_ms;
+    return ESP_OK;
 }
 
 esp_err_t audio_file_manager_get_all_names(char ***names, size_t *count)
@@ -840,24 +1466,80 @@ esp_err_t audio_file_manager_get_all_names(char ***names, size_t *count)
         ESP_RETURN_ON_ERROR(audio_file_manager_init(), TAG, "init failed");
     }
 
-    *count = s_file_count;
-    char **name_array = calloc(s_file_count, sizeof(char *));
+    catalog_lock();
+    size_t file_count = s_catalog.count;
+    char **name_array = calloc(file_count ? file_count : 1, sizeof(char *));
     if (!name_array) {
+        catalog_unlock();
         return ESP_ERR_NO_MEM;
     }
 
-    for (size_t i = 0; i < s_file_count; i++) {
-        name_array[i] = strdup(s_audio_files[i].name);
+    for (size_t i = 0; i < file_count; i++) {
+        name_array[i] = strdup(track_name((uint32_t)i));
         if (!name_array[i]) {
             // Free allocated strings on error
             for (size_t j = 0; j < i; j++) {
                 free(name_array[j]);
             }
             free(name_array);
+            catalog_unlock();
             return ESP_ERR_NO_MEM;
         }
     }
+    catalog_unlock();
 
+    *count = file_count;
     *names = name_array;
     return ESP_OK;
 }
+
+esp_err_t audio_file_manager_add_file(const char *path)
+{
+    if (!path) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *slash = strrchr(path, '/');
+    if (!slash || slash == path || !is_audio_file(slash + 1)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        ESP_RETURN_ON_ERROR(audio_file_manager_init(), TAG, "init failed");
+    }
+
+    char dir[128];
+    char name[128];
+    char display[128];
+    size_t dir_len = slash - path;
+    size_t name_len = strlen(slash + 1) - 4;
+    if (dir_len >= sizeof(dir) || name_len >= sizeof(name)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dir, path, dir_len);
+    dir[dir_len] = '\0';
+    memcpy(name, slash + 1, name_len);
+    name[name_len] = '\0';
+    make_display_name(name, display, sizeof(display));
+
+    sd_cache_invalidate(path);  // An upload may replace a file that was read before
+
+    catalog_lock();
+    uint32_t index;
+    esp_err_t err = track_catalog_add(&s_catalog, dir, slash + 1, display, &index);
+    if (err == ESP_OK) {
+        // An upload may replace a file of the same name: read its metadata again
+        s_catalog.entries[index].flags &= ~TRACK_CATALOG_INDEXED;
+        s_search_stale = true;
+        if (s_catalog_path[0]) {
+            track_catalog_save(&s_catalog, s_catalog_path);
+        }
+    }
+    catalog_unlock();
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to add %s: %s", path, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Added %s to the library", path);
+    start_indexer();
+    return ESP_OK;
+}
@@ -8,22 +8,59 @@
 extern "C" {
 #endif
 
+#define AUDIO_FILE_GAIN_UNKNOWN    INT16_MIN  // replay_gain of a file that carries none
+#define AUDIO_FILE_MATCH_MIN_SCORE 300        // A search match below this is a guess, not a request
+#define AUDIO_FILE_SEARCH_MAX      16         // Most matches one search returns
+
 /**
  * Audio file information
+ * The strings stay valid until reboot, even if the library changes.
  */
 typedef struct {
     const char *name;        // Song name (without .mp3 extension)
     const char *display_name; // Display name for UI
     const uint8_t *data;     // MP3 file data (NULL if not embedded)
     size_t data_len;         // MP3 file data length
+    uint32_t duration_ms;    // Track length, 0 until the file has been indexed
+    uint32_t sample_rate;    // 0 until indexed
+    uint16_t bitrate_kbps;   // Average, 0 until indexed
+    int16_t replay_gain;     // Track gain in 0.1 dB from a LAME tag, or AUDIO_FILE_GAIN_UNKNOWN
 } audio_file_info_t;
 
+/**
+ * A search result
+ */
+typedef struct {
+    audio_file_info_t info;
+    uint16_t score;          // 0-1000; 1000 is every word of the query, and nothing else
+} audio_file_match_t;
+
+/**
+ * What is playing and how far it has got
+ */
+typedef struct {
+    char name[128];          // Song name
+    uint32_t position_ms;    // Audio heard so far, from the start of the track
+    uint32_t duration_ms;    // Track length, 0 if not known yet
+} audio_file_position_t;
+
 /**
  * Initialize audio file manager
+ * The library comes from the catalog file in the sounds directory, so this does not
+ * list the directory; a background task picks up changes. Only the first boot (no
+ * catalog yet) lists it here.
  * @return ESP_OK on success
  */
 esp_err_t audio_file_manager_init(void);
 
+/**
+ * Add a file to the library, or update the track of the same name
+ * The catalog on SD is saved and the file indexed in the background.
+ * @param path: Full path of an MP3 or WAV file, e.g. after an upload
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if it is not an MP3 or WAV path
+ */
+esp_err_t audio_file_manager_add_file(const char *path);
+
 /**
  * Get number of available audio files
  * @return Number of files
@@ -40,14 +77,29 @@ esp_err_t audio_file_manager_get_by_index(size_t index, audio_file_info_t *info)
 
 /**
  * Get audio file info by name
+ * An exact name (ignoring case) first, otherwise the best search match if it scores
+ * at least AUDIO_FILE_MATCH_MIN_SCORE.
  * @param name: File name (with or without .mp3 extension)
  * @param info: Output file info structure
  * @return ESP_OK on success, ESP_ERR_NOT_FOUND if not found
  */
 esp_err_t audio_file_manager_get_by_name(const char *name, audio_file_info_t *info);
 
+/**
+ * Find tracks by what someone calls them: "the rain one", "ocean sleep", "chants third eye"
+ * Words are matched by trigrams against track and display names, so partial words,
+ * word order, small misspellings and 8.3 short names ("OCEAN_~1") still match.
+ * @param query: Free text
+ * @param matches: Output, best first
+ * @param max_matches: Size of matches; at most AUDIO_FILE_SEARCH_MAX are filled
+ * @return Number of matches, 0 if none
+ */
+size_t audio_file_manager_search(const char *query, audio_file_match_t *matches, size_t max_matches);
+
 /**
  * Play audio file by name
+ * Over a track already playing it crossfades in over CONFIG_AUDIO_CROSSFADE_MS.
+ * Clears the play queue.
  * @param name: File name (with or without .mp3 extension)
  * @param volume: Volume level (0.0 to 1.0)
  * @param duration: Duration in seconds (-1 for full file)
@@ -56,7 +108,59 @@ esp_err_t audio_file_manager_get_by_name(const char *name, audio_file_info_t *in
 esp_err_t audio_file_manager_play(const char *name, float volume, int duration);
 
 /**
- * Stop current playback
+ * Play audio file by name from a position
+ * MP3 seeks use the file's index: exact to the frame once it is built (it is cached
+ * next to the file), approximate before that.
+ * @param name: File name (with or without .mp3 extension)
+ * @param volume: Volume level (0.0 to 1.0)
+ * @param duration: Seconds of audio to play from start_ms (-1 for the rest of the file)
+ * @param start_ms: Position to start at
+ * @return ESP_OK on success
+ */
+esp_err_t audio_file_manager_play_at(const char *name, float volume, int duration, uint32_t start_ms);
+
+/**
+ * Queue a track to follow the current one
+ * It is decoded ahead on a second media stream and crossfaded in over the end of the
+ * current track (CONFIG_AUDIO_CROSSFADE_MS), or with no crossfade played straight
+ * after its last sample. Encoder delay and padding from a LAME tag are cut, so
+ * tracks made to run together play with no gap. Its start is prefetched.
+ * @param name: Track name, matched as for audio_file_manager_play()
+ * @param duration: Seconds to play (-1 for full file)
+ * @return ESP_OK once queued, or played at once if nothing is playing;
+ *         ESP_ERR_NOT_FOUND, ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t audio_file_manager_enqueue(const char *name, int duration);
+
+/**
+ * Resume the last track that was stopped before its end, where it was stopped
+ * The point is kept in NVS, so it survives a reboot.
+ * @param volume: Volume level (0.0 to 1.0)
+ * @param duration: As for audio_file_manager_play_at()
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if there is nothing to resume
+ */
+esp_err_t audio_file_manager_resume(float volume, int duration);
+
+/**
+ * Get the current track and position
+ * @param pos: Output position
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if nothing is playing
+ */
+esp_err_t audio_file_manager_get_position(audio_file_position_t *pos);
+
+/**
+ * Load the start of a track into the SD cache in the background
+ * For the next track of a routine (presleep, sleep, wakeup): when it is played it
+ * starts from memory, with no wait on the card. CONFIG_AUDIO_SD_PREFETCH_SEC of audio
+ * is loaded, sized from the track's bitrate.
+ * @param name: Track name, matched as for audio_file_manager_play()
+ * @return ESP_OK once queued, ESP_ERR_NOT_FOUND, ESP_ERR_INVALID_STATE without the cache
+ */
+esp_err_t audio_file_manager_prefetch(const char *name);
+
+/**
+ * Stop current playback and clear the play queue
+ * Returns once the decode tasks have ended.
  * @return ESP_OK on success
  */
 esp_err_t audio_file_manager_stop(void);
@@ -1,6 +1,11 @@
 #include "audio_player.h"
 
+#include <errno.h>
 #include <inttypes.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "driver/i2c.h"
@@ -9,8 +14,18 @@
 #define i2c_master_bus_handle_t i2c_port_t
 #define i2c_master_dev_handle_t i2c_cmd_handle_t
 #include "esp_check.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "audio_drc.h"
+#include "audio_eq.h"
+#include "audio_mixer.h"
+#include "audio_telemetry.h"
+#include "audio_volume.h"
+#include "pcm_ring.h"
+#include "wav_source.h"
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
 #include "driver/i2s_std.h"
 #else
@@ -18,6 +33,68 @@
 #endif
 
 #define AUDIO_PLAYER_I2C_FREQ_HZ 100000
+
+#ifndef CONFIG_AUDIO_PLAYBACK_RING_KB
+#define CONFIG_AUDIO_PLAYBACK_RING_KB 64
+#endif
+#ifndef CONFIG_AUDIO_PLAYBACK_TASK_PRIORITY
+#define CONFIG_AUDIO_PLAYBACK_TASK_PRIORITY 19
+#endif
+#ifndef CONFIG_AUDIO_EQ_ENABLED
+#define CONFIG_AUDIO_EQ_ENABLED 1
+#endif
+#ifndef CONFIG_AUDIO_DRC_ENABLED
+#define CONFIG_AUDIO_DRC_ENABLED 1
+#endif
+#ifndef CONFIG_AUDIO_DRC_THRESHOLD_DB
+#define CONFIG_AUDIO_DRC_THRESHOLD_DB (-18)
+#endif
+#ifndef CONFIG_AUDIO_DRC_RATIO
+#define CONFIG_AUDIO_DRC_RATIO 2
+#endif
+#ifndef CONFIG_AUDIO_DRC_ATTACK_MS
+#define CONFIG_AUDIO_DRC_ATTACK_MS 10
+#endif
+#ifndef CONFIG_AUDIO_DRC_RELEASE_MS
+#define CONFIG_AUDIO_DRC_RELEASE_MS 200
+#endif
+#ifndef CONFIG_AUDIO_DRC_MAKEUP_DB
+#define CONFIG_AUDIO_DRC_MAKEUP_DB 3
+#endif
+#ifndef CONFIG_AUDIO_DRC_LIMIT_DB
+#define CONFIG_AUDIO_DRC_LIMIT_DB (-1)
+#endif
+#ifndef CONFIG_AUDIO_DRC_LIMIT_RELEASE_MS
+#define CONFIG_AUDIO_DRC_LIMIT_RELEASE_MS 50
+#endif
+#ifndef CONFIG_AUDIO_DRC_LOOKAHEAD_MS
+#define CONFIG_AUDIO_DRC_LOOKAHEAD_MS 2
+#endif
+#ifndef CONFIG_AUDIO_VOLUME_RANGE_DB
+#define CONFIG_AUDIO_VOLUME_RANGE_DB 48
+#endif
+#ifndef CONFIG_AUDIO_VOLUME_HW_STEP_DB
+#define CONFIG_AUDIO_VOLUME_HW_STEP_DB 6
+#endif
+#ifndef CONFIG_AUDIO_VOLUME_RAMP_MS
+#define CONFIG_AUDIO_VOLUME_RAMP_MS 30
+#endif
+#ifndef CONFIG_AUDIO_DUCK_DB
+#define CONFIG_AUDIO_DUCK_DB 12
+#endif
+#ifndef CONFIG_AUDIO_DUCK_ATTACK_MS
+#define CONFIG_AUDIO_DUCK_ATTACK_MS 50
+#endif
+#ifndef CONFIG_AUDIO_DUCK_RELEASE_MS
+#define CONFIG_AUDIO_DUCK_RELEASE_MS 400
+#endif
+
+#define PLAYBACK_TASK_STACK    6144
+#define PLAYBACK_TASK_CORE     1          // Same core as MP3 decode, away from WiFi
+#define PLAYBACK_CHUNK_FRAMES  AUDIO_MIXER_CHUNK_FRAMES  // Frames mixed per I2S write
+#define PLAYBACK_DMA_DESC_NUM  6          // I2S DMA buffers, one mixed block each
+#define UNDERRUN_WINDOW_US     (250 * 1000)  // Shorter gaps between blocks are underruns, longer ones a new stream
+#define FILL_WINDOW_MS         1000       // Ring and DMA fill min/avg are published this often
 #define ES8311_ADDR_7BIT 0x18  // 7-bit I2C address (becomes 0x30 when shifted for 8-bit)
 
 // ES8311 register definitions (from es8311_reg.h)
@@ -53,26 +130,104 @@
 #define ES8311_GPIO_REG44        0x44
 #define ES8311_GP_REG45          0x45
 
+#define ES8311_DAC_VOL_FULL      0xD0  // DAC_REG32 at volume 1.0 (+8.5 dB, 0.5 dB per step, 0xBF = 0 dB)
+
+// Prepended to every submitted block in a stream ring. A block of no frames is a
+// crossfade cue from audio_player_queue_crossfade(), with no PCM after it.
+typedef struct {
+    uint32_t frames;
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t cue_stream;             // Cue: stream to fade in as this one fades out
+    uint32_t cue_ms;                 // Cue: crossfade time
+} pcm_block_hdr_t;
+
+typedef struct {
+    pcm_ring_t ring;
+    SemaphoreHandle_t submit_lock;   // Serializes producers; the ring is single-producer
+    SemaphoreHandle_t space_sem;     // Given by the feeder whenever it frees ring space
+    pcm_block_hdr_t block;           // Block the mixer is reading (feeder only)
+    uint32_t block_left;             // Frames left in it
+    volatile bool drained;           // Feeder found nothing queued after its last read
+    volatile bool held;              // Queued audio waits for a crossfade (cleared by the feeder)
+    bool fade_in;                    // Fade request, read by the feeder once its fade_mask bit is set
+    uint32_t fade_ms;
+    bool cue;                        // Feeder has read a crossfade cue, applied before the next chunk
+    pcm_block_hdr_t cue_hdr;
+    bool playing;                    // Feeder view: stream had data on the last peek
+    int64_t dry_since_us;
+    int submit_rate;                 // Format of the last submission, for buffered_ms
+    int submit_channels;
+    size_t fill_min;                 // Ring fill over the current window (feeder only)
+    uint32_t fill_sum;
+    uint32_t fill_samples;
+    audio_player_stats_t stats;      // Written by the feeder (rejected, overruns: by producers)
+} playback_stream_t;
+
 typedef struct {
     bool initialized;
     audio_player_config_t cfg;
-    int current_sample_rate;
+    int current_sample_rate;         // Fixed I2S rate; every stream is resampled to it
     i2c_master_bus_handle_t i2c_bus;
     i2c_master_dev_handle_t i2c_dev;
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
     i2s_chan_handle_t tx_handle;  // I2S TX channel handle (ESP-IDF 5.x)
 #endif
+    // Playback engine: producers fill per-stream rings, the feeder task mixes them into I2S
+    playback_stream_t streams[AUDIO_STREAM_COUNT];
+    audio_mixer_t *mixer;
+    audio_eq_t eq;                   // Speaker tuning on the mixed output, feeder-owned
+    volatile bool eq_enabled;        // Requested state, applied by the feeder
+    audio_drc_t drc;                 // Compressor and peak limiter after the EQ, feeder-owned
+    volatile bool drc_enabled;       // Requested state, applied by the feeder
+    float mix_f32[PLAYBACK_CHUNK_FRAMES * 2];  // Unclipped mix while the DRC is on
+    // One DMA buffer's worth: mixed, processed and handed to I2S in place, no staging copy
+    int16_t out_block[PLAYBACK_CHUNK_FRAMES * 2] __attribute__((aligned(4)));
+    // Volume: fine steps in software, whole steps in DAC_REG32 (feeder-owned apart from volume_level)
+    audio_volume_codec_t volume;
+    volatile float volume_level;     // Requested level 0..1
+    float volume_applied;            // Level the feeder last acted on
+    float volume_db;                 // Its total attenuation
+    // ES8311 register cache: last value written to each register
+    uint8_t codec_regs[256];
+    uint32_t codec_regs_valid[256 / 32];
+    TaskHandle_t feeder_task;
+    volatile bool feeder_running;
+    atomic_uint flush_mask;          // Streams to discard, bit per audio_stream_t
+    atomic_uint fade_mask;           // Streams with a fade request, bit per audio_stream_t
+    SemaphoreHandle_t fade_lock;     // Serializes fade requests
+    // The DMA ISR counts what it has sent, the feeder what it has written (telemetry, volume handover)
+    volatile uint32_t dma_sent_bytes;
+    volatile uint32_t dma_underruns;
+    uint32_t dma_written_bytes;
+    uint32_t dma_capacity;           // Bytes the DMA queue holds
+    uint32_t dma_fill_min;
+    uint32_t dma_fill_sum;
+    uint32_t dma_fill_samples;
+    uint8_t dma_fill_min_percent;    // Published at the end of each window
+    uint8_t dma_fill_avg_percent;
+    uint64_t fill_window_end;        // frames_played at which the window closes
+    bool mixing;                     // Last pass produced audio
+    uint64_t frames_played;
 } audio_player_state_t;
 
 static audio_player_state_t s_audio;
 static const char *TAG = "audio_player";
 
+// The playback task also writes (volume) and is not subscribed to the task watchdog
+static void es8311_feed_wdt(void)
+{
+    if (esp_task_wdt_status(NULL) == ESP_OK) {
+        esp_task_wdt_reset();
+    }
+}
+
 static esp_err_t es8311_write_reg(uint8_t reg, uint8_t value)
 {
     if (s_audio.i2c_bus == I2C_NUM_MAX) {
         return ESP_ERR_INVALID_STATE;
     }
-    esp_task_wdt_reset(); // Feed watchdog before I2C operation
+    es8311_feed_wdt(); // Feed watchdog before I2C operation
     // Use ESP-IDF v4.4 I2C API
     // ES8311_ADDR_7BIT is 7-bit address, shift to get 8-bit write address
     i2c_cmd_handle_t cmd = i2c_cmd_link_create();
@@ -83,13 +238,29 @@ static esp_err_t es8311_write_reg(uint8_t reg, uint8_t value)
     i2c_master_stop(cmd);
     esp_err_t err = i2c_master_cmd_begin(s_audio.i2c_bus, cmd, pdMS_TO_TICKS(100));
     i2c_cmd_link_delete(cmd);
-    esp_task_wdt_reset(); // Feed watchdog after I2C operation
+    es8311_feed_wdt(); // Feed watchdog after I2C operation
+    if (reg == ES8311_RESET_REG00) {
+        memset(s_audio.codec_regs_valid, 0, sizeof(s_audio.codec_regs_valid));
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "ES8311 write failed reg=0x%02x val=0x%02x err=%s", reg, value, esp_err_to_name(err));
+        s_audio.codec_regs_valid[reg / 32] &= ~(1u << (reg % 32));
+        return err;
     }
+    s_audio.codec_regs[reg] = value;
+    s_audio.codec_regs_valid[reg / 32] |= 1u << (reg % 32);
     return err;
 }
 
+// Skips the I2C transaction when the register already holds the value
+static esp_err_t es8311_write_reg_cached(uint8_t reg, uint8_t value)
+{
+    if ((s_audio.codec_regs_valid[reg / 32] & (1u << (reg % 32))) && s_audio.codec_regs[reg] == value) {
+        return ESP_OK;
+    }
+    return es8311_write_reg(reg, value);
+}
+
 static esp_err_t es8311_read_reg(uint8_t reg, uint8_t *value)
 {
     if (s_audio.i2c_bus == I2C_NUM_MAX || value == NULL) {
@@ -426,9 +597,9 @@ static esp_err_t es8311_init(void)
     
     // DAC configuration
     ESP_RETURN_ON_ERROR(es8311_write_reg(ES8311_DAC_REG31, 0x00), TAG, "dac 31"); // Unmute
-    // Volume: 0xFF = max, 0xE0 = ~-1dB, 0xD0 = ~-2dB, 0xC0 = ~0dB, 0xB0 = ~-3dB
-    // Using 0xD0 for good volume without distortion
-    ESP_RETURN_ON_ERROR(es8311_write_reg(ES8311_DAC_REG32, 0xD0), TAG, "dac 32"); // Good volume level
+    // Volume: 0.5 dB per step, 0xBF = 0 dB, 0xFF = +32 dB
+    // Using 0xD0 for good volume without distortion; audio_player_set_volume() steps down from it
+    ESP_RETURN_ON_ERROR(es8311_write_reg(ES8311_DAC_REG32, ES8311_DAC_VOL_FULL), TAG, "dac 32"); // Good volume level
     
     // Additional registers from es8311_open
     // SYSTEM_REG13: May control output routing or bias
@@ -538,12 +709,32 @@ static esp_err_t configure_i2c(const audio_player_config_t *cfg)
     return ESP_OK;
 }
 
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+static bool IRAM_ATTR i2s_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    s_audio.dma_sent_bytes += event->size;
+    return false;
+}
+
+// Every DMA buffer has been played and none refilled: the driver repeats cleared buffers
+static bool IRAM_ATTR i2s_on_send_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    if (s_audio.mixing) {
+        s_audio.dma_underruns++;
+    }
+    return false;
+}
+#endif
+
 static esp_err_t configure_i2s(const audio_player_config_t *cfg)
 {
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
     // ESP-IDF 5.x: Use new I2S driver API
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(cfg->i2s_port, I2S_ROLE_MASTER);
     chan_cfg.auto_clear = true;  // Auto clear the legacy data in the DMA buffer
+    // One mixed block per DMA buffer, so each write is a single aligned copy into one buffer
+    chan_cfg.dma_desc_num = PLAYBACK_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = PLAYBACK_CHUNK_FRAMES;
     ESP_RETURN_ON_ERROR(i2s_new_channel(&chan_cfg, &s_audio.tx_handle, NULL), TAG, "create I2S TX channel failed");
     
     i2s_std_config_t std_cfg = {
@@ -563,6 +754,12 @@ static esp_err_t configure_i2s(const audio_player_config_t *cfg)
         },
     };
     ESP_RETURN_ON_ERROR(i2s_channel_init_std_mode(s_audio.tx_handle, &std_cfg), TAG, "init I2S std mode failed");
+    s_audio.dma_capacity = chan_cfg.dma_desc_num * chan_cfg.dma_frame_num * 2 * sizeof(int16_t);
+    i2s_event_callbacks_t cbs = {
+        .on_sent = i2s_on_sent,
+        .on_send_q_ovf = i2s_on_send_q_ovf,
+    };
+    ESP_RETURN_ON_ERROR(i2s_channel_register_event_callback(s_audio.tx_handle, &cbs, NULL), TAG, "i2s callbacks");
     ESP_RETURN_ON_ERROR(i2s_channel_enable(s_audio.tx_handle), TAG, "enable I2S channel failed");
     ESP_LOGI(TAG, "I2S driver started on port %d (ESP-IDF 5.x)", cfg->i2s_port);
 #else
@@ -574,8 +771,8 @@ static esp_err_t configure_i2s(const audio_player_config_t *cfg)
         .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
         .communication_format = I2S_COMM_FORMAT_STAND_I2S,
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = 6,
-        .dma_buf_len = 256,
+        .dma_buf_count = PLAYBACK_DMA_DESC_NUM,
+        .dma_buf_len = PLAYBACK_CHUNK_FRAMES,
         .use_apll = false,  // Don't use APLL when codec generates MCLK from BCLK
         .tx_desc_auto_clear = true,
         .fixed_mclk = 0,  // No fixed MCLK - codec generates it from BCLK (use_mclk=false)
@@ -598,6 +795,8 @@ static esp_err_t configure_i2s(const audio_player_config_t *cfg)
     return ESP_OK;
 }
 
+static esp_err_t playback_engine_start(void);
+
 esp_err_t audio_player_init(const audio_player_config_t *cfg)
 {
     ESP_RETURN_ON_FALSE(cfg, ESP_ERR_INVALID_ARG, TAG, "cfg required");
@@ -632,507 +831,871 @@ esp_err_t audio_player_init(const audio_player_config_t *cfg)
     esp_task_wdt_reset(); // Feed watchdog after codec init
     ESP_LOGI(TAG, "ES8311 codec initialized");
 
+    ESP_RETURN_ON_ERROR(playback_engine_start(), TAG, "playback engine");
+
     s_audio.initialized = true;
     ESP_LOGI(TAG, "Audio player ready (sr=%d)", s_audio.current_sample_rate);
     return ESP_OK;
 }
 
-static esp_err_t ensure_sample_rate(int sample_rate_hz)
+// DMA queue fill just before a write: bytes written minus bytes the ISR reports sent
+static void sample_dma_fill(void)
 {
-    if (!s_audio.initialized || sample_rate_hz <= 0) {
-        return ESP_ERR_INVALID_STATE;
+    uint32_t sent = s_audio.dma_sent_bytes;
+    int32_t queued = (int32_t)(s_audio.dma_written_bytes - sent);
+    if (queued < 0) {
+        // Cleared buffers went out while idle; count from here
+        s_audio.dma_written_bytes = sent;
+        queued = 0;
     }
-    if (sample_rate_hz == s_audio.current_sample_rate) {
-        return ESP_OK;
+    uint32_t fill = (uint32_t)queued < s_audio.dma_capacity ? (uint32_t)queued : s_audio.dma_capacity;
+    if (s_audio.dma_fill_samples == 0 || fill < s_audio.dma_fill_min) {
+        s_audio.dma_fill_min = fill;
+    }
+    s_audio.dma_fill_sum += fill;
+    s_audio.dma_fill_samples++;
+}
+
+// Write one stereo block straight from the feeder's buffer; the driver copies it into
+// the next free DMA buffer, which it fills exactly
+static esp_err_t write_output_block(const int16_t *block, size_t frames)
+{
+    size_t bytes_to_write = frames * sizeof(int16_t) * 2;
+    size_t total_written = 0;
+
+    // Log the first block to verify audio data
+    static bool first_write_logged = false;
+    if (!first_write_logged) {
+        ESP_LOGI(TAG, "🔊 First I2S write: %zu frames, first 4 PCM samples: %d, %d, %d, %d",
+                 frames, block[0], block[1], block[2], block[3]);
+        first_write_logged = true;
     }
+
+    sample_dma_fill();
+    int64_t write_start = esp_timer_get_time();
+    while (total_written < bytes_to_write) {
+        size_t bytes_written = 0;
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-    // ESP-IDF 5.x: Disable channel, reconfigure clock, then re-enable
-    ESP_RETURN_ON_ERROR(i2s_channel_disable(s_audio.tx_handle), TAG, "disable channel for reconfig");
-    i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate_hz);
-    ESP_RETURN_ON_ERROR(i2s_channel_reconfig_std_clock(s_audio.tx_handle, &clk_cfg), TAG, "reconfig clock");
-    ESP_RETURN_ON_ERROR(i2s_channel_enable(s_audio.tx_handle), TAG, "re-enable channel after reconfig");
+        // ESP-IDF 5.x: Use new I2S channel write API
+        esp_err_t err = i2s_channel_write(s_audio.tx_handle,
+                                           (const uint8_t *)block + total_written,
+                                           bytes_to_write - total_written,
+                                           &bytes_written,
+                                           portMAX_DELAY);
 #else
-    // ESP-IDF 4.x: Use legacy API
-    ESP_RETURN_ON_ERROR(
-        i2s_set_clk(s_audio.cfg.i2s_port,
-                    sample_rate_hz,
-                    I2S_BITS_PER_SAMPLE_16BIT,
-                    I2S_CHANNEL_STEREO),
-        TAG,
-        "set clk");
+        // ESP-IDF 4.x: Use legacy API
+        esp_err_t err = i2s_write(s_audio.cfg.i2s_port,
+                                  (const uint8_t *)block + total_written,
+                                  bytes_to_write - total_written,
+                                  &bytes_written,
+                                  portMAX_DELAY);
 #endif
-    s_audio.current_sample_rate = sample_rate_hz;
-    ESP_LOGI(TAG, "Playback sample rate -> %d Hz", sample_rate_hz);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "I2S write failed: %s", esp_err_to_name(err));
+            return err;
+        }
+        if (bytes_written == 0) {
+            ESP_LOGW(TAG, "I2S write returned 0 bytes");
+            vTaskDelay(pdMS_TO_TICKS(1));
+            continue;
+        }
+        total_written += bytes_written;
+    }
+    audio_telemetry_record(AUDIO_TELEMETRY_I2S_WRITE, (uint32_t)(esp_timer_get_time() - write_start));
+    s_audio.dma_written_bytes += bytes_to_write;
     return ESP_OK;
 }
 
-static esp_err_t write_pcm_frames(const int16_t *samples, size_t sample_count, int num_channels)
+// --- playback engine ------------------------------------------------------------
+
+static const uint8_t s_stream_priority[AUDIO_STREAM_COUNT] = {
+    [AUDIO_STREAM_MEDIA] = 0,
+    [AUDIO_STREAM_MEDIA_ALT] = 0,
+    [AUDIO_STREAM_VOICE] = 1,
+    [AUDIO_STREAM_ALERT] = 2,
+};
+
+// Mixer source callbacks, run on the feeder task
+
+static bool stream_peek_format(void *ctx, audio_mixer_format_t *fmt)
 {
-    ESP_RETURN_ON_FALSE(samples && sample_count > 0, ESP_ERR_INVALID_ARG, TAG, "bad pcm args");
-    ESP_RETURN_ON_FALSE(num_channels == 1 || num_channels == 2, ESP_ERR_INVALID_ARG, TAG, "channels");
+    playback_stream_t *st = ctx;
+    if (st->held) {
+        return false;  // Decoded ahead, waiting to be crossfaded in
+    }
+    while (st->block_left == 0) {
+        if (pcm_ring_used(&st->ring) < sizeof(st->block)) {
+            if (st->playing) {
+                st->playing = false;
+                st->stats.playing = false;
+                st->dry_since_us = esp_timer_get_time();
+            }
+            return false;
+        }
+        pcm_ring_read(&st->ring, &st->block, sizeof(st->block));
+        st->block_left = st->block.frames;
+        if (st->block.frames == 0) {
+            // Started on the next chunk, together with the stream it fades in
+            st->cue = true;
+            st->cue_hdr = st->block;
+        }
+    }
+    if (!st->playing) {
+        // Data arriving shortly after the ring ran dry means the producer fell behind
+        int64_t gap_us = esp_timer_get_time() - st->dry_since_us;
+        if (st->dry_since_us != 0 && gap_us < UNDERRUN_WINDOW_US) {
+            st->stats.underruns++;
+            st->stats.underrun_ms += (uint32_t)(gap_us / 1000);
+        }
+        st->playing = true;
+        st->stats.playing = true;
+    }
+    fmt->sample_rate = st->block.sample_rate;
+    fmt->channels = (uint8_t)st->block.channels;
+    return true;
+}
+
+static size_t stream_read(void *ctx, int16_t *dst, size_t max_frames)
+{
+    playback_stream_t *st = ctx;
+    size_t frames = st->block_left < max_frames ? st->block_left : max_frames;
+    size_t bytes = frames * st->block.channels * sizeof(int16_t);
+    size_t got = pcm_ring_read(&st->ring, dst, bytes);
+    st->drained = false;
+    if (got != bytes) {
+        ESP_LOGE(TAG, "PCM ring out of sync (%zu of %zu bytes), discarding", got, bytes);
+        pcm_ring_discard(&st->ring);
+        st->block_left = 0;
+        return 0;
+    }
+    st->block_left -= frames;
+    st->stats.frames_played += frames;
+    return frames;
+}
+
+static void volume_write_hw(float hw_db)
+{
+    int reg = ES8311_DAC_VOL_FULL + (int)floorf(hw_db * 2.0f + 0.5f);
+    if (reg < 0) {
+        reg = 0;
+    }
+    es8311_write_reg_cached(ES8311_DAC_REG32, (uint8_t)reg);
+}
+
+// Runs on the feeder before each block. Software ramps start on this block; the codec
+// takes whole steps, handed over so that the total level stays continuous. The register
+// is written once the DMA ISR has sent everything queued ahead of the handover block.
+static void volume_update(bool playing)
+{
+    float level = s_audio.volume_level;
+    if (level != s_audio.volume_applied) {
+        s_audio.volume_applied = level;
+        s_audio.volume_db = audio_volume_level_to_db(level, CONFIG_AUDIO_VOLUME_RANGE_DB);
+        ESP_LOGI(TAG, "Volume %.2f (%.1f dB)", level, s_audio.volume_db);
+    }
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    uint32_t played = s_audio.dma_sent_bytes;
+#else
+    uint32_t played = s_audio.dma_written_bytes;  // No sent callback: step as the block is written
+#endif
+    float hw_db;
+    if (audio_volume_codec_update(&s_audio.volume, s_audio.volume_db, playing,
+                                  s_audio.dma_written_bytes, played, &hw_db)) {
+        volume_write_hw(hw_db);
+    }
+}
 
-    const size_t chunk_frames = 256;
-    // Allocate stereo buffer on stack (stack is in internal RAM, DMA-accessible)
-    // I2S DMA will copy from this buffer in task context, not interrupt context
-    // All processing happens in task context - I2S interrupt only handles DMA transfers
-    int16_t stereo_buffer[chunk_frames * 2];
-
-    size_t frames_written = 0;
-    static size_t total_frames_written = 0;  // Track total frames for diagnostics
-    while (frames_written < sample_count) {
-        size_t frames_this = chunk_frames;
-        if (frames_this > sample_count - frames_written) {
-            frames_this = sample_count - frames_written;
+static uint8_t fill_percent(uint32_t bytes, size_t capacity)
+{
+    return capacity ? (uint8_t)((uint64_t)bytes * 100 / capacity) : 0;
+}
+
+// Once per mixed block: sample the fill of every stream with data, and publish the
+// window's min/avg (ring and DMA) when it closes
+static void update_fill_stats(void)
+{
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        playback_stream_t *st = &s_audio.streams[i];
+        if (!st->playing) {
+            continue;
+        }
+        size_t used = pcm_ring_used(&st->ring);
+        if (st->fill_samples == 0 || used < st->fill_min) {
+            st->fill_min = used;
+        }
+        st->fill_sum += (uint32_t)used;
+        st->fill_samples++;
+    }
+    if (s_audio.frames_played < s_audio.fill_window_end) {
+        return;
+    }
+    s_audio.fill_window_end = s_audio.frames_played + (uint64_t)s_audio.current_sample_rate * FILL_WINDOW_MS / 1000;
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        playback_stream_t *st = &s_audio.streams[i];
+        if (st->fill_samples > 0) {
+            st->stats.fill_min_percent = fill_percent(st->fill_min, st->ring.size);
+            st->stats.fill_avg_percent = fill_percent(st->fill_sum / st->fill_samples, st->ring.size);
         }
+        st->fill_sum = 0;
+        st->fill_samples = 0;
+    }
+    if (s_audio.dma_fill_samples > 0) {
+        s_audio.dma_fill_min_percent = fill_percent(s_audio.dma_fill_min, s_audio.dma_capacity);
+        s_audio.dma_fill_avg_percent =
+            fill_percent(s_audio.dma_fill_sum / s_audio.dma_fill_samples, s_audio.dma_capacity);
+    }
+    s_audio.dma_fill_sum = 0;
+    s_audio.dma_fill_samples = 0;
+}
 
-        if (num_channels == 1) {
-            for (size_t i = 0; i < frames_this; ++i) {
-                int16_t sample = samples[frames_written + i];
-                stereo_buffer[2 * i] = sample;
-                stereo_buffer[2 * i + 1] = sample;
+// Speaker processing on one mixed block. With the DRC on, the block comes from the float
+// mix so overs between streams and from the EQ reach the limiter instead of clipping.
+static void process_output(int16_t *mix_buf)
+{
+    if (s_audio.drc.enabled) {
+        audio_eq_process_f32(&s_audio.eq, s_audio.mix_f32, PLAYBACK_CHUNK_FRAMES);
+        audio_drc_process(&s_audio.drc, s_audio.mix_f32, mix_buf, PLAYBACK_CHUNK_FRAMES);
+    } else {
+        audio_eq_process_s16(&s_audio.eq, mix_buf, PLAYBACK_CHUNK_FRAMES);
+    }
+    audio_volume_process_s16(&s_audio.volume.sw, mix_buf, PLAYBACK_CHUNK_FRAMES);
+}
+
+// Fade requests and crossfade cues, applied between chunks so both sides of a
+// crossfade start on the same output frame
+static void apply_fades(void)
+{
+    unsigned fades = atomic_exchange(&s_audio.fade_mask, 0);
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        playback_stream_t *st = &s_audio.streams[i];
+        if (fades & (1u << i)) {
+            audio_mixer_fade(s_audio.mixer, i, st->fade_in, st->fade_ms);
+            if (st->fade_in) {
+                st->held = false;
             }
-        } else {
-            memcpy(stereo_buffer,
-                   &samples[(frames_written)*2],
-                   frames_this * sizeof(int16_t) * 2);
         }
+    }
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        playback_stream_t *st = &s_audio.streams[i];
+        if (!st->cue) {
+            continue;
+        }
+        st->cue = false;
+        int to = st->cue_hdr.cue_stream;
+        ESP_LOGI(TAG, "Crossfade stream %d -> %d over %" PRIu32 " ms", i, to, st->cue_hdr.cue_ms);
+        audio_mixer_fade(s_audio.mixer, i, false, st->cue_hdr.cue_ms);
+        audio_mixer_fade(s_audio.mixer, to, true, st->cue_hdr.cue_ms);
+        s_audio.streams[to].held = false;
+    }
+}
 
-        size_t bytes_to_write = frames_this * sizeof(int16_t) * 2;
-        size_t total_written = 0;
-        
-        // Log first chunk and every second to verify audio data
-        static bool first_write_logged = false;
-        static size_t write_count = 0;
-        write_count++;
-
-        if (!first_write_logged && frames_written == 0) {
-            ESP_LOGI(TAG, "🔊 First I2S write: %zu frames, first 4 PCM samples: %d, %d, %d, %d",
-                     frames_this, stereo_buffer[0], stereo_buffer[1], stereo_buffer[2], stereo_buffer[3]);
-            first_write_logged = true;
+static void playback_task(void *arg)
+{
+    (void)arg;
+    int16_t *mix_buf = s_audio.out_block;
+
+    ESP_LOGI(TAG, "Playback task started (%d streams, %zu-byte rings)",
+             AUDIO_STREAM_COUNT, s_audio.streams[0].ring.size);
+
+    while (s_audio.feeder_running) {
+        unsigned flush = atomic_exchange(&s_audio.flush_mask, 0);
+        for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+            if (flush & (1u << i)) {
+                playback_stream_t *st = &s_audio.streams[i];
+                pcm_ring_discard(&st->ring);
+                st->block_left = 0;
+                st->cue = false;
+                audio_mixer_reset_stream(s_audio.mixer, i);
+                if (st->held) {
+                    audio_mixer_fade(s_audio.mixer, i, false, 0);
+                }
+                xSemaphoreGive(st->space_sem);
+            }
         }
+        apply_fades();
 
-        // Log every 1000th write (~6 seconds at 16kHz) to verify continuous writing
-        if (write_count % 1000 == 0) {
-            ESP_LOGI(TAG, "🔊 I2S write #%zu: %zu frames, RMS level: %d",
-                     write_count, frames_this, (int)((stereo_buffer[0] + stereo_buffer[2]) / 2));
+        if (s_audio.drc.enabled != s_audio.drc_enabled) {
+            audio_drc_reset(&s_audio.drc);
+            s_audio.drc.enabled = s_audio.drc_enabled;
         }
-        
-        while (total_written < bytes_to_write) {
-            size_t bytes_written = 0;
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
-            // ESP-IDF 5.x: Use new I2S channel write API
-            esp_err_t err = i2s_channel_write(s_audio.tx_handle,
-                                               (uint8_t *)stereo_buffer + total_written,
-                                               bytes_to_write - total_written,
-                                               &bytes_written,
-                                               portMAX_DELAY);
-#else
-            // ESP-IDF 4.x: Use legacy API
-            esp_err_t err = i2s_write(s_audio.cfg.i2s_port,
-                                      (uint8_t *)stereo_buffer + total_written,
-                                      bytes_to_write - total_written,
-                                      &bytes_written,
-                                      portMAX_DELAY);
-#endif
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "I2S write failed: %s", esp_err_to_name(err));
-                return err;
+        int streams = s_audio.drc.enabled
+                          ? audio_mixer_process_f32(s_audio.mixer, s_audio.mix_f32, PLAYBACK_CHUNK_FRAMES)
+                          : audio_mixer_process(s_audio.mixer, mix_buf, PLAYBACK_CHUNK_FRAMES);
+        for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+            xSemaphoreGive(s_audio.streams[i].space_sem);
+        }
+
+        if (streams == 0) {
+            if (s_audio.mixing && s_audio.drc.enabled) {
+                // The limiter still holds its look-ahead; push it out with this silent block
+                volume_update(true);
+                process_output(mix_buf);
+                if (write_output_block(mix_buf, PLAYBACK_CHUNK_FRAMES) == ESP_OK) {
+                    s_audio.frames_played += PLAYBACK_CHUNK_FRAMES;
+                }
             }
-            if (bytes_written == 0) {
-                ESP_LOGW(TAG, "I2S write returned 0 bytes");
-                vTaskDelay(pdMS_TO_TICKS(1));
-                continue;
+            // Everything read so far has been written; empty streams are now idle
+            s_audio.mixing = false;
+            for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+                s_audio.streams[i].drained = true;
             }
-            total_written += bytes_written;
+            volume_update(false);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+            continue;
         }
-        frames_written += frames_this;
-        total_frames_written += frames_this;
-        
-        // Log every 10000 frames (~0.23 seconds at 44.1kHz) to track playback
-        if (total_frames_written % 10000 == 0) {
-            ESP_LOGI(TAG, "Audio playback: %zu frames written to I2S", total_frames_written);
+        if (!s_audio.mixing || s_audio.eq.enabled != s_audio.eq_enabled) {
+            // Don't ring out the tail of unrelated audio into this one
+            audio_eq_reset(&s_audio.eq);
+            s_audio.eq.enabled = s_audio.eq_enabled;
+        }
+        if (!s_audio.mixing) {
+            audio_drc_reset(&s_audio.drc);
+        }
+        s_audio.mixing = true;
+        volume_update(true);
+        process_output(mix_buf);
+
+        if (write_output_block(mix_buf, PLAYBACK_CHUNK_FRAMES) == ESP_OK) {
+            s_audio.frames_played += PLAYBACK_CHUNK_FRAMES;
+        }
+        update_fill_stats();
+        for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+            playback_stream_t *st = &s_audio.streams[i];
+            if (!st->playing && st->block_left == 0) {
+                st->drained = true;
+            }
+        }
+    }
+
+    s_audio.feeder_task = NULL;
+    vTaskDelete(NULL);
+}
+
+static esp_err_t playback_engine_start(void)
+{
+    // Largest power of two that fits the configured size
+    size_t ring_size = 1;
+    while (ring_size * 2 <= (size_t)CONFIG_AUDIO_PLAYBACK_RING_KB * 1024) {
+        ring_size *= 2;
+    }
+
+    // The mixer runs every few milliseconds; keep its scratch in internal RAM when possible
+    s_audio.mixer = heap_caps_malloc(sizeof(audio_mixer_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_audio.mixer) {
+        s_audio.mixer = malloc(sizeof(audio_mixer_t));
+        if (!s_audio.mixer) {
+            return ESP_ERR_NO_MEM;
         }
     }
+    ESP_RETURN_ON_ERROR(audio_mixer_init(s_audio.mixer, (uint32_t)s_audio.current_sample_rate), TAG, "mixer");
+    // Design the filter banks for the usual source rates now rather than on the feeder
+    static const uint32_t source_rates[] = { 16000, 22050, 24000, 32000, 44100, 48000 };
+    if (audio_resampler_prepare((uint32_t)s_audio.current_sample_rate, source_rates,
+                                sizeof(source_rates) / sizeof(source_rates[0])) != ESP_OK) {
+        ESP_LOGW(TAG, "Resampler banks not all allocated; missing ones are built on first use");
+    }
+    audio_mixer_set_ducking(s_audio.mixer, CONFIG_AUDIO_DUCK_DB, CONFIG_AUDIO_DUCK_ATTACK_MS,
+                            CONFIG_AUDIO_DUCK_RELEASE_MS);
+    ESP_RETURN_ON_ERROR(audio_eq_init_default(&s_audio.eq, (uint32_t)s_audio.current_sample_rate), TAG, "eq");
+    s_audio.eq_enabled = CONFIG_AUDIO_EQ_ENABLED;
+    s_audio.eq.enabled = s_audio.eq_enabled;
+    const audio_drc_config_t drc_cfg = {
+        .threshold_db = CONFIG_AUDIO_DRC_THRESHOLD_DB,
+        .ratio = CONFIG_AUDIO_DRC_RATIO,
+        .attack_ms = CONFIG_AUDIO_DRC_ATTACK_MS,
+        .release_ms = CONFIG_AUDIO_DRC_RELEASE_MS,
+        .makeup_db = CONFIG_AUDIO_DRC_MAKEUP_DB,
+        .limit_db = CONFIG_AUDIO_DRC_LIMIT_DB,
+        .limit_release_ms = CONFIG_AUDIO_DRC_LIMIT_RELEASE_MS,
+        .lookahead_ms = CONFIG_AUDIO_DRC_LOOKAHEAD_MS,
+    };
+    ESP_RETURN_ON_ERROR(audio_drc_init(&s_audio.drc, (uint32_t)s_audio.current_sample_rate, &drc_cfg), TAG, "drc");
+    s_audio.drc_enabled = CONFIG_AUDIO_DRC_ENABLED;
+    s_audio.drc.enabled = s_audio.drc_enabled;
+    ESP_RETURN_ON_ERROR(audio_volume_codec_init(&s_audio.volume, (uint32_t)s_audio.current_sample_rate,
+                                                CONFIG_AUDIO_VOLUME_RAMP_MS, CONFIG_AUDIO_VOLUME_HW_STEP_DB),
+                        TAG, "volume");
+    s_audio.volume_level = 1.0f;
+    s_audio.volume_applied = 1.0f;
+
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        playback_stream_t *st = &s_audio.streams[i];
+        ESP_RETURN_ON_ERROR(pcm_ring_init(&st->ring, ring_size), TAG, "pcm ring");
+        st->submit_lock = xSemaphoreCreateMutex();
+        st->space_sem = xSemaphoreCreateBinary();
+        if (!st->submit_lock || !st->space_sem) {
+            return ESP_ERR_NO_MEM;
+        }
+        st->drained = true;
+        st->stats.ring_capacity = ring_size;
+        audio_mixer_source_t src = {
+            .peek_format = stream_peek_format,
+            .read = stream_read,
+            .ctx = st,
+        };
+        ESP_RETURN_ON_ERROR(audio_mixer_attach(s_audio.mixer, i, &src, s_stream_priority[i]), TAG, "attach");
+    }
+    atomic_init(&s_audio.flush_mask, 0);
+    atomic_init(&s_audio.fade_mask, 0);
+    s_audio.fade_lock = xSemaphoreCreateMutex();
+    if (!s_audio.fade_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_audio.feeder_running = true;
+
+    BaseType_t ret = xTaskCreatePinnedToCore(playback_task,
+                                             "audio_feeder",
+                                             PLAYBACK_TASK_STACK,
+                                             NULL,
+                                             CONFIG_AUDIO_PLAYBACK_TASK_PRIORITY,
+                                             &s_audio.feeder_task,
+                                             PLAYBACK_TASK_CORE);
+    if (ret != pdPASS) {
+        s_audio.feeder_running = false;
+        return ESP_ERR_NO_MEM;
+    }
     return ESP_OK;
 }
 
-typedef struct __attribute__((packed)) {
-    char chunk_id[4];
-    uint32_t chunk_size;
-    char format[4];
-} wav_header_t;
+static void playback_engine_stop(void)
+{
+    if (s_audio.feeder_task) {
+        s_audio.feeder_running = false;
+        xTaskNotifyGive(s_audio.feeder_task);
+        // The feeder may be inside a DMA write; give it a few buffers' worth of time
+        for (int i = 0; i < 100 && s_audio.feeder_task != NULL; i++) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        playback_stream_t *st = &s_audio.streams[i];
+        if (st->submit_lock) {
+            vSemaphoreDelete(st->submit_lock);
+        }
+        if (st->space_sem) {
+            vSemaphoreDelete(st->space_sem);
+        }
+        pcm_ring_deinit(&st->ring);
+    }
+    if (s_audio.fade_lock) {
+        vSemaphoreDelete(s_audio.fade_lock);
+        s_audio.fade_lock = NULL;
+    }
+    heap_caps_free(s_audio.mixer);
+    s_audio.mixer = NULL;
+}
 
-typedef struct __attribute__((packed)) {
-    uint16_t audio_format;
-    uint16_t num_channels;
-    uint32_t sample_rate;
-    uint32_t byte_rate;
-    uint16_t block_align;
-    uint16_t bits_per_sample;
-} wav_fmt_body_t;
+// Caller holds the stream's submit_lock
+static esp_err_t enqueue_block(playback_stream_t *st, const int16_t *samples, size_t frames,
+                               int sample_rate_hz, int num_channels)
+{
+    pcm_block_hdr_t hdr = {
+        .frames = (uint32_t)frames,
+        .sample_rate = (uint32_t)sample_rate_hz,
+        .channels = (uint16_t)num_channels,
+    };
+    esp_err_t err = pcm_ring_write(&st->ring, &hdr, sizeof(hdr),
+                                   samples, frames * num_channels * sizeof(int16_t));
+    if (err == ESP_OK) {
+        st->submit_rate = sample_rate_hz;
+        st->submit_channels = num_channels;
+        xTaskNotifyGive(s_audio.feeder_task);
+    }
+    return err;
+}
 
-esp_err_t audio_player_play_wav(const uint8_t *wav_data, size_t wav_len, audio_progress_callback_t progress_cb)
+esp_err_t audio_player_stream_submit(audio_stream_t stream,
+                                     const int16_t *samples,
+                                     size_t sample_count,
+                                     int sample_rate_hz,
+                                     int num_channels,
+                                     TickType_t timeout,
+                                     size_t *frames_queued)
 {
+    if (frames_queued) {
+        *frames_queued = 0;
+    }
     ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
-    ESP_RETURN_ON_FALSE(wav_data && wav_len > sizeof(wav_header_t), ESP_ERR_INVALID_ARG, TAG, "bad wav");
-
-    // Debug: log first few bytes to verify data
-    ESP_LOGI(TAG, "=== WAV FILE VERIFICATION ===");
-    ESP_LOGI(TAG, "WAV data: len=%zu bytes (%.2f MB)", wav_len, wav_len / (1024.0f * 1024.0f));
-    ESP_LOGI(TAG, "First 32 bytes: %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x %02x",
-             wav_data[0], wav_data[1], wav_data[2], wav_data[3],
-             wav_data[4], wav_data[5], wav_data[6], wav_data[7],
-             wav_data[8], wav_data[9], wav_data[10], wav_data[11],
-             wav_data[12], wav_data[13], wav_data[14], wav_data[15],
-             wav_data[16], wav_data[17], wav_data[18], wav_data[19],
-             wav_data[20], wav_data[21], wav_data[22], wav_data[23],
-             wav_data[24], wav_data[25], wav_data[26], wav_data[27],
-             wav_data[28], wav_data[29], wav_data[30], wav_data[31]);
-    
-    // Check RIFF header
-    if (wav_len >= 4 && wav_data[0] == 'R' && wav_data[1] == 'I' && wav_data[2] == 'F' && wav_data[3] == 'F') {
-        ESP_LOGI(TAG, "✓ Valid RIFF header");
-    } else {
-        ESP_LOGE(TAG, "✗ INVALID RIFF HEADER! First 4 bytes: %02x %02x %02x %02x",
-                 wav_data[0], wav_data[1], wav_data[2], wav_data[3]);
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    const uint8_t *ptr = wav_data;
-    const uint8_t *end = wav_data + wav_len;
-    const wav_header_t *hdr = (const wav_header_t *)ptr;
-    if (memcmp(hdr->chunk_id, "RIFF", 4) != 0 || memcmp(hdr->format, "WAVE", 4) != 0) {
-        ESP_LOGE(TAG, "Invalid WAV header: chunk_id=%.4s, format=%.4s", hdr->chunk_id, hdr->format);
-        return ESP_ERR_INVALID_ARG;
-    }
-    ptr += sizeof(wav_header_t);
-
-    wav_fmt_body_t fmt = {0};
-    bool fmt_found = false;
-    const uint8_t *data_ptr = NULL;
-    uint32_t data_size = 0;
-
-    while (ptr + 8 <= end) {
-        char chunk_id[4];
-        memcpy(chunk_id, ptr, 4);
-        uint32_t chunk_size = *(const uint32_t *)(ptr + 4);
-        ptr += 8;
-        if (ptr + chunk_size > end) {
-            ESP_LOGE(TAG, "Chunk extends beyond end: chunk_size=%" PRIu32 ", remaining=%zu", chunk_size, end - ptr);
-            return ESP_ERR_INVALID_ARG;
+    ESP_RETURN_ON_FALSE((unsigned)stream < AUDIO_STREAM_COUNT, ESP_ERR_INVALID_ARG, TAG, "stream");
+    ESP_RETURN_ON_FALSE(samples && sample_count > 0 && sample_rate_hz > 0, ESP_ERR_INVALID_ARG, TAG, "bad pcm args");
+    ESP_RETURN_ON_FALSE(num_channels == 1 || num_channels == 2, ESP_ERR_INVALID_ARG, TAG, "channels");
+    playback_stream_t *st = &s_audio.streams[stream];
+
+    if (timeout == 0) {
+        // Non-blocking: the whole block or nothing
+        if (sizeof(pcm_block_hdr_t) + sample_count * num_channels * sizeof(int16_t) > st->ring.size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t err = ESP_ERR_TIMEOUT;
+        if (xSemaphoreTake(st->submit_lock, 0) == pdTRUE) {
+            err = enqueue_block(st, samples, sample_count, sample_rate_hz, num_channels);
+            xSemaphoreGive(st->submit_lock);
+        }
+        if (err != ESP_OK) {
+            st->stats.rejected++;
+            return ESP_ERR_TIMEOUT;
+        }
+        if (frames_queued) {
+            *frames_queued = sample_count;
         }
+        return ESP_OK;
+    }
 
-        if (!fmt_found && memcmp(chunk_id, "fmt ", 4) == 0) {
-            ESP_LOGI(TAG, "Found fmt chunk, size=%" PRIu32, chunk_size);
-            if (chunk_size < 16) {
-                ESP_LOGE(TAG, "fmt chunk too small: %" PRIu32 " < 16", chunk_size);
-                return ESP_ERR_INVALID_ARG;
-            }
-            // Read fmt chunk - standard is 16 bytes, but we support up to sizeof(wav_fmt_body_t)
-            memset(&fmt, 0, sizeof(wav_fmt_body_t));  // Zero out first
-            size_t bytes_to_read = chunk_size < sizeof(wav_fmt_body_t) ? chunk_size : sizeof(wav_fmt_body_t);
-            memcpy(&fmt, ptr, bytes_to_read);  // Copy available bytes
-            fmt_found = true;
-            ESP_LOGI(TAG, "WAV format: audio_format=%u, channels=%u, sample_rate=%" PRIu32 ", bits_per_sample=%u",
-                     fmt.audio_format, fmt.num_channels, fmt.sample_rate, fmt.bits_per_sample);
-            // Advance past the fmt chunk data (word-aligned)
-            uint32_t advance = chunk_size;
-            if (advance & 1) {
-                advance++;  // WAV chunks are word-aligned
-            }
-            ptr += advance;
-            continue;  // Continue to next chunk
-        } else if (memcmp(chunk_id, "data", 4) == 0) {
-            ESP_LOGI(TAG, "Found data chunk, size=%" PRIu32, chunk_size);
-            data_ptr = ptr;
-            data_size = chunk_size;
+    TickType_t start = xTaskGetTickCount();
+    if (xSemaphoreTake(st->submit_lock, timeout) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // Blocks of a quarter ring keep the feeder fed while the next one waits for space
+    size_t max_frames = (st->ring.size / 4) / (num_channels * sizeof(int16_t));
+    size_t queued = 0;
+    esp_err_t err = ESP_OK;
+    while (queued < sample_count) {
+        size_t frames = sample_count - queued;
+        if (frames > max_frames) {
+            frames = max_frames;
+        }
+        if (enqueue_block(st, samples + queued * num_channels, frames, sample_rate_hz, num_channels) == ESP_OK) {
+            queued += frames;
+            continue;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && elapsed >= timeout) {
+            st->stats.overruns++;
+            err = ESP_ERR_TIMEOUT;
             break;
-        } else {
-            ESP_LOGD(TAG, "Skipping chunk: %.4s, size=%" PRIu32, chunk_id, chunk_size);
-            uint32_t advance = chunk_size;
-            if (advance & 1) {
-                advance++;
-            }
-            ptr += advance;
         }
+        xSemaphoreTake(st->space_sem, timeout == portMAX_DELAY ? portMAX_DELAY : timeout - elapsed);
     }
+    xSemaphoreGive(st->submit_lock);
 
-    if (!fmt_found) {
-        ESP_LOGE(TAG, "WAV file missing fmt chunk");
-        return ESP_ERR_INVALID_ARG;
+    if (frames_queued) {
+        *frames_queued = queued;
     }
-    if (!data_ptr) {
-        ESP_LOGE(TAG, "WAV file missing data chunk (searched %zu bytes, ptr now at offset %zu from start)",
-                 (size_t)(ptr - wav_data), (size_t)(ptr - wav_data));
-        return ESP_ERR_INVALID_ARG;
+    return err;
+}
+
+esp_err_t audio_player_submit_pcm(const int16_t *samples,
+                                  size_t sample_count,
+                                  int sample_rate_hz,
+                                  int num_channels)
+{
+    return audio_player_stream_submit(AUDIO_STREAM_MEDIA, samples, sample_count, sample_rate_hz, num_channels,
+                                      0, NULL);
+}
+
+esp_err_t audio_player_submit_pcm_wait(const int16_t *samples,
+                                       size_t sample_count,
+                                       int sample_rate_hz,
+                                       int num_channels,
+                                       TickType_t timeout,
+                                       size_t *frames_queued)
+{
+    // A zero timeout still means "wait" here, for as long as one tick
+    return audio_player_stream_submit(AUDIO_STREAM_MEDIA, samples, sample_count, sample_rate_hz, num_channels,
+                                      timeout ? timeout : 1, frames_queued);
+}
+
+esp_err_t audio_player_stream_set_gain(audio_stream_t stream, float gain_db)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    return audio_mixer_set_gain_db(s_audio.mixer, stream, gain_db);
+}
+
+esp_err_t audio_player_set_ducking(float duck_db, uint32_t attack_ms, uint32_t release_ms)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    audio_mixer_set_ducking(s_audio.mixer, duck_db, attack_ms, release_ms);
+    return ESP_OK;
+}
+
+esp_err_t audio_player_set_eq_enabled(bool enabled)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    s_audio.eq_enabled = enabled;
+    return ESP_OK;
+}
+
+esp_err_t audio_player_set_drc_enabled(bool enabled)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    s_audio.drc_enabled = enabled;
+    return ESP_OK;
+}
+
+esp_err_t audio_player_set_volume(float level)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    if (!(level > 0.0f)) {
+        level = 0.0f;
+    } else if (level > 1.0f) {
+        level = 1.0f;
     }
-    ESP_LOGI(TAG, "WAV file parsed successfully: fmt found, data chunk found, data_size=%" PRIu32, data_size);
-    
-    // Support both PCM (format 1) and IEEE float (format 3)
-    bool is_float = (fmt.audio_format == 3);
-    bool is_pcm = (fmt.audio_format == 1);
-    if (!is_pcm && !is_float) {
-        ESP_LOGE(TAG, "Unsupported audio format: %u (expected 1=PCM or 3=float)", fmt.audio_format);
-        return ESP_ERR_NOT_SUPPORTED;
+    s_audio.volume_level = level;
+    if (s_audio.feeder_task) {
+        xTaskNotifyGive(s_audio.feeder_task);
     }
-    
-    // For float, require 32-bit; for PCM, require 16-bit
-    if (is_float) {
-        if (fmt.bits_per_sample != 32) {
-            ESP_LOGE(TAG, "Unsupported float bit depth: %u (expected 32)", fmt.bits_per_sample);
-            return ESP_ERR_NOT_SUPPORTED;
+    return ESP_OK;
+}
+
+float audio_player_get_volume(void)
+{
+    return s_audio.initialized ? s_audio.volume_level : 1.0f;
+}
+
+static bool stream_idle(playback_stream_t *st)
+{
+    return st->drained && pcm_ring_used(&st->ring) == 0;
+}
+
+esp_err_t audio_player_stream_wait_idle(audio_stream_t stream, TickType_t timeout)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    ESP_RETURN_ON_FALSE((unsigned)stream < AUDIO_STREAM_COUNT, ESP_ERR_INVALID_ARG, TAG, "stream");
+    TickType_t start = xTaskGetTickCount();
+    while (!stream_idle(&s_audio.streams[stream])) {
+        if (timeout != portMAX_DELAY && xTaskGetTickCount() - start >= timeout) {
+            return ESP_ERR_TIMEOUT;
         }
-        ESP_LOGI(TAG, "Processing 32-bit float WAV, sample_rate=%" PRIu32 ", channels=%u", fmt.sample_rate, fmt.num_channels);
-    } else {
-        if (fmt.bits_per_sample != 16) {
-            ESP_LOGE(TAG, "Unsupported PCM bit depth: %u (expected 16)", fmt.bits_per_sample);
-            return ESP_ERR_NOT_SUPPORTED;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_player_wait_idle(TickType_t timeout)
+{
+    TickType_t start = xTaskGetTickCount();
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        TickType_t left = timeout == portMAX_DELAY ? portMAX_DELAY : (elapsed < timeout ? timeout - elapsed : 0);
+        ESP_RETURN_ON_ERROR(audio_player_stream_wait_idle((audio_stream_t)i, left), TAG, "wait idle");
+    }
+    return ESP_OK;
+}
+
+void audio_player_stream_flush(audio_stream_t stream)
+{
+    if (!s_audio.initialized || (unsigned)stream >= AUDIO_STREAM_COUNT) {
+        return;
+    }
+    atomic_fetch_or(&s_audio.flush_mask, 1u << stream);
+    xTaskNotifyGive(s_audio.feeder_task);
+}
+
+// Set fade requests for the feeder; streams in one call start fading on the same chunk
+static void request_fades(unsigned mask, audio_stream_t in, uint32_t fade_ms)
+{
+    xSemaphoreTake(s_audio.fade_lock, portMAX_DELAY);
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        if (mask & (1u << i)) {
+            s_audio.streams[i].fade_in = i == (int)in;
+            s_audio.streams[i].fade_ms = fade_ms;
         }
-        ESP_LOGI(TAG, "Processing 16-bit PCM WAV, sample_rate=%" PRIu32 ", channels=%u", fmt.sample_rate, fmt.num_channels);
     }
+    atomic_fetch_or(&s_audio.fade_mask, mask);
+    xSemaphoreGive(s_audio.fade_lock);
+    xTaskNotifyGive(s_audio.feeder_task);
+}
 
-    ESP_LOGI(TAG, "Setting playback sample rate to %" PRIu32 " Hz", fmt.sample_rate);
-    ESP_RETURN_ON_ERROR(ensure_sample_rate(fmt.sample_rate), TAG, "sr");
-    ESP_LOGI(TAG, "I2S sample rate configured to %" PRIu32 " Hz", fmt.sample_rate);
-    
-    if (is_float) {
-        // Convert 32-bit float to 16-bit PCM
-        // Calculate frame count: data_size bytes / (bytes_per_sample * channels)
-        size_t bytes_per_sample = fmt.bits_per_sample / 8;
-        size_t bytes_per_frame = bytes_per_sample * fmt.num_channels;
-        size_t frame_count = data_size / bytes_per_frame;
-        const uint8_t *float_data = data_ptr;  // Keep as uint8_t to avoid direct flash access
-        
-        ESP_LOGI(TAG, "Float conversion: data_size=%u, bytes_per_frame=%u, frame_count=%u", 
-                 (unsigned int)data_size, (unsigned int)bytes_per_frame, (unsigned int)frame_count);
-        ESP_LOGI(TAG, "Expected duration: %.2f seconds at %" PRIu32 " Hz", 
-                 (float)frame_count / (float)fmt.sample_rate, fmt.sample_rate);
-        
-        // Allocate buffers: one for float samples from flash (RAM copy), one for PCM output
-        const size_t chunk_size = 1024;  // frames per chunk
-        const size_t three_second_frame = (size_t)fmt.sample_rate * 3;  // Frame number at 3 seconds
-        bool three_second_logged = false;
-        bool signal_start_logged = false;  // Track when actual audio signal starts
-        // Prefer PSRAM for audio processing buffers
-        float *float_buffer = heap_caps_malloc(chunk_size * sizeof(float) * fmt.num_channels, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (!float_buffer) {
-            float_buffer = malloc(chunk_size * sizeof(float) * fmt.num_channels);
+esp_err_t audio_player_stream_hold(audio_stream_t stream, bool hold)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    ESP_RETURN_ON_FALSE((unsigned)stream < AUDIO_STREAM_COUNT, ESP_ERR_INVALID_ARG, TAG, "stream");
+    if (hold) {
+        s_audio.streams[stream].held = true;  // Nothing more is read from now on
+        request_fades(1u << stream, AUDIO_STREAM_COUNT, 0);
+    } else {
+        request_fades(1u << stream, stream, 0);  // The feeder releases it at full level
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_player_crossfade(audio_stream_t from, audio_stream_t to, uint32_t fade_ms)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    ESP_RETURN_ON_FALSE((unsigned)from < AUDIO_STREAM_COUNT && (unsigned)to < AUDIO_STREAM_COUNT && from != to,
+                        ESP_ERR_INVALID_ARG, TAG, "stream");
+    request_fades((1u << from) | (1u << to), to, fade_ms);
+    return ESP_OK;
+}
+
+esp_err_t audio_player_queue_crossfade(audio_stream_t from, audio_stream_t to, uint32_t fade_ms,
+                                       TickType_t timeout)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    ESP_RETURN_ON_FALSE((unsigned)from < AUDIO_STREAM_COUNT && (unsigned)to < AUDIO_STREAM_COUNT && from != to,
+                        ESP_ERR_INVALID_ARG, TAG, "stream");
+    playback_stream_t *st = &s_audio.streams[from];
+    pcm_block_hdr_t cue = {
+        .cue_stream = (uint16_t)to,
+        .cue_ms = fade_ms,
+    };
+    TickType_t start = xTaskGetTickCount();
+    if (xSemaphoreTake(st->submit_lock, timeout) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_err_t err;
+    while ((err = pcm_ring_write(&st->ring, &cue, sizeof(cue), NULL, 0)) != ESP_OK) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (timeout != portMAX_DELAY && elapsed >= timeout) {
+            err = ESP_ERR_TIMEOUT;
+            break;
         }
-        int16_t *pcm_buffer = malloc(chunk_size * sizeof(int16_t) * fmt.num_channels);
-        if (!float_buffer || !pcm_buffer) {
-            ESP_LOGE(TAG, "Failed to allocate conversion buffers");
-            free(float_buffer);
-            free(pcm_buffer);
-            return ESP_ERR_NO_MEM;
+        xSemaphoreTake(st->space_sem, timeout == portMAX_DELAY ? portMAX_DELAY : timeout - elapsed);
+    }
+    xSemaphoreGive(st->submit_lock);
+    if (err == ESP_OK) {
+        xTaskNotifyGive(s_audio.feeder_task);
+    }
+    return err;
+}
+
+void audio_player_flush(void)
+{
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        audio_player_stream_flush((audio_stream_t)i);
+    }
+}
+
+void audio_player_get_stream_stats(audio_stream_t stream, audio_player_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!s_audio.initialized || (unsigned)stream >= AUDIO_STREAM_COUNT) {
+        return;
+    }
+    playback_stream_t *st = &s_audio.streams[stream];
+    *stats = st->stats;
+    stats->ring_used = pcm_ring_used(&st->ring);
+    stats->fill_percent = (uint8_t)(stats->ring_used * 100 / st->ring.size);
+    int bytes_per_sec = st->submit_rate * st->submit_channels * (int)sizeof(int16_t);
+    stats->buffered_ms = bytes_per_sec > 0 ? (uint32_t)((uint64_t)stats->ring_used * 1000 / bytes_per_sec) : 0;
+}
+
+void audio_player_get_stats(audio_player_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!s_audio.initialized) {
+        return;
+    }
+    unsigned played = 0, avg_sum = 0;
+    for (int i = 0; i < AUDIO_STREAM_COUNT; i++) {
+        audio_player_stats_t one;
+        audio_player_get_stream_stats((audio_stream_t)i, &one);
+        stats->ring_capacity += one.ring_capacity;
+        stats->ring_used += one.ring_used;
+        if (one.buffered_ms > stats->buffered_ms) {
+            stats->buffered_ms = one.buffered_ms;
         }
-        
-        size_t frames_processed = 0;
-        esp_err_t err = ESP_OK;
-        
-        while (frames_processed < frame_count && err == ESP_OK) {
-            size_t frames_this_chunk = chunk_size;
-            if (frames_processed + frames_this_chunk > frame_count) {
-                frames_this_chunk = frame_count - frames_processed;
-            }
-            
-            // Copy float samples from flash to RAM first (to avoid cache issues)
-            // Calculate source offset in bytes (frames * bytes_per_frame)
-            size_t byte_offset = frames_processed * bytes_per_frame;
-            size_t float_bytes_this_chunk = frames_this_chunk * bytes_per_frame;
-            const uint8_t *src = float_data + byte_offset;
-            
-            // Verify we're not reading past the data
-            if (byte_offset + float_bytes_this_chunk > data_size) {
-                ESP_LOGE(TAG, "Read would exceed data size: offset=%u, chunk=%u, total=%u", 
-                         (unsigned int)byte_offset, (unsigned int)float_bytes_this_chunk, (unsigned int)data_size);
-                err = ESP_ERR_INVALID_ARG;
-                break;
-            }
-            
-            // Copy from flash to RAM - memcpy should work if flash is properly mapped
-            // If this fails, the embedded binary might not be accessible
-            memcpy(float_buffer, src, float_bytes_this_chunk);
-            
-            // Process through EQ, then convert float to int16
-            // Add headroom (90%) to prevent clipping and distortion
-            static bool first_chunk_logged = false;
-            float max_amp_this_chunk = 0.0f;
-            const float headroom = 0.90f;  // 90% of full scale for headroom
-            const float pcm_scale = 32767.0f * headroom;  // ~29490 for headroom
-            
-            // Process samples through EQ chain
-            for (size_t i = 0; i < frames_this_chunk; i++) {
-                float sample_f;
-                float abs_sample;
-                
-                if (fmt.num_channels == 2) {
-                    // Stereo: process left and right channels separately
-                    float left = float_buffer[i * 2];
-                    float right = float_buffer[i * 2 + 1];
-                    
-                    // Clamp to [-1.0, 1.0] range
-                    if (left > 1.0f) left = 1.0f;
-                    if (left < -1.0f) left = -1.0f;
-                    if (right > 1.0f) right = 1.0f;
-                    if (right < -1.0f) right = -1.0f;
-                    
-                    // Track max amplitude
-                    abs_sample = left < 0.0f ? -left : left;
-                    if (abs_sample > max_amp_this_chunk) max_amp_this_chunk = abs_sample;
-                    abs_sample = right < 0.0f ? -right : right;
-                    if (abs_sample > max_amp_this_chunk) max_amp_this_chunk = abs_sample;
-                    
-                    // Convert to PCM
-                    pcm_buffer[i * 2] = (int16_t)(left * pcm_scale);
-                    pcm_buffer[i * 2 + 1] = (int16_t)(right * pcm_scale);
-                    
-                    // Log first few samples for verification
-                    if (!first_chunk_logged && i < 4) {
-                        ESP_LOGI(TAG, "First samples [%zu]: L=%.6f->%d, R=%.6f->%d", 
-                                 i, float_buffer[i * 2], pcm_buffer[i * 2],
-                                 float_buffer[i * 2 + 1], pcm_buffer[i * 2 + 1]);
-                        if (i == 3) first_chunk_logged = true;
-                    }
-                } else {
-                    // Mono: process single channel
-                    sample_f = float_buffer[i];
-                    
-                    abs_sample = sample_f < 0.0f ? -sample_f : sample_f;
-                    if (abs_sample > max_amp_this_chunk) {
-                        max_amp_this_chunk = abs_sample;
-                    }
-                    
-                    // Clamp to [-1.0, 1.0] range
-                    if (sample_f > 1.0f) sample_f = 1.0f;
-                    if (sample_f < -1.0f) sample_f = -1.0f;
-                    
-                    // Convert to PCM
-                    pcm_buffer[i] = (int16_t)(sample_f * pcm_scale);
-                    
-                    // Log first few samples for verification
-                    if (!first_chunk_logged && i < 8) {
-                        ESP_LOGI(TAG, "First samples [%zu]: float=%.6f, PCM=%d", 
-                                 i, sample_f, pcm_buffer[i]);
-                        if (i == 7) first_chunk_logged = true;
-                    }
-                }
-            }
-            
-            // Detect when actual audio signal starts (chirp begins)
-            if (!signal_start_logged && max_amp_this_chunk > 0.001f) {
-                float time_seconds = (float)frames_processed / (float)fmt.sample_rate;
-                ESP_LOGI(TAG, "*** AUDIO SIGNAL DETECTED (chirp starts) at frame %zu (%.3f seconds), max_amp=%.6f ***",
-                         frames_processed, time_seconds, max_amp_this_chunk);
-                
-                // Log sample values around the chirp start for verification
-                ESP_LOGI(TAG, "Chirp samples (first 10 after detection):");
-                for (size_t j = 0; j < 10 && j < frames_this_chunk * fmt.num_channels; j++) {
-                    float sample_val = float_buffer[j];
-                    int16_t pcm_val = pcm_buffer[j];
-                    ESP_LOGI(TAG, "  [%zu]: float=%.6f, PCM=%d", j, sample_val, pcm_val);
-                }
-                
-                signal_start_logged = true;
-            }
-            
-            // Log amplitude statistics during chirp (first 2 seconds after detection)
-            if (signal_start_logged && frames_processed < (size_t)fmt.sample_rate * 5) {
-                static size_t last_amp_log = 0;
-                if (frames_processed - last_amp_log >= (size_t)fmt.sample_rate / 2) {  // Every 0.5 seconds
-                    float time_seconds = (float)frames_processed / (float)fmt.sample_rate;
-                    ESP_LOGI(TAG, "Chirp amplitude at %.2fs: max=%.6f (PCM range: %d to %d)",
-                             time_seconds, max_amp_this_chunk,
-                             pcm_buffer[0], pcm_buffer[frames_this_chunk * fmt.num_channels - 1]);
-                    last_amp_log = frames_processed;
-                }
-            }
-            
-            // Write PCM frames
-            err = write_pcm_frames(pcm_buffer, frames_this_chunk, fmt.num_channels);
-            
-            frames_processed += frames_this_chunk;
-            
-            // Log when we reach 3 seconds (where the chirp should be)
-            if (!three_second_logged && frames_processed >= three_second_frame) {
-                float time_seconds = (float)frames_processed / (float)fmt.sample_rate;
-                ESP_LOGI(TAG, "*** REACHED 3 SECOND MARK (chirp location) at frame %zu (%.2f seconds) ***", 
-                         frames_processed, time_seconds);
-                three_second_logged = true;
-            }
-            
-            // Update progress callback if provided (after updating frames_processed)
-            if (progress_cb && err == ESP_OK) {
-                float progress = (float)frames_processed / (float)frame_count;
-                if (progress > 1.0f) progress = 1.0f;
-                progress_cb(progress, true);
-            }
-            
-            // Log progress every 5 seconds
-            static size_t last_log_frame = 0;
-            if (frames_processed - last_log_frame >= fmt.sample_rate * 5) {
-                float time_seconds = (float)frames_processed / (float)fmt.sample_rate;
-                ESP_LOGI(TAG, "Playback progress: %.1f seconds (%.1f%%)", 
-                         time_seconds, (float)frames_processed * 100.0f / (float)frame_count);
-                last_log_frame = frames_processed;
+        stats->underruns += one.underruns;
+        stats->underrun_ms += one.underrun_ms;
+        stats->overruns += one.overruns;
+        stats->rejected += one.rejected;
+        if (one.frames_played > 0) {
+            if (played == 0 || one.fill_min_percent < stats->fill_min_percent) {
+                stats->fill_min_percent = one.fill_min_percent;
             }
+            avg_sum += one.fill_avg_percent;
+            played++;
         }
-        
-        // Final progress update
-        if (progress_cb) {
-            progress_cb(1.0f, true);
-            vTaskDelay(pdMS_TO_TICKS(50));
-            progress_cb(0.0f, false);
+    }
+    stats->fill_percent = (uint8_t)(stats->ring_used * 100 / stats->ring_capacity);
+    stats->fill_avg_percent = played ? (uint8_t)(avg_sum / played) : 0;
+    stats->frames_played = s_audio.frames_played;
+    stats->dma_underruns = s_audio.dma_underruns;
+    stats->dma_fill_min_percent = s_audio.dma_fill_min_percent;
+    stats->dma_fill_avg_percent = s_audio.dma_fill_avg_percent;
+    stats->playing = s_audio.mixing;
+}
+
+esp_err_t audio_player_play_wav_source(struct wav_source *src, audio_progress_callback_t progress_cb)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    ESP_RETURN_ON_FALSE(src && src->frames_total > 0, ESP_ERR_INVALID_ARG, TAG, "bad wav source");
+    ESP_LOGI(TAG, "WAV: %" PRIu32 " Hz, %u ch, %u-bit %s, %.2f s", src->sample_rate, src->channels,
+             src->bits_per_sample, src->is_float ? "float" : "PCM", (float)src->frames_total / src->sample_rate);
+
+    // Converted a block at a time, so memory use does not depend on the file length
+    const size_t block_frames = 1024;
+    size_t block_bytes = block_frames * WAV_SOURCE_MAX_CHANNELS * sizeof(int16_t);
+    int16_t *pcm = heap_caps_malloc(block_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!pcm) {
+        pcm = malloc(block_bytes);
+    }
+    ESP_RETURN_ON_FALSE(pcm, ESP_ERR_NO_MEM, TAG, "wav block");
+
+    esp_err_t err = ESP_OK;
+    size_t frames_done = 0;
+    size_t n;
+    while ((n = wav_source_read(src, pcm, block_frames)) > 0) {
+        err = audio_player_submit_pcm_wait(pcm, n, (int)src->sample_rate, src->channels, portMAX_DELAY, NULL);
+        if (err != ESP_OK) {
+            break;
         }
-        
-        free(float_buffer);
-        free(pcm_buffer);
-        return err;
-    } else {
-        // Direct PCM playback
-        size_t sample_count = data_size / (fmt.bits_per_sample / 8);
-        size_t frame_count = sample_count / fmt.num_channels;
-        const int16_t *samples = (const int16_t *)data_ptr;
-        
-        // For PCM, we can update progress during playback
+        frames_done += n;
         if (progress_cb) {
-            const size_t update_interval = 1024; // Update every 1024 frames
-            size_t frames_written = 0;
-            
-            while (frames_written < frame_count) {
-                size_t frames_this_batch = update_interval;
-                if (frames_written + frames_this_batch > frame_count) {
-                    frames_this_batch = frame_count - frames_written;
-                }
-                
-                esp_err_t err = write_pcm_frames(samples + (frames_written * fmt.num_channels), 
-                                                 frames_this_batch, fmt.num_channels);
-                if (err != ESP_OK) {
-                    return err;
-                }
-                
-                frames_written += frames_this_batch;
-                float progress = (float)frames_written / (float)frame_count;
-                progress_cb(progress, true);
-            }
-            
-            progress_cb(1.0f, true);
-            vTaskDelay(pdMS_TO_TICKS(50));
-            progress_cb(0.0f, false);
-            return ESP_OK;
-        } else {
-            return write_pcm_frames(samples, frame_count, fmt.num_channels);
+            float progress = (float)frames_done / (float)src->frames_total;
+            progress_cb(progress > 1.0f ? 1.0f : progress, true);
         }
     }
+    free(pcm);
+
+    // Return only once the tail has been played, as callers expect
+    if (err == ESP_OK) {
+        audio_player_stream_wait_idle(AUDIO_STREAM_MEDIA, portMAX_DELAY);
+    }
+    if (progress_cb) {
+        progress_cb(1.0f, true);
+        vTaskDelay(pdMS_TO_TICKS(50));
+        progress_cb(0.0f, false);
+    }
+    return err;
 }
 
-esp_err_t audio_player_submit_pcm(const int16_t *samples,
-                                  size_t sample_count,
-                                  int sample_rate_hz,
-                                  int num_channels)
+esp_err_t audio_player_play_wav(const uint8_t *wav_data, size_t wav_len, audio_progress_callback_t progress_cb)
 {
     ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
-    ESP_RETURN_ON_ERROR(ensure_sample_rate(sample_rate_hz), TAG, "sr");
-    return write_pcm_frames(samples, sample_count, num_channels);
+    wav_source_t src;
+    esp_err_t err = wav_source_open_memory(&src, wav_data, wav_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot play WAV image (%zu bytes): %s", wav_len, esp_err_to_name(err));
+        return err;
+    }
+    err = audio_player_play_wav_source(&src, progress_cb);
+    wav_source_close(&src);
+    return err;
+}
+
+esp_err_t audio_player_play_wav_file(const char *path, audio_progress_callback_t progress_cb)
+{
+    ESP_RETURN_ON_FALSE(s_audio.initialized, ESP_ERR_INVALID_STATE, TAG, "not init");
+    ESP_RETURN_ON_FALSE(path, ESP_ERR_INVALID_ARG, TAG, "path required");
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        ESP_LOGE(TAG, "Cannot open %s (errno %d)", path, errno);
+        return ESP_ERR_NOT_FOUND;
+    }
+    // wav_source_t carries a block buffer; keep it off the caller's stack
+    wav_source_t *src = malloc(sizeof(wav_source_t));
+    if (!src) {
+        fclose(fp);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = wav_source_open_file(src, fp);
+    if (err == ESP_OK) {
+        err = audio_player_play_wav_source(src, progress_cb);
+        wav_source_close(src);
+    } else {
+        ESP_LOGE(TAG, "Cannot play %s: %s", path, esp_err_to_name(err));
+    }
+    free(src);
+    fclose(fp);
+    return err;
 }
 
 void audio_player_shutdown(void)
@@ -1140,6 +1703,9 @@ void audio_player_shutdown(void)
     if (!s_audio.initialized) {
         return;
     }
+    // Stop the feeder before its I2S channel goes away
+    playback_engine_stop();
+    
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
     // ESP-IDF 5.x: Disable and delete channel
     if (s_audio.tx_handle) {
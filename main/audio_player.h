@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 #include "hal/gpio_types.h"
 // Suppress deprecated I2S API warning - will migrate to new API in future
 #pragma GCC diagnostic push
@@ -25,12 +26,249 @@ typedef struct {
 
 typedef void (*audio_progress_callback_t)(float progress, bool playing);
 
+/**
+ * Mixer inputs, in ascending priority. While a stream is playing, every
+ * lower-priority stream is ducked by CONFIG_AUDIO_DUCK_DB. The two media decks share
+ * a priority: one plays while the next track is decoded into the other, to be
+ * crossfaded in.
+ */
+typedef enum {
+    AUDIO_STREAM_MEDIA = 0,   // Sleep sounds, music, WAV/MP3 files
+    AUDIO_STREAM_MEDIA_ALT,   // Second media deck, for crossfades between tracks
+    AUDIO_STREAM_VOICE,       // TTS replies
+    AUDIO_STREAM_ALERT,       // Alarms and notification tones
+    AUDIO_STREAM_COUNT,
+} audio_stream_t;
+
+/**
+ * Playback engine counters, see audio_player_get_stats() and audio_player_get_stream_stats()
+ */
+typedef struct {
+    size_t ring_capacity;     // PCM ring size in bytes (all streams for the totals)
+    size_t ring_used;         // Bytes queued ahead of the I2S feeder
+    uint8_t fill_percent;     // ring_used as a percentage of ring_capacity
+    uint32_t buffered_ms;     // Queued audio in the format of the last submission (longest stream)
+    uint64_t frames_played;   // Frames handed to I2S since init (per stream: frames consumed)
+    uint32_t underruns;       // Times a ring ran dry mid-stream
+    uint32_t underrun_ms;     // Total length of those gaps
+    uint32_t overruns;        // Blocking submissions that timed out on a full ring
+    uint32_t rejected;        // Non-blocking submissions refused for lack of space
+    uint8_t fill_min_percent; // Lowest ring fill over the last second of playback (totals: over streams that played)
+    uint8_t fill_avg_percent; // Mean ring fill over that second
+    uint32_t dma_underruns;   // Totals only: I2S DMA ran out of data while mixing
+    uint8_t dma_fill_min_percent;  // Totals only: I2S DMA queue fill before each write, last second
+    uint8_t dma_fill_avg_percent;
+    bool playing;             // Feeder is currently writing audio (per stream: has data)
+} audio_player_stats_t;
+
+struct wav_source;
+
 esp_err_t audio_player_init(const audio_player_config_t *cfg);
+
+/**
+ * @brief Play a WAV image in memory (e.g. an EMBED_FILES blob); returns once it has been heard
+ * 16/24/32-bit PCM or 32-bit float, mono or stereo, at any sample rate; it is converted
+ * and queued a block at a time on the media stream.
+ * @param wav_data: RIFF image, any alignment
+ * @param wav_len: Image length
+ * @param progress_cb: Optional, called after each block and with (0, false) at the end
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a malformed image,
+ *         ESP_ERR_NOT_SUPPORTED for an unsupported sample format
+ */
 esp_err_t audio_player_play_wav(const uint8_t *wav_data, size_t wav_len, audio_progress_callback_t progress_cb);
+
+/**
+ * @brief Stream a WAV file (e.g. from the SD card) with constant memory; returns once it has been heard
+ * @param path: File path
+ * @param progress_cb: Optional, as for audio_player_play_wav()
+ * @return As audio_player_play_wav(), or ESP_ERR_NOT_FOUND if the file cannot be opened
+ */
+esp_err_t audio_player_play_wav_file(const char *path, audio_progress_callback_t progress_cb);
+
+/**
+ * @brief Play an open wav_source_t (file, memory or mapped partition) to its end
+ * The caller closes the source afterwards.
+ * @param src: Source from one of the wav_source_open_*() calls
+ * @param progress_cb: Optional, as for audio_player_play_wav()
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_play_wav_source(struct wav_source *src, audio_progress_callback_t progress_cb);
+
+/**
+ * @brief Queue PCM on the media stream without blocking
+ * The samples are copied; output runs in the background at the given rate.
+ * @param samples: Interleaved 16-bit PCM
+ * @param sample_count: Number of frames
+ * @param sample_rate_hz: Sample rate of this block
+ * @param num_channels: 1 or 2
+ * @return ESP_OK if the whole block was queued, ESP_ERR_TIMEOUT if the ring has no
+ *         room for it right now (nothing was queued), ESP_ERR_INVALID_SIZE if the block
+ *         can never fit, ESP_ERR_INVALID_STATE if the player is not initialized
+ */
 esp_err_t audio_player_submit_pcm(const int16_t *samples,
                                   size_t sample_count,
                                   int sample_rate_hz,
                                   int num_channels);
+
+/**
+ * @brief Queue PCM of any length on the media stream, waiting for ring space as needed
+ * Producers block on the ring, not on I2S DMA, so decoding continues while earlier
+ * audio plays.
+ * @param samples: Interleaved 16-bit PCM
+ * @param sample_count: Number of frames
+ * @param sample_rate_hz: Sample rate of this block
+ * @param num_channels: 1 or 2
+ * @param timeout: Longest total wait for space
+ * @param frames_queued: Optional, set to the number of frames queued (all of them on ESP_OK)
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the timeout expired first
+ */
+esp_err_t audio_player_submit_pcm_wait(const int16_t *samples,
+                                       size_t sample_count,
+                                       int sample_rate_hz,
+                                       int num_channels,
+                                       TickType_t timeout,
+                                       size_t *frames_queued);
+
+/**
+ * @brief Queue PCM on one mixer stream
+ * audio_player_submit_pcm() and audio_player_submit_pcm_wait() are this call on
+ * AUDIO_STREAM_MEDIA. Each stream keeps its own rate and channel count; the mixer
+ * resamples it to the output rate.
+ * @param stream: Mixer input
+ * @param samples: Interleaved 16-bit PCM
+ * @param sample_count: Number of frames
+ * @param sample_rate_hz: Sample rate of this block
+ * @param num_channels: 1 or 2
+ * @param timeout: Longest total wait for space; 0 queues all or nothing without waiting
+ * @param frames_queued: Optional, set to the number of frames queued (all of them on ESP_OK)
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if there was not enough room in time,
+ *         ESP_ERR_INVALID_SIZE if a non-blocking block can never fit
+ */
+esp_err_t audio_player_stream_submit(audio_stream_t stream,
+                                     const int16_t *samples,
+                                     size_t sample_count,
+                                     int sample_rate_hz,
+                                     int num_channels,
+                                     TickType_t timeout,
+                                     size_t *frames_queued);
+
+/**
+ * @brief Set a stream's gain
+ * @param stream: Mixer input
+ * @param gain_db: Gain in dB, clamped to [-90, +6]; ramped over ~20 ms
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_stream_set_gain(audio_stream_t stream, float gain_db);
+
+/**
+ * @brief Configure how lower-priority streams are ducked
+ * @param duck_db: Attenuation while ducked, in dB
+ * @param attack_ms: Ramp time into ducking
+ * @param release_ms: Ramp time back to full level
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_set_ducking(float duck_db, uint32_t attack_ms, uint32_t release_ms);
+
+/**
+ * @brief Turn the speaker EQ (audio_eq_init_default tuning) on or off
+ * Applies to everything played; takes effect on the next mixed chunk.
+ * @param enabled: true to filter the output
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_set_eq_enabled(bool enabled);
+
+/**
+ * @brief Turn the output compressor and true-peak limiter on or off
+ * Off, mixed streams and EQ boosts that exceed full scale clip. Takes effect on the
+ * next mixed chunk.
+ * @param enabled: true to control the output dynamics
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_set_drc_enabled(bool enabled);
+
+/**
+ * @brief Set the output volume
+ * Takes effect from the next mixed block, ramped; coarse steps are made in the codec
+ * so quiet settings keep their bit depth.
+ * @param level: 0.0 (mute) to 1.0 (max), clamped
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_set_volume(float level);
+
+/**
+ * @brief Current volume level, 0.0 to 1.0
+ */
+float audio_player_get_volume(void);
+
+/**
+ * @brief Wait until everything queued on a stream has been written to I2S
+ * @return ESP_OK once idle, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t audio_player_stream_wait_idle(audio_stream_t stream, TickType_t timeout);
+
+/**
+ * @brief Drop a stream's queued audio that has not reached I2S yet
+ */
+void audio_player_stream_flush(audio_stream_t stream);
+
+/**
+ * @brief Hold a stream silent, or release it at full level
+ * A held stream queues what is submitted to it but plays none of it, so the next
+ * track can be decoded ahead while the current one plays. audio_player_crossfade()
+ * and audio_player_queue_crossfade() fade it in and release it. Flushing a held
+ * stream leaves it held.
+ * @param stream: Mixer input
+ * @param hold: true to hold, false to release at once at full level
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_stream_hold(audio_stream_t stream, bool hold);
+
+/**
+ * @brief Crossfade from one stream to another now
+ * Equal-power: from follows a quarter cosine down and to a quarter sine up, so the
+ * loudness stays even across uncorrelated tracks. Both start on the next mixed chunk.
+ * @param from: Stream to fade out; it stays silent until flushed or released
+ * @param to: Stream to fade in, released if held
+ * @param fade_ms: Crossfade time; 0 switches at once
+ * @return ESP_OK on success
+ */
+esp_err_t audio_player_crossfade(audio_stream_t from, audio_stream_t to, uint32_t fade_ms);
+
+/**
+ * @brief Queue a crossfade at the end of what has been submitted to a stream so far
+ * When the feeder reaches that point in from it crossfades as audio_player_crossfade();
+ * what is submitted to from afterwards is the tail heard while it fades out. The point
+ * is exact to the mixed chunk, whatever the decode or SD timing.
+ * @param from: Stream carrying the cue, to fade out
+ * @param to: Stream to fade in, normally held with audio already queued
+ * @param fade_ms: Crossfade time
+ * @param timeout: Longest wait for ring space for the cue
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if there was no room in time
+ */
+esp_err_t audio_player_queue_crossfade(audio_stream_t from, audio_stream_t to, uint32_t fade_ms,
+                                       TickType_t timeout);
+
+/**
+ * @brief Wait until every stream is idle
+ * @return ESP_OK once idle, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t audio_player_wait_idle(TickType_t timeout);
+
+/**
+ * @brief Drop queued audio on every stream
+ */
+void audio_player_flush(void);
+
+/**
+ * @brief Snapshot of the playback engine counters, summed over all streams
+ */
+void audio_player_get_stats(audio_player_stats_t *stats);
+
+/**
+ * @brief Snapshot of one stream's counters
+ */
+void audio_player_get_stream_stats(audio_stream_t stream, audio_player_stats_t *stats);
+
 void audio_player_shutdown(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,147 @@
+/**
+ * @file audio_telemetry.c
+ * @brief Duration histograms for the playback path and the combined telemetry snapshot
+ *
+ * Recording is a count-leading-zeros, three adds and a compare inside a short critical
+ * section, so it can run on every I2S write, decoded frame, SD block read and reader
+ * fread() in production. The lock is needed because during a crossfade both decks'
+ * reader and decoder tasks record into the same histograms. Fill levels,
+ * underruns and overruns are kept by the audio player next to the rings they describe
+ * and are only gathered here when a snapshot is taken.
+ */
+
+#include "audio_telemetry.h"
+#include "audio_player.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+#define FIRST_EDGE_SHIFT  5  // Bucket 1 starts at 32 us
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[AUDIO_TELEMETRY_BUCKETS];
+} hist_state_t;
+
+static hist_state_t s_hist[AUDIO_TELEMETRY_HIST_COUNT];
+static portMUX_TYPE s_hist_lock = portMUX_INITIALIZER_UNLOCKED;
+
+_Static_assert(AUDIO_TELEMETRY_STREAMS == AUDIO_STREAM_COUNT, "snapshot stream count");
+
+static inline int bucket_of(uint32_t us)
+{
+    if (us < (1u << FIRST_EDGE_SHIFT)) {
+        return 0;
+    }
+    int b = 31 - __builtin_clz(us) - (FIRST_EDGE_SHIFT - 1);
+    return b < AUDIO_TELEMETRY_BUCKETS ? b : AUDIO_TELEMETRY_BUCKETS - 1;
+}
+
+void audio_telemetry_record(audio_telemetry_hist_id_t id, uint32_t us)
+{
+    if ((unsigned)id >= AUDIO_TELEMETRY_HIST_COUNT) {
+        return;
+    }
+    int bucket = bucket_of(us);
+    hist_state_t *h = &s_hist[id];
+    taskENTER_CRITICAL(&s_hist_lock);
+    h->buckets[bucket]++;
+    h->total_us += us;
+    if (us > h->max_us) {
+        h->max_us = us;
+    }
+    h->count++;
+    taskEXIT_CRITICAL(&s_hist_lock);
+}
+
+void audio_telemetry_get_hist(audio_telemetry_hist_id_t id, audio_telemetry_hist_t *out)
+{
+    if (!out) {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+    if ((unsigned)id >= AUDIO_TELEMETRY_HIST_COUNT) {
+        return;
+    }
+    const hist_state_t *h = &s_hist[id];
+    taskENTER_CRITICAL(&s_hist_lock);
+    out->count = h->count;
+    out->max_us = h->max_us;
+    out->total_us = h->total_us;
+    for (int b = 0; b < AUDIO_TELEMETRY_BUCKETS; b++) {
+        out->buckets[b] = h->buckets[b];
+    }
+    taskEXIT_CRITICAL(&s_hist_lock);
+}
+
+uint32_t audio_telemetry_bucket_floor_us(int bucket)
+{
+    if (bucket <= 0) {
+        return 0;
+    }
+    if (bucket >= AUDIO_TELEMETRY_BUCKETS) {
+        bucket = AUDIO_TELEMETRY_BUCKETS - 1;
+    }
+    return 1u << (bucket + FIRST_EDGE_SHIFT - 1);
+}
+
+uint32_t audio_telemetry_percentile_us(const audio_telemetry_hist_t *hist, float fraction)
+{
+    if (!hist || hist->count == 0) {
+        return 0;
+    }
+    uint32_t total = 0;
+    for (int b = 0; b < AUDIO_TELEMETRY_BUCKETS; b++) {
+        total += hist->buckets[b];
+    }
+    float want = fraction * (float)total;
+    uint32_t seen = 0;
+    for (int b = 0; b < AUDIO_TELEMETRY_BUCKETS - 1; b++) {
+        seen += hist->buckets[b];
+        if ((float)seen >= want) {
+            uint32_t edge = audio_telemetry_bucket_floor_us(b + 1);
+            return edge < hist->max_us ? edge : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
+
+esp_err_t audio_telemetry_snapshot(audio_telemetry_snapshot_t *snap)
+{
+    if (!snap) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(snap, 0, sizeof(*snap));
+    snap->magic = AUDIO_TELEMETRY_MAGIC;
+    snap->version = AUDIO_TELEMETRY_VERSION;
+    snap->size = sizeof(*snap);
+    snap->uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    for (int i = 0; i < AUDIO_TELEMETRY_HIST_COUNT; i++) {
+        audio_telemetry_get_hist((audio_telemetry_hist_id_t)i, &snap->hist[i]);
+    }
+
+    audio_player_stats_t stats;
+    audio_player_get_stats(&stats);
+    snap->frames_played = stats.frames_played;
+    snap->dma_underruns = stats.dma_underruns;
+    snap->dma_fill_min_percent = stats.dma_fill_min_percent;
+    snap->dma_fill_avg_percent = stats.dma_fill_avg_percent;
+    snap->playing = stats.playing;
+    snap->num_streams = AUDIO_TELEMETRY_STREAMS;
+    for (int i = 0; i < AUDIO_TELEMETRY_STREAMS; i++) {
+        audio_player_get_stream_stats((audio_stream_t)i, &stats);
+        audio_telemetry_stream_t *st = &snap->streams[i];
+        st->frames_played = stats.frames_played;
+        st->underruns = stats.underruns;
+        st->underrun_ms = stats.underrun_ms;
+        st->overruns = stats.overruns;
+        st->rejected = stats.rejected;
+        st->fill_percent = stats.fill_percent;
+        st->fill_min_percent = stats.fill_min_percent;
+        st->fill_avg_percent = stats.fill_avg_percent;
+        st->playing = stats.playing;
+    }
+    return ESP_OK;
+}
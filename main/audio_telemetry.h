@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_TELEMETRY_BUCKETS   12  // <32 us, then one per doubling, last >= 32.768 ms
+#define AUDIO_TELEMETRY_STREAMS   4   // AUDIO_STREAM_COUNT
+#define AUDIO_TELEMETRY_MAGIC     0x4D4C5441u  // "ATLM" little-endian
+#define AUDIO_TELEMETRY_VERSION   3
+
+/**
+ * Timed operations on the playback path
+ */
+typedef enum {
+    AUDIO_TELEMETRY_I2S_WRITE = 0,  // Feeder blocked in i2s_channel_write() per block
+    AUDIO_TELEMETRY_DECODE,         // One MP3 frame through the decoder
+    AUDIO_TELEMETRY_SD_READ,        // One block read from the card by the SD cache's I/O task
+    AUDIO_TELEMETRY_READER_WAIT,    // A playback reader in fread(): a cache copy, or the card read
+                                    // itself when the cache is off
+    AUDIO_TELEMETRY_HIST_COUNT,
+} audio_telemetry_hist_id_t;
+
+/**
+ * Duration histogram, cumulative since boot; diff two snapshots for a rate
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[AUDIO_TELEMETRY_BUCKETS];  // b > 0: [16 << b, 32 << b) us; the last is open
+} audio_telemetry_hist_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t frames_played;     // Frames consumed from the ring
+    uint32_t underruns;         // Ring ran dry mid-stream
+    uint32_t underrun_ms;
+    uint32_t overruns;          // Producer found the ring full and had to wait
+    uint32_t rejected;          // Non-blocking submissions refused
+    uint8_t fill_percent;       // Ring fill now
+    uint8_t fill_min_percent;   // Lowest fill over the last window while playing
+    uint8_t fill_avg_percent;   // Mean fill over that window
+    uint8_t playing;
+} audio_telemetry_stream_t;
+
+/**
+ * Binary snapshot, little-endian and packed: served as-is by GET /api/audio/telemetry
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // AUDIO_TELEMETRY_MAGIC
+    uint16_t version;           // AUDIO_TELEMETRY_VERSION
+    uint16_t size;              // sizeof(audio_telemetry_snapshot_t)
+    uint32_t uptime_ms;
+    uint64_t frames_played;     // Frames handed to I2S
+    uint32_t dma_underruns;     // I2S DMA found no new data and repeated silence
+    uint8_t dma_fill_min_percent;
+    uint8_t dma_fill_avg_percent;
+    uint8_t playing;
+    uint8_t num_streams;        // AUDIO_TELEMETRY_STREAMS
+    audio_telemetry_hist_t hist[AUDIO_TELEMETRY_HIST_COUNT];
+    audio_telemetry_stream_t streams[AUDIO_TELEMETRY_STREAMS];
+} audio_telemetry_snapshot_t;
+
+/**
+ * @brief Add one duration to a histogram
+ * Safe from any task: during a crossfade both decks' reader and decoder tasks record
+ * into the same histogram, so the update runs in a short critical section.
+ * @param id: Histogram
+ * @param us: Duration in microseconds
+ */
+void audio_telemetry_record(audio_telemetry_hist_id_t id, uint32_t us);
+
+/**
+ * @brief Copy one histogram
+ */
+void audio_telemetry_get_hist(audio_telemetry_hist_id_t id, audio_telemetry_hist_t *out);
+
+/**
+ * @brief Lower edge of a bucket in microseconds
+ */
+uint32_t audio_telemetry_bucket_floor_us(int bucket);
+
+/**
+ * @brief Duration below which a fraction of the samples fall, at bucket resolution
+ * @param hist: Histogram
+ * @param fraction: 0..1, e.g. 0.99
+ * @return Upper edge of the bucket holding that sample (max_us for the last bucket), 0 if empty
+ */
+uint32_t audio_telemetry_percentile_us(const audio_telemetry_hist_t *hist, float fraction);
+
+/**
+ * @brief Fill a snapshot of the histograms and the audio player counters
+ * @param snap: Destination
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL
+ */
+esp_err_t audio_telemetry_snapshot(audio_telemetry_snapshot_t *snap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,201 @@
+/**
+ * @file audio_volume.c
+ * @brief Per-block software gain with click-free exponential ramps
+ *
+ * The ramp is exponential from block to block and linear within a block, so a
+ * block costs one expf() at most and the sample loop is a Q16 multiply that the
+ * compiler can unroll and keep in registers. The codec split hands whole steps
+ * to the DAC register, timed by the output position rather than by block counts.
+ */
+
+#include "audio_volume.h"
+#include <math.h>
+#include <string.h>
+
+#define GAIN_ONE_Q16   65536
+#define SETTLED_EPS    (1.0f / GAIN_ONE_Q16)
+#define RAMP_TAUS      4.6f  // ln(100): time constants to get within 1%
+
+esp_err_t audio_volume_init(audio_volume_t *vol, uint32_t sample_rate, uint32_t ramp_ms)
+{
+    if (!vol || sample_rate == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(vol, 0, sizeof(*vol));
+    vol->gain = 1.0f;
+    vol->target = 1.0f;
+    vol->sample_rate = sample_rate;
+    vol->ramp_ms = ramp_ms;
+    return ESP_OK;
+}
+
+void audio_volume_set_sample_rate(audio_volume_t *vol, uint32_t sample_rate)
+{
+    if (vol && sample_rate > 0 && sample_rate != vol->sample_rate) {
+        vol->sample_rate = sample_rate;
+        vol->ramp_k_frames = 0;
+    }
+}
+
+void audio_volume_set_target(audio_volume_t *vol, float gain, bool immediate)
+{
+    if (!vol) {
+        return;
+    }
+    if (!(gain > 0.0f)) {
+        gain = 0.0f;
+    } else if (gain > 1.0f) {
+        gain = 1.0f;
+    }
+    vol->target = gain;
+    if (immediate || vol->ramp_ms == 0) {
+        vol->gain = gain;
+    }
+}
+
+bool audio_volume_settled(const audio_volume_t *vol)
+{
+    return vol->gain == vol->target;
+}
+
+static inline int32_t to_q16(float gain)
+{
+    return (int32_t)(gain * GAIN_ONE_Q16 + 0.5f);
+}
+
+void audio_volume_process_s16(audio_volume_t *vol, int16_t *samples, size_t frames)
+{
+    if (!vol || !samples || frames == 0) {
+        return;
+    }
+    float start = vol->gain;
+    float end = vol->target;
+    if (start != end) {
+        if (vol->ramp_k_frames != frames) {
+            float tau_frames = vol->ramp_ms * vol->sample_rate / (1000.0f * RAMP_TAUS);
+            vol->ramp_k = expf(-(float)frames / tau_frames);
+            vol->ramp_k_frames = frames;
+        }
+        float next = end + (start - end) * vol->ramp_k;
+        if (fabsf(next - end) >= SETTLED_EPS) {
+            end = next;
+        }
+        vol->gain = end;
+    }
+
+    int32_t g = to_q16(start);
+    int32_t g_end = to_q16(end);
+    if (g == g_end) {
+        if (g == GAIN_ONE_Q16) {
+            return;
+        }
+        if (g == 0) {
+            memset(samples, 0, frames * 2 * sizeof(int16_t));
+            return;
+        }
+        // Both operands fit: |s| <= 2^15 and g < 2^16
+        for (size_t i = 0; i < frames * 2; i++) {
+            samples[i] = (int16_t)((samples[i] * g + 0x8000) >> 16);
+        }
+        return;
+    }
+
+    // Ramp in Q24 so the per-block truncation of the step stays below half an LSB
+    int32_t g24 = g << 8;
+    int32_t step = ((g_end - g) << 8) / (int32_t)frames;
+    for (size_t i = 0; i < frames; i++) {
+        g24 += step;
+        int32_t gi = g24 >> 8;
+        samples[2 * i] = (int16_t)((samples[2 * i] * gi + 0x8000) >> 16);
+        samples[2 * i + 1] = (int16_t)((samples[2 * i + 1] * gi + 0x8000) >> 16);
+    }
+}
+
+float audio_volume_level_to_db(float level, float range_db)
+{
+    if (!(level > 0.0f)) {
+        return -INFINITY;
+    }
+    if (level > 1.0f) {
+        level = 1.0f;
+    }
+    return range_db * (level - 1.0f);
+}
+
+void audio_volume_split_db(float db, float step_db, float *hw_db, float *sw_db)
+{
+    float hw = 0.0f;
+    if (step_db > 0.0f && db < 0.0f) {
+        hw = step_db * ceilf(db / step_db);
+    }
+    if (hw_db) {
+        *hw_db = hw;
+    }
+    if (sw_db) {
+        *sw_db = db - hw;
+    }
+}
+
+esp_err_t audio_volume_codec_init(audio_volume_codec_t *vc, uint32_t sample_rate, uint32_t ramp_ms, float step_db)
+{
+    if (!vc || step_db < 0.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = audio_volume_init(&vc->sw, sample_rate, ramp_ms);
+    if (err != ESP_OK) {
+        return err;
+    }
+    vc->step_db = step_db;
+    vc->hw_db = 0.0f;
+    vc->hw_pending = false;
+    vc->hw_due_pos = 0;
+    return ESP_OK;
+}
+
+static inline float db_to_gain(float db)
+{
+    return powf(10.0f, db / 20.0f);
+}
+
+bool audio_volume_codec_update(audio_volume_codec_t *vc, float db, bool playing,
+                               uint32_t written_pos, uint32_t played_pos, float *hw_db)
+{
+    bool write = false;
+    // After an underrun the hardware has run ahead of what was written
+    if ((int32_t)(written_pos - played_pos) < 0) {
+        written_pos = played_pos;
+    }
+    // Everything queued before the handover block has played: it is playing now
+    if (vc->hw_pending && (int32_t)(played_pos - vc->hw_due_pos) >= 0) {
+        vc->hw_pending = false;
+        write = true;
+    }
+    bool audible = playing || written_pos != played_pos;
+
+    if (isinf(db)) {
+        audio_volume_set_target(&vc->sw, 0.0f, !audible);
+    } else {
+        float want_hw;
+        audio_volume_split_db(db, vc->step_db, &want_hw, NULL);
+        if (!audible) {
+            // Nothing queued or playing: move both parts at once
+            write |= vc->hw_pending || want_hw != vc->hw_db;
+            vc->hw_pending = false;
+            vc->hw_db = want_hw;
+            audio_volume_set_target(&vc->sw, db_to_gain(db - want_hw), true);
+        } else {
+            // Up: hand over first, then ramp up. Down: ramp down first, then hand over.
+            audio_volume_set_target(&vc->sw, db_to_gain(db - vc->hw_db), false);
+            if (!vc->hw_pending && want_hw != vc->hw_db &&
+                (want_hw > vc->hw_db || audio_volume_settled(&vc->sw))) {
+                audio_volume_set_target(&vc->sw, vc->sw.gain * db_to_gain(vc->hw_db - want_hw), true);
+                vc->hw_db = want_hw;
+                vc->hw_pending = true;
+                vc->hw_due_pos = written_pos;
+                audio_volume_set_target(&vc->sw, db_to_gain(db - want_hw), false);
+            }
+        }
+    }
+    *hw_db = vc->hw_db;
+    return write;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Software gain stage with exponential ramps
+ *
+ * Gain never exceeds unity: boosts are left to the codec, so the stage only
+ * attenuates and cannot clip.
+ */
+typedef struct {
+    float gain;             // Linear gain at the end of the last block
+    float target;           // Linear gain being ramped to, 0..1
+    float ramp_k;           // Per-block decay of (gain - target)
+    size_t ramp_k_frames;   // Block length ramp_k was computed for
+    uint32_t sample_rate;
+    uint32_t ramp_ms;
+} audio_volume_t;
+
+/**
+ * @brief Set up a gain stage at unity
+ * @param vol: Gain stage
+ * @param sample_rate: Sample rate in Hz
+ * @param ramp_ms: Time for a change to settle within 1% (-40 dB) of its target
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad parameters
+ */
+esp_err_t audio_volume_init(audio_volume_t *vol, uint32_t sample_rate, uint32_t ramp_ms);
+
+/**
+ * @brief Keep ramp times in milliseconds across an output rate change
+ */
+void audio_volume_set_sample_rate(audio_volume_t *vol, uint32_t sample_rate);
+
+/**
+ * @brief Ramp towards a new gain
+ * @param vol: Gain stage
+ * @param gain: Linear gain, clamped to 0..1
+ * @param immediate: Jump without a ramp (nothing is playing, or the codec compensates)
+ */
+void audio_volume_set_target(audio_volume_t *vol, float gain, bool immediate);
+
+/**
+ * @brief True once the ramp has reached its target
+ */
+bool audio_volume_settled(const audio_volume_t *vol);
+
+/**
+ * @brief Apply the gain to interleaved stereo in place, advancing the ramp by one block
+ * @param vol: Gain stage
+ * @param samples: Interleaved L/R samples
+ * @param frames: Number of frames
+ */
+void audio_volume_process_s16(audio_volume_t *vol, int16_t *samples, size_t frames);
+
+/**
+ * @brief Volume curve: level 1.0 is 0 dB, falling linearly in dB to -range_db just above 0
+ * @param level: Volume 0.0 (mute) to 1.0 (max)
+ * @param range_db: Attenuation at the bottom of the curve
+ * @return Attenuation in dB (<= 0), -INFINITY for mute
+ */
+float audio_volume_level_to_db(float level, float range_db);
+
+/**
+ * @brief Split an attenuation into a coarse codec part and a fine software part
+ * The software part is in (-step_db, 0], so it costs at most step_db / 6 bits.
+ * @param db: Total attenuation (<= 0, finite)
+ * @param step_db: Codec step size
+ * @param hw_db: Multiple of step_db, rounded towards 0 dB
+ * @param sw_db: Remainder, db - *hw_db
+ */
+void audio_volume_split_db(float db, float step_db, float *hw_db, float *sw_db);
+
+/**
+ * Volume split between the codec (whole steps) and the software stage (the rest)
+ *
+ * A codec step acts on everything already queued for output, so it is handed
+ * over at a block boundary: the first block at the new step is mixed with a
+ * compensating software gain, and the register is written once the output has
+ * played up to that block. Positions are output byte counters that may wrap.
+ */
+typedef struct {
+    audio_volume_t sw;       // Fine part, applied to each block
+    float step_db;           // Codec step size, 0 keeps the codec at 0 dB
+    float hw_db;             // Codec attenuation for the block being mixed
+    bool hw_pending;         // hw_db not written yet: earlier audio is still queued
+    uint32_t hw_due_pos;     // Output position of the first block mixed for hw_db
+} audio_volume_codec_t;
+
+/**
+ * @brief Set up a split volume at 0 dB (codec register at its 0 dB setting)
+ * @param vc: Split volume
+ * @param sample_rate: Sample rate in Hz
+ * @param ramp_ms: Software ramp time, see audio_volume_init()
+ * @param step_db: Codec step size in dB
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad parameters
+ */
+esp_err_t audio_volume_codec_init(audio_volume_codec_t *vc, uint32_t sample_rate, uint32_t ramp_ms, float step_db);
+
+/**
+ * @brief Plan the next output block; call before processing it with vc->sw
+ * @param vc: Split volume
+ * @param db: Requested attenuation (<= 0, -INFINITY for mute)
+ * @param playing: A block is about to be mixed
+ * @param written_pos: Output position at which that block will be queued
+ * @param played_pos: Output position the hardware has played up to
+ * @param hw_db: Set to the codec attenuation to write when returning true
+ * @return true if the codec register must be written now
+ */
+bool audio_volume_codec_update(audio_volume_codec_t *vc, float db, bool playing,
+                               uint32_t written_pos, uint32_t played_pos, float *hw_db);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,7 +7,8 @@
 #include "esp_http_client.h"
 #include "esp_tls.h"
 #include "esp_heap_caps.h"
-#include "tls_mutex.h"
+#include "net_scheduler.h"
+#include "gzip_stream.h"
 #ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
 #include "esp_crt_bundle.h"
 #endif
@@ -15,6 +16,7 @@
 #include "cJSON.h"
 #include "time.h"
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 
 static const char *TAG = "env_report";
@@ -29,26 +31,42 @@ typedef struct {
     char *buffer;
     size_t buffer_size;
     size_t written;
+    gzip_stream_t *gzip;  // Set while inflating a Content-Encoding: gzip body
 } http_response_data_t;
 
+// Append decoded response bytes, truncating once the buffer is full
+static esp_err_t response_append(const uint8_t *bytes, size_t len, void *ctx)
+{
+    http_response_data_t *data = (http_response_data_t *)ctx;
+    size_t available = data->buffer_size - data->written - 1;
+    size_t to_copy = (len < available) ? len : available;
+    if (to_copy > 0) {
+        memcpy(data->buffer + data->written, bytes, to_copy);
+        data->written += to_copy;
+        data->buffer[data->written] = '\0';
+    } else if (len > 0) {
+        ESP_LOGW(TAG, "Response buffer full, truncating (written=%zu, available=%zu, data_len=%zu)",
+                 data->written, available, len);
+    }
+    return ESP_OK;
+}
+
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
     http_response_data_t *data = (http_response_data_t *)evt->user_data;
 
     switch (evt->event_id) {
+        case HTTP_EVENT_ON_HEADER:
+            if (data) {
+                return gzip_stream_handle_header(&data->gzip, evt->header_key, evt->header_value,
+                                                 response_append, data);
+            }
+            break;
         case HTTP_EVENT_ON_DATA:
             if (data && data->buffer && evt->data_len > 0) {
-                // Handle both chunked and non-chunked responses
-                size_t available = data->buffer_size - data->written - 1;
-                size_t to_copy = (evt->data_len < available) ? evt->data_len : available;
-                if (to_copy > 0) {
-                    memcpy(data->buffer + data->written, evt->data, to_copy);
-                    data->written += to_copy;
-                    data->buffer[data->written] = '\0';
-                } else if (evt->data_len > 0) {
-                    ESP_LOGW(TAG, "Response buffer full, truncating (written=%zu, available=%zu, data_len=%zu)",
-                             data->written, available, evt->data_len);
-                }
+                // Handle both chunked and non-chunked responses; gzip bodies are inflated as they arrive
+                return gzip_stream_handle_data(data->gzip, (const uint8_t *)evt->data, evt->data_len,
+                                               response_append, data);
             }
             break;
         case HTTP_EVENT_ON_FINISH:
@@ -83,18 +101,19 @@ esp_err_t environmental_report_fetch_weather_data(char *weather_json, size_t wea
         http_response_data_t response_data = {
             .buffer = weather_json,
             .buffer_size = weather_json_len,
-            .written = 0
+            .written = 0,
+            .gzip = NULL
         };
 
         // Configure TLS to skip certificate verification for development
         // CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY=y in sdkconfig.defaults enables
         // MBEDTLS_SSL_VERIFY_NONE when no CA cert is provided, avoiding the
         // "No server verification option set" error
-        // Acquire TLS mutex to serialize TLS connections
-        // Use longer timeout to wait for sensor manager to finish (sensor publishes every 60s)
-        esp_err_t mutex_err = tls_mutex_take(pdMS_TO_TICKS(15000));  // 15 second timeout
-        if (mutex_err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to acquire TLS mutex: %s", esp_err_to_name(mutex_err));
+        // Weather is the lowest request class: it waits behind voice turns and telemetry
+        net_session_t session;
+        esp_err_t sched_err = net_scheduler_acquire(NET_PRIO_WEATHER, pdMS_TO_TICKS(15000), &session);
+        if (sched_err != ESP_OK) {
+            ESP_LOGE(TAG, "No TLS session admitted for weather fetch: %s", esp_err_to_name(sched_err));
             ret = ESP_ERR_TIMEOUT;
         } else {
             esp_http_client_config_t config = {
@@ -110,12 +129,18 @@ esp_err_t environmental_report_fetch_weather_data(char *weather_json, size_t wea
             esp_http_client_handle_t client = esp_http_client_init(&config);
             if (client == NULL) {
                 ESP_LOGE(TAG, "Failed to initialize HTTP client for weather/air quality");
-                tls_mutex_give();  // Release mutex on error
+                net_scheduler_release(&session);
                 ret = ESP_ERR_NO_MEM;
             } else {
+                // Open-Meteo JSON compresses well; the event handler inflates it incrementally
+                esp_http_client_set_header(client, "Accept-Encoding", "gzip");
                 esp_task_wdt_reset();  // Feed watchdog before HTTP request
                 esp_err_t http_ret = esp_http_client_perform(client);
                 esp_task_wdt_reset();  // Feed watchdog after HTTP request
+                esp_err_t gz_err = gzip_stream_close(&response_data.gzip);
+                if (gz_err != ESP_OK && http_ret == ESP_OK) {
+                    http_ret = gz_err;
+                }
                 if (http_ret == ESP_OK) {
                     int status_code = esp_http_client_get_status_code(client);
                     if (status_code == 200) {
@@ -139,8 +164,8 @@ esp_err_t environmental_report_fetch_weather_data(char *weather_json, size_t wea
                 }
                 esp_http_client_cleanup(client);
                 
-                // Release TLS mutex after connection is complete
-                tls_mutex_give();
+                // Release the session after cleanup so its TLS memory is already returned
+                net_scheduler_release(&session);
             }
         }
     }
@@ -290,7 +315,7 @@ static void format_air_quality_summary(char *buffer, size_t buffer_len, const ch
     cJSON_Delete(json);
 }
 
-esp_err_t environmental_report_generate_and_speak(void)
+static esp_err_t generate_and_speak(void)
 {
     ESP_LOGI(TAG, "Generating environmental report...");
 
@@ -377,11 +402,6 @@ esp_err_t environmental_report_generate_and_speak(void)
     ESP_LOGI(TAG, "Sending prompt to LLM...");
     esp_task_wdt_reset();  // Feed watchdog before LLM call
 
-    // Wait longer after weather API call to ensure TLS connection is fully closed
-    // This helps prevent MBEDTLS_ERR_SSL_ALLOC_FAILED errors from concurrent connections
-    // TLS connections need time to fully release internal RAM before starting new ones
-    vTaskDelay(pdMS_TO_TICKS(2000));
-
     // Retry logic for LLM call
     char llm_response[512];
     esp_err_t ret = ESP_FAIL;
@@ -393,10 +413,10 @@ esp_err_t environmental_report_generate_and_speak(void)
         }
         
         if (retry < LLM_MAX_RETRIES) {
-            ESP_LOGW(TAG, "LLM call failed (attempt %d/%d): %s, retrying in 2000ms...", 
+            ESP_LOGW(TAG, "LLM call failed (attempt %d/%d): %s, retrying in 500ms...", 
                      retry + 1, LLM_MAX_RETRIES + 1, esp_err_to_name(ret));
-            // Longer delay between retries to allow TLS resources to be fully released
-            vTaskDelay(pdMS_TO_TICKS(2000));  // Wait before retry
+            // The scheduler waits for TLS memory itself; this only backs off the server
+            vTaskDelay(pdMS_TO_TICKS(500));
             esp_task_wdt_reset();  // Feed watchdog during retry delay
         }
     }
@@ -439,3 +459,13 @@ esp_err_t environmental_report_generate_and_speak(void)
     return ESP_OK;
 #endif
 }
+
+esp_err_t environmental_report_generate_and_speak(void)
+{
+    // The summary LLM and TTS requests go through gemini_api, which uses the calling
+    // task's request class; run them as weather so voice turns and telemetry go first
+    net_scheduler_set_task_priority(NULL, NET_PRIO_WEATHER);
+    esp_err_t ret = generate_and_speak();
+    net_scheduler_set_task_priority(NULL, NET_PRIO_VOICE);
+    return ret;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file mp3_pipeline.c
+ * @brief SD reader task -> compressed ring -> in-place decode -> media PCM ring
+ *
+ * The reader fills the ring through pcm_ring_reserve() in multiples of the SD sector
+ * size, so FATFS can read straight into it; a stream from sd_cache_fopen() instead
+ * copies from cached blocks the cache's I/O task read ahead. The decoder hands minimp3
+ * a pointer into the ring; only a frame that straddles the end of the storage is copied,
+ * once per lap.
+ * Each side sleeps on a semaphore the other gives, so no stage polls.
+ */
+
+#include "mp3_pipeline.h"
+#include "audio_player.h"
+#include "audio_telemetry.h"
+#include "mp3_decoder.h"
+#include "pcm_ring.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "mp3_pipeline";
+
+#ifndef CONFIG_AUDIO_MP3_INPUT_RING_KB
+#define CONFIG_AUDIO_MP3_INPUT_RING_KB 64
+#endif
+#ifndef CONFIG_AUDIO_MP3_READER_PRIORITY
+#define CONFIG_AUDIO_MP3_READER_PRIORITY 7
+#endif
+
+#define MP3_READER_STACK      4096
+#define MP3_READER_CORE       0       // Sleeps in SD transfers; leaves core 1 to decode and I2S
+#define MP3_READ_ALIGN        512     // SD sector: whole-sector reads bypass the FATFS window
+#define MP3_READ_CHUNK        8192    // Largest single read
+#define MP3_DECODE_WINDOW     4096    // Input offered per frame: a few frames, enough to resync
+#define MP3_MAX_FRAME_SAMPLES (1152 * 2)
+#define MP3_WAIT_TICKS        pdMS_TO_TICKS(100)  // Longest sleep before rechecking stop
+
+typedef struct {
+    const mp3_pipeline_config_t *config;
+    pcm_ring_t in;
+    SemaphoreHandle_t data_sem;    // Given by the reader after each commit
+    SemaphoreHandle_t space_sem;   // Given by the decoder when a full read fits
+    SemaphoreHandle_t done_sem;    // Given by the reader as it exits
+    atomic_bool eof;               // Reader has stopped; what is queued is all there is
+    atomic_bool stop;              // Decoder is finished; reader should exit
+    atomic_uint_fast32_t bytes_read;
+    uint8_t window[MP3_DECODE_WINDOW];       // Linear copy of a frame across the wrap
+    int16_t pcm[MP3_MAX_FRAME_SAMPLES];
+} mp3_pipeline_t;
+
+static void reader_task(void *arg)
+{
+    mp3_pipeline_t *p = arg;
+    while (!atomic_load(&p->stop)) {
+        if (pcm_ring_free(&p->in) < MP3_READ_CHUNK) {
+            xSemaphoreTake(p->space_sem, MP3_WAIT_TICKS);
+            continue;
+        }
+        uint8_t *dst;
+        size_t room = pcm_ring_reserve(&p->in, &dst);
+        if (room > MP3_READ_CHUNK) {
+            room = MP3_READ_CHUNK;
+        }
+        room -= room % MP3_READ_ALIGN;  // Positions stay sector-aligned; the ring size is a power of two
+
+        int64_t start = esp_timer_get_time();
+        size_t got = fread(dst, 1, room, p->config->fp);
+        audio_telemetry_record(AUDIO_TELEMETRY_READER_WAIT, (uint32_t)(esp_timer_get_time() - start));
+        pcm_ring_commit(&p->in, got);
+        atomic_fetch_add(&p->bytes_read, got);
+        xSemaphoreGive(p->data_sem);
+        if (got < room) {
+            if (ferror(p->config->fp)) {
+                ESP_LOGW(TAG, "SD read failed after %u bytes", (unsigned)atomic_load(&p->bytes_read));
+            }
+            break;
+        }
+    }
+    atomic_store(&p->eof, true);
+    xSemaphoreGive(p->data_sem);
+    xSemaphoreGive(p->done_sem);
+    vTaskDelete(NULL);
+}
+
+// Queue one decoded frame, waiting in slices so a stop request is noticed while the ring is full
+static void submit_frame(mp3_pipeline_t *p, const int16_t *pcm, size_t frames, int sample_rate, int channels)
+{
+    size_t done = 0;
+    while (done < frames && *p->config->keep_running) {
+        size_t queued = 0;
+        esp_err_t err = audio_player_stream_submit(p->config->stream, pcm + done * channels, frames - done,
+                                                   sample_rate, channels, MP3_WAIT_TICKS, &queued);
+        done += queued;
+        if (err != ESP_OK && err != ESP_ERR_TIMEOUT) {
+            ESP_LOGW(TAG, "Failed to submit PCM: %s", esp_err_to_name(err));
+            return;
+        }
+    }
+}
+
+static void decode_loop(mp3_pipeline_t *p, mp3_decoder_t *decoder, mp3_pipeline_result_t *result)
+{
+    const mp3_pipeline_config_t *config = p->config;
+    size_t prefill = p->in.size / 2;
+    size_t min_used = SIZE_MAX;
+    bool started = false;
+    uint64_t consumed_total = 0;     // Input bytes before the frame being decoded
+    uint64_t frames_queued = 0;      // Per channel
+    uint64_t frames_limit = UINT64_MAX;
+    uint32_t skip_left = config->skip_samples;
+    bool duration_limited = false;   // frames_limit is duration_ms, not the end of the trimmed track
+    int out_rate = 0;                // Of the first queued frame; the limit is counted in it
+
+    while (*config->keep_running && frames_queued < frames_limit) {
+        size_t used = pcm_ring_used(&p->in);
+        bool eof = atomic_load(&p->eof);
+        if (!eof && used < (started ? MP3_DECODE_WINDOW : prefill)) {
+            result->input_waits += started;
+            xSemaphoreTake(p->data_sem, MP3_WAIT_TICKS);
+            continue;
+        }
+        if (used == 0) {
+            break;
+        }
+
+        const uint8_t *in;
+        size_t avail = pcm_ring_peek(&p->in, &in);
+        if (avail < MP3_DECODE_WINDOW && avail < used) {
+            // The next frame may straddle the end of the storage
+            avail = pcm_ring_copy(&p->in, p->window, sizeof(p->window));
+            in = p->window;
+        }
+
+        size_t samples = 0;
+        size_t consumed = 0;
+        int sample_rate = 0;
+        int channels = 0;
+        int64_t decode_start = esp_timer_get_time();
+        esp_err_t err = mp3_decoder_decode(decoder, in, avail, p->pcm, MP3_MAX_FRAME_SAMPLES, &samples,
+                                           &sample_rate, &channels, &consumed);
+        if (consumed == 0) {
+            if (eof) {
+                break;  // Truncated last frame
+            }
+            // A full window with no frame in it: the decoder cannot resync here
+            ESP_LOGW(TAG, "No MP3 frame in %zu bytes, skipping", avail);
+            consumed = avail;
+        }
+        pcm_ring_consume(&p->in, consumed);
+        if (pcm_ring_free(&p->in) >= MP3_READ_CHUNK) {
+            xSemaphoreGive(p->space_sem);
+        }
+        bool priming = consumed_total < config->prime_bytes;
+        consumed_total += consumed;
+        if (err != ESP_OK || samples == 0) {
+            continue;  // Skipped a tag or damaged data, or refilled the bit reservoir
+        }
+
+        audio_telemetry_record(AUDIO_TELEMETRY_DECODE, (uint32_t)(esp_timer_get_time() - decode_start));
+        if (!started) {
+            ESP_LOGI(TAG, "MP3: %d Hz, %d channel(s)", sample_rate, channels);
+            started = true;
+        }
+        result->frames_decoded++;
+        if (!eof && used - consumed < min_used) {
+            min_used = used - consumed;
+        }
+        if (priming) {
+            continue;  // Decoded only to fill the reservoir ahead of a seek target
+        }
+        size_t frames = samples / channels;
+        const int16_t *pcm = p->pcm;
+        if (skip_left > 0) {
+            // Encoder delay: silence (or the decoder's start-up) ahead of the first sample
+            size_t drop = frames < skip_left ? frames : skip_left;
+            skip_left -= (uint32_t)drop;
+            frames -= drop;
+            pcm += drop * channels;
+            if (frames == 0) {
+                continue;
+            }
+        }
+        if (out_rate == 0) {
+            out_rate = sample_rate;
+            if (config->length_samples > 0) {
+                frames_limit = config->length_samples;
+            }
+            if (config->duration_ms > 0 && (uint64_t)config->duration_ms * out_rate / 1000 < frames_limit) {
+                frames_limit = (uint64_t)config->duration_ms * out_rate / 1000;
+                duration_limited = true;
+            }
+        }
+        // The last frame is cut to the sample, so the stop does not depend on decode or SD timing
+        if (frames > frames_limit - frames_queued) {
+            frames = (size_t)(frames_limit - frames_queued);
+        }
+        submit_frame(p, pcm, frames, sample_rate, channels);
+        frames_queued += frames;
+        if (frames_queued >= frames_limit) {
+            ESP_LOGI(TAG, duration_limited ? "Duration limit reached, stopping playback" : "End of track");
+        }
+        if (config->on_progress) {
+            config->on_progress((uint32_t)(frames_queued * 1000 / out_rate), config->progress_arg);
+        }
+    }
+
+    result->cut_short = !*config->keep_running;
+    result->queued_ms = out_rate ? (uint32_t)(frames_queued * 1000 / out_rate) : 0;
+    if (min_used != SIZE_MAX) {
+        result->input_min_percent = (uint8_t)(min_used * 100 / p->in.size);
+    }
+}
+
+esp_err_t mp3_pipeline_play(const mp3_pipeline_config_t *config, mp3_pipeline_result_t *result)
+{
+    if (!config || !config->fp || !config->keep_running) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mp3_pipeline_result_t local;
+    if (!result) {
+        result = &local;
+    }
+    memset(result, 0, sizeof(*result));
+
+    mp3_pipeline_t *p = calloc(1, sizeof(mp3_pipeline_t));
+    mp3_decoder_t *decoder = mp3_decoder_create();
+    if (!p || !decoder) {
+        free(p);
+        mp3_decoder_destroy(decoder);
+        return ESP_ERR_NO_MEM;
+    }
+    p->config = config;
+    atomic_init(&p->eof, false);
+    atomic_init(&p->stop, false);
+    atomic_init(&p->bytes_read, 0);
+
+    size_t ring_size = 1;
+    while (ring_size * 2 <= (size_t)CONFIG_AUDIO_MP3_INPUT_RING_KB * 1024) {
+        ring_size *= 2;
+    }
+    esp_err_t err = pcm_ring_init(&p->in, ring_size);
+    p->data_sem = xSemaphoreCreateBinary();
+    p->space_sem = xSemaphoreCreateBinary();
+    p->done_sem = xSemaphoreCreateBinary();
+    if (err == ESP_OK && (!p->data_sem || !p->space_sem || !p->done_sem)) {
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err == ESP_OK && xTaskCreatePinnedToCore(reader_task, "mp3_reader", MP3_READER_STACK, p,
+                                                 CONFIG_AUDIO_MP3_READER_PRIORITY, NULL,
+                                                 MP3_READER_CORE) != pdPASS) {
+        err = ESP_ERR_NO_MEM;
+    }
+
+    if (err == ESP_OK) {
+        decode_loop(p, decoder, result);
+        // The reader may be inside fread(); the file must outlive it
+        atomic_store(&p->stop, true);
+        xSemaphoreGive(p->space_sem);
+        xSemaphoreTake(p->done_sem, portMAX_DELAY);
+        result->bytes_read = (uint32_t)atomic_load(&p->bytes_read);
+        ESP_LOGI(TAG, "Decoded %" PRIu32 " frames from %" PRIu32 " bytes; input waits %" PRIu32
+                 ", lowest input fill %u%%",
+                 result->frames_decoded, result->bytes_read, result->input_waits, result->input_min_percent);
+    } else {
+        ESP_LOGE(TAG, "Failed to start: %s", esp_err_to_name(err));
+    }
+
+    if (p->data_sem) {
+        vSemaphoreDelete(p->data_sem);
+    }
+    if (p->space_sem) {
+        vSemaphoreDelete(p->space_sem);
+    }
+    if (p->done_sem) {
+        vSemaphoreDelete(p->done_sem);
+    }
+    pcm_ring_deinit(&p->in);
+    mp3_decoder_destroy(decoder);
+    free(p);
+    return err;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "audio_player.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * MP3 playback as three stages, each waiting only on its neighbour:
+ *  1. a reader task streams the file into a byte ring in whole SD sectors,
+ *  2. the calling task decodes frames straight out of that ring,
+ *  3. decoded PCM goes to a media stream ring of the player, drained by the I2S feeder.
+ * A slow SD read only delays stage 1; the compressed ring (seconds of audio) and the
+ * PCM ring keep the output fed meanwhile.
+ * Encoder delay and padding are cut to the sample (skip_samples, length_samples from
+ * mp3_index_trim()), so one track queued after another on the same stream is gapless.
+ */
+typedef struct {
+    FILE *fp;                           // Open file at the first byte to decode; not closed here
+    const volatile bool *keep_running;  // Playback stops early once this reads false
+    uint32_t duration_ms;               // Audio to queue, 0 for all; counted in samples, not wall-clock time
+    uint32_t prime_bytes;               // Leading input decoded only to fill the bit reservoir (mp3_index_seek())
+    uint32_t skip_samples;              // Then decoded samples (per channel) to drop: encoder and decoder delay
+    uint32_t length_samples;            // Samples (per channel) to queue after those, 0 for all: padding is cut
+    audio_stream_t stream;              // Media deck to queue on; AUDIO_STREAM_MEDIA when zeroed
+    void (*on_progress)(uint32_t queued_ms, void *arg);  // Optional: called after each frame is queued
+    void *progress_arg;
+} mp3_pipeline_config_t;
+
+typedef struct {
+    uint32_t frames_decoded;
+    uint32_t bytes_read;
+    uint32_t input_waits;        // Times the decoder found too little input and waited
+    uint8_t input_min_percent;   // Lowest compressed ring fill after the first frame
+    uint32_t queued_ms;          // Audio queued, after priming and the duration limit
+    bool cut_short;              // Stopped by keep_running, not the end of file or duration_ms
+} mp3_pipeline_result_t;
+
+/**
+ * @brief Play an MP3 file to a media stream and return when it is decoded
+ * Blocks the calling task, which becomes the decode stage. Queued PCM may still be
+ * playing on return.
+ * @param config: File and stop conditions
+ * @param result: Optional, filled with counters
+ * @return ESP_OK when the file was played to the end or stopped, ESP_ERR_NO_MEM if the
+ *         rings or the reader task could not be created
+ */
+esp_err_t mp3_pipeline_play(const mp3_pipeline_config_t *config, mp3_pipeline_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file pcm_ring.c
+ * @brief Lock-free SPSC byte ring between PCM producers and the I2S feeder task
+ *
+ * Also carries compressed MP3 between the SD reader and the decoder, which fill and
+ * parse it in place through reserve/commit and peek/consume.
+ */
+
+#include "pcm_ring.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
+#include <string.h>
+
+esp_err_t pcm_ring_init(pcm_ring_t *ring, size_t size)
+{
+    // Positions wrap modulo 2^32, so the mask only stays valid for power-of-two sizes
+    if (!ring || size == 0 || (size & (size - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ring->buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!ring->buf) {
+        ring->buf = malloc(size);
+        if (!ring->buf) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ring->size = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ESP_OK;
+}
+
+void pcm_ring_deinit(pcm_ring_t *ring)
+{
+    if (!ring) {
+        return;
+    }
+    heap_caps_free(ring->buf);
+    ring->buf = NULL;
+    ring->size = 0;
+}
+
+size_t pcm_ring_used(pcm_ring_t *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return head - tail;
+}
+
+size_t pcm_ring_free(pcm_ring_t *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return ring->size - (head - tail);
+}
+
+// Copy into the ring at absolute position pos, splitting at the end of storage
+static void copy_in(pcm_ring_t *ring, size_t pos, const void *data, size_t len)
+{
+    size_t offset = pos & (ring->size - 1);
+    size_t first = ring->size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(ring->buf + offset, data, first);
+    memcpy(ring->buf, (const uint8_t *)data + first, len - first);
+}
+
+esp_err_t pcm_ring_write(pcm_ring_t *ring, const void *hdr, size_t hdr_len, const void *data, size_t len)
+{
+    if (pcm_ring_free(ring) < hdr_len + len) {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (hdr_len) {
+        copy_in(ring, head, hdr, hdr_len);
+    }
+    if (len) {
+        copy_in(ring, head + hdr_len, data, len);
+    }
+    atomic_store_explicit(&ring->head, head + hdr_len + len, memory_order_release);
+    return ESP_OK;
+}
+
+size_t pcm_ring_reserve(pcm_ring_t *ring, uint8_t **data)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t offset = head & (ring->size - 1);
+    size_t room = pcm_ring_free(ring);
+    size_t first = ring->size - offset;
+    *data = ring->buf + offset;
+    return room < first ? room : first;
+}
+
+void pcm_ring_commit(pcm_ring_t *ring, size_t len)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+}
+
+size_t pcm_ring_peek(pcm_ring_t *ring, const uint8_t **data)
+{
+    size_t used = pcm_ring_used(ring);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t offset = tail & (ring->size - 1);
+    size_t first = ring->size - offset;
+    *data = ring->buf + offset;
+    return used < first ? used : first;
+}
+
+size_t pcm_ring_copy(pcm_ring_t *ring, void *out, size_t len)
+{
+    size_t used = pcm_ring_used(ring);
+    if (len > used) {
+        len = used;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t offset = tail & (ring->size - 1);
+    size_t first = ring->size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(out, ring->buf + offset, first);
+    memcpy((uint8_t *)out + first, ring->buf, len - first);
+    return len;
+}
+
+void pcm_ring_consume(pcm_ring_t *ring, size_t len)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
+
+size_t pcm_ring_read(pcm_ring_t *ring, void *out, size_t len)
+{
+    len = pcm_ring_copy(ring, out, len);
+    pcm_ring_consume(ring, len);
+    return len;
+}
+
+void pcm_ring_discard(pcm_ring_t *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Single-producer / single-consumer byte ring for PCM (and compressed input)
+ *
+ * Lock-free: the producer only advances head, the consumer only advances
+ * tail, and each publishes with a release store. Several producer tasks must
+ * serialize among themselves; the consumer (the I2S feeder) never blocks on
+ * them. head and tail count bytes ever written / read, so used = head - tail
+ * even after wrap-around.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    atomic_size_t head;
+    atomic_size_t tail;
+} pcm_ring_t;
+
+/**
+ * @brief Allocate the ring storage (PSRAM preferred)
+ * @param ring: Ring to initialize
+ * @param size: Capacity in bytes, a power of two
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if size is not a power of two,
+ *         ESP_ERR_NO_MEM if the storage could not be allocated
+ */
+esp_err_t pcm_ring_init(pcm_ring_t *ring, size_t size);
+
+/**
+ * @brief Free the ring storage
+ */
+void pcm_ring_deinit(pcm_ring_t *ring);
+
+/**
+ * @brief Bytes queued (consumer view)
+ */
+size_t pcm_ring_used(pcm_ring_t *ring);
+
+/**
+ * @brief Bytes that can be written (producer view)
+ */
+size_t pcm_ring_free(pcm_ring_t *ring);
+
+/**
+ * @brief Append a header and a payload as one unit (producer only)
+ * Both parts are copied before head moves, so the consumer sees all or nothing.
+ * @param ring: Ring
+ * @param hdr: First part, may be NULL if hdr_len is 0
+ * @param hdr_len: First part length
+ * @param data: Second part, may be NULL if len is 0
+ * @param len: Second part length
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if there is not enough free space (nothing is written)
+ */
+esp_err_t pcm_ring_write(pcm_ring_t *ring, const void *hdr, size_t hdr_len, const void *data, size_t len);
+
+/**
+ * @brief Contiguous free space at the write position, for filling in place (producer only)
+ * @param ring: Ring
+ * @param data: Set to the first free byte
+ * @return Bytes writable at *data; fewer than pcm_ring_free() where the storage wraps
+ */
+size_t pcm_ring_reserve(pcm_ring_t *ring, uint8_t **data);
+
+/**
+ * @brief Publish len bytes written at the pointer from pcm_ring_reserve() (producer only)
+ */
+void pcm_ring_commit(pcm_ring_t *ring, size_t len);
+
+/**
+ * @brief Contiguous queued bytes at the read position, for parsing in place (consumer only)
+ * @param ring: Ring
+ * @param data: Set to the first queued byte
+ * @return Bytes readable at *data; fewer than pcm_ring_used() where the storage wraps
+ */
+size_t pcm_ring_peek(pcm_ring_t *ring, const uint8_t **data);
+
+/**
+ * @brief Copy out up to len bytes without consuming them, across the wrap (consumer only)
+ * @return Number of bytes copied
+ */
+size_t pcm_ring_copy(pcm_ring_t *ring, void *out, size_t len);
+
+/**
+ * @brief Drop len bytes from the read position (consumer only)
+ * @param ring: Ring
+ * @param len: At most pcm_ring_used()
+ */
+void pcm_ring_consume(pcm_ring_t *ring, size_t len);
+
+/**
+ * @brief Copy out and consume up to len bytes (consumer only)
+ * @return Number of bytes read
+ */
+size_t pcm_ring_read(pcm_ring_t *ring, void *out, size_t len);
+
+/**
+ * @brief Drop everything queued (consumer only)
+ */
+void pcm_ring_discard(pcm_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
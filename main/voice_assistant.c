@@ -3,6 +3,7 @@
 #include "wake_word_manager.h"
 #include "audio_player.h"
 #include "action_manager.h"
+#include "net_scheduler.h"
 #include "wake_word_manager.h"  // For pause/resume during playback
 #include "esp_log.h"
 #include "esp_heap_caps.h"
@@ -20,6 +21,7 @@ static bool s_initialized = false;
 static bool s_active = false;
 static TaskHandle_t s_assistant_task = NULL;
 static QueueHandle_t s_command_queue = NULL;
+static gemini_conversation_t *s_conversation = NULL;  // Prior turns for follow-up questions
 
 // Voice command processing task
 static void assistant_task(void *pvParameters)
@@ -56,6 +58,12 @@ __attribute__((unused)) static void on_wake_word_detected(const char *wake_word)
     // 3. Send to voice_assistant_process_command()
 }
 
+// System instruction for the LLM turn; cached server-side together with the tools
+static const char *VOICE_SYSTEM_INSTRUCTION =
+    "You are Nap, the voice assistant of a bedside sleep device. "
+    "Call a function whenever the user asks to change the lights, volume or playback. "
+    "Otherwise answer in one or two short spoken sentences without markdown.";
+
 // Function definitions for Gemini (matching SomnusDevice actions)
 static const char *get_function_definitions_json(void)
 {
@@ -130,12 +138,24 @@ static const char *get_function_definitions_json(void)
     "}";
 }
 
-// Convert Gemini function call to action_manager action
-static esp_err_t execute_function_call(const gemini_function_call_t *func_call)
+// Clamp a 0.0-1.0 argument to a whole percentage for spoken confirmations
+static int percent_from_unit(double value)
+{
+    if (value < 0.0) value = 0.0;
+    if (value > 1.0) value = 1.0;
+    return (int)(value * 100.0 + 0.5);
+}
+
+// Convert Gemini function call to action_manager action.
+// On success, `confirmation` is filled from the function's response template so the
+// spoken reply needs no second LLM round trip.
+static esp_err_t execute_function_call(const gemini_function_call_t *func_call,
+                                       char *confirmation, size_t confirmation_len)
 {
-    if (!func_call || !func_call->is_function_call) {
+    if (!func_call || !func_call->is_function_call || !confirmation || confirmation_len == 0) {
         return ESP_ERR_INVALID_ARG;
     }
+    confirmation[0] = '\0';
     
     ESP_LOGI(TAG, "🔧 Executing function call: %s with args: %s", 
              func_call->function_name, func_call->arguments);
@@ -166,6 +186,9 @@ static esp_err_t execute_function_call(const gemini_function_call_t *func_call)
             };
             strncpy(action.data.led.pattern_data, pattern_json, sizeof(action.data.led.pattern_data) - 1);
             ret = action_manager_execute(&action);
+            snprintf(confirmation, confirmation_len, "Okay, I've changed the lights.");
+        } else {
+            ret = ESP_ERR_INVALID_ARG;
         }
     } else if (strcmp(func_call->function_name, "set_led_pattern") == 0) {
         cJSON *pattern = cJSON_GetObjectItem(args, "pattern");
@@ -179,6 +202,13 @@ static esp_err_t execute_function_call(const gemini_function_call_t *func_call)
             };
             strncpy(action.data.led.pattern_data, pattern_json, sizeof(action.data.led.pattern_data) - 1);
             ret = action_manager_execute(&action);
+            if (strcmp(pattern->valuestring, "clear") == 0) {
+                snprintf(confirmation, confirmation_len, "Okay, lights off.");
+            } else {
+                snprintf(confirmation, confirmation_len, "Okay, %s it is.", pattern->valuestring);
+            }
+        } else {
+            ret = ESP_ERR_INVALID_ARG;
         }
     } else if (strcmp(func_call->function_name, "set_led_intensity") == 0) {
         cJSON *intensity = cJSON_GetObjectItem(args, "intensity");
@@ -188,6 +218,10 @@ static esp_err_t execute_function_call(const gemini_function_call_t *func_call)
                 .data.led_intensity.intensity = (float)intensity->valuedouble
             };
             ret = action_manager_execute(&action);
+            snprintf(confirmation, confirmation_len, "Brightness set to %d percent.",
+                     percent_from_unit(intensity->valuedouble));
+        } else {
+            ret = ESP_ERR_INVALID_ARG;
         }
     } else if (strcmp(func_call->function_name, "set_volume") == 0) {
         cJSON *volume = cJSON_GetObjectItem(args, "volume");
@@ -197,13 +231,19 @@ static esp_err_t execute_function_call(const gemini_function_call_t *func_call)
                 .data.volume.volume = (float)volume->valuedouble
             };
             ret = action_manager_execute(&action);
+            snprintf(confirmation, confirmation_len, "Volume set to %d percent.",
+                     percent_from_unit(volume->valuedouble));
+        } else {
+            ret = ESP_ERR_INVALID_ARG;
         }
     } else if (strcmp(func_call->function_name, "pause_device") == 0) {
         action_t action = { .type = ACTION_PAUSE };
         ret = action_manager_execute(&action);
+        snprintf(confirmation, confirmation_len, "Paused.");
     } else if (strcmp(func_call->function_name, "resume_device") == 0) {
         action_t action = { .type = ACTION_PLAY };
         ret = action_manager_execute(&action);
+        snprintf(confirmation, confirmation_len, "Resuming.");
     } else {
         ESP_LOGW(TAG, "Unknown function: %s", func_call->function_name);
         ret = ESP_ERR_NOT_FOUND;
@@ -213,6 +253,23 @@ static esp_err_t execute_function_call(const gemini_function_call_t *func_call)
     return ret;
 }
 
+// Streaming TTS playback callback
+// Called with decoded PCM audio chunks as they arrive from the API
+static esp_err_t tts_playback_callback(const int16_t *samples, size_t sample_count, void *user_data)
+{
+    // user_data is unused, but could be used to pass state if needed
+    (void)user_data;
+
+    if (!samples || sample_count == 0) {
+        return ESP_OK;
+    }
+
+    // Queue PCM chunk on the voice stream (24kHz, mono); background media is ducked under it
+    // This avoids buffering entire audio in memory; waits only while the ring is full
+    // Note: Wake word detection should be paused during TTS playback to prevent feedback
+    return audio_player_stream_submit(AUDIO_STREAM_VOICE, samples, sample_count, 24000, 1, portMAX_DELAY, NULL);
+}
+
 // Process complete voice command: STT -> LLM (with function calling) -> Execute actions -> TTS -> Playback
 static esp_err_t process_voice_command(const int16_t *audio_data, size_t audio_len)
 {
@@ -233,27 +290,19 @@ static esp_err_t process_voice_command(const int16_t *audio_data, size_t audio_l
     gemini_function_call_t function_call = {0};
     const char *tools_json = get_function_definitions_json();
     
-    ret = gemini_llm_with_functions(transcribed_text, tools_json, 
-                                     llm_response, sizeof(llm_response),
-                                     &function_call);
+    ret = gemini_llm_converse(s_conversation, transcribed_text, tools_json,
+                              llm_response, sizeof(llm_response),
+                              &function_call);
     
     // Check if LLM wants to call a function
     if (ret == ESP_ERR_NOT_FOUND && function_call.is_function_call) {
         ESP_LOGI(TAG, "LLM requested function call: %s", function_call.function_name);
         
-        // Execute the function call
-        esp_err_t action_ret = execute_function_call(&function_call);
+        // Execute the function call; the confirmation comes from the function's
+        // response template rather than a second LLM request
+        esp_err_t action_ret = execute_function_call(&function_call, llm_response, sizeof(llm_response));
         if (action_ret == ESP_OK) {
-            // Function executed successfully, get confirmation text
-            char confirm_prompt[1024];
-            snprintf(confirm_prompt, sizeof(confirm_prompt),
-                    "The user said: \"%s\". I executed the function %s. Provide a brief confirmation message (1-2 sentences).",
-                    transcribed_text, function_call.function_name);
-            
-            // Get text response for confirmation
-            ret = gemini_llm(confirm_prompt, llm_response, sizeof(llm_response));
-            if (ret != ESP_OK) {
-                // Fallback message
+            if (llm_response[0] == '\0') {
                 snprintf(llm_response, sizeof(llm_response), "Done.");
             }
         } else {
@@ -268,33 +317,26 @@ static esp_err_t process_voice_command(const int16_t *audio_data, size_t audio_l
     
     ESP_LOGI(TAG, "LLM response: %s", llm_response);
     
-    // Step 3: Text-to-Speech
-    const size_t tts_buffer_size = 48000; // ~2 seconds at 24kHz
-    int16_t *tts_audio = (int16_t *)malloc(tts_buffer_size * sizeof(int16_t));
-    if (!tts_audio) {
-        ESP_LOGE(TAG, "Failed to allocate TTS buffer");
-        return ESP_ERR_NO_MEM;
+    // Remember the exchange as spoken so a follow-up can refer back to it
+    if (s_conversation) {
+        gemini_conversation_add(s_conversation, GEMINI_ROLE_USER, transcribed_text);
+        gemini_conversation_add(s_conversation, GEMINI_ROLE_MODEL, llm_response);
     }
     
-    size_t samples_written = 0;
-    ret = gemini_tts(llm_response, tts_audio, tts_buffer_size, &samples_written);
+    // Step 3: Text-to-Speech and playback
+    // The PCM buffer is sized from the response, so long replies aren't cut at a fixed length.
+    // The reply's TTS request runs as TTS prefetch: behind the STT/LLM requests of a
+    // voice turn, still ahead of telemetry and weather
+    net_scheduler_set_task_priority(NULL, NET_PRIO_TTS_PREFETCH);
+    ret = gemini_tts_streaming(llm_response, tts_playback_callback, NULL);
+    net_scheduler_set_task_priority(NULL, NET_PRIO_VOICE);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "TTS failed: %s", esp_err_to_name(ret));
-        free(tts_audio);
         return ret;
     }
     
-    ESP_LOGI(TAG, "TTS generated %zu samples", samples_written);
-    
-    // Step 4: Play audio response
-    // Note: TTS typically outputs at 24kHz, but our audio player may be at 48kHz
-    // We'll need to resample or configure TTS for 48kHz
-    ret = audio_player_submit_pcm(tts_audio, samples_written, 24000, 1); // Mono, 24kHz
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Audio playback failed: %s", esp_err_to_name(ret));
-    }
-    
-    free(tts_audio);
+    // Playback is asynchronous; don't reopen the microphone until the reply has been heard
+    audio_player_stream_wait_idle(AUDIO_STREAM_VOICE, portMAX_DELAY);
     return ESP_OK;
 }
 
@@ -335,11 +377,20 @@ esp_err_t voice_assistant_init(const voice_assistant_config_t *config)
         // action_manager_deinit(); // Disabled
         return ret;
     }
+    gemini_api_set_system_instruction(VOICE_SYSTEM_INSTRUCTION);
+    
+    // History is optional: without it every turn is sent single-shot
+    s_conversation = gemini_conversation_create(0);
+    if (!s_conversation) {
+        ESP_LOGW(TAG, "No memory for conversation history, follow-ups won't have context");
+    }
     
     // Create command queue
     s_command_queue = xQueueCreate(4, sizeof(size_t)); // Store audio buffer pointers
     if (!s_command_queue) {
         ESP_LOGE(TAG, "Failed to create command queue");
+        gemini_conversation_destroy(s_conversation);
+        s_conversation = NULL;
         gemini_api_deinit();
         // action_manager_deinit(); // Disabled
         return ESP_ERR_NO_MEM;
@@ -405,7 +456,11 @@ esp_err_t voice_assistant_process_command(const int16_t *audio_data, size_t audi
         return ESP_ERR_INVALID_STATE;
     }
     
-    return process_voice_command(audio_data, audio_len);
+    // Hold background network work (telemetry, weather) for the whole turn
+    net_scheduler_voice_turn_begin();
+    esp_err_t ret = process_voice_command(audio_data, audio_len);
+    net_scheduler_voice_turn_end();
+    return ret;
 }
 
 bool voice_assistant_is_active(void)
@@ -422,6 +477,8 @@ void voice_assistant_deinit(void)
         s_command_queue = NULL;
     }
     
+    gemini_conversation_destroy(s_conversation);
+    s_conversation = NULL;
     gemini_api_deinit();
     // action_manager_deinit(); // Disabled for debugging
     s_initialized = false;
@@ -429,23 +486,6 @@ void voice_assistant_deinit(void)
     ESP_LOGI(TAG, "Voice assistant deinitialized");
 }
 
-// Streaming TTS playback callback
-// Called with decoded PCM audio chunks as they arrive from the API
-static esp_err_t tts_playback_callback(const int16_t *samples, size_t sample_count, void *user_data)
-{
-    // user_data is unused, but could be used to pass state if needed
-    (void)user_data;
-
-    if (!samples || sample_count == 0) {
-        return ESP_OK;
-    }
-
-    // Submit PCM chunk directly to audio player (24kHz, mono)
-    // This avoids buffering entire audio in memory
-    // Note: Wake word detection should be paused during TTS playback to prevent feedback
-    return audio_player_submit_pcm(samples, sample_count, 24000, 1);
-}
-
 // Test TTS function - generate and play audio from text using streaming
 // Gracefully handles network errors (e.g., in China where Google is blocked)
 esp_err_t voice_assistant_test_tts(const char *text)
@@ -471,6 +511,7 @@ esp_err_t voice_assistant_test_tts(const char *text)
     // No need to allocate 80KB buffer for entire audio
     // Timeout is typically 30 seconds, but will fail faster if network is down
     esp_err_t ret = gemini_tts_streaming(text, tts_playback_callback, NULL);
+    audio_player_stream_wait_idle(AUDIO_STREAM_VOICE, portMAX_DELAY);
     
     // Resume wake word detection after TTS completes
     wake_word_manager_resume();
@@ -195,55 +195,32 @@ static esp_err_t es7210_init_with_codec_dev(void)
     return ESP_OK;
 }
 
-// Wake word detection callback
-static void on_wake_word_detected(const char *wake_word)
+#ifndef CONFIG_VOICE_FOLLOWUP_WINDOW_MS
+#define CONFIG_VOICE_FOLLOWUP_WINDOW_MS 0
+#endif
+#ifndef CONFIG_VOICE_FOLLOWUP_MAX_TURNS
+#define CONFIG_VOICE_FOLLOWUP_MAX_TURNS 0
+#endif
+#define FOLLOWUP_ONSET_RMS      400   // Chunk RMS that counts as the user speaking again
+#define FOLLOWUP_SETTLE_MS      300   // Let the reply's DMA tail drain before listening
+
+static float chunk_rms(const int16_t *samples, size_t count)
 {
-    ESP_LOGI(TAG, "*** WAKE WORD DETECTED: %s ***", wake_word);
-    
-    // Only process if it's "Hey Nap"
-    if (strcmp(wake_word, "hey_nap") != 0) {
-        ESP_LOGD(TAG, "Ignoring wake word: %s (expected 'hey_nap')", wake_word);
-        return;
-    }
-    
-    // IMPORTANT: Temporarily stop the continuous mic capture task to avoid I2S conflicts
-    // The continuous task and recording both try to read from the same I2S channel
-    bool was_running = s_running;
-    if (was_running) {
-        ESP_LOGI(TAG, "Pausing continuous mic capture during recording...");
-        s_running = false;  // Stop continuous capture
-        // Wait longer for task to exit - it needs to finish current I2S read and break from loop
-        vTaskDelay(pdMS_TO_TICKS(500));  // Increased delay to ensure task fully stops
+    int64_t sum_sq = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum_sq += (int32_t)samples[i] * samples[i];
     }
-    
-    // Record audio for voice command (after wake word)
-    // Record for ~3-5 seconds or until silence detected
-    const size_t record_duration_ms = 3000;  // 3 seconds
-    const size_t sample_rate = 16000;
-    const size_t record_samples = (record_duration_ms * sample_rate) / 1000;
-    
-    // Allocate buffer in PSRAM for audio recording
-    int16_t *audio_buffer = (int16_t *)heap_caps_malloc(record_samples * sizeof(int16_t), 
-                                                         MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!audio_buffer) {
-        ESP_LOGW(TAG, "PSRAM allocation failed, trying internal RAM");
-        audio_buffer = (int16_t *)heap_caps_malloc(record_samples * sizeof(int16_t),
-                                                    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-        if (!audio_buffer) {
-            ESP_LOGE(TAG, "Failed to allocate audio buffer for voice command");
-            return;
-        }
-    }
-    
-    ESP_LOGI(TAG, "🎤 Recording voice command after 'Hey Nap' (%zu samples, %.1f seconds)...", 
-             record_samples, (float)record_duration_ms / 1000.0f);
-    
-    // Small delay to skip the wake word itself and start recording the command
-    vTaskDelay(pdMS_TO_TICKS(200));
-    
-    // Record audio from microphone (after wake word)
+    return count ? sqrtf((float)sum_sq / count) : 0.0f;
+}
+
+// Record a command into audio_buffer. With onset_timeout_ms > 0 nothing is kept
+// until a chunk's RMS shows speech; returns 0 if none starts within the timeout.
+static size_t record_command(int16_t *audio_buffer, size_t record_samples, uint32_t onset_timeout_ms)
+{
+    const size_t record_duration_ms = (record_samples * 1000) / 16000;
     size_t samples_recorded = 0;
     const size_t chunk_size = 512;  // Read in chunks
+    bool speech_started = (onset_timeout_ms == 0);
     int64_t start_time = esp_timer_get_time();
     
     while (samples_recorded < record_samples) {
@@ -273,10 +250,22 @@ static void on_wake_word_detected(const char *wake_word)
         if (ret == ESP_OK && bytes_read > 0) {
             // Convert 32-bit stereo to 16-bit mono
             size_t stereo_samples = bytes_read / sizeof(int32_t);
+            size_t chunk_start = samples_recorded;
             for (size_t i = 0; i < stereo_samples / 2 && samples_recorded < record_samples; i++) {
                 int32_t left = temp_buffer[i * 2];
                 audio_buffer[samples_recorded++] = (int16_t)(left >> 16);  // Upper 16 bits
             }
+            if (!speech_started) {
+                if (chunk_rms(audio_buffer + chunk_start, samples_recorded - chunk_start) >= FOLLOWUP_ONSET_RMS) {
+                    ESP_LOGI(TAG, "🎤 Follow-up speech detected, recording...");
+                    speech_started = true;
+                    start_time = esp_timer_get_time();
+                    // Overlap the TLS handshakes with the rest of the follow-up
+                    gemini_api_prewarm();
+                } else {
+                    samples_recorded = chunk_start;  // Discard silence before the onset
+                }
+            }
         } else if (ret != ESP_OK) {
             ESP_LOGW(TAG, "Microphone read error during recording: %s", esp_err_to_name(ret));
             free(temp_buffer);
@@ -284,47 +273,127 @@ static void on_wake_word_detected(const char *wake_word)
         }
         free(temp_buffer);
         
-        // Check timeout (safety)
         int64_t elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+        if (!speech_started) {
+            if (elapsed_ms > onset_timeout_ms) {
+                break;  // Follow-up window closed without speech
+            }
+            continue;
+        }
+        // Check timeout (safety)
         if (elapsed_ms > record_duration_ms + 500) {
             ESP_LOGW(TAG, "Recording timeout");
             break;
         }
     }
     
-    ESP_LOGI(TAG, "✅ Recorded %zu samples (%.2f seconds)", 
-             samples_recorded, (float)samples_recorded / sample_rate);
+    return speech_started ? samples_recorded : 0;
+}
+
+// Wake word detection callback
+static void on_wake_word_detected(const char *wake_word)
+{
+    ESP_LOGI(TAG, "*** WAKE WORD DETECTED: %s ***", wake_word);
     
-    // Resume continuous mic capture if it was running
-    // Use wake_word_manager_start() to restart properly
-    if (was_running) {
-        ESP_LOGI(TAG, "Resuming continuous mic capture...");
-        // Small delay to ensure I2S channel is ready
-        vTaskDelay(pdMS_TO_TICKS(100));
-        // Restart using the existing function (it will check s_running and create task)
-        s_running = false;  // Ensure it's false so start() will create the task
-        esp_err_t ret = wake_word_manager_start();
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to restart mic capture: %s", esp_err_to_name(ret));
-        } else {
-            ESP_LOGI(TAG, "Mic capture restarted successfully");
+    // Only process if it's "Hey Nap"
+    if (strcmp(wake_word, "hey_nap") != 0) {
+        ESP_LOGD(TAG, "Ignoring wake word: %s (expected 'hey_nap')", wake_word);
+        return;
+    }
+    
+    // Start STT/LLM TLS handshakes now so they complete while the command is recorded
+    esp_err_t prewarm_ret = gemini_api_prewarm();
+    if (prewarm_ret != ESP_OK && prewarm_ret != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "TLS pre-warm not started: %s", esp_err_to_name(prewarm_ret));
+    }
+    
+    // Record audio for voice command (after wake word)
+    // Record for ~3-5 seconds or until silence detected
+    const size_t record_duration_ms = 3000;  // 3 seconds
+    const size_t sample_rate = 16000;
+    const size_t record_samples = (record_duration_ms * sample_rate) / 1000;
+    
+    // Allocate buffer in PSRAM for audio recording
+    int16_t *audio_buffer = (int16_t *)heap_caps_malloc(record_samples * sizeof(int16_t), 
+                                                         MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!audio_buffer) {
+        ESP_LOGW(TAG, "PSRAM allocation failed, trying internal RAM");
+        audio_buffer = (int16_t *)heap_caps_malloc(record_samples * sizeof(int16_t),
+                                                    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (!audio_buffer) {
+            ESP_LOGE(TAG, "Failed to allocate audio buffer for voice command");
+            return;
         }
     }
     
-    if (samples_recorded > 0) {
+    // The first command follows the wake word directly; after each answer a
+    // follow-up window listens for more speech without requiring the wake word
+    for (int turn = 0; turn <= CONFIG_VOICE_FOLLOWUP_MAX_TURNS; turn++) {
+        uint32_t onset_timeout_ms = (turn == 0) ? 0 : CONFIG_VOICE_FOLLOWUP_WINDOW_MS;
+        
+        // IMPORTANT: Temporarily stop the continuous mic capture task to avoid I2S conflicts
+        // The continuous task and recording both try to read from the same I2S channel
+        bool was_running = s_running;
+        if (was_running) {
+            ESP_LOGI(TAG, "Pausing continuous mic capture during recording...");
+            s_running = false;  // Stop continuous capture
+            // Wait longer for task to exit - it needs to finish current I2S read and break from loop
+            vTaskDelay(pdMS_TO_TICKS(500));  // Increased delay to ensure task fully stops
+        }
+        
+        if (turn == 0) {
+            ESP_LOGI(TAG, "🎤 Recording voice command after 'Hey Nap' (%zu samples, %.1f seconds)...", 
+                     record_samples, (float)record_duration_ms / 1000.0f);
+            // Small delay to skip the wake word itself and start recording the command
+            vTaskDelay(pdMS_TO_TICKS(200));
+        } else {
+            ESP_LOGI(TAG, "👂 Listening for a follow-up (%lu ms, no wake word needed)...",
+                     (unsigned long)onset_timeout_ms);
+            vTaskDelay(pdMS_TO_TICKS(FOLLOWUP_SETTLE_MS));
+        }
+        
+        // Record audio from microphone
+        size_t samples_recorded = record_command(audio_buffer, record_samples, onset_timeout_ms);
+        
+        ESP_LOGI(TAG, "✅ Recorded %zu samples (%.2f seconds)", 
+                 samples_recorded, (float)samples_recorded / sample_rate);
+        
+        // Resume continuous mic capture if it was running
+        // Use wake_word_manager_start() to restart properly
+        if (was_running) {
+            ESP_LOGI(TAG, "Resuming continuous mic capture...");
+            // Small delay to ensure I2S channel is ready
+            vTaskDelay(pdMS_TO_TICKS(100));
+            // Restart using the existing function (it will check s_running and create task)
+            s_running = false;  // Ensure it's false so start() will create the task
+            esp_err_t ret = wake_word_manager_start();
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to restart mic capture: %s", esp_err_to_name(ret));
+            } else {
+                ESP_LOGI(TAG, "Mic capture restarted successfully");
+            }
+        }
+        
+        if (samples_recorded == 0) {
+            if (turn == 0) {
+                ESP_LOGW(TAG, "No audio recorded, skipping STT");
+            } else {
+                ESP_LOGI(TAG, "No follow-up, back to wake word detection");
+            }
+            break;
+        }
+        
         // Validate audio - check if it's all zeros (microphone not working)
         int32_t sum = 0;
-        int32_t sum_sq = 0;
         int16_t max_val = 0;
         int16_t min_val = 0;
         for (size_t i = 0; i < samples_recorded; i++) {
             int16_t sample = audio_buffer[i];
             sum += sample;
-            sum_sq += (int32_t)sample * sample;
             if (sample > max_val) max_val = sample;
             if (sample < min_val) min_val = sample;
         }
-        float rms = sqrtf((float)sum_sq / samples_recorded);
+        float rms = chunk_rms(audio_buffer, samples_recorded);
         float avg = (float)sum / samples_recorded;
         ESP_LOGI(TAG, "📊 Recorded audio stats: RMS=%.1f, avg=%.1f, peak=[%d, %d]", rms, avg, min_val, max_val);
         
@@ -338,11 +407,9 @@ static void on_wake_word_detected(const char *wake_word)
         esp_err_t cmd_ret = voice_assistant_process_command(audio_buffer, samples_recorded);
         if (cmd_ret != ESP_OK) {
             ESP_LOGW(TAG, "Voice command processing failed: %s", esp_err_to_name(cmd_ret));
-        } else {
-            ESP_LOGI(TAG, "✅ Voice command processed successfully");
+            break;  // Don't hold the mic open after a failed turn
         }
-    } else {
-        ESP_LOGW(TAG, "No audio recorded, skipping STT");
+        ESP_LOGI(TAG, "✅ Voice command processed successfully");
     }
     
     free(audio_buffer);
@@ -13,6 +13,8 @@
 #include "voice_assistant.h"
 #include "sensor_integration.h"
 #include "audio_file_manager.h"
+#include "audio_telemetry.h"
+#include "sd_cache.h"
 #include "esp_log.h"
 #include "esp_http_server.h"
 #include "esp_netif.h"
@@ -23,6 +25,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <time.h>
@@ -73,8 +77,10 @@ static esp_err_t api_state_handler(httpd_req_t *req);
 static esp_err_t api_logs_handler(httpd_req_t *req);
 static esp_err_t api_sensors_handler(httpd_req_t *req);
 static esp_err_t api_audio_list_handler(httpd_req_t *req);
+static esp_err_t api_audio_search_handler(httpd_req_t *req);
 static esp_err_t api_audio_play_handler(httpd_req_t *req);
 static esp_err_t api_audio_upload_handler(httpd_req_t *req);
+static esp_err_t api_audio_telemetry_handler(httpd_req_t *req);
 static int log_vprintf(const char *fmt, va_list args);
 
 // HTML dashboard
@@ -148,12 +154,17 @@ static const char* html_dashboard =
 "</div>"
 "<div class='card'><h2>MP3 Player</h2>"
 "<div class='control-group'>"
+"<label>Search:</label>"
+"<input type='text' id='audio-search' placeholder='e.g. rain, ocean sleep' style='flex: 1; min-width: 200px;'>"
+"</div>"
+"<div class='control-group'>"
 "<label>Select Track:</label>"
 "<select id='audio-track' style='flex: 1; min-width: 200px;'>"
 "<option value=''>Loading tracks...</option>"
 "</select>"
 "<button class='button button-primary' onclick='playAudio()'>Play</button>"
 "<button class='button button-danger' onclick='stopAudio()'>Stop</button>"
+"<button class='button' onclick='resumeAudio()'>Resume</button>"
 "</div>"
 "<div id='audio-status' style='margin-top: 10px; color: #aaa;'>Ready</div>"
 "</div>"
@@ -231,6 +242,10 @@ static const char* html_dashboard =
 "      {label:'Free Heap', value: (data.free_heap / 1024).toFixed(1) + ' KB'},"
 "      {label:'Uptime', value: (data.uptime_seconds / 60).toFixed(1) + ' min'}"
 "    ];"
+"    if (data.audio && data.audio.track) {"
+"      items.push({label:'Now Playing', value: data.audio.track + ' ' + formatTime(data.audio.position_ms) +"
+"        (data.audio.duration_ms ? ' / ' + formatTime(data.audio.duration_ms) : '')});"
+"    }"
 "    items.forEach(item=>{"
 "      const div = document.createElement('div');"
 "      div.className = 'status-item';"
@@ -370,7 +385,7 @@ static const char* html_dashboard =
 "      data.tracks.forEach(track=>{"
 "        const opt = document.createElement('option');"
 "        opt.value = track.name;"
-"        opt.textContent = track.display_name || track.name;"
+"        opt.textContent = (track.display_name || track.name) + (track.duration_ms ? ' (' + formatTime(track.duration_ms) + ')' : '');"
 "        select.appendChild(opt);"
 "      });"
 "    } else {"
@@ -380,6 +395,34 @@ static const char* html_dashboard =
 "    document.getElementById('audio-status').textContent = 'Error loading tracks: ' + e;"
 "  });"
 "}"
+"let searchTimer = null;"
+"function searchAudio() {"
+"  const q = document.getElementById('audio-search').value.trim();"
+"  if (!q) { loadAudioList(); return; }"
+"  fetch('/api/audio/search?q=' + encodeURIComponent(q)).then(r=>r.json()).then(data=>{"
+"    const select = document.getElementById('audio-track');"
+"    select.innerHTML = '';"
+"    if (data.matches && data.matches.length > 0) {"
+"      data.matches.forEach(m=>{"
+"        const opt = document.createElement('option');"
+"        opt.value = m.name;"
+"        opt.textContent = (m.display_name || m.name) + (m.duration_ms ? ' (' + formatTime(m.duration_ms) + ')' : '');"
+"        select.appendChild(opt);"
+"      });"
+"    } else {"
+"      select.innerHTML = '<option value=\"\">No matching tracks</option>';"
+"    }"
+"  }).catch(e=>{"
+"    document.getElementById('audio-status').textContent = 'Search failed: ' + e;"
+"  });"
+"}"
+"document.getElementById('audio-search').addEventListener('input', function() {"
+"  clearTimeout(searchTimer);"
+"  searchTimer = setTimeout(searchAudio, 200);"
+"});"
+"document.getElementById('audio-search').addEventListener('keydown', function(e) {"
+"  if (e.key === 'Enter') { clearTimeout(searchTimer); searchAudio(); }"
+"});"
 "function playAudio() {"
 "  const select = document.getElementById('audio-track');"
 "  const trackName = select.value;"
@@ -402,6 +445,17 @@ static const char* html_dashboard =
 "    document.getElementById('audio-status').textContent = 'Error: ' + e;"
 "  });"
 "}"
+"function resumeAudio() {"
+"  fetch('/api/audio/play', {"
+"    method: 'POST',"
+"    headers: {'Content-Type': 'application/json'},"
+"    body: JSON.stringify({resume: true, volume: 1.0})"
+"  }).then(r=>r.json()).then(data=>{"
+"    document.getElementById('audio-status').textContent = data.success ? 'Resumed' : 'Nothing to resume';"
+"  }).catch(e=>{"
+"    document.getElementById('audio-status').textContent = 'Error: ' + e;"
+"  });"
+"}"
 "function stopAudio() {"
 "  fetch('/api/action', {"
 "    method: 'POST',"
@@ -478,6 +532,10 @@ static const char* html_dashboard =
 "  xhr.open('POST', '/api/audio/upload');"
 "  xhr.send(formData);"
 "}"
+"function formatTime(ms) {"
+"  const s = Math.floor(ms / 1000);"
+"  return Math.floor(s / 60) + ':' + String(s % 60).padStart(2, '0');"
+"}"
 "function formatBytes(bytes) {"
 "  if (bytes === 0) return '0 Bytes';"
 "  const k = 1024;"
@@ -503,6 +561,76 @@ static esp_err_t root_handler(httpd_req_t *req) {
 }
 
 // API: Get device status
+static void add_hist(cJSON *parent, const char *name, const audio_telemetry_hist_t *h) {
+    cJSON *obj = cJSON_AddObjectToObject(parent, name);
+    cJSON_AddNumberToObject(obj, "count", h->count);
+    cJSON_AddNumberToObject(obj, "avg_us", h->count ? (double)(h->total_us / h->count) : 0);
+    cJSON_AddNumberToObject(obj, "p50_us", audio_telemetry_percentile_us(h, 0.50f));
+    cJSON_AddNumberToObject(obj, "p99_us", audio_telemetry_percentile_us(h, 0.99f));
+    cJSON_AddNumberToObject(obj, "max_us", h->max_us);
+    cJSON *buckets = cJSON_AddArrayToObject(obj, "buckets");
+    for (int b = 0; b < AUDIO_TELEMETRY_BUCKETS; b++) {
+        cJSON_AddItemToArray(buckets, cJSON_CreateNumber(h->buckets[b]));
+    }
+}
+
+// Playback telemetry; the same data is served in binary by /api/audio/telemetry
+static void add_audio_telemetry(cJSON *json) {
+    static const char *const stream_names[AUDIO_TELEMETRY_STREAMS] = { "media", "media_alt", "voice", "alert" };
+    audio_telemetry_snapshot_t snap;
+    audio_telemetry_snapshot(&snap);
+
+    cJSON *audio = cJSON_AddObjectToObject(json, "audio");
+    cJSON_AddBoolToObject(audio, "playing", snap.playing);
+    audio_file_position_t pos;
+    if (audio_file_manager_get_position(&pos) == ESP_OK) {
+        cJSON_AddStringToObject(audio, "track", pos.name);
+        cJSON_AddNumberToObject(audio, "position_ms", pos.position_ms);
+        if (pos.duration_ms > 0) {
+            cJSON_AddNumberToObject(audio, "duration_ms", pos.duration_ms);
+        }
+    }
+    cJSON_AddNumberToObject(audio, "frames_played", (double)snap.frames_played);
+    cJSON_AddNumberToObject(audio, "dma_underruns", snap.dma_underruns);
+    cJSON_AddNumberToObject(audio, "dma_fill_min", snap.dma_fill_min_percent);
+    cJSON_AddNumberToObject(audio, "dma_fill_avg", snap.dma_fill_avg_percent);
+    cJSON *buckets = cJSON_AddArrayToObject(audio, "bucket_floor_us");
+    for (int b = 0; b < AUDIO_TELEMETRY_BUCKETS; b++) {
+        cJSON_AddItemToArray(buckets, cJSON_CreateNumber(audio_telemetry_bucket_floor_us(b)));
+    }
+    add_hist(audio, "i2s_write", &snap.hist[AUDIO_TELEMETRY_I2S_WRITE]);
+    add_hist(audio, "decode", &snap.hist[AUDIO_TELEMETRY_DECODE]);
+    add_hist(audio, "sd_read", &snap.hist[AUDIO_TELEMETRY_SD_READ]);
+    add_hist(audio, "reader_wait", &snap.hist[AUDIO_TELEMETRY_READER_WAIT]);
+
+    sd_cache_stats_t cache;
+    sd_cache_get_stats(&cache);
+    cJSON *sd = cJSON_AddObjectToObject(audio, "sd_cache");
+    cJSON_AddNumberToObject(sd, "hits", cache.hits);
+    cJSON_AddNumberToObject(sd, "misses", cache.misses);
+    cJSON_AddNumberToObject(sd, "blocks_read", cache.blocks_read);
+    cJSON_AddNumberToObject(sd, "readahead_blocks", cache.readahead_blocks);
+    cJSON_AddNumberToObject(sd, "prefetch_blocks", cache.prefetch_blocks);
+    cJSON_AddNumberToObject(sd, "evictions", cache.evictions);
+    cJSON_AddNumberToObject(sd, "read_errors", cache.read_errors);
+    cJSON_AddNumberToObject(sd, "wait_us_max", cache.wait_us_max);
+
+    cJSON *streams = cJSON_AddObjectToObject(audio, "streams");
+    for (int i = 0; i < AUDIO_TELEMETRY_STREAMS; i++) {
+        const audio_telemetry_stream_t *st = &snap.streams[i];
+        cJSON *obj = cJSON_AddObjectToObject(streams, stream_names[i]);
+        cJSON_AddBoolToObject(obj, "playing", st->playing);
+        cJSON_AddNumberToObject(obj, "frames_played", (double)st->frames_played);
+        cJSON_AddNumberToObject(obj, "underruns", st->underruns);
+        cJSON_AddNumberToObject(obj, "underrun_ms", st->underrun_ms);
+        cJSON_AddNumberToObject(obj, "overruns", st->overruns);
+        cJSON_AddNumberToObject(obj, "rejected", st->rejected);
+        cJSON_AddNumberToObject(obj, "fill", st->fill_percent);
+        cJSON_AddNumberToObject(obj, "fill_min", st->fill_min_percent);
+        cJSON_AddNumberToObject(obj, "fill_avg", st->fill_avg_percent);
+    }
+}
+
 static esp_err_t api_status_handler(httpd_req_t *req) {
     (void)req;
     cJSON *json = cJSON_CreateObject();
@@ -528,6 +656,7 @@ static esp_err_t api_status_handler(httpd_req_t *req) {
     cJSON_AddNumberToObject(json, "free_heap", esp_get_free_heap_size());
     cJSON_AddNumberToObject(json, "uptime_seconds", esp_timer_get_time() / 1000000);
     cJSON_AddStringToObject(json, "firmware_version", "0.1");
+    add_audio_telemetry(json);
     
     char *json_str = cJSON_Print(json);
     httpd_resp_set_type(req, "application/json");
@@ -537,6 +666,14 @@ static esp_err_t api_status_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// API: Playback telemetry as a packed audio_telemetry_snapshot_t (little-endian)
+static esp_err_t api_audio_telemetry_handler(httpd_req_t *req) {
+    audio_telemetry_snapshot_t snap;
+    audio_telemetry_snapshot(&snap);
+    httpd_resp_set_type(req, "application/octet-stream");
+    return httpd_resp_send(req, (const char *)&snap, sizeof(snap));
+}
+
 // API: Execute action
 static esp_err_t api_action_handler(httpd_req_t *req) {
     cJSON *json = cJSON_CreateObject();
@@ -609,7 +746,7 @@ esp_err_t webserver_start(webserver_t **out_server, const webserver_config_t *cf
     
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = ws->config.port;
-    config.max_uri_handlers = 10;
+    config.max_uri_handlers = 12;
     config.max_open_sockets = 7;
     
     esp_err_t err = httpd_start(&ws->server, &config);
@@ -676,6 +813,14 @@ esp_err_t webserver_start(webserver_t **out_server, const webserver_config_t *cf
     };
     httpd_register_uri_handler(ws->server, &audio_list_uri);
     
+    httpd_uri_t audio_search_uri = {
+        .uri = "/api/audio/search",
+        .method = HTTP_GET,
+        .handler = api_audio_search_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(ws->server, &audio_search_uri);
+
     httpd_uri_t audio_play_uri = {
         .uri = "/api/audio/play",
         .method = HTTP_POST,
@@ -692,6 +837,14 @@ esp_err_t webserver_start(webserver_t **out_server, const webserver_config_t *cf
     };
     httpd_register_uri_handler(ws->server, &audio_upload_uri);
     
+    httpd_uri_t audio_telemetry_uri = {
+        .uri = "/api/audio/telemetry",
+        .method = HTTP_GET,
+        .handler = api_audio_telemetry_handler,
+        .user_ctx = ws
+    };
+    httpd_register_uri_handler(ws->server, &audio_telemetry_uri);
+    
     // Initialize log buffer and hook into logging system
     if (!s_log_buffer.initialized) {
         // Allocate log buffer from PSRAM
@@ -788,6 +941,16 @@ static esp_err_t api_audio_list_handler(httpd_req_t *req) {
             cJSON_AddStringToObject(track, "name", info.name);
             cJSON_AddStringToObject(track, "display_name", info.display_name ? info.display_name : info.name);
             cJSON_AddNumberToObject(track, "size", info.data_len);
+            if (info.duration_ms > 0) {
+                cJSON_AddNumberToObject(track, "duration_ms", info.duration_ms);
+            }
+            if (info.bitrate_kbps > 0) {
+                cJSON_AddNumberToObject(track, "bitrate_kbps", info.bitrate_kbps);
+                cJSON_AddNumberToObject(track, "sample_rate", info.sample_rate);
+            }
+            if (info.replay_gain != AUDIO_FILE_GAIN_UNKNOWN) {
+                cJSON_AddNumberToObject(track, "replay_gain_db", info.replay_gain / 10.0);
+            }
             cJSON_AddItemToArray(tracks, track);
         }
     }
@@ -811,6 +974,69 @@ static esp_err_t api_audio_list_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// Decode %XX and '+' of a query string value in place
+static void url_decode(char *s)
+{
+    char *out = s;
+    for (char *in = s; *in; in++) {
+        if (*in == '+') {
+            *out++ = ' ';
+        } else if (*in == '%' && isxdigit((unsigned char)in[1]) && isxdigit((unsigned char)in[2])) {
+            char hex[3] = { in[1], in[2], '\0' };
+            *out++ = (char)strtol(hex, NULL, 16);
+            in += 2;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+// API: Fuzzy track search, best first: /api/audio/search?q=rain&limit=5
+static esp_err_t api_audio_search_handler(httpd_req_t *req) {
+    char query[256] = {0};
+    char q[128] = {0};
+    char limit_str[8] = {0};
+    size_t limit = 10;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "q", q, sizeof(q));
+        if (httpd_query_key_value(query, "limit", limit_str, sizeof(limit_str)) == ESP_OK) {
+            int n = atoi(limit_str);
+            if (n > 0) {
+                limit = (size_t)n;
+            }
+        }
+    }
+    url_decode(q);
+    if (limit > AUDIO_FILE_SEARCH_MAX) {
+        limit = AUDIO_FILE_SEARCH_MAX;
+    }
+
+    audio_file_match_t matches[AUDIO_FILE_SEARCH_MAX];
+    size_t found = audio_file_manager_search(q, matches, limit);
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "query", q);
+    cJSON *list = cJSON_AddArrayToObject(json, "matches");
+    for (size_t i = 0; i < found; i++) {
+        cJSON *match = cJSON_CreateObject();
+        cJSON_AddStringToObject(match, "name", matches[i].info.name);
+        cJSON_AddStringToObject(match, "display_name", matches[i].info.display_name);
+        cJSON_AddNumberToObject(match, "score", matches[i].score);
+        if (matches[i].info.duration_ms > 0) {
+            cJSON_AddNumberToObject(match, "duration_ms", matches[i].info.duration_ms);
+        }
+        cJSON_AddItemToArray(list, match);
+    }
+
+    char *json_str = cJSON_PrintUnformatted(json);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json_str, HTTPD_RESP_USE_STRLEN);
+    free(json_str);
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
 // API: Play audio track
 static esp_err_t api_audio_play_handler(httpd_req_t *req) {
     cJSON *json = cJSON_CreateObject();
@@ -830,14 +1056,35 @@ static esp_err_t api_audio_play_handler(httpd_req_t *req) {
         if (root) {
             cJSON *name = cJSON_GetObjectItem(root, "name");
             cJSON *volume = cJSON_GetObjectItem(root, "volume");
+            cJSON *position = cJSON_GetObjectItem(root, "position_ms");
+            cJSON *resume = cJSON_GetObjectItem(root, "resume");
+            cJSON *queue = cJSON_GetObjectItem(root, "queue");
             
-            if (cJSON_IsString(name)) {
+            if (cJSON_IsTrue(resume) || cJSON_IsString(name)) {
                 float vol = 1.0f;
                 if (cJSON_IsNumber(volume)) {
                     vol = (float)volume->valuedouble;
                 }
                 
-                err = audio_file_manager_play(name->valuestring, vol, -1);
+                if (cJSON_IsTrue(resume)) {
+                    // Where the last track was stopped, kept across reboots
+                    err = audio_file_manager_resume(vol, -1);
+                } else {
+                    uint32_t start_ms = 0;
+                    if (cJSON_IsNumber(position) && position->valuedouble > 0) {
+                        start_ms = (uint32_t)position->valuedouble;
+                    }
+                    err = audio_file_manager_play_at(name->valuestring, vol, -1, start_ms);
+                }
+                // Tracks to follow it, gapless or crossfaded (a sleep program)
+                cJSON *next = NULL;
+                if (err == ESP_OK && cJSON_IsArray(queue)) {
+                    cJSON_ArrayForEach(next, queue) {
+                        if (cJSON_IsString(next) && audio_file_manager_enqueue(next->valuestring, -1) != ESP_OK) {
+                            ESP_LOGW(TAG, "Not queued: %s", next->valuestring);
+                        }
+                    }
+                }
                 cJSON_AddBoolToObject(json, "success", err == ESP_OK);
                 if (err != ESP_OK) {
                     cJSON_AddStringToObject(json, "error", esp_err_to_name(err));
@@ -875,6 +1122,7 @@ static esp_err_t api_audio_upload_handler(httpd_req_t *req) {
     size_t received = 0;
     bool in_file_data = false;
     size_t file_bytes_written = 0;
+    bool writing = false;  // Announced to the SD cache
     char *buf = NULL;  // Initialize to NULL - will be allocated below
     
     // Get Content-Type header to extract boundary
@@ -997,6 +1245,10 @@ static esp_err_t api_audio_upload_handler(httpd_req_t *req) {
                         }
                         ESP_LOGI(TAG, "Uploading file: %s", filepath);
                         
+                        // Playback reads further ahead while the upload shares the card
+                        sd_cache_write_begin(filepath);
+                        writing = true;
+                        
                         // Open file for writing
                         fp = fopen(filepath, "wb");
                         if (!fp) {
@@ -1066,6 +1318,10 @@ static esp_err_t api_audio_upload_handler(httpd_req_t *req) {
         fclose(fp);
         fp = NULL;
     }
+    if (writing) {
+        sd_cache_write_end(filepath);
+        writing = false;
+    }
     
     if (filename && file_bytes_written > 0) {
         cJSON_AddBoolToObject(json, "success", true);
@@ -1074,8 +1330,8 @@ static esp_err_t api_audio_upload_handler(httpd_req_t *req) {
         cJSON_AddStringToObject(json, "path", filepath);
         ESP_LOGI(TAG, "✅ File uploaded successfully: %s (%zu bytes) to %s", filename, file_bytes_written, filepath);
         
-        // Reload audio file list to include new file
-        audio_file_manager_init();
+        // Add it to the library catalog; nothing else is rescanned
+        audio_file_manager_add_file(filepath);
     } else {
         cJSON_AddBoolToObject(json, "success", false);
         if (!filename) {
@@ -1089,6 +1345,7 @@ static esp_err_t api_audio_upload_handler(httpd_req_t *req) {
     
 cleanup:
     if (fp) fclose(fp);
+    if (writing) sd_cache_write_end(filepath);
     if (boundary) free(boundary);
     if (filename) free(filename);
     if (buf) free(buf);  // buf is initialized to NULL, then malloc'd or stays NULL
@@ -0,0 +1,226 @@
+/**
+ * @file base64_bench.c
+ * @brief Throughput of fast_base64 kernels versus mbedtls_base64 on audio-sized payloads
+ *
+ * Verifies every kernel byte-for-byte (against mbedtls when linked, otherwise
+ * against the scalar kernel) before timing it, then reports MB/s for encode
+ * (STT upload: raw bytes in), decode (TTS audioContent: base64 characters in)
+ * and the streaming decoder fed in TCP-segment-sized pieces as gemini_api does.
+ *
+ * Usage: base64_bench [--size BYTES] [--ms MIN_MS_PER_CASE]
+ */
+
+#include "fast_base64.h"
+#include "streaming_base64.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_MBEDTLS
+// Declared here so the benchmark only needs the library, not its headers
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+int mbedtls_base64_decode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen);
+#endif
+
+#define STREAM_CHUNK 1460  // One TCP segment per ON_DATA event
+
+typedef enum {
+    OP_ENCODE = 0,
+    OP_DECODE,
+    OP_STREAM,
+    OP_COUNT,
+} op_t;
+
+static uint8_t *s_raw;
+static char *s_b64;
+static uint8_t *s_out;
+static size_t s_size;
+static size_t s_b64_len;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int run_fast(op_t op)
+{
+    size_t n = 0;
+    switch (op) {
+        case OP_ENCODE:
+            fast_base64_encode((char *)s_out, s_raw, s_size);
+            return 0;
+        case OP_DECODE:
+            return fast_base64_decode(s_out, s_size, &n, s_b64, s_b64_len) != ESP_OK;
+        case OP_STREAM: {
+            streaming_base64_decoder_t dec;
+            streaming_base64_decoder_init(&dec);
+            size_t written = 0;
+            for (size_t pos = 0; pos < s_b64_len; pos += STREAM_CHUNK) {
+                size_t chunk = s_b64_len - pos < STREAM_CHUNK ? s_b64_len - pos : STREAM_CHUNK;
+                n = s_size - written;
+                if (streaming_base64_decode(&dec, (const uint8_t *)s_b64 + pos, chunk, s_out + written, &n) != ESP_OK) {
+                    return 1;
+                }
+                written += n;
+            }
+            n = s_size - written;
+            return streaming_base64_decode_finish(&dec, s_out + written, &n) != ESP_OK;
+        }
+        default:
+            return 1;
+    }
+}
+
+#ifdef HAVE_MBEDTLS
+static int run_mbedtls(op_t op)
+{
+    size_t n = 0;
+    if (op == OP_ENCODE) {
+        return mbedtls_base64_encode(s_out, fast_base64_encoded_len(s_size) + 1, &n, s_raw, s_size) != 0;
+    }
+    return mbedtls_base64_decode(s_out, s_size, &n, (const unsigned char *)s_b64, s_b64_len) != 0;
+}
+#endif
+
+// Returns MB/s of the op's input side, or a negative value on error
+static double measure(int (*fn)(op_t), op_t op, int min_ms)
+{
+    size_t bytes = op == OP_ENCODE ? s_size : s_b64_len;
+    if (fn(op) != 0) {
+        return -1;
+    }
+    int iters = 0;
+    double start = now_s();
+    double elapsed;
+    do {
+        if (fn(op) != 0) {
+            return -1;
+        }
+        iters++;
+        elapsed = now_s() - start;
+    } while (elapsed * 1000 < min_ms);
+    return (double)bytes * iters / elapsed / 1e6;
+}
+
+// Encode must match the reference exactly and decode must round-trip, using the selected kernel
+static bool verify_len(fast_base64_kernel_t kernel, size_t len, char *enc, char *ref, uint8_t *dec)
+{
+    size_t ref_len;
+#ifdef HAVE_MBEDTLS
+    mbedtls_base64_encode((unsigned char *)ref, fast_base64_encoded_len(s_size) + 1, &ref_len, s_raw, len);
+#else
+    fast_base64_select_kernel(FAST_BASE64_KERNEL_SCALAR);
+    ref_len = fast_base64_encode(ref, s_raw, len);
+    fast_base64_select_kernel(kernel);
+#endif
+    size_t n = fast_base64_encode(enc, s_raw, len);
+    size_t out_len = 0;
+    return n == ref_len && memcmp(enc, ref, n) == 0 &&
+           fast_base64_decode(dec, len, &out_len, enc, n) == ESP_OK &&
+           out_len == len && memcmp(dec, s_raw, len) == 0;
+}
+
+// Every length up to 1 KB (all tail and kernel-boundary cases), then the full payload
+static int verify_kernel(fast_base64_kernel_t kernel)
+{
+    char *enc = malloc(fast_base64_encoded_len(s_size) + 1);
+    char *ref = malloc(fast_base64_encoded_len(s_size) + 1);
+    uint8_t *dec = malloc(s_size + 3);
+    int failures = 0;
+
+    size_t small = s_size < 1024 ? s_size : 1024;
+    for (size_t len = 0; len <= s_size; len = (len < small) ? len + 1 : (len < s_size ? s_size : s_size + 1)) {
+        if (!verify_len(kernel, len, enc, ref, dec) && failures++ < 5) {
+            fprintf(stderr, "  %s: mismatch at length %zu\n", fast_base64_kernel_name(kernel), len);
+        }
+    }
+    free(enc);
+    free(ref);
+    free(dec);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    s_size = 512 * 1024;  // ~8 s of 24 kHz 16-bit TTS audio
+    int min_ms = 300;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            s_size = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--size BYTES] [--ms MIN_MS_PER_CASE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    s_raw = malloc(s_size);
+    s_b64 = malloc(fast_base64_encoded_len(s_size) + 1);
+    s_out = malloc(fast_base64_encoded_len(s_size) + 1);
+    if (!s_raw || !s_b64 || !s_out) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < s_size; i++) {
+        s_raw[i] = (uint8_t)rand();
+    }
+    s_b64_len = fast_base64_encode(s_b64, s_raw, s_size);
+
+    printf("Payload: %zu bytes / %zu base64 characters, stream chunks of %d\n\n", s_size, s_b64_len, STREAM_CHUNK);
+    printf("%-10s %12s %12s %12s %10s\n", "codec", "encode MB/s", "decode MB/s", "stream MB/s", "verify");
+
+#ifdef HAVE_MBEDTLS
+    double baseline[OP_COUNT] = { 0 };
+    printf("%-10s", "mbedtls");
+    for (int op = OP_ENCODE; op <= OP_DECODE; op++) {
+        baseline[op] = measure(run_mbedtls, op, min_ms);
+        printf(" %12.1f", baseline[op]);
+    }
+    printf(" %12s %10s\n", "-", "-");
+#endif
+
+    int failures = 0;
+    double best[OP_COUNT] = { 0 };
+    fast_base64_kernel_t last = FAST_BASE64_KERNEL_AUTO;
+    for (int k = FAST_BASE64_KERNEL_SCALAR; k <= FAST_BASE64_KERNEL_AVX2; k++) {
+        fast_base64_kernel_t active = fast_base64_select_kernel(k);
+        if (active == last) {
+            continue;  // Not supported by this CPU
+        }
+        last = active;
+        int bad = verify_kernel(active);
+        failures += bad;
+        printf("%-10s", fast_base64_kernel_name(active));
+        for (int op = 0; op < OP_COUNT; op++) {
+            double mbps = measure(run_fast, op, min_ms);
+            if (mbps < 0) {
+                failures++;
+            }
+            if (mbps > best[op]) {
+                best[op] = mbps;
+            }
+            printf(" %12.1f", mbps);
+        }
+        printf(" %10s\n", bad ? "FAIL" : "ok");
+    }
+
+#ifdef HAVE_MBEDTLS
+    printf("\nSpeed-up over mbedtls (best kernel): encode %.1fx, decode %.1fx, stream %.1fx\n",
+           best[OP_ENCODE] / baseline[OP_ENCODE], best[OP_DECODE] / baseline[OP_DECODE],
+           best[OP_STREAM] / baseline[OP_DECODE]);
+#endif
+
+    free(s_raw);
+    free(s_b64);
+    free(s_out);
+    if (failures) {
+        printf("\n%d verification failure(s)\n", failures);
+    }
+    return failures ? 1 : 0;
+}
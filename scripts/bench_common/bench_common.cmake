@@ -0,0 +1,25 @@
+# Project setup shared by the host benches under scripts/ (not part of the ESP-IDF project).
+#
+#   include(${CMAKE_CURRENT_SOURCE_DIR}/../bench_common/bench_common.cmake)
+#   add_host_bench(eq_bench ${REPO_ROOT}/main/audio_eq.c)
+#
+# Sets C11, a Release default and REPO_ROOT. add_host_bench() builds <name>.c plus the
+# given sources against the voice bench shims and bench_common.h, with -Wall and libm.
+
+set(CMAKE_C_STANDARD 11)
+set(CMAKE_C_STANDARD_REQUIRED ON)
+if(NOT CMAKE_BUILD_TYPE)
+    set(CMAKE_BUILD_TYPE Release)
+endif()
+
+get_filename_component(REPO_ROOT "${CMAKE_CURRENT_LIST_DIR}/../.." ABSOLUTE)
+set(BENCH_COMMON_DIR "${CMAKE_CURRENT_LIST_DIR}")
+
+function(add_host_bench name)
+    add_executable(${name} ${name}.c ${ARGN})
+    target_include_directories(${name} PRIVATE
+        ${BENCH_COMMON_DIR}
+        ${REPO_ROOT}/scripts/voice_bench/shims)
+    target_compile_options(${name} PRIVATE -Wall)
+    target_link_libraries(${name} PRIVATE m)
+endfunction()
@@ -0,0 +1,42 @@
+/**
+ * @file bench_common.h
+ * @brief Check and timing helpers shared by the host benches under scripts/
+ *
+ * Each bench is a single translation unit, so the failure count lives here as a
+ * file-local static: CHECK() reports and counts, bench_exit_code() prints the total.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+
+static int s_failures;
+
+#define CHECK(cond, ...)                      \
+    do {                                      \
+        if (!(cond)) {                        \
+            printf("  FAIL: " __VA_ARGS__);   \
+            printf("\n");                     \
+            s_failures++;                     \
+        }                                     \
+    } while (0)
+
+static inline double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Report the failed checks, if any
+ * @return Process exit code: 0 if every check passed, 1 otherwise
+ */
+static inline int bench_exit_code(void)
+{
+    if (s_failures) {
+        printf("\n%d check(s) failed\n", s_failures);
+    }
+    return s_failures ? 1 : 0;
+}
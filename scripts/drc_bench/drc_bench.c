@@ -0,0 +1,352 @@
+/**
+ * @file drc_bench.c
+ * @brief Ceiling, compression-curve and look-ahead checks plus ns/frame timing of the playback DRC
+ * (main/audio_drc.c)
+ *
+ * Checks: sample and true peak (8x oversampled offline) stay under the limiter ceiling
+ * for hot noise, sines and a burst after silence; the compressor's static curve matches
+ * the soft-knee design; a unity setting is transparent apart from its latency; the
+ * limiter gain moves by at most 1/lookahead of its swing per frame; and a disabled
+ * stage only rounds and saturates. Test noise stops at 20 kHz, the top of a resampled
+ * 44.1 kHz source; the stage's short interpolator does not track the last few kHz. Then times the stage on stereo program material.
+ *
+ * Usage: drc_bench [--ms MIN_MS_PER_CASE]
+ */
+
+#include "audio_drc.h"
+#include "bench_common.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RATE        48000
+#define OS_FACTOR   8         // Offline true-peak oversampling
+#define OS_HALF     32        // Offline interpolator half length, input samples
+
+static double frand(void)
+{
+    return rand() / (double)RAND_MAX * 2.0 - 1.0;
+}
+
+static double db(double lin)
+{
+    return 20.0 * log10(lin);
+}
+
+// Largest |x| of one channel, sampled and 8x oversampled with a long Hann-windowed sinc
+static double true_peak(const int16_t *x, size_t frames, int ch)
+{
+    double peak = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+        for (int p = 0; p < OS_FACTOR; p++) {
+            double frac = p / (double)OS_FACTOR, v = 0.0;
+            if (p == 0) {
+                v = x[2 * i + ch];
+            } else {
+                for (int t = -OS_HALF + 1; t <= OS_HALF; t++) {
+                    long k = (long)i + t;
+                    if (k < 0 || k >= (long)frames) {
+                        continue;
+                    }
+                    double d = t - frac;
+                    double w = 0.5 + 0.5 * cos(M_PI * d / OS_HALF);
+                    v += x[2 * k + ch] * w * sin(M_PI * d) / (M_PI * d);
+                }
+            }
+            peak = fabs(v) > peak ? fabs(v) : peak;
+        }
+    }
+    return peak;
+}
+
+// In-place linear-phase low-pass (windowed sinc), the band a resampled 44.1 kHz source fills
+static void lowpass(float *x, size_t frames, double cutoff)
+{
+    const int half = 32;
+    double h[2 * 32 + 1], fc = cutoff / RATE;
+    for (int t = -half; t <= half; t++) {
+        double w = 0.5 + 0.5 * cos(M_PI * t / (half + 1));
+        h[t + half] = t == 0 ? 2.0 * fc : w * sin(2.0 * M_PI * fc * t) / (M_PI * t);
+    }
+    float *src = malloc(frames * 2 * sizeof(float));
+    memcpy(src, x, frames * 2 * sizeof(float));
+    for (size_t i = 0; i < frames; i++) {
+        for (int ch = 0; ch < 2; ch++) {
+            double v = 0.0;
+            for (int t = -half; t <= half; t++) {
+                long k = (long)i + t;
+                if (k >= 0 && k < (long)frames) {
+                    v += h[t + half] * src[2 * k + ch];
+                }
+            }
+            x[2 * i + ch] = (float)v;
+        }
+    }
+    free(src);
+}
+
+static void run(audio_drc_t *drc, const float *in, int16_t *out, size_t frames)
+{
+    for (size_t pos = 0; pos < frames; pos += AUDIO_DRC_BLOCK_FRAMES) {
+        size_t n = frames - pos < AUDIO_DRC_BLOCK_FRAMES ? frames - pos : AUDIO_DRC_BLOCK_FRAMES;
+        audio_drc_process(drc, in + pos * 2, out + pos * 2, n);
+    }
+}
+
+// Peak of the output against the ceiling; signals are up to 12 dB over full scale
+static void check_ceiling(const char *name, const float *in, size_t frames)
+{
+    audio_drc_t drc;
+    audio_drc_init(&drc, RATE, NULL);
+    int16_t *out = malloc(frames * 2 * sizeof(int16_t));
+    run(&drc, in, out, frames);
+
+    double ceiling = 32768.0 * pow(10.0, drc.cfg.limit_db / 20.0);
+    double sample_peak = 0.0;
+    for (size_t i = 0; i < frames * 2; i++) {
+        sample_peak = abs(out[i]) > sample_peak ? abs(out[i]) : sample_peak;
+    }
+    double tp = fmax(true_peak(out, frames, 0), true_peak(out, frames, 1));
+    printf("  %-24s sample peak %6.2f dBFS, true peak %6.2f dBFS (ceiling %.1f)\n", name, db(sample_peak / 32768.0),
+           db(tp / 32768.0), drc.cfg.limit_db);
+    CHECK(sample_peak <= ceiling + 1.0, "%s: sample peak %.0f over ceiling %.0f", name, sample_peak, ceiling);
+    CHECK(db(tp / ceiling) < 0.5, "%s: true peak %.2f dB over the ceiling", name, db(tp / ceiling));
+    free(out);
+}
+
+static void check_ceilings(void)
+{
+    const size_t frames = RATE;
+    float *in = malloc(frames * 2 * sizeof(float));
+
+    for (size_t i = 0; i < frames * 2; i++) {
+        in[i] = (float)(frand() * 4.0 * 32768.0);
+    }
+    lowpass(in, frames, 20000.0);
+    check_ceiling("noise to 20 kHz +12 dB", in, frames);
+
+    static const double freqs[] = { 100.0, 997.0, 11025.0, 15999.0 };
+    for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+        for (size_t i = 0; i < frames; i++) {
+            double ph = 2.0 * M_PI * freqs[f] * i / RATE + 0.3;
+            in[2 * i] = (float)(2.0 * 32768.0 * sin(ph));
+            in[2 * i + 1] = (float)(2.0 * 32768.0 * sin(ph + 1.0));
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%.0f Hz sine +6 dB", freqs[f]);
+        check_ceiling(name, in, frames);
+    }
+
+    // Silence, then a hot burst: the look-ahead must have the gain down before it arrives
+    for (size_t i = 0; i < frames; i++) {
+        double v = i < frames / 2 ? 0.0 : 3.0 * 32768.0 * sin(2.0 * M_PI * 3000.0 * i / RATE);
+        in[2 * i] = in[2 * i + 1] = (float)v;
+    }
+    check_ceiling("burst after silence", in, frames);
+    free(in);
+}
+
+// Expected static gain in dB for a steady level, same soft-knee law as the stage
+static double design_gain_db(const audio_drc_config_t *cfg, double level_db)
+{
+    double over = level_db - cfg->threshold_db, slope = 1.0 - 1.0 / cfg->ratio, reduce = 0.0;
+    if (2.0 * over >= 6.0) {
+        reduce = slope * over;
+    } else if (2.0 * over > -6.0) {
+        reduce = slope * (over + 3.0) * (over + 3.0) / 12.0;
+    }
+    return cfg->makeup_db - reduce;
+}
+
+// Quadrature sines keep the stereo power constant, so the detector settles exactly
+static void check_curve(void)
+{
+    audio_drc_config_t cfg = AUDIO_DRC_DEFAULT_CONFIG();
+    cfg.limit_db = 0.0f;
+    const size_t frames = RATE;
+    float *in = malloc(frames * 2 * sizeof(float));
+    int16_t *out = malloc(frames * 2 * sizeof(int16_t));
+    double worst = 0.0;
+
+    for (int level = -42; level <= -6; level += 3) {
+        double amp = 32768.0 * pow(10.0, level / 20.0) * sqrt(2.0);  // RMS = level
+        for (size_t i = 0; i < frames; i++) {
+            double ph = 2.0 * M_PI * 441.0 * i / RATE;
+            in[2 * i] = (float)(amp * sin(ph));
+            in[2 * i + 1] = (float)(amp * cos(ph));
+        }
+        audio_drc_t drc;
+        audio_drc_init(&drc, RATE, &cfg);
+        run(&drc, in, out, frames);
+
+        double in_power = 0.0, out_power = 0.0;
+        for (size_t i = frames; i < frames * 2; i++) {
+            in_power += (double)in[i] * in[i];
+            out_power += (double)out[i] * out[i];
+        }
+        double got = 10.0 * log10(out_power / in_power);
+        double expect = design_gain_db(&cfg, level);
+        double peak_db = level + 3.01 + expect;
+        if (peak_db > -0.5) {
+            continue;  // The limiter owns this level
+        }
+        worst = fabs(got - expect) > worst ? fabs(got - expect) : worst;
+        CHECK(fabs(got - expect) < 0.5, "%d dBFS RMS: gain %.2f dB, expected %.2f dB", level, got, expect);
+    }
+    printf("  static curve within %.3f dB of design (-42 .. -6 dBFS RMS, %.0f:1 above %.0f dB)\n", worst, cfg.ratio,
+           cfg.threshold_db);
+    free(in);
+    free(out);
+}
+
+// Unity settings: the output is the input, delayed by the reported latency
+static void check_transparent(void)
+{
+    audio_drc_config_t cfg = AUDIO_DRC_DEFAULT_CONFIG();
+    cfg.ratio = 1.0f;
+    cfg.makeup_db = 0.0f;
+    audio_drc_t drc;
+    audio_drc_init(&drc, RATE, &cfg);
+    size_t latency = audio_drc_latency_frames(&drc);
+
+    const size_t frames = 4096;
+    float in[4096 * 2];
+    int16_t out[4096 * 2];
+    for (size_t i = 0; i < frames * 2; i++) {
+        in[i] = (float)lrint(frand() * 16000.0);
+    }
+    run(&drc, in, out, frames);
+    int worst = 0;
+    for (size_t i = latency * 2; i < frames * 2; i++) {
+        int err = abs(out[i] - (int)in[i - latency * 2]);
+        worst = err > worst ? err : worst;
+    }
+    printf("  unity settings: latency %zu frames (%.2f ms), worst error %d LSB\n", latency, latency * 1000.0 / RATE,
+           worst);
+    CHECK(worst <= 1, "unity settings changed the signal by %d LSB", worst);
+}
+
+// A DC step far over the ceiling: the limiter gain ramps across the look-ahead, never steps
+static void check_gain_slew(void)
+{
+    audio_drc_config_t cfg = AUDIO_DRC_DEFAULT_CONFIG();
+    cfg.ratio = 1.0f;
+    cfg.makeup_db = 0.0f;
+    audio_drc_t drc;
+    audio_drc_init(&drc, RATE, &cfg);
+    size_t latency = audio_drc_latency_frames(&drc);
+
+    const size_t frames = 2048;
+    float in[2048 * 2];
+    int16_t out[2048 * 2];
+    for (size_t i = 0; i < frames * 2; i++) {
+        in[i] = i < frames ? 8000.0f : 80000.0f;
+    }
+    run(&drc, in, out, frames);
+    double worst = 0.0, last = 1.0;
+    for (size_t i = latency; i < frames; i++) {
+        double g = out[2 * i] / in[2 * (i - latency)];
+        worst = fabs(g - last) > worst ? fabs(g - last) : worst;
+        last = g;
+    }
+    double swing = 1.0 - drc.ceiling / 80000.0;
+    printf("  DC step +7.8 dBFS: largest gain change %.4f per frame (swing %.3f over %u frames)\n", worst, swing,
+           (unsigned)drc.lookahead);
+    CHECK(worst <= swing / drc.lookahead + 1e-3, "gain stepped by %.4f in one frame", worst);
+}
+
+static void check_disabled(void)
+{
+    audio_drc_t drc;
+    audio_drc_init(&drc, RATE, NULL);
+    drc.enabled = false;
+    float in[512];
+    int16_t out[512], s16[512], ref[512];
+    for (int i = 0; i < 512; i++) {
+        in[i] = (float)(frand() * 40000.0);
+        double r = in[i] < 0 ? ceil(in[i] - 0.5) : floor(in[i] + 0.5);
+        ref[i] = (int16_t)(r > 32767 ? 32767 : r < -32768 ? -32768 : r);
+        s16[i] = (int16_t)(rand() - RAND_MAX / 2);
+    }
+    audio_drc_process(&drc, in, out, 256);
+    CHECK(memcmp(out, ref, sizeof(out)) == 0, "disabled DRC did more than round and saturate");
+    memcpy(ref, s16, sizeof(ref));
+    audio_drc_process_s16(&drc, s16, 256);
+    CHECK(memcmp(s16, ref, sizeof(ref)) == 0, "disabled DRC changed int16 samples");
+    CHECK(audio_drc_latency_frames(&drc) == 0, "disabled DRC reports latency");
+}
+
+static double time_ns_per_frame(audio_drc_t *drc, const float *in, int16_t *out, size_t frames, int min_ms)
+{
+    long long done = 0;
+    double start = now_s(), elapsed;
+    do {
+        run(drc, in, out, frames);
+        done += (long long)frames;
+        elapsed = now_s() - start;
+    } while (elapsed * 1000 < min_ms);
+    return elapsed * 1e9 / done;
+}
+
+static void bench(int min_ms)
+{
+    const size_t frames = RATE;
+    float *in = malloc(frames * 2 * sizeof(float));
+    int16_t *out = malloc(frames * 2 * sizeof(int16_t));
+    // Program-like: a few partials at -12 dBFS with noise, peaks now and then over full scale
+    for (size_t i = 0; i < frames; i++) {
+        double t = (double)i / RATE;
+        double v = 0.25 * sin(2 * M_PI * 110 * t) + 0.15 * sin(2 * M_PI * 660 * t) + 0.1 * frand();
+        v *= 1.0 + 3.0 * ((i / 4800) % 5 == 0);
+        in[2 * i] = (float)(v * 32768.0);
+        in[2 * i + 1] = (float)(v * 0.9 * 32768.0);
+    }
+
+    audio_drc_t drc;
+    audio_drc_init(&drc, RATE, NULL);
+    double ns = time_ns_per_frame(&drc, in, out, frames, min_ms);
+    audio_drc_config_t cfg = AUDIO_DRC_DEFAULT_CONFIG();
+    cfg.lookahead_ms = 4.0f;
+    audio_drc_set_config(&drc, &cfg);
+    double ns4 = time_ns_per_frame(&drc, in, out, frames, min_ms);
+    drc.enabled = false;
+    double off = time_ns_per_frame(&drc, in, out, frames, min_ms);
+
+    printf("\n%-26s %12s %14s\n", "stage (stereo float)", "ns/frame", "x realtime@48k");
+    printf("%-26s %12.2f %14.0f\n", "default (2 ms look-ahead)", ns, 1e9 / (ns * RATE));
+    printf("%-26s %12.2f %14.0f\n", "4 ms look-ahead", ns4, 1e9 / (ns4 * RATE));
+    printf("%-26s %12.2f %14.0f\n", "disabled (pack only)", off, 1e9 / (off * RATE));
+    free(in);
+    free(out);
+}
+
+int main(int argc, char **argv)
+{
+    int min_ms = 300;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--ms MIN_MS_PER_CASE]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(1);
+
+    printf("Ceiling\n");
+    check_ceilings();
+    printf("Compressor and limiter\n");
+    check_curve();
+    check_transparent();
+    check_gain_slew();
+    check_disabled();
+
+    bench(min_ms);
+
+    return bench_exit_code();
+}
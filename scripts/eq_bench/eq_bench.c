@@ -0,0 +1,219 @@
+/**
+ * @file eq_bench.c
+ * @brief Frequency-response checks and ns/sample timing of the playback EQ (main/audio_eq.c)
+ *
+ * Checks, at every playback rate: the analytic response at the design points, the
+ * response measured by running sines through audio_eq_process_s16() against
+ * audio_eq_response_db(), bit-exact bypass when disabled, and saturation. Then
+ * times the cascade on stereo noise, next to a frame-major reference loop.
+ *
+ * Usage: eq_bench [--ms MIN_MS_PER_CASE]
+ */
+
+#include "audio_eq.h"
+#include "bench_common.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const uint32_t RATES[] = { 16000, 24000, 44100, 48000 };
+
+// Gain in dB of a sine through the EQ, measured after the filters have settled
+static double measure_sine_db(audio_eq_t *eq, double freq, double amplitude)
+{
+    uint32_t rate = eq->sample_rate;
+    size_t settle = rate / 2;
+    size_t frames = settle + rate / 2;
+    int16_t *buf = malloc(frames * 2 * sizeof(int16_t));
+    double in_power = 0, out_power = 0;
+
+    audio_eq_reset(eq);
+    for (size_t i = 0; i < frames; i++) {
+        double ph = 2.0 * M_PI * freq * i / rate;
+        buf[2 * i] = (int16_t)lrint(amplitude * sin(ph));
+        buf[2 * i + 1] = (int16_t)lrint(amplitude * cos(ph));
+    }
+    for (size_t i = settle * 2; i < frames * 2; i++) {
+        in_power += (double)buf[i] * buf[i];
+    }
+    audio_eq_process_s16(eq, buf, frames);
+    for (size_t i = settle * 2; i < frames * 2; i++) {
+        out_power += (double)buf[i] * buf[i];
+    }
+    free(buf);
+    return 10.0 * log10(out_power / in_power);
+}
+
+static void check_design_points(uint32_t rate)
+{
+    audio_eq_t eq;
+    audio_eq_band_t hpf = { AUDIO_EQ_HIGHPASS, 90.0f, 0.70710678f, 0.0f };
+    audio_eq_init(&eq, rate, &hpf, 1, 0.0f);
+    CHECK(fabsf(audio_eq_response_db(&eq, 90.0f) + 3.01f) < 0.05f, "%u Hz: HPF at fc %.2f dB", rate,
+          audio_eq_response_db(&eq, 90.0f));
+    CHECK(fabsf(audio_eq_response_db(&eq, 45.0f) + 12.3f) < 0.3f, "%u Hz: HPF one octave down %.2f dB", rate,
+          audio_eq_response_db(&eq, 45.0f));
+
+    audio_eq_band_t peak = { AUDIO_EQ_PEAKING, 320.0f, 1.0f, -4.0f };
+    audio_eq_init(&eq, rate, &peak, 1, 0.0f);
+    CHECK(fabsf(audio_eq_response_db(&eq, 320.0f) + 4.0f) < 0.01f, "%u Hz: peak at fc %.3f dB", rate,
+          audio_eq_response_db(&eq, 320.0f));
+
+    audio_eq_band_t shelves[] = {
+        { AUDIO_EQ_LOWSHELF, 200.0f, 0.707f, 6.0f },
+        { AUDIO_EQ_HIGHSHELF, 4000.0f, 0.707f, -6.0f },
+    };
+    audio_eq_init(&eq, rate, shelves, 2, 0.0f);
+    CHECK(fabsf(audio_eq_response_db(&eq, 20.0f) - 6.0f) < 0.2f, "%u Hz: low shelf plateau %.2f dB", rate,
+          audio_eq_response_db(&eq, 20.0f));
+    CHECK(fabsf(audio_eq_response_db(&eq, rate * 0.45f) + 6.0f) < 0.5f, "%u Hz: high shelf plateau %.2f dB", rate,
+          audio_eq_response_db(&eq, rate * 0.45f));
+
+    audio_eq_init_default(&eq, rate);
+    CHECK(fabsf(audio_eq_response_db(&eq, 5000.0f)) < 0.1f, "%u Hz: default EQ passband %.2f dB", rate,
+          audio_eq_response_db(&eq, 5000.0f));
+}
+
+// The filter as run must match the analytic response of its coefficients
+static void check_measured_response(uint32_t rate)
+{
+    audio_eq_t eq;
+    audio_eq_init_default(&eq, rate);
+    double worst = 0;
+    for (int k = 0; k < 24; k++) {
+        double freq = 30.0 * pow(rate * 0.45 / 30.0, k / 23.0);
+        double expect = audio_eq_response_db(&eq, (float)freq);
+        double got = measure_sine_db(&eq, freq, 16000.0);
+        double err = fabs(got - expect);
+        if (err > worst) {
+            worst = err;
+        }
+        CHECK(err < (expect < -30 ? 0.5 : 0.1), "%u Hz: %.0f Hz measured %.2f dB, expected %.2f dB", rate, freq,
+              got, expect);
+    }
+    printf("  %5u Hz: default EQ measured within %.3f dB of design (24 points, 30 Hz - %.0f Hz)\n", rate, worst,
+           rate * 0.45);
+}
+
+static void check_bypass_and_clip(void)
+{
+    audio_eq_t eq;
+    int16_t buf[512], ref[512];
+    for (int i = 0; i < 512; i++) {
+        ref[i] = buf[i] = (int16_t)(rand() - RAND_MAX / 2);
+    }
+    audio_eq_init_default(&eq, 48000);
+    eq.enabled = false;
+    audio_eq_process_s16(&eq, buf, 256);
+    CHECK(memcmp(buf, ref, sizeof(buf)) == 0, "disabled EQ changed the samples");
+
+    audio_eq_init(&eq, 48000, NULL, 0, 12.0f);
+    for (int i = 0; i < 512; i++) {
+        buf[i] = (i & 2) ? 30000 : -30000;
+    }
+    audio_eq_process_s16(&eq, buf, 256);
+    for (int i = 0; i < 512; i++) {
+        CHECK(buf[i] == ((i & 2) ? 32767 : -32768), "sample %d not saturated: %d", i, buf[i]);
+        if (s_failures) {
+            break;
+        }
+    }
+}
+
+// Frame-major reference: every sample walks the whole cascade before the next one starts
+static void reference_process(audio_eq_t *eq, int16_t *samples, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++) {
+        for (int ch = 0; ch < 2; ch++) {
+            float x = samples[2 * i + ch];
+            for (size_t s = 0; s < eq->num_sections; s++) {
+                const audio_eq_coeffs_t *c = &eq->coeffs[s];
+                float *z = &eq->state[s][ch * 2];
+                float y = c->b0 * x + z[0];
+                z[0] = c->b1 * x - c->a1 * y + z[1];
+                z[1] = c->b2 * x - c->a2 * y;
+                x = y;
+            }
+            x *= eq->gain;
+            samples[2 * i + ch] = (int16_t)(x > 32767.0f ? 32767 : x < -32768.0f ? -32768 : lrintf(x));
+        }
+    }
+}
+
+static double time_ns_per_sample(void (*fn)(audio_eq_t *, int16_t *, size_t), audio_eq_t *eq, int16_t *src,
+                                 int16_t *work, size_t frames, int min_ms)
+{
+    size_t block = 256;
+    long long samples = 0;
+    double start = now_s(), elapsed;
+    do {
+        memcpy(work, src, frames * 2 * sizeof(int16_t));
+        for (size_t pos = 0; pos < frames; pos += block) {
+            fn(eq, work + pos * 2, frames - pos < block ? frames - pos : block);
+        }
+        samples += (long long)frames * 2;
+        elapsed = now_s() - start;
+    } while (elapsed * 1000 < min_ms);
+    return elapsed * 1e9 / samples;
+}
+
+static void bench(int min_ms)
+{
+    const size_t frames = 48000;
+    int16_t *src = malloc(frames * 2 * sizeof(int16_t));
+    int16_t *work = malloc(frames * 2 * sizeof(int16_t));
+    for (size_t i = 0; i < frames * 2; i++) {
+        src[i] = (int16_t)((rand() % 20000) - 10000);
+    }
+
+    audio_eq_t eq;
+    audio_eq_init_default(&eq, 48000);
+    double ns = time_ns_per_sample(audio_eq_process_s16, &eq, src, work, frames, min_ms);
+    double ref = time_ns_per_sample(reference_process, &eq, src, work, frames, min_ms);
+
+    // Cost per additional section
+    audio_eq_band_t eight[AUDIO_EQ_MAX_SECTIONS];
+    for (int i = 0; i < AUDIO_EQ_MAX_SECTIONS; i++) {
+        eight[i] = (audio_eq_band_t){ AUDIO_EQ_PEAKING, 100.0f * (i + 1), 1.0f, -1.0f };
+    }
+    audio_eq_init(&eq, 48000, eight, AUDIO_EQ_MAX_SECTIONS, 0.0f);
+    double ns8 = time_ns_per_sample(audio_eq_process_s16, &eq, src, work, frames, min_ms);
+
+    printf("\n%-26s %12s %14s\n", "cascade (stereo s16)", "ns/sample", "x realtime@48k");
+    printf("%-26s %12.2f %14.0f\n", "default, 3 sections", ns, 1e9 / (ns * 96000));
+    printf("%-26s %12.2f %14.0f\n", "frame-major reference", ref, 1e9 / (ref * 96000));
+    printf("%-26s %12.2f %14.0f\n", "8 sections", ns8, 1e9 / (ns8 * 96000));
+    printf("Per section: %.2f ns/sample\n", (ns8 - ns) / (AUDIO_EQ_MAX_SECTIONS - 3));
+    free(src);
+    free(work);
+}
+
+int main(int argc, char **argv)
+{
+    int min_ms = 300;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--ms MIN_MS_PER_CASE]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(1);
+
+    printf("Frequency response\n");
+    for (size_t r = 0; r < sizeof(RATES) / sizeof(RATES[0]); r++) {
+        check_design_points(RATES[r]);
+        check_measured_response(RATES[r]);
+    }
+    check_bypass_and_clip();
+
+    bench(min_ms);
+
+    return bench_exit_code();
+}
@@ -0,0 +1,348 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for the Google APIs used by the voice pipeline.
+
+Serves speech:recognize, models/*:generateContent, models/*:streamGenerateContent
+(SSE), cachedContents and text:synthesize over plain HTTP, with configurable
+latency, bandwidth and failure injection, so the STT -> LLM -> TTS path can be
+benchmarked without credentials (see scripts/voice_bench).
+
+Usage:
+    python3 scripts/mock_google_api.py --port 8765 --latency-ms 250 --bandwidth-kbps 2000
+    python3 scripts/mock_google_api.py --latency llm=600,tts=400 --fail-rate 0.1
+"""
+
+import argparse
+import base64
+import gzip
+import json
+import math
+import random
+import re
+import signal
+import struct
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+ENDPOINTS = ("stt", "llm", "llm_stream", "cache", "tts", "other")
+
+# Prompt keywords that make the mock LLM answer with a function call
+FUNCTION_CALLS = [
+    (re.compile(r"\b(red|blue|green|color|colour)\b", re.I),
+     {"name": "set_led_color", "args": {"red": 255, "green": 0, "blue": 0}}),
+    (re.compile(r"\blights? off\b|\bclear\b", re.I),
+     {"name": "set_led_pattern", "args": {"pattern": "clear"}}),
+    (re.compile(r"\bvolume\b", re.I),
+     {"name": "set_volume", "args": {"volume": 0.4}}),
+    (re.compile(r"\b(pause|stop)\b", re.I),
+     {"name": "pause_device", "args": {}}),
+]
+
+
+class MockStats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.requests = {e: 0 for e in ENDPOINTS}
+        self.failures = {e: 0 for e in ENDPOINTS}
+        self.bytes_in = {e: 0 for e in ENDPOINTS}
+        self.bytes_out = {e: 0 for e in ENDPOINTS}
+
+    def record(self, endpoint, bytes_in, bytes_out, failed):
+        with self.lock:
+            self.requests[endpoint] += 1
+            self.bytes_in[endpoint] += bytes_in
+            self.bytes_out[endpoint] += bytes_out
+            if failed:
+                self.failures[endpoint] += 1
+
+    def summary(self):
+        lines = [f"{'endpoint':<12}{'requests':>10}{'failed':>8}{'bytes in':>12}{'bytes out':>12}"]
+        for e in ENDPOINTS:
+            if self.requests[e]:
+                lines.append(f"{e:<12}{self.requests[e]:>10}{self.failures[e]:>8}"
+                             f"{self.bytes_in[e]:>12}{self.bytes_out[e]:>12}")
+        return "\n".join(lines)
+
+
+def _raise_interrupt(signum, frame):
+    raise KeyboardInterrupt
+
+
+def parse_per_endpoint(spec, default, cast=float):
+    """Parse 'llm=600,tts=400' or a bare number applied to every endpoint"""
+    values = {e: default for e in ENDPOINTS}
+    if spec is None:
+        return values
+    for item in spec.split(","):
+        item = item.strip()
+        if not item:
+            continue
+        if "=" in item:
+            key, val = item.split("=", 1)
+            if key not in ENDPOINTS:
+                raise argparse.ArgumentTypeError(f"unknown endpoint '{key}' (one of {', '.join(ENDPOINTS)})")
+            values[key] = cast(val)
+        else:
+            values = {e: cast(item) for e in ENDPOINTS}
+    return values
+
+
+def classify(path):
+    if ":recognize" in path:
+        return "stt"
+    if ":streamGenerateContent" in path:
+        return "llm_stream"
+    if ":generateContent" in path:
+        return "llm"
+    if "/cachedContents" in path:
+        return "cache"
+    if "text:synthesize" in path:
+        return "tts"
+    return "other"
+
+
+def synth_pcm(duration_ms, sample_rate=24000, freq=440.0):
+    """LINEAR16 mono sine with a RIFF header, like Cloud TTS returns"""
+    count = sample_rate * duration_ms // 1000
+    samples = b"".join(struct.pack("<h", int(8000 * math.sin(2 * math.pi * freq * i / sample_rate)))
+                       for i in range(count))
+    header = struct.pack("<4sI4s4sIHHIIHH4sI", b"RIFF", 36 + len(samples), b"WAVE", b"fmt ", 16, 1, 1,
+                         sample_rate, sample_rate * 2, 2, 16, b"data", len(samples))
+    return header + samples
+
+
+class MockHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "MockGoogleAPI/1.0"
+
+    def log_message(self, fmt, *args):
+        if self.server.opts.verbose:
+            sys.stderr.write("%s - %s\n" % (self.address_string(), fmt % args))
+
+    # --- transport helpers -------------------------------------------------
+
+    def _throttled_write(self, data, endpoint):
+        """Write at the configured bandwidth; optionally drop the connection midway"""
+        kbps = self.server.bandwidth[endpoint]
+        chunk = 1460
+        drop_at = None
+        if random.random() < self.server.drop_rate[endpoint]:
+            drop_at = len(data) // 2
+        sent = 0
+        while sent < len(data):
+            piece = data[sent:sent + chunk]
+            if drop_at is not None and sent + len(piece) > drop_at:
+                self.wfile.write(piece[:max(0, drop_at - sent)])
+                self.wfile.flush()
+                self.close_connection = True
+                return sent + max(0, drop_at - sent), True
+            self.wfile.write(piece)
+            sent += len(piece)
+            if kbps > 0:
+                time.sleep(len(piece) * 8 / (kbps * 1000))
+        self.wfile.flush()
+        return sent, False
+
+    def _wants_gzip(self):
+        # Google only compresses when the client also says "gzip" in its User-Agent
+        return ("gzip" in self.headers.get("Accept-Encoding", "")
+                and "gzip" in self.headers.get("User-Agent", ""))
+
+    def _first_byte_delay(self, endpoint):
+        opts = self.server.opts
+        delay = self.server.latency[endpoint] + random.uniform(-opts.jitter_ms, opts.jitter_ms)
+        if delay > 0:
+            time.sleep(delay / 1000.0)
+
+    def _send_json(self, endpoint, status, obj, bytes_in, escape=None):
+        body = json.dumps(obj)
+        if escape:
+            body = escape(body)
+        body = body.encode()
+        headers = [("Content-Type", "application/json; charset=UTF-8")]
+        if self._wants_gzip():
+            body = gzip.compress(body, 6)
+            headers.append(("Content-Encoding", "gzip"))
+        self._first_byte_delay(endpoint)
+        self.send_response(status)
+        for k, v in headers:
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        sent, dropped = self._throttled_write(body, endpoint)
+        self.server.stats.record(endpoint, bytes_in, sent, status >= 400 or dropped)
+
+    def _inject_failure(self, endpoint, bytes_in):
+        opts = self.server.opts
+        if random.random() < self.server.fail_rate[endpoint]:
+            status = opts.fail_status
+            self._send_json(endpoint, status, {"error": {"code": status, "message": "Injected failure",
+                                                         "status": "UNAVAILABLE"}}, bytes_in)
+            return True
+        return False
+
+    # --- endpoint handlers -------------------------------------------------
+
+    def _llm_reply(self, request):
+        contents = request.get("contents", [])
+        prompt = ""
+        if contents:
+            parts = contents[-1].get("parts", [])
+            prompt = " ".join(p.get("text", "") for p in parts)
+        if self.server.opts.function_calls and ("tools" in request or "cachedContent" in request):
+            for pattern, call in FUNCTION_CALLS:
+                if pattern.search(prompt):
+                    return {"functionCall": call}
+        text = self.server.opts.llm_text or f"You said: {prompt[:80]}. It is 21 degrees and quiet tonight."
+        return {"text": text}
+
+    def do_HEAD(self):
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def do_POST(self):
+        endpoint = classify(self.path)
+        length = int(self.headers.get("Content-Length", 0))
+        raw = self.rfile.read(length) if length else b""
+        bytes_in = len(raw) + sum(len(k) + len(v) + 4 for k, v in self.headers.items())
+        try:
+            request = json.loads(raw or b"{}")
+        except ValueError:
+            self._send_json(endpoint, 400, {"error": {"code": 400, "message": "Invalid JSON payload"}}, bytes_in)
+            return
+
+        if self._inject_failure(endpoint, bytes_in):
+            return
+
+        opts = self.server.opts
+        if endpoint == "stt":
+            self._send_json(endpoint, 200, {"results": [{"alternatives": [
+                {"transcript": opts.transcript, "confidence": 0.94}]}]}, bytes_in)
+        elif endpoint == "llm":
+            if "cachedContent" in request and request["cachedContent"] not in self.server.caches:
+                self._send_json(endpoint, 404, {"error": {"code": 404, "message": "CachedContent not found"}},
+                                bytes_in)
+                return
+            part = self._llm_reply(request)
+            self._send_json(endpoint, 200, {"candidates": [{"content": {"role": "model", "parts": [part]},
+                                                            "finishReason": "STOP"}]}, bytes_in)
+        elif endpoint == "llm_stream":
+            self._stream_llm(request, bytes_in)
+        elif endpoint == "cache":
+            approx_tokens = len(raw) // 4
+            if approx_tokens < opts.cache_min_tokens:
+                self._send_json(endpoint, 400, {"error": {"code": 400, "message":
+                                f"Cached content is too small. total_token_count={approx_tokens}, "
+                                f"min_total_token_count={opts.cache_min_tokens}"}}, bytes_in)
+                return
+            name = f"cachedContents/mock{len(self.server.caches) + 1}"
+            self.server.caches.add(name)
+            self._send_json(endpoint, 200, {"name": name, "model": request.get("model", ""),
+                                            "usageMetadata": {"totalTokenCount": approx_tokens}}, bytes_in)
+        elif endpoint == "tts":
+            text = request.get("input", {}).get("text", "")
+            duration = min(opts.tts_max_ms, max(300, len(text) * opts.tts_ms_per_char))
+            audio = base64.b64encode(synth_pcm(duration)).decode()
+            if opts.tts_escapes:
+                # Legal JSON some encoders produce: MIME line breaks, "\/" and "\u002B"
+                audio = "\n".join(audio[i:i + 76] for i in range(0, len(audio), 76))
+                self._send_json(endpoint, 200, {"audioContent": audio}, bytes_in,
+                                escape=lambda text: text.replace("/", "\\/").replace("+", "\\u002B"))
+            else:
+                self._send_json(endpoint, 200, {"audioContent": audio}, bytes_in)
+        else:
+            self._send_json(endpoint, 404, {"error": {"code": 404, "message": "Not found"}}, bytes_in)
+
+    def _stream_llm(self, request, bytes_in):
+        part = self._llm_reply(request)
+        events = []
+        if "text" in part:
+            words = part["text"].split(" ")
+            for i in range(0, len(words), 4):
+                chunk = " ".join(words[i:i + 4]) + (" " if i + 4 < len(words) else "")
+                events.append({"candidates": [{"content": {"role": "model", "parts": [{"text": chunk}]}}]})
+        else:
+            events.append({"candidates": [{"content": {"role": "model", "parts": [part]}}]})
+        events[-1]["candidates"][0]["finishReason"] = "STOP"
+
+        self._first_byte_delay("llm_stream")
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+        sent = 0
+        for event in events:
+            data = f"data: {json.dumps(event)}\r\n\r\n".encode()
+            frame = f"{len(data):x}\r\n".encode() + data + b"\r\n"
+            n, dropped = self._throttled_write(frame, "llm_stream")
+            sent += n
+            if dropped:
+                self.server.stats.record("llm_stream", bytes_in, sent, True)
+                return
+            time.sleep(self.server.opts.stream_interval_ms / 1000.0)
+        self.wfile.write(b"0\r\n\r\n")
+        self.wfile.flush()
+        self.server.stats.record("llm_stream", bytes_in, sent + 5, False)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Mock Google STT/Gemini/TTS server for local benchmarks")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--latency", default=None,
+                        help="Time to first byte in ms, global or per endpoint (e.g. 'stt=300,llm=600,tts=400')")
+    parser.add_argument("--latency-ms", type=float, default=150, help="Default time to first byte (ms)")
+    parser.add_argument("--jitter-ms", type=float, default=0, help="Uniform +/- jitter on the latency (ms)")
+    parser.add_argument("--bandwidth", default=None, help="Response bandwidth in kbit/s, global or per endpoint")
+    parser.add_argument("--bandwidth-kbps", type=float, default=0, help="Default bandwidth (0 = unlimited)")
+    parser.add_argument("--fail-rate", default="0", help="Probability of an error response, global or per endpoint")
+    parser.add_argument("--fail-status", type=int, default=503, help="HTTP status used for injected failures")
+    parser.add_argument("--drop-rate", default="0",
+                        help="Probability of closing the connection halfway through a response, global or per endpoint")
+    parser.add_argument("--transcript", default="what is the temperature in the bedroom")
+    parser.add_argument("--llm-text", default=None, help="Fixed LLM reply (default echoes the prompt)")
+    parser.add_argument("--no-function-calls", dest="function_calls", action="store_false",
+                        help="Never answer with a functionCall")
+    parser.add_argument("--cache-min-tokens", type=int, default=1024,
+                        help="Reject cachedContents smaller than this many (approximate) tokens")
+    parser.add_argument("--tts-ms-per-char", type=int, default=60)
+    parser.add_argument("--tts-max-ms", type=int, default=1800, help="Cap on synthesized audio length")
+    parser.add_argument("--tts-escapes", action="store_true",
+                        help="Escape '/' and '+' and break lines in the TTS base64 (JSON escapes)")
+    parser.add_argument("--stream-interval-ms", type=float, default=40, help="Gap between SSE events")
+    parser.add_argument("--seed", type=int, default=None)
+    parser.add_argument("-v", "--verbose", action="store_true")
+    opts = parser.parse_args()
+
+    if opts.seed is not None:
+        random.seed(opts.seed)
+
+    server = ThreadingHTTPServer((opts.host, opts.port), MockHandler)
+    server.daemon_threads = True
+    server.opts = opts
+    server.stats = MockStats()
+    server.caches = set()
+    server.latency = parse_per_endpoint(opts.latency, opts.latency_ms)
+    server.bandwidth = parse_per_endpoint(opts.bandwidth, opts.bandwidth_kbps)
+    server.fail_rate = parse_per_endpoint(opts.fail_rate, 0.0)
+    server.drop_rate = parse_per_endpoint(opts.drop_rate, 0.0)
+
+    print(f"Mock Google API listening on http://{opts.host}:{opts.port}")
+    print(f"  latency (ms): {server.latency}")
+    print(f"  bandwidth (kbit/s, 0=unlimited): {server.bandwidth}")
+    print(f"  fail rate: {server.fail_rate}, drop rate: {server.drop_rate}")
+    # Scripts usually stop the server with SIGTERM; print the summary then too
+    signal.signal(signal.SIGTERM, _raise_interrupt)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print("\n" + server.stats.summary())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,528 @@
+/**
+ * @file mp3_pipeline_bench.c
+ * @brief Underrun check of MP3 playback from a slow SD card (main/mp3_pipeline.c)
+ *
+ * Plays a synthetic 128 kbit/s, 44.1 kHz stereo MP3 through the pipeline and the real
+ * minimp3 decoder. The file's reads take as long as on a slow SD card and stall now and
+ * then, as they do while WiFi traffic holds off the reader. A feeder thread drains the
+ * player's PCM ring in real time and counts the times it runs dry. The single-task
+ * loop the pipeline replaced plays the same file under the same conditions for
+ * comparison.
+ *
+ * Usage: mp3_pipeline_bench [--seconds S] [--sd-kbps K] [--stall-ms MS] [--stall-every-ms MS]
+ */
+
+#include "mp3_pipeline.h"
+#include "audio_player.h"
+#include "audio_telemetry.h"
+#include "mp3_decoder.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_BYTES      417    // 128 kbit/s at 44.1 kHz, no padding
+#define FRAME_SAMPLES    1152
+#define JUNK_BYTES       3000   // Leading bytes with no sync, like an ID3 tag
+#define PCM_RING_KB      64     // CONFIG_AUDIO_PLAYBACK_RING_KB
+#define FEED_FRAMES      256    // Frames the I2S feeder takes per block
+#define SD_COMMAND_US    400    // Per-read overhead of the card and FATFS
+
+static int s_seconds = 8;
+static int s_sd_kbps = 1500;
+static int s_stall_ms = 600;
+static int s_stall_every_ms = 2000;
+
+// --- host shims -------------------------------------------------------------------
+
+void host_log(int level, const char *tag, const char *fmt, ...)
+{
+    if (level > 2) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "%s: ", tag);
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "error";
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(int64_t us)
+{
+    if (us > 0) {
+        usleep((useconds_t)us);
+    }
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+struct host_task {
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static void *task_trampoline(void *param)
+{
+    struct host_task task = *(struct host_task *)param;
+    free(param);
+    task.fn(task.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    (void)name;
+    (void)stack;
+    (void)prio;
+    (void)core;
+    struct host_task *task = malloc(sizeof(*task));
+    pthread_t thread;
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&thread, NULL, task_trampoline, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (out) {
+        *out = NULL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sleep_us((int64_t)ticks * 1000);
+}
+
+struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool given;
+};
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    struct host_sem *sem = calloc(1, sizeof(*sem));
+    if (sem) {
+        pthread_mutex_init(&sem->lock, NULL);
+        pthread_cond_init(&sem->cond, NULL);
+    }
+    return sem;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    sem->given = true;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+static void deadline_after(struct timespec *ts, int64_t us)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    struct timespec until;
+    deadline_after(&until, ticks == portMAX_DELAY ? 3600LL * 1000000 : (int64_t)ticks * 1000);
+    pthread_mutex_lock(&sem->lock);
+    while (!sem->given && pthread_cond_timedwait(&sem->cond, &sem->lock, &until) != ETIMEDOUT) {
+    }
+    BaseType_t got = sem->given ? pdTRUE : pdFALSE;
+    sem->given = false;
+    pthread_mutex_unlock(&sem->lock);
+    return got;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->cond);
+    free(sem);
+}
+
+void audio_telemetry_record(audio_telemetry_hist_id_t id, uint32_t us)
+{
+    (void)id;
+    (void)us;
+}
+
+// --- the player: a PCM ring drained in real time by a feeder thread ---------------
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t space;
+    size_t capacity;      // Frames
+    size_t used;
+    int rate;
+    bool started;
+    bool dry;
+    bool quit;
+    uint32_t underruns;   // Times the ring ran dry while the producer was still going
+    int64_t dry_since_us;
+    int64_t dry_us;
+} s_out = { .lock = PTHREAD_MUTEX_INITIALIZER, .space = PTHREAD_COND_INITIALIZER };
+
+esp_err_t audio_player_stream_submit(audio_stream_t stream, const int16_t *samples, size_t sample_count,
+                                     int sample_rate_hz, int num_channels, TickType_t timeout, size_t *frames_queued)
+{
+    (void)stream;
+    (void)samples;
+    (void)num_channels;
+    struct timespec until;
+    deadline_after(&until, (int64_t)timeout * 1000);
+    pthread_mutex_lock(&s_out.lock);
+    s_out.rate = sample_rate_hz;
+    s_out.started = true;
+    while (s_out.used == s_out.capacity &&
+           pthread_cond_timedwait(&s_out.space, &s_out.lock, &until) != ETIMEDOUT) {
+    }
+    size_t n = s_out.capacity - s_out.used;
+    if (n > sample_count) {
+        n = sample_count;
+    }
+    s_out.used += n;
+    pthread_mutex_unlock(&s_out.lock);
+    if (frames_queued) {
+        *frames_queued = n;
+    }
+    return n == sample_count ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t audio_player_submit_pcm_wait(const int16_t *samples, size_t sample_count, int sample_rate_hz,
+                                       int num_channels, TickType_t timeout, size_t *frames_queued)
+{
+    return audio_player_stream_submit(AUDIO_STREAM_MEDIA, samples, sample_count, sample_rate_hz, num_channels,
+                                      timeout, frames_queued);
+}
+
+static void *feeder_thread(void *arg)
+{
+    (void)arg;
+    int64_t next = esp_timer_get_time();
+    for (;;) {
+        pthread_mutex_lock(&s_out.lock);
+        if (s_out.quit) {
+            pthread_mutex_unlock(&s_out.lock);
+            return NULL;
+        }
+        int rate = s_out.rate ? s_out.rate : 44100;
+        int64_t now = esp_timer_get_time();
+        if (s_out.started) {
+            if (s_out.used >= FEED_FRAMES) {
+                if (s_out.dry) {
+                    s_out.dry_us += now - s_out.dry_since_us;
+                    s_out.dry = false;
+                }
+                s_out.used -= FEED_FRAMES;
+                pthread_cond_signal(&s_out.space);
+            } else if (!s_out.dry) {
+                s_out.dry = true;
+                s_out.dry_since_us = now;
+                s_out.underruns++;
+            }
+        }
+        pthread_mutex_unlock(&s_out.lock);
+        next += (int64_t)FEED_FRAMES * 1000000 / rate;
+        sleep_us(next - esp_timer_get_time());
+    }
+}
+
+// --- a slow SD card ---------------------------------------------------------------
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    int64_t next_stall_us;
+    uint32_t stalls;
+    uint32_t reads;
+    int64_t max_read_us;
+} sd_file_t;
+
+static ssize_t sd_read(void *cookie, char *buf, size_t size)
+{
+    sd_file_t *f = cookie;
+    size_t n = f->len - f->pos < size ? f->len - f->pos : size;
+    int64_t us = SD_COMMAND_US + (int64_t)n * 1000000 / ((int64_t)s_sd_kbps * 1024);
+    int64_t now = esp_timer_get_time();
+    if (s_stall_ms > 0 && now >= f->next_stall_us) {
+        us += (int64_t)s_stall_ms * 1000;
+        f->next_stall_us = now + (int64_t)s_stall_every_ms * 1000;
+        f->stalls++;
+    }
+    sleep_us(us);
+    f->reads++;
+    if (us > f->max_read_us) {
+        f->max_read_us = us;
+    }
+    memcpy(buf, f->data + f->pos, n);
+    f->pos += n;
+    return (ssize_t)n;
+}
+
+static FILE *sd_open(sd_file_t *f, const uint8_t *data, size_t len)
+{
+    memset(f, 0, sizeof(*f));
+    f->data = data;
+    f->len = len;
+    f->next_stall_us = esp_timer_get_time() + (int64_t)s_stall_every_ms * 1000;
+    cookie_io_functions_t io = { .read = sd_read };
+    return fopencookie(f, "rb", io);
+}
+
+// Silent MPEG-1 Layer III frames: a header, zeroed side info and main data
+static uint8_t *make_mp3(size_t frames, size_t *len)
+{
+    *len = JUNK_BYTES + frames * FRAME_BYTES;
+    uint8_t *mp3 = calloc(1, *len);
+    if (!mp3) {
+        return NULL;
+    }
+    memcpy(mp3, "ID3", 3);
+    for (size_t i = 0; i < frames; i++) {
+        uint8_t *hdr = mp3 + JUNK_BYTES + i * FRAME_BYTES;
+        hdr[0] = 0xFF;
+        hdr[1] = 0xFB;  // MPEG-1, Layer III, no CRC
+        hdr[2] = 0x90;  // 128 kbit/s, 44.1 kHz
+        hdr[3] = 0x00;  // Stereo
+    }
+    return mp3;
+}
+
+// --- the single-task loop mp3_pipeline.c replaced ---------------------------------
+
+static uint32_t legacy_play(FILE *fp, const volatile bool *keep_running, int64_t deadline_us)
+{
+    const size_t mp3_buffer_size = 32768;
+    uint8_t *mp3_buffer = malloc(mp3_buffer_size);
+    int16_t *pcm_buffer = malloc(FRAME_SAMPLES * 2 * sizeof(int16_t));
+    mp3_decoder_t *decoder = mp3_decoder_create();
+    uint32_t frames = 0;
+    size_t bytes_read = fread(mp3_buffer, 1, mp3_buffer_size, fp);
+    bool eof = bytes_read == 0;
+    while (*keep_running && !eof && esp_timer_get_time() < deadline_us) {
+        if (bytes_read < mp3_buffer_size / 2) {
+            size_t to_read = mp3_buffer_size - bytes_read;
+            size_t total_read = 0;
+            while (total_read < to_read && !eof) {
+                size_t this_read = to_read - total_read > 8192 ? 8192 : to_read - total_read;
+                size_t got = fread(mp3_buffer + bytes_read + total_read, 1, this_read, fp);
+                eof = got < this_read;
+                total_read += got;
+                if (total_read < to_read && !eof && total_read % 4096 == 0) {
+                    vTaskDelay(pdMS_TO_TICKS(1));
+                }
+            }
+            bytes_read += total_read;
+        }
+        size_t samples = 0, consumed = 0;
+        int rate = 0, channels = 0;
+        esp_err_t err = mp3_decoder_decode(decoder, mp3_buffer, bytes_read, pcm_buffer, FRAME_SAMPLES * 2,
+                                           &samples, &rate, &channels, &consumed);
+        if (err == ESP_OK && samples > 0 && consumed > 0) {
+            frames++;
+            size_t done = 0;
+            while (done < samples / channels && *keep_running) {
+                size_t queued = 0;
+                audio_player_submit_pcm_wait(pcm_buffer + done * channels, samples / channels - done, rate,
+                                             channels, pdMS_TO_TICKS(100), &queued);
+                done += queued;
+            }
+        }
+        if (consumed > 0) {
+            memmove(mp3_buffer, mp3_buffer + consumed, bytes_read - consumed);
+            bytes_read -= consumed;
+        } else if (bytes_read >= mp3_buffer_size) {
+            bytes_read = 0;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    mp3_decoder_destroy(decoder);
+    free(pcm_buffer);
+    free(mp3_buffer);
+    return frames;
+}
+
+// --- runs -------------------------------------------------------------------------
+
+typedef struct {
+    uint32_t frames;
+    uint32_t underruns;
+    int64_t dry_ms;
+    uint32_t stalls;
+    uint32_t sd_reads;
+    uint32_t sd_max_ms;
+    uint32_t queued_ms;     // Pipeline only: audio queued before its duration limit
+    int input_min_percent;  // -1 where not tracked
+} run_result_t;
+
+static run_result_t run(bool pipeline, const uint8_t *mp3, size_t len)
+{
+    run_result_t r = { .input_min_percent = -1 };
+    pthread_mutex_lock(&s_out.lock);
+    s_out.capacity = PCM_RING_KB * 1024 / (2 * sizeof(int16_t));
+    s_out.used = 0;
+    s_out.started = s_out.dry = s_out.quit = false;
+    s_out.underruns = 0;
+    s_out.dry_us = 0;
+    pthread_mutex_unlock(&s_out.lock);
+
+    pthread_t feeder;
+    pthread_create(&feeder, NULL, feeder_thread, NULL);
+    sd_file_t sd;
+    FILE *fp = sd_open(&sd, mp3, len);
+    static volatile bool keep_running = true;
+    if (pipeline) {
+        // Unbuffered on the device, where newlib reads straight into the ring. glibc reads
+        // an unbuffered stream a byte at a time; with a small buffer it passes large reads
+        // through to the card the same way.
+        setvbuf(fp, NULL, _IOFBF, 512);
+        mp3_pipeline_config_t config = {
+            .fp = fp,
+            .keep_running = &keep_running,
+            .duration_ms = (uint32_t)s_seconds * 1000,
+        };
+        mp3_pipeline_result_t result;
+        if (mp3_pipeline_play(&config, &result) != ESP_OK) {
+            fprintf(stderr, "mp3_pipeline_play failed\n");
+        }
+        r.frames = result.frames_decoded;
+        r.queued_ms = result.queued_ms;
+        r.input_min_percent = result.input_min_percent;
+    } else {
+        setvbuf(fp, NULL, _IOFBF, 16384);
+        r.frames = legacy_play(fp, &keep_running, esp_timer_get_time() + (int64_t)s_seconds * 1000000);
+    }
+    fclose(fp);
+
+    pthread_mutex_lock(&s_out.lock);
+    s_out.quit = true;
+    r.underruns = s_out.underruns;
+    r.dry_ms = s_out.dry_us / 1000;
+    pthread_mutex_unlock(&s_out.lock);
+    pthread_join(feeder, NULL);
+    r.stalls = sd.stalls;
+    r.sd_reads = sd.reads;
+    r.sd_max_ms = (uint32_t)(sd.max_read_us / 1000);
+    return r;
+}
+
+static void print_row(const char *name, const run_result_t *r)
+{
+    char fill[16] = "-";
+    if (r->input_min_percent >= 0) {
+        snprintf(fill, sizeof(fill), "%d%%", r->input_min_percent);
+    }
+    printf("%-12s %8u %10u %8lld %8u %9u %10u %10s\n", name, r->frames, r->underruns, (long long)r->dry_ms,
+           r->stalls, r->sd_reads, r->sd_max_ms, fill);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--seconds") == 0) {
+            s_seconds = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--sd-kbps") == 0) {
+            s_sd_kbps = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--stall-ms") == 0) {
+            s_stall_ms = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "--stall-every-ms") == 0) {
+            s_stall_every_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--seconds S] [--sd-kbps K] [--stall-ms MS] [--stall-every-ms MS]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (s_seconds < 1 || s_sd_kbps < 1 || s_stall_every_ms < 1) {
+        fprintf(stderr, "seconds, sd-kbps and stall-every-ms must be positive\n");
+        return 2;
+    }
+
+    // Longer than the run, so every run is cut by its time limit with data still on the card
+    size_t frames = (size_t)(s_seconds + 10) * 44100 / FRAME_SAMPLES;
+    size_t len;
+    uint8_t *mp3 = make_mp3(frames, &len);
+    if (!mp3) {
+        return 1;
+    }
+    printf("%d s of 128 kbit/s MP3; SD %d KB/s + %d us per read, %d ms stall every %d ms; %d KB PCM ring\n\n",
+           s_seconds, s_sd_kbps, SD_COMMAND_US, s_stall_ms, s_stall_every_ms, PCM_RING_KB);
+    printf("%-12s %8s %10s %8s %8s %9s %10s %10s\n", "loop", "frames", "underruns", "dry ms", "stalls",
+           "SD reads", "SD max ms", "input min");
+
+    run_result_t legacy = run(false, mp3, len);
+    print_row("single task", &legacy);
+    run_result_t piped = run(true, mp3, len);
+    print_row("pipeline", &piped);
+    free(mp3);
+
+    uint32_t expected = (uint32_t)((int64_t)s_seconds * 44100 / FRAME_SAMPLES);
+    int failures = 0;
+    if (piped.underruns > 0) {
+        printf("\nFAIL: pipeline underran %u time(s)\n", piped.underruns);
+        failures++;
+    }
+    if (piped.frames < expected) {
+        printf("\nFAIL: pipeline decoded %u frames, expected at least %u\n", piped.frames, expected);
+        failures++;
+    }
+    if (piped.queued_ms != (uint32_t)s_seconds * 1000) {
+        printf("\nFAIL: pipeline queued %u ms, expected exactly %d\n", piped.queued_ms, s_seconds * 1000);
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+/**
+ * @file resampler_bench.c
+ * @brief Quality checks and ns/frame timing of the mixer's polyphase resampler
+ *
+ * Every conversion is streamed in mixer-sized blocks through audio_resampler_process(),
+ * fed with exactly audio_resampler_input_needed() frames, as the mixer does. Checks per
+ * ratio: THD+N of a 1 kHz tone, the worst THD+N over a passband sweep, passband gain,
+ * image / alias rejection, bit-exact DC and output length. Then times each ratio.
+ *
+ * Usage: resampler_bench [--ms MIN_MS_PER_CASE]
+ */
+
+#include "audio_resampler.h"
+#include "bench_common.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BLOCK_FRAMES    256     // Mixer chunk
+#define THDN_1K_DB      -80.0   // 1 kHz at -1 dBFS
+#define THDN_SWEEP_DB   -70.0   // Worst tone up to PASS_EDGE
+#define PASS_EDGE       0.35    // Fraction of the lower rate held flat
+#define PASS_RIPPLE_DB  0.1
+#define REJECT_DB       -70.0   // Images when upsampling, aliases when downsampling
+
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+} ratio_t;
+
+static const ratio_t RATIOS[] = {
+    { 16000, 48000 }, { 22050, 48000 }, { 24000, 48000 }, { 32000, 48000 }, { 44100, 48000 },
+    { 48000, 44100 }, { 48000, 16000 },
+};
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+// Stream in_frames of stereo input through a fresh resampler, in mixer-sized output blocks
+static size_t run(const audio_resampler_bank_t *bank, const int16_t *in, size_t in_frames, int16_t *out,
+                  size_t max_out)
+{
+    static audio_resampler_t rs;
+    size_t pos = 0, produced = 0;
+    audio_resampler_init(&rs, bank);
+    while (produced < max_out) {
+        size_t want = max_out - produced < BLOCK_FRAMES ? max_out - produced : BLOCK_FRAMES;
+        size_t need = audio_resampler_input_needed(&rs, want);
+        size_t give = in_frames - pos < need ? in_frames - pos : need;
+        size_t used = 0;
+        size_t got = audio_resampler_process(&rs, in + pos * 2, give, &used, out + produced * 2, want);
+        pos += used;
+        produced += got;
+        if (got == 0 && give == 0) {
+            break;
+        }
+    }
+    return produced;
+}
+
+static void make_tone(int16_t *buf, size_t frames, uint32_t rate, double freq, double amplitude)
+{
+    for (size_t i = 0; i < frames; i++) {
+        double v = amplitude * sin(2.0 * M_PI * freq * i / rate);
+        buf[2 * i] = (int16_t)lrint(v);
+        buf[2 * i + 1] = (int16_t)lrint(-v);
+    }
+}
+
+// Least-squares fit of a*sin + b*cos + c to the left channel; returns tone power, sets residual power
+static double fit_tone(const int16_t *buf, size_t frames, uint32_t rate, double freq, double *residual)
+{
+    double m[3][4] = { { 0 } };
+    for (size_t i = 0; i < frames; i++) {
+        double ph = 2.0 * M_PI * freq * i / rate;
+        double v[3] = { sin(ph), cos(ph), 1.0 };
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                m[r][c] += v[r] * v[c];
+            }
+            m[r][3] += v[r] * buf[2 * i];
+        }
+    }
+    for (int p = 0; p < 3; p++) {
+        for (int r = p + 1; r < 3; r++) {
+            double f = m[r][p] / m[p][p];
+            for (int c = p; c < 4; c++) {
+                m[r][c] -= f * m[p][c];
+            }
+        }
+    }
+    double x[3];
+    for (int r = 2; r >= 0; r--) {
+        x[r] = m[r][3];
+        for (int c = r + 1; c < 3; c++) {
+            x[r] -= m[r][c] * x[c];
+        }
+        x[r] /= m[r][r];
+    }
+    double res = 0;
+    for (size_t i = 0; i < frames; i++) {
+        double ph = 2.0 * M_PI * freq * i / rate;
+        double e = buf[2 * i] - (x[0] * sin(ph) + x[1] * cos(ph) + x[2]);
+        res += e * e;
+    }
+    if (residual) {
+        *residual = res / frames;
+    }
+    return (x[0] * x[0] + x[1] * x[1]) / 2.0;
+}
+
+// Tone through the resampler, measured over the second half of a 0.5 s output
+typedef struct {
+    double gain_db;     // Output tone power relative to the input tone
+    double thdn_db;     // Everything else relative to the output tone
+    double at_db;       // Power at 'probe' relative to the input tone
+} tone_result_t;
+
+static tone_result_t measure(const audio_resampler_bank_t *bank, double freq, double amplitude, double probe)
+{
+    size_t in_frames = bank->in_rate / 2 + AUDIO_RESAMPLER_MAX_TAPS;
+    size_t out_frames = bank->out_rate / 2;
+    int16_t *in = malloc(in_frames * 2 * sizeof(int16_t));
+    int16_t *out = calloc(out_frames * 2, sizeof(int16_t));
+    make_tone(in, in_frames, bank->in_rate, freq, amplitude);
+    size_t got = run(bank, in, in_frames, out, out_frames);
+    CHECK(got == out_frames, "%u -> %u: %zu of %zu frames", bank->in_rate, bank->out_rate, got, out_frames);
+
+    const int16_t *win = out + (out_frames / 2) * 2;
+    size_t n = out_frames / 2;
+    double in_power = amplitude * amplitude / 2.0;
+    double residual;
+    double tone = fit_tone(win, n, bank->out_rate, fmod(freq, bank->out_rate), &residual);
+    tone_result_t r = {
+        .gain_db = 10.0 * log10(tone / in_power),
+        .thdn_db = 10.0 * log10((residual + 1e-9) / (tone + 1e-9)),
+        .at_db = -999.0,
+    };
+    if (probe > 0) {
+        r.at_db = 10.0 * log10((fit_tone(win, n, bank->out_rate, probe, NULL) + 1e-9) / in_power);
+    }
+    free(in);
+    free(out);
+    return r;
+}
+
+static void check_ratio(const ratio_t *ratio)
+{
+    const audio_resampler_bank_t *bank = audio_resampler_get_bank(ratio->in_rate, ratio->out_rate);
+    CHECK(bank != NULL, "%u -> %u: no bank", ratio->in_rate, ratio->out_rate);
+    if (!bank) {
+        return;
+    }
+    const double amp = 32767.0 * pow(10.0, -1.0 / 20.0);
+    const double low = ratio->in_rate < ratio->out_rate ? ratio->in_rate : ratio->out_rate;
+
+    tone_result_t k1 = measure(bank, 1000.0, amp, 0);
+    CHECK(k1.thdn_db < THDN_1K_DB, "%u -> %u: 1 kHz THD+N %.1f dB", ratio->in_rate, ratio->out_rate, k1.thdn_db);
+
+    double worst_thdn = -999, worst_gain = 0;
+    for (int k = 1; k <= 8; k++) {
+        double freq = low * PASS_EDGE * k / 8.0;
+        tone_result_t t = measure(bank, freq, amp, 0);
+        worst_thdn = fmax(worst_thdn, t.thdn_db);
+        if (fabs(t.gain_db) > fabs(worst_gain)) {
+            worst_gain = t.gain_db;
+        }
+    }
+    CHECK(worst_thdn < THDN_SWEEP_DB, "%u -> %u: sweep THD+N %.1f dB", ratio->in_rate, ratio->out_rate, worst_thdn);
+    CHECK(fabs(worst_gain) < PASS_RIPPLE_DB, "%u -> %u: passband gain %.3f dB", ratio->in_rate, ratio->out_rate,
+          worst_gain);
+
+    // Upsampling: a tone at f images at in_rate - f. Downsampling: a tone above the output
+    // Nyquist folds to out_rate - f. Either way the unwanted product must be gone.
+    double reject;
+    if (ratio->in_rate < ratio->out_rate) {
+        double f = ratio->in_rate * PASS_EDGE;
+        double image = ratio->in_rate - f;
+        while (image > ratio->out_rate / 2.0) {
+            image = fabs(ratio->out_rate - image);
+        }
+        reject = measure(bank, f, amp, image).at_db;
+    } else {
+        double f = ratio->out_rate * 0.65;
+        tone_result_t t = measure(bank, f, amp, ratio->out_rate - f);
+        reject = t.at_db;
+    }
+    CHECK(reject < REJECT_DB, "%u -> %u: %s %.1f dB", ratio->in_rate, ratio->out_rate,
+          ratio->in_rate < ratio->out_rate ? "image" : "alias", reject);
+
+    // DC passes bit-exact once the window is full
+    size_t in_frames = ratio->in_rate / 10, out_frames = ratio->out_rate / 10;
+    int16_t *in = malloc(in_frames * 2 * sizeof(int16_t));
+    int16_t *out = malloc(out_frames * 2 * sizeof(int16_t));
+    for (size_t i = 0; i < in_frames * 2; i++) {
+        in[i] = (i & 1) ? -12345 : 23456;
+    }
+    size_t got = run(bank, in, in_frames, out, out_frames);
+    size_t settle = (size_t)bank->taps * ratio->out_rate / ratio->in_rate + 1;
+    size_t bad = 0;
+    for (size_t i = settle; i + settle < got; i++) {
+        bad += out[2 * i] != 23456 || out[2 * i + 1] != -12345;
+    }
+    CHECK(bad == 0, "%u -> %u: %zu DC frames not exact", ratio->in_rate, ratio->out_rate, bad);
+    free(in);
+    free(out);
+
+    printf("  %5u -> %5u  L/M %3u/%-3u taps %3u   1k THD+N %6.1f dB  sweep %6.1f dB  gain %+.3f dB  %s %6.1f dB\n",
+           ratio->in_rate, ratio->out_rate, bank->up, bank->down, bank->taps, k1.thdn_db, worst_thdn, worst_gain,
+           ratio->in_rate < ratio->out_rate ? "image" : "alias", reject);
+}
+
+static void bench(int min_ms)
+{
+    printf("\n%-16s %14s %16s\n", "ratio", "ns/out frame", "x realtime");
+    for (size_t r = 0; r < sizeof(RATIOS) / sizeof(RATIOS[0]); r++) {
+        const audio_resampler_bank_t *bank = audio_resampler_get_bank(RATIOS[r].in_rate, RATIOS[r].out_rate);
+        if (!bank) {
+            continue;
+        }
+        size_t in_frames = RATIOS[r].in_rate, out_frames = RATIOS[r].out_rate;
+        int16_t *in = malloc(in_frames * 2 * sizeof(int16_t));
+        int16_t *out = malloc(out_frames * 2 * sizeof(int16_t));
+        for (size_t i = 0; i < in_frames * 2; i++) {
+            in[i] = (int16_t)((rand() % 20000) - 10000);
+        }
+        long long frames = 0;
+        double start = now_s(), elapsed;
+        do {
+            frames += run(bank, in, in_frames, out, out_frames);
+            elapsed = now_s() - start;
+        } while (elapsed * 1000 < min_ms);
+        double ns = elapsed * 1e9 / frames;
+        printf("%5u -> %-7u %14.2f %16.0f\n", RATIOS[r].in_rate, RATIOS[r].out_rate, ns,
+               1e9 / (ns * RATIOS[r].out_rate));
+        free(in);
+        free(out);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int min_ms = 300;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--ms MIN_MS_PER_CASE]\n", argv[0]);
+            return 2;
+        }
+    }
+    srand(1);
+
+    printf("Quality\n");
+    for (size_t r = 0; r < sizeof(RATIOS) / sizeof(RATIOS[0]); r++) {
+        check_ratio(&RATIOS[r]);
+    }
+
+    bench(min_ms);
+
+    return bench_exit_code();
+}
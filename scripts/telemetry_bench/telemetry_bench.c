@@ -0,0 +1,228 @@
+/**
+ * @file telemetry_bench.c
+ * @brief Histogram, snapshot-layout and cost checks of the playback telemetry (main/audio_telemetry.c)
+ *
+ * Checks bucket edges, percentiles, that the binary snapshot layout a client decodes
+ * has not moved, and that the counters are gathered from the audio player. Then times
+ * audio_telemetry_record() and a snapshot, and sets them against the event rates of
+ * 48 kHz playback of a 44.1 kHz MP3 from SD.
+ *
+ * Usage: telemetry_bench [--ms MIN_MS_PER_CASE]
+ */
+
+#include "audio_telemetry.h"
+#include "audio_player.h"
+#include "bench_common.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)(now_s() * 1e6);
+}
+
+// The player side: fixed counters so the snapshot can be checked field by field
+void audio_player_get_stats(audio_player_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->frames_played = 123456789;
+    stats->dma_underruns = 7;
+    stats->dma_fill_min_percent = 40;
+    stats->dma_fill_avg_percent = 83;
+    stats->playing = true;
+}
+
+void audio_player_get_stream_stats(audio_stream_t stream, audio_player_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->frames_played = 1000 + stream;
+    stats->underruns = 10 + stream;
+    stats->overruns = 20 + stream;
+    stats->fill_min_percent = 30 + stream;
+    stats->fill_avg_percent = 60 + stream;
+    stats->playing = stream == AUDIO_STREAM_MEDIA;
+}
+
+static void check_buckets(void)
+{
+    static const struct {
+        uint32_t us;
+        int bucket;
+    } cases[] = {
+        { 0, 0 }, { 31, 0 }, { 32, 1 }, { 63, 1 }, { 64, 2 }, { 1000, 5 },
+        { 16383, 9 }, { 16384, 10 }, { 32767, 10 }, { 32768, 11 }, { 4000000000u, 11 },
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        audio_telemetry_hist_t before, after;
+        audio_telemetry_get_hist(AUDIO_TELEMETRY_DECODE, &before);
+        audio_telemetry_record(AUDIO_TELEMETRY_DECODE, cases[i].us);
+        audio_telemetry_get_hist(AUDIO_TELEMETRY_DECODE, &after);
+        int got = -1;
+        for (int b = 0; b < AUDIO_TELEMETRY_BUCKETS; b++) {
+            if (after.buckets[b] != before.buckets[b]) {
+                got = b;
+            }
+        }
+        CHECK(got == cases[i].bucket, "%u us went to bucket %d, expected %d", cases[i].us, got, cases[i].bucket);
+        CHECK(audio_telemetry_bucket_floor_us(cases[i].bucket) <= cases[i].us, "bucket %d floor %u above %u",
+              cases[i].bucket, audio_telemetry_bucket_floor_us(cases[i].bucket), cases[i].us);
+    }
+    audio_telemetry_hist_t h;
+    audio_telemetry_get_hist(AUDIO_TELEMETRY_DECODE, &h);
+    CHECK(h.count == sizeof(cases) / sizeof(cases[0]), "count %u", h.count);
+    CHECK(h.max_us == 4000000000u, "max %u", h.max_us);
+    printf("  bucket edges: %u", audio_telemetry_bucket_floor_us(0));
+    for (int b = 1; b < AUDIO_TELEMETRY_BUCKETS; b++) {
+        printf(" %u", audio_telemetry_bucket_floor_us(b));
+    }
+    printf(" us\n");
+}
+
+static void check_percentiles(void)
+{
+    // 98 fast writes, one slow, one stall: p50 in the fast bucket, p99 at the slow one
+    for (int i = 0; i < 98; i++) {
+        audio_telemetry_record(AUDIO_TELEMETRY_SD_READ, 100);
+    }
+    audio_telemetry_record(AUDIO_TELEMETRY_SD_READ, 3000);
+    audio_telemetry_record(AUDIO_TELEMETRY_SD_READ, 50000);
+    audio_telemetry_hist_t h;
+    audio_telemetry_get_hist(AUDIO_TELEMETRY_SD_READ, &h);
+    uint32_t p50 = audio_telemetry_percentile_us(&h, 0.50f);
+    uint32_t p99 = audio_telemetry_percentile_us(&h, 0.99f);
+    uint32_t p100 = audio_telemetry_percentile_us(&h, 1.0f);
+    printf("  p50 %u us, p99 %u us, p100 %u us (samples 100 x98, 3000, 50000)\n", p50, p99, p100);
+    CHECK(p50 == 128, "p50 %u", p50);
+    CHECK(p99 == 4096, "p99 %u", p99);
+    CHECK(p100 == 50000, "p100 %u", p100);
+    CHECK(h.total_us == 98 * 100 + 3000 + 50000, "total %llu", (unsigned long long)h.total_us);
+}
+
+#define WRITER_TASKS    4       // Reader and decoder of both decks during a crossfade
+#define WRITER_SAMPLES  1000000
+
+static void *writer_task(void *arg)
+{
+    uint32_t us = (uint32_t)(uintptr_t)arg;
+    for (int i = 0; i < WRITER_SAMPLES; i++) {
+        audio_telemetry_record(AUDIO_TELEMETRY_READER_WAIT, us);
+    }
+    return NULL;
+}
+
+static void check_writers(void)
+{
+    // Each task records its own duration, so lost or torn updates show in the count and total
+    pthread_t tasks[WRITER_TASKS];
+    uint64_t expect_total = 0;
+    for (int i = 0; i < WRITER_TASKS; i++) {
+        uint32_t us = 1000u * (i + 1);
+        expect_total += (uint64_t)us * WRITER_SAMPLES;
+        pthread_create(&tasks[i], NULL, writer_task, (void *)(uintptr_t)us);
+    }
+    for (int i = 0; i < WRITER_TASKS; i++) {
+        pthread_join(tasks[i], NULL);
+    }
+    audio_telemetry_hist_t h;
+    audio_telemetry_get_hist(AUDIO_TELEMETRY_READER_WAIT, &h);
+    printf("  %d writers x %d samples: count %u\n", WRITER_TASKS, WRITER_SAMPLES, h.count);
+    CHECK(h.count == WRITER_TASKS * WRITER_SAMPLES, "count %u, expected %u", h.count,
+          (unsigned)(WRITER_TASKS * WRITER_SAMPLES));
+    CHECK(h.total_us == expect_total, "total %llu, expected %llu", (unsigned long long)h.total_us,
+          (unsigned long long)expect_total);
+    CHECK(h.max_us == 1000u * WRITER_TASKS, "max %u", h.max_us);
+}
+
+// Field offsets are the wire format: a change here needs AUDIO_TELEMETRY_VERSION bumped
+static void check_snapshot(void)
+{
+    CHECK(sizeof(audio_telemetry_hist_t) == 64, "hist size %zu", sizeof(audio_telemetry_hist_t));
+    CHECK(sizeof(audio_telemetry_stream_t) == 28, "stream size %zu", sizeof(audio_telemetry_stream_t));
+    CHECK(offsetof(audio_telemetry_snapshot_t, hist) == 28, "hist offset %zu",
+          offsetof(audio_telemetry_snapshot_t, hist));
+    CHECK(sizeof(audio_telemetry_snapshot_t) == 28 + 4 * 64 + 4 * 28, "snapshot size %zu",
+          sizeof(audio_telemetry_snapshot_t));
+
+    audio_telemetry_snapshot_t snap;
+    CHECK(audio_telemetry_snapshot(&snap) == ESP_OK, "snapshot failed");
+    const uint8_t *raw = (const uint8_t *)&snap;
+    CHECK(memcmp(raw, "ATLM", 4) == 0, "magic %.4s", (const char *)raw);
+    CHECK(snap.size == sizeof(snap) && snap.version == AUDIO_TELEMETRY_VERSION, "header size %u version %u",
+          snap.size, snap.version);
+    CHECK(snap.frames_played == 123456789 && snap.dma_underruns == 7 && snap.dma_fill_min_percent == 40 &&
+              snap.dma_fill_avg_percent == 83 && snap.playing == 1 && snap.num_streams == 4,
+          "player totals not copied");
+    for (int i = 0; i < AUDIO_TELEMETRY_STREAMS; i++) {
+        const audio_telemetry_stream_t *st = &snap.streams[i];
+        CHECK(st->frames_played == 1000u + i && st->underruns == 10u + i && st->overruns == 20u + i &&
+                  st->fill_min_percent == 30 + i && st->fill_avg_percent == 60 + i && st->playing == (i == 0),
+              "stream %d counters not copied", i);
+    }
+    CHECK(snap.hist[AUDIO_TELEMETRY_SD_READ].count == 100, "SD histogram count %u",
+          snap.hist[AUDIO_TELEMETRY_SD_READ].count);
+    printf("  snapshot: %zu bytes, version %u\n", sizeof(snap), snap.version);
+}
+
+static void bench(int min_ms)
+{
+    long long n = 0;
+    uint32_t us = 1;
+    double start = now_s(), elapsed;
+    do {
+        for (int i = 0; i < 4096; i++) {
+            audio_telemetry_record(AUDIO_TELEMETRY_I2S_WRITE, us);
+            us = us * 1103515245u + 12345u;  // Spread over every bucket
+            us >>= 12;
+        }
+        n += 4096;
+        elapsed = now_s() - start;
+    } while (elapsed * 1000 < min_ms);
+    double record_ns = elapsed * 1e9 / n;
+
+    audio_telemetry_snapshot_t snap;
+    n = 0;
+    start = now_s();
+    do {
+        audio_telemetry_snapshot(&snap);
+        n++;
+        elapsed = now_s() - start;
+    } while (elapsed * 1000 < min_ms);
+    double snapshot_ns = elapsed * 1e9 / n;
+
+    // Per second: one I2S write per 256 frames at 48 kHz, one decode per 1152 samples
+    // at 44.1 kHz, one 8 KB reader fread() per ~0.5 s of 128 kbit/s MP3 and one 16 KB
+    // SD cache block read per ~1 s
+    double events = 48000.0 / 256 + 44100.0 / 1152 + 2.0 + 1.0;
+    printf("\n%-26s %12s\n", "operation", "ns");
+    printf("%-26s %12.1f\n", "record", record_ns);
+    printf("%-26s %12.1f\n", "snapshot", snapshot_ns);
+    printf("Playback: %.0f events/s -> %.4f%% of one core at host speed (budget 1%%)\n", events,
+           events * record_ns / 1e7);
+}
+
+int main(int argc, char **argv)
+{
+    int min_ms = 300;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--ms MIN_MS_PER_CASE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("Histograms\n");
+    check_buckets();
+    check_percentiles();
+    check_writers();
+    printf("Snapshot\n");
+    check_snapshot();
+
+    bench(min_ms);
+
+    return bench_exit_code();
+}
@@ -0,0 +1,36 @@
+/**
+ * @file host_bench.h
+ * @brief Measurement hooks shared by the host shims and the voice pipeline benchmark
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Raw bytes written to / read from the mock server sockets since start
+ */
+void host_http_get_counters(uint64_t *tx, uint64_t *rx);
+
+/**
+ * Bytes currently allocated through malloc/calloc/realloc and the high-water mark
+ */
+void host_heap_get(size_t *live, size_t *peak);
+
+/**
+ * Restart the high-water mark from the current live size
+ */
+void host_heap_reset_peak(void);
+
+/**
+ * Playback sink statistics: time of the first submitted sample (0 if none), total samples
+ * and the largest step between consecutive samples (the mock's 440 Hz sine stays below
+ * HOST_PCM_MAX_STEP; a mis-decoded base64 body does not)
+ */
+#define HOST_PCM_MAX_STEP 2000
+
+void host_audio_reset(void);
+int64_t host_audio_first_us(void);
+size_t host_audio_samples(void);
+int host_audio_max_step(void);
@@ -0,0 +1,412 @@
+/**
+ * @file host_http_client.c
+ * @brief Blocking HTTP/1.1 client implementing the esp_http_client subset on POSIX sockets
+ *
+ * Every request goes to VOICE_BENCH_SERVER (default 127.0.0.1:8765) in clear text,
+ * with the original host kept in the Host header. Events are dispatched like the
+ * IDF client (ON_HEADER per header, ON_DATA per decoded body chunk) so the gemini
+ * event handler runs unmodified. Raw bytes sent/received are counted for the bench.
+ */
+
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "host_bench.h"
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const char *TAG = "host_http";
+
+#define MAX_HEADERS     16
+#define RECV_CHUNK      4096
+
+struct esp_http_client {
+    char url[2048];
+    esp_http_client_method_t method;
+    char *header_keys[MAX_HEADERS];
+    char *header_values[MAX_HEADERS];
+    int header_count;
+    const char *post_data;
+    int post_len;
+    http_event_handle_cb handler;
+    void *user_data;
+    int timeout_ms;
+    int status;
+    int64_t content_length;
+};
+
+static uint64_t s_bytes_tx = 0;
+static uint64_t s_bytes_rx = 0;
+
+void host_http_get_counters(uint64_t *tx, uint64_t *rx)
+{
+    *tx = s_bytes_tx;
+    *rx = s_bytes_rx;
+}
+
+// Local copy so the allocation goes through the tracked malloc
+static char *dup_string(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *copy = malloc(len);
+    if (copy) {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
+
+static void dispatch(esp_http_client_handle_t client, esp_http_client_event_id_t id,
+                     void *data, int len, char *key, char *value)
+{
+    if (!client->handler) {
+        return;
+    }
+    esp_http_client_event_t evt = {
+        .event_id = id,
+        .client = client,
+        .data = data,
+        .data_len = len,
+        .user_data = client->user_data,
+        .header_key = key,
+        .header_value = value,
+    };
+    // Like the IDF client, the handler's return value doesn't abort the transfer
+    client->handler(&evt);
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    if (!config || !config->url) {
+        return NULL;
+    }
+    esp_http_client_handle_t client = calloc(1, sizeof(struct esp_http_client));
+    if (!client) {
+        return NULL;
+    }
+    snprintf(client->url, sizeof(client->url), "%s", config->url);
+    client->method = config->method;
+    client->handler = config->event_handler;
+    client->user_data = config->user_data;
+    client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+    return client;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url)
+{
+    snprintf(client->url, sizeof(client->url), "%s", url);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method)
+{
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    for (int i = 0; i < client->header_count; i++) {
+        if (strcasecmp(client->header_keys[i], key) == 0) {
+            free(client->header_values[i]);
+            client->header_values[i] = dup_string(value);
+            return ESP_OK;
+        }
+    }
+    if (client->header_count >= MAX_HEADERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    client->header_keys[client->header_count] = dup_string(key);
+    client->header_values[client->header_count] = dup_string(value);
+    client->header_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len)
+{
+    client->post_data = data;
+    client->post_len = len;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_user_data(esp_http_client_handle_t client, void *data)
+{
+    client->user_data = data;
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int64_t esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    return client->content_length;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    if (!client) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < client->header_count; i++) {
+        free(client->header_keys[i]);
+        free(client->header_values[i]);
+    }
+    free(client);
+    return ESP_OK;
+}
+
+static const char *method_name(esp_http_client_method_t method)
+{
+    switch (method) {
+        case HTTP_METHOD_POST:   return "POST";
+        case HTTP_METHOD_PUT:    return "PUT";
+        case HTTP_METHOD_PATCH:  return "PATCH";
+        case HTTP_METHOD_DELETE: return "DELETE";
+        case HTTP_METHOD_HEAD:   return "HEAD";
+        default:                 return "GET";
+    }
+}
+
+static int connect_server(int timeout_ms)
+{
+    const char *server = getenv("VOICE_BENCH_SERVER");
+    char host[256];
+    snprintf(host, sizeof(host), "%s", server ? server : "127.0.0.1:8765");
+    char *colon = strrchr(host, ':');
+    const char *port = "8765";
+    if (colon) {
+        *colon = '\0';
+        port = colon + 1;
+    }
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, port, &hints, &res) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, 0);
+        if (n <= 0) {
+            return false;
+        }
+        s_bytes_tx += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Buffered reader over the socket
+typedef struct {
+    int fd;
+    char buf[RECV_CHUNK];
+    size_t pos;
+    size_t len;
+} reader_t;
+
+static ssize_t reader_fill(reader_t *r)
+{
+    if (r->pos < r->len) {
+        return r->len - r->pos;
+    }
+    ssize_t n = recv(r->fd, r->buf, sizeof(r->buf), 0);
+    if (n > 0) {
+        s_bytes_rx += n;
+        r->pos = 0;
+        r->len = n;
+    }
+    return n;
+}
+
+// Read one CRLF-terminated line (terminator stripped)
+static bool reader_line(reader_t *r, char *line, size_t line_len)
+{
+    size_t n = 0;
+    while (true) {
+        if (reader_fill(r) <= 0) {
+            return false;
+        }
+        char c = r->buf[r->pos++];
+        if (c == '\n') {
+            if (n > 0 && line[n - 1] == '\r') {
+                n--;
+            }
+            line[n] = '\0';
+            return true;
+        }
+        if (n + 1 < line_len) {
+            line[n++] = c;
+        }
+    }
+}
+
+// Deliver up to `want` body bytes (or until EOF if want < 0) as ON_DATA events
+static bool deliver_body(esp_http_client_handle_t client, reader_t *r, int64_t want)
+{
+    while (want != 0) {
+        ssize_t avail = reader_fill(r);
+        if (avail <= 0) {
+            return want < 0;  // EOF terminates a body without a length
+        }
+        size_t n = (want > 0 && want < avail) ? (size_t)want : (size_t)avail;
+        dispatch(client, HTTP_EVENT_ON_DATA, r->buf + r->pos, (int)n, NULL, NULL);
+        r->pos += n;
+        if (want > 0) {
+            want -= n;
+        }
+    }
+    return true;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    client->status = 0;
+    client->content_length = -1;
+
+    // Split https://host[:port]/path into Host header and request target
+    const char *p = strstr(client->url, "://");
+    p = p ? p + 3 : client->url;
+    const char *path = strchr(p, '/');
+    char host[256];
+    size_t host_len = path ? (size_t)(path - p) : strlen(p);
+    snprintf(host, sizeof(host), "%.*s", (int)host_len, p);
+    if (!path) {
+        path = "/";
+    }
+
+    int fd = connect_server(client->timeout_ms);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Cannot connect to mock server for %s", host);
+        dispatch(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+        return ESP_ERR_INVALID_STATE;
+    }
+    dispatch(client, HTTP_EVENT_ON_CONNECTED, NULL, 0, NULL, NULL);
+
+    size_t head_cap = 1024 + strlen(client->url);
+    for (int i = 0; i < client->header_count; i++) {
+        head_cap += strlen(client->header_keys[i]) + strlen(client->header_values[i]) + 4;
+    }
+    char *head = malloc(head_cap);
+    if (!head) {
+        close(fd);
+        return ESP_ERR_NO_MEM;
+    }
+    int body_len = client->post_data ? client->post_len : 0;
+    int n = snprintf(head, head_cap, "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nContent-Length: %d\r\n",
+                     method_name(client->method), path, host, body_len);
+    for (int i = 0; i < client->header_count; i++) {
+        n += snprintf(head + n, head_cap - n, "%s: %s\r\n", client->header_keys[i], client->header_values[i]);
+    }
+    n += snprintf(head + n, head_cap - n, "\r\n");
+    bool sent = send_all(fd, head, n) && (body_len == 0 || send_all(fd, client->post_data, body_len));
+    free(head);
+    if (!sent) {
+        close(fd);
+        dispatch(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+        return ESP_FAIL;
+    }
+    dispatch(client, HTTP_EVENT_HEADERS_SENT, NULL, 0, NULL, NULL);
+
+    reader_t *r = malloc(sizeof(reader_t));
+    if (!r) {
+        close(fd);
+        return ESP_ERR_NO_MEM;
+    }
+    r->fd = fd;
+    r->pos = r->len = 0;
+
+    esp_err_t err = ESP_OK;
+    char line[1024];
+    bool chunked = false;
+    if (!reader_line(r, line, sizeof(line)) || sscanf(line, "HTTP/%*s %d", &client->status) != 1) {
+        err = (errno == EAGAIN || errno == EWOULDBLOCK) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        goto done;
+    }
+    while (true) {
+        if (!reader_line(r, line, sizeof(line))) {
+            err = ESP_FAIL;
+            goto done;
+        }
+        if (line[0] == '\0') {
+            break;
+        }
+        char *colon = strchr(line, ':');
+        if (!colon) {
+            continue;
+        }
+        *colon = '\0';
+        char *value = colon + 1;
+        while (*value == ' ') {
+            value++;
+        }
+        if (strcasecmp(line, "Content-Length") == 0) {
+            client->content_length = strtoll(value, NULL, 10);
+        } else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasecmp(value, "chunked") == 0) {
+            chunked = true;
+        }
+        dispatch(client, HTTP_EVENT_ON_HEADER, NULL, 0, line, value);
+    }
+
+    if (client->method == HTTP_METHOD_HEAD) {
+        // No body
+    } else if (chunked) {
+        while (true) {
+            if (!reader_line(r, line, sizeof(line))) {
+                err = ESP_FAIL;
+                break;
+            }
+            long size = strtol(line, NULL, 16);
+            if (size == 0) {
+                break;
+            }
+            if (!deliver_body(client, r, size) || !reader_line(r, line, sizeof(line))) {
+                err = ESP_FAIL;
+                break;
+            }
+        }
+    } else if (!deliver_body(client, r, client->content_length)) {
+        ESP_LOGW(TAG, "Connection closed before the end of the body");
+        err = ESP_FAIL;
+    }
+
+done:
+    free(r);
+    close(fd);
+    if (err == ESP_OK) {
+        dispatch(client, HTTP_EVENT_ON_FINISH, NULL, 0, NULL, NULL);
+    } else {
+        dispatch(client, HTTP_EVENT_ERROR, NULL, 0, NULL, NULL);
+    }
+    dispatch(client, HTTP_EVENT_DISCONNECTED, NULL, 0, NULL, NULL);
+    return err;
+}
@@ -0,0 +1,385 @@
+/**
+ * @file host_platform.c
+ * @brief Host implementations of the IDF, FreeRTOS and board APIs the voice pipeline links against
+ *
+ * Allocation tracking relies on the linker wrapping malloc/calloc/realloc/free
+ * (see CMakeLists.txt); sizes come from malloc_usable_size so no header is added.
+ */
+
+#include "host_bench.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "net_scheduler.h"
+#include "gemini_prewarm.h"
+#include "action_manager.h"
+#include "audio_player.h"
+#include "wake_word_manager.h"
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOST_HEAP_SIZE (8 * 1024 * 1024)  // Reported capacity, like the Korvo-1 PSRAM
+
+// --- logging / errors --------------------------------------------------------
+
+void host_log(int level, const char *tag, const char *fmt, ...)
+{
+    static int max_level = -1;
+    if (max_level < 0) {
+        const char *env = getenv("VOICE_BENCH_LOG");
+        max_level = env ? atoi(env) : 2;
+    }
+    if (level > max_level) {
+        return;
+    }
+    static const char letters[] = "?EWIDV";
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                   return "ESP_OK";
+        case ESP_FAIL:                 return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:           return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:      return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:    return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:     return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:        return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:    return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:          return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:      return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NOT_FINISHED:     return "ESP_ERR_NOT_FINISHED";
+        default:                       return "UNKNOWN ERROR";
+    }
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// --- tracked heap -------------------------------------------------------------
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static size_t s_heap_live = 0;
+static size_t s_heap_peak = 0;
+
+static void heap_add(size_t n)
+{
+    size_t live = __atomic_add_fetch(&s_heap_live, n, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&s_heap_peak, __ATOMIC_RELAXED);
+    while (live > peak && !__atomic_compare_exchange_n(&s_heap_peak, &peak, live, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void heap_sub(size_t n)
+{
+    __atomic_sub_fetch(&s_heap_live, n, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *p = __real_malloc(size);
+    if (p) {
+        heap_add(malloc_usable_size(p));
+    }
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    if (p) {
+        heap_add(malloc_usable_size(p));
+    }
+    return p;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void *p = __real_realloc(ptr, size);
+    if (p) {
+        heap_sub(old);
+        heap_add(malloc_usable_size(p));
+    } else if (size == 0) {
+        heap_sub(old);
+    }
+    return p;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr) {
+        heap_sub(malloc_usable_size(ptr));
+        __real_free(ptr);
+    }
+}
+
+void host_heap_get(size_t *live, size_t *peak)
+{
+    *live = __atomic_load_n(&s_heap_live, __ATOMIC_RELAXED);
+    *peak = __atomic_load_n(&s_heap_peak, __ATOMIC_RELAXED);
+}
+
+void host_heap_reset_peak(void)
+{
+    __atomic_store_n(&s_heap_peak, __atomic_load_n(&s_heap_live, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return realloc(ptr, size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    (void)caps;
+    size_t live = __atomic_load_n(&s_heap_live, __ATOMIC_RELAXED);
+    return live < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - live : 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+size_t esp_get_free_heap_size(void)
+{
+    return heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+// --- FreeRTOS -------------------------------------------------------------------
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static void *task_trampoline(void *param)
+{
+    struct host_task *task = param;
+    task->fn(task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *out)
+{
+    (void)name;
+    (void)stack;
+    (void)prio;
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if (!task) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&task->thread, NULL, task_trampoline, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (out) {
+        *out = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    (void)core;
+    return xTaskCreate(fn, name, stack, arg, prio, out);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Tasks on the benchmarked path only delete themselves after leaving their loop
+    if (task == NULL) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    (void)length;
+    (void)item_size;
+    return (QueueHandle_t)malloc(1);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    free(queue);
+}
+
+// --- network scheduler / pre-connect: a single client, always admitted ---------
+
+esp_err_t net_scheduler_init(void) { return ESP_OK; }
+
+esp_err_t net_scheduler_acquire(net_priority_t priority, TickType_t timeout, net_session_t *session)
+{
+    (void)timeout;
+    session->slot = 0;
+    session->priority = priority == NET_PRIO_TASK_DEFAULT ? NET_PRIO_VOICE : priority;
+    return ESP_OK;
+}
+
+void net_scheduler_release(net_session_t *session) { session->slot = -1; }
+esp_err_t net_scheduler_set_task_priority(TaskHandle_t task, net_priority_t priority)
+{
+    (void)task;
+    (void)priority;
+    return ESP_OK;
+}
+void net_scheduler_voice_turn_begin(void) {}
+void net_scheduler_voice_turn_end(void) {}
+bool net_scheduler_voice_turn_active(void) { return false; }
+void net_scheduler_get_stats(net_scheduler_stats_t *stats) { memset(stats, 0, sizeof(*stats)); }
+esp_err_t net_scheduler_deinit(void) { return ESP_OK; }
+
+esp_err_t gemini_prewarm_start(http_event_handle_cb event_handler)
+{
+    (void)event_handler;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_http_client_handle_t gemini_prewarm_claim(const char *url, net_session_t *session)
+{
+    (void)url;
+    (void)session;
+    return NULL;
+}
+
+// --- board: actions, playback sink, wake word ---------------------------------
+
+esp_err_t action_manager_execute(const action_t *action)
+{
+    ESP_LOGI("host_action", "Action %d", action->type);
+    return ESP_OK;
+}
+
+static int64_t s_audio_first_us = 0;
+static size_t s_audio_samples = 0;
+static int16_t s_audio_last = 0;
+static int s_audio_max_step = 0;
+
+// LINEAR16 TTS bodies start with a 44-byte RIFF header that reaches the sink as samples
+#define WAV_HEADER_SAMPLES 22
+
+esp_err_t audio_player_stream_submit(audio_stream_t stream, const int16_t *samples, size_t sample_count,
+                                     int sample_rate_hz, int num_channels, TickType_t timeout,
+                                     size_t *frames_queued)
+{
+    (void)stream;
+    (void)sample_rate_hz;
+    (void)num_channels;
+    (void)timeout;
+    if (s_audio_first_us == 0 && sample_count > 0) {
+        s_audio_first_us = esp_timer_get_time();
+    }
+    for (size_t i = 0; i < sample_count; i++) {
+        int step = abs(samples[i] - s_audio_last);
+        if (s_audio_samples + i > WAV_HEADER_SAMPLES && step > s_audio_max_step) {
+            s_audio_max_step = step;
+        }
+        s_audio_last = samples[i];
+    }
+    s_audio_samples += sample_count;
+    if (frames_queued) {
+        *frames_queued = sample_count;
+    }
+    return ESP_OK;
+}
+
+// Nothing is actually played on the host, so the queue is always drained
+esp_err_t audio_player_stream_wait_idle(audio_stream_t stream, TickType_t timeout)
+{
+    (void)stream;
+    (void)timeout;
+    return ESP_OK;
+}
+
+void host_audio_reset(void)
+{
+    s_audio_first_us = 0;
+    s_audio_samples = 0;
+    s_audio_last = 0;
+    s_audio_max_step = 0;
+}
+
+int64_t host_audio_first_us(void)
+{
+    return s_audio_first_us;
+}
+
+size_t host_audio_samples(void)
+{
+    return s_audio_samples;
+}
+
+int host_audio_max_step(void)
+{
+    return s_audio_max_step;
+}
+
+void wake_word_manager_pause(void) {}
+void wake_word_manager_resume(void) {}
@@ -0,0 +1,4 @@
+// Host shim
+#pragma once
+
+typedef int i2s_port_t;
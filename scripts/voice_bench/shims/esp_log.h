@@ -0,0 +1,12 @@
+// Host shim: ESP_LOGx to stderr, filtered by VOICE_BENCH_LOG (0=none .. 4=debug)
+#pragma once
+
+#include "esp_err.h"
+
+void host_log(int level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, fmt, ...) host_log(1, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) host_log(2, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) host_log(3, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) host_log(4, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) host_log(5, tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,10 @@
+// Host shim: ROM CRC32 backed by zlib
+#pragma once
+
+#include <stdint.h>
+#include <zlib.h>
+
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    return crc32(crc, buf, len);
+}
@@ -0,0 +1,6 @@
+// Host shim: monotonic microsecond clock
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
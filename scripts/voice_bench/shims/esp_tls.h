@@ -0,0 +1,2 @@
+// Host shim: TLS is not used against the local mock server
+#pragma once
@@ -0,0 +1,25 @@
+// Host shim: FreeRTOS types and tick conversion on top of pthreads (1 tick = 1 ms)
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE            1
+#define pdFALSE           0
+#define pdPASS            1
+#define pdFAIL            0
+#define portMAX_DELAY     ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// Critical sections map onto a pthread mutex per portMUX
+#include <pthread.h>
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+#define taskENTER_CRITICAL(mux)      pthread_mutex_lock(mux)
+#define taskEXIT_CRITICAL(mux)       pthread_mutex_unlock(mux)
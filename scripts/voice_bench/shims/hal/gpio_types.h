@@ -0,0 +1,4 @@
+// Host shim
+#pragma once
+
+typedef int gpio_num_t;
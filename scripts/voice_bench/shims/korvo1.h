@@ -0,0 +1,2 @@
+// Host shim: board definitions are not needed off-target
+#pragma once
@@ -0,0 +1,4 @@
+// Host shim
+#pragma once
+
+typedef struct led_strip_t *led_strip_handle_t;
@@ -0,0 +1,95 @@
+// Host shim: the subset of the ROM tinfl API used by gzip_stream, backed by zlib raw inflate
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TINFL_LZ_DICT_SIZE          32768
+#define TINFL_FLAG_HAS_MORE_INPUT   2
+
+typedef enum {
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+typedef struct {
+    z_stream z;
+    int active;
+    uint32_t m_num_bits;      // Bits left in the bit buffer at TINFL_STATUS_DONE
+    uint32_t m_bit_buf;
+    uint8_t tail[4];          // Last input bytes consumed, oldest first
+    uint32_t pad;             // Bits left of the last deflate byte after its last block
+} tinfl_decompressor;
+
+#define tinfl_init(r) ((r)->active = 0, (r)->m_num_bits = 0, (r)->m_bit_buf = 0, (r)->pad = 0)
+
+// Like the ROM inflater, which refills its 32-bit bit buffer a word at a time,
+// swallow up to 4 input bytes past the end of the deflate stream
+#define TINFL_SHIM_LOOKAHEAD 4
+
+static inline void tinfl_shim_keep_tail(tinfl_decompressor *r, const uint8_t *in, size_t used)
+{
+    for (size_t i = 0; i < used; i++) {
+        memmove(r->tail, r->tail + 1, sizeof(r->tail) - 1);
+        r->tail[sizeof(r->tail) - 1] = in[i];
+    }
+}
+
+static inline tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in, size_t *in_size,
+                                            uint8_t *start, uint8_t *next, size_t *out_size, uint32_t flags)
+{
+    (void)start;
+    (void)flags;
+    if (!r->active) {
+        memset(&r->z, 0, sizeof(r->z));
+        if (inflateInit2(&r->z, -15) != Z_OK) {
+            return TINFL_STATUS_FAILED;
+        }
+        r->active = 1;
+    }
+    r->z.next_in = (Bytef *)in;
+    r->z.avail_in = (uInt)*in_size;
+    r->z.next_out = next;
+    r->z.avail_out = (uInt)*out_size;
+    // Block by block, to see the padding at the end of the last block before zlib
+    // drops it: data_type then has bit 6 (last block) and bit 7 (at a block boundary)
+    int ret;
+    do {
+        ret = inflate(&r->z, Z_BLOCK);
+        if (ret == Z_OK && (r->z.data_type & 192) == 192) {
+            r->pad = (uint32_t)r->z.data_type & 7;
+        }
+    } while (ret == Z_OK && r->z.avail_out > 0);
+    tinfl_shim_keep_tail(r, in, *in_size - r->z.avail_in);
+    r->m_num_bits = 0;
+    r->m_bit_buf = 0;
+    if (ret == Z_STREAM_END) {
+        // The bit buffer as the ROM leaves it: the padding of the last deflate byte (not
+        // shifted out without a zlib wrapper), then any whole bytes zlib took past it
+        uint32_t bits = ((uint32_t)r->z.data_type & 63) + r->pad;
+        uint32_t bytes = (bits + 7) / 8;
+        uint64_t held = 0;
+        for (uint32_t i = 0; i < bytes; i++) {
+            held |= (uint64_t)r->tail[sizeof(r->tail) - bytes + i] << (8 * i);
+        }
+        r->m_bit_buf = (uint32_t)(held >> (8 * bytes - bits));
+        r->m_num_bits = bits;
+        for (uInt i = 0; i < TINFL_SHIM_LOOKAHEAD && r->z.avail_in > 0 && r->m_num_bits + 8 <= 32; i++) {
+            r->m_bit_buf |= (uint32_t)*r->z.next_in++ << r->m_num_bits;
+            r->m_num_bits += 8;
+            r->z.avail_in--;
+        }
+    }
+    *in_size -= r->z.avail_in;
+    *out_size -= r->z.avail_out;
+    if (ret == Z_STREAM_END || (ret != Z_OK && ret != Z_BUF_ERROR)) {
+        inflateEnd(&r->z);
+        r->active = 0;
+        return ret == Z_STREAM_END ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+    }
+    return r->z.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
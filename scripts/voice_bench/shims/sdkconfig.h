@@ -0,0 +1,10 @@
+// Host shim: configuration for the voice pipeline benchmark build
+#pragma once
+
+#define CONFIG_MBEDTLS_SSL_IN_CONTENT_LEN 12288
+#define CONFIG_GEMINI_CONTEXT_CACHE_ENABLED 1
+#define CONFIG_GEMINI_CONTEXT_CACHE_TTL_S 3600
+#define CONFIG_GEMINI_CONVERSATION_BUDGET_BYTES 2048
+#define CONFIG_GEMINI_CONVERSATION_MAX_TURNS 8
+#define CONFIG_GEMINI_CONVERSATION_IDLE_S 120
+// No pre-connect: the mock server has no handshake to hide
@@ -0,0 +1,276 @@
+/**
+ * @file voice_bench.c
+ * @brief End-to-end benchmark of voice_assistant -> gemini_api -> playback against the mock server
+ *
+ * Runs voice_assistant_process_command() on a recorded (or synthetic) utterance and
+ * reports, per run, the time from end of speech to the first PCM sample handed to
+ * the playback sink, plus latency, bytes on the wire and peak heap of each stage.
+ * Stage boundaries come from linker-wrapped gemini_* entry points.
+ *
+ * Usage: voice_bench [--server host:port] [--runs N] [--audio utterance.s16le] [--speech-ms MS]
+ */
+
+#include "host_bench.h"
+#include "voice_assistant.h"
+#include "gemini_api.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    STAGE_STT = 0,
+    STAGE_LLM,
+    STAGE_TTS,
+    STAGE_COUNT,
+} stage_t;
+
+static const char *STAGE_NAMES[STAGE_COUNT] = { "stt", "llm", "tts" };
+
+typedef struct {
+    int calls;
+    int64_t elapsed_us;
+    uint64_t bytes_tx;
+    uint64_t bytes_rx;
+    size_t peak_heap;  // Above the live size at stage entry
+} stage_stats_t;
+
+static stage_stats_t s_stages[STAGE_COUNT];
+
+typedef struct {
+    int64_t start_us;
+    uint64_t tx;
+    uint64_t rx;
+    size_t live;
+} stage_mark_t;
+
+static stage_mark_t stage_begin(void)
+{
+    stage_mark_t mark;
+    mark.start_us = esp_timer_get_time();
+    host_http_get_counters(&mark.tx, &mark.rx);
+    size_t peak;
+    host_heap_get(&mark.live, &peak);
+    host_heap_reset_peak();
+    return mark;
+}
+
+static void stage_end(stage_t stage, const stage_mark_t *mark)
+{
+    stage_stats_t *s = &s_stages[stage];
+    uint64_t tx, rx;
+    size_t live, peak;
+    host_http_get_counters(&tx, &rx);
+    host_heap_get(&live, &peak);
+    s->calls++;
+    s->elapsed_us += esp_timer_get_time() - mark->start_us;
+    s->bytes_tx += tx - mark->tx;
+    s->bytes_rx += rx - mark->rx;
+    if (peak - mark->live > s->peak_heap) {
+        s->peak_heap = peak - mark->live;
+    }
+}
+
+// --- stage hooks (see -Wl,--wrap in CMakeLists.txt) -------------------------------
+
+esp_err_t __real_gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out, size_t text_len);
+esp_err_t __real_gemini_llm_converse(gemini_conversation_t *conversation, const char *prompt, const char *tools_json,
+                                     char *response, size_t response_len, gemini_function_call_t *function_call);
+esp_err_t __real_gemini_tts(const char *text, int16_t *audio_out, size_t audio_len, size_t *samples_written);
+esp_err_t __real_gemini_tts_streaming(const char *text, gemini_tts_playback_callback_t callback, void *user_data);
+
+esp_err_t __wrap_gemini_stt(const int16_t *audio_data, size_t audio_len, char *text_out, size_t text_len)
+{
+    stage_mark_t mark = stage_begin();
+    esp_err_t ret = __real_gemini_stt(audio_data, audio_len, text_out, text_len);
+    stage_end(STAGE_STT, &mark);
+    return ret;
+}
+
+esp_err_t __wrap_gemini_llm_converse(gemini_conversation_t *conversation, const char *prompt, const char *tools_json,
+                                     char *response, size_t response_len, gemini_function_call_t *function_call)
+{
+    stage_mark_t mark = stage_begin();
+    esp_err_t ret = __real_gemini_llm_converse(conversation, prompt, tools_json, response, response_len, function_call);
+    stage_end(STAGE_LLM, &mark);
+    return ret;
+}
+
+esp_err_t __wrap_gemini_tts(const char *text, int16_t *audio_out, size_t audio_len, size_t *samples_written)
+{
+    stage_mark_t mark = stage_begin();
+    esp_err_t ret = __real_gemini_tts(text, audio_out, audio_len, samples_written);
+    stage_end(STAGE_TTS, &mark);
+    return ret;
+}
+
+esp_err_t __wrap_gemini_tts_streaming(const char *text, gemini_tts_playback_callback_t callback, void *user_data)
+{
+    stage_mark_t mark = stage_begin();
+    esp_err_t ret = __real_gemini_tts_streaming(text, callback, user_data);
+    stage_end(STAGE_TTS, &mark);
+    return ret;
+}
+
+// --- input ----------------------------------------------------------------------
+
+static int16_t *load_audio(const char *path, size_t *samples)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    int16_t *audio = malloc(size);
+    if (audio && fread(audio, 1, size, f) != (size_t)size) {
+        free(audio);
+        audio = NULL;
+    }
+    fclose(f);
+    *samples = size / sizeof(int16_t);
+    return audio;
+}
+
+// Voiced-sounding synthetic utterance: a few harmonics under a syllable-rate envelope
+static int16_t *synth_audio(int duration_ms, size_t *samples)
+{
+    *samples = (size_t)duration_ms * 16;
+    int16_t *audio = malloc(*samples * sizeof(int16_t));
+    if (!audio) {
+        return NULL;
+    }
+    for (size_t i = 0; i < *samples; i++) {
+        double t = i / 16000.0;
+        double env = 0.5 + 0.5 * sin(2 * M_PI * 4.0 * t);
+        double v = sin(2 * M_PI * 140 * t) + 0.5 * sin(2 * M_PI * 280 * t) + 0.25 * sin(2 * M_PI * 560 * t);
+        audio[i] = (int16_t)(4000 * env * v);
+    }
+    return audio;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    const char *audio_path = NULL;
+    int runs = 5;
+    int speech_ms = 3000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            setenv("VOICE_BENCH_SERVER", argv[++i], 1);
+        } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--audio") == 0 && i + 1 < argc) {
+            audio_path = argv[++i];
+        } else if (strcmp(argv[i], "--speech-ms") == 0 && i + 1 < argc) {
+            speech_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--server host:port] [--runs N] [--audio utterance.s16le] [--speech-ms MS]\n"
+                            "  --audio expects raw 16 kHz mono signed 16-bit PCM\n"
+                            "  VOICE_BENCH_LOG=0..5 sets the log level (default 2 = warnings)\n", argv[0]);
+            return 2;
+        }
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    size_t samples = 0;
+    int16_t *audio = audio_path ? load_audio(audio_path, &samples) : synth_audio(speech_ms, &samples);
+    if (!audio) {
+        fprintf(stderr, "Cannot load audio %s\n", audio_path ? audio_path : "(synthetic)");
+        return 1;
+    }
+
+    voice_assistant_config_t config = { 0 };
+    snprintf(config.gemini_api_key, sizeof(config.gemini_api_key), "mock-key");
+    snprintf(config.gemini_model, sizeof(config.gemini_model), "gemini-2.5-flash");
+    if (voice_assistant_init(&config) != ESP_OK || voice_assistant_start() != ESP_OK) {
+        fprintf(stderr, "Voice assistant init failed\n");
+        return 1;
+    }
+
+    printf("Utterance: %zu samples (%.2f s), %d runs, server %s\n\n", samples, samples / 16000.0, runs,
+           getenv("VOICE_BENCH_SERVER") ? getenv("VOICE_BENCH_SERVER") : "127.0.0.1:8765");
+    printf("%-4s %-6s %12s %10s %10s %10s %10s %10s %12s\n", "run", "result", "first audio", "stt ms", "llm ms",
+           "tts ms", "tx bytes", "rx bytes", "peak heap");
+
+    int64_t *first_audio = calloc(runs, sizeof(int64_t));
+    int ok_runs = 0;
+    stage_stats_t totals[STAGE_COUNT] = { 0 };
+
+    for (int run = 0; run < runs; run++) {
+        memset(s_stages, 0, sizeof(s_stages));
+        host_audio_reset();
+        uint64_t tx0, rx0;
+        host_http_get_counters(&tx0, &rx0);
+
+        // The utterance is already captured: t0 is the end of speech
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t ret = voice_assistant_process_command(audio, samples);
+        int64_t first_us = host_audio_first_us();
+
+        uint64_t tx1, rx1;
+        host_http_get_counters(&tx1, &rx1);
+        size_t peak = 0;
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            if (s_stages[s].peak_heap > peak) {
+                peak = s_stages[s].peak_heap;
+            }
+            totals[s].calls += s_stages[s].calls;
+            totals[s].elapsed_us += s_stages[s].elapsed_us;
+            totals[s].bytes_tx += s_stages[s].bytes_tx;
+            totals[s].bytes_rx += s_stages[s].bytes_rx;
+            if (s_stages[s].peak_heap > totals[s].peak_heap) {
+                totals[s].peak_heap = s_stages[s].peak_heap;
+            }
+        }
+
+        // A reply that decodes to noise (e.g. mishandled JSON escapes) counts as a failure
+        bool pcm_ok = host_audio_max_step() <= HOST_PCM_MAX_STEP;
+        bool ok = (ret == ESP_OK && first_us > 0 && pcm_ok);
+        char first_buf[16] = "-";
+        if (ok) {
+            first_audio[ok_runs++] = first_us - t0;
+            snprintf(first_buf, sizeof(first_buf), "%.1f ms", (first_us - t0) / 1000.0);
+        }
+        const char *result = ok ? "ok" : (pcm_ok ? "FAIL" : "PCM");
+        printf("%-4d %-6s %12s %10.1f %10.1f %10.1f %10llu %10llu %12zu\n", run + 1, result, first_buf,
+               s_stages[STAGE_STT].elapsed_us / 1000.0, s_stages[STAGE_LLM].elapsed_us / 1000.0,
+               s_stages[STAGE_TTS].elapsed_us / 1000.0, (unsigned long long)(tx1 - tx0),
+               (unsigned long long)(rx1 - rx0), peak);
+    }
+
+    printf("\nPer stage (all runs)\n");
+    printf("%-6s %6s %12s %14s %14s %14s\n", "stage", "calls", "mean ms", "tx bytes/call", "rx bytes/call",
+           "peak heap");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        int calls = totals[s].calls ? totals[s].calls : 1;
+        printf("%-6s %6d %12.1f %14llu %14llu %14zu\n", STAGE_NAMES[s], totals[s].calls,
+               totals[s].elapsed_us / 1000.0 / calls, (unsigned long long)(totals[s].bytes_tx / calls),
+               (unsigned long long)(totals[s].bytes_rx / calls), totals[s].peak_heap);
+    }
+
+    if (ok_runs > 0) {
+        qsort(first_audio, ok_runs, sizeof(int64_t), cmp_i64);
+        printf("\nEnd of speech -> first audio: min %.1f ms, median %.1f ms, max %.1f ms (%d/%d runs ok)\n",
+               first_audio[0] / 1000.0, first_audio[ok_runs / 2] / 1000.0, first_audio[ok_runs - 1] / 1000.0,
+               ok_runs, runs);
+    } else {
+        printf("\nNo successful runs\n");
+    }
+
+    voice_assistant_deinit();
+    free(first_audio);
+    free(audio);
+    return ok_runs == runs ? 0 : 1;
+}
@@ -0,0 +1,363 @@
+/**
+ * @file volume_bench.c
+ * @brief Ramp and codec-handover checks plus ns/frame timing of the output volume
+ * (main/audio_volume.c)
+ *
+ * Checks: a software ramp gets within 1% of its target in the configured time, moves
+ * monotonically and never boosts; the codec/software split keeps the total level
+ * continuous across DAC register steps. For the split, a DC block stream goes through
+ * a model of the player: a 6-buffer I2S DMA queue, a feeder that plans each block with
+ * audio_volume_codec_update() against the byte counters the DMA ISR keeps, and a DAC
+ * whose step applies from the block playing when the register is written. The feeder
+ * either keeps the queue full or lags behind it with underruns. Then times the stage.
+ *
+ * Usage: volume_bench [--ms MIN_MS_PER_CASE]
+ */
+
+#include "audio_volume.h"
+#include "bench_common.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RATE         48000
+#define BLOCK        256       // AUDIO_MIXER_CHUNK_FRAMES
+#define BLOCK_BYTES  (BLOCK * 2 * (uint32_t)sizeof(int16_t))
+#define QUEUE        6         // PLAYBACK_DMA_DESC_NUM
+#define RAMP_MS      30        // CONFIG_AUDIO_VOLUME_RAMP_MS
+#define STEP_DB      6.0f      // CONFIG_AUDIO_VOLUME_HW_STEP_DB
+#define RANGE_DB     48.0f     // CONFIG_AUDIO_VOLUME_RANGE_DB
+#define DC           32000     // Test input, both channels
+#define MAX_JUMP_DB  0.5       // Largest level change across a block boundary (a step is 6 dB)
+#define MIN_OUT      64        // Below this the int16 output is too coarse to compare in dB
+#define TICKS        1400      // DMA blocks per scenario
+
+static void fill_dc(int16_t *block, size_t frames)
+{
+    for (size_t i = 0; i < frames * 2; i++) {
+        block[i] = DC;
+    }
+}
+
+// --- software ramp ----------------------------------------------------------------
+
+static void check_ramp(float from, float to)
+{
+    audio_volume_t vol;
+    audio_volume_init(&vol, RATE, RAMP_MS);
+    audio_volume_set_target(&vol, from, true);
+    audio_volume_set_target(&vol, to, false);
+
+    int16_t block[BLOCK * 2];
+    int prev = (int)lroundf(DC * from);
+    bool monotonic = true;
+    bool boosted = false;
+    int blocks_in_ramp = (RATE * RAMP_MS / 1000 + BLOCK - 1) / BLOCK;
+    float at_ramp_end = 0.0f;
+    for (int b = 0; b < blocks_in_ramp * 4; b++) {
+        fill_dc(block, BLOCK);
+        audio_volume_process_s16(&vol, block, BLOCK);
+        for (int i = 0; i < BLOCK; i++) {
+            int s = block[2 * i];
+            if ((to < from && s > prev + 1) || (to > from && s < prev - 1)) {
+                monotonic = false;
+            }
+            if (s > DC || block[2 * i + 1] != s) {
+                boosted = true;
+            }
+            prev = s;
+        }
+        if (b == blocks_in_ramp - 1) {
+            at_ramp_end = vol.gain;
+        }
+    }
+    printf("  %.2f -> %.2f: %.4f after %d ms, %s\n", from, to, at_ramp_end, RAMP_MS,
+           audio_volume_settled(&vol) ? "settled" : "not settled");
+    CHECK(fabsf(at_ramp_end - to) <= 0.01f * fabsf(from - to) + 1e-4f, "ramp %.2f -> %.2f at %.4f after %d ms",
+          from, to, at_ramp_end, RAMP_MS);
+    CHECK(monotonic, "ramp %.2f -> %.2f is not monotonic", from, to);
+    CHECK(!boosted, "ramp %.2f -> %.2f exceeds the input or splits the channels", from, to);
+    CHECK(audio_volume_settled(&vol) && vol.gain == to, "ramp %.2f -> %.2f never settles", from, to);
+}
+
+static void check_ramps(void)
+{
+    check_ramp(1.0f, 0.25f);
+    check_ramp(0.25f, 1.0f);
+    check_ramp(0.5f, 0.0f);
+    check_ramp(0.0f, 0.7f);
+
+    audio_volume_t vol;
+    audio_volume_init(&vol, RATE, RAMP_MS);
+    audio_volume_set_target(&vol, 1.5f, false);
+    CHECK(vol.target == 1.0f, "a target above unity is not clamped");
+    audio_volume_set_target(&vol, 0.3f, true);
+    CHECK(vol.gain == 0.3f && audio_volume_settled(&vol), "an immediate change ramps");
+
+    int16_t block[BLOCK * 2];
+    fill_dc(block, BLOCK);
+    audio_volume_set_target(&vol, 0.0f, true);
+    audio_volume_process_s16(&vol, block, BLOCK);
+    bool silent = true;
+    for (int i = 0; i < BLOCK * 2; i++) {
+        silent &= block[i] == 0;
+    }
+    CHECK(silent, "mute leaves signal");
+}
+
+// --- codec handover ---------------------------------------------------------------
+
+typedef struct {
+    int16_t pcm[BLOCK * 2];
+} dma_block_t;
+
+typedef struct {
+    int tick;
+    float level;
+} level_change_t;
+
+static const level_change_t s_script[] = {
+    { 0, 1.0f }, { 20, 0.3f }, { 220, 0.8f }, { 420, 0.05f }, { 620, 0.0f },
+    { 720, 0.6f }, { 920, 0.42f }, { 1000, 0.9f }, { 1200, 1.0f },
+};
+#define SCRIPT_LEN (sizeof(s_script) / sizeof(s_script[0]))
+
+typedef struct {
+    audio_volume_codec_t vc;
+    float db;                  // Requested attenuation
+    float dac_db;              // Codec register as last written
+    dma_block_t queue[QUEUE];
+    int head;
+    int count;
+    uint32_t written;          // Bytes the feeder has queued (dma_written_bytes)
+    uint32_t sent;             // Bytes the DMA has finished (dma_sent_bytes)
+    int dac_writes;
+    double prev;               // Total gain of the last audible sample, NAN after silence
+    double slope;              // Its change from the sample before
+    double max_jump_db;
+    int jumps;
+} sim_t;
+
+static void sim_update(sim_t *sim, bool playing)
+{
+    float hw_db;
+    if (audio_volume_codec_update(&sim->vc, sim->db, playing, sim->written, sim->sent, &hw_db)) {
+        sim->dac_db = hw_db;  // Applies from the block the DMA is on now, the next one popped
+        sim->dac_writes++;
+    }
+}
+
+// One feeder pass: plan, process and queue a mixed block
+static void sim_feed(sim_t *sim)
+{
+    if ((int32_t)(sim->written - sim->sent) < 0) {
+        sim->written = sim->sent;  // As sample_dma_fill() after cleared buffers went out
+    }
+    sim_update(sim, true);
+    dma_block_t *blk = &sim->queue[(sim->head + sim->count) % QUEUE];
+    fill_dc(blk->pcm, BLOCK);
+    audio_volume_process_s16(&sim->vc.sw, blk->pcm, BLOCK);
+    sim->count++;
+    sim->written += BLOCK_BYTES;
+}
+
+// One DMA buffer goes out: the oldest queued block, or a cleared one after an underrun
+static void sim_play(sim_t *sim)
+{
+    sim->sent += BLOCK_BYTES;
+    if (sim->count == 0) {
+        sim->prev = NAN;
+        return;
+    }
+    const dma_block_t *blk = &sim->queue[sim->head];
+    sim->head = (sim->head + 1) % QUEUE;
+    sim->count--;
+    for (int i = 0; i < BLOCK; i++) {
+        int s = blk->pcm[2 * i];
+        if (s > DC || blk->pcm[2 * i + 1] != s) {
+            sim->max_jump_db = INFINITY;  // Boost or channel mismatch
+        }
+        if (s < MIN_OUT) {
+            sim->prev = NAN;
+            continue;
+        }
+        double level = (double)s / DC * pow(10.0, sim->dac_db / 20.0);
+        // Within a block the DAC is fixed and the ramp linear; a step can only land
+        // on a boundary, so compare the first sample with the previous block's trend
+        if (i == 0 && !isnan(sim->prev) && !isnan(sim->slope)) {
+            double jump = fabs(20.0 * log10(level / (sim->prev + sim->slope)));
+            if (jump > sim->max_jump_db) {
+                sim->max_jump_db = jump;
+            }
+            if (jump > MAX_JUMP_DB) {
+                sim->jumps++;
+            }
+        }
+        sim->slope = isnan(sim->prev) || i == 0 ? NAN : level - sim->prev;
+        sim->prev = level;
+    }
+}
+
+// Level of the block that just played, from the last queued one's gain and the DAC
+static double sim_settled_db(const sim_t *sim)
+{
+    return 20.0 * log10(sim->vc.sw.gain) + sim->dac_db;
+}
+
+/**
+ * @param lag: 0 keeps the queue full; otherwise the source delivers 0..2 blocks per DMA
+ *             block at random, so the queue runs anywhere from empty to full
+ */
+static void run_handover(const char *name, int lag, unsigned seed)
+{
+    sim_t sim;
+    memset(&sim, 0, sizeof(sim));
+    audio_volume_codec_init(&sim.vc, RATE, RAMP_MS, STEP_DB);
+    sim.prev = NAN;
+    sim.slope = NAN;
+    srand(seed);
+
+    size_t next_change = 0;
+    int budget = 0;
+    int underruns = 0;
+    int unsettled = 0;
+    for (int tick = 0; tick < TICKS; tick++) {
+        if (next_change < SCRIPT_LEN && s_script[next_change].tick == tick) {
+            if (tick > 0 && !isinf(sim.db)) {
+                // End of the previous step: everything handed over, level reached
+                double got = sim_settled_db(&sim);
+                if (sim.vc.hw_pending || fabs(got - sim.db) > 0.1) {
+                    printf("  %s: %.1f dB requested, %.2f dB at tick %d%s\n", name, sim.db, got, tick,
+                           sim.vc.hw_pending ? " (handover pending)" : "");
+                    unsettled++;
+                }
+            }
+            sim.db = audio_volume_level_to_db(s_script[next_change].level, RANGE_DB);
+            next_change++;
+        }
+
+        if (lag == 0) {
+            while (sim.count < QUEUE) {
+                sim_feed(&sim);
+            }
+        } else {
+            budget += rand() % 3;
+            while (sim.count < QUEUE) {
+                if (budget == 0) {
+                    sim_update(&sim, false);  // Mixer ran dry: the feeder idles
+                    break;
+                }
+                sim_feed(&sim);
+                budget--;
+            }
+            if (budget > QUEUE) {
+                budget = QUEUE;
+            }
+        }
+        underruns += sim.count == 0;
+        sim_play(&sim);
+    }
+
+    printf("  %-12s max step %.3f dB, %d DAC writes, %d underruns\n", name, sim.max_jump_db, sim.dac_writes,
+           underruns);
+    CHECK(sim.jumps == 0 && isfinite(sim.max_jump_db), "%s: %d level jumps over %.1f dB (max %.2f dB)", name,
+          sim.jumps, MAX_JUMP_DB, sim.max_jump_db);
+    CHECK(unsettled == 0, "%s: %d volume steps not reached", name, unsettled);
+    CHECK(sim.dac_writes > 0, "%s: the codec register was never written", name);
+}
+
+static void check_handover(void)
+{
+    run_handover("queue full", 0, 1);
+    for (unsigned seed = 1; seed <= 4; seed++) {
+        char name[32];
+        snprintf(name, sizeof(name), "lagging #%u", seed);
+        run_handover(name, 1, seed);
+    }
+
+    // Nothing queued or playing: both parts move at once
+    audio_volume_codec_t vc;
+    audio_volume_codec_init(&vc, RATE, RAMP_MS, STEP_DB);
+    float hw_db = 0.0f;
+    bool write = audio_volume_codec_update(&vc, -20.0f, false, 4096, 4096, &hw_db);
+    CHECK(write && hw_db == -18.0f && !vc.hw_pending, "idle change: write %d, codec %.1f dB", write, hw_db);
+    CHECK(fabsf(20.0f * log10f(vc.sw.gain) + 2.0f) < 0.01f && audio_volume_settled(&vc.sw),
+          "idle change: software %.2f dB", 20.0f * log10f(vc.sw.gain));
+
+    // A step handed over at a wrapped position is written once the counter passes it
+    audio_volume_codec_init(&vc, RATE, RAMP_MS, STEP_DB);
+    uint32_t pos = 0xFFFFFFFFu - BLOCK_BYTES + 1;
+    audio_volume_codec_update(&vc, -3.0f, true, pos, pos - QUEUE * BLOCK_BYTES, &hw_db);
+    audio_volume_codec_update(&vc, -12.0f, true, pos, pos - QUEUE * BLOCK_BYTES, &hw_db);
+    int16_t block[BLOCK * 2];
+    for (int i = 0; i < 40 && !audio_volume_settled(&vc.sw); i++) {
+        fill_dc(block, BLOCK);
+        audio_volume_process_s16(&vc.sw, block, BLOCK);
+    }
+    write = audio_volume_codec_update(&vc, -12.0f, true, pos, pos - QUEUE * BLOCK_BYTES, &hw_db);
+    CHECK(!write && vc.hw_pending && vc.hw_due_pos == pos, "handover not queued at the write position");
+    write = audio_volume_codec_update(&vc, -12.0f, true, pos + BLOCK_BYTES, pos - BLOCK_BYTES, &hw_db);
+    CHECK(!write, "codec written before the queue ahead of the handover block played");
+    write = audio_volume_codec_update(&vc, -12.0f, true, pos + BLOCK_BYTES, pos, &hw_db);
+    CHECK(write && hw_db == -12.0f && !vc.hw_pending, "codec not written once its block plays (wrap)");
+}
+
+// --- timing -----------------------------------------------------------------------
+
+static void bench(int min_ms)
+{
+    static int16_t block[BLOCK * 2];
+    const struct {
+        const char *name;
+        float from;
+        float to;
+    } cases[] = {
+        { "unity", 1.0f, 1.0f },
+        { "constant 0.5", 0.5f, 0.5f },
+        { "ramping", 1.0f, 0.0001f },
+    };
+    printf("\nTiming (%d frames per block)\n", BLOCK);
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        audio_volume_t vol;
+        audio_volume_init(&vol, RATE, 1000);
+        long blocks = 0;
+        double start = now_s();
+        double elapsed;
+        do {
+            for (int i = 0; i < 256; i++) {
+                if (vol.gain == cases[c].to) {
+                    audio_volume_set_target(&vol, cases[c].from, true);
+                    audio_volume_set_target(&vol, cases[c].to, false);
+                }
+                fill_dc(block, BLOCK);
+                audio_volume_process_s16(&vol, block, BLOCK);
+            }
+            blocks += 256;
+            elapsed = now_s() - start;
+        } while (elapsed * 1000.0 < min_ms);
+        printf("  %-14s %6.2f ns/frame (fill included)\n", cases[c].name, elapsed * 1e9 / (blocks * BLOCK));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int min_ms = 300;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ms") == 0 && i + 1 < argc) {
+            min_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--ms MIN_MS_PER_CASE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("Software ramp (%d ms)\n", RAMP_MS);
+    check_ramps();
+    printf("Codec handover (%.0f dB steps, %d-block DMA queue)\n", STEP_DB, QUEUE);
+    check_handover();
+
+    bench(min_ms);
+
+    return bench_exit_code();
+}